@@ -24,11 +24,21 @@
  * <ulink url="http://flac.sourceforge.net/">FLAC</ulink>
  * is a Free Lossless Audio Codec.
  *
+ * With the #GstFlacEnc:threads property set to anything but 1, the input is
+ * split into groups of frames that are encoded independently by a pool of
+ * worker threads. The encoded frames are pushed in stream order and the
+ * STREAMINFO and SEEKTABLE headers are rewritten at the end of the stream,
+ * so the result is a normal FLAC stream that does not depend on the number
+ * of threads.
+ *
  * <refsect2>
- * <title>Example launch line</title>
+ * <title>Example launch lines</title>
  * |[
  * gst-launch audiotestsrc num-buffers=100 ! flacenc ! filesink location=beep.flac
  * ]|
+ * |[
+ * gst-launch filesrc location=capture.wav ! wavparse ! audioconvert ! flacenc quality=8 threads=0 ! filesink location=capture.flac
+ * ]| Encode a file at the highest compression level, using all CPU cores.
  * </refsect2>
  */
 
@@ -42,6 +52,9 @@
 #endif
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include <gstflacenc.h>
 #include <gst/audio/audio.h>
@@ -143,7 +156,8 @@ enum
   PROP_MAX_RESIDUAL_PARTITION_ORDER,
   PROP_RICE_PARAMETER_SEARCH_DIST,
   PROP_PADDING,
-  PROP_SEEKPOINTS
+  PROP_SEEKPOINTS,
+  PROP_THREADS
 };
 
 GST_DEBUG_CATEGORY_STATIC (flacenc_debug);
@@ -194,6 +208,13 @@ static FLAC__StreamEncoderTellStatus
 gst_flac_enc_tell_callback (const FLAC__StreamEncoder * encoder,
     FLAC__uint64 * absolute_byte_offset, void *client_data);
 
+static void gst_flac_enc_init_crc16_table (void);
+static void gst_flac_enc_start_pool (GstFlacEnc * flacenc);
+static GstFlowReturn gst_flac_enc_queue_samples (GstFlacEnc * flacenc,
+    const FLAC__int32 * data, guint samples);
+static void gst_flac_enc_finish_groups (GstFlacEnc * flacenc);
+static void gst_flac_enc_free_groups (GstFlacEnc * flacenc);
+
 typedef struct
 {
   gboolean exhaustive_model_search;
@@ -226,6 +247,12 @@ static const GstFlacEncParams flacenc_params[] = {
 #define DEFAULT_QUALITY 5
 #define DEFAULT_PADDING 0
 #define DEFAULT_SEEKPOINTS 0
+#define DEFAULT_THREADS 1
+
+/* number of frames that are encoded together in parallel mode. This, and
+ * not the number of threads, decides where the independent encoders start,
+ * so the output is the same for any number of threads */
+#define GROUP_FRAMES 16
 
 #define GST_TYPE_FLAC_ENC_QUALITY (gst_flac_enc_quality_get_type ())
 static GType
@@ -290,6 +317,8 @@ gst_flac_enc_class_init (GstFlacEncClass * klass)
   base_class->getcaps = GST_DEBUG_FUNCPTR (gst_flac_enc_getcaps);
   base_class->event = GST_DEBUG_FUNCPTR (gst_flac_enc_sink_event);
 
+  gst_flac_enc_init_crc16_table ();
+
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_QUALITY,
       g_param_spec_enum ("quality",
           "Quality",
@@ -402,6 +431,24 @@ gst_flac_enc_class_init (GstFlacEncClass * klass)
           -G_MAXINT, G_MAXINT,
           DEFAULT_SEEKPOINTS,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFlacEnc:threads
+   *
+   * Number of threads that encode groups of frames in parallel. 1 uses the
+   * single threaded stream encoder of libFLAC, 0 uses one thread per CPU
+   * core. Changes take effect when the next stream starts.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_THREADS,
+      g_param_spec_uint ("threads",
+          "Threads",
+          "Number of threads for encoding frames in parallel "
+          "(0 = automatic, 1 = single threaded)", 0, G_MAXINT,
+          DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -412,6 +459,10 @@ gst_flac_enc_init (GstFlacEnc * flacenc, GstFlacEncClass * klass)
   flacenc->encoder = FLAC__stream_encoder_new ();
   gst_flac_enc_update_quality (flacenc, DEFAULT_QUALITY);
 
+  flacenc->groups_lock = g_mutex_new ();
+  flacenc->groups_cond = g_cond_new ();
+  flacenc->groups = g_queue_new ();
+
   /* arrange granulepos marking (and required perfect ts) */
   gst_audio_encoder_set_mark_granule (enc, TRUE);
   gst_audio_encoder_set_perfect_timestamp (enc, TRUE);
@@ -423,6 +474,9 @@ gst_flac_enc_finalize (GObject * object)
   GstFlacEnc *flacenc = GST_FLAC_ENC (object);
 
   FLAC__stream_encoder_delete (flacenc->encoder);
+  g_mutex_free (flacenc->groups_lock);
+  g_cond_free (flacenc->groups_cond);
+  g_queue_free (flacenc->groups);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -442,6 +496,14 @@ gst_flac_enc_start (GstAudioEncoder * enc)
   flacenc->sample_rate = 0;
   flacenc->eos = FALSE;
   flacenc->tags = gst_tag_list_new ();
+  flacenc->seektable_offset = 0;
+  flacenc->seektable = NULL;
+  flacenc->frames_queued = 0;
+  flacenc->samples_out = 0;
+  flacenc->frames_offset = 0;
+  flacenc->min_framesize = 0;
+  flacenc->max_framesize = 0;
+  flacenc->seek_point = 0;
 
   return TRUE;
 }
@@ -459,6 +521,8 @@ gst_flac_enc_stop (GstAudioEncoder * enc)
     flacenc->stopped = TRUE;
     FLAC__stream_encoder_finish (flacenc->encoder);
   }
+  gst_flac_enc_free_groups (flacenc);
+  flacenc->seektable = NULL;
   if (flacenc->meta) {
     FLAC__metadata_object_delete (flacenc->meta[0]);
 
@@ -599,6 +663,7 @@ gst_flac_enc_set_metadata (GstFlacEnc * flacenc, guint64 total_samples)
       FLAC__metadata_object_delete (flacenc->meta[1]);
       flacenc->meta[entries] = NULL;
     } else {
+      flacenc->seektable = flacenc->meta[entries];
       entries++;
     }
   } else if (flacenc->seekpoints && total_samples == GST_CLOCK_TIME_NONE) {
@@ -807,6 +872,9 @@ gst_flac_enc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
   if (init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
     goto failed_to_initialize;
 
+  if (flacenc->threads != 1)
+    gst_flac_enc_start_pool (flacenc);
+
   /* no special feedback to base class; should provide all available samples */
 
   return TRUE;
@@ -931,6 +999,7 @@ notgst_value_array_append_buffer (GValue * array_val, GstBuffer * buf)
 }
 
 #define HDR_TYPE_STREAMINFO     0
+#define HDR_TYPE_SEEKTABLE      3
 #define HDR_TYPE_VORBISCOMMENT  4
 
 static GstFlowReturn
@@ -1062,6 +1131,8 @@ gst_flac_enc_write_callback (const FLAC__StreamEncoder * encoder,
     if (samples == 0) {
       GST_DEBUG_OBJECT (flacenc, "Got header, queueing (%u bytes)",
           (guint) bytes);
+      if (bytes > 4 && (buffer[0] & 0x7f) == HDR_TYPE_SEEKTABLE)
+        flacenc->seektable_offset = flacenc->offset;
       flacenc->headers = g_list_append (flacenc->headers, outbuf);
       /* note: it's important that we increase our byte offset */
       goto out;
@@ -1115,6 +1186,507 @@ gst_flac_enc_tell_callback (const FLAC__StreamEncoder * encoder,
   return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
 }
 
+/* Parallel encoding: the input is collected in groups of GROUP_FRAMES frames
+ * that are encoded by their own stream encoder in the thread pool. The
+ * encoded groups are passed through the write callback in stream order, as
+ * if the main encoder had produced them; the main encoder itself only writes
+ * the headers, which are updated at the end of the stream. */
+struct _GstFlacEncGroup
+{
+  FLAC__StreamEncoder *encoder;
+  FLAC__int32 *data;
+  guint samples;                /* per channel */
+  guint64 first_frame;
+
+  /* written by the worker thread */
+  GByteArray *frames;
+  GArray *frame_sizes;
+  gboolean done;                /* protected by the groups lock */
+  gboolean failed;
+};
+
+static guint16 crc16_table[256];
+
+static void
+gst_flac_enc_init_crc16_table (void)
+{
+  guint i, j;
+  guint16 crc;
+
+  for (i = 0; i < 256; i++) {
+    crc = i << 8;
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
+    crc16_table[i] = crc;
+  }
+}
+
+static guint8
+gst_flac_enc_crc8 (const guint8 * data, guint size)
+{
+  guint8 crc = 0;
+  guint i;
+
+  while (size--) {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+
+  return crc;
+}
+
+static guint16
+gst_flac_enc_crc16 (const guint8 * data, guint size)
+{
+  guint16 crc = 0;
+
+  while (size--)
+    crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ *data++];
+
+  return crc;
+}
+
+/* Every group encoder numbers its frames from 0, so the frame number in the
+ * header is replaced by @number, which can change the size of the header.
+ * Writes the frame to @out, which needs room for 6 bytes more than @size,
+ * and returns the new size */
+static guint
+gst_flac_enc_renumber_frame (const guint8 * data, guint size, guint64 number,
+    guint8 * out)
+{
+  guint old_len = 0, len, extra = 0, header, i;
+
+  /* "UTF-8" coded frame number */
+  while (old_len < 7 && (data[4] & (0x80 >> old_len)))
+    old_len++;
+  if (old_len == 0)
+    old_len = 1;
+
+  /* blocksize and sample rate that follow the frame number */
+  if ((data[2] >> 4) == 6)
+    extra += 1;
+  else if ((data[2] >> 4) == 7)
+    extra += 2;
+  if ((data[2] & 0x0f) == 12)
+    extra += 1;
+  else if ((data[2] & 0x0f) == 13 || (data[2] & 0x0f) == 14)
+    extra += 2;
+
+  header = 4 + old_len + extra;
+  if (G_UNLIKELY (size < header + 3)) {
+    memcpy (out, data, size);
+    return size;
+  }
+
+  memcpy (out, data, 4);
+  if (number < 0x80) {
+    out[4] = number;
+    len = 1;
+  } else {
+    len = 2;
+    while (len < 7 && number >= (G_GUINT64_CONSTANT (1) << (5 * len + 1)))
+      len++;
+    out[4] = ((0xff00 >> len) & 0xff) | (number >> (6 * (len - 1)));
+    for (i = 1; i < len; i++)
+      out[4 + i] = 0x80 | ((number >> (6 * (len - 1 - i))) & 0x3f);
+  }
+  memcpy (out + 4 + len, data + 4 + old_len, extra);
+  out[4 + len + extra] = gst_flac_enc_crc8 (out, 4 + len + extra);
+  memcpy (out + 5 + len + extra, data + header + 1, size - header - 3);
+
+  size = size - old_len + len;
+  GST_WRITE_UINT16_BE (out + size - 2, gst_flac_enc_crc16 (out, size - 2));
+
+  return size;
+}
+
+static FLAC__StreamEncoderWriteStatus
+gst_flac_enc_group_write_callback (const FLAC__StreamEncoder * encoder,
+    const FLAC__byte buffer[], size_t bytes,
+    unsigned samples, unsigned current_frame, void *client_data)
+{
+  GstFlacEncGroup *group = client_data;
+  guint pos = group->frames->len;
+  guint size = bytes;
+
+  /* the stream headers come from the main encoder */
+  if (samples == 0)
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+
+  g_byte_array_set_size (group->frames, pos + bytes + 6);
+  if (group->first_frame == 0)
+    memcpy (group->frames->data + pos, buffer, bytes);
+  else
+    size = gst_flac_enc_renumber_frame (buffer, bytes,
+        group->first_frame + current_frame, group->frames->data + pos);
+  g_byte_array_set_size (group->frames, pos + size);
+  g_array_append_val (group->frame_sizes, size);
+
+  return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static GstFlacEncGroup *
+gst_flac_enc_group_new (GstFlacEnc * flacenc)
+{
+  GstFlacEncGroup *group;
+  FLAC__StreamEncoder *encoder;
+  guint blocksize = FLAC__stream_encoder_get_blocksize (flacenc->encoder);
+
+  group = g_slice_new0 (GstFlacEncGroup);
+  group->data = g_new (FLAC__int32, GROUP_FRAMES * blocksize *
+      flacenc->channels);
+  group->first_frame = flacenc->frames_queued;
+  group->frames = g_byte_array_new ();
+  group->frame_sizes = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* same settings as the main encoder, the MD5 sum is calculated over
+   * the whole stream by us */
+  encoder = group->encoder = FLAC__stream_encoder_new ();
+
+#define COPY_SETTING(name)                                                      \
+  FLAC__stream_encoder_set_##name (encoder,                                     \
+      FLAC__stream_encoder_get_##name (flacenc->encoder))
+
+  COPY_SETTING (channels);
+  COPY_SETTING (bits_per_sample);
+  COPY_SETTING (sample_rate);
+  COPY_SETTING (streamable_subset);
+  COPY_SETTING (blocksize);
+  COPY_SETTING (do_mid_side_stereo);
+  COPY_SETTING (loose_mid_side_stereo);
+  COPY_SETTING (max_lpc_order);
+  COPY_SETTING (qlp_coeff_precision);
+  COPY_SETTING (do_qlp_coeff_prec_search);
+  COPY_SETTING (do_escape_coding);
+  COPY_SETTING (do_exhaustive_model_search);
+  COPY_SETTING (min_residual_partition_order);
+  COPY_SETTING (max_residual_partition_order);
+  COPY_SETTING (rice_parameter_search_dist);
+
+#undef COPY_SETTING
+
+  FLAC__stream_encoder_set_do_md5 (encoder, false);
+
+  return group;
+}
+
+static void
+gst_flac_enc_group_free (GstFlacEncGroup * group)
+{
+  FLAC__stream_encoder_delete (group->encoder);
+  g_free (group->data);
+  g_byte_array_free (group->frames, TRUE);
+  g_array_free (group->frame_sizes, TRUE);
+  g_slice_free (GstFlacEncGroup, group);
+}
+
+/* runs in the thread pool */
+static void
+gst_flac_enc_encode_group (GstFlacEncGroup * group, GstFlacEnc * flacenc)
+{
+  gboolean res;
+
+  res = (FLAC__stream_encoder_init_stream (group->encoder,
+          gst_flac_enc_group_write_callback, NULL, NULL, NULL, group) ==
+      FLAC__STREAM_ENCODER_INIT_STATUS_OK);
+  if (res)
+    res = FLAC__stream_encoder_process_interleaved (group->encoder,
+        group->data, group->samples);
+  /* writes the last frame */
+  FLAC__stream_encoder_finish (group->encoder);
+
+  g_free (group->data);
+  group->data = NULL;
+
+  g_mutex_lock (flacenc->groups_lock);
+  group->done = TRUE;
+  group->failed = !res;
+  g_cond_broadcast (flacenc->groups_cond);
+  g_mutex_unlock (flacenc->groups_lock);
+}
+
+static void
+gst_flac_enc_start_pool (GstFlacEnc * flacenc)
+{
+  gint threads = flacenc->threads;
+
+  if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#else
+    threads = 1;
+#endif
+  }
+
+  GST_DEBUG_OBJECT (flacenc, "encoding with %d threads", threads);
+
+  flacenc->pool = g_thread_pool_new ((GFunc) gst_flac_enc_encode_group,
+      flacenc, threads, FALSE, NULL);
+  flacenc->md5 = g_checksum_new (G_CHECKSUM_MD5);
+}
+
+static void
+gst_flac_enc_free_groups (GstFlacEnc * flacenc)
+{
+  GstFlacEncGroup *group;
+
+  if (flacenc->pool) {
+    /* drops the groups that are not encoded yet and waits for the others */
+    g_thread_pool_free (flacenc->pool, TRUE, TRUE);
+    flacenc->pool = NULL;
+  }
+
+  while ((group = g_queue_pop_head (flacenc->groups)))
+    gst_flac_enc_group_free (group);
+
+  if (flacenc->group) {
+    gst_flac_enc_group_free (flacenc->group);
+    flacenc->group = NULL;
+  }
+
+  if (flacenc->md5) {
+    g_checksum_free (flacenc->md5);
+    flacenc->md5 = NULL;
+  }
+}
+
+/* STREAMINFO has the MD5 sum of the samples in little endian byte order,
+ * with as many bytes per sample as needed for the depth */
+static void
+gst_flac_enc_update_md5 (GstFlacEnc * flacenc, const FLAC__int32 * data,
+    guint samples)
+{
+  guint bps = (flacenc->depth + 7) / 8;
+  guint n = samples * flacenc->channels;
+  guint8 *bytes, *p;
+  guint i, j;
+
+  p = bytes = g_malloc (n * bps);
+  for (i = 0; i < n; i++)
+    for (j = 0; j < bps; j++)
+      *p++ = data[i] >> (8 * j);
+
+  g_checksum_update (flacenc->md5, bytes, n * bps);
+  g_free (bytes);
+}
+
+static void
+gst_flac_enc_submit_group (GstFlacEnc * flacenc)
+{
+  g_queue_push_tail (flacenc->groups, flacenc->group);
+  g_thread_pool_push (flacenc->pool, flacenc->group, NULL);
+  flacenc->group = NULL;
+  flacenc->frames_queued += GROUP_FRAMES;
+}
+
+static GstFlowReturn
+gst_flac_enc_push_group (GstFlacEnc * flacenc, GstFlacEncGroup * group)
+{
+  FLAC__StreamMetadata_SeekTable *table = NULL;
+  guint blocksize = FLAC__stream_encoder_get_blocksize (flacenc->encoder);
+  const guint8 *data = group->frames->data;
+  guint i, size, samples;
+
+  if (group->failed) {
+    GST_ELEMENT_ERROR (flacenc, STREAM, ENCODE, (NULL),
+        ("could not encode frames starting at %" G_GUINT64_FORMAT,
+            group->first_frame));
+    flacenc->last_flow = GST_FLOW_ERROR;
+    return GST_FLOW_ERROR;
+  }
+
+  if (flacenc->seektable)
+    table = &flacenc->seektable->data.seek_table;
+
+  for (i = 0; i < group->frame_sizes->len; i++) {
+    size = g_array_index (group->frame_sizes, guint, i);
+    samples = MIN (blocksize, group->samples - i * blocksize);
+
+    if (flacenc->samples_out == 0)
+      flacenc->frames_offset = flacenc->offset;
+
+    /* like libFLAC, make the seekpoints of the template point to the frame
+     * that contains their sample */
+    while (table && flacenc->seek_point < table->num_points &&
+        table->points[flacenc->seek_point].sample_number <
+        flacenc->samples_out + samples) {
+      FLAC__StreamMetadata_SeekPoint *point =
+          &table->points[flacenc->seek_point++];
+
+      point->sample_number = flacenc->samples_out;
+      point->stream_offset = flacenc->offset - flacenc->frames_offset;
+      point->frame_samples = samples;
+    }
+
+    if (flacenc->min_framesize == 0 || size < flacenc->min_framesize)
+      flacenc->min_framesize = size;
+    if (size > flacenc->max_framesize)
+      flacenc->max_framesize = size;
+    flacenc->samples_out += samples;
+
+    if (gst_flac_enc_write_callback (flacenc->encoder, data, size, samples,
+            group->first_frame + i, flacenc) !=
+        FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+      return flacenc->last_flow;
+
+    data += size;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Pushes the encoded groups at the head of the queue, waiting for them as
+ * long as more than @max_pending groups are queued */
+static GstFlowReturn
+gst_flac_enc_push_groups (GstFlacEnc * flacenc, guint max_pending)
+{
+  GstFlacEncGroup *group;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean done;
+
+  while ((group = g_queue_peek_head (flacenc->groups))) {
+    g_mutex_lock (flacenc->groups_lock);
+    while (!group->done && g_queue_get_length (flacenc->groups) > max_pending)
+      g_cond_wait (flacenc->groups_cond, flacenc->groups_lock);
+    done = group->done;
+    g_mutex_unlock (flacenc->groups_lock);
+
+    if (!done)
+      break;
+
+    g_queue_pop_head (flacenc->groups);
+    ret = gst_flac_enc_push_group (flacenc, group);
+    gst_flac_enc_group_free (group);
+
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_flac_enc_queue_samples (GstFlacEnc * flacenc, const FLAC__int32 * data,
+    guint samples)
+{
+  guint group_samples =
+      GROUP_FRAMES * FLAC__stream_encoder_get_blocksize (flacenc->encoder);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint n;
+
+  gst_flac_enc_update_md5 (flacenc, data, samples);
+
+  while (samples > 0) {
+    if (!flacenc->group)
+      flacenc->group = gst_flac_enc_group_new (flacenc);
+
+    n = MIN (samples, group_samples - flacenc->group->samples);
+    memcpy (flacenc->group->data + flacenc->group->samples * flacenc->channels,
+        data, n * flacenc->channels * sizeof (FLAC__int32));
+    flacenc->group->samples += n;
+    data += n * flacenc->channels;
+    samples -= n;
+
+    if (flacenc->group->samples == group_samples) {
+      gst_flac_enc_submit_group (flacenc);
+
+      /* keep all threads busy, but don't queue up the whole stream */
+      ret = gst_flac_enc_push_groups (flacenc,
+          2 * g_thread_pool_get_max_threads (flacenc->pool));
+      if (ret != GST_FLOW_OK)
+        break;
+    }
+  }
+
+  return ret;
+}
+
+/* Rewrites STREAMINFO and SEEKTABLE, which the main encoder wrote before it
+ * knew anything about the frames */
+static void
+gst_flac_enc_update_headers (GstFlacEnc * flacenc)
+{
+  guint8 streaminfo[34];
+  guint blocksize = FLAC__stream_encoder_get_blocksize (flacenc->encoder);
+  gsize len = 16;
+  guint64 val;
+
+  GST_WRITE_UINT16_BE (streaminfo, blocksize);
+  GST_WRITE_UINT16_BE (streaminfo + 2, blocksize);
+  streaminfo[4] = flacenc->min_framesize >> 16;
+  streaminfo[5] = flacenc->min_framesize >> 8;
+  streaminfo[6] = flacenc->min_framesize;
+  streaminfo[7] = flacenc->max_framesize >> 16;
+  streaminfo[8] = flacenc->max_framesize >> 8;
+  streaminfo[9] = flacenc->max_framesize;
+  val = ((guint64) flacenc->sample_rate << 44) |
+      ((guint64) (flacenc->channels - 1) << 41) |
+      ((guint64) (flacenc->depth - 1) << 36) |
+      (flacenc->samples_out & G_GUINT64_CONSTANT (0x0FFFFFFFFF));
+  GST_WRITE_UINT64_BE (streaminfo + 10, val);
+  g_checksum_get_digest (flacenc->md5, streaminfo + 18, &len);
+
+  /* STREAMINFO follows the "fLaC" marker and its block header */
+  if (gst_flac_enc_seek_callback (flacenc->encoder, 8, flacenc) ==
+      FLAC__STREAM_ENCODER_SEEK_STATUS_OK)
+    gst_flac_enc_write_callback (flacenc->encoder, streaminfo,
+        sizeof (streaminfo), 0, 0, flacenc);
+
+  if (flacenc->seektable && flacenc->seektable_offset > 0) {
+    FLAC__StreamMetadata_SeekTable *table =
+        &flacenc->seektable->data.seek_table;
+    guint8 *data;
+    guint i;
+
+    /* the stream ended before these */
+    for (i = flacenc->seek_point; i < table->num_points; i++) {
+      table->points[i].sample_number =
+          FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER;
+      table->points[i].stream_offset = 0;
+      table->points[i].frame_samples = 0;
+    }
+    FLAC__format_seektable_sort (table);
+
+    data = g_malloc (table->num_points * 18);
+    for (i = 0; i < table->num_points; i++) {
+      GST_WRITE_UINT64_BE (data + i * 18, table->points[i].sample_number);
+      GST_WRITE_UINT64_BE (data + i * 18 + 8, table->points[i].stream_offset);
+      GST_WRITE_UINT16_BE (data + i * 18 + 16, table->points[i].frame_samples);
+    }
+
+    if (gst_flac_enc_seek_callback (flacenc->encoder,
+            flacenc->seektable_offset + 4, flacenc) ==
+        FLAC__STREAM_ENCODER_SEEK_STATUS_OK)
+      gst_flac_enc_write_callback (flacenc->encoder, data,
+          table->num_points * 18, 0, 0, flacenc);
+
+    g_free (data);
+  }
+}
+
+static void
+gst_flac_enc_finish_groups (GstFlacEnc * flacenc)
+{
+  if (flacenc->group)
+    gst_flac_enc_submit_group (flacenc);
+
+  if (gst_flac_enc_push_groups (flacenc, 0) != GST_FLOW_OK)
+    return;
+
+  if (!flacenc->got_headers) {
+    flacenc->last_flow = gst_flac_enc_process_stream_headers (flacenc);
+    flacenc->got_headers = TRUE;
+  }
+
+  gst_flac_enc_update_headers (flacenc);
+
+  /* the main encoder has not seen any samples, so it must not write its
+   * own version of the headers */
+  flacenc->stopped = TRUE;
+  FLAC__stream_encoder_finish (flacenc->encoder);
+}
+
 static gboolean
 gst_flac_enc_sink_event (GstAudioEncoder * enc, GstEvent * event)
 {
@@ -1198,7 +1770,10 @@ gst_flac_enc_handle_frame (GstAudioEncoder * enc, GstBuffer * buffer)
 
   if (G_UNLIKELY (!buffer)) {
     if (flacenc->eos) {
-      FLAC__stream_encoder_finish (flacenc->encoder);
+      if (flacenc->pool)
+        gst_flac_enc_finish_groups (flacenc);
+      else
+        FLAC__stream_encoder_finish (flacenc->encoder);
     } else {
       /* can't handle intermittent draining/resyncing */
       GST_ELEMENT_WARNING (flacenc, STREAM, FORMAT, (NULL),
@@ -1233,6 +1808,16 @@ gst_flac_enc_handle_frame (GstAudioEncoder * enc, GstBuffer * buffer)
     g_assert_not_reached ();
   }
 
+  if (flacenc->pool) {
+    GstFlowReturn ret;
+
+    ret = gst_flac_enc_queue_samples (flacenc, data,
+        samples / flacenc->channels);
+    g_free (data);
+
+    return ret;
+  }
+
   res = FLAC__stream_encoder_process_interleaved (flacenc->encoder,
       (const FLAC__int32 *) data, samples / flacenc->channels);
 
@@ -1314,6 +1899,9 @@ gst_flac_enc_set_property (GObject * object, guint prop_id,
     case PROP_SEEKPOINTS:
       this->seekpoints = g_value_get_int (value);
       break;
+    case PROP_THREADS:
+      this->threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1390,6 +1978,9 @@ gst_flac_enc_get_property (GObject * object, guint prop_id,
     case PROP_SEEKPOINTS:
       g_value_set_int (value, this->seekpoints);
       break;
+    case PROP_THREADS:
+      g_value_set_uint (value, this->threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -36,6 +36,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstFlacEnc GstFlacEnc;
 typedef struct _GstFlacEncClass GstFlacEncClass;
+typedef struct _GstFlacEncGroup GstFlacEncGroup;
 
 struct _GstFlacEnc {
   GstAudioEncoder  element;
@@ -55,6 +56,7 @@ struct _GstFlacEnc {
   gboolean       stopped;
   guint           padding;
   gint            seekpoints;
+  guint           threads;
 
   FLAC__StreamEncoder *encoder;
 
@@ -66,6 +68,23 @@ struct _GstFlacEnc {
   /* queue headers until we have them all so we can add streamheaders to caps */
   gboolean         got_headers;
   GList           *headers;
+  /* byte offset of the SEEKTABLE block, 0 if there is none */
+  guint64          seektable_offset;
+  FLAC__StreamMetadata *seektable;
+
+  /* parallel encoding of frame groups, NULL pool in single threaded mode */
+  GThreadPool     *pool;
+  GMutex          *groups_lock;
+  GCond           *groups_cond;
+  GQueue          *groups;          /* submitted groups, in stream order */
+  GstFlacEncGroup *group;           /* group that is being filled */
+  guint64          frames_queued;
+  guint64          samples_out;
+  guint64          frames_offset;
+  guint            min_framesize;
+  guint            max_framesize;
+  guint            seek_point;
+  GChecksum       *md5;
 };
 
 struct _GstFlacEncClass {
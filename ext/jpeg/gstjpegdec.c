@@ -29,13 +29,27 @@
  * gst-launch -v v4l2src ! jpegdec ! ffmpegcolorspace ! xvimagesink
  * ]| The above pipeline reads a motion JPEG stream from a v4l2 camera
  * and renders it to the screen.
+ * |[
+ * gst-launch -v v4l2src ! image/jpeg,width=1920,height=1080 ! jpegdec threads=0 ! xvimagesink
+ * ]| The same with a high resolution camera, decoding on all CPU cores.
  * </refsect2>
+ *
+ * With the #GstJpegDec:threads property set to anything but 1, pictures are
+ * decoded by a pool of worker threads, directly into the output buffers.
+ * Pictures with restart markers are split into slices of whole MCU rows at
+ * the restart markers, and the slices are decoded in parallel. Pictures
+ * without restart markers are decoded in parallel with the following
+ * pictures and pushed in their original order. Those pictures are pushed up
+ * to one picture per thread later, which is reported as additional latency.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "gstjpegdec.h"
 #include "gstjpeg.h"
@@ -53,12 +67,14 @@
 
 #define JPEG_DEFAULT_IDCT_METHOD	JDCT_FASTEST
 #define JPEG_DEFAULT_MAX_ERRORS 	0
+#define JPEG_DEFAULT_THREADS		1
 
 enum
 {
   PROP_0,
   PROP_IDCT_METHOD,
-  PROP_MAX_ERRORS
+  PROP_MAX_ERRORS,
+  PROP_THREADS
 };
 
 /* *INDENT-OFF* */
@@ -102,6 +118,51 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_PERFORMANCE);
 
 #define I420_SIZE(w,h)     (I420_V_OFFSET(w,h)+(I420_V_ROWSTRIDE(w)*GST_ROUND_UP_2(h)/2))
 
+/* Source manager of the decoders in the worker threads. A slice of a picture
+ * is read as a copy of the picture headers with the height of the slice,
+ * followed by the entropy coded data of its restart intervals. */
+struct GstJpegDecMemSourceMgr
+{
+  struct jpeg_source_mgr pub;
+  const guint8 *chunk_data[2];
+  guint chunk_size[2];
+  guint n_chunks;
+  guint next_chunk;
+};
+
+/* a decoder of the worker threads */
+typedef struct
+{
+  struct jpeg_decompress_struct cinfo;
+  struct GstJpegDecErrorMgr jerr;
+  struct GstJpegDecMemSourceMgr jsrc;
+} GstJpegDecContext;
+
+/* a picture that is decoded by the worker threads */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  guint pending;                /* jobs not done yet, with frames_lock */
+  gchar *error_msg;             /* first decoding error, with frames_lock */
+} GstJpegDecFrame;
+
+/* the slice of a picture one worker thread decodes */
+typedef struct
+{
+  GstJpegDecFrame *frame;
+  /* the headers with the height of the slice, or NULL if the slice is the
+   * whole picture */
+  guint8 *header;
+  guint header_size;
+  const guint8 *data;
+  guint size;
+  /* the rows of the slice and the size of the picture */
+  guint y, height;
+  guint width, frame_height;
+  gint idct_method;
+} GstJpegDecJob;
+
 static GstElementClass *parent_class;   /* NULL */
 
 static void gst_jpeg_dec_base_init (gpointer g_class);
@@ -118,6 +179,7 @@ static gboolean gst_jpeg_dec_setcaps (GstPad * pad, GstCaps * caps);
 static GstCaps *gst_jpeg_dec_getcaps (GstPad * pad);
 static gboolean gst_jpeg_dec_sink_event (GstPad * pad, GstEvent * event);
 static gboolean gst_jpeg_dec_src_event (GstPad * pad, GstEvent * event);
+static gboolean gst_jpeg_dec_src_query (GstPad * pad, GstQuery * query);
 static GstStateChangeReturn gst_jpeg_dec_change_state (GstElement * element,
     GstStateChange transition);
 static void gst_jpeg_dec_update_qos (GstJpegDec * dec, gdouble proportion,
@@ -159,6 +221,10 @@ gst_jpeg_dec_finalize (GObject * object)
 
   g_object_unref (dec->adapter);
 
+  g_mutex_free (dec->frames_lock);
+  g_cond_free (dec->frames_cond);
+  g_queue_free (dec->frames);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -212,6 +278,24 @@ gst_jpeg_dec_class_init (GstJpegDecClass * klass)
           -1, G_MAXINT, JPEG_DEFAULT_MAX_ERRORS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstJpegDec:threads
+   *
+   * Number of threads for decoding pictures in parallel. 1 decodes in the
+   * streaming thread, 0 uses one thread per CPU core. Only pictures that
+   * are decoded to I420 with horizontally halved chroma are decoded in
+   * parallel, the others are still decoded in the streaming thread.
+   * Changes take effect when the element goes to PAUSED.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads for decoding pictures and slices in parallel "
+          "(0 = automatic, 1 = single threaded)", 0, G_MAXINT,
+          JPEG_DEFAULT_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_jpeg_dec_change_state);
 
@@ -420,6 +504,8 @@ gst_jpeg_dec_init (GstJpegDec * dec)
       gst_pad_new_from_static_template (&gst_jpeg_dec_src_pad_template, "src");
   gst_pad_set_event_function (dec->srcpad,
       GST_DEBUG_FUNCPTR (gst_jpeg_dec_src_event));
+  gst_pad_set_query_function (dec->srcpad,
+      GST_DEBUG_FUNCPTR (gst_jpeg_dec_src_query));
   gst_pad_use_fixed_caps (dec->srcpad);
   gst_element_add_pad (GST_ELEMENT (dec), dec->srcpad);
 
@@ -444,8 +530,13 @@ gst_jpeg_dec_init (GstJpegDec * dec)
   /* init properties */
   dec->idct_method = JPEG_DEFAULT_IDCT_METHOD;
   dec->max_errors = JPEG_DEFAULT_MAX_ERRORS;
+  dec->threads = JPEG_DEFAULT_THREADS;
 
   dec->adapter = gst_adapter_new ();
+
+  dec->frames_lock = g_mutex_new ();
+  dec->frames_cond = g_cond_new ();
+  dec->frames = g_queue_new ();
 }
 
 static gboolean
@@ -1036,8 +1127,10 @@ dump_lines (guchar * base[3], guchar ** line[3], int v_samp0, int width)
 }
 #endif
 
-static GstFlowReturn
-gst_jpeg_dec_decode_direct (GstJpegDec * dec, guchar * base[3],
+/* lets jpeglib decode directly into the output buffer, for the sampling
+ * factors checked by gst_jpeg_dec_decode_direct() */
+static void
+gst_jpeg_dec_read_direct (j_decompress_ptr cinfo, guchar * base[3],
     guchar * last[3], guint width, guint height)
 {
   guchar **line[3];             /* the jpeg line buffer         */
@@ -1051,15 +1144,9 @@ gst_jpeg_dec_decode_direct (GstJpegDec * dec, guchar * base[3],
   line[1] = u;
   line[2] = v;
 
-  v_samp[0] = dec->cinfo.comp_info[0].v_samp_factor;
-  v_samp[1] = dec->cinfo.comp_info[1].v_samp_factor;
-  v_samp[2] = dec->cinfo.comp_info[2].v_samp_factor;
-
-  if (G_UNLIKELY (v_samp[0] > 2 || v_samp[1] > 2 || v_samp[2] > 2))
-    goto format_not_supported;
-
-  /* let jpeglib decode directly into our final buffer */
-  GST_DEBUG_OBJECT (dec, "decoding directly into output buffer");
+  v_samp[0] = cinfo->comp_info[0].v_samp_factor;
+  v_samp[1] = cinfo->comp_info[1].v_samp_factor;
+  v_samp[2] = cinfo->comp_info[2].v_samp_factor;
 
   for (i = 0; i < height; i += v_samp[0] * DCTSIZE) {
     for (j = 0; j < (v_samp[0] * DCTSIZE); ++j) {
@@ -1087,11 +1174,31 @@ gst_jpeg_dec_decode_direct (GstJpegDec * dec, guchar * base[3],
 
     /* dump_lines (base, line, v_samp[0], width); */
 
-    lines = jpeg_read_raw_data (&dec->cinfo, line, v_samp[0] * DCTSIZE);
+    lines = jpeg_read_raw_data (cinfo, line, v_samp[0] * DCTSIZE);
     if (G_UNLIKELY (!lines)) {
-      GST_INFO_OBJECT (dec, "jpeg_read_raw_data() returned 0");
+      GST_INFO ("jpeg_read_raw_data() returned 0");
     }
   }
+}
+
+static GstFlowReturn
+gst_jpeg_dec_decode_direct (GstJpegDec * dec, guchar * base[3],
+    guchar * last[3], guint width, guint height)
+{
+  gint v_samp[3];
+
+  v_samp[0] = dec->cinfo.comp_info[0].v_samp_factor;
+  v_samp[1] = dec->cinfo.comp_info[1].v_samp_factor;
+  v_samp[2] = dec->cinfo.comp_info[2].v_samp_factor;
+
+  if (G_UNLIKELY (v_samp[0] > 2 || v_samp[1] > 2 || v_samp[2] > 2))
+    goto format_not_supported;
+
+  /* let jpeglib decode directly into our final buffer */
+  GST_DEBUG_OBJECT (dec, "decoding directly into output buffer");
+
+  gst_jpeg_dec_read_direct (&dec->cinfo, base, last, width, height);
+
   return GST_FLOW_OK;
 
 format_not_supported:
@@ -1205,7 +1312,7 @@ gst_jpeg_dec_negotiate (GstJpegDec * dec, gint width, gint height, gint clrspc)
   }
   GST_OBJECT_UNLOCK (dec);
 
-  if (dec->cinfo.jpeg_color_space == JCS_RGB) {
+  if (clrspc == JCS_RGB) {
     gint i;
     GstCaps *allowed_caps;
 
@@ -1256,7 +1363,7 @@ gst_jpeg_dec_negotiate (GstJpegDec * dec, gint width, gint height, gint clrspc)
     /* equal for all components */
     dec->stride = gst_video_format_get_row_stride (format, 0, width);
     dec->inc = gst_video_format_get_pixel_stride (format, 0);
-  } else if (dec->cinfo.jpeg_color_space == JCS_GRAYSCALE) {
+  } else if (clrspc == JCS_GRAYSCALE) {
     /* TODO is anything else then 8bit supported in jpeg? */
     format = GST_VIDEO_FORMAT_GRAY8;
     caps = gst_video_format_new_caps (format, width, height,
@@ -1290,6 +1397,650 @@ gst_jpeg_dec_negotiate (GstJpegDec * dec, gint width, gint height, gint clrspc)
   dec->caps_framerate_denominator = dec->framerate_denominator;
 }
 
+static void
+gst_jpeg_dec_set_timestamp (GstJpegDec * dec, GstBuffer * outbuf,
+    GstClockTime duration)
+{
+  GST_BUFFER_TIMESTAMP (outbuf) = dec->next_ts;
+
+  if (dec->packetized && GST_CLOCK_TIME_IS_VALID (dec->next_ts)) {
+    if (GST_CLOCK_TIME_IS_VALID (duration)) {
+      /* use duration from incoming buffer for outgoing buffer */
+      dec->next_ts += duration;
+    } else if (dec->framerate_numerator != 0) {
+      duration = gst_util_uint64_scale (GST_SECOND,
+          dec->framerate_denominator, dec->framerate_numerator);
+      dec->next_ts += duration;
+    } else {
+      duration = GST_CLOCK_TIME_NONE;
+      dec->next_ts = GST_CLOCK_TIME_NONE;
+    }
+  } else {
+    duration = GST_CLOCK_TIME_NONE;
+    dec->next_ts = GST_CLOCK_TIME_NONE;
+  }
+  GST_BUFFER_DURATION (outbuf) = duration;
+}
+
+static GstFlowReturn
+gst_jpeg_dec_clip_and_push (GstJpegDec * dec, GstBuffer * outbuf)
+{
+  /* Clipping */
+  if (dec->segment.format == GST_FORMAT_TIME) {
+    gint64 start, stop, clip_start, clip_stop;
+
+    GST_LOG_OBJECT (dec, "Attempting clipping");
+
+    start = GST_BUFFER_TIMESTAMP (outbuf);
+    if (GST_BUFFER_DURATION (outbuf) == GST_CLOCK_TIME_NONE)
+      stop = start;
+    else
+      stop = start + GST_BUFFER_DURATION (outbuf);
+
+    if (gst_segment_clip (&dec->segment, GST_FORMAT_TIME,
+            start, stop, &clip_start, &clip_stop)) {
+      GST_LOG_OBJECT (dec, "Clipping start to %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (clip_start));
+      GST_BUFFER_TIMESTAMP (outbuf) = clip_start;
+      if (GST_BUFFER_DURATION (outbuf) != GST_CLOCK_TIME_NONE) {
+        GST_LOG_OBJECT (dec, "Clipping duration to %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (clip_stop - clip_start));
+        GST_BUFFER_DURATION (outbuf) = clip_stop - clip_start;
+      }
+    } else {
+      GST_WARNING_OBJECT (dec, "Outgoing buffer is outside configured segment");
+      gst_buffer_unref (outbuf);
+      return GST_FLOW_OK;
+    }
+  }
+
+  /* reset error count on successful decode */
+  dec->error_count = 0;
+
+  ++dec->good_count;
+
+  GST_LOG_OBJECT (dec, "pushing buffer (ts=%" GST_TIME_FORMAT ", dur=%"
+      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (outbuf)),
+      GST_TIME_ARGS (GST_BUFFER_DURATION (outbuf)));
+
+  return gst_pad_push (dec->srcpad, outbuf);
+}
+
+static void
+gst_jpeg_dec_mem_init_source (j_decompress_ptr cinfo)
+{
+}
+
+static boolean
+gst_jpeg_dec_mem_fill_input_buffer (j_decompress_ptr cinfo)
+{
+  struct GstJpegDecMemSourceMgr *src =
+      (struct GstJpegDecMemSourceMgr *) cinfo->src;
+  static const JOCTET eoi[2] = { 0xff, JPEG_EOI };
+
+  if (src->next_chunk < src->n_chunks) {
+    src->pub.next_input_byte = src->chunk_data[src->next_chunk];
+    src->pub.bytes_in_buffer = src->chunk_size[src->next_chunk];
+    src->next_chunk++;
+  } else {
+    /* out of data, insert an EOI marker like the stdio source manager */
+    src->pub.next_input_byte = eoi;
+    src->pub.bytes_in_buffer = 2;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_jpeg_dec_mem_skip_input_data (j_decompress_ptr cinfo, glong num_bytes)
+{
+  struct jpeg_source_mgr *src = cinfo->src;
+
+  if (num_bytes <= 0)
+    return;
+
+  while (num_bytes > (glong) src->bytes_in_buffer) {
+    num_bytes -= src->bytes_in_buffer;
+    gst_jpeg_dec_mem_fill_input_buffer (cinfo);
+  }
+  src->next_input_byte += (size_t) num_bytes;
+  src->bytes_in_buffer -= (size_t) num_bytes;
+}
+
+static boolean
+gst_jpeg_dec_mem_resync_to_restart (j_decompress_ptr cinfo, gint desired)
+{
+  /* slices start in the middle of the sequence of restart markers, so
+   * accept whatever restart marker comes next */
+  if (cinfo->unread_marker >= 0xd0 && cinfo->unread_marker <= 0xd7) {
+    cinfo->unread_marker = 0;
+    return TRUE;
+  }
+
+  return jpeg_resync_to_restart (cinfo, desired);
+}
+
+static void
+gst_jpeg_dec_mem_term_source (j_decompress_ptr cinfo)
+{
+}
+
+static void
+gst_jpeg_dec_set_mem_source (GstJpegDecContext * ctx, const guint8 * header,
+    guint header_size, const guint8 * data, guint size)
+{
+  struct GstJpegDecMemSourceMgr *src = &ctx->jsrc;
+
+  src->n_chunks = 0;
+  if (header) {
+    src->chunk_data[src->n_chunks] = header;
+    src->chunk_size[src->n_chunks] = header_size;
+    src->n_chunks++;
+  }
+  src->chunk_data[src->n_chunks] = data;
+  src->chunk_size[src->n_chunks] = size;
+  src->n_chunks++;
+
+  src->next_chunk = 0;
+  src->pub.next_input_byte = NULL;
+  src->pub.bytes_in_buffer = 0;
+}
+
+static GstJpegDecContext *
+gst_jpeg_dec_get_context (GstJpegDec * dec)
+{
+  GstJpegDecContext *ctx = NULL;
+
+  g_mutex_lock (dec->frames_lock);
+  if (dec->contexts) {
+    ctx = dec->contexts->data;
+    dec->contexts = g_slist_delete_link (dec->contexts, dec->contexts);
+  }
+  g_mutex_unlock (dec->frames_lock);
+
+  if (ctx)
+    return ctx;
+
+  ctx = g_new0 (GstJpegDecContext, 1);
+  ctx->cinfo.err = jpeg_std_error (&ctx->jerr.pub);
+  ctx->jerr.pub.output_message = gst_jpeg_dec_my_output_message;
+  ctx->jerr.pub.emit_message = gst_jpeg_dec_my_emit_message;
+  ctx->jerr.pub.error_exit = gst_jpeg_dec_my_error_exit;
+
+  jpeg_create_decompress (&ctx->cinfo);
+
+  ctx->cinfo.src = (struct jpeg_source_mgr *) &ctx->jsrc;
+  ctx->cinfo.src->init_source = gst_jpeg_dec_mem_init_source;
+  ctx->cinfo.src->fill_input_buffer = gst_jpeg_dec_mem_fill_input_buffer;
+  ctx->cinfo.src->skip_input_data = gst_jpeg_dec_mem_skip_input_data;
+  ctx->cinfo.src->resync_to_restart = gst_jpeg_dec_mem_resync_to_restart;
+  ctx->cinfo.src->term_source = gst_jpeg_dec_mem_term_source;
+
+  return ctx;
+}
+
+static void
+gst_jpeg_dec_free_context (GstJpegDecContext * ctx)
+{
+  jpeg_destroy_decompress (&ctx->cinfo);
+  g_free (ctx);
+}
+
+static void
+gst_jpeg_dec_free_frame (GstJpegDecFrame * frame)
+{
+  gst_buffer_unref (frame->inbuf);
+  if (frame->outbuf)
+    gst_buffer_unref (frame->outbuf);
+  g_free (frame->error_msg);
+  g_free (frame);
+}
+
+/* runs in the thread pool */
+static void
+gst_jpeg_dec_decode_job (GstJpegDecJob * job, GstJpegDec * dec)
+{
+  GstJpegDecFrame *frame = job->frame;
+  GstJpegDecContext *ctx;
+  guchar *outdata, *base[3], *last[3];
+  guint width = job->width, height = job->frame_height;
+  gchar *error_msg = NULL;
+
+  ctx = gst_jpeg_dec_get_context (dec);
+
+  if (setjmp (ctx->jerr.setjmp_buffer)) {
+    gchar err_msg[JMSG_LENGTH_MAX];
+
+    ctx->jerr.pub.format_message ((j_common_ptr) (&ctx->cinfo), err_msg);
+    error_msg = g_strdup_printf ("Decode error #%u in rows %u-%u: %s",
+        ctx->jerr.pub.msg_code, job->y, job->y + job->height - 1, err_msg);
+    jpeg_abort_decompress (&ctx->cinfo);
+    goto done;
+  }
+
+  gst_jpeg_dec_set_mem_source (ctx, job->header, job->header_size,
+      job->data, job->size);
+  jpeg_read_header (&ctx->cinfo, TRUE);
+
+  /* prepare for raw output */
+  ctx->cinfo.do_fancy_upsampling = FALSE;
+  ctx->cinfo.do_block_smoothing = FALSE;
+  ctx->cinfo.out_color_space = ctx->cinfo.jpeg_color_space;
+  ctx->cinfo.dct_method = job->idct_method;
+  ctx->cinfo.raw_data_out = TRUE;
+
+  guarantee_huff_tables (&ctx->cinfo);
+  jpeg_start_decompress (&ctx->cinfo);
+
+  outdata = GST_BUFFER_DATA (frame->outbuf);
+  base[0] = outdata + I420_Y_OFFSET (width, height) +
+      job->y * I420_Y_ROWSTRIDE (width);
+  base[1] = outdata + I420_U_OFFSET (width, height) +
+      (job->y / 2) * I420_U_ROWSTRIDE (width);
+  base[2] = outdata + I420_V_OFFSET (width, height) +
+      (job->y / 2) * I420_V_ROWSTRIDE (width);
+
+  /* the last rows of the picture, the slices above it end on MCU rows */
+  last[0] = outdata + I420_Y_OFFSET (width, height) +
+      I420_Y_ROWSTRIDE (width) * (height - 1);
+  last[1] = outdata + I420_U_OFFSET (width, height) +
+      I420_U_ROWSTRIDE (width) * ((GST_ROUND_UP_2 (height) / 2) - 1);
+  last[2] = outdata + I420_V_OFFSET (width, height) +
+      I420_V_ROWSTRIDE (width) * ((GST_ROUND_UP_2 (height) / 2) - 1);
+
+  gst_jpeg_dec_read_direct (&ctx->cinfo, base, last, width, job->height);
+
+  jpeg_finish_decompress (&ctx->cinfo);
+
+done:
+  g_mutex_lock (dec->frames_lock);
+  dec->contexts = g_slist_prepend (dec->contexts, ctx);
+  if (error_msg && frame->error_msg == NULL) {
+    frame->error_msg = error_msg;
+    error_msg = NULL;
+  }
+  frame->pending--;
+  g_cond_broadcast (dec->frames_cond);
+  g_mutex_unlock (dec->frames_lock);
+
+  g_free (error_msg);
+  g_free (job->header);
+  g_free (job);
+}
+
+static GstFlowReturn
+gst_jpeg_dec_finish_frame (GstJpegDec * dec, GstJpegDecFrame * frame)
+{
+  GstBuffer *outbuf;
+
+  if (G_UNLIKELY (frame->error_msg)) {
+    gst_jpeg_dec_set_error (dec, GST_FUNCTION, __LINE__, "%s",
+        frame->error_msg);
+    return gst_jpeg_dec_post_error_or_warning (dec);
+  }
+
+  outbuf = frame->outbuf;
+  frame->outbuf = NULL;
+
+  return gst_jpeg_dec_clip_and_push (dec, outbuf);
+}
+
+/* Pushes the decoded frames at the head of the queue, and waits for the
+ * worker threads until at most @max_frames frames are left. Frames that are
+ * done after a flow error are dropped. */
+static GstFlowReturn
+gst_jpeg_dec_push_frames (GstJpegDec * dec, guint max_frames)
+{
+  GstJpegDecFrame *frame;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_mutex_lock (dec->frames_lock);
+  while ((frame = g_queue_peek_head (dec->frames))) {
+    if (frame->pending > 0) {
+      if (g_queue_get_length (dec->frames) <= max_frames)
+        break;
+      g_cond_wait (dec->frames_cond, dec->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (dec->frames);
+    g_mutex_unlock (dec->frames_lock);
+
+    if (ret == GST_FLOW_OK)
+      ret = gst_jpeg_dec_finish_frame (dec, frame);
+    gst_jpeg_dec_free_frame (frame);
+
+    g_mutex_lock (dec->frames_lock);
+  }
+  g_mutex_unlock (dec->frames_lock);
+
+  return ret;
+}
+
+/* waits for the worker threads and drops all frames */
+static void
+gst_jpeg_dec_discard_frames (GstJpegDec * dec)
+{
+  GstJpegDecFrame *frame;
+
+  g_mutex_lock (dec->frames_lock);
+  while ((frame = g_queue_peek_head (dec->frames))) {
+    if (frame->pending > 0) {
+      g_cond_wait (dec->frames_cond, dec->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (dec->frames);
+    gst_jpeg_dec_free_frame (frame);
+  }
+  g_mutex_unlock (dec->frames_lock);
+}
+
+/* Finds the offsets of the SOF marker and of the end of the SOS marker
+ * segment, where the entropy coded data starts */
+static gboolean
+gst_jpeg_dec_find_markers (const guint8 * data, guint size, guint * sof,
+    guint * sos_end)
+{
+  guint offset = 2;
+  guint8 marker;
+
+  *sof = 0;
+
+  while (offset + 4 <= size) {
+    if (data[offset] != 0xff)
+      return FALSE;
+
+    marker = data[offset + 1];
+    if (marker == 0xff) {
+      /* fill byte */
+      offset++;
+      continue;
+    }
+
+    if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 &&
+        marker != 0xc8 && marker != 0xcc)
+      *sof = offset;
+
+    if (marker == 0xda) {
+      *sos_end = offset + 2 + GST_READ_UINT16_BE (data + offset + 2);
+      return (*sof != 0 && *sos_end <= size);
+    }
+
+    offset += 2 + GST_READ_UINT16_BE (data + offset + 2);
+  }
+
+  return FALSE;
+}
+
+/* Collects the offsets of the restart markers in the entropy coded data
+ * starting at @offset. Returns FALSE if the data does not end with an EOI
+ * marker after them, e.g. because there is more than one scan */
+static gboolean
+gst_jpeg_dec_find_restart_markers (const guint8 * data, guint size,
+    guint offset, GArray * markers)
+{
+  const guint8 *p;
+  guint8 marker;
+
+  while (offset + 1 < size) {
+    p = memchr (data + offset, 0xff, size - offset - 1);
+    if (p == NULL)
+      return FALSE;
+
+    offset = p - data;
+    marker = data[offset + 1];
+    if (marker == 0xff) {
+      /* fill byte */
+      offset++;
+    } else if (marker == 0x00) {
+      /* stuffed 0xff in the entropy coded data */
+      offset += 2;
+    } else if (marker >= 0xd0 && marker <= 0xd7) {
+      g_array_append_val (markers, offset);
+      offset += 2;
+    } else {
+      return (marker == 0xd9);
+    }
+  }
+
+  return FALSE;
+}
+
+/* Reads the headers of the picture in @data and checks if the workers can
+ * decode it directly into I420 in a single scan */
+static gboolean
+gst_jpeg_dec_read_parallel_header (GstJpegDecContext * ctx,
+    const guint8 * data, guint size, guint * width, guint * height,
+    guint * mcu_width, guint * mcu_height, guint * restart_interval)
+{
+  j_decompress_ptr cinfo = &ctx->cinfo;
+  jpeg_component_info *comp;
+  gboolean ret = FALSE;
+
+  if (setjmp (ctx->jerr.setjmp_buffer)) {
+    jpeg_abort_decompress (cinfo);
+    return FALSE;
+  }
+
+  gst_jpeg_dec_set_mem_source (ctx, NULL, 0, data, size);
+  if (jpeg_read_header (cinfo, TRUE) != JPEG_HEADER_OK)
+    goto done;
+
+  comp = cinfo->comp_info;
+  if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3 ||
+      cinfo->comps_in_scan != 3 || cinfo->progressive_mode ||
+      cinfo->data_precision != 8)
+    goto done;
+
+  /* what gst_jpeg_dec_chain() decodes with gst_jpeg_dec_decode_direct() */
+  if (comp[0].h_samp_factor != 2 || comp[1].h_samp_factor != 1 ||
+      comp[2].h_samp_factor != 1 || comp[0].v_samp_factor > 2 ||
+      comp[1].v_samp_factor > comp[0].v_samp_factor ||
+      comp[2].v_samp_factor != comp[1].v_samp_factor)
+    goto done;
+
+  if (cinfo->image_width < MIN_WIDTH || cinfo->image_width > MAX_WIDTH ||
+      cinfo->image_height < MIN_HEIGHT || cinfo->image_height > MAX_HEIGHT ||
+      cinfo->image_width % (cinfo->max_h_samp_factor * DCTSIZE) != 0)
+    goto done;
+
+  *width = cinfo->image_width;
+  *height = cinfo->image_height;
+  *mcu_width = cinfo->max_h_samp_factor * DCTSIZE;
+  *mcu_height = cinfo->max_v_samp_factor * DCTSIZE;
+  *restart_interval = cinfo->restart_interval;
+  ret = TRUE;
+
+done:
+  jpeg_abort_decompress (cinfo);
+  return ret;
+}
+
+/* Decodes the picture of @img_len bytes at the start of the adapter in the
+ * thread pool, split into slices at restart markers if it has any, and
+ * pushes the frames that are done. Returns FALSE if the picture has to be
+ * decoded by the streaming thread, after pushing all earlier frames. */
+static gboolean
+gst_jpeg_dec_decode_parallel (GstJpegDec * dec, guint img_len,
+    GstClockTime duration, GstFlowReturn * ret)
+{
+  GstJpegDecContext *ctx;
+  GstJpegDecFrame *frame;
+  GstBuffer *outbuf = NULL;
+  GArray *markers = NULL;
+  const guint8 *data;
+  guint sof, sos_end, width, height, mcu_width, mcu_height, restart_interval;
+  guint mcus_per_row = 0, mcu_rows, slice_rows, n_slices, i;
+  gboolean ok;
+
+  data = gst_adapter_peek (dec->adapter, img_len);
+  if (!gst_jpeg_dec_find_markers (data, img_len, &sof, &sos_end))
+    goto not_supported;
+
+  ctx = gst_jpeg_dec_get_context (dec);
+  ok = gst_jpeg_dec_read_parallel_header (ctx, data, img_len, &width, &height,
+      &mcu_width, &mcu_height, &restart_interval);
+  g_mutex_lock (dec->frames_lock);
+  dec->contexts = g_slist_prepend (dec->contexts, ctx);
+  g_mutex_unlock (dec->frames_lock);
+  if (!ok)
+    goto not_supported;
+
+  /* slices are whole MCU rows that start after a restart marker */
+  n_slices = 1;
+  slice_rows = mcu_rows = (height + mcu_height - 1) / mcu_height;
+  if (restart_interval > 0 && dec->n_threads > 1) {
+    guint row_step, n_intervals;
+
+    mcus_per_row = width / mcu_width;
+    row_step = restart_interval /
+        gst_util_greatest_common_divisor (restart_interval, mcus_per_row);
+    n_intervals = (mcus_per_row * mcu_rows + restart_interval - 1) /
+        restart_interval;
+
+    markers = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_intervals);
+    if (row_step < mcu_rows &&
+        gst_jpeg_dec_find_restart_markers (data, img_len, sos_end, markers) &&
+        markers->len == n_intervals - 1) {
+      slice_rows = (mcu_rows + dec->n_threads - 1) / dec->n_threads;
+      slice_rows = ((slice_rows + row_step - 1) / row_step) * row_step;
+      n_slices = (mcu_rows + slice_rows - 1) / slice_rows;
+    } else if (markers->len > 0) {
+      GST_DEBUG_OBJECT (dec, "can't split picture with %u restart markers, "
+          "restart interval %u", markers->len, restart_interval);
+    }
+  }
+
+  gst_jpeg_dec_negotiate (dec, width, height, JCS_YCbCr);
+
+  *ret = gst_pad_alloc_buffer_and_set_caps (dec->srcpad,
+      GST_BUFFER_OFFSET_NONE, dec->outsize, GST_PAD_CAPS (dec->srcpad),
+      &outbuf);
+  if (G_UNLIKELY (*ret != GST_FLOW_OK))
+    goto alloc_failed;
+
+  gst_jpeg_dec_set_timestamp (dec, outbuf, duration);
+
+  GST_LOG_OBJECT (dec, "decoding %ux%u picture in %u slices of %u rows",
+      width, height, n_slices, slice_rows * mcu_height);
+
+  frame = g_new0 (GstJpegDecFrame, 1);
+  frame->inbuf = gst_adapter_take_buffer (dec->adapter, img_len);
+  frame->outbuf = outbuf;
+  frame->pending = n_slices;
+  dec->rem_img_len = 0;
+  data = GST_BUFFER_DATA (frame->inbuf);
+
+  g_mutex_lock (dec->frames_lock);
+  g_queue_push_tail (dec->frames, frame);
+  g_mutex_unlock (dec->frames_lock);
+
+  for (i = 0; i < n_slices; i++) {
+    GstJpegDecJob *job = g_new0 (GstJpegDecJob, 1);
+    guint row = i * slice_rows;
+    guint start, end;
+
+    job->frame = frame;
+    job->y = row * mcu_height;
+    job->width = width;
+    job->frame_height = height;
+    job->idct_method = dec->idct_method;
+
+    if (n_slices == 1) {
+      job->height = height;
+      job->data = data;
+      job->size = img_len;
+    } else {
+      if (i == n_slices - 1) {
+        job->height = height - job->y;
+        end = img_len;
+      } else {
+        job->height = slice_rows * mcu_height;
+        end = g_array_index (markers, guint,
+            (row + slice_rows) * mcus_per_row / restart_interval - 1);
+      }
+      if (row == 0)
+        start = sos_end;
+      else
+        start = g_array_index (markers, guint,
+            row * mcus_per_row / restart_interval - 1) + 2;
+
+      job->header = g_memdup (data, sos_end);
+      job->header_size = sos_end;
+      GST_WRITE_UINT16_BE (job->header + sof + 5, job->height);
+      job->data = data + start;
+      job->size = end - start;
+    }
+
+    g_thread_pool_push (dec->pool, job, NULL);
+  }
+
+  if (markers)
+    g_array_free (markers, TRUE);
+
+  *ret = gst_jpeg_dec_push_frames (dec, dec->n_threads);
+  return TRUE;
+
+not_supported:
+  {
+    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, dec,
+        "picture can't be decoded in parallel");
+    *ret = gst_jpeg_dec_push_frames (dec, 0);
+    return FALSE;
+  }
+alloc_failed:
+  {
+    const gchar *reason;
+
+    if (markers)
+      g_array_free (markers, TRUE);
+
+    reason = gst_flow_get_name (*ret);
+
+    GST_DEBUG_OBJECT (dec, "failed to alloc buffer, reason %s", reason);
+    if (*ret != GST_FLOW_UNEXPECTED && *ret != GST_FLOW_WRONG_STATE &&
+        *ret != GST_FLOW_NOT_LINKED) {
+      gst_jpeg_dec_set_error (dec, GST_FUNCTION, __LINE__,
+          "Buffer allocation failed, reason: %s", reason);
+      if (*ret == GST_FLOW_ERROR)
+        *ret = gst_jpeg_dec_post_error_or_warning (dec);
+    }
+    return TRUE;
+  }
+}
+
+static void
+gst_jpeg_dec_start_pool (GstJpegDec * dec)
+{
+  guint threads = dec->threads;
+
+  if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#else
+    threads = 1;
+#endif
+  }
+
+  GST_DEBUG_OBJECT (dec, "decoding with %u threads", threads);
+
+  dec->n_threads = threads;
+  dec->pool = g_thread_pool_new ((GFunc) gst_jpeg_dec_decode_job, dec,
+      threads, FALSE, NULL);
+}
+
+static void
+gst_jpeg_dec_stop_pool (GstJpegDec * dec)
+{
+  gst_jpeg_dec_discard_frames (dec);
+
+  g_thread_pool_free (dec->pool, FALSE, TRUE);
+  dec->pool = NULL;
+
+  g_slist_foreach (dec->contexts, (GFunc) gst_jpeg_dec_free_context, NULL);
+  g_slist_free (dec->contexts);
+  dec->contexts = NULL;
+}
+
 static GstFlowReturn
 gst_jpeg_dec_chain (GstPad * pad, GstBuffer * buf)
 {
@@ -1377,6 +2128,15 @@ again:
       data[2], data[3]);
 #endif
 
+  /* errors of the worker threads are posted when their frames are pushed */
+  if (dec->pool) {
+    if (gst_jpeg_dec_decode_parallel (dec, img_len, duration, &ret) ||
+        ret != GST_FLOW_OK) {
+      gst_adapter_flush (dec->adapter, dec->rem_img_len);
+      return ret;
+    }
+  }
+
   gst_jpeg_dec_fill_input_buffer (&dec->cinfo);
 
   if (setjmp (dec->jerr.setjmp_buffer)) {
@@ -1485,25 +2245,7 @@ again:
   GST_LOG_OBJECT (dec, "width %d, height %d, buffer size %d, required size %d",
       width, height, outsize, dec->outsize);
 
-  GST_BUFFER_TIMESTAMP (outbuf) = dec->next_ts;
-
-  if (dec->packetized && GST_CLOCK_TIME_IS_VALID (dec->next_ts)) {
-    if (GST_CLOCK_TIME_IS_VALID (duration)) {
-      /* use duration from incoming buffer for outgoing buffer */
-      dec->next_ts += duration;
-    } else if (dec->framerate_numerator != 0) {
-      duration = gst_util_uint64_scale (GST_SECOND,
-          dec->framerate_denominator, dec->framerate_numerator);
-      dec->next_ts += duration;
-    } else {
-      duration = GST_CLOCK_TIME_NONE;
-      dec->next_ts = GST_CLOCK_TIME_NONE;
-    }
-  } else {
-    duration = GST_CLOCK_TIME_NONE;
-    dec->next_ts = GST_CLOCK_TIME_NONE;
-  }
-  GST_BUFFER_DURATION (outbuf) = duration;
+  gst_jpeg_dec_set_timestamp (dec, outbuf, duration);
 
   if (dec->cinfo.jpeg_color_space == JCS_RGB) {
     base[0] = outdata + dec->offset[0];
@@ -1559,42 +2301,7 @@ again:
   GST_LOG_OBJECT (dec, "decompressing finished");
   jpeg_finish_decompress (&dec->cinfo);
 
-  /* Clipping */
-  if (dec->segment.format == GST_FORMAT_TIME) {
-    gint64 start, stop, clip_start, clip_stop;
-
-    GST_LOG_OBJECT (dec, "Attempting clipping");
-
-    start = GST_BUFFER_TIMESTAMP (outbuf);
-    if (GST_BUFFER_DURATION (outbuf) == GST_CLOCK_TIME_NONE)
-      stop = start;
-    else
-      stop = start + GST_BUFFER_DURATION (outbuf);
-
-    if (gst_segment_clip (&dec->segment, GST_FORMAT_TIME,
-            start, stop, &clip_start, &clip_stop)) {
-      GST_LOG_OBJECT (dec, "Clipping start to %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (clip_start));
-      GST_BUFFER_TIMESTAMP (outbuf) = clip_start;
-      if (GST_BUFFER_DURATION (outbuf) != GST_CLOCK_TIME_NONE) {
-        GST_LOG_OBJECT (dec, "Clipping duration to %" GST_TIME_FORMAT,
-            GST_TIME_ARGS (clip_stop - clip_start));
-        GST_BUFFER_DURATION (outbuf) = clip_stop - clip_start;
-      }
-    } else
-      goto drop_buffer;
-  }
-
-  /* reset error count on successful decode */
-  dec->error_count = 0;
-
-  ++dec->good_count;
-
-  GST_LOG_OBJECT (dec, "pushing buffer (ts=%" GST_TIME_FORMAT ", dur=%"
-      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (outbuf)),
-      GST_TIME_ARGS (GST_BUFFER_DURATION (outbuf)));
-
-  ret = gst_pad_push (dec->srcpad, outbuf);
+  ret = gst_jpeg_dec_clip_and_push (dec, outbuf);
 
 skip_decoding:
 done:
@@ -1667,13 +2374,6 @@ alloc_failed:
     }
     goto exit;
   }
-drop_buffer:
-  {
-    GST_WARNING_OBJECT (dec, "Outgoing buffer is outside configured segment");
-    gst_buffer_unref (outbuf);
-    ret = GST_FLOW_OK;
-    goto exit;
-  }
 components_not_supported:
   {
     gst_jpeg_dec_set_error (dec, GST_FUNCTION, __LINE__,
@@ -1698,6 +2398,40 @@ invalid_yuvrgbgrayscale:
   }
 }
 
+static gboolean
+gst_jpeg_dec_src_query (GstPad * pad, GstQuery * query)
+{
+  GstJpegDec *dec = GST_JPEG_DEC (gst_pad_get_parent (pad));
+  gboolean res;
+
+  res = gst_pad_query_default (pad, query);
+
+  /* pictures decoded in parallel can be pushed up to one picture per thread
+   * after the next ones came in */
+  if (res && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY && dec->pool &&
+      dec->framerate_numerator > 0 && dec->framerate_denominator > 0) {
+    GstClockTime min, max, latency;
+    gboolean live;
+
+    gst_query_parse_latency (query, &live, &min, &max);
+
+    latency = gst_util_uint64_scale (dec->n_threads,
+        dec->framerate_denominator * GST_SECOND, dec->framerate_numerator);
+    GST_DEBUG_OBJECT (dec, "adding latency %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (latency));
+
+    min += latency;
+    if (max != GST_CLOCK_TIME_NONE)
+      max += latency;
+
+    gst_query_set_latency (query, live, min, max);
+  }
+
+  gst_object_unref (dec);
+
+  return res;
+}
+
 static gboolean
 gst_jpeg_dec_src_event (GstPad * pad, GstEvent * event)
 {
@@ -1738,6 +2472,14 @@ gst_jpeg_dec_sink_event (GstPad * pad, GstEvent * event)
 
   GST_DEBUG_OBJECT (dec, "event : %s", GST_EVENT_TYPE_NAME (event));
 
+  /* keep the decoded frames in order with the serialized events */
+  if (dec->pool) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_jpeg_dec_discard_frames (dec);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_jpeg_dec_push_frames (dec, 0);
+  }
+
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_STOP:
       GST_DEBUG_OBJECT (dec, "Aborting decompress");
@@ -1794,6 +2536,9 @@ gst_jpeg_dec_set_property (GObject * object, guint prop_id,
     case PROP_MAX_ERRORS:
       g_atomic_int_set (&dec->max_errors, g_value_get_int (value));
       break;
+    case PROP_THREADS:
+      dec->threads = g_value_get_uint (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1816,6 +2561,9 @@ gst_jpeg_dec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_MAX_ERRORS:
       g_value_set_int (value, g_atomic_int_get (&dec->max_errors));
       break;
+    case PROP_THREADS:
+      g_value_set_uint (value, dec->threads);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1850,6 +2598,8 @@ gst_jpeg_dec_change_state (GstElement * element, GstStateChange transition)
       dec->cur_buf = NULL;
       gst_segment_init (&dec->segment, GST_FORMAT_UNDEFINED);
       gst_jpeg_dec_reset_qos (dec);
+      if (dec->threads != 1 && dec->pool == NULL)
+        gst_jpeg_dec_start_pool (dec);
     default:
       break;
   }
@@ -1864,6 +2614,8 @@ gst_jpeg_dec_change_state (GstElement * element, GstStateChange transition)
       g_free (dec->cur_buf);
       dec->cur_buf = NULL;
       gst_jpeg_dec_free_buffers (dec);
+      if (dec->pool)
+        gst_jpeg_dec_stop_pool (dec);
       break;
     default:
       break;
@@ -114,6 +114,15 @@ struct _GstJpegDec {
   /* properties */
   gint     idct_method;
   gint     max_errors;  /* ATOMIC */
+  guint    threads;
+
+  /* parallel decoding, see gst_jpeg_dec_decode_parallel() */
+  guint         n_threads;
+  GThreadPool  *pool;
+  GMutex       *frames_lock;
+  GCond        *frames_cond;
+  GQueue       *frames;       /* GstJpegDecFrame in output order */
+  GSList       *contexts;     /* idle GstJpegDecContext, with frames_lock */
 
   /* current error (the message is the debug message) */
   gchar       *error_msg;
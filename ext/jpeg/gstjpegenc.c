@@ -27,13 +27,26 @@
  * gst-launch videotestsrc num-buffers=50 ! video/x-raw-yuv, framerate='(fraction)'5/1 ! jpegenc ! avimux ! filesink location=mjpeg.avi
  * ]| a pipeline to mux 5 JPEG frames per second into a 10 sec. long motion jpeg
  * avi.
+ * |[
+ * gst-launch v4l2src ! video/x-raw-yuv,width=1920,height=1080 ! jpegenc threads=0 ! multipartmux ! tcpserversink
+ * ]| a pipeline to stream motion jpeg from a camera, encoding on all CPU
+ * cores.
  * </refsect2>
+ *
+ * With the #GstJpegEnc:threads property set to anything but 1, frames are
+ * encoded in parallel by a pool of worker threads, each with its own
+ * encoder, and pushed in their original order. At most
+ * #GstJpegEnc:max-frames-in-flight frames are queued in the element at any
+ * time, which is also reported as additional latency.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "gstjpegenc.h"
 #include "gstjpeg.h"
@@ -50,6 +63,34 @@ GST_DEBUG_CATEGORY_STATIC (jpegenc_debug);
 #define JPEG_DEFAULT_QUALITY 85
 #define JPEG_DEFAULT_SMOOTHING 0
 #define JPEG_DEFAULT_IDCT_METHOD	JDCT_FASTEST
+#define JPEG_DEFAULT_RESTART_INTERVAL 0
+#define JPEG_DEFAULT_THREADS 1
+#define JPEG_DEFAULT_MAX_FRAMES_IN_FLIGHT 0
+
+/* an encoder of the worker threads, set up for the negotiated format */
+typedef struct
+{
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  struct jpeg_destination_mgr jdest;
+  guchar **line[3];
+  guchar *row[3][4 * DCTSIZE];
+  GstBuffer *output_buffer;
+} GstJpegEncContext;
+
+/* a frame that is encoded by the worker threads */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  gboolean done;                /* with frames_lock */
+
+  /* the settings when the frame was queued */
+  gint quality;
+  gint smoothing;
+  gint idct_method;
+  gint restart_interval;
+} GstJpegEncFrame;
 
 /* JpegEnc signals and args */
 enum
@@ -64,7 +105,10 @@ enum
   PROP_0,
   PROP_QUALITY,
   PROP_SMOOTHING,
-  PROP_IDCT_METHOD
+  PROP_IDCT_METHOD,
+  PROP_RESTART_INTERVAL,
+  PROP_THREADS,
+  PROP_MAX_FRAMES_IN_FLIGHT
 };
 
 static void gst_jpegenc_reset (GstJpegEnc * enc);
@@ -76,8 +120,14 @@ static void gst_jpegenc_finalize (GObject * object);
 static GstFlowReturn gst_jpegenc_chain (GstPad * pad, GstBuffer * buf);
 static gboolean gst_jpegenc_setcaps (GstPad * pad, GstCaps * caps);
 static GstCaps *gst_jpegenc_getcaps (GstPad * pad);
+static gboolean gst_jpegenc_sink_event (GstPad * pad, GstEvent * event);
+static gboolean gst_jpegenc_src_query (GstPad * pad, GstQuery * query);
 
 static void gst_jpegenc_resync (GstJpegEnc * jpegenc);
+static GstFlowReturn gst_jpegenc_push_frames (GstJpegEnc * jpegenc,
+    guint max_frames);
+static void gst_jpegenc_discard_frames (GstJpegEnc * jpegenc);
+static void gst_jpegenc_free_contexts (GstJpegEnc * jpegenc);
 static void gst_jpegenc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_jpegenc_get_property (GObject * object, guint prop_id,
@@ -190,6 +240,56 @@ gst_jpegenc_class_init (GstJpegEnc * klass)
           JPEG_DEFAULT_IDCT_METHOD,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstJpegEnc:restart-interval
+   *
+   * Number of MCUs between restart markers, 0 for no restart markers.
+   * Restart markers make the images more robust against transmission
+   * errors and allow decoders to decode parts of the image in parallel.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_RESTART_INTERVAL,
+      g_param_spec_int ("restart-interval", "Restart Interval",
+          "Number of MCUs between restart markers (0 = no restart markers)",
+          0, 65535, JPEG_DEFAULT_RESTART_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstJpegEnc:threads
+   *
+   * Number of threads for encoding frames in parallel. 1 encodes in the
+   * streaming thread, 0 uses one thread per CPU core. Changes take effect
+   * when the element goes to PAUSED.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads for encoding frames in parallel "
+          "(0 = automatic, 1 = single threaded)", 0, G_MAXINT,
+          JPEG_DEFAULT_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstJpegEnc:max-frames-in-flight
+   *
+   * Maximum number of frames that are encoded or wait to be pushed at the
+   * same time when encoding in parallel, 0 for twice the number of threads.
+   * Frames can be held back for this number of frames minus one, which is
+   * added to the latency. Changes take effect when the element goes to
+   * PAUSED.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, PROP_MAX_FRAMES_IN_FLIGHT,
+      g_param_spec_uint ("max-frames-in-flight", "Max Frames In Flight",
+          "Maximum number of frames encoded in parallel "
+          "(0 = twice the number of threads)", 0, G_MAXINT,
+          JPEG_DEFAULT_MAX_FRAMES_IN_FLIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   gstelement_class->change_state = gst_jpegenc_change_state;
 
   gobject_class->finalize = gst_jpegenc_finalize;
@@ -262,6 +362,48 @@ gst_jpegenc_term_destination (j_compress_ptr cinfo)
   jpegenc->output_buffer = NULL;
 }
 
+/* Destination manager of the encoders in the worker threads, the frames are
+ * pushed from the streaming thread once they are done */
+static void
+gst_jpegenc_mem_init_destination (j_compress_ptr cinfo)
+{
+}
+
+static boolean
+gst_jpegenc_mem_flush_destination (j_compress_ptr cinfo)
+{
+  GstJpegEncContext *ctx = (GstJpegEncContext *) (cinfo->client_data);
+  GstBuffer *overflow_buffer;
+  guint32 old_buffer_size;
+
+  /* can't allocate from the peer outside of the streaming thread, so just
+   * make a new buffer that's twice the size */
+  old_buffer_size = GST_BUFFER_SIZE (ctx->output_buffer);
+  overflow_buffer = gst_buffer_new_and_alloc (old_buffer_size * 2);
+  memcpy (GST_BUFFER_DATA (overflow_buffer),
+      GST_BUFFER_DATA (ctx->output_buffer), old_buffer_size);
+  gst_buffer_copy_metadata (overflow_buffer, ctx->output_buffer,
+      GST_BUFFER_COPY_TIMESTAMPS | GST_BUFFER_COPY_CAPS);
+
+  gst_buffer_unref (ctx->output_buffer);
+  ctx->output_buffer = overflow_buffer;
+
+  ctx->jdest.next_output_byte =
+      GST_BUFFER_DATA (ctx->output_buffer) + old_buffer_size;
+  ctx->jdest.free_in_buffer =
+      GST_BUFFER_SIZE (ctx->output_buffer) - old_buffer_size;
+
+  return TRUE;
+}
+
+static void
+gst_jpegenc_mem_term_destination (j_compress_ptr cinfo)
+{
+  GstJpegEncContext *ctx = (GstJpegEncContext *) (cinfo->client_data);
+
+  GST_BUFFER_SIZE (ctx->output_buffer) -= ctx->jdest.free_in_buffer;
+}
+
 static void
 gst_jpegenc_init (GstJpegEnc * jpegenc)
 {
@@ -274,10 +416,14 @@ gst_jpegenc_init (GstJpegEnc * jpegenc)
       GST_DEBUG_FUNCPTR (gst_jpegenc_getcaps));
   gst_pad_set_setcaps_function (jpegenc->sinkpad,
       GST_DEBUG_FUNCPTR (gst_jpegenc_setcaps));
+  gst_pad_set_event_function (jpegenc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_jpegenc_sink_event));
   gst_element_add_pad (GST_ELEMENT (jpegenc), jpegenc->sinkpad);
 
   jpegenc->srcpad =
       gst_pad_new_from_static_template (&gst_jpegenc_src_pad_template, "src");
+  gst_pad_set_query_function (jpegenc->srcpad,
+      GST_DEBUG_FUNCPTR (gst_jpegenc_src_query));
   gst_pad_use_fixed_caps (jpegenc->srcpad);
   gst_element_add_pad (GST_ELEMENT (jpegenc), jpegenc->srcpad);
 
@@ -301,27 +447,36 @@ gst_jpegenc_init (GstJpegEnc * jpegenc)
   jpegenc->quality = JPEG_DEFAULT_QUALITY;
   jpegenc->smoothing = JPEG_DEFAULT_SMOOTHING;
   jpegenc->idct_method = JPEG_DEFAULT_IDCT_METHOD;
+  jpegenc->restart_interval = JPEG_DEFAULT_RESTART_INTERVAL;
+  jpegenc->threads = JPEG_DEFAULT_THREADS;
+  jpegenc->max_frames_in_flight = JPEG_DEFAULT_MAX_FRAMES_IN_FLIGHT;
+
+  jpegenc->frames_lock = g_mutex_new ();
+  jpegenc->frames_cond = g_cond_new ();
+  jpegenc->frames = g_queue_new ();
 
   gst_jpegenc_reset (jpegenc);
 }
 
 static void
-gst_jpegenc_reset (GstJpegEnc * enc)
+gst_jpegenc_free_lines (guchar ** line[3], guchar * row[3][4 * DCTSIZE])
 {
   gint i, j;
 
-  g_free (enc->line[0]);
-  g_free (enc->line[1]);
-  g_free (enc->line[2]);
-  enc->line[0] = NULL;
-  enc->line[1] = NULL;
-  enc->line[2] = NULL;
   for (i = 0; i < 3; i++) {
+    g_free (line[i]);
+    line[i] = NULL;
     for (j = 0; j < 4 * DCTSIZE; j++) {
-      g_free (enc->row[i][j]);
-      enc->row[i][j] = NULL;
+      g_free (row[i][j]);
+      row[i][j] = NULL;
     }
   }
+}
+
+static void
+gst_jpegenc_reset (GstJpegEnc * enc)
+{
+  gst_jpegenc_free_lines (enc->line, enc->row);
 
   enc->width = -1;
   enc->height = -1;
@@ -337,6 +492,10 @@ gst_jpegenc_finalize (GObject * object)
 
   jpeg_destroy_compress (&filter->cinfo);
 
+  g_mutex_free (filter->frames_lock);
+  g_cond_free (filter->frames_cond);
+  g_queue_free (filter->frames);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -414,6 +573,13 @@ gst_jpegenc_setcaps (GstPad * pad, GstCaps * caps)
       && par_num == enc->par_num && par_den == enc->par_den)
     return TRUE;
 
+  /* the queued frames are pushed with the old caps, and the encoders of the
+   * worker threads are set up again for the new format */
+  if (enc->pool) {
+    gst_jpegenc_push_frames (enc, 0);
+    gst_jpegenc_free_contexts (enc);
+  }
+
   /* store input description */
   enc->format = format;
   enc->width = width;
@@ -485,39 +651,32 @@ refuse_caps:
   }
 }
 
+/* sets up @cinfo for raw input in the negotiated format */
 static void
-gst_jpegenc_resync (GstJpegEnc * jpegenc)
+gst_jpegenc_setup_compress (GstJpegEnc * jpegenc, j_compress_ptr cinfo)
 {
-  gint width, height;
-  gint i, j;
-
-  GST_DEBUG_OBJECT (jpegenc, "resync");
-
-  jpegenc->cinfo.image_width = width = jpegenc->width;
-  jpegenc->cinfo.image_height = height = jpegenc->height;
-  jpegenc->cinfo.input_components = jpegenc->channels;
+  gint i;
 
-  GST_DEBUG_OBJECT (jpegenc, "width %d, height %d", width, height);
-  GST_DEBUG_OBJECT (jpegenc, "format %d", jpegenc->format);
+  cinfo->image_width = jpegenc->width;
+  cinfo->image_height = jpegenc->height;
+  cinfo->input_components = jpegenc->channels;
 
   if (gst_video_format_is_rgb (jpegenc->format)) {
     GST_DEBUG_OBJECT (jpegenc, "RGB");
-    jpegenc->cinfo.in_color_space = JCS_RGB;
+    cinfo->in_color_space = JCS_RGB;
   } else if (gst_video_format_is_gray (jpegenc->format)) {
     GST_DEBUG_OBJECT (jpegenc, "gray");
-    jpegenc->cinfo.in_color_space = JCS_GRAYSCALE;
+    cinfo->in_color_space = JCS_GRAYSCALE;
   } else {
     GST_DEBUG_OBJECT (jpegenc, "YUV");
-    jpegenc->cinfo.in_color_space = JCS_YCbCr;
+    cinfo->in_color_space = JCS_YCbCr;
   }
 
-  /* input buffer size as max output */
-  jpegenc->bufsize = gst_video_format_get_size (jpegenc->format, width, height);
-  jpeg_set_defaults (&jpegenc->cinfo);
-  jpegenc->cinfo.raw_data_in = TRUE;
+  jpeg_set_defaults (cinfo);
+  cinfo->raw_data_in = TRUE;
   /* duh, libjpeg maps RGB to YUV ... and don't expect some conversion */
-  if (jpegenc->cinfo.in_color_space == JCS_RGB)
-    jpeg_set_colorspace (&jpegenc->cinfo, JCS_RGB);
+  if (cinfo->in_color_space == JCS_RGB)
+    jpeg_set_colorspace (cinfo, JCS_RGB);
 
   GST_DEBUG_OBJECT (jpegenc, "h_max_samp=%d, v_max_samp=%d",
       jpegenc->h_max_samp, jpegenc->v_max_samp);
@@ -525,28 +684,298 @@ gst_jpegenc_resync (GstJpegEnc * jpegenc)
   for (i = 0; i < jpegenc->channels; i++) {
     GST_DEBUG_OBJECT (jpegenc, "comp %i: h_samp=%d, v_samp=%d", i,
         jpegenc->h_samp[i], jpegenc->v_samp[i]);
-    jpegenc->cinfo.comp_info[i].h_samp_factor = jpegenc->h_samp[i];
-    jpegenc->cinfo.comp_info[i].v_samp_factor = jpegenc->v_samp[i];
-    g_free (jpegenc->line[i]);
-    jpegenc->line[i] = g_new (guchar *, jpegenc->v_max_samp * DCTSIZE);
+    cinfo->comp_info[i].h_samp_factor = jpegenc->h_samp[i];
+    cinfo->comp_info[i].v_samp_factor = jpegenc->v_samp[i];
+  }
+
+  jpeg_suppress_tables (cinfo, TRUE);
+}
+
+/* allocates the jpeg line buffers, and for packed formats the rows they
+ * point to */
+static void
+gst_jpegenc_alloc_lines (GstJpegEnc * jpegenc, guchar ** line[3],
+    guchar * row[3][4 * DCTSIZE])
+{
+  gint i, j;
+
+  for (i = 0; i < jpegenc->channels; i++) {
+    g_free (line[i]);
+    line[i] = g_new (guchar *, jpegenc->v_max_samp * DCTSIZE);
     if (!jpegenc->planar) {
       for (j = 0; j < jpegenc->v_max_samp * DCTSIZE; j++) {
-        g_free (jpegenc->row[i][j]);
-        jpegenc->row[i][j] = g_malloc (width);
-        jpegenc->line[i][j] = jpegenc->row[i][j];
+        g_free (row[i][j]);
+        row[i][j] = g_malloc (jpegenc->width);
+        line[i][j] = row[i][j];
       }
     }
   }
+}
+
+static void
+gst_jpegenc_resync (GstJpegEnc * jpegenc)
+{
+  gint width, height;
+
+  GST_DEBUG_OBJECT (jpegenc, "resync");
+
+  width = jpegenc->width;
+  height = jpegenc->height;
 
+  GST_DEBUG_OBJECT (jpegenc, "width %d, height %d", width, height);
+  GST_DEBUG_OBJECT (jpegenc, "format %d", jpegenc->format);
+
+  /* input buffer size as max output */
+  jpegenc->bufsize = gst_video_format_get_size (jpegenc->format, width, height);
   /* guard against a potential error in gst_jpegenc_term_destination
      which occurs iff bufsize % 4 < free_space_remaining */
   jpegenc->bufsize = GST_ROUND_UP_4 (jpegenc->bufsize);
 
-  jpeg_suppress_tables (&jpegenc->cinfo, TRUE);
+  gst_jpegenc_setup_compress (jpegenc, &jpegenc->cinfo);
+  gst_jpegenc_alloc_lines (jpegenc, jpegenc->line, jpegenc->row);
 
   GST_DEBUG_OBJECT (jpegenc, "resync done");
 }
 
+/* feeds the picture in @data to @cinfo, after jpeg_start_compress() */
+static void
+gst_jpegenc_write_image (GstJpegEnc * jpegenc, j_compress_ptr cinfo,
+    guchar ** line[3], guchar * data)
+{
+  guint height;
+  guchar *base[3], *end[3];
+  gint i, j, k;
+
+  height = jpegenc->height;
+
+  for (i = 0; i < jpegenc->channels; i++) {
+    base[i] = data + jpegenc->offset[i];
+    end[i] = base[i] + jpegenc->cheight[i] * jpegenc->stride[i];
+  }
+
+  if (jpegenc->planar) {
+    for (i = 0; i < height; i += jpegenc->v_max_samp * DCTSIZE) {
+      for (k = 0; k < jpegenc->channels; k++) {
+        for (j = 0; j < jpegenc->v_samp[k] * DCTSIZE; j++) {
+          line[k][j] = base[k];
+          if (base[k] + jpegenc->stride[k] < end[k])
+            base[k] += jpegenc->stride[k];
+        }
+      }
+      jpeg_write_raw_data (cinfo, line, jpegenc->v_max_samp * DCTSIZE);
+    }
+  } else {
+    for (i = 0; i < height; i += jpegenc->v_max_samp * DCTSIZE) {
+      for (k = 0; k < jpegenc->channels; k++) {
+        for (j = 0; j < jpegenc->v_samp[k] * DCTSIZE; j++) {
+          guchar *src, *dst;
+          gint l;
+
+          /* ouch, copy line */
+          src = base[k];
+          dst = line[k][j];
+          for (l = jpegenc->cwidth[k]; l > 0; l--) {
+            *dst = *src;
+            src += jpegenc->inc[k];
+            dst++;
+          }
+          if (base[k] + jpegenc->stride[k] < end[k])
+            base[k] += jpegenc->stride[k];
+        }
+      }
+      jpeg_write_raw_data (cinfo, line, jpegenc->v_max_samp * DCTSIZE);
+    }
+  }
+}
+
+static GstJpegEncContext *
+gst_jpegenc_get_context (GstJpegEnc * jpegenc)
+{
+  GstJpegEncContext *ctx = NULL;
+
+  g_mutex_lock (jpegenc->frames_lock);
+  if (jpegenc->contexts) {
+    ctx = jpegenc->contexts->data;
+    jpegenc->contexts = g_slist_delete_link (jpegenc->contexts,
+        jpegenc->contexts);
+  }
+  g_mutex_unlock (jpegenc->frames_lock);
+
+  if (ctx)
+    return ctx;
+
+  /* the format can't change while frames are encoded, see
+   * gst_jpegenc_setcaps() */
+  ctx = g_new0 (GstJpegEncContext, 1);
+  ctx->cinfo.err = jpeg_std_error (&ctx->jerr);
+  jpeg_create_compress (&ctx->cinfo);
+
+  ctx->jdest.init_destination = gst_jpegenc_mem_init_destination;
+  ctx->jdest.empty_output_buffer = gst_jpegenc_mem_flush_destination;
+  ctx->jdest.term_destination = gst_jpegenc_mem_term_destination;
+  ctx->cinfo.dest = &ctx->jdest;
+  ctx->cinfo.client_data = ctx;
+
+  gst_jpegenc_setup_compress (jpegenc, &ctx->cinfo);
+  gst_jpegenc_alloc_lines (jpegenc, ctx->line, ctx->row);
+
+  return ctx;
+}
+
+static void
+gst_jpegenc_free_context (GstJpegEncContext * ctx)
+{
+  jpeg_destroy_compress (&ctx->cinfo);
+  gst_jpegenc_free_lines (ctx->line, ctx->row);
+  g_free (ctx);
+}
+
+/* frees the idle encoders, must only be called when no frames are queued */
+static void
+gst_jpegenc_free_contexts (GstJpegEnc * jpegenc)
+{
+  g_slist_foreach (jpegenc->contexts, (GFunc) gst_jpegenc_free_context, NULL);
+  g_slist_free (jpegenc->contexts);
+  jpegenc->contexts = NULL;
+}
+
+static void
+gst_jpegenc_free_frame (GstJpegEncFrame * frame)
+{
+  gst_buffer_unref (frame->inbuf);
+  if (frame->outbuf)
+    gst_buffer_unref (frame->outbuf);
+  g_free (frame);
+}
+
+/* runs in the thread pool */
+static void
+gst_jpegenc_encode_job (GstJpegEncFrame * frame, GstJpegEnc * jpegenc)
+{
+  GstJpegEncContext *ctx;
+
+  ctx = gst_jpegenc_get_context (jpegenc);
+
+  ctx->output_buffer = frame->outbuf;
+  ctx->jdest.next_output_byte = GST_BUFFER_DATA (ctx->output_buffer);
+  ctx->jdest.free_in_buffer = GST_BUFFER_SIZE (ctx->output_buffer);
+
+  /* prepare for raw input */
+#if JPEG_LIB_VERSION >= 70
+  ctx->cinfo.do_fancy_downsampling = FALSE;
+#endif
+  ctx->cinfo.smoothing_factor = frame->smoothing;
+  ctx->cinfo.dct_method = frame->idct_method;
+  ctx->cinfo.restart_interval = frame->restart_interval;
+  jpeg_set_quality (&ctx->cinfo, frame->quality, TRUE);
+  jpeg_start_compress (&ctx->cinfo, TRUE);
+
+  gst_jpegenc_write_image (jpegenc, &ctx->cinfo, ctx->line,
+      GST_BUFFER_DATA (frame->inbuf));
+
+  jpeg_finish_compress (&ctx->cinfo);
+
+  g_mutex_lock (jpegenc->frames_lock);
+  frame->outbuf = ctx->output_buffer;
+  ctx->output_buffer = NULL;
+  jpegenc->contexts = g_slist_prepend (jpegenc->contexts, ctx);
+  frame->done = TRUE;
+  g_cond_broadcast (jpegenc->frames_cond);
+  g_mutex_unlock (jpegenc->frames_lock);
+}
+
+/* Pushes the encoded frames at the head of the queue, and waits for the
+ * worker threads until at most @max_frames frames are left. Frames that are
+ * done after a flow error are dropped. */
+static GstFlowReturn
+gst_jpegenc_push_frames (GstJpegEnc * jpegenc, guint max_frames)
+{
+  GstJpegEncFrame *frame;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_mutex_lock (jpegenc->frames_lock);
+  while ((frame = g_queue_peek_head (jpegenc->frames))) {
+    if (!frame->done) {
+      if (g_queue_get_length (jpegenc->frames) <= max_frames)
+        break;
+      g_cond_wait (jpegenc->frames_cond, jpegenc->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (jpegenc->frames);
+    g_mutex_unlock (jpegenc->frames_lock);
+
+    if (ret == GST_FLOW_OK) {
+      g_signal_emit (G_OBJECT (jpegenc), gst_jpegenc_signals[FRAME_ENCODED],
+          0);
+      ret = gst_pad_push (jpegenc->srcpad, frame->outbuf);
+      frame->outbuf = NULL;
+    }
+    gst_jpegenc_free_frame (frame);
+
+    g_mutex_lock (jpegenc->frames_lock);
+  }
+  g_mutex_unlock (jpegenc->frames_lock);
+
+  return ret;
+}
+
+/* waits for the worker threads and drops all frames */
+static void
+gst_jpegenc_discard_frames (GstJpegEnc * jpegenc)
+{
+  GstJpegEncFrame *frame;
+
+  g_mutex_lock (jpegenc->frames_lock);
+  while ((frame = g_queue_peek_head (jpegenc->frames))) {
+    if (!frame->done) {
+      g_cond_wait (jpegenc->frames_cond, jpegenc->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (jpegenc->frames);
+    gst_jpegenc_free_frame (frame);
+  }
+  g_mutex_unlock (jpegenc->frames_lock);
+}
+
+/* Queues @buf for encoding by the thread pool into an output buffer that is
+ * allocated here, and pushes the frames before it that are done. Waits for
+ * the worker threads while more than max-frames-in-flight frames are
+ * queued. */
+static GstFlowReturn
+gst_jpegenc_encode_parallel (GstJpegEnc * jpegenc, GstBuffer * buf)
+{
+  GstJpegEncFrame *frame;
+  GstFlowReturn ret;
+
+  frame = g_new0 (GstJpegEncFrame, 1);
+  frame->inbuf = buf;
+
+  ret = gst_pad_alloc_buffer_and_set_caps (jpegenc->srcpad,
+      GST_BUFFER_OFFSET_NONE, jpegenc->bufsize, GST_PAD_CAPS (jpegenc->srcpad),
+      &frame->outbuf);
+  if (ret != GST_FLOW_OK) {
+    gst_jpegenc_free_frame (frame);
+    return ret;
+  }
+
+  gst_buffer_copy_metadata (frame->outbuf, buf, GST_BUFFER_COPY_TIMESTAMPS);
+
+  GST_OBJECT_LOCK (jpegenc);
+  frame->quality = jpegenc->quality;
+  frame->smoothing = jpegenc->smoothing;
+  frame->idct_method = jpegenc->idct_method;
+  frame->restart_interval = jpegenc->restart_interval;
+  GST_OBJECT_UNLOCK (jpegenc);
+
+  g_mutex_lock (jpegenc->frames_lock);
+  g_queue_push_tail (jpegenc->frames, frame);
+  g_mutex_unlock (jpegenc->frames_lock);
+
+  g_thread_pool_push (jpegenc->pool, frame, NULL);
+
+  return gst_jpegenc_push_frames (jpegenc, jpegenc->n_frames - 1);
+}
+
 static GstFlowReturn
 gst_jpegenc_chain (GstPad * pad, GstBuffer * buf)
 {
@@ -554,9 +983,6 @@ gst_jpegenc_chain (GstPad * pad, GstBuffer * buf)
   GstJpegEnc *jpegenc;
   guchar *data;
   gulong size;
-  guint height;
-  guchar *base[3], *end[3];
-  gint i, j, k;
 
   jpegenc = GST_JPEGENC (GST_OBJECT_PARENT (pad));
 
@@ -568,6 +994,9 @@ gst_jpegenc_chain (GstPad * pad, GstBuffer * buf)
 
   GST_LOG_OBJECT (jpegenc, "got buffer of %lu bytes", size);
 
+  if (jpegenc->pool)
+    return gst_jpegenc_encode_parallel (jpegenc, buf);
+
   ret =
       gst_pad_alloc_buffer_and_set_caps (jpegenc->srcpad,
       GST_BUFFER_OFFSET_NONE, jpegenc->bufsize, GST_PAD_CAPS (jpegenc->srcpad),
@@ -579,13 +1008,6 @@ gst_jpegenc_chain (GstPad * pad, GstBuffer * buf)
   gst_buffer_copy_metadata (jpegenc->output_buffer, buf,
       GST_BUFFER_COPY_TIMESTAMPS);
 
-  height = jpegenc->height;
-
-  for (i = 0; i < jpegenc->channels; i++) {
-    base[i] = data + jpegenc->offset[i];
-    end[i] = base[i] + jpegenc->cheight[i] * jpegenc->stride[i];
-  }
-
   jpegenc->jdest.next_output_byte = GST_BUFFER_DATA (jpegenc->output_buffer);
   jpegenc->jdest.free_in_buffer = GST_BUFFER_SIZE (jpegenc->output_buffer);
 
@@ -595,46 +1017,13 @@ gst_jpegenc_chain (GstPad * pad, GstBuffer * buf)
 #endif
   jpegenc->cinfo.smoothing_factor = jpegenc->smoothing;
   jpegenc->cinfo.dct_method = jpegenc->idct_method;
+  jpegenc->cinfo.restart_interval = jpegenc->restart_interval;
   jpeg_set_quality (&jpegenc->cinfo, jpegenc->quality, TRUE);
   jpeg_start_compress (&jpegenc->cinfo, TRUE);
 
   GST_LOG_OBJECT (jpegenc, "compressing");
 
-  if (jpegenc->planar) {
-    for (i = 0; i < height; i += jpegenc->v_max_samp * DCTSIZE) {
-      for (k = 0; k < jpegenc->channels; k++) {
-        for (j = 0; j < jpegenc->v_samp[k] * DCTSIZE; j++) {
-          jpegenc->line[k][j] = base[k];
-          if (base[k] + jpegenc->stride[k] < end[k])
-            base[k] += jpegenc->stride[k];
-        }
-      }
-      jpeg_write_raw_data (&jpegenc->cinfo, jpegenc->line,
-          jpegenc->v_max_samp * DCTSIZE);
-    }
-  } else {
-    for (i = 0; i < height; i += jpegenc->v_max_samp * DCTSIZE) {
-      for (k = 0; k < jpegenc->channels; k++) {
-        for (j = 0; j < jpegenc->v_samp[k] * DCTSIZE; j++) {
-          guchar *src, *dst;
-          gint l;
-
-          /* ouch, copy line */
-          src = base[k];
-          dst = jpegenc->line[k][j];
-          for (l = jpegenc->cwidth[k]; l > 0; l--) {
-            *dst = *src;
-            src += jpegenc->inc[k];
-            dst++;
-          }
-          if (base[k] + jpegenc->stride[k] < end[k])
-            base[k] += jpegenc->stride[k];
-        }
-      }
-      jpeg_write_raw_data (&jpegenc->cinfo, jpegenc->line,
-          jpegenc->v_max_samp * DCTSIZE);
-    }
-  }
+  gst_jpegenc_write_image (jpegenc, &jpegenc->cinfo, jpegenc->line, data);
 
   /* This will ensure that gst_jpegenc_term_destination is called; we push
      the final output buffer from there */
@@ -655,6 +1044,92 @@ not_negotiated:
   }
 }
 
+static gboolean
+gst_jpegenc_sink_event (GstPad * pad, GstEvent * event)
+{
+  GstJpegEnc *jpegenc = GST_JPEGENC (GST_OBJECT_PARENT (pad));
+
+  /* keep the encoded frames in order with the serialized events */
+  if (jpegenc->pool) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_jpegenc_discard_frames (jpegenc);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_jpegenc_push_frames (jpegenc, 0);
+  }
+
+  return gst_pad_event_default (pad, event);
+}
+
+static gboolean
+gst_jpegenc_src_query (GstPad * pad, GstQuery * query)
+{
+  GstJpegEnc *jpegenc = GST_JPEGENC (gst_pad_get_parent (pad));
+  gboolean res;
+
+  res = gst_pad_query_default (pad, query);
+
+  /* frames in flight can be pushed up to max-frames-in-flight - 1 frames
+   * after the next ones came in */
+  if (res && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY && jpegenc->pool &&
+      jpegenc->fps_num > 0 && jpegenc->fps_den > 0) {
+    GstClockTime min, max, latency;
+    gboolean live;
+
+    gst_query_parse_latency (query, &live, &min, &max);
+
+    latency = gst_util_uint64_scale (jpegenc->n_frames - 1,
+        jpegenc->fps_den * GST_SECOND, jpegenc->fps_num);
+    GST_DEBUG_OBJECT (jpegenc, "adding latency %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (latency));
+
+    min += latency;
+    if (max != GST_CLOCK_TIME_NONE)
+      max += latency;
+
+    gst_query_set_latency (query, live, min, max);
+  }
+
+  gst_object_unref (jpegenc);
+
+  return res;
+}
+
+static void
+gst_jpegenc_start_pool (GstJpegEnc * jpegenc)
+{
+  guint threads = jpegenc->threads;
+
+  if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#else
+    threads = 1;
+#endif
+  }
+
+  jpegenc->n_threads = threads;
+  jpegenc->n_frames = jpegenc->max_frames_in_flight;
+  if (jpegenc->n_frames == 0)
+    jpegenc->n_frames = 2 * threads;
+
+  GST_DEBUG_OBJECT (jpegenc, "encoding with %u threads, %u frames in flight",
+      jpegenc->n_threads, jpegenc->n_frames);
+
+  jpegenc->pool = g_thread_pool_new ((GFunc) gst_jpegenc_encode_job, jpegenc,
+      threads, FALSE, NULL);
+}
+
+static void
+gst_jpegenc_stop_pool (GstJpegEnc * jpegenc)
+{
+  gst_jpegenc_discard_frames (jpegenc);
+
+  g_thread_pool_free (jpegenc->pool, FALSE, TRUE);
+  jpegenc->pool = NULL;
+
+  gst_jpegenc_free_contexts (jpegenc);
+}
+
 static void
 gst_jpegenc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -675,6 +1150,15 @@ gst_jpegenc_set_property (GObject * object, guint prop_id,
     case PROP_IDCT_METHOD:
       jpegenc->idct_method = g_value_get_enum (value);
       break;
+    case PROP_RESTART_INTERVAL:
+      jpegenc->restart_interval = g_value_get_int (value);
+      break;
+    case PROP_THREADS:
+      jpegenc->threads = g_value_get_uint (value);
+      break;
+    case PROP_MAX_FRAMES_IN_FLIGHT:
+      jpegenc->max_frames_in_flight = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -703,6 +1187,15 @@ gst_jpegenc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_IDCT_METHOD:
       g_value_set_enum (value, jpegenc->idct_method);
       break;
+    case PROP_RESTART_INTERVAL:
+      g_value_set_int (value, jpegenc->restart_interval);
+      break;
+    case PROP_THREADS:
+      g_value_set_uint (value, jpegenc->threads);
+      break;
+    case PROP_MAX_FRAMES_IN_FLIGHT:
+      g_value_set_uint (value, jpegenc->max_frames_in_flight);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -724,6 +1217,10 @@ gst_jpegenc_change_state (GstElement * element, GstStateChange transition)
       filter->line[1] = NULL;
       filter->line[2] = NULL;
       break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (filter->threads != 1 && filter->pool == NULL)
+        gst_jpegenc_start_pool (filter);
+      break;
     default:
       break;
   }
@@ -734,6 +1231,8 @@ gst_jpegenc_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (filter->pool)
+        gst_jpegenc_stop_pool (filter);
       gst_jpegenc_reset (filter);
       break;
     default:
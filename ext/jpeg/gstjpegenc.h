@@ -88,6 +88,18 @@ struct _GstJpegEnc
   gint quality;
   gint smoothing;
   gint idct_method;
+  gint restart_interval;
+  guint threads;
+  guint max_frames_in_flight;
+
+  /* parallel encoding, see gst_jpegenc_encode_parallel() */
+  guint n_threads;
+  guint n_frames;
+  GThreadPool *pool;
+  GMutex *frames_lock;
+  GCond *frames_cond;
+  GQueue *frames;               /* GstJpegEncFrame in input order */
+  GSList *contexts;             /* idle GstJpegEncContext, with frames_lock */
 
   /* cached return state for any problems that may occur in callbacks */
   GstFlowReturn last_ret;
@@ -25,6 +25,9 @@
 #include "config.h"
 #endif
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include <gst/gst.h>
 #include "gstpngenc.h"
 #include <gst/video/video.h>
@@ -43,15 +46,37 @@ enum
 #define DEFAULT_SNAPSHOT                TRUE
 /* #define DEFAULT_NEWMEDIA             FALSE */
 #define DEFAULT_COMPRESSION_LEVEL       6
+#define DEFAULT_THREADS                 1
+#define DEFAULT_MAX_FRAMES_IN_FLIGHT    0
 
 enum
 {
   ARG_0,
   ARG_SNAPSHOT,
 /*   ARG_NEWMEDIA, */
-  ARG_COMPRESSION_LEVEL
+  ARG_COMPRESSION_LEVEL,
+  ARG_THREADS,
+  ARG_MAX_FRAMES_IN_FLIGHT
 };
 
+/* a frame to encode, in the streaming thread or in the thread pool */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;            /* the encoded image */
+  guint compression_level;
+
+  /* the output buffer while encoding */
+  GstBuffer *buffer_out;
+  guint written;
+
+  /* error, GST_LIBRARY_ERROR_INIT or GST_LIBRARY_ERROR_FAILED */
+  GstLibraryError error;
+  const gchar *error_msg;
+
+  gboolean done;                /* with frames_lock */
+} GstPngEncFrame;
+
 static GstStaticPadTemplate pngenc_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
@@ -79,6 +104,13 @@ static void gst_pngenc_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec);
 
 static GstFlowReturn gst_pngenc_chain (GstPad * pad, GstBuffer * data);
+static gboolean gst_pngenc_sink_event (GstPad * pad, GstEvent * event);
+static gboolean gst_pngenc_src_query (GstPad * pad, GstQuery * query);
+static GstStateChangeReturn gst_pngenc_change_state (GstElement * element,
+    GstStateChange transition);
+static void gst_pngenc_finalize (GObject * object);
+static GstFlowReturn gst_pngenc_push_frames (GstPngEnc * pngenc,
+    guint max_frames);
 
 static void
 user_error_fn (png_structp png_ptr, png_const_charp error_msg)
@@ -111,13 +143,16 @@ static void
 gst_pngenc_class_init (GstPngEncClass * klass)
 {
   GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
 
   gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
 
   parent_class = g_type_class_peek_parent (klass);
 
   gobject_class->get_property = gst_pngenc_get_property;
   gobject_class->set_property = gst_pngenc_set_property;
+  gobject_class->finalize = gst_pngenc_finalize;
 
   g_object_class_install_property (gobject_class, ARG_SNAPSHOT,
       g_param_spec_boolean ("snapshot", "Snapshot",
@@ -136,6 +171,42 @@ gst_pngenc_class_init (GstPngEncClass * klass)
           DEFAULT_COMPRESSION_LEVEL,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstPngEnc:threads
+   *
+   * Number of threads for encoding frames in parallel. 1 encodes in the
+   * streaming thread, 0 uses one thread per CPU core. Frames are only
+   * encoded in parallel when #GstPngEnc:snapshot is disabled. Changes take
+   * effect when the element goes to PAUSED.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, ARG_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads for encoding frames in parallel "
+          "(0 = automatic, 1 = single threaded)", 0, G_MAXINT,
+          DEFAULT_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstPngEnc:max-frames-in-flight
+   *
+   * Maximum number of frames that are encoded or wait to be pushed at the
+   * same time when encoding in parallel, 0 for twice the number of threads.
+   * Changes take effect when the element goes to PAUSED.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gobject_class, ARG_MAX_FRAMES_IN_FLIGHT,
+      g_param_spec_uint ("max-frames-in-flight", "Max Frames In Flight",
+          "Maximum number of frames encoded in parallel "
+          "(0 = twice the number of threads)", 0, G_MAXINT,
+          DEFAULT_MAX_FRAMES_IN_FLIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gstelement_class->change_state = gst_pngenc_change_state;
+
   GST_DEBUG_CATEGORY_INIT (pngenc_debug, "pngenc", 0, "PNG image encoder");
 }
 
@@ -151,6 +222,10 @@ gst_pngenc_setcaps (GstPad * pad, GstCaps * caps)
 
   pngenc = GST_PNGENC (gst_pad_get_parent (pad));
 
+  /* the queued frames are encoded with the old format */
+  if (pngenc->pool)
+    gst_pngenc_push_frames (pngenc, 0);
+
   ret = gst_video_format_parse_caps (caps, &format,
       &pngenc->width, &pngenc->height);
   if (G_LIKELY (ret))
@@ -181,6 +256,8 @@ gst_pngenc_setcaps (GstPad * pad, GstCaps * caps)
   }
 
   pngenc->stride = gst_video_format_get_row_stride (format, 0, pngenc->width);
+  pngenc->fps_n = fps_n;
+  pngenc->fps_d = fps_d;
 
   pcaps = gst_caps_new_simple ("image/png",
       "width", G_TYPE_INT, pngenc->width,
@@ -213,6 +290,7 @@ gst_pngenc_init (GstPngEnc * pngenc, GstPngEncClass * g_class)
   /*   gst_pad_set_link_function (pngenc->sinkpad, gst_pngenc_sinklink); */
   /*   gst_pad_set_getcaps_function (pngenc->sinkpad, gst_pngenc_sink_getcaps); */
   gst_pad_set_setcaps_function (pngenc->sinkpad, gst_pngenc_setcaps);
+  gst_pad_set_event_function (pngenc->sinkpad, gst_pngenc_sink_event);
   gst_element_add_pad (GST_ELEMENT (pngenc), pngenc->sinkpad);
 
   /* srcpad */
@@ -221,15 +299,32 @@ gst_pngenc_init (GstPngEnc * pngenc, GstPngEncClass * g_class)
   /*   pngenc->srcpad = gst_pad_new ("src", GST_PAD_SRC); */
   /*   gst_pad_set_getcaps_function (pngenc->srcpad, gst_pngenc_src_getcaps); */
   /*   gst_pad_set_setcaps_function (pngenc->srcpad, gst_pngenc_setcaps); */
+  gst_pad_set_query_function (pngenc->srcpad,
+      GST_DEBUG_FUNCPTR (gst_pngenc_src_query));
   gst_element_add_pad (GST_ELEMENT (pngenc), pngenc->srcpad);
 
   /* init settings */
-  pngenc->png_struct_ptr = NULL;
-  pngenc->png_info_ptr = NULL;
-
   pngenc->snapshot = DEFAULT_SNAPSHOT;
 /*   pngenc->newmedia = FALSE; */
   pngenc->compression_level = DEFAULT_COMPRESSION_LEVEL;
+  pngenc->threads = DEFAULT_THREADS;
+  pngenc->max_frames_in_flight = DEFAULT_MAX_FRAMES_IN_FLIGHT;
+
+  pngenc->frames_lock = g_mutex_new ();
+  pngenc->frames_cond = g_cond_new ();
+  pngenc->frames = g_queue_new ();
+}
+
+static void
+gst_pngenc_finalize (GObject * object)
+{
+  GstPngEnc *pngenc = GST_PNGENC (object);
+
+  g_mutex_free (pngenc->frames_lock);
+  g_cond_free (pngenc->frames_cond);
+  g_queue_free (pngenc->frames);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -240,30 +335,223 @@ user_flush_data (png_structp png_ptr G_GNUC_UNUSED)
 static void
 user_write_data (png_structp png_ptr, png_bytep data, png_uint_32 length)
 {
-  GstPngEnc *pngenc;
+  GstPngEncFrame *frame;
 
-  pngenc = (GstPngEnc *) png_get_io_ptr (png_ptr);
+  frame = (GstPngEncFrame *) png_get_io_ptr (png_ptr);
 
-  if (pngenc->written + length >= GST_BUFFER_SIZE (pngenc->buffer_out)) {
-    GST_ERROR_OBJECT (pngenc, "output buffer bigger than the input buffer!?");
+  if (frame->written + length >= GST_BUFFER_SIZE (frame->buffer_out)) {
+    GST_ERROR ("output buffer bigger than the input buffer!?");
     png_error (png_ptr, "output buffer bigger than the input buffer!?");
 
     /* never reached */
     return;
   }
 
-  memcpy (GST_BUFFER_DATA (pngenc->buffer_out) + pngenc->written, data, length);
-  pngenc->written += length;
+  memcpy (GST_BUFFER_DATA (frame->buffer_out) + frame->written, data, length);
+  frame->written += length;
+}
+
+/* Encodes the input buffer of @frame into its output buffer. Doesn't post
+ * errors, so it can be used from the worker threads; on failure the error
+ * is stored in @frame and FALSE is returned. */
+static gboolean
+gst_pngenc_encode_frame (GstPngEnc * pngenc, GstPngEncFrame * frame)
+{
+  png_structp png_struct_ptr;
+  png_infop png_info_ptr;
+  png_byte **row_pointers;
+  gint row_index;
+
+  /* initialize png struct stuff */
+  png_struct_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING,
+      (png_voidp) NULL, user_error_fn, user_warning_fn);
+  if (png_struct_ptr == NULL) {
+    frame->error = GST_LIBRARY_ERROR_INIT;
+    frame->error_msg = "Failed to initialize png structure";
+    return FALSE;
+  }
+
+  png_info_ptr = png_create_info_struct (png_struct_ptr);
+  if (!png_info_ptr) {
+    png_destroy_write_struct (&png_struct_ptr, (png_infopp) NULL);
+    frame->error = GST_LIBRARY_ERROR_INIT;
+    frame->error_msg = "Failed to initialize the png info structure";
+    return FALSE;
+  }
+
+  row_pointers = g_new (png_byte *, pngenc->height);
+
+  for (row_index = 0; row_index < pngenc->height; row_index++) {
+    row_pointers[row_index] = GST_BUFFER_DATA (frame->inbuf) +
+        (row_index * pngenc->stride);
+  }
+
+  /* allocate the output buffer */
+  frame->buffer_out =
+      gst_buffer_new_and_alloc (pngenc->height * pngenc->stride);
+  frame->written = 0;
+
+  /* non-0 return is from a longjmp inside of libpng */
+  if (setjmp (png_jmpbuf (png_struct_ptr)) != 0) {
+    png_destroy_write_struct (&png_struct_ptr, &png_info_ptr);
+    g_free (row_pointers);
+    gst_buffer_unref (frame->buffer_out);
+    frame->buffer_out = NULL;
+    frame->error = GST_LIBRARY_ERROR_FAILED;
+    frame->error_msg = "returning from longjmp";
+    return FALSE;
+  }
+
+  png_set_filter (png_struct_ptr, 0, PNG_FILTER_NONE | PNG_FILTER_VALUE_NONE);
+  png_set_compression_level (png_struct_ptr, frame->compression_level);
+
+  png_set_IHDR (png_struct_ptr,
+      png_info_ptr,
+      pngenc->width,
+      pngenc->height,
+      8,
+      pngenc->png_color_type,
+      PNG_INTERLACE_NONE,
+      PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+  png_set_write_fn (png_struct_ptr, frame,
+      (png_rw_ptr) user_write_data, user_flush_data);
+
+  png_write_info (png_struct_ptr, png_info_ptr);
+  png_write_image (png_struct_ptr, row_pointers);
+  png_write_end (png_struct_ptr, NULL);
+
+  g_free (row_pointers);
+
+  frame->outbuf = gst_buffer_create_sub (frame->buffer_out, 0, frame->written);
+  gst_buffer_unref (frame->buffer_out);
+  frame->buffer_out = NULL;
+
+  png_destroy_info_struct (png_struct_ptr, &png_info_ptr);
+  png_destroy_write_struct (&png_struct_ptr, (png_infopp) NULL);
+  gst_buffer_copy_metadata (frame->outbuf, frame->inbuf,
+      GST_BUFFER_COPY_TIMESTAMPS);
+
+  return TRUE;
+}
+
+/* posts the error of a frame that failed to encode */
+static GstFlowReturn
+gst_pngenc_frame_error (GstPngEnc * pngenc, GstPngEncFrame * frame)
+{
+  if (frame->error == GST_LIBRARY_ERROR_INIT)
+    GST_ELEMENT_ERROR (pngenc, LIBRARY, INIT, (NULL), ("%s", frame->error_msg));
+  else
+    GST_ELEMENT_ERROR (pngenc, LIBRARY, FAILED, (NULL), ("%s",
+            frame->error_msg));
+
+  return GST_FLOW_ERROR;
+}
+
+static void
+gst_pngenc_free_frame (GstPngEncFrame * frame)
+{
+  gst_buffer_unref (frame->inbuf);
+  if (frame->outbuf)
+    gst_buffer_unref (frame->outbuf);
+  g_free (frame);
+}
+
+/* runs in the thread pool */
+static void
+gst_pngenc_encode_job (GstPngEncFrame * frame, GstPngEnc * pngenc)
+{
+  gst_pngenc_encode_frame (pngenc, frame);
+
+  g_mutex_lock (pngenc->frames_lock);
+  frame->done = TRUE;
+  g_cond_broadcast (pngenc->frames_cond);
+  g_mutex_unlock (pngenc->frames_lock);
+}
+
+/* Pushes the encoded frames at the head of the queue, and waits for the
+ * worker threads until at most @max_frames frames are left. Frames that are
+ * done after a flow error are dropped. */
+static GstFlowReturn
+gst_pngenc_push_frames (GstPngEnc * pngenc, guint max_frames)
+{
+  GstPngEncFrame *frame;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_mutex_lock (pngenc->frames_lock);
+  while ((frame = g_queue_peek_head (pngenc->frames))) {
+    if (!frame->done) {
+      if (g_queue_get_length (pngenc->frames) <= max_frames)
+        break;
+      g_cond_wait (pngenc->frames_cond, pngenc->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (pngenc->frames);
+    g_mutex_unlock (pngenc->frames_lock);
+
+    if (ret == GST_FLOW_OK) {
+      if (frame->outbuf == NULL) {
+        ret = gst_pngenc_frame_error (pngenc, frame);
+      } else {
+        gst_buffer_set_caps (frame->outbuf, GST_PAD_CAPS (pngenc->srcpad));
+        ret = gst_pad_push (pngenc->srcpad, frame->outbuf);
+        frame->outbuf = NULL;
+      }
+    }
+    gst_pngenc_free_frame (frame);
+
+    g_mutex_lock (pngenc->frames_lock);
+  }
+  g_mutex_unlock (pngenc->frames_lock);
+
+  return ret;
+}
+
+/* waits for the worker threads and drops all frames */
+static void
+gst_pngenc_discard_frames (GstPngEnc * pngenc)
+{
+  GstPngEncFrame *frame;
+
+  g_mutex_lock (pngenc->frames_lock);
+  while ((frame = g_queue_peek_head (pngenc->frames))) {
+    if (!frame->done) {
+      g_cond_wait (pngenc->frames_cond, pngenc->frames_lock);
+      continue;
+    }
+    g_queue_pop_head (pngenc->frames);
+    gst_pngenc_free_frame (frame);
+  }
+  g_mutex_unlock (pngenc->frames_lock);
+}
+
+/* Queues @buf for encoding by the thread pool and pushes the frames before
+ * it that are done. Waits for the worker threads while more than
+ * max-frames-in-flight frames are queued. */
+static GstFlowReturn
+gst_pngenc_encode_parallel (GstPngEnc * pngenc, GstBuffer * buf)
+{
+  GstPngEncFrame *frame;
+
+  frame = g_new0 (GstPngEncFrame, 1);
+  frame->inbuf = buf;
+  frame->compression_level = pngenc->compression_level;
+
+  g_mutex_lock (pngenc->frames_lock);
+  g_queue_push_tail (pngenc->frames, frame);
+  g_mutex_unlock (pngenc->frames_lock);
+
+  g_thread_pool_push (pngenc->pool, frame, NULL);
+
+  return gst_pngenc_push_frames (pngenc, pngenc->n_frames - 1);
 }
 
 static GstFlowReturn
 gst_pngenc_chain (GstPad * pad, GstBuffer * buf)
 {
   GstPngEnc *pngenc;
-  gint row_index;
-  png_byte **row_pointers;
   GstFlowReturn ret = GST_FLOW_OK;
-  GstBuffer *encoded_buf = NULL;
+  GstPngEncFrame frame = { NULL, };
 
   pngenc = GST_PNGENC (gst_pad_get_parent (pad));
 
@@ -282,80 +570,34 @@ gst_pngenc_chain (GstPad * pad, GstBuffer * buf)
     goto done;
   }
 
-  /* initialize png struct stuff */
-  pngenc->png_struct_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING,
-      (png_voidp) NULL, user_error_fn, user_warning_fn);
-  if (pngenc->png_struct_ptr == NULL) {
-    gst_buffer_unref (buf);
-    GST_ELEMENT_ERROR (pngenc, LIBRARY, INIT, (NULL),
-        ("Failed to initialize png structure"));
-    ret = GST_FLOW_ERROR;
+  /* in snapshot mode only one frame is encoded anyway */
+  if (pngenc->pool && !pngenc->snapshot) {
+    ret = gst_pngenc_encode_parallel (pngenc, buf);
     goto done;
   }
 
-  pngenc->png_info_ptr = png_create_info_struct (pngenc->png_struct_ptr);
-  if (!pngenc->png_info_ptr) {
-    gst_buffer_unref (buf);
-    png_destroy_write_struct (&(pngenc->png_struct_ptr), (png_infopp) NULL);
-    GST_ELEMENT_ERROR (pngenc, LIBRARY, INIT, (NULL),
-        ("Failed to initialize the png info structure"));
-    ret = GST_FLOW_ERROR;
-    goto done;
+  /* frames queued before snapshot mode was enabled go first */
+  if (pngenc->pool) {
+    ret = gst_pngenc_push_frames (pngenc, 0);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (buf);
+      goto done;
+    }
   }
 
-  /* non-0 return is from a longjmp inside of libpng */
-  if (setjmp (png_jmpbuf (pngenc->png_struct_ptr)) != 0) {
+  frame.inbuf = buf;
+  frame.compression_level = pngenc->compression_level;
+
+  if (!gst_pngenc_encode_frame (pngenc, &frame)) {
     gst_buffer_unref (buf);
-    png_destroy_write_struct (&pngenc->png_struct_ptr, &pngenc->png_info_ptr);
-    GST_ELEMENT_ERROR (pngenc, LIBRARY, FAILED, (NULL),
-        ("returning from longjmp"));
-    ret = GST_FLOW_ERROR;
+    ret = gst_pngenc_frame_error (pngenc, &frame);
     goto done;
   }
 
-  png_set_filter (pngenc->png_struct_ptr, 0,
-      PNG_FILTER_NONE | PNG_FILTER_VALUE_NONE);
-  png_set_compression_level (pngenc->png_struct_ptr, pngenc->compression_level);
-
-  png_set_IHDR (pngenc->png_struct_ptr,
-      pngenc->png_info_ptr,
-      pngenc->width,
-      pngenc->height,
-      8,
-      pngenc->png_color_type,
-      PNG_INTERLACE_NONE,
-      PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-  png_set_write_fn (pngenc->png_struct_ptr, pngenc,
-      (png_rw_ptr) user_write_data, user_flush_data);
-
-  row_pointers = g_new (png_byte *, pngenc->height);
-
-  for (row_index = 0; row_index < pngenc->height; row_index++) {
-    row_pointers[row_index] = GST_BUFFER_DATA (buf) +
-        (row_index * pngenc->stride);
-  }
-
-  /* allocate the output buffer */
-  pngenc->buffer_out =
-      gst_buffer_new_and_alloc (pngenc->height * pngenc->stride);
-  pngenc->written = 0;
-
-  png_write_info (pngenc->png_struct_ptr, pngenc->png_info_ptr);
-  png_write_image (pngenc->png_struct_ptr, row_pointers);
-  png_write_end (pngenc->png_struct_ptr, NULL);
-
-  g_free (row_pointers);
-
-  encoded_buf = gst_buffer_create_sub (pngenc->buffer_out, 0, pngenc->written);
-
-  png_destroy_info_struct (pngenc->png_struct_ptr, &pngenc->png_info_ptr);
-  png_destroy_write_struct (&pngenc->png_struct_ptr, (png_infopp) NULL);
-  gst_buffer_copy_metadata (encoded_buf, buf, GST_BUFFER_COPY_TIMESTAMPS);
   gst_buffer_unref (buf);
-  gst_buffer_set_caps (encoded_buf, GST_PAD_CAPS (pngenc->srcpad));
+  gst_buffer_set_caps (frame.outbuf, GST_PAD_CAPS (pngenc->srcpad));
 
-  if ((ret = gst_pad_push (pngenc->srcpad, encoded_buf)) != GST_FLOW_OK)
+  if ((ret = gst_pad_push (pngenc->srcpad, frame.outbuf)) != GST_FLOW_OK)
     goto done;
 
   if (pngenc->snapshot) {
@@ -372,15 +614,129 @@ gst_pngenc_chain (GstPad * pad, GstBuffer * buf)
 done:
   GST_DEBUG_OBJECT (pngenc, "END, ret:%d", ret);
 
-  if (pngenc->buffer_out != NULL) {
-    gst_buffer_unref (pngenc->buffer_out);
-    pngenc->buffer_out = NULL;
+  gst_object_unref (pngenc);
+  return ret;
+}
+
+static gboolean
+gst_pngenc_sink_event (GstPad * pad, GstEvent * event)
+{
+  GstPngEnc *pngenc;
+  gboolean ret;
+
+  pngenc = GST_PNGENC (gst_pad_get_parent (pad));
+
+  /* keep the encoded frames in order with the serialized events */
+  if (pngenc->pool) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_pngenc_discard_frames (pngenc);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_pngenc_push_frames (pngenc, 0);
   }
 
+  ret = gst_pad_event_default (pad, event);
+
   gst_object_unref (pngenc);
   return ret;
 }
 
+static gboolean
+gst_pngenc_src_query (GstPad * pad, GstQuery * query)
+{
+  GstPngEnc *pngenc = GST_PNGENC (gst_pad_get_parent (pad));
+  gboolean res;
+
+  res = gst_pad_query_default (pad, query);
+
+  /* frames encoded in parallel are pushed up to n_frames - 1 frames after
+   * they came in */
+  if (res && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY && pngenc->pool &&
+      pngenc->n_frames > 1 && pngenc->fps_n > 0 && pngenc->fps_d > 0) {
+    GstClockTime min, max, latency;
+    gboolean live;
+
+    gst_query_parse_latency (query, &live, &min, &max);
+
+    latency = gst_util_uint64_scale (pngenc->n_frames - 1,
+        pngenc->fps_d * GST_SECOND, pngenc->fps_n);
+    GST_DEBUG_OBJECT (pngenc, "adding latency %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (latency));
+
+    min += latency;
+    if (max != GST_CLOCK_TIME_NONE)
+      max += latency;
+
+    gst_query_set_latency (query, live, min, max);
+  }
+
+  gst_object_unref (pngenc);
+
+  return res;
+}
+
+static void
+gst_pngenc_start_pool (GstPngEnc * pngenc)
+{
+  guint threads = pngenc->threads;
+
+  if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#else
+    threads = 1;
+#endif
+  }
+
+  pngenc->n_frames = pngenc->max_frames_in_flight;
+  if (pngenc->n_frames == 0)
+    pngenc->n_frames = 2 * threads;
+
+  GST_DEBUG_OBJECT (pngenc, "encoding with %u threads, %u frames in flight",
+      threads, pngenc->n_frames);
+
+  pngenc->pool = g_thread_pool_new ((GFunc) gst_pngenc_encode_job, pngenc,
+      threads, FALSE, NULL);
+}
+
+static void
+gst_pngenc_stop_pool (GstPngEnc * pngenc)
+{
+  gst_pngenc_discard_frames (pngenc);
+
+  g_thread_pool_free (pngenc->pool, FALSE, TRUE);
+  pngenc->pool = NULL;
+}
+
+static GstStateChangeReturn
+gst_pngenc_change_state (GstElement * element, GstStateChange transition)
+{
+  GstPngEnc *pngenc = GST_PNGENC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (pngenc->threads != 1 && pngenc->pool == NULL)
+        gst_pngenc_start_pool (pngenc);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (pngenc->pool)
+        gst_pngenc_stop_pool (pngenc);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
 
 static void
 gst_pngenc_get_property (GObject * object,
@@ -400,6 +756,12 @@ gst_pngenc_get_property (GObject * object,
     case ARG_COMPRESSION_LEVEL:
       g_value_set_uint (value, pngenc->compression_level);
       break;
+    case ARG_THREADS:
+      g_value_set_uint (value, pngenc->threads);
+      break;
+    case ARG_MAX_FRAMES_IN_FLIGHT:
+      g_value_set_uint (value, pngenc->max_frames_in_flight);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -425,6 +787,12 @@ gst_pngenc_set_property (GObject * object,
     case ARG_COMPRESSION_LEVEL:
       pngenc->compression_level = g_value_get_uint (value);
       break;
+    case ARG_THREADS:
+      pngenc->threads = g_value_get_uint (value);
+      break;
+    case ARG_MAX_FRAMES_IN_FLIGHT:
+      pngenc->max_frames_in_flight = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -43,20 +43,26 @@ struct _GstPngEnc
   GstElement element;
 
   GstPad *sinkpad, *srcpad;
-  GstBuffer *buffer_out;
-  guint written;
-
-  png_structp png_struct_ptr;
-  png_infop png_info_ptr;
 
   gint png_color_type;
   gint width;
   gint height;
   gint stride;
+  gint fps_n;
+  gint fps_d;
   guint compression_level;
 
   gboolean snapshot;
   gboolean newmedia;
+  guint threads;
+  guint max_frames_in_flight;
+
+  /* parallel encoding, see gst_pngenc_encode_parallel() */
+  guint n_frames;
+  GThreadPool *pool;
+  GMutex *frames_lock;
+  GCond *frames_cond;
+  GQueue *frames;               /* GstPngEncFrame in input order */
 };
 
 struct _GstPngEncClass
@@ -0,0 +1,117 @@
+/*
+ *  GStreamer pulseaudio plugin
+ *
+ *  Copyright (c) 2004-2008 Lennart Poettering
+ *
+ *  gst-pulse is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation; either version 2.1 of the
+ *  License, or (at your option) any later version.
+ *
+ *  gst-pulse is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with gst-pulse; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ *  USA.
+ */
+
+#ifndef __GST_PULSERING_H__
+#define __GST_PULSERING_H__
+
+#include <string.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A byte ring with one producer and one consumer that don't share a lock.
+ * Each side owns its own position in the ring and only the number of used
+ * bytes is shared, so the size can be anything, like a whole number of
+ * samples. */
+typedef struct
+{
+  guint8 *data;
+  guint size;
+  guint read;                   /* consumer */
+  guint write;                  /* producer */
+  volatile gint used;
+} GstPulseRing;
+
+static inline void
+gst_pulse_ring_init (GstPulseRing * ring, guint size)
+{
+  ring->data = g_malloc (size);
+  ring->size = size;
+  ring->read = ring->write = 0;
+  ring->used = 0;
+}
+
+static inline void
+gst_pulse_ring_free (GstPulseRing * ring)
+{
+  g_free (ring->data);
+  ring->data = NULL;
+  ring->size = 0;
+}
+
+static inline guint
+gst_pulse_ring_get_used (GstPulseRing * ring)
+{
+  return (guint) g_atomic_int_get (&ring->used);
+}
+
+/* consumer: copies @len used bytes to @dest without removing them */
+static inline void
+gst_pulse_ring_peek (GstPulseRing * ring, guint8 * dest, guint len)
+{
+  guint first = MIN (len, ring->size - ring->read);
+
+  memcpy (dest, ring->data + ring->read, first);
+  memcpy (dest + first, ring->data, len - first);
+}
+
+/* consumer: removes @len used bytes */
+static inline void
+gst_pulse_ring_skip (GstPulseRing * ring, guint len)
+{
+  ring->read += len;
+  if (ring->read >= ring->size)
+    ring->read -= ring->size;
+  g_atomic_int_add (&ring->used, -(gint) len);
+}
+
+/* consumer: removes everything the producer has committed so far */
+static inline void
+gst_pulse_ring_drop (GstPulseRing * ring)
+{
+  gst_pulse_ring_skip (ring, gst_pulse_ring_get_used (ring));
+}
+
+/* producer: returns where the next bytes go, and in @len how many fit
+ * there before the end of the ring or the used bytes */
+static inline guint8 *
+gst_pulse_ring_get_free (GstPulseRing * ring, guint * len)
+{
+  *len = MIN (ring->size - gst_pulse_ring_get_used (ring),
+      ring->size - ring->write);
+
+  return ring->data + ring->write;
+}
+
+/* producer: hands @len bytes written at the free space to the consumer */
+static inline void
+gst_pulse_ring_commit (GstPulseRing * ring, guint len)
+{
+  ring->write += len;
+  if (ring->write >= ring->size)
+    ring->write -= ring->size;
+  g_atomic_int_add (&ring->used, len);
+}
+
+G_END_DECLS
+
+#endif /* __GST_PULSERING_H__ */
@@ -40,6 +40,9 @@
  * gst-launch -v audiotestsrc ! pulsesink stream-properties="props,media.title=test"
  * ]| Play a sine wave and set a stream property. The property can be checked
  * with "pactl list".
+ * |[
+ * gst-launch -v jackaudiosrc ! audioconvert ! pulsesink target-latency=5000000
+ * ]| Monitor an input with 5ms of buffering in PulseAudio.
  * </refsect2>
  */
 
@@ -62,6 +65,7 @@
 
 #include "pulsesink.h"
 #include "pulseutil.h"
+#include "pulsering.h"
 
 GST_DEBUG_CATEGORY_EXTERN (pulse_debug);
 #define GST_CAT_DEFAULT pulse_debug
@@ -71,6 +75,8 @@ GST_DEBUG_CATEGORY_EXTERN (pulse_debug);
 #define DEFAULT_DEVICE_NAME     NULL
 #define DEFAULT_VOLUME          1.0
 #define DEFAULT_MUTE            FALSE
+#define DEFAULT_TARGET_LATENCY  0
+#define MAX_TARGET_LATENCY      GST_SECOND
 #define MAX_VOLUME              10.0
 
 enum
@@ -83,6 +89,9 @@ enum
   PROP_MUTE,
   PROP_CLIENT,
   PROP_STREAM_PROPERTIES,
+  PROP_TARGET_LATENCY,
+  PROP_CURRENT_LATENCY,
+  PROP_UNDERRUNS,
   PROP_LAST
 };
 
@@ -158,6 +167,18 @@ struct _GstPulseRingBuffer
   gboolean corked:1;
   gboolean in_commit:1;
   gboolean paused:1;
+
+  /* In target-latency mode, commit writes into this ring without taking the
+   * mainloop lock and the write callback moves the data to pulse. There is
+   * one producer (commit) and one consumer (the write callback, or commit
+   * with the mainloop lock when it had to kick pulse). */
+  GstPulseRing ring;
+  gint64 ring_read_offset;      /* consumer, stream offset of ring.read */
+  gint64 ring_write_offset;     /* producer, stream offset of ring.write */
+  volatile gint ring_hungry;    /* pulse wanted more than we had */
+  volatile gint ring_waiting;   /* commit sleeps until there is room */
+  GMutex *ring_lock;
+  GCond *ring_cond;
 };
 struct _GstPulseRingBufferClass
 {
@@ -248,6 +269,11 @@ gst_pulseringbuffer_init (GstPulseRingBuffer * pbuf)
   pbuf->corked = TRUE;
   pbuf->in_commit = FALSE;
   pbuf->paused = FALSE;
+
+  pbuf->ring.data = NULL;
+  pbuf->ring.size = 0;
+  pbuf->ring_lock = g_mutex_new ();
+  pbuf->ring_cond = g_cond_new ();
 }
 
 static void
@@ -266,6 +292,8 @@ gst_pulsering_destroy_stream (GstPulseRingBuffer * pbuf)
       pbuf->m_offset = 0;
       pbuf->m_lastoffset = 0;
     }
+
+    gst_pulse_ring_free (&pbuf->ring);
 #ifdef HAVE_PULSE_1_0
     if (pbuf->format) {
       pa_format_info_free (pbuf->format);
@@ -346,6 +374,9 @@ gst_pulseringbuffer_finalize (GObject * object)
   ringbuffer = GST_PULSERING_BUFFER_CAST (object);
 
   gst_pulsering_destroy_context (ringbuffer);
+  g_mutex_free (ringbuffer->ring_lock);
+  g_cond_free (ringbuffer->ring_cond);
+
   G_OBJECT_CLASS (ring_parent_class)->finalize (object);
 }
 
@@ -619,6 +650,83 @@ gst_pulsering_stream_state_cb (pa_stream * s, void *userdata)
   }
 }
 
+/* moves data from the ring to pulse, must be called with the mainloop lock */
+static gboolean
+gst_pulsering_ring_write (GstPulseRingBuffer * pbuf)
+{
+  GstPulseSink *psink;
+  guint bps, avail;
+  size_t writable, towrite, len;
+  void *dest;
+
+  psink = GST_PULSESINK_CAST (GST_OBJECT_PARENT (pbuf));
+  bps = (GST_RING_BUFFER_CAST (pbuf))->spec.bytes_per_sample;
+
+  if ((writable = pa_stream_writable_size (pbuf->stream)) == (size_t) - 1)
+    goto writable_size_failed;
+  writable -= writable % bps;
+
+  /* say that we want more before looking at what we have, then either we see
+   * the new data or commit sees the flag and kicks us */
+  g_atomic_int_set (&pbuf->ring_hungry, 1);
+  avail = gst_pulse_ring_get_used (&pbuf->ring);
+  if (avail >= writable)
+    g_atomic_int_set (&pbuf->ring_hungry, 0);
+
+  towrite = MIN (avail, writable);
+
+  /* batch everything we have in as few writes as pulse allows */
+  while (towrite > 0) {
+    len = towrite;
+    if (pa_stream_begin_write (pbuf->stream, &dest, &len) < 0)
+      goto write_failed;
+
+    len = MIN (len, towrite);
+    len -= len % bps;
+    if (len == 0) {
+      pa_stream_cancel_write (pbuf->stream);
+      break;
+    }
+
+    gst_pulse_ring_peek (&pbuf->ring, dest, len);
+
+    GST_LOG_OBJECT (psink, "writing %u samples at offset %" G_GINT64_FORMAT,
+        (guint) len / bps, pbuf->ring_read_offset);
+
+    if (pa_stream_write (pbuf->stream, dest, len, NULL,
+            pbuf->ring_read_offset, PA_SEEK_ABSOLUTE) < 0)
+      goto write_failed;
+
+    gst_pulse_ring_skip (&pbuf->ring, len);
+    pbuf->ring_read_offset += len;
+    towrite -= len;
+  }
+
+  if (g_atomic_int_get (&pbuf->ring_waiting)) {
+    g_mutex_lock (pbuf->ring_lock);
+    g_cond_signal (pbuf->ring_cond);
+    g_mutex_unlock (pbuf->ring_lock);
+  }
+
+  return TRUE;
+
+  /* ERRORS */
+writable_size_failed:
+  {
+    GST_ELEMENT_ERROR (psink, RESOURCE, FAILED,
+        ("pa_stream_writable_size() failed: %s",
+            pa_strerror (pa_context_errno (pbuf->context))), (NULL));
+    return FALSE;
+  }
+write_failed:
+  {
+    GST_ELEMENT_ERROR (psink, RESOURCE, FAILED,
+        ("pa_stream_write() failed: %s",
+            pa_strerror (pa_context_errno (pbuf->context))), (NULL));
+    return FALSE;
+  }
+}
+
 static void
 gst_pulsering_stream_request_cb (pa_stream * s, size_t length, void *userdata)
 {
@@ -632,6 +740,11 @@ gst_pulsering_stream_request_cb (pa_stream * s, size_t length, void *userdata)
 
   GST_LOG_OBJECT (psink, "got request for length %" G_GSIZE_FORMAT, length);
 
+  if (pbuf->ring.data) {
+    gst_pulsering_ring_write (pbuf);
+    return;
+  }
+
   if (pbuf->in_commit && (length >= rbuf->spec.segsize)) {
     /* only signal when we are waiting in the commit thread
      * and got request for atleast a segment */
@@ -649,6 +762,7 @@ gst_pulsering_stream_underflow_cb (pa_stream * s, void *userdata)
   psink = GST_PULSESINK_CAST (GST_OBJECT_PARENT (pbuf));
 
   GST_WARNING_OBJECT (psink, "Got underflow");
+  g_atomic_int_inc (&psink->underruns);
 }
 
 static void
@@ -811,6 +925,7 @@ gst_pulseringbuffer_acquire (GstRingBuffer * buf, GstRingBufferSpec * spec)
   pa_stream_flags_t flags;
   const gchar *name;
   GstAudioClock *clock;
+  gboolean use_ring;
 #ifdef HAVE_PULSE_1_0
   pa_format_info *formats[1];
 #ifndef GST_DISABLE_GST_DEBUG
@@ -899,6 +1014,20 @@ gst_pulseringbuffer_acquire (GstRingBuffer * buf, GstRingBufferSpec * spec)
   wanted.prebuf = 0;
   wanted.minreq = spec->segsize;
 
+  use_ring = (psink->target_latency > 0);
+#ifdef HAVE_PULSE_1_0
+  use_ring = use_ring && pbuf->is_pcm;
+#endif
+  if (use_ring) {
+    /* pulse only buffers the target latency and asks for small chunks, which
+     * the write callback takes from our ring */
+    wanted.tlength = gst_util_uint64_scale_int (psink->target_latency,
+        spec->rate, GST_SECOND) * spec->bytes_per_sample;
+    wanted.tlength = MAX (wanted.tlength, 4 * spec->bytes_per_sample);
+    wanted.minreq = wanted.tlength / 4;
+    wanted.minreq -= wanted.minreq % spec->bytes_per_sample;
+  }
+
   GST_INFO_OBJECT (psink, "tlength:   %d", wanted.tlength);
   GST_INFO_OBJECT (psink, "maxlength: %d", wanted.maxlength);
   GST_INFO_OBJECT (psink, "prebuf:    %d", wanted.prebuf);
@@ -979,6 +1108,17 @@ gst_pulseringbuffer_acquire (GstRingBuffer * buf, GstRingBufferSpec * spec)
   spec->segsize = actual->minreq;
   spec->segtotal = actual->tlength / spec->segsize;
 
+  if (use_ring) {
+    /* room for two requests, commit waits when it is full */
+    gst_pulse_ring_init (&pbuf->ring, 2 * spec->segsize);
+    pbuf->ring_read_offset = pbuf->ring_write_offset = 0;
+    /* so that the first commit hands its data to pulse */
+    pbuf->ring_hungry = 1;
+    pbuf->ring_waiting = 0;
+    GST_INFO_OBJECT (psink, "ring:      %u", pbuf->ring.size);
+  }
+  g_atomic_int_set (&psink->underruns, 0);
+
   pa_threaded_mainloop_unlock (mainloop);
 
   return TRUE;
@@ -1108,6 +1248,15 @@ cork_failed:
   }
 }
 
+/* wakes up a commit that waits for room in the ring, after pausing */
+static void
+gst_pulsering_ring_wakeup (GstPulseRingBuffer * pbuf)
+{
+  g_mutex_lock (pbuf->ring_lock);
+  g_cond_signal (pbuf->ring_cond);
+  g_mutex_unlock (pbuf->ring_lock);
+}
+
 static void
 gst_pulseringbuffer_clear (GstRingBuffer * buf)
 {
@@ -1125,6 +1274,11 @@ gst_pulseringbuffer_clear (GstRingBuffer * buf)
     if ((o = pa_stream_flush (pbuf->stream, NULL, pbuf)))
       pa_operation_unref (o);
   }
+  if (pbuf->ring.data) {
+    /* drop what is queued, the next commit starts at its own offset */
+    gst_pulse_ring_drop (&pbuf->ring);
+    pbuf->ring_write_offset = -1;
+  }
   pa_threaded_mainloop_unlock (mainloop);
 }
 
@@ -1203,6 +1357,7 @@ gst_pulseringbuffer_pause (GstRingBuffer * buf)
     GST_DEBUG_OBJECT (psink, "signal commit");
     pa_threaded_mainloop_signal (mainloop, 0);
   }
+  gst_pulsering_ring_wakeup (pbuf);
   pa_threaded_mainloop_unlock (mainloop);
 
   return res;
@@ -1252,6 +1407,7 @@ gst_pulseringbuffer_stop (GstRingBuffer * buf)
     GST_DEBUG_OBJECT (psink, "signal commit thread");
     pa_threaded_mainloop_signal (mainloop, 0);
   }
+  gst_pulsering_ring_wakeup (pbuf);
 #ifdef HAVE_PULSE_1_0
   if (g_atomic_int_get (&psink->format_lost)) {
     /* Don't try to flush, the stream's probably gone by now */
@@ -1366,6 +1522,175 @@ G_STMT_START {                                  \
   GST_DEBUG ("rev_down end %d/%d",*accum,*toprocess);   \
 } G_STMT_END
 
+/* hands the ring to pulse from the streaming thread when the write callback
+ * found it empty, and starts playback when asked to */
+static gboolean
+gst_pulsering_ring_kick (GstPulseRingBuffer * pbuf, gboolean uncork)
+{
+  gboolean res = TRUE;
+
+  pa_threaded_mainloop_lock (mainloop);
+  if (pbuf->stream && !pbuf->paused) {
+    res = gst_pulsering_ring_write (pbuf);
+    if (res && uncork && pbuf->corked)
+      res = gst_pulsering_set_corked (pbuf, FALSE, FALSE);
+  }
+  pa_threaded_mainloop_unlock (mainloop);
+
+  return res;
+}
+
+/* waits until the write callback made room in the ring, returns FALSE when
+ * we got paused */
+static gboolean
+gst_pulsering_ring_wait (GstPulseRingBuffer * pbuf)
+{
+  gboolean paused;
+
+  /* the ring only fills up when pulse has all it wants, so there is enough
+   * data to start playback */
+  if (pbuf->corked && !gst_pulsering_ring_kick (pbuf, TRUE))
+    return FALSE;
+
+  g_mutex_lock (pbuf->ring_lock);
+  g_atomic_int_set (&pbuf->ring_waiting, 1);
+  while (!pbuf->paused &&
+      gst_pulse_ring_get_used (&pbuf->ring) >= pbuf->ring.size)
+    g_cond_wait (pbuf->ring_cond, pbuf->ring_lock);
+  g_atomic_int_set (&pbuf->ring_waiting, 0);
+  paused = pbuf->paused;
+  g_mutex_unlock (pbuf->ring_lock);
+
+  return !paused;
+}
+
+/* continues the ring at a new stream offset */
+static void
+gst_pulsering_ring_rebase (GstPulseRingBuffer * pbuf, gint64 offset)
+{
+  GstPulseSink *psink;
+
+  psink = GST_PULSESINK_CAST (GST_OBJECT_PARENT (pbuf));
+  GST_LOG_OBJECT (psink, "discontinuity, offset is %" G_GINT64_FORMAT ", "
+      "last offset was %" G_GINT64_FORMAT, offset, pbuf->ring_write_offset);
+
+  pa_threaded_mainloop_lock (mainloop);
+  /* give pulse what it can take of the old data, the rest is dropped */
+  if (pbuf->stream && pbuf->ring_write_offset >= 0)
+    gst_pulsering_ring_write (pbuf);
+  gst_pulse_ring_drop (&pbuf->ring);
+  pbuf->ring_read_offset = offset;
+  pbuf->ring_write_offset = offset;
+  pa_threaded_mainloop_unlock (mainloop);
+}
+
+/* commit for the target-latency mode, writes into the ring without taking
+ * the mainloop lock */
+static guint
+gst_pulsering_ring_commit (GstPulseRingBuffer * pbuf, guint64 * sample,
+    guchar * data, gint in_samples, gint out_samples, gint * accum)
+{
+  GstPulseSink *psink;
+  GstRingBuffer *buf;
+  guint result;
+  guint8 *data_end;
+  gboolean reverse;
+  gint *toprocess;
+  gint inr, outr, bps;
+  gint64 offset;
+
+  buf = GST_RING_BUFFER_CAST (pbuf);
+  psink = GST_PULSESINK_CAST (GST_OBJECT_PARENT (pbuf));
+
+  bps = buf->spec.bytes_per_sample;
+
+  /* our toy resampler for trick modes */
+  reverse = out_samples < 0;
+  out_samples = ABS (out_samples);
+
+  if (in_samples >= out_samples)
+    toprocess = &in_samples;
+  else
+    toprocess = &out_samples;
+
+  inr = in_samples - 1;
+  outr = out_samples - 1;
+
+  data_end = data + (bps * inr);
+
+#ifdef HAVE_PULSE_1_0
+  if (g_atomic_int_get (&psink->format_lost)) {
+    /* Sink format changed, drop the data and hope upstream renegotiates */
+    goto fake_done;
+  }
+#endif
+
+  if (pbuf->paused)
+    goto done;
+
+  offset = *sample * bps;
+  if (offset != pbuf->ring_write_offset)
+    gst_pulsering_ring_rebase (pbuf, offset);
+
+  while (*toprocess > 0) {
+    guint towrite;
+    guint8 *dest, *d, *d_end;
+
+    /* free space up to the end of the ring */
+    dest = d = gst_pulse_ring_get_free (&pbuf->ring, &towrite);
+    if (towrite == 0) {
+      GST_LOG_OBJECT (psink, "waiting for free space");
+      if (!gst_pulsering_ring_wait (pbuf))
+        goto done;
+      continue;
+    }
+
+    towrite = MIN (towrite, out_samples * bps);
+    d_end = d + towrite;
+
+    if (G_LIKELY (inr == outr && !reverse)) {
+      memcpy (d, data, towrite);
+      data += towrite;
+      in_samples -= towrite / bps;
+      out_samples -= towrite / bps;
+    } else {
+      if (!reverse) {
+        if (inr >= outr)
+          FWD_UP_SAMPLES (data, data_end, d, d_end);
+        else
+          FWD_DOWN_SAMPLES (data, data_end, d, d_end);
+      } else {
+        if (inr >= outr)
+          REV_UP_SAMPLES (data, data_end, d, d_end);
+        else
+          REV_DOWN_SAMPLES (data, data_end, d, d_end);
+      }
+      towrite = d - dest;
+    }
+
+    /* publish the samples to the write callback */
+    gst_pulse_ring_commit (&pbuf->ring, towrite);
+    pbuf->ring_write_offset += towrite;
+    *sample += towrite / bps;
+
+    if (g_atomic_int_get (&pbuf->ring_hungry) &&
+        !gst_pulsering_ring_kick (pbuf, FALSE))
+      goto done;
+  }
+
+#ifdef HAVE_PULSE_1_0
+fake_done:
+#endif
+  /* we consumed all samples here */
+  data = data_end + bps;
+
+done:
+  result = inr - ((data_end - data) / bps);
+  GST_LOG_OBJECT (psink, "wrote %d samples", result);
+
+  return result;
+}
+
 /* our custom commit function because we write into the buffer of pulseaudio
  * instead of keeping our own buffer */
 static guint
@@ -1403,6 +1728,10 @@ gst_pulseringbuffer_commit (GstRingBuffer * buf, guint64 * sample,
       goto start_failed;
   }
 
+  if (pbuf->ring.data)
+    return gst_pulsering_ring_commit (pbuf, sample, data, in_samples,
+        out_samples, accum);
+
   pa_threaded_mainloop_lock (mainloop);
 
   GST_DEBUG_OBJECT (psink, "entering commit");
@@ -1699,6 +2028,12 @@ gst_pulsering_flush (GstPulseRingBuffer * pbuf)
   psink = GST_PULSESINK_CAST (GST_OBJECT_PARENT (pbuf));
   GST_DEBUG_OBJECT (psink, "entering flush");
 
+  /* the write callback takes the rest when there is room */
+  if (pbuf->stream && pbuf->ring.data) {
+    gst_pulsering_ring_write (pbuf);
+    return;
+  }
+
   /* flush the buffer if possible */
   if (pbuf->stream && (pbuf->m_data != NULL) && (pbuf->m_towrite > 0)) {
 #ifndef GST_DISABLE_GST_DEBUG
@@ -1954,6 +2289,56 @@ gst_pulsesink_class_init (GstPulseSinkClass * klass)
       g_param_spec_boxed ("stream-properties", "stream properties",
           "list of pulseaudio stream properties",
           GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPulseSink:target-latency
+   *
+   * Amount of audio that PulseAudio buffers, in nanoseconds. When this is
+   * set, the sink asks PulseAudio for small chunks of this latency instead
+   * of using #GstBaseAudioSink:buffer-time and #GstBaseAudioSink:latency-time,
+   * and the streaming thread hands the samples to the PulseAudio thread
+   * through a lock-free ring instead of taking the mainloop lock for every
+   * segment. 0 disables this mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_TARGET_LATENCY,
+      g_param_spec_uint64 ("target-latency", "Target latency",
+          "Amount of audio buffered by PulseAudio in nanoseconds "
+          "(0 = use buffer-time and latency-time)", 0, MAX_TARGET_LATENCY,
+          DEFAULT_TARGET_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstPulseSink:current-latency
+   *
+   * The time it takes until a sample that is written now is played, as
+   * reported by PulseAudio plus what is still waiting in the ring of the
+   * #GstPulseSink:target-latency mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_CURRENT_LATENCY,
+      g_param_spec_uint64 ("current-latency", "Current latency",
+          "Current playback latency in nanoseconds", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPulseSink:underruns
+   *
+   * Number of times PulseAudio ran out of data since the stream was
+   * created.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_UNDERRUNS,
+      g_param_spec_uint ("underruns", "Underruns",
+          "Number of buffer underruns", 0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 /* returns the current time of the sink ringbuffer */
@@ -2202,6 +2587,9 @@ gst_pulsesink_init (GstPulseSink * pulsesink, GstPulseSinkClass * klass)
   pulsesink->mute = DEFAULT_MUTE;
   pulsesink->mute_set = FALSE;
 
+  pulsesink->target_latency = DEFAULT_TARGET_LATENCY;
+  pulsesink->underruns = 0;
+
   pulsesink->notify = 0;
 
 #ifdef HAVE_PULSE_1_0
@@ -2627,6 +3015,53 @@ info_failed:
   }
 }
 
+static GstClockTime
+gst_pulsesink_get_current_latency (GstPulseSink * psink)
+{
+  GstPulseRingBuffer *pbuf;
+  GstClockTime latency = 0;
+  pa_usec_t usec;
+  int negative;
+  guint queued;
+  gint bps, rate;
+
+  if (!mainloop)
+    goto no_mainloop;
+
+  pa_threaded_mainloop_lock (mainloop);
+
+  pbuf = GST_PULSERING_BUFFER_CAST (GST_BASE_AUDIO_SINK (psink)->ringbuffer);
+  if (pbuf == NULL || pbuf->stream == NULL)
+    goto no_buffer;
+
+  if (pa_stream_get_latency (pbuf->stream, &usec, &negative) >= 0 && !negative)
+    latency = usec * GST_USECOND;
+
+  bps = GST_RING_BUFFER_CAST (pbuf)->spec.bytes_per_sample;
+  rate = GST_RING_BUFFER_CAST (pbuf)->spec.rate;
+  if (pbuf->ring.data && bps > 0 && rate > 0) {
+    queued = gst_pulse_ring_get_used (&pbuf->ring);
+    latency += gst_util_uint64_scale_int (queued / bps, GST_SECOND, rate);
+  }
+
+unlock:
+  pa_threaded_mainloop_unlock (mainloop);
+
+  return latency;
+
+  /* ERRORS */
+no_mainloop:
+  {
+    GST_DEBUG_OBJECT (psink, "we have no mainloop");
+    return 0;
+  }
+no_buffer:
+  {
+    GST_DEBUG_OBJECT (psink, "we have no ringbuffer");
+    goto unlock;
+  }
+}
+
 static void
 gst_pulsesink_set_property (GObject * object,
     guint prop_id, const GValue * value, GParamSpec * pspec)
@@ -2668,6 +3103,9 @@ gst_pulsesink_set_property (GObject * object,
         pa_proplist_free (pulsesink->proplist);
       pulsesink->proplist = gst_pulse_make_proplist (pulsesink->properties);
       break;
+    case PROP_TARGET_LATENCY:
+      pulsesink->target_latency = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2703,6 +3141,15 @@ gst_pulsesink_get_property (GObject * object,
     case PROP_STREAM_PROPERTIES:
       gst_value_set_structure (value, pulsesink->properties);
       break;
+    case PROP_TARGET_LATENCY:
+      g_value_set_uint64 (value, pulsesink->target_latency);
+      break;
+    case PROP_CURRENT_LATENCY:
+      g_value_set_uint64 (value, gst_pulsesink_get_current_latency (pulsesink));
+      break;
+    case PROP_UNDERRUNS:
+      g_value_set_uint (value, g_atomic_int_get (&pulsesink->underruns));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
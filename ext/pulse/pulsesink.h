@@ -77,6 +77,9 @@ struct _GstPulseSink
   GstStructure *properties;
   pa_proplist *proplist;
 
+  guint64 target_latency;
+  gint underruns; /* atomic */
+
 #ifdef HAVE_PULSE_1_0
   GMutex *sink_formats_lock;
   GList *sink_formats;
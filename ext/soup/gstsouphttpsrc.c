@@ -33,6 +33,13 @@
  * need to use the #ICYDemux element as follow-up element to extract the Icecast
  * metadata and to determine the underlying media type.
  *
+ * If the #GstSoupHTTPSrc:parallel-requests property is set and the server
+ * accepts Range requests, souphttpsrc reads the resource in blocks with
+ * several concurrent Range requests for the data after the read position,
+ * and keeps the blocks in a cache. Seeking back into cached data, as demuxers
+ * do when the index is at the end of the file, then doesn't go to the server
+ * again.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -64,6 +71,12 @@
  * These are used by the mime/multipart demultiplexer to emit timestamps
  * on the JPEG-encoded video frame buffers. This allows the Matroska
  * multiplexer to timestamp the frames in the resulting file.
+ * |[
+ * gst-launch -v souphttpsrc location=http://media.server.org/movie.mp4
+ *     parallel-requests=4 cache-location=/var/tmp ! qtdemux ! fakesink
+ * ]| The above pipeline reads an MP4 file with up to four Range requests
+ * in flight, and keeps the data that doesn't fit in memory in a file in
+ * /var/tmp.
  * </refsect2>
  */
 
@@ -75,6 +88,10 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>             /* atoi() */
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>             /* lseek() */
+#endif
+#include <glib/gstdio.h>
 #include <gst/gstelement.h>
 #include <gst/gst-i18n-plugin.h>
 #ifdef HAVE_LIBSOUP_GNOME
@@ -113,10 +130,40 @@ enum
   PROP_IRADIO_URL,
   PROP_IRADIO_TITLE,
   PROP_TIMEOUT,
-  PROP_EXTRA_HEADERS
+  PROP_EXTRA_HEADERS,
+  PROP_PARALLEL_REQUESTS,
+  PROP_CACHE_BLOCK_SIZE,
+  PROP_CACHE_SIZE,
+  PROP_CACHE_LOCATION,
+  PROP_CACHE_HITS,
+  PROP_CACHE_MISSES,
+  PROP_KEEP_ALIVE
 };
 
 #define DEFAULT_USER_AGENT           "GStreamer souphttpsrc "
+#define DEFAULT_PARALLEL_REQUESTS    0
+#define DEFAULT_CACHE_BLOCK_SIZE     (256 * 1024)
+#define DEFAULT_CACHE_SIZE           (16 * 1024 * 1024)
+#define DEFAULT_CACHE_LOCATION       NULL
+#define DEFAULT_KEEP_ALIVE           FALSE
+
+/* Sessions that elements in keep-alive mode left behind when they stopped,
+ * with their connections still open, most recent first. An element that
+ * starts takes one for the same server and session settings from here, so
+ * that its requests don't have to look up the host and connect again. Each
+ * session is only ever used by one element at a time, as the async sessions
+ * are not thread-safe. */
+typedef struct
+{
+  gchar *key;
+  SoupSession *session;
+  GMainContext *context;
+} GstSoupHTTPSrcIdleSession;
+
+#define MAX_IDLE_SESSIONS            16
+
+static GQueue idle_sessions = G_QUEUE_INIT;
+static GMutex *idle_sessions_mutex = NULL;
 
 static void gst_soup_http_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
@@ -169,6 +216,12 @@ static void gst_soup_http_src_finished_cb (SoupMessage * msg,
 static void gst_soup_http_src_authenticate_cb (SoupSession * session,
     SoupMessage * msg, SoupAuth * auth, gboolean retrying,
     GstSoupHTTPSrc * src);
+static GstFlowReturn gst_soup_http_src_create_cached (GstSoupHTTPSrc * src,
+    GstBuffer ** outbuf);
+static void gst_soup_http_src_cancel_blocks (GstSoupHTTPSrc * src,
+    guint64 first, guint64 last);
+static void gst_soup_http_src_cache_flush (GstSoupHTTPSrc * src);
+static void gst_soup_http_src_cache_clear (GstSoupHTTPSrc * src);
 
 static void
 _do_init (GType type)
@@ -216,6 +269,9 @@ gst_soup_http_src_class_init (GstSoupHTTPSrcClass * klass)
   gobject_class->get_property = gst_soup_http_src_get_property;
   gobject_class->finalize = gst_soup_http_src_finalize;
 
+  g_assert (idle_sessions_mutex == NULL);
+  idle_sessions_mutex = g_mutex_new ();
+
   g_object_class_install_property (gobject_class,
       PROP_LOCATION,
       g_param_spec_string ("location", "Location",
@@ -268,6 +324,113 @@ gst_soup_http_src_class_init (GstSoupHTTPSrcClass * klass)
           "Extra headers to append to the HTTP request",
           GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSoupHTTPSrc:parallel-requests
+   *
+   * Number of Range requests to keep in flight for the blocks at and after
+   * the read position, when the server accepts Range requests. Blocks are
+   * kept in a cache so that seeking back into them does not go to the
+   * network again. 0 reads the resource with one sequential request.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_PARALLEL_REQUESTS,
+      g_param_spec_uint ("parallel-requests", "Parallel requests",
+          "Number of Range requests for upcoming blocks to keep in flight "
+          "(0 = one sequential request)", 0, 16, DEFAULT_PARALLEL_REQUESTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstSoupHTTPSrc:cache-block-size
+   *
+   * Size of the blocks requested and cached in parallel-requests mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_BLOCK_SIZE,
+      g_param_spec_uint ("cache-block-size", "Cache block size",
+          "Size in bytes of a block requested with one Range request",
+          4096, G_MAXINT, DEFAULT_CACHE_BLOCK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstSoupHTTPSrc:cache-size
+   *
+   * Maximum number of bytes of blocks kept in memory in parallel-requests
+   * mode. Blocks that don't fit any more are written to a file in
+   * #GstSoupHTTPSrc:cache-location if set, and dropped otherwise.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_SIZE,
+      g_param_spec_uint64 ("cache-size", "Cache size",
+          "Maximum number of bytes of blocks to keep in memory", 0,
+          G_MAXUINT64, DEFAULT_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstSoupHTTPSrc:cache-location
+   *
+   * Directory to create a file in for the blocks that are pushed out of
+   * the memory cache, or NULL to drop them. The file is created with a
+   * unique name and removed right away, so it is only reachable through
+   * the element and goes away with it.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_LOCATION,
+      g_param_spec_string ("cache-location", "Cache location",
+          "Directory for a file to keep blocks in that don't fit in memory "
+          "(NULL = drop them)", DEFAULT_CACHE_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstSoupHTTPSrc:cache-hits
+   *
+   * Number of buffers in parallel-requests mode whose data was cached
+   * already.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_HITS,
+      g_param_spec_uint64 ("cache-hits", "Cache hits",
+          "Number of buffers pushed from blocks that were cached already",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstSoupHTTPSrc:cache-misses
+   *
+   * Number of buffers in parallel-requests mode that had to wait for their
+   * block to arrive from the network.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CACHE_MISSES,
+      g_param_spec_uint64 ("cache-misses", "Cache misses",
+          "Number of buffers that had to wait for data from the network",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstSoupHTTPSrc:keep-alive
+   *
+   * Keep the connection to the server open after a request. It is reused
+   * for the next request of the element, and when the element stops, its
+   * connections are handed to the next souphttpsrc in the process that
+   * starts with a location on the same server and the same session
+   * settings. Sessions that were given credentials are not handed on, they
+   * may have cached the authentication.
+   *
+   * The location can also be changed while the element is running, after it
+   * posted EOS. A flushing seek then makes it read the new location from
+   * the seek position on, over the same connection if the server is the
+   * same.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_KEEP_ALIVE,
+      g_param_spec_boolean ("keep-alive", "Keep alive",
+          "Keep connections open and reuse them for the next requests, also "
+          "of other elements", DEFAULT_KEEP_ALIVE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   /* icecast stuff */
   g_object_class_install_property (gobject_class,
       PROP_IRADIO_MODE,
@@ -322,6 +485,8 @@ gst_soup_http_src_reset (GstSoupHTTPSrc * src)
   src->read_position = 0;
   src->request_position = 0;
   src->content_size = 0;
+  src->accept_ranges = FALSE;
+  src->location_changed = FALSE;
 
   gst_caps_replace (&src->src_caps, NULL);
   g_free (src->iradio_name);
@@ -352,6 +517,15 @@ gst_soup_http_src_init (GstSoupHTTPSrc * src, GstSoupHTTPSrcClass * g_class)
   src->context = NULL;
   src->session = NULL;
   src->msg = NULL;
+  src->keep_alive = DEFAULT_KEEP_ALIVE;
+  src->parallel_requests = DEFAULT_PARALLEL_REQUESTS;
+  src->cache_block_size = DEFAULT_CACHE_BLOCK_SIZE;
+  src->cache_size = DEFAULT_CACHE_SIZE;
+  src->cache_location = DEFAULT_CACHE_LOCATION;
+  src->blocks = g_hash_table_new (g_int64_hash, g_int64_equal);
+  g_queue_init (&src->cache_lru);
+  src->spill_file = NULL;
+  src->spill_file_path = NULL;
   proxy = g_getenv ("http_proxy");
   if (proxy && !gst_soup_http_src_set_proxy (src, proxy)) {
     GST_WARNING_OBJECT (src,
@@ -379,6 +553,8 @@ gst_soup_http_src_finalize (GObject * gobject)
   g_free (src->proxy_id);
   g_free (src->proxy_pw);
   g_strfreev (src->cookies);
+  g_free (src->cache_location);
+  g_hash_table_destroy (src->blocks);
 
   G_OBJECT_CLASS (parent_class)->finalize (gobject);
 }
@@ -472,6 +648,22 @@ gst_soup_http_src_set_property (GObject * object, guint prop_id,
       src->extra_headers = s ? gst_structure_copy (s) : NULL;
       break;
     }
+    case PROP_PARALLEL_REQUESTS:
+      src->parallel_requests = g_value_get_uint (value);
+      break;
+    case PROP_CACHE_BLOCK_SIZE:
+      src->cache_block_size = g_value_get_uint (value);
+      break;
+    case PROP_CACHE_SIZE:
+      src->cache_size = g_value_get_uint64 (value);
+      break;
+    case PROP_CACHE_LOCATION:
+      g_free (src->cache_location);
+      src->cache_location = g_value_dup_string (value);
+      break;
+    case PROP_KEEP_ALIVE:
+      src->keep_alive = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -545,6 +737,31 @@ gst_soup_http_src_get_property (GObject * object, guint prop_id,
     case PROP_EXTRA_HEADERS:
       gst_value_set_structure (value, src->extra_headers);
       break;
+    case PROP_PARALLEL_REQUESTS:
+      g_value_set_uint (value, src->parallel_requests);
+      break;
+    case PROP_CACHE_BLOCK_SIZE:
+      g_value_set_uint (value, src->cache_block_size);
+      break;
+    case PROP_CACHE_SIZE:
+      g_value_set_uint64 (value, src->cache_size);
+      break;
+    case PROP_CACHE_LOCATION:
+      g_value_set_string (value, src->cache_location);
+      break;
+    case PROP_CACHE_HITS:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint64 (value, src->cache_hits);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_CACHE_MISSES:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint64 (value, src->cache_misses);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_KEEP_ALIVE:
+      g_value_set_boolean (value, src->keep_alive);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -601,7 +818,7 @@ gst_soup_http_src_add_range_header (GstSoupHTTPSrc * src, guint64 offset)
 static gboolean
 _append_extra_header (GQuark field_id, const GValue * value, gpointer user_data)
 {
-  GstSoupHTTPSrc *src = GST_SOUP_HTTP_SRC (user_data);
+  SoupMessage *msg = SOUP_MESSAGE (user_data);
   const gchar *field_name = g_quark_to_string (field_id);
   gchar *field_content = NULL;
 
@@ -617,15 +834,13 @@ _append_extra_header (GQuark field_id, const GValue * value, gpointer user_data)
   }
 
   if (field_content == NULL) {
-    GST_ERROR_OBJECT (src, "extra-headers field '%s' contains no value "
+    GST_ERROR ("extra-headers field '%s' contains no value "
         "or can't be converted to a string", field_name);
     return FALSE;
   }
 
-  GST_DEBUG_OBJECT (src, "Appending extra header: \"%s: %s\"", field_name,
-      field_content);
-  soup_message_headers_append (src->msg->request_headers, field_name,
-      field_content);
+  GST_DEBUG ("Appending extra header: \"%s: %s\"", field_name, field_content);
+  soup_message_headers_append (msg->request_headers, field_name, field_content);
 
   g_free (field_content);
 
@@ -665,12 +880,12 @@ _append_extra_headers (GQuark field_id, const GValue * value,
 
 
 static gboolean
-gst_soup_http_src_add_extra_headers (GstSoupHTTPSrc * src)
+gst_soup_http_src_add_extra_headers (GstSoupHTTPSrc * src, SoupMessage * msg)
 {
   if (!src->extra_headers)
     return TRUE;
 
-  return gst_structure_foreach (src->extra_headers, _append_extra_headers, src);
+  return gst_structure_foreach (src->extra_headers, _append_extra_headers, msg);
 }
 
 
@@ -686,12 +901,119 @@ gst_soup_http_src_session_pause_message (GstSoupHTTPSrc * src)
   soup_session_pause_message (src->session, src->msg);
 }
 
+/* Everything the session was set up with, and the cookies, which are sent
+ * on its connections. Credentials are not part of it, sessions that had
+ * them are never reused, see gst_soup_http_src_session_reusable(). */
+static gchar *
+gst_soup_http_src_session_key (GstSoupHTTPSrc * src)
+{
+  SoupURI *uri = soup_uri_new (src->location);
+  gchar *proxy = NULL, *cookies = NULL, *key;
+
+  if (src->proxy)
+    proxy = soup_uri_to_string (src->proxy, FALSE);
+  if (src->cookies)
+    cookies = g_strjoinv ("; ", src->cookies);
+
+  key = g_strdup_printf ("%s://%s:%u %s %s %u %u %s", uri ? uri->scheme : "",
+      uri ? uri->host : "", uri ? uri->port : 0, GST_STR_NULL (proxy),
+      GST_STR_NULL (src->user_agent), src->timeout, src->parallel_requests,
+      GST_STR_NULL (cookies));
+
+  if (uri)
+    soup_uri_free (uri);
+  g_free (proxy);
+  g_free (cookies);
+  return key;
+}
+
+/* A session that may have authenticated keeps the credentials around */
+static gboolean
+gst_soup_http_src_session_reusable (GstSoupHTTPSrc * src)
+{
+  return src->user_id == NULL && src->user_pw == NULL &&
+      src->proxy_id == NULL && src->proxy_pw == NULL;
+}
+
+static void
+gst_soup_http_src_idle_session_free (GstSoupHTTPSrcIdleSession * idle)
+{
+  soup_session_abort (idle->session);
+  g_object_unref (idle->session);
+  g_main_context_unref (idle->context);
+  g_free (idle->key);
+  g_slice_free (GstSoupHTTPSrcIdleSession, idle);
+}
+
+/* Takes an idle session for the location and settings of @src. */
+static gboolean
+gst_soup_http_src_take_idle_session (GstSoupHTTPSrc * src)
+{
+  GstSoupHTTPSrcIdleSession *idle = NULL;
+  gchar *key = gst_soup_http_src_session_key (src);
+  GList *walk;
+
+  g_mutex_lock (idle_sessions_mutex);
+  for (walk = idle_sessions.head; walk; walk = walk->next) {
+    if (strcmp (((GstSoupHTTPSrcIdleSession *) walk->data)->key, key) == 0) {
+      idle = walk->data;
+      g_queue_delete_link (&idle_sessions, walk);
+      break;
+    }
+  }
+  g_mutex_unlock (idle_sessions_mutex);
+  g_free (key);
+
+  if (!idle)
+    return FALSE;
+
+  src->session = idle->session;
+  src->context = idle->context;
+  g_free (idle->key);
+  g_slice_free (GstSoupHTTPSrcIdleSession, idle);
+  return TRUE;
+}
+
+/* Hands the session and its context over to the idle sessions. */
+static void
+gst_soup_http_src_release_session (GstSoupHTTPSrc * src)
+{
+  GstSoupHTTPSrcIdleSession *idle = g_slice_new (GstSoupHTTPSrcIdleSession);
+
+  g_signal_handlers_disconnect_by_func (src->session,
+      gst_soup_http_src_authenticate_cb, src);
+
+  idle->key = gst_soup_http_src_session_key (src);
+  idle->session = src->session;
+  idle->context = src->context;
+  src->session = NULL;
+  src->context = NULL;
+
+  g_mutex_lock (idle_sessions_mutex);
+  g_queue_push_head (&idle_sessions, idle);
+  if (idle_sessions.length > MAX_IDLE_SESSIONS)
+    idle = g_queue_pop_tail (&idle_sessions);
+  else
+    idle = NULL;
+  g_mutex_unlock (idle_sessions_mutex);
+
+  if (idle)
+    gst_soup_http_src_idle_session_free (idle);
+}
+
 static void
 gst_soup_http_src_session_close (GstSoupHTTPSrc * src)
 {
   if (src->session) {
-    soup_session_abort (src->session);  /* This unrefs the message. */
-    g_object_unref (src->session);
+    if (src->keep_alive && gst_soup_http_src_session_reusable (src)) {
+      /* Only stop our own requests, the connections stay open. */
+      gst_soup_http_src_cancel_message (src);
+      gst_soup_http_src_cancel_blocks (src, 0, 0);
+      gst_soup_http_src_release_session (src);
+    } else {
+      soup_session_abort (src->session);        /* This unrefs the message. */
+      g_object_unref (src->session);
+    }
     src->session = NULL;
     src->msg = NULL;
   }
@@ -767,6 +1089,13 @@ gst_soup_http_src_got_headers_cb (SoupMessage * msg, GstSoupHTTPSrc * src)
     }
   }
 
+  /* Blocks can be read with Range requests. */
+  if (msg->status_code == SOUP_STATUS_PARTIAL_CONTENT ||
+      ((value = soup_message_headers_get (msg->response_headers,
+                  "Accept-Ranges")) != NULL &&
+          g_ascii_strcasecmp (value, "bytes") == 0))
+    src->accept_ranges = TRUE;
+
   /* Icecast stuff */
   tag_list = gst_tag_list_new ();
 
@@ -893,6 +1222,11 @@ gst_soup_http_src_got_body_cb (SoupMessage * msg, GstSoupHTTPSrc * src)
   src->ret = GST_FLOW_UNEXPECTED;
   if (src->loop)
     g_main_loop_quit (src->loop);
+  if (src->keep_alive) {
+    /* Let the message finish, so that its connection can be reused. */
+    src->session_io_status = GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_FINISHED;
+    return;
+  }
   gst_soup_http_src_session_pause_message (src);
 }
 
@@ -910,6 +1244,9 @@ gst_soup_http_src_finished_cb (SoupMessage * msg, GstSoupHTTPSrc * src)
     /* gst_soup_http_src_cancel_message() triggered this; probably a seek
      * that occurred in the QUEUEING state; i.e. before the connection setup
      * was complete. Do nothing */
+  } else if (src->session_io_status ==
+      GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_FINISHED) {
+    /* The whole body was read, in keep-alive mode. */
   } else if (src->session_io_status ==
       GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_RUNNING && src->read_position > 0) {
     /* The server disconnected while streaming. Reconnect and seeking to the
@@ -1131,8 +1468,9 @@ gst_soup_http_src_build_message (GstSoupHTTPSrc * src)
     return FALSE;
   }
   src->session_io_status = GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_IDLE;
-  soup_message_headers_append (src->msg->request_headers, "Connection",
-      "close");
+  if (!src->keep_alive)
+    soup_message_headers_append (src->msg->request_headers, "Connection",
+        "close");
   if (src->iradio_mode) {
     soup_message_headers_append (src->msg->request_headers, "icy-metadata",
         "1");
@@ -1163,7 +1501,7 @@ gst_soup_http_src_build_message (GstSoupHTTPSrc * src)
       gst_soup_http_src_chunk_allocator, src, NULL);
   gst_soup_http_src_add_range_header (src, src->request_position);
 
-  gst_soup_http_src_add_extra_headers (src);
+  gst_soup_http_src_add_extra_headers (src, src->msg);
 
   GST_DEBUG_OBJECT (src, "request headers:");
   soup_message_headers_foreach (src->msg->request_headers,
@@ -1172,6 +1510,25 @@ gst_soup_http_src_build_message (GstSoupHTTPSrc * src)
   return TRUE;
 }
 
+/* Starts over with the location that was set in keep-alive mode, on the
+ * session of the previous one. */
+static void
+gst_soup_http_src_switch_location (GstSoupHTTPSrc * src)
+{
+  guint64 position = src->request_position;
+
+  GST_DEBUG_OBJECT (src, "switching to location %s", src->location);
+
+  gst_soup_http_src_cancel_message (src);
+  gst_soup_http_src_cancel_blocks (src, 0, 0);
+  gst_soup_http_src_cache_flush (src);
+  gst_soup_http_src_reset (src);
+  src->request_position = position;
+
+  gst_segment_set_duration (&GST_BASE_SRC_CAST (src)->segment,
+      GST_FORMAT_BYTES, -1);
+}
+
 static GstFlowReturn
 gst_soup_http_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 {
@@ -1179,6 +1536,12 @@ gst_soup_http_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 
   src = GST_SOUP_HTTP_SRC (psrc);
 
+  if (G_UNLIKELY (src->location_changed))
+    gst_soup_http_src_switch_location (src);
+
+  if (src->parallel_requests > 0 && src->have_size && src->accept_ranges)
+    return gst_soup_http_src_create_cached (src, outbuf);
+
   if (src->msg && (src->request_position != src->read_position)) {
     if (src->content_size != 0 && src->request_position >= src->content_size) {
       GST_WARNING_OBJECT (src, "Seeking behind the end of file -- EOS");
@@ -1229,6 +1592,9 @@ gst_soup_http_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
       case GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_CANCELLED:
         /* Impossible. */
         break;
+      case GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_FINISHED:
+        /* Waiting for the message to finish. */
+        break;
     }
 
     if (src->ret == GST_FLOW_CUSTOM_ERROR)
@@ -1240,6 +1606,430 @@ gst_soup_http_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
   return src->ret;
 }
 
+/* Range-parallel download.
+ *
+ * With #GstSoupHTTPSrc:parallel-requests set, and once the first response
+ * told us the size of the resource and that the server accepts Range
+ * requests, the sequential request is dropped and the resource is read in
+ * blocks of #GstSoupHTTPSrc:cache-block-size bytes, each with its own Range
+ * request on the session. gst_soup_http_src_create_cached() pushes the rest
+ * of the block at the read position as a subbuffer and keeps requests in
+ * flight for that block and the ones after it.
+ * Finished blocks stay in memory, least recently used first out, up to
+ * #GstSoupHTTPSrc:cache-size bytes. Blocks that don't fit any more are
+ * written to the spill file at their offset in the resource if there is one,
+ * and read back from there when needed again. A seek into a cached block
+ * thus doesn't touch the network, and one into a block that is in flight
+ * only waits for that request.
+ */
+
+typedef struct
+{
+  GstSoupHTTPSrc *src;
+  guint64 index;                /* Hash table key. */
+  guint64 offset;
+  guint size;
+  SoupMessage *msg;             /* Range request, while in flight. */
+  GstBuffer *buffer;            /* Data, while in flight or in memory. */
+  guint filled;
+  gboolean spilled;             /* Data is in the spill file. */
+  gboolean in_memory;           /* Finished and in the LRU queue. */
+  GList link;
+} GstSoupHTTPSrcBlock;
+
+static void
+gst_soup_http_src_block_free (GstSoupHTTPSrcBlock * block)
+{
+  GstSoupHTTPSrc *src = block->src;
+
+  if (block->in_memory) {
+    g_queue_unlink (&src->cache_lru, &block->link);
+    src->cache_used -= block->size;
+  }
+  if (block->buffer)
+    gst_buffer_unref (block->buffer);
+  g_hash_table_remove (src->blocks, &block->index);
+  g_slice_free (GstSoupHTTPSrcBlock, block);
+}
+
+static gboolean
+gst_soup_http_src_spill_seek (GstSoupHTTPSrc * src, guint64 offset)
+{
+#ifdef HAVE_FSEEKO
+  if (fseeko (src->spill_file, (off_t) offset, SEEK_SET) != 0)
+    return FALSE;
+#elif defined (G_OS_UNIX) || defined (G_OS_WIN32)
+  if (lseek (fileno (src->spill_file), (off_t) offset,
+          SEEK_SET) == (off_t) - 1)
+    return FALSE;
+#else
+  if (offset > G_MAXLONG)
+    return FALSE;
+  if (fseek (src->spill_file, (long) offset, SEEK_SET) != 0)
+    return FALSE;
+#endif
+  return TRUE;
+}
+
+static gboolean
+gst_soup_http_src_block_spill (GstSoupHTTPSrc * src,
+    GstSoupHTTPSrcBlock * block)
+{
+  if (block->spilled)
+    return TRUE;
+
+  if (!gst_soup_http_src_spill_seek (src, block->offset) ||
+      fwrite (GST_BUFFER_DATA (block->buffer), 1, block->size,
+          src->spill_file) != block->size) {
+    GST_WARNING_OBJECT (src, "failed to write block %" G_GUINT64_FORMAT
+        " to the spill file", block->index);
+    return FALSE;
+  }
+  block->spilled = TRUE;
+  return TRUE;
+}
+
+/* Moves blocks out of memory until the cache fits in cache-size again. The
+ * block at the read position is kept, it is about to be pushed. */
+static void
+gst_soup_http_src_cache_evict (GstSoupHTTPSrc * src)
+{
+  while (src->cache_used > src->cache_size && src->cache_lru.length > 1) {
+    GList *link = g_queue_pop_tail_link (&src->cache_lru);
+    GstSoupHTTPSrcBlock *block = link->data;
+    gboolean spilled;
+
+    if (src->read_position >= block->offset &&
+        src->read_position < block->offset + block->size) {
+      g_queue_push_head_link (&src->cache_lru, link);
+      continue;
+    }
+
+    GST_LOG_OBJECT (src, "evicting block %" G_GUINT64_FORMAT, block->index);
+    block->in_memory = FALSE;
+    src->cache_used -= block->size;
+    spilled = src->spill_file && gst_soup_http_src_block_spill (src, block);
+    gst_buffer_unref (block->buffer);
+    block->buffer = NULL;
+    if (!spilled) {
+      g_hash_table_remove (src->blocks, &block->index);
+      g_slice_free (GstSoupHTTPSrcBlock, block);
+    }
+  }
+}
+
+static void
+gst_soup_http_src_cache_insert (GstSoupHTTPSrc * src,
+    GstSoupHTTPSrcBlock * block)
+{
+  g_queue_push_head_link (&src->cache_lru, &block->link);
+  block->in_memory = TRUE;
+  src->cache_used += block->size;
+  gst_soup_http_src_cache_evict (src);
+}
+
+/* Reads a spilled block back into memory. Frees the block on failure. */
+static gboolean
+gst_soup_http_src_block_unspill (GstSoupHTTPSrc * src,
+    GstSoupHTTPSrcBlock * block)
+{
+  GstBuffer *buf = gst_buffer_new_and_alloc (block->size);
+
+  if (!gst_soup_http_src_spill_seek (src, block->offset) ||
+      fread (GST_BUFFER_DATA (buf), 1, block->size,
+          src->spill_file) != block->size) {
+    GST_WARNING_OBJECT (src, "failed to read block %" G_GUINT64_FORMAT
+        " from the spill file", block->index);
+    gst_buffer_unref (buf);
+    gst_soup_http_src_block_free (block);
+    return FALSE;
+  }
+
+  GST_LOG_OBJECT (src, "read block %" G_GUINT64_FORMAT " from the spill file",
+      block->index);
+  block->buffer = buf;
+  gst_soup_http_src_cache_insert (src, block);
+  return TRUE;
+}
+
+static gboolean
+gst_soup_http_src_block_status_ok (GstSoupHTTPSrcBlock * block,
+    SoupMessage * msg)
+{
+  /* A server may answer a range covering everything with the whole body. */
+  return msg->status_code == SOUP_STATUS_PARTIAL_CONTENT ||
+      (msg->status_code == SOUP_STATUS_OK && block->offset == 0 &&
+      block->size == block->src->content_size);
+}
+
+static void
+gst_soup_http_src_block_got_chunk_cb (SoupMessage * msg, SoupBuffer * chunk,
+    GstSoupHTTPSrcBlock * block)
+{
+  gsize length;
+
+  /* Redirection and error bodies. */
+  if (!gst_soup_http_src_block_status_ok (block, msg))
+    return;
+
+  length = MIN (chunk->length, block->size - block->filled);
+  memcpy (GST_BUFFER_DATA (block->buffer) + block->filled, chunk->data,
+      length);
+  block->filled += length;
+}
+
+static void
+gst_soup_http_src_block_cb (SoupSession * session, SoupMessage * msg,
+    GstSoupHTTPSrcBlock * block)
+{
+  GstSoupHTTPSrc *src = block->src;
+
+  block->msg = NULL;
+  src->in_flight--;
+
+  if (msg->status_code == SOUP_STATUS_CANCELLED) {
+    GST_DEBUG_OBJECT (src, "request for block %" G_GUINT64_FORMAT
+        " cancelled", block->index);
+    gst_soup_http_src_block_free (block);
+  } else if (!gst_soup_http_src_block_status_ok (block, msg)) {
+    gst_soup_http_src_parse_status (msg, src);
+    if (src->ret != GST_FLOW_ERROR) {
+      GST_ELEMENT_ERROR (src, RESOURCE, SEEK,
+          (_("Server does not support seeking.")),
+          ("Server does not accept Range HTTP header, URL: %s",
+              src->location));
+      src->ret = GST_FLOW_ERROR;
+    }
+    gst_soup_http_src_block_free (block);
+  } else if (block->filled < block->size) {
+    SOUP_HTTP_SRC_ERROR (src, msg, RESOURCE, READ,
+        _("Server sent bad data."));
+    src->ret = GST_FLOW_ERROR;
+    gst_soup_http_src_block_free (block);
+  } else {
+    GST_LOG_OBJECT (src, "got block %" G_GUINT64_FORMAT, block->index);
+    gst_soup_http_src_cache_insert (src, block);
+  }
+
+  if (src->loop)
+    g_main_loop_quit (src->loop);
+}
+
+static gboolean
+gst_soup_http_src_request_block (GstSoupHTTPSrc * src, guint64 index)
+{
+  GstSoupHTTPSrcBlock *block;
+  SoupMessage *msg;
+  gchar buf[64];
+
+  msg = soup_message_new (SOUP_METHOD_GET, src->location);
+  if (!msg) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+        ("Error parsing URL."), ("URL: %s", src->location));
+    return FALSE;
+  }
+
+  block = g_slice_new0 (GstSoupHTTPSrcBlock);
+  block->src = src;
+  block->index = index;
+  block->offset = index * src->cache_block_size;
+  block->size = MIN (src->cache_block_size,
+      src->content_size - block->offset);
+  block->msg = msg;
+  block->buffer = gst_buffer_new_and_alloc (block->size);
+  block->link.data = block;
+
+  GST_LOG_OBJECT (src, "requesting block %" G_GUINT64_FORMAT, index);
+
+  g_snprintf (buf, sizeof (buf), "bytes=%" G_GUINT64_FORMAT "-%"
+      G_GUINT64_FORMAT, block->offset, block->offset + block->size - 1);
+  soup_message_headers_append (msg->request_headers, "Range", buf);
+  if (src->cookies) {
+    gchar **cookie;
+
+    for (cookie = src->cookies; *cookie != NULL; cookie++) {
+      soup_message_headers_append (msg->request_headers, "Cookie", *cookie);
+    }
+  }
+  gst_soup_http_src_add_extra_headers (src, msg);
+
+  g_signal_connect (msg, "got_chunk",
+      G_CALLBACK (gst_soup_http_src_block_got_chunk_cb), block);
+  soup_message_set_flags (msg, SOUP_MESSAGE_OVERWRITE_CHUNKS |
+      (src->automatic_redirect ? 0 : SOUP_MESSAGE_NO_REDIRECT));
+
+  g_hash_table_insert (src->blocks, &block->index, block);
+  src->in_flight++;
+  soup_session_queue_message (src->session, msg,
+      (SoupSessionCallback) gst_soup_http_src_block_cb, block);
+
+  return TRUE;
+}
+
+/* Cancels the requests in flight for blocks before @first or from @last on,
+ * which a seek left behind. */
+static void
+gst_soup_http_src_cancel_blocks (GstSoupHTTPSrc * src, guint64 first,
+    guint64 last)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GSList *cancel = NULL, *walk;
+
+  g_hash_table_iter_init (&iter, src->blocks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GstSoupHTTPSrcBlock *block = value;
+
+    if (block->msg && (block->index < first || block->index >= last))
+      cancel = g_slist_prepend (cancel, block->msg);
+  }
+
+  /* This frees the blocks from gst_soup_http_src_block_cb(). */
+  for (walk = cancel; walk; walk = walk->next)
+    soup_session_cancel_message (src->session, walk->data,
+        SOUP_STATUS_CANCELLED);
+  g_slist_free (cancel);
+}
+
+/* Requests the blocks from @index on that aren't cached yet, up to
+ * parallel-requests in flight. */
+static gboolean
+gst_soup_http_src_prefetch (GstSoupHTTPSrc * src, guint64 index)
+{
+  guint64 n_blocks, last;
+
+  n_blocks = (src->content_size + src->cache_block_size - 1) /
+      src->cache_block_size;
+  last = MIN (index + src->parallel_requests, n_blocks);
+
+  for (; index < last && src->in_flight < src->parallel_requests; index++) {
+    if (g_hash_table_lookup (src->blocks, &index) == NULL &&
+        !gst_soup_http_src_request_block (src, index))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_soup_http_src_create_cached (GstSoupHTTPSrc * src, GstBuffer ** outbuf)
+{
+  GstBaseSrc *basesrc = GST_BASE_SRC_CAST (src);
+  GstSoupHTTPSrcBlock *block;
+  guint64 index, offset;
+  gboolean hit = TRUE;
+
+  if (src->msg) {
+    GST_DEBUG_OBJECT (src, "switching to Range requests of %u bytes",
+        src->cache_block_size);
+    gst_soup_http_src_cancel_message (src);
+  }
+
+  if (src->request_position >= src->content_size) {
+    GST_DEBUG_OBJECT (src, "EOS reached");
+    return GST_FLOW_UNEXPECTED;
+  }
+  src->read_position = src->request_position;
+  index = src->read_position / src->cache_block_size;
+
+  /* Let the requests in flight make progress without blocking. */
+  src->ret = GST_FLOW_OK;
+  while (g_main_context_iteration (src->context, FALSE));
+
+  while (TRUE) {
+    if (src->ret != GST_FLOW_OK)
+      return src->ret;
+    if (src->interrupted) {
+      GST_DEBUG_OBJECT (src, "interrupted");
+      return GST_FLOW_WRONG_STATE;
+    }
+
+    block = g_hash_table_lookup (src->blocks, &index);
+    if (block == NULL) {
+      hit = FALSE;
+      if (src->in_flight >= src->parallel_requests)
+        gst_soup_http_src_cancel_blocks (src, index,
+            index + src->parallel_requests);
+      if (!gst_soup_http_src_request_block (src, index))
+        return GST_FLOW_ERROR;
+    } else if (block->in_memory) {
+      g_queue_unlink (&src->cache_lru, &block->link);
+      g_queue_push_head_link (&src->cache_lru, &block->link);
+      break;
+    } else if (block->msg == NULL) {
+      if (gst_soup_http_src_block_unspill (src, block))
+        break;
+      continue;
+    } else {
+      hit = FALSE;
+    }
+
+    if (!gst_soup_http_src_prefetch (src, index))
+      return GST_FLOW_ERROR;
+    g_main_loop_run (src->loop);
+  }
+
+  GST_OBJECT_LOCK (src);
+  if (hit)
+    src->cache_hits++;
+  else
+    src->cache_misses++;
+  GST_OBJECT_UNLOCK (src);
+
+  offset = src->read_position - block->offset;
+  *outbuf = gst_buffer_create_sub (block->buffer, offset,
+      block->size - offset);
+  GST_BUFFER_OFFSET (*outbuf) = src->read_position;
+  gst_buffer_set_caps (*outbuf,
+      (src->src_caps) ? src->src_caps :
+      GST_PAD_CAPS (GST_BASE_SRC_PAD (basesrc)));
+
+  src->read_position += GST_BUFFER_SIZE (*outbuf);
+  src->request_position = src->read_position;
+
+  if (!gst_soup_http_src_prefetch (src, index + 1)) {
+    gst_buffer_unref (*outbuf);
+    *outbuf = NULL;
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_soup_http_src_cache_flush (GstSoupHTTPSrc * src)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, src->blocks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GstSoupHTTPSrcBlock *block = value;
+
+    if (block->buffer)
+      gst_buffer_unref (block->buffer);
+    g_slice_free (GstSoupHTTPSrcBlock, block);
+  }
+  g_hash_table_remove_all (src->blocks);
+  g_queue_init (&src->cache_lru);
+  src->cache_used = 0;
+  src->in_flight = 0;
+}
+
+static void
+gst_soup_http_src_cache_clear (GstSoupHTTPSrc * src)
+{
+  gst_soup_http_src_cache_flush (src);
+
+  if (src->spill_file) {
+    fclose (src->spill_file);
+    src->spill_file = NULL;
+  }
+  if (src->spill_file_path)
+    g_remove (src->spill_file_path);
+  g_free (src->spill_file_path);
+  src->spill_file_path = NULL;
+}
+
 static gboolean
 gst_soup_http_src_start (GstBaseSrc * bsrc)
 {
@@ -1253,41 +2043,92 @@ gst_soup_http_src_start (GstBaseSrc * bsrc)
     return FALSE;
   }
 
-  src->context = g_main_context_new ();
-
-  src->loop = g_main_loop_new (src->context, TRUE);
-  if (!src->loop) {
-    GST_ELEMENT_ERROR (src, LIBRARY, INIT,
-        (NULL), ("Failed to start GMainLoop"));
-    g_main_context_unref (src->context);
-    return FALSE;
-  }
+  if (src->keep_alive && gst_soup_http_src_take_idle_session (src)) {
+    GST_DEBUG_OBJECT (src, "reusing the session of a stopped element");
+  } else {
+    src->context = g_main_context_new ();
 
-  if (src->proxy == NULL) {
-    src->session =
-        soup_session_async_new_with_options (SOUP_SESSION_ASYNC_CONTEXT,
-        src->context, SOUP_SESSION_USER_AGENT, src->user_agent,
-        SOUP_SESSION_TIMEOUT, src->timeout,
+    if (src->proxy == NULL) {
+      src->session =
+          soup_session_async_new_with_options (SOUP_SESSION_ASYNC_CONTEXT,
+          src->context, SOUP_SESSION_USER_AGENT, src->user_agent,
+          SOUP_SESSION_TIMEOUT, src->timeout,
 #ifdef HAVE_LIBSOUP_GNOME
-        SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_PROXY_RESOLVER_GNOME,
+          SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_PROXY_RESOLVER_GNOME,
 #endif
-        NULL);
-  } else {
-    src->session =
-        soup_session_async_new_with_options (SOUP_SESSION_ASYNC_CONTEXT,
-        src->context, SOUP_SESSION_PROXY_URI, src->proxy,
-        SOUP_SESSION_TIMEOUT, src->timeout,
-        SOUP_SESSION_USER_AGENT, src->user_agent, NULL);
+          NULL);
+    } else {
+      src->session =
+          soup_session_async_new_with_options (SOUP_SESSION_ASYNC_CONTEXT,
+          src->context, SOUP_SESSION_PROXY_URI, src->proxy,
+          SOUP_SESSION_TIMEOUT, src->timeout,
+          SOUP_SESSION_USER_AGENT, src->user_agent, NULL);
+    }
+
+    if (!src->session) {
+      GST_ELEMENT_ERROR (src, LIBRARY, INIT,
+          (NULL), ("Failed to create async session"));
+      g_main_context_unref (src->context);
+      src->context = NULL;
+      return FALSE;
+    }
   }
 
-  if (!src->session) {
+  src->loop = g_main_loop_new (src->context, TRUE);
+  if (!src->loop) {
     GST_ELEMENT_ERROR (src, LIBRARY, INIT,
-        (NULL), ("Failed to create async session"));
+        (NULL), ("Failed to start GMainLoop"));
+    gst_soup_http_src_session_close (src);
+    if (src->context)
+      g_main_context_unref (src->context);
+    src->context = NULL;
     return FALSE;
   }
 
   g_signal_connect (src->session, "authenticate",
       G_CALLBACK (gst_soup_http_src_authenticate_cb), src);
+
+  if (src->parallel_requests > 0) {
+    /* A connection for each block request and one for the first request. */
+    g_object_set (src->session,
+        SOUP_SESSION_MAX_CONNS, src->parallel_requests + 1,
+        SOUP_SESSION_MAX_CONNS_PER_HOST, src->parallel_requests + 1, NULL);
+
+    if (src->cache_location) {
+      gint fd;
+
+      /* a new file that nobody else can have opened or linked to */
+      src->spill_file_path = g_build_filename (src->cache_location,
+          "souphttpsrc-XXXXXX", NULL);
+      fd = g_mkstemp (src->spill_file_path);
+      if (fd < 0 || !(src->spill_file = fdopen (fd, "w+b"))) {
+        GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ_WRITE,
+            ("Could not open temporary file \"%s\"", src->spill_file_path),
+            GST_ERROR_SYSTEM);
+        if (fd >= 0) {
+          close (fd);
+          g_unlink (src->spill_file_path);
+        }
+        g_free (src->spill_file_path);
+        src->spill_file_path = NULL;
+        gst_soup_http_src_session_close (src);
+        return FALSE;
+      }
+
+      /* only the open file is used, unlink it now so that it can't be left
+       * behind. Where open files can't be unlinked, it is removed on stop. */
+      if (g_unlink (src->spill_file_path) == 0) {
+        g_free (src->spill_file_path);
+        src->spill_file_path = NULL;
+      }
+    }
+  }
+
+  GST_OBJECT_LOCK (src);
+  src->cache_hits = 0;
+  src->cache_misses = 0;
+  GST_OBJECT_UNLOCK (src);
+
   return TRUE;
 }
 
@@ -1299,10 +2140,14 @@ gst_soup_http_src_stop (GstBaseSrc * bsrc)
   src = GST_SOUP_HTTP_SRC (bsrc);
   GST_DEBUG_OBJECT (src, "stop()");
   gst_soup_http_src_session_close (src);
+  gst_soup_http_src_cache_clear (src);
   if (src->loop) {
     g_main_loop_unref (src->loop);
-    g_main_context_unref (src->context);
     src->loop = NULL;
+  }
+  /* Gone with the session in keep-alive mode. */
+  if (src->context) {
+    g_main_context_unref (src->context);
     src->context = NULL;
   }
   if (src->extra_headers) {
@@ -1364,7 +2209,8 @@ gst_soup_http_src_is_seekable (GstBaseSrc * bsrc)
 {
   GstSoupHTTPSrc *src = GST_SOUP_HTTP_SRC (bsrc);
 
-  return src->seekable;
+  /* A flushing seek starts reading a new location in keep-alive mode. */
+  return src->seekable || src->location_changed;
 }
 
 static gboolean
@@ -1374,6 +2220,12 @@ gst_soup_http_src_do_seek (GstBaseSrc * bsrc, GstSegment * segment)
 
   GST_DEBUG_OBJECT (src, "do_seek(%" G_GUINT64_FORMAT ")", segment->start);
 
+  if (src->location_changed) {
+    /* The new location is read from here on. */
+    src->request_position = segment->start;
+    return TRUE;
+  }
+
   if (src->read_position == segment->start) {
     GST_DEBUG_OBJECT (src, "Seeking to current read position");
     return TRUE;
@@ -1429,6 +2281,10 @@ gst_soup_http_src_set_location (GstSoupHTTPSrc * src, const gchar * uri)
   }
   src->location = g_strdup (uri);
 
+  /* Picked up by the next create(), see gst_soup_http_src_switch_location() */
+  if (src->keep_alive && src->session)
+    src->location_changed = TRUE;
+
   return TRUE;
 }
 
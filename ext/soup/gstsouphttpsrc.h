@@ -18,6 +18,7 @@
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 #include <glib.h>
+#include <stdio.h>
 
 G_BEGIN_DECLS
 
@@ -43,6 +44,7 @@ typedef enum {
   GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_QUEUED,
   GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_RUNNING,
   GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_CANCELLED,
+  GST_SOUP_HTTP_SRC_SESSION_IO_STATUS_FINISHED,
 } GstSoupHTTPSrcSessionIOStatus;
 
 struct _GstSoupHTTPSrc {
@@ -87,6 +89,24 @@ struct _GstSoupHTTPSrc {
   GstStructure *extra_headers;
 
   guint timeout;
+
+  gboolean keep_alive;         /* Reuse connections for the next request. */
+  gboolean location_changed;   /* New location while running. */
+
+  /* Range-parallel download and block cache. */
+  guint parallel_requests;     /* Range requests kept in flight. */
+  guint cache_block_size;      /* Size of a cached block. */
+  guint64 cache_size;          /* Bytes of blocks kept in memory. */
+  gchar *cache_location;       /* Directory for the spill file. */
+  gboolean accept_ranges;      /* Server accepts Range requests. */
+  GHashTable *blocks;          /* Requested and cached blocks by index. */
+  GQueue cache_lru;            /* Blocks in memory, most recent first. */
+  guint64 cache_used;          /* Bytes of blocks in memory. */
+  guint in_flight;             /* Block requests in flight. */
+  FILE *spill_file;            /* Blocks pushed out of memory. */
+  gchar *spill_file_path;      /* Set while the spill file is linked. */
+  guint64 cache_hits;
+  guint64 cache_misses;
 };
 
 struct _GstSoupHTTPSrcClass {
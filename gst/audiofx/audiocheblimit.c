@@ -382,11 +382,12 @@ generate_coefficients (GstAudioChebLimit * filter)
   /* Calculate coefficients for the chebyshev filter */
   {
     gint np = filter->poles;
-    gdouble *a, *b;
+    gdouble *a, *b, *biquads;
     gint i, p;
 
     a = g_new0 (gdouble, np + 3);
     b = g_new0 (gdouble, np + 3);
+    biquads = g_new (gdouble, 5 * (np / 2));
 
     /* Calculate transfer function coefficients */
     a[2] = 1.0;
@@ -399,6 +400,14 @@ generate_coefficients (GstAudioChebLimit * filter)
 
       generate_biquad_coefficients (filter, p, &a0, &a1, &a2, &b1, &b2);
 
+      /* the sections are used for filtering, the complete transfer
+       * function only to calculate the gain */
+      biquads[5 * (p - 1) + 0] = a0;
+      biquads[5 * (p - 1) + 1] = a1;
+      biquads[5 * (p - 1) + 2] = a2;
+      biquads[5 * (p - 1) + 3] = b1;
+      biquads[5 * (p - 1) + 4] = b2;
+
       memcpy (ta, a, sizeof (gdouble) * (np + 3));
       memcpy (tb, b, sizeof (gdouble) * (np + 3));
 
@@ -440,11 +449,11 @@ generate_coefficients (GstAudioChebLimit * filter)
       for (i = 0; i <= np; i++) {
         a[i] /= gain;
       }
+      for (i = 0; i < 3; i++) {
+        biquads[i] /= gain;
+      }
     }
 
-    gst_audio_fx_base_iir_filter_set_coefficients (GST_AUDIO_FX_BASE_IIR_FILTER
-        (filter), a, np + 1, b, np + 1);
-
     GST_LOG_OBJECT (filter,
         "Generated IIR coefficients for the Chebyshev filter");
     GST_LOG_OBJECT (filter,
@@ -472,6 +481,12 @@ generate_coefficients (GstAudioChebLimit * filter)
         20.0 * log10 (gst_audio_fx_base_iir_filter_calculate_gain (a, np + 1, b,
                 np + 1, -1.0, 0.0)),
         GST_AUDIO_FILTER (filter)->format.rate / 2);
+
+    g_free (a);
+    g_free (b);
+
+    gst_audio_fx_base_iir_filter_set_biquads (GST_AUDIO_FX_BASE_IIR_FILTER
+        (filter), biquads, np / 2);
   }
 }
 
@@ -26,22 +26,35 @@
  * a expander does the same for all samples below a specific threshold. If
  * soft-knee mode is selected the ratio is applied smoothly.
  *
+ * By default the ratio is applied to every sample on its own. If the attack
+ * or release time is set, the gain is instead calculated from the envelope of
+ * every channel, which rises with the attack time and falls with the release
+ * time, and is applied smoothly to the samples. With a lookahead time the
+ * samples are delayed by that time, so that the gain already changes before
+ * a peak arrives and only recovers after all of it has passed. The lookahead
+ * is reported as latency of the element. The silence the delay line starts
+ * with is dropped and the buffers are timestamped with the time of the
+ * delayed samples they contain, the last samples are pushed out at the end of
+ * the stream.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
  * gst-launch audiotestsrc wave=saw ! audiodynamic characteristics=soft-knee mode=compressor threshold=0.5 rate=0.5 ! alsasink
  * gst-launch filesrc location="melo1.ogg" ! oggdemux ! vorbisdec ! audioconvert ! audiodynamic characteristics=hard-knee mode=expander threshold=0.2 rate=4.0 ! alsasink
  * gst-launch audiotestsrc wave=saw ! audioconvert ! audiodynamic ! audioconvert ! alsasink
+ * gst-launch filesrc location="melo1.ogg" ! oggdemux ! vorbisdec ! audioconvert ! audiodynamic threshold=0.3 ratio=0.25 attack=5000000 release=100000000 lookahead=5000000 ! audioconvert ! alsasink
  * ]|
  * </refsect2>
  */
 
-/* TODO: Implement attack and release parameters */
-
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <math.h>
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 #include <gst/audio/audio.h>
@@ -66,9 +79,20 @@ enum
   PROP_CHARACTERISTICS,
   PROP_MODE,
   PROP_THRESHOLD,
-  PROP_RATIO
+  PROP_RATIO,
+  PROP_ATTACK,
+  PROP_RELEASE,
+  PROP_LOOKAHEAD
 };
 
+#define DEFAULT_ATTACK 0
+#define DEFAULT_RELEASE 0
+#define DEFAULT_LOOKAHEAD 0
+#define MAX_LOOKAHEAD GST_SECOND
+
+/* Frames that are processed at once by the envelope follower */
+#define ENVELOPE_BLOCK_FRAMES 256
+
 #define ALLOWED_CAPS \
     "audio/x-raw-int,"                                                \
     " depth=(int)16,"                                                 \
@@ -94,10 +118,17 @@ static void gst_audio_dynamic_set_property (GObject * object, guint prop_id,
 static void gst_audio_dynamic_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
+static void gst_audio_dynamic_finalize (GObject * object);
+
 static gboolean gst_audio_dynamic_setup (GstAudioFilter * filter,
     GstRingBufferSpec * format);
 static GstFlowReturn gst_audio_dynamic_transform_ip (GstBaseTransform * base,
     GstBuffer * buf);
+static gboolean gst_audio_dynamic_stop (GstBaseTransform * base);
+static gboolean gst_audio_dynamic_event (GstBaseTransform * base,
+    GstEvent * event);
+static gboolean gst_audio_dynamic_query (GstPad * pad, GstQuery * query);
+static const GstQueryType *gst_audio_dynamic_query_type (GstPad * pad);
 
 static void
 gst_audio_dynamic_transform_hard_knee_compressor_int (GstAudioDynamic * filter,
@@ -236,6 +267,7 @@ gst_audio_dynamic_class_init (GstAudioDynamicClass * klass)
   gobject_class = (GObjectClass *) klass;
   gobject_class->set_property = gst_audio_dynamic_set_property;
   gobject_class->get_property = gst_audio_dynamic_get_property;
+  gobject_class->finalize = gst_audio_dynamic_finalize;
 
   g_object_class_install_property (gobject_class, PROP_CHARACTERISTICS,
       g_param_spec_enum ("characteristics", "Characteristics",
@@ -263,10 +295,58 @@ gst_audio_dynamic_class_init (GstAudioDynamicClass * klass)
           1.0,
           G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAudioDynamic:attack:
+   *
+   * Time in nanoseconds in which the envelope follows rising levels. If
+   * this, the release or the lookahead time is set the gain is calculated
+   * from the envelope instead of from every single sample.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_ATTACK,
+      g_param_spec_uint64 ("attack", "Attack",
+          "Attack time of the envelope in nanoseconds (0 = follow peaks "
+          "immediately)", 0, G_MAXUINT64, DEFAULT_ATTACK,
+          G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAudioDynamic:release:
+   *
+   * Time in nanoseconds in which the envelope follows falling levels.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_RELEASE,
+      g_param_spec_uint64 ("release", "Release",
+          "Release time of the envelope in nanoseconds (0 = follow the "
+          "level immediately)", 0, G_MAXUINT64, DEFAULT_RELEASE,
+          G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstAudioDynamic:lookahead:
+   *
+   * Time in nanoseconds by which the samples are delayed before the gain
+   * is applied, so that the gain can already change before a peak arrives.
+   * This is the latency of the element and can only be changed in states
+   * lower than PAUSED.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_LOOKAHEAD,
+      g_param_spec_uint64 ("lookahead", "Lookahead",
+          "Lookahead time in nanoseconds, adds the same latency",
+          0, MAX_LOOKAHEAD, DEFAULT_LOOKAHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   GST_AUDIO_FILTER_CLASS (klass)->setup =
       GST_DEBUG_FUNCPTR (gst_audio_dynamic_setup);
   GST_BASE_TRANSFORM_CLASS (klass)->transform_ip =
       GST_DEBUG_FUNCPTR (gst_audio_dynamic_transform_ip);
+  GST_BASE_TRANSFORM_CLASS (klass)->stop =
+      GST_DEBUG_FUNCPTR (gst_audio_dynamic_stop);
+  GST_BASE_TRANSFORM_CLASS (klass)->event =
+      GST_DEBUG_FUNCPTR (gst_audio_dynamic_event);
 }
 
 static void
@@ -276,8 +356,52 @@ gst_audio_dynamic_init (GstAudioDynamic * filter, GstAudioDynamicClass * klass)
   filter->threshold = 0.0;
   filter->characteristics = CHARACTERISTICS_HARD_KNEE;
   filter->mode = MODE_COMPRESSOR;
+  filter->attack = DEFAULT_ATTACK;
+  filter->release = DEFAULT_RELEASE;
+  filter->lookahead = DEFAULT_LOOKAHEAD;
+  filter->next_timestamp = GST_CLOCK_TIME_NONE;
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
   gst_base_transform_set_gap_aware (GST_BASE_TRANSFORM (filter), TRUE);
+
+  gst_pad_set_query_function (GST_BASE_TRANSFORM (filter)->srcpad,
+      gst_audio_dynamic_query);
+  gst_pad_set_query_type_function (GST_BASE_TRANSFORM (filter)->srcpad,
+      gst_audio_dynamic_query_type);
+}
+
+static void
+gst_audio_dynamic_free_envelope (GstAudioDynamic * filter)
+{
+  g_free (filter->envelope);
+  filter->envelope = NULL;
+  g_free (filter->delay);
+  filter->delay = NULL;
+  g_free (filter->block);
+  filter->block = NULL;
+  g_free (filter->gain);
+  filter->gain = NULL;
+  g_free (filter->hold_gain);
+  filter->hold_gain = NULL;
+  g_free (filter->hold_frame);
+  filter->hold_frame = NULL;
+  g_free (filter->hold_head);
+  filter->hold_head = NULL;
+  g_free (filter->hold_len);
+  filter->hold_len = NULL;
+  filter->lookahead_frames = 0;
+  filter->skip_frames = 0;
+  filter->frames = 0;
+  filter->next_timestamp = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_audio_dynamic_finalize (GObject * object)
+{
+  GstAudioDynamic *filter = GST_AUDIO_DYNAMIC (object);
+
+  gst_audio_dynamic_free_envelope (filter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -301,6 +425,20 @@ gst_audio_dynamic_set_property (GObject * object, guint prop_id,
     case PROP_RATIO:
       filter->ratio = g_value_get_float (value);
       break;
+    case PROP_ATTACK:
+      filter->attack = g_value_get_uint64 (value);
+      break;
+    case PROP_RELEASE:
+      filter->release = g_value_get_uint64 (value);
+      break;
+    case PROP_LOOKAHEAD:
+      if (GST_STATE (filter) >= GST_STATE_PAUSED) {
+        g_warning ("Changing the \"lookahead\" property "
+            "is only allowed in states < PAUSED");
+        return;
+      }
+      filter->lookahead = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -326,6 +464,15 @@ gst_audio_dynamic_get_property (GObject * object, guint prop_id,
     case PROP_RATIO:
       g_value_set_float (value, filter->ratio);
       break;
+    case PROP_ATTACK:
+      g_value_set_uint64 (value, filter->attack);
+      break;
+    case PROP_RELEASE:
+      g_value_set_uint64 (value, filter->release);
+      break;
+    case PROP_LOOKAHEAD:
+      g_value_set_uint64 (value, filter->lookahead);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -342,6 +489,9 @@ gst_audio_dynamic_setup (GstAudioFilter * base, GstRingBufferSpec * format)
 
   ret = gst_audio_dynamic_set_process_function (filter);
 
+  /* the envelope state depends on the channels and rate */
+  gst_audio_dynamic_free_envelope (filter);
+
   return ret;
 }
 
@@ -689,6 +839,371 @@ gst_audio_dynamic_transform_soft_knee_expander_float (GstAudioDynamic * filter,
   }
 }
 
+/* Envelope follower
+ *
+ * The envelope of every channel rises with the attack and falls with the
+ * release coefficient. The gain for the envelope is the static curve of the
+ * selected mode and characteristics, normalized to [-1.0, 1.0], divided by
+ * the envelope. With a lookahead it is applied to the samples from the
+ * lookahead time before, and every sample gets the smallest gain of the
+ * lookahead window that follows it. So a raising gain reduction starts before
+ * the peak arrives, and the end of the peak is reduced as much as the rest.
+ * The samples are kept in a circular delay line and the smallest gains are
+ * found with an increasing queue of gains per channel, which costs the same
+ * for any lookahead time.
+ *
+ * The envelope and the gains are calculated on blocks of floats with the
+ * channels in the inner loops and without branches in the loops, so that
+ * the compiler can vectorize them even for many channels. */
+
+static gfloat
+gst_audio_dynamic_coefficient (guint64 time, gint rate)
+{
+  if (time == 0 || rate == 0)
+    return 0.0;
+
+  /* time constant, the envelope reaches 1 - 1/e of a step in @time */
+  return exp (-((gdouble) GST_SECOND) / ((gdouble) time * rate));
+}
+
+static gboolean
+gst_audio_dynamic_use_envelope (GstAudioDynamic * filter)
+{
+  return filter->attack > 0 || filter->release > 0 || filter->lookahead > 0;
+}
+
+static guint
+gst_audio_dynamic_get_lookahead_frames (GstAudioDynamic * filter)
+{
+  return gst_util_uint64_scale_round (filter->lookahead,
+      GST_AUDIO_FILTER (filter)->format.rate, GST_SECOND);
+}
+
+static void
+gst_audio_dynamic_reset_envelope (GstAudioDynamic * filter)
+{
+  gint channels = GST_AUDIO_FILTER (filter)->format.channels;
+
+  filter->frames = 0;
+  filter->skip_frames = filter->lookahead_frames;
+  filter->next_timestamp = GST_CLOCK_TIME_NONE;
+
+  if (filter->envelope == NULL)
+    return;
+
+  memset (filter->envelope, 0, channels * sizeof (gfloat));
+  if (filter->delay)
+    memset (filter->delay, 0,
+        filter->lookahead_frames * channels * sizeof (gfloat));
+  filter->delay_pos = 0;
+  memset (filter->hold_len, 0, channels * sizeof (guint));
+}
+
+static void
+gst_audio_dynamic_alloc_envelope (GstAudioDynamic * filter)
+{
+  gint channels = GST_AUDIO_FILTER (filter)->format.channels;
+  guint hold;
+
+  filter->lookahead_frames = gst_audio_dynamic_get_lookahead_frames (filter);
+  filter->skip_frames = filter->lookahead_frames;
+  hold = filter->lookahead_frames + 1;
+
+  filter->envelope = g_new0 (gfloat, channels);
+  if (filter->lookahead_frames > 0)
+    filter->delay = g_new0 (gfloat, filter->lookahead_frames * channels);
+  filter->delay_pos = 0;
+  filter->block = g_new0 (gfloat, ENVELOPE_BLOCK_FRAMES * channels);
+  filter->gain = g_new0 (gfloat, ENVELOPE_BLOCK_FRAMES * channels);
+  filter->hold_gain = g_new0 (gfloat, hold * channels);
+  filter->hold_frame = g_new0 (guint64, hold * channels);
+  filter->hold_head = g_new0 (guint, channels);
+  filter->hold_len = g_new0 (guint, channels);
+}
+
+/* Replaces the @n envelope values in @env by the gains for them */
+static void
+gst_audio_dynamic_calculate_gains (GstAudioDynamic * filter, gfloat * env,
+    guint n)
+{
+  gfloat t = filter->threshold, r = filter->ratio;
+  gfloat a, b, c, zero, e, f;
+  guint i;
+
+  if (filter->ratio == 1.0 ||
+      (filter->mode == MODE_EXPANDER && filter->threshold == 0.0)) {
+    for (i = 0; i < n; i++)
+      env[i] = 1.0;
+    return;
+  }
+
+  /* See the per-sample functions above for the curves. The envelope is
+   * never smaller than a tiny value, which gives the limit of the gain for
+   * silence without dividing by zero */
+  if (filter->mode == MODE_COMPRESSOR) {
+    if (filter->characteristics == CHARACTERISTICS_HARD_KNEE) {
+      for (i = 0; i < n; i++) {
+        e = MAX (env[i], 1e-9f);
+        f = e - MAX (e - t, 0.0f) * (1.0f - r);
+        env[i] = f / e;
+      }
+    } else {
+      if (t == 1.0)
+        t = 1.0 + 0.00001;
+      a = (1.0 - r) / (2.0 * (t - 1.0));
+      b = (r * t - 1.0) / (t - 1.0);
+      c = t * (1.0 - b - a * t);
+
+      for (i = 0; i < n; i++) {
+        e = MAX (env[i], 1e-9f);
+        f = (e > 1.0f) ? 1.0f + (e - 1.0f) * r :
+            ((e > t) ? (a * e + b) * e + c : e);
+        env[i] = f / e;
+      }
+    }
+  } else {
+    if (filter->characteristics == CHARACTERISTICS_HARD_KNEE) {
+      zero = (r != 0.0) ? MAX (t - t / r, 0.0) : 0.0;
+
+      for (i = 0; i < n; i++) {
+        e = MAX (env[i], 1e-9f);
+        f = (e <= zero) ? 0.0f : ((e < t) ? r * e + t * (1.0f - r) : e);
+        env[i] = f / e;
+      }
+    } else {
+      zero = MAX ((t * (r - 1.0)) / (1.0 + r), 0.0);
+      a = (1.0 - r * r) / (4.0 * t);
+      b = (1.0 + r * r) / 2.0;
+      c = t * (1.0 - b - a * t);
+
+      for (i = 0; i < n; i++) {
+        e = MAX (env[i], 1e-9f);
+        f = (e <= zero) ? 0.0f : ((e < t) ? (a * e + b) * e + c : e);
+        env[i] = f / e;
+      }
+    }
+  }
+}
+
+/* Adds the @gain of @frame to the queue of channel @c and returns the
+ * smallest gain of the lookahead window that ends with it */
+static inline gfloat
+gst_audio_dynamic_hold_gain (GstAudioDynamic * filter, gint c, gfloat gain,
+    guint64 frame)
+{
+  guint size = filter->lookahead_frames + 1;
+  gfloat *gains = filter->hold_gain + c * size;
+  guint64 *frames = filter->hold_frame + c * size;
+  guint head = filter->hold_head[c], len = filter->hold_len[c], i;
+
+  /* the oldest gain leaves the window */
+  if (len > 0 && frames[head] + filter->lookahead_frames < frame) {
+    head = (head + 1 == size) ? 0 : head + 1;
+    len--;
+  }
+
+  /* gains that are not smaller than the new one can't be the smallest of
+   * any later window anymore */
+  while (len > 0) {
+    i = head + len - 1;
+    if (i >= size)
+      i -= size;
+    if (gains[i] < gain)
+      break;
+    len--;
+  }
+
+  i = head + len;
+  if (i >= size)
+    i -= size;
+  gains[i] = gain;
+  frames[i] = frame;
+
+  filter->hold_head[c] = head;
+  filter->hold_len[c] = len + 1;
+
+  return gains[head];
+}
+
+/* Processes the block of @n frames in the block buffer in place. With a
+ * lookahead the output are the samples from the delay line */
+static void
+gst_audio_dynamic_process_block (GstAudioDynamic * filter, guint n,
+    gfloat attack, gfloat release)
+{
+  gint channels = GST_AUDIO_FILTER (filter)->format.channels;
+  gfloat *env = filter->envelope, *gain = filter->gain;
+  gfloat *block = filter->block, *delay;
+  gfloat x, e, g;
+  guint i;
+  gint c;
+
+  for (i = 0; i < n * channels; i += channels) {
+    for (c = 0; c < channels; c++) {
+      x = ABS (block[i + c]);
+      e = env[c];
+      e = x + ((x > e) ? attack : release) * (e - x);
+      env[c] = e;
+      gain[i + c] = e;
+    }
+  }
+
+  /* flush denormals when the envelope decays in silence */
+  for (c = 0; c < channels; c++)
+    env[c] = (env[c] < 1e-15f) ? 0.0f : env[c];
+
+  gst_audio_dynamic_calculate_gains (filter, gain, n * channels);
+
+  if (filter->lookahead_frames == 0) {
+    for (i = 0; i < n * channels; i++)
+      block[i] *= gain[i];
+    filter->frames += n;
+    return;
+  }
+
+  for (i = 0; i < n * channels; i += channels) {
+    delay = filter->delay + filter->delay_pos * channels;
+
+    for (c = 0; c < channels; c++) {
+      g = gst_audio_dynamic_hold_gain (filter, c, gain[i + c], filter->frames);
+      x = delay[c];
+      delay[c] = block[i + c];
+      block[i + c] = x * g;
+    }
+
+    if (++filter->delay_pos == filter->lookahead_frames)
+      filter->delay_pos = 0;
+    filter->frames++;
+  }
+}
+
+#define DEFINE_ENVELOPE_PROCESS_FUNC(NAME, TYPE, TO_FLOAT, FROM_FLOAT) \
+static void \
+gst_audio_dynamic_process_envelope_##NAME (GstAudioDynamic * filter, \
+    TYPE * data, guint num_samples) \
+{ \
+  gint channels = GST_AUDIO_FILTER (filter)->format.channels; \
+  gint rate = GST_AUDIO_FILTER (filter)->format.rate; \
+  gfloat attack = gst_audio_dynamic_coefficient (filter->attack, rate); \
+  gfloat release = gst_audio_dynamic_coefficient (filter->release, rate); \
+  guint num_frames = num_samples / channels, n, i; \
+  gfloat *block = filter->block, val; \
+  \
+  while (num_frames > 0) { \
+    n = MIN (num_frames, ENVELOPE_BLOCK_FRAMES); \
+    \
+    for (i = 0; i < n * channels; i++) \
+      block[i] = TO_FLOAT (data[i]); \
+    \
+    gst_audio_dynamic_process_block (filter, n, attack, release); \
+    \
+    for (i = 0; i < n * channels; i++) { \
+      val = block[i]; \
+      data[i] = FROM_FLOAT (val); \
+    } \
+    \
+    data += n * channels; \
+    num_frames -= n; \
+  } \
+}
+
+#define INT16_TO_FLOAT(x) ((x) * (1.0f / 32768.0f))
+#define FLOAT_TO_INT16(x) ((gint16) CLAMP ((x) * 32768.0f, G_MININT16, G_MAXINT16))
+#define FLOAT_TO_FLOAT(x) (x)
+
+DEFINE_ENVELOPE_PROCESS_FUNC (int, gint16, INT16_TO_FLOAT, FLOAT_TO_INT16);
+DEFINE_ENVELOPE_PROCESS_FUNC (float, gfloat, FLOAT_TO_FLOAT, FLOAT_TO_FLOAT);
+
+static void
+gst_audio_dynamic_process_envelope (GstAudioDynamic * filter, GstBuffer * buf)
+{
+  GstAudioFilter *audiofilter = GST_AUDIO_FILTER (filter);
+  guint num_samples = GST_BUFFER_SIZE (buf) / (audiofilter->format.width / 8);
+
+  if (audiofilter->format.type == GST_BUFTYPE_FLOAT)
+    gst_audio_dynamic_process_envelope_float (filter,
+        (gfloat *) GST_BUFFER_DATA (buf), num_samples);
+  else
+    gst_audio_dynamic_process_envelope_int (filter,
+        (gint16 *) GST_BUFFER_DATA (buf), num_samples);
+}
+
+/* Drops the silence the delay line starts with from @buf and timestamps it
+ * with the time of the delayed samples in it. Returns FALSE if nothing is
+ * left of @buf */
+static gboolean
+gst_audio_dynamic_clip_delay (GstAudioDynamic * filter, GstBuffer * buf)
+{
+  GstAudioFilter *audiofilter = GST_AUDIO_FILTER (filter);
+  gint rate = audiofilter->format.rate;
+  guint bpf = audiofilter->format.channels * (audiofilter->format.width / 8);
+  guint frames = GST_BUFFER_SIZE (buf) / bpf;
+  guint skip = MIN (filter->skip_frames, frames);
+  GstClockTime timestamp = GST_BUFFER_TIMESTAMP (buf);
+  GstClockTime delay;
+
+  filter->skip_frames -= skip;
+  if (skip == frames)
+    return FALSE;
+
+  GST_BUFFER_DATA (buf) += skip * bpf;
+  GST_BUFFER_SIZE (buf) -= skip * bpf;
+  frames -= skip;
+
+  /* the samples left are delayed by the lookahead minus the dropped ones */
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    delay = gst_util_uint64_scale_int (filter->lookahead_frames - skip,
+        GST_SECOND, rate);
+    GST_BUFFER_TIMESTAMP (buf) = (timestamp > delay) ? timestamp - delay : 0;
+  }
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale_int (frames, GST_SECOND,
+      rate);
+  GST_BUFFER_OFFSET (buf) = GST_BUFFER_OFFSET_NONE;
+  GST_BUFFER_OFFSET_END (buf) = GST_BUFFER_OFFSET_NONE;
+
+  return TRUE;
+}
+
+/* Pushes the samples that are still in the delay line at EOS */
+static void
+gst_audio_dynamic_drain (GstAudioDynamic * filter)
+{
+  GstBaseTransform *base = GST_BASE_TRANSFORM (filter);
+  GstAudioFilter *audiofilter = GST_AUDIO_FILTER (filter);
+  guint frames = filter->lookahead_frames;
+  GstFlowReturn ret;
+  GstBuffer *buf;
+
+  if (filter->envelope == NULL || frames == 0 || filter->frames == 0)
+    return;
+
+  /* silence pushes the delayed samples out of the delay line */
+  buf = gst_buffer_new_and_alloc (frames * audiofilter->format.channels *
+      (audiofilter->format.width / 8));
+  memset (GST_BUFFER_DATA (buf), 0, GST_BUFFER_SIZE (buf));
+  gst_buffer_set_caps (buf, GST_PAD_CAPS (base->srcpad));
+  GST_BUFFER_TIMESTAMP (buf) = filter->next_timestamp;
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale_int (frames, GST_SECOND,
+      audiofilter->format.rate);
+
+  gst_audio_dynamic_process_envelope (filter, buf);
+  if (!gst_audio_dynamic_clip_delay (filter, buf)) {
+    gst_buffer_unref (buf);
+    gst_audio_dynamic_reset_envelope (filter);
+    return;
+  }
+  gst_audio_dynamic_reset_envelope (filter);
+
+  GST_DEBUG_OBJECT (filter, "pushing %u delayed frames",
+      GST_BUFFER_SIZE (buf) / (audiofilter->format.channels *
+          (audiofilter->format.width / 8)));
+
+  ret = gst_pad_push (base->srcpad, buf);
+  if (ret != GST_FLOW_OK)
+    GST_DEBUG_OBJECT (filter, "pushing delayed frames failed: %s",
+        gst_flow_get_name (ret));
+}
+
 /* GstBaseTransform vmethod implementations */
 static GstFlowReturn
 gst_audio_dynamic_transform_ip (GstBaseTransform * base, GstBuffer * buf)
@@ -710,11 +1225,132 @@ gst_audio_dynamic_transform_ip (GstBaseTransform * base, GstBuffer * buf)
   num_samples =
       GST_BUFFER_SIZE (buf) / (GST_AUDIO_FILTER (filter)->format.width / 8);
 
-  if (gst_base_transform_is_passthrough (base) ||
-      G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP)))
+  if (gst_base_transform_is_passthrough (base))
+    return GST_FLOW_OK;
+
+  if (gst_audio_dynamic_use_envelope (filter)) {
+    if (filter->envelope == NULL)
+      gst_audio_dynamic_alloc_envelope (filter);
+
+    /* Silence still has to go through the delay line, but stays silence
+     * without it */
+    if (filter->lookahead_frames == 0 &&
+        GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP))
+      return GST_FLOW_OK;
+    GST_BUFFER_FLAG_UNSET (buf, GST_BUFFER_FLAG_GAP);
+
+    gst_audio_dynamic_process_envelope (filter, buf);
+
+    /* the delayed samples are pushed after this buffer at EOS */
+    if (GST_CLOCK_TIME_IS_VALID (timestamp))
+      filter->next_timestamp = timestamp +
+          gst_util_uint64_scale_int (num_samples /
+          GST_AUDIO_FILTER (filter)->format.channels, GST_SECOND,
+          GST_AUDIO_FILTER (filter)->format.rate);
+
+    if (filter->lookahead_frames > 0 &&
+        !gst_audio_dynamic_clip_delay (filter, buf))
+      return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+    return GST_FLOW_OK;
+  }
+
+  if (G_UNLIKELY (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP)))
     return GST_FLOW_OK;
 
   filter->process (filter, GST_BUFFER_DATA (buf), num_samples);
 
   return GST_FLOW_OK;
 }
+
+static gboolean
+gst_audio_dynamic_stop (GstBaseTransform * base)
+{
+  GstAudioDynamic *filter = GST_AUDIO_DYNAMIC (base);
+
+  gst_audio_dynamic_free_envelope (filter);
+
+  return TRUE;
+}
+
+static gboolean
+gst_audio_dynamic_event (GstBaseTransform * base, GstEvent * event)
+{
+  GstAudioDynamic *filter = GST_AUDIO_DYNAMIC (base);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      gst_audio_dynamic_reset_envelope (filter);
+      break;
+    case GST_EVENT_EOS:
+      gst_audio_dynamic_drain (filter);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->event (base, event);
+}
+
+static gboolean
+gst_audio_dynamic_query (GstPad * pad, GstQuery * query)
+{
+  GstAudioDynamic *filter = GST_AUDIO_DYNAMIC (gst_pad_get_parent (pad));
+  gboolean res = TRUE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+    {
+      GstClockTime min, max;
+      gboolean live;
+      guint64 latency;
+      GstPad *peer;
+      gint rate = GST_AUDIO_FILTER (filter)->format.rate;
+
+      if (rate == 0) {
+        res = FALSE;
+      } else if ((peer =
+              gst_pad_get_peer (GST_BASE_TRANSFORM (filter)->sinkpad))) {
+        if ((res = gst_pad_query (peer, query))) {
+          gst_query_parse_latency (query, &live, &min, &max);
+
+          GST_DEBUG_OBJECT (filter, "Peer latency: min %"
+              GST_TIME_FORMAT " max %" GST_TIME_FORMAT,
+              GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+
+          /* add our own latency */
+          latency =
+              gst_util_uint64_scale_round (gst_audio_dynamic_get_lookahead_frames
+              (filter), GST_SECOND, rate);
+
+          GST_DEBUG_OBJECT (filter, "Our latency: %"
+              GST_TIME_FORMAT, GST_TIME_ARGS (latency));
+
+          min += latency;
+          if (max != GST_CLOCK_TIME_NONE)
+            max += latency;
+
+          gst_query_set_latency (query, live, min, max);
+        }
+        gst_object_unref (peer);
+      }
+      break;
+    }
+    default:
+      res = gst_pad_query_default (pad, query);
+      break;
+  }
+  gst_object_unref (filter);
+  return res;
+}
+
+static const GstQueryType *
+gst_audio_dynamic_query_type (GstPad * pad)
+{
+  static const GstQueryType types[] = {
+    GST_QUERY_LATENCY,
+    0
+  };
+
+  return types;
+}
@@ -51,6 +51,27 @@ struct _GstAudioDynamic
   gint mode;
   gfloat threshold;
   gfloat ratio;
+  guint64 attack;
+  guint64 release;
+  guint64 lookahead;
+
+  /* envelope follower state, allocated for the first buffer that
+   * needs it */
+  guint lookahead_frames;
+  guint skip_frames;            /* delayed silence still to drop */
+  guint64 frames;               /* frames processed since the last reset */
+  GstClockTime next_timestamp;  /* end of the last buffer */
+  gfloat *envelope;             /* one value per channel */
+  gfloat *delay;                /* circular, lookahead frames */
+  guint delay_pos;              /* oldest frame in the delay line */
+  gfloat *block;                /* one block */
+  gfloat *gain;                 /* one block */
+  /* per channel queues of lookahead + 1 increasing gains with their frame,
+   * the first is the smallest gain of the lookahead window */
+  gfloat *hold_gain;
+  guint64 *hold_frame;
+  guint *hold_head;
+  guint *hold_len;
 };
 
 struct _GstAudioDynamicClass
@@ -56,15 +56,23 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 /* Switch from time-domain to FFT convolution for kernels >= this */
 #define FFT_THRESHOLD 32
 
+/* Largest partition size that is chosen automatically, longer kernels
+ * are split into several partitions */
+#define DEFAULT_MAX_PARTITION_SIZE 4096
+
+#define MAX_PARTITION_SIZE (1 << 20)
+
 enum
 {
   PROP_0 = 0,
   PROP_LOW_LATENCY,
-  PROP_DRAIN_ON_CHANGES
+  PROP_DRAIN_ON_CHANGES,
+  PROP_PARTITION_SIZE
 };
 
 #define DEFAULT_LOW_LATENCY FALSE
 #define DEFAULT_DRAIN_ON_CHANGES TRUE
+#define DEFAULT_PARTITION_SIZE 0
 
 GST_BOILERPLATE_FULL (GstAudioFXBaseFIRFilter, gst_audio_fx_base_fir_filter,
     GstAudioFilter, GST_TYPE_AUDIO_FILTER, DEBUG_INIT);
@@ -235,6 +243,29 @@ DEFINE_PROCESS_FUNC_FIXED_CHANNELS (64, 2, double);
  *   (  N log N  )
  * O ( --------- ) compared to O (M) for the direct calculation.
  *   ( N - M + 1 )
+ *
+ * A single FFT of the size of the kernel gives a latency of at least
+ * the kernel length though, which is a lot for long kernels like room
+ * impulse responses. Because of that the kernel is split into P
+ * partitions h_0 ... h_{P-1} of B samples each (uniformly partitioned
+ * convolution):
+ *
+ * y[t] = \sum_{k=0}^{P-1} \sum_{u=0}^{B-1} x[t - kB - u] * h_k[u]
+ *
+ * Every inner sum is the convolution of h_k with the input delayed by
+ * k blocks, which is calculated with overlap-save and an FFT size of
+ * N = 2B as above. As everything is linear the sum can be done in the
+ * frequency domain, and the spectra of the last P input blocks are
+ * kept in a ring (the frequency domain delay line), so that per block
+ * of B samples only one FFT, one inverse FFT and P complex
+ * multiplications of length B + 1 are needed:
+ *
+ * y = IFFT (\sum_{k=0}^{P-1} FFT(x_{-k}) * FFT(h_k))
+ *
+ * where x_{-k} are the 2B input samples that ended k blocks ago. Of
+ * the 2B output samples the last B are valid.
+ *
+ * The latency is B samples, independent of the kernel length.
  */
 #define DEFINE_FFT_PROCESS_FUNC(width,ctype) \
 static guint \
@@ -255,52 +286,55 @@ process_fft_##channels##_##width (GstAudioFXBaseFIRFilter * self, const g##ctype
 
 #define FFT_CONVOLUTION_BODY(channels) G_STMT_START { \
   gint i, j; \
-  guint pass; \
-  guint kernel_length = self->kernel_length; \
+  guint k, slot, pass; \
   guint block_length = self->block_length; \
-  guint buffer_length = self->buffer_length; \
-  guint real_buffer_length = buffer_length + kernel_length - 1; \
+  guint fft_length = 2 * block_length; \
   guint buffer_fill = self->buffer_fill; \
+  guint partitions = self->partitions; \
+  guint fdl_pos = self->fdl_pos; \
   GstFFTF64 *fft = self->fft; \
   GstFFTF64 *ifft = self->ifft; \
   GstFFTF64Complex *frequency_response = self->frequency_response; \
   GstFFTF64Complex *fft_buffer = self->fft_buffer; \
+  GstFFTF64Complex *fdl = self->fdl; \
+  GstFFTF64Complex *spectra, *x, *h; \
   guint frequency_response_length = self->frequency_response_length; \
   gdouble *buffer = self->buffer; \
+  gdouble *window, *result; \
   guint generated = 0; \
-  gdouble re, im; \
   \
   if (!fft_buffer) \
     self->fft_buffer = fft_buffer = \
         g_new (GstFFTF64Complex, frequency_response_length); \
   \
-  /* Buffer contains the time domain samples of input data for one chunk \
-   * plus some more space for the inverse FFT below. \
+  /* Buffer contains an input window of two blocks for every channel, \
+   * the previous block followed by the one that is currently filled, \
+   * plus space for the inverse FFT below. \
    * \
-   * The samples are put at offset kernel_length, the inverse FFT \
-   * overwrites everthing from offset 0 to length-kernel_length+1, keeping \
-   * the last kernel_length-1 samples for copying to the next processing \
-   * step. \
+   * The delay line is reset together with it. \
    */ \
   if (!buffer) { \
-    self->buffer_length = buffer_length = block_length; \
-    real_buffer_length = buffer_length + kernel_length - 1; \
+    self->buffer_length = fft_length; \
+    self->buffer = buffer = g_new0 (gdouble, fft_length * (channels + 1)); \
     \
-    self->buffer = buffer = g_new0 (gdouble, real_buffer_length * channels); \
+    g_free (self->fdl); \
+    self->fdl = fdl = g_new0 (GstFFTF64Complex, \
+        frequency_response_length * partitions * channels); \
+    self->fdl_pos = fdl_pos = 0; \
     \
-    /* Beginning has kernel_length-1 zeroes at the beginning */ \
-    self->buffer_fill = buffer_fill = kernel_length - 1; \
+    self->buffer_fill = buffer_fill = 0; \
   } \
   \
-  g_assert (self->buffer_length == block_length); \
+  g_assert (self->buffer_length == fft_length); \
+  result = buffer + fft_length * channels; \
   \
   while (input_samples) { \
-    pass = MIN (buffer_length - buffer_fill, input_samples); \
+    pass = MIN (block_length - buffer_fill, input_samples); \
     \
     /* Deinterleave channels */ \
     for (i = 0; i < pass; i++) { \
       for (j = 0; j < channels; j++) { \
-        buffer[real_buffer_length * j + buffer_fill + kernel_length - 1 + i] = \
+        buffer[fft_length * j + block_length + buffer_fill + i] = \
             src[i * channels + j]; \
       } \
     } \
@@ -308,54 +342,63 @@ process_fft_##channels##_##width (GstAudioFXBaseFIRFilter * self, const g##ctype
     src += channels * pass; \
     input_samples -= pass; \
     \
-    /* If we don't have a complete buffer go out */ \
-    if (buffer_fill < buffer_length) \
+    /* If we don't have a complete block go out */ \
+    if (buffer_fill < block_length) \
       break; \
     \
+    /* The oldest spectrum in the delay line is replaced by the new one */ \
+    fdl_pos = (fdl_pos + partitions - 1) % partitions; \
+    \
     for (j = 0; j < channels; j++) { \
-      /* Calculate FFT of input block */ \
-      gst_fft_f64_fft (fft, \
-          buffer + real_buffer_length * j + kernel_length - 1, fft_buffer); \
+      window = buffer + fft_length * j; \
+      spectra = fdl + frequency_response_length * partitions * j; \
       \
-      /* Complex multiplication of input and filter spectrum */ \
-      for (i = 0; i < frequency_response_length; i++) { \
-	re = fft_buffer[i].r; \
-	im = fft_buffer[i].i; \
+      /* Calculate FFT of the input window */ \
+      gst_fft_f64_fft (fft, window, \
+          spectra + frequency_response_length * fdl_pos); \
+      \
+      /* Sum of the complex multiplications of the input spectra and the \
+       * spectra of the kernel partitions, partition k is applied to the \
+       * input spectrum of k blocks ago */ \
+      memset (fft_buffer, 0, \
+          frequency_response_length * sizeof (GstFFTF64Complex)); \
+      slot = fdl_pos; \
+      for (k = 0; k < partitions; k++) { \
+        x = spectra + frequency_response_length * slot; \
+        h = frequency_response + frequency_response_length * k; \
+        \
+        for (i = 0; i < frequency_response_length; i++) { \
+          fft_buffer[i].r += x[i].r * h[i].r - x[i].i * h[i].i; \
+          fft_buffer[i].i += x[i].r * h[i].i + x[i].i * h[i].r; \
+        } \
         \
-        fft_buffer[i].r = \
-            re * frequency_response[i].r - \
-            im * frequency_response[i].i; \
-        fft_buffer[i].i = \
-            re * frequency_response[i].i + \
-            im * frequency_response[i].r; \
+        if (++slot == partitions) \
+          slot = 0; \
       } \
       \
       /* Calculate inverse FFT of the result */ \
-      gst_fft_f64_inverse_fft (ifft, fft_buffer, \
-          buffer + real_buffer_length * j); \
+      gst_fft_f64_inverse_fft (ifft, fft_buffer, result); \
       \
-      /* Copy all except the first kernel_length-1 samples to the output */ \
-      for (i = 0; i < buffer_length - kernel_length + 1; i++) { \
-        dst[i * channels + j] = \
-            buffer[real_buffer_length * j + kernel_length - 1 + i]; \
+      /* The first block is garbage because of the circular convolution, \
+       * copy the second one to the output */ \
+      for (i = 0; i < block_length; i++) { \
+        dst[i * channels + j] = result[block_length + i]; \
       } \
       \
-      /* Copy the last kernel_length-1 samples to the beginning for the next block */ \
-      for (i = 0; i < kernel_length - 1; i++) { \
-        buffer[real_buffer_length * j + kernel_length - 1 + i] = \
-            buffer[real_buffer_length * j + buffer_length + i]; \
-      } \
+      /* The current block is the previous one for the next pass */ \
+      memcpy (window, window + block_length, \
+          block_length * sizeof (gdouble)); \
     } \
     \
-    generated += buffer_length - kernel_length + 1; \
-    dst += channels * (buffer_length - kernel_length + 1); \
+    generated += block_length; \
+    dst += channels * block_length; \
     \
-    /* The the first kernel_length-1 samples are there already */ \
-    buffer_fill = kernel_length - 1; \
+    buffer_fill = 0; \
   } \
   \
-  /* Write back cached buffer_fill value */ \
+  /* Write back cached values */ \
   self->buffer_fill = buffer_fill; \
+  self->fdl_pos = fdl_pos; \
   \
   return generated; \
 } G_STMT_END
@@ -374,45 +417,85 @@ DEFINE_FFT_PROCESS_FUNC_FIXED_CHANNELS (64, 2, double);
 #undef DEFINE_FFT_PROCESS_FUNC_FIXED_CHANNELS
 
 /* Element class */
+
+/* Returns the partition size that is used for a kernel of @kernel_length
+ * samples, or 0 if the kernel is not used in the frequency domain */
+static guint
+gst_audio_fx_base_fir_filter_get_block_length (GstAudioFXBaseFIRFilter *
+    self, guint kernel_length)
+{
+  guint block_length;
+
+  if (kernel_length < FFT_THRESHOLD || self->low_latency)
+    return 0;
+
+  /* Partitions larger than the kernel only add latency */
+  block_length = 1 << g_bit_storage (kernel_length - 1);
+  if (self->partition_size == 0)
+    block_length = MIN (block_length, DEFAULT_MAX_PARTITION_SIZE);
+  else
+    block_length = MIN (block_length,
+        1 << g_bit_storage (self->partition_size - 1));
+
+  return block_length;
+}
+
 static void
     gst_audio_fx_base_fir_filter_calculate_frequency_response
     (GstAudioFXBaseFIRFilter * self)
 {
+  guint block_length;
+
   gst_fft_f64_free (self->fft);
   self->fft = NULL;
   gst_fft_f64_free (self->ifft);
   self->ifft = NULL;
   g_free (self->frequency_response);
+  self->frequency_response = NULL;
   self->frequency_response_length = 0;
   g_free (self->fft_buffer);
   self->fft_buffer = NULL;
 
-  if (self->kernel && self->kernel_length >= FFT_THRESHOLD
-      && !self->low_latency) {
-    guint block_length, i;
+  if (self->kernel
+      && (block_length = gst_audio_fx_base_fir_filter_get_block_length (self,
+              self->kernel_length))) {
+    guint fft_length, length, i, k;
     gdouble *kernel_tmp, *kernel = self->kernel;
+    GstFFTF64Complex *frequency_response;
 
-    /* We process 4 * kernel_length samples per pass in FFT mode */
-    block_length = 4 * self->kernel_length;
-    block_length = gst_fft_next_fast_length (block_length);
+    /* We process block_length samples per pass in FFT mode, the
+     * kernel is split into partitions of that size */
+    fft_length = 2 * block_length;
     self->block_length = block_length;
+    self->partitions = (self->kernel_length + block_length - 1) / block_length;
 
-    kernel_tmp = g_new0 (gdouble, block_length);
-    memcpy (kernel_tmp, kernel, self->kernel_length * sizeof (gdouble));
+    GST_DEBUG_OBJECT (self, "using %u partitions of %u samples for a kernel "
+        "of %u samples", self->partitions, block_length, self->kernel_length);
 
-    self->fft = gst_fft_f64_new (block_length, FALSE);
-    self->ifft = gst_fft_f64_new (block_length, TRUE);
-    self->frequency_response_length = block_length / 2 + 1;
+    self->fft = gst_fft_f64_new (fft_length, FALSE);
+    self->ifft = gst_fft_f64_new (fft_length, TRUE);
+    self->frequency_response_length = block_length + 1;
     self->frequency_response =
-        g_new (GstFFTF64Complex, self->frequency_response_length);
-    gst_fft_f64_fft (self->fft, kernel_tmp, self->frequency_response);
-    g_free (kernel_tmp);
-
-    /* Normalize to make sure IFFT(FFT(x)) == x */
-    for (i = 0; i < self->frequency_response_length; i++) {
-      self->frequency_response[i].r /= block_length;
-      self->frequency_response[i].i /= block_length;
+        g_new (GstFFTF64Complex,
+        self->frequency_response_length * self->partitions);
+
+    kernel_tmp = g_new0 (gdouble, fft_length);
+    for (k = 0; k < self->partitions; k++) {
+      length = MIN (block_length, self->kernel_length - k * block_length);
+      memcpy (kernel_tmp, kernel + k * block_length, length * sizeof (gdouble));
+      memset (kernel_tmp + length, 0, (fft_length - length) * sizeof (gdouble));
+
+      frequency_response =
+          self->frequency_response + self->frequency_response_length * k;
+      gst_fft_f64_fft (self->fft, kernel_tmp, frequency_response);
+
+      /* Normalize to make sure IFFT(FFT(x)) == x */
+      for (i = 0; i < self->frequency_response_length; i++) {
+        frequency_response[i].r /= fft_length;
+        frequency_response[i].i /= fft_length;
+      }
     }
+    g_free (kernel_tmp);
   }
 }
 
@@ -477,6 +560,9 @@ gst_audio_fx_base_fir_filter_dispose (GObject * object)
   g_free (self->fft_buffer);
   self->fft_buffer = NULL;
 
+  g_free (self->fdl);
+  self->fdl = NULL;
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -515,6 +601,28 @@ gst_audio_fx_base_fir_filter_set_property (GObject * object, guint prop_id,
       GST_BASE_TRANSFORM_UNLOCK (self);
       break;
     }
+    case PROP_PARTITION_SIZE:{
+      guint partition_size;
+
+      if (GST_STATE (self) >= GST_STATE_PAUSED) {
+        g_warning ("Changing the \"partition-size\" property "
+            "is only allowed in states < PAUSED");
+        return;
+      }
+
+      GST_BASE_TRANSFORM_LOCK (self);
+      partition_size = g_value_get_uint (value);
+
+      if (self->partition_size != partition_size) {
+        self->partition_size = partition_size;
+        gst_audio_fx_base_fir_filter_calculate_frequency_response (self);
+        gst_audio_fx_base_fir_filter_select_process_function (self,
+            GST_AUDIO_FILTER_CAST (self)->format.width,
+            GST_AUDIO_FILTER_CAST (self)->format.channels);
+      }
+      GST_BASE_TRANSFORM_UNLOCK (self);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -534,6 +642,9 @@ gst_audio_fx_base_fir_filter_get_property (GObject * object, guint prop_id,
     case PROP_DRAIN_ON_CHANGES:
       g_value_set_boolean (value, self->drain_on_changes);
       break;
+    case PROP_PARTITION_SIZE:
+      g_value_set_uint (value, self->partition_size);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -582,8 +693,9 @@ gst_audio_fx_base_fir_filter_class_init (GstAudioFXBaseFIRFilterClass * klass)
    *
    * Whether the filter should be drained when its coeficients change
    *
-   * Note: Currently this only works if the kernel size is not changed!
-   * Support for drainless kernel size changes will be added in the future.
+   * Note: Currently this only works if the kernel size, or in FFT mode the
+   * number of kernel partitions, is not changed! Support for drainless kernel
+   * size changes will be added in the future.
    *
    * Since: 0.10.18
    */
@@ -593,6 +705,23 @@ gst_audio_fx_base_fir_filter_class_init (GstAudioFXBaseFIRFilterClass * klass)
           DEFAULT_DRAIN_ON_CHANGES,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstAudioFXBaseFIRFilter::partition-size:
+   *
+   * Size of the partitions in samples that long filter kernels are split
+   * into in FFT mode. This is the latency of the filter, independent of
+   * the kernel length. Smaller partitions need more CPU. The value is
+   * rounded up to the next power of two, 0 selects a size automatically.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_PARTITION_SIZE,
+      g_param_spec_uint ("partition-size", "Partition size",
+          "Size of the kernel partitions in samples in FFT mode, this is "
+          "the latency of the filter (0 = automatic). "
+          "Can only be changed in states < PAUSED!", 0, MAX_PARTITION_SIZE,
+          DEFAULT_PARTITION_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   trans_class->transform =
       GST_DEBUG_FUNCPTR (gst_audio_fx_base_fir_filter_transform);
   trans_class->start = GST_DEBUG_FUNCPTR (gst_audio_fx_base_fir_filter_start);
@@ -618,6 +747,7 @@ gst_audio_fx_base_fir_filter_init (GstAudioFXBaseFIRFilter * self,
 
   self->low_latency = DEFAULT_LOW_LATENCY;
   self->drain_on_changes = DEFAULT_DRAIN_ON_CHANGES;
+  self->partition_size = DEFAULT_PARTITION_SIZE;
 
   gst_pad_set_query_function (GST_BASE_TRANSFORM (self)->srcpad,
       gst_audio_fx_base_fir_filter_query);
@@ -703,8 +833,8 @@ gst_audio_fx_base_fir_filter_push_residue (GstAudioFXBaseFIRFilter * self)
       step_gensamples = self->process (self, zeroes, out, step_insamples);
       g_free (zeroes);
 
-      memcpy (data + gensamples * width, out, MIN (step_gensamples,
-              outsamples - gensamples) * width);
+      memcpy (data + gensamples * channels * width, out,
+          MIN (step_gensamples, outsamples - gensamples) * channels * width);
       gensamples += MIN (step_gensamples, outsamples - gensamples);
 
       g_free (out);
@@ -800,7 +930,7 @@ gst_audio_fx_base_fir_filter_transform_size (GstBaseTransform * base,
 
   size /= width * channels;
 
-  blocklen = self->block_length - self->kernel_length + 1;
+  blocklen = self->block_length;
   *othersize = ((size + blocklen - 1) / blocklen) * blocklen;
 
   *othersize *= width * channels;
@@ -975,7 +1105,7 @@ gst_audio_fx_base_fir_filter_query (GstPad * pad, GstQuery * query)
               GST_TIME_ARGS (min), GST_TIME_ARGS (max));
 
           if (self->fft && !self->low_latency)
-            latency = self->block_length - self->kernel_length + 1;
+            latency = self->block_length;
           else
             latency = self->latency;
 
@@ -1042,22 +1172,31 @@ void
 gst_audio_fx_base_fir_filter_set_kernel (GstAudioFXBaseFIRFilter * self,
     gdouble * kernel, guint kernel_length, guint64 latency)
 {
-  gboolean latency_changed;
+  gboolean latency_changed, layout_changed;
+  guint old_block_length, block_length;
 
   g_return_if_fail (kernel != NULL);
   g_return_if_fail (self != NULL);
 
   GST_BASE_TRANSFORM_LOCK (self);
 
+  old_block_length =
+      gst_audio_fx_base_fir_filter_get_block_length (self, self->kernel_length);
+  block_length =
+      gst_audio_fx_base_fir_filter_get_block_length (self, kernel_length);
+
   latency_changed = (self->latency != latency
-      || (!self->low_latency && self->kernel_length < FFT_THRESHOLD
-          && kernel_length >= FFT_THRESHOLD)
-      || (!self->low_latency && self->kernel_length >= FFT_THRESHOLD
-          && kernel_length < FFT_THRESHOLD));
+      || old_block_length != block_length);
+
+  /* In FFT mode the delay line has one slot per kernel partition */
+  layout_changed = latency_changed || (block_length == 0
+      && self->kernel_length != kernel_length) || (block_length != 0
+      && (kernel_length + block_length - 1) / block_length !=
+      self->partitions);
 
   /* FIXME: If the latency changes, the buffer size changes too and we
    * have to drain in any case until this is fixed in the future */
-  if (self->buffer && (!self->drain_on_changes || latency_changed)) {
+  if (self->buffer && (!self->drain_on_changes || layout_changed)) {
     gst_audio_fx_base_fir_filter_push_residue (self);
     self->start_ts = GST_CLOCK_TIME_NONE;
     self->start_off = GST_BUFFER_OFFSET_NONE;
@@ -1067,7 +1206,7 @@ gst_audio_fx_base_fir_filter_set_kernel (GstAudioFXBaseFIRFilter * self,
   }
 
   g_free (self->kernel);
-  if (!self->drain_on_changes || latency_changed) {
+  if (!self->drain_on_changes || layout_changed) {
     g_free (self->buffer);
     self->buffer = NULL;
     self->buffer_fill = 0;
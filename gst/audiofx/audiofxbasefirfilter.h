@@ -65,6 +65,8 @@ struct _GstAudioFXBaseFIRFilter {
   gboolean drain_on_changes;    /* If the filter should be drained when
                                  * coeficients change */
 
+  guint partition_size;         /* requested kernel partition size, 0 = automatic */
+
   /* < private > */
   GstAudioFXBaseFIRFilterProcessFunc process;
 
@@ -75,10 +77,15 @@ struct _GstAudioFXBaseFIRFilter {
   /* FFT convolution specific data */
   GstFFTF64 *fft;
   GstFFTF64 *ifft;
-  GstFFTF64Complex *frequency_response;  /* filter kernel -- frequency domain */
-  guint frequency_response_length;       /* length of filter kernel -- frequency domain */
-  GstFFTF64Complex *fft_buffer;          /* FFT buffer, has the length of the frequency response */
-  guint block_length;                    /* Length of the processing blocks -- time domain */
+  GstFFTF64Complex *frequency_response;  /* filter kernel partitions -- frequency domain */
+  guint frequency_response_length;       /* length of one kernel partition -- frequency domain */
+  guint partitions;                      /* number of kernel partitions */
+  GstFFTF64Complex *fft_buffer;          /* FFT buffer, has the length of one kernel partition */
+  GstFFTF64Complex *fdl;                 /* frequency domain delay line, the input spectra
+                                          * of the last partitions blocks for every channel */
+  guint fdl_pos;                         /* slot of the most recent input spectrum */
+  guint block_length;                    /* Length of the processing blocks and of the
+                                          * kernel partitions -- time domain */
 
   GstClockTime start_ts;        /* start timestamp after a discont */
   guint64 start_off;            /* start offset after a discont */
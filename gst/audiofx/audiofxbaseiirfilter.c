@@ -29,6 +29,7 @@
 #include <gst/controller/gstcontroller.h>
 
 #include <math.h>
+#include <string.h>
 
 #include "audiofxbaseiirfilter.h"
 
@@ -45,6 +46,9 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define DEBUG_INIT(bla) \
   GST_DEBUG_CATEGORY_INIT (gst_audio_fx_base_iir_filter_debug, "audiofxbaseiirfilter", 0, "Audio IIR Filter Base Class");
 
+/* Number of frames that are converted from 32 bit at once */
+#define BLOCK_FRAMES 256
+
 GST_BOILERPLATE_FULL (GstAudioFXBaseIIRFilter,
     gst_audio_fx_base_iir_filter, GstAudioFilter, GST_TYPE_AUDIO_FILTER,
     DEBUG_INIT);
@@ -60,6 +64,11 @@ static void process_64 (GstAudioFXBaseIIRFilter * filter,
     gdouble * data, guint num_samples);
 static void process_32 (GstAudioFXBaseIIRFilter * filter,
     gfloat * data, guint num_samples);
+static void gst_audio_fx_base_iir_filter_free_history (GstAudioFXBaseIIRFilter *
+    filter);
+static void
+gst_audio_fx_base_iir_filter_select_process_function (GstAudioFXBaseIIRFilter *
+    filter);
 
 /* GObject vmethod implementations */
 
@@ -89,19 +98,10 @@ gst_audio_fx_base_iir_filter_dispose (GObject * object)
     filter->b = NULL;
   }
 
-  if (filter->channels) {
-    GstAudioFXBaseIIRFilterChannelCtx *ctx;
-    guint i;
-
-    for (i = 0; i < filter->nchannels; i++) {
-      ctx = &filter->channels[i];
-      g_free (ctx->x);
-      g_free (ctx->y);
-    }
+  g_free (filter->biquads);
+  filter->biquads = NULL;
 
-    g_free (filter->channels);
-    filter->channels = NULL;
-  }
+  gst_audio_fx_base_iir_filter_free_history (filter);
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -132,7 +132,8 @@ gst_audio_fx_base_iir_filter_init (GstAudioFXBaseIIRFilter * filter,
   filter->na = 0;
   filter->b = NULL;
   filter->nb = 0;
-  filter->channels = NULL;
+  filter->biquads = NULL;
+  filter->nbiquads = 0;
   filter->nchannels = 0;
 }
 
@@ -181,61 +182,105 @@ gst_audio_fx_base_iir_filter_calculate_gain (gdouble * a, guint na, gdouble * b,
   return (sqrt (gain_r * gain_r + gain_i * gain_i));
 }
 
+/* Must be called with the transform lock! */
+static void
+gst_audio_fx_base_iir_filter_free_history (GstAudioFXBaseIIRFilter * filter)
+{
+  g_free (filter->x);
+  filter->x = NULL;
+  g_free (filter->y);
+  filter->y = NULL;
+  g_free (filter->val);
+  filter->val = NULL;
+  g_free (filter->biquad_state);
+  filter->biquad_state = NULL;
+  g_free (filter->scratch);
+  filter->scratch = NULL;
+  filter->x_pos = filter->y_pos = 0;
+}
+
+/* Must be called with the transform lock! */
+static void
+gst_audio_fx_base_iir_filter_alloc_history (GstAudioFXBaseIIRFilter * filter)
+{
+  guint channels = filter->nchannels;
+
+  gst_audio_fx_base_iir_filter_free_history (filter);
+
+  if (channels == 0)
+    return;
+
+  if (filter->biquads) {
+    filter->biquad_state = g_new0 (gdouble, 2 * filter->nbiquads * channels);
+  } else {
+    if (filter->na > 1)
+      filter->x = g_new0 (gdouble, 2 * (filter->na - 1) * channels);
+    if (filter->nb > 1)
+      filter->y = g_new0 (gdouble, 2 * (filter->nb - 1) * channels);
+  }
+  filter->val = g_new0 (gdouble, channels);
+  filter->scratch = g_new (gdouble, BLOCK_FRAMES * channels);
+}
+
 void
 gst_audio_fx_base_iir_filter_set_coefficients (GstAudioFXBaseIIRFilter * filter,
     gdouble * a, guint na, gdouble * b, guint nb)
 {
-  guint i;
-
   g_return_if_fail (GST_IS_AUDIO_FX_BASE_IIR_FILTER (filter));
 
   GST_BASE_TRANSFORM_LOCK (filter);
 
   g_free (filter->a);
   g_free (filter->b);
+  g_free (filter->biquads);
 
-  filter->a = filter->b = NULL;
+  filter->biquads = NULL;
+  filter->nbiquads = 0;
 
-  if (filter->channels) {
-    GstAudioFXBaseIIRFilterChannelCtx *ctx;
-    gboolean free = (na != filter->na || nb != filter->nb);
+  filter->na = na;
+  filter->nb = nb;
 
-    for (i = 0; i < filter->nchannels; i++) {
-      ctx = &filter->channels[i];
+  filter->a = a;
+  filter->b = b;
 
-      if (free)
-        g_free (ctx->x);
-      else
-        memset (ctx->x, 0, filter->na * sizeof (gdouble));
+  gst_audio_fx_base_iir_filter_alloc_history (filter);
+  gst_audio_fx_base_iir_filter_select_process_function (filter);
 
-      if (free)
-        g_free (ctx->y);
-      else
-        memset (ctx->y, 0, filter->nb * sizeof (gdouble));
-    }
+  GST_BASE_TRANSFORM_UNLOCK (filter);
+}
 
-    g_free (filter->channels);
-    filter->channels = NULL;
-  }
+/**
+ * gst_audio_fx_base_iir_filter_set_biquads:
+ * @filter: a #GstAudioFXBaseIIRFilter
+ * @biquads: coefficients of the sections, takes ownership
+ * @nbiquads: number of sections
+ *
+ * Sets the filter to a cascade of @nbiquads second order sections
+ * y = a0 * x + a1 * x1 + a2 * x2 + b1 * y1 + b2 * y2, given by five
+ * coefficients a0 a1 a2 b1 b2 each. This is numerically better behaved
+ * and faster than the direct form of the same filter.
+ */
+void
+gst_audio_fx_base_iir_filter_set_biquads (GstAudioFXBaseIIRFilter * filter,
+    gdouble * biquads, guint nbiquads)
+{
+  g_return_if_fail (GST_IS_AUDIO_FX_BASE_IIR_FILTER (filter));
+  g_return_if_fail (biquads != NULL && nbiquads > 0);
 
-  filter->na = na;
-  filter->nb = nb;
+  GST_BASE_TRANSFORM_LOCK (filter);
 
-  filter->a = a;
-  filter->b = b;
+  g_free (filter->a);
+  g_free (filter->b);
+  g_free (filter->biquads);
 
-  if (filter->nchannels && !filter->channels) {
-    GstAudioFXBaseIIRFilterChannelCtx *ctx;
+  filter->a = filter->b = NULL;
+  filter->na = filter->nb = 0;
 
-    filter->channels =
-        g_new0 (GstAudioFXBaseIIRFilterChannelCtx, filter->nchannels);
-    for (i = 0; i < filter->nchannels; i++) {
-      ctx = &filter->channels[i];
+  filter->biquads = biquads;
+  filter->nbiquads = nbiquads;
 
-      ctx->x = g_new0 (gdouble, filter->na);
-      ctx->y = g_new0 (gdouble, filter->nb);
-    }
-  }
+  gst_audio_fx_base_iir_filter_alloc_history (filter);
+  gst_audio_fx_base_iir_filter_select_process_function (filter);
 
   GST_BASE_TRANSFORM_UNLOCK (filter);
 }
@@ -258,96 +303,188 @@ gst_audio_fx_base_iir_filter_setup (GstAudioFilter * base,
   else
     ret = FALSE;
 
-  if (format->channels != filter->nchannels) {
-    guint i;
-    GstAudioFXBaseIIRFilterChannelCtx *ctx;
-
-    if (filter->channels) {
+  if (format->channels != filter->nchannels || !filter->val) {
+    filter->nchannels = format->channels;
+    gst_audio_fx_base_iir_filter_alloc_history (filter);
+    gst_audio_fx_base_iir_filter_select_process_function (filter);
+  }
 
-      for (i = 0; i < filter->nchannels; i++) {
-        ctx = &filter->channels[i];
+  return ret;
+}
 
-        g_free (ctx->x);
-        g_free (ctx->y);
-      }
+/* The filters below run on blocks of interleaved samples. The innermost
+ * loops always go over the channels with the same coefficient and state
+ * that is interleaved the same way as the samples, which allows the
+ * compiler to process several channels at once with SIMD instructions.
+ * There are variants for one and two channels where the number of
+ * channels is known at compile time. */
 
-      g_free (filter->channels);
-      filter->channels = NULL;
+/* Direct form I of arbitrary order:
+ *
+ * y[t] = \sum_{i=0}^{na-1} a[i] * x[t-i] + \sum_{i=1}^{nb-1} b[i] * y[t-i]
+ */
+static inline void
+process_direct_form (GstAudioFXBaseIIRFilter * filter, gdouble * data,
+    guint frames, guint channels)
+{
+  const gdouble *a = filter->a, *b = filter->b, *h;
+  guint na = filter->na, nb = filter->nb;
+  gdouble *x = filter->x, *y = filter->y, *val = filter->val;
+  guint x_pos = filter->x_pos, y_pos = filter->y_pos;
+  guint i, j, c;
+
+  for (i = 0; i < frames; i++) {
+    for (c = 0; c < channels; c++)
+      val[c] = a[0] * data[c];
+
+    h = x + x_pos * channels;
+    for (j = 1; j < na; j++) {
+      for (c = 0; c < channels; c++)
+        val[c] += a[j] * h[c];
+      h += channels;
     }
 
-    filter->nchannels = format->channels;
-
-    filter->channels =
-        g_new0 (GstAudioFXBaseIIRFilterChannelCtx, filter->nchannels);
-    for (i = 0; i < filter->nchannels; i++) {
-      ctx = &filter->channels[i];
+    h = y + y_pos * channels;
+    for (j = 1; j < nb; j++) {
+      for (c = 0; c < channels; c++)
+        val[c] += b[j] * h[c];
+      h += channels;
+    }
 
-      ctx->x = g_new0 (gdouble, filter->na);
-      ctx->y = g_new0 (gdouble, filter->nb);
+    /* store the new values in front of the history, and a second
+     * time behind it */
+    if (na > 1) {
+      x_pos = (x_pos == 0) ? na - 2 : x_pos - 1;
+      for (c = 0; c < channels; c++) {
+        x[x_pos * channels + c] = data[c];
+        x[(x_pos + na - 1) * channels + c] = data[c];
+      }
+    }
+    if (nb > 1) {
+      y_pos = (y_pos == 0) ? nb - 2 : y_pos - 1;
+      for (c = 0; c < channels; c++) {
+        y[y_pos * channels + c] = val[c];
+        y[(y_pos + nb - 1) * channels + c] = val[c];
+      }
     }
+
+    for (c = 0; c < channels; c++)
+      data[c] = val[c];
+    data += channels;
   }
 
-  return ret;
+  filter->x_pos = x_pos;
+  filter->y_pos = y_pos;
 }
 
-static inline gdouble
-process (GstAudioFXBaseIIRFilter * filter,
-    GstAudioFXBaseIIRFilterChannelCtx * ctx, gdouble x0)
+/* Cascade of second order sections in transposed direct form II. Each
+ * section runs over the complete block before the next one, which keeps
+ * its coefficients and state in registers:
+ *
+ * y[t] = a0 * x[t] + z1
+ * z1 = a1 * x[t] + b1 * y[t] + z2
+ * z2 = a2 * x[t] + b2 * y[t]
+ */
+static inline void
+process_biquads (GstAudioFXBaseIIRFilter * filter, gdouble * data,
+    guint frames, guint channels)
 {
-  gdouble val = filter->a[0] * x0;
-  gint i, j;
-
-  for (i = 1, j = ctx->x_pos; i < filter->na; i++) {
-    val += filter->a[i] * ctx->x[j];
-    j--;
-    if (j < 0)
-      j = filter->na - 1;
+  gdouble a0, a1, a2, b1, b2, in, out;
+  gdouble *z1, *z2, *d;
+  guint s, i, c;
+
+  for (s = 0; s < filter->nbiquads; s++) {
+    a0 = filter->biquads[5 * s + 0];
+    a1 = filter->biquads[5 * s + 1];
+    a2 = filter->biquads[5 * s + 2];
+    b1 = filter->biquads[5 * s + 3];
+    b2 = filter->biquads[5 * s + 4];
+    z1 = filter->biquad_state + 2 * s * channels;
+    z2 = z1 + channels;
+
+    d = data;
+    for (i = 0; i < frames; i++) {
+      for (c = 0; c < channels; c++) {
+        in = d[c];
+        out = a0 * in + z1[c];
+        z1[c] = a1 * in + b1 * out + z2[c];
+        z2[c] = a2 * in + b2 * out;
+        d[c] = out;
+      }
+      d += channels;
+    }
   }
+}
 
-  for (i = 1, j = ctx->y_pos; i < filter->nb; i++) {
-    val += filter->b[i] * ctx->y[j];
-    j--;
-    if (j < 0)
-      j = filter->nb - 1;
-  }
+#define DEFINE_PROCESS_BLOCK_FUNC(type,name,channels) \
+static void \
+process_##type##_##name (GstAudioFXBaseIIRFilter * filter, gdouble * data, \
+    guint frames) \
+{ \
+  process_##type (filter, data, frames, channels); \
+}
 
-  if (ctx->x) {
-    ctx->x_pos++;
-    if (ctx->x_pos >= filter->na)
-      ctx->x_pos = 0;
-    ctx->x[ctx->x_pos] = x0;
-  }
-  if (ctx->y) {
-    ctx->y_pos++;
-    if (ctx->y_pos >= filter->nb)
-      ctx->y_pos = 0;
+DEFINE_PROCESS_BLOCK_FUNC (direct_form, 1, 1);
+DEFINE_PROCESS_BLOCK_FUNC (direct_form, 2, 2);
+DEFINE_PROCESS_BLOCK_FUNC (direct_form, n, filter->nchannels);
+DEFINE_PROCESS_BLOCK_FUNC (biquads, 1, 1);
+DEFINE_PROCESS_BLOCK_FUNC (biquads, 2, 2);
+DEFINE_PROCESS_BLOCK_FUNC (biquads, n, filter->nchannels);
 
-    ctx->y[ctx->y_pos] = val;
-  }
+#undef DEFINE_PROCESS_BLOCK_FUNC
 
-  return val;
+/* Must be called with the transform lock! */
+static void
+gst_audio_fx_base_iir_filter_select_process_function (GstAudioFXBaseIIRFilter *
+    filter)
+{
+  if (filter->biquads) {
+    if (filter->nchannels == 1)
+      filter->process_block = process_biquads_1;
+    else if (filter->nchannels == 2)
+      filter->process_block = process_biquads_2;
+    else
+      filter->process_block = process_biquads_n;
+  } else {
+    if (filter->nchannels == 1)
+      filter->process_block = process_direct_form_1;
+    else if (filter->nchannels == 2)
+      filter->process_block = process_direct_form_2;
+    else
+      filter->process_block = process_direct_form_n;
+  }
 }
 
-#define DEFINE_PROCESS_FUNC(width,ctype) \
-static void \
-process_##width (GstAudioFXBaseIIRFilter * filter, \
-    g##ctype * data, guint num_samples) \
-{ \
-  gint i, j, channels = GST_AUDIO_FILTER (filter)->format.channels; \
-  gdouble val; \
-  \
-  for (i = 0; i < num_samples / channels; i++) { \
-    for (j = 0; j < channels; j++) { \
-      val = process (filter, &filter->channels[j], *data); \
-      *data++ = val; \
-    } \
-  } \
+static void
+process_64 (GstAudioFXBaseIIRFilter * filter, gdouble * data,
+    guint num_samples)
+{
+  filter->process_block (filter, data, num_samples / filter->nchannels);
 }
 
-DEFINE_PROCESS_FUNC (32, float);
-DEFINE_PROCESS_FUNC (64, double);
-
-#undef DEFINE_PROCESS_FUNC
+static void
+process_32 (GstAudioFXBaseIIRFilter * filter, gfloat * data,
+    guint num_samples)
+{
+  guint channels = filter->nchannels;
+  guint frames = num_samples / channels;
+  gdouble *scratch = filter->scratch;
+  guint i, n;
+
+  /* Filter in double precision like for 64 bit samples */
+  while (frames) {
+    n = MIN (frames, BLOCK_FRAMES);
+
+    for (i = 0; i < n * channels; i++)
+      scratch[i] = data[i];
+    filter->process_block (filter, scratch, n);
+    for (i = 0; i < n * channels; i++)
+      data[i] = scratch[i];
+
+    data += n * channels;
+    frames -= n;
+  }
+}
 
 /* GstBaseTransform vmethod implementations */
 static GstFlowReturn
@@ -374,7 +511,12 @@ gst_audio_fx_base_iir_filter_transform_ip (GstBaseTransform * base,
   if (gst_base_transform_is_passthrough (base))
     return GST_FLOW_OK;
 
-  g_return_val_if_fail (filter->a != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (filter->a != NULL || filter->biquads != NULL,
+      GST_FLOW_ERROR);
+
+  /* The history is reset in stop() */
+  if (G_UNLIKELY (!filter->val))
+    gst_audio_fx_base_iir_filter_alloc_history (filter);
 
   filter->process (filter, GST_BUFFER_DATA (buf), num_samples);
 
@@ -386,21 +528,10 @@ static gboolean
 gst_audio_fx_base_iir_filter_stop (GstBaseTransform * base)
 {
   GstAudioFXBaseIIRFilter *filter = GST_AUDIO_FX_BASE_IIR_FILTER (base);
-  guint channels = GST_AUDIO_FILTER (filter)->format.channels;
-  GstAudioFXBaseIIRFilterChannelCtx *ctx;
-  guint i;
 
   /* Reset the history of input and output values if
    * already existing */
-  if (channels && filter->channels) {
-    for (i = 0; i < channels; i++) {
-      ctx = &filter->channels[i];
-      g_free (ctx->x);
-      g_free (ctx->y);
-    }
-    g_free (filter->channels);
-  }
-  filter->channels = NULL;
+  gst_audio_fx_base_iir_filter_free_history (filter);
 
   return TRUE;
 }
@@ -38,14 +38,7 @@ typedef struct _GstAudioFXBaseIIRFilter GstAudioFXBaseIIRFilter;
 typedef struct _GstAudioFXBaseIIRFilterClass GstAudioFXBaseIIRFilterClass;
 
 typedef void (*GstAudioFXBaseIIRFilterProcessFunc) (GstAudioFXBaseIIRFilter *, guint8 *, guint);
-
-typedef struct
-{
-  gdouble *x;
-  gint x_pos;
-  gdouble *y;
-  gint y_pos;
-} GstAudioFXBaseIIRFilterChannelCtx;
+typedef void (*GstAudioFXBaseIIRFilterProcessBlockFunc) (GstAudioFXBaseIIRFilter *, gdouble *, guint);
 
 struct _GstAudioFXBaseIIRFilter
 {
@@ -53,14 +46,35 @@ struct _GstAudioFXBaseIIRFilter
 
   /* < private > */
   GstAudioFXBaseIIRFilterProcessFunc process;
+  GstAudioFXBaseIIRFilterProcessBlockFunc process_block;
 
   gboolean have_coeffs;
   gdouble *a;
   guint na;
   gdouble *b;
   guint nb;
-  GstAudioFXBaseIIRFilterChannelCtx *channels;
+
+  /* cascade of second order sections, a0 a1 a2 b1 b2 for every
+   * section. Used instead of a and b if set */
+  gdouble *biquads;
+  guint nbiquads;
+
   guint nchannels;
+
+  /* history of the direct form with the channels interleaved. Every
+   * value is stored twice so that the last na-1 (nb-1) values are
+   * contiguous from x_pos (y_pos) on, newest first */
+  gdouble *x;
+  guint x_pos;
+  gdouble *y;
+  guint y_pos;
+  gdouble *val;
+
+  /* state of the sections, two values per section and channel */
+  gdouble *biquad_state;
+
+  /* 32 bit samples are converted to this in blocks */
+  gdouble *scratch;
 };
 
 struct _GstAudioFXBaseIIRFilterClass
@@ -70,6 +84,7 @@ struct _GstAudioFXBaseIIRFilterClass
 
 GType gst_audio_fx_base_iir_filter_get_type (void);
 void gst_audio_fx_base_iir_filter_set_coefficients (GstAudioFXBaseIIRFilter *filter, gdouble *a, guint na, gdouble *b, guint nb);
+void gst_audio_fx_base_iir_filter_set_biquads (GstAudioFXBaseIIRFilter *filter, gdouble *biquads, guint nbiquads);
 gdouble gst_audio_fx_base_iir_filter_calculate_gain (gdouble *a, guint na, gdouble *b, guint nb, gdouble zr, gdouble zi);
 
 G_END_DECLS
@@ -46,6 +46,7 @@
 
 #include <gst/base/gstbitreader.h>
 #include "gstaacparse.h"
+#include "gstsyncscan.h"
 
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
@@ -712,9 +713,9 @@ gst_aac_parse_detect_stream (GstAacParse * aacparse,
     const guint8 * data, const guint avail, gboolean drain,
     guint * framesize, gint * skipsize)
 {
-  gboolean found = FALSE;
   guint need_data_adts = 0, need_data_loas;
   guint i = 0;
+  gint adts, adif;
 
   GST_DEBUG_OBJECT (aacparse, "Parsing header data");
 
@@ -727,26 +728,33 @@ gst_aac_parse_detect_stream (GstAacParse * aacparse,
     return FALSE;
   }
 
-  for (i = 0; i < avail - 4; i++) {
-    if (((data[i] == 0xff) && ((data[i + 1] & 0xf6) == 0xf0)) ||
-        ((data[0] == 0x56) && ((data[1] & 0xe0) == 0xe0)) ||
-        strncmp ((char *) data + i, "ADIF", 4) == 0) {
-      GST_DEBUG_OBJECT (aacparse, "Found ADIF signature at offset %u", i);
-      found = TRUE;
-
-      if (i) {
-        /* Trick: tell the parent class that we didn't find the frame yet,
-           but make it skip 'i' amount of bytes. Next time we arrive
-           here we have full frame in the beginning of the data. */
-        *skipsize = i;
-        return FALSE;
-      }
-      break;
+  /* LOAS sync at the start, or the first ADTS sync or ADIF signature in
+   * the first avail - 4 bytes */
+  if ((data[0] == 0x56) && ((data[1] & 0xe0) == 0xe0)) {
+    i = 0;
+  } else {
+    adts = gst_sync_scan_uint16 (data, avail - 3, 0xfff6, 0xfff0);
+    /* 0x41444946 is "ADIF" */
+    adif = gst_sync_scan_uint32 (data, (adts >= 0) ? adts + 3 : avail - 1,
+        0xffffffff, 0x41444946);
+
+    if (adif >= 0) {
+      i = adif;
+    } else if (adts >= 0) {
+      i = adts;
+    } else {
+      *skipsize = avail - 4;
+      return FALSE;
     }
   }
-  if (!found) {
-    if (i)
-      *skipsize = i;
+
+  GST_DEBUG_OBJECT (aacparse, "Found signature at offset %u", i);
+
+  if (i) {
+    /* Trick: tell the parent class that we didn't find the frame yet,
+       but make it skip 'i' amount of bytes. Next time we arrive
+       here we have full frame in the beginning of the data. */
+    *skipsize = i;
     return FALSE;
   }
 
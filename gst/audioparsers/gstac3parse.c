@@ -46,6 +46,7 @@
 #include <string.h>
 
 #include "gstac3parse.h"
+#include "gstsyncscan.h"
 #include <gst/base/gstbytereader.h>
 #include <gst/base/gstbitreader.h>
 
@@ -466,8 +467,8 @@ gst_ac3_parse_check_valid_frame (GstBaseParse * parse,
   if (G_UNLIKELY (GST_BUFFER_SIZE (buf) < 6))
     return FALSE;
 
-  off = gst_byte_reader_masked_scan_uint32 (&reader, 0xffff0000, 0x0b770000,
-      0, GST_BUFFER_SIZE (buf));
+  off = gst_sync_scan_uint32 (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf),
+      0xffff0000, 0x0b770000);
 
   GST_LOG_OBJECT (parse, "possible sync at buffer offset %d", off);
 
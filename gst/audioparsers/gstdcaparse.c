@@ -48,6 +48,7 @@
 #include <string.h>
 
 #include "gstdcaparse.h"
+#include "gstsyncscan.h"
 #include <gst/base/gstbytereader.h>
 #include <gst/base/gstbitreader.h>
 
@@ -256,51 +257,37 @@ gst_dca_parse_parse_header (GstDcaParse * dcaparse,
 }
 
 static gint
-gst_dca_parse_find_sync (GstDcaParse * dcaparse, GstByteReader * reader,
-    const GstBuffer * buf, guint32 * sync)
+gst_dca_parse_find_sync (GstDcaParse * dcaparse, const GstBuffer * buf,
+    guint32 * sync)
 {
+  static const guint32 syncs[] = {
+    0xfe7f0180,                 /* Raw little endian */
+    0x7ffe8001,                 /* Raw big endian */
+    0xff1f00e8,                 /* 14-bit little endian */
+    0x1fffe800                  /* 14-bit big endian */
+  };
   guint32 best_sync = 0;
-  guint best_offset = G_MAXUINT;
-  gint off;
+  guint size = GST_BUFFER_SIZE (buf), i;
+  gint off, best_offset = -1;
 
   /* FIXME: verify syncs via _parse_header() here already */
 
-  /* Raw little endian */
-  off = gst_byte_reader_masked_scan_uint32 (reader, 0xffffffff, 0xfe7f0180,
-      0, GST_BUFFER_SIZE (buf));
-  if (off >= 0 && off < best_offset) {
-    best_offset = off;
-    best_sync = 0xfe7f0180;
-  }
-
-  /* Raw big endian */
-  off = gst_byte_reader_masked_scan_uint32 (reader, 0xffffffff, 0x7ffe8001,
-      0, GST_BUFFER_SIZE (buf));
-  if (off >= 0 && off < best_offset) {
-    best_offset = off;
-    best_sync = 0x7ffe8001;
-  }
-
   /* FIXME: check next 2 bytes as well for 14-bit formats (but then don't
    * forget to adjust the *skipsize= in _check_valid_frame() */
 
-  /* 14-bit little endian  */
-  off = gst_byte_reader_masked_scan_uint32 (reader, 0xffffffff, 0xff1f00e8,
-      0, GST_BUFFER_SIZE (buf));
-  if (off >= 0 && off < best_offset) {
-    best_offset = off;
-    best_sync = 0xff1f00e8;
-  }
-
-  /* 14-bit big endian  */
-  off = gst_byte_reader_masked_scan_uint32 (reader, 0xffffffff, 0x1fffe800,
-      0, GST_BUFFER_SIZE (buf));
-  if (off >= 0 && off < best_offset) {
-    best_offset = off;
-    best_sync = 0x1fffe800;
+  /* Once a sync word was found the others only need to be searched for
+   * before it */
+  for (i = 0; i < G_N_ELEMENTS (syncs); i++) {
+    off = gst_sync_scan_uint32 (GST_BUFFER_DATA (buf), size, 0xffffffff,
+        syncs[i]);
+    if (off >= 0) {
+      best_offset = off;
+      best_sync = syncs[i];
+      size = off + 3;
+    }
   }
 
-  if (best_offset == G_MAXUINT)
+  if (best_offset < 0)
     return -1;
 
   *sync = best_sync;
@@ -327,12 +314,13 @@ gst_dca_parse_check_valid_frame (GstBaseParse * parse,
   parser_in_sync = !GST_BASE_PARSE_LOST_SYNC (parse);
 
   if (G_LIKELY (parser_in_sync && dcaparse->last_sync != 0)) {
-    off = gst_byte_reader_masked_scan_uint32 (&r, 0xffffffff,
-        dcaparse->last_sync, 0, GST_BUFFER_SIZE (buf));
+    sync = dcaparse->last_sync;
+    off = gst_sync_scan_uint32 (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf),
+        0xffffffff, sync);
   }
 
   if (G_UNLIKELY (off < 0)) {
-    off = gst_dca_parse_find_sync (dcaparse, &r, buf, &sync);
+    off = gst_dca_parse_find_sync (dcaparse, buf, &sync);
   }
 
   /* didn't find anything that looks like a sync word, skip */
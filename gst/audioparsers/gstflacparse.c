@@ -54,6 +54,7 @@
 #endif
 
 #include "gstflacparse.h"
+#include "gstsyncscan.h"
 
 #include <string.h>
 #include <gst/tag/tag.h>
@@ -330,6 +331,9 @@ gst_flac_parse_start (GstBaseParse * parse)
   flacparse->sample_number = 0;
   flacparse->strategy_checked = FALSE;
 
+  flacparse->search_offset = GST_BUFFER_OFFSET_NONE;
+  flacparse->search_pos = 0;
+
   /* "fLaC" marker */
   gst_base_parse_set_min_frame_size (GST_BASE_PARSE (flacparse), 4);
 
@@ -619,8 +623,9 @@ gst_flac_parse_frame_is_valid (GstFlacParse * flacparse,
 {
   GstBuffer *buffer;
   const guint8 *data;
-  guint max, size, remaining;
+  guint max, size;
   guint i, search_start, search_end;
+  gint off;
   FrameHeaderCheckReturn header_ret;
   guint16 block_size;
 
@@ -649,27 +654,36 @@ gst_flac_parse_frame_is_valid (GstFlacParse * flacparse,
     search_end = size;
   search_end -= 2;
 
-  remaining = size;
-
-  for (i = search_start; i < search_end; i++, remaining--) {
-    if ((GST_READ_UINT16_BE (data + i) & 0xfffe) == 0xfff8) {
-      header_ret =
-          gst_flac_parse_frame_header_is_valid (flacparse, data + i, remaining,
-          FALSE, NULL);
-      if (header_ret == FRAME_HEADER_VALID) {
-        if (flacparse->check_frame_checksums) {
-          guint16 actual_crc = gst_flac_calculate_crc16 (data, i - 2);
-          guint16 expected_crc = GST_READ_UINT16_BE (data + i - 2);
+  /* Continue where the last search for the end of this frame stopped */
+  if (GST_BUFFER_OFFSET_IS_VALID (buffer) &&
+      flacparse->search_offset == GST_BUFFER_OFFSET (buffer))
+    search_start = MAX (search_start, flacparse->search_pos);
+  flacparse->search_offset = GST_BUFFER_OFFSET_NONE;
 
-          if (actual_crc != expected_crc)
-            continue;
-        }
-        *ret = i;
-        flacparse->block_size = block_size;
-        return TRUE;
-      } else if (header_ret == FRAME_HEADER_MORE_DATA) {
-        goto need_more;
+  for (i = search_start; i < search_end; i++) {
+    off = gst_sync_scan_uint16 (data + i, search_end + 1 - i, 0xfffe, 0xfff8);
+    if (off < 0)
+      break;
+    i += off;
+
+    header_ret =
+        gst_flac_parse_frame_header_is_valid (flacparse, data + i, size - i,
+        FALSE, NULL);
+    if (header_ret == FRAME_HEADER_VALID) {
+      if (flacparse->check_frame_checksums) {
+        guint16 actual_crc = gst_flac_calculate_crc16 (data, i - 2);
+        guint16 expected_crc = GST_READ_UINT16_BE (data + i - 2);
+
+        if (actual_crc != expected_crc)
+          continue;
       }
+      *ret = i;
+      flacparse->block_size = block_size;
+      return TRUE;
+    } else if (header_ret == FRAME_HEADER_MORE_DATA) {
+      flacparse->search_offset = GST_BUFFER_OFFSET (buffer);
+      flacparse->search_pos = i;
+      goto need_more;
     }
   }
 
@@ -691,6 +705,9 @@ gst_flac_parse_frame_is_valid (GstFlacParse * flacparse,
     }
   }
 
+  flacparse->search_offset = GST_BUFFER_OFFSET (buffer);
+  flacparse->search_pos = search_end;
+
 need_more:
   max = flacparse->max_framesize + 16;
   if (max == 16)
@@ -767,12 +784,10 @@ gst_flac_parse_check_valid_frame (GstBaseParse * parse,
         }
       }
     } else {
-      GstByteReader reader = GST_BYTE_READER_INIT_FROM_BUFFER (buffer);
       gint off;
 
-      off =
-          gst_byte_reader_masked_scan_uint32 (&reader, 0xfffc0000, 0xfff80000,
-          0, GST_BUFFER_SIZE (buffer));
+      off = gst_sync_scan_uint32 (data, GST_BUFFER_SIZE (buffer), 0xfffc0000,
+          0xfff80000);
 
       if (off > 0) {
         GST_DEBUG_OBJECT (parse, "Possible sync at buffer offset %d", off);
@@ -76,6 +76,11 @@ struct _GstFlacParse {
   guint64 sample_number;
   gboolean strategy_checked;
 
+  /* Where the search for the end of the current frame stopped because of
+   * missing data, to continue there once more data is available */
+  guint64 search_offset;
+  guint search_pos;
+
   GstTagList *tags;
 
   GList *headers;
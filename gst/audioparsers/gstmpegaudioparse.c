@@ -48,6 +48,7 @@
 #include <string.h>
 
 #include "gstmpegaudioparse.h"
+#include "gstsyncscan.h"
 #include <gst/base/gstbytereader.h>
 
 GST_DEBUG_CATEGORY_STATIC (mpeg_audio_parse_debug);
@@ -492,7 +493,6 @@ gst_mpeg_audio_parse_check_valid_frame (GstBaseParse * parse,
 {
   GstMpegAudioParse *mp3parse = GST_MPEG_AUDIO_PARSE (parse);
   GstBuffer *buf = frame->buffer;
-  GstByteReader reader = GST_BYTE_READER_INIT_FROM_BUFFER (buf);
   gint off, bpf;
   gboolean lost_sync, draining, valid, caps_change;
   guint32 header;
@@ -501,8 +501,8 @@ gst_mpeg_audio_parse_check_valid_frame (GstBaseParse * parse,
   if (G_UNLIKELY (GST_BUFFER_SIZE (buf) < 6))
     return FALSE;
 
-  off = gst_byte_reader_masked_scan_uint32 (&reader, 0xffe00000, 0xffe00000,
-      0, GST_BUFFER_SIZE (buf));
+  off = gst_sync_scan_uint32 (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf),
+      0xffe00000, 0xffe00000);
 
   GST_LOG_OBJECT (parse, "possible sync at buffer offset %d", off);
 
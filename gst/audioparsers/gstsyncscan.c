@@ -0,0 +1,117 @@
+/* GStreamer audio parsers
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Sync word search shared by the parsers.
+ *
+ * All sync words the parsers look for start with a byte that is completely
+ * part of the pattern (0xff for MPEG audio, ADTS and FLAC, 0x0b for AC3,
+ * 0x7f, 0xfe, 0x1f and 0xff for DTS). Candidates for that byte are found
+ * with memchr(), which the C library implements with vector instructions on
+ * all common platforms, and only those are compared against the complete
+ * masked pattern. This is much faster than looking at every byte when
+ * resyncing after corruption or when searching for the end of a FLAC frame.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstsyncscan.h"
+
+/**
+ * gst_sync_scan_uint16:
+ * @data: data to search
+ * @size: size of @data
+ * @mask: mask to apply to the 16 bit big endian values
+ * @pattern: pattern to match after applying @mask
+ *
+ * Returns: the offset of the first 16 bit big endian value in @data that
+ * matches @pattern after applying @mask, or -1 if there is none.
+ */
+gint
+gst_sync_scan_uint16 (const guint8 * data, guint size, guint16 mask,
+    guint16 pattern)
+{
+  const guint8 *p, *end;
+
+  g_return_val_if_fail ((pattern & mask) == pattern, -1);
+
+  if (size < 2)
+    return -1;
+
+  /* one after the last possible start */
+  end = data + size - 1;
+
+  if ((mask >> 8) == 0xff) {
+    for (p = data; (p = memchr (p, pattern >> 8, end - p)); p++) {
+      if ((GST_READ_UINT16_BE (p) & mask) == pattern)
+        return p - data;
+    }
+  } else {
+    for (p = data; p < end; p++) {
+      if ((GST_READ_UINT16_BE (p) & mask) == pattern)
+        return p - data;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * gst_sync_scan_uint32:
+ * @data: data to search
+ * @size: size of @data
+ * @mask: mask to apply to the 32 bit big endian values
+ * @pattern: pattern to match after applying @mask
+ *
+ * Like gst_byte_reader_masked_scan_uint32() on the complete @data.
+ *
+ * Returns: the offset of the first 32 bit big endian value in @data that
+ * matches @pattern after applying @mask, or -1 if there is none.
+ */
+gint
+gst_sync_scan_uint32 (const guint8 * data, guint size, guint32 mask,
+    guint32 pattern)
+{
+  const guint8 *p, *end;
+
+  g_return_val_if_fail ((pattern & mask) == pattern, -1);
+
+  if (size < 4)
+    return -1;
+
+  /* one after the last possible start */
+  end = data + size - 3;
+
+  if ((mask >> 24) == 0xff) {
+    for (p = data; (p = memchr (p, pattern >> 24, end - p)); p++) {
+      if ((GST_READ_UINT32_BE (p) & mask) == pattern)
+        return p - data;
+    }
+  } else {
+    for (p = data; p < end; p++) {
+      if ((GST_READ_UINT32_BE (p) & mask) == pattern)
+        return p - data;
+    }
+  }
+
+  return -1;
+}
@@ -0,0 +1,34 @@
+/* GStreamer audio parsers
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_SYNC_SCAN_H__
+#define __GST_SYNC_SCAN_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+gint gst_sync_scan_uint16 (const guint8 * data, guint size, guint16 mask,
+    guint16 pattern);
+gint gst_sync_scan_uint32 (const guint8 * data, guint size, guint32 mask,
+    guint32 pattern);
+
+G_END_DECLS
+
+#endif /* __GST_SYNC_SCAN_H__ */
@@ -66,6 +66,20 @@
 #define ENTRY_SET_KEYFRAME(e) ((e)->flags = GST_AVI_KEYFRAME)
 #define ENTRY_UNSET_KEYFRAME(e) ((e)->flags = 0)
 
+/* accessors for the index entries, which are packed unless one of the
+ * entries of the stream could not be packed */
+#define PACKED_KEYFRAME_FLAG 0x80000000
+#define PACKED_BLOCK(s,n) (&(s)->index_blocks[(n) >> GST_AVI_INDEX_BLOCK_SHIFT])
+#define PACKED_OFFSET(s,n) ((s)->index_full ? (s)->index_full[n].offset : \
+    PACKED_BLOCK(s,n)->offset + (s)->index[n].offset)
+#define PACKED_TOTAL(s,n) ((s)->index_full ? (s)->index_full[n].total : \
+    PACKED_BLOCK(s,n)->total + (s)->index[n].total)
+#define PACKED_SIZE(s,n) ((s)->index_full ? (s)->index_full[n].size : \
+    (s)->index[n].size & ~PACKED_KEYFRAME_FLAG)
+#define PACKED_IS_KEYFRAME(s,n) ((s)->index_full ? \
+    ENTRY_IS_KEYFRAME (&(s)->index_full[n]) : \
+    ((s)->index[n].size & PACKED_KEYFRAME_FLAG) != 0)
+
 
 GST_DEBUG_CATEGORY_STATIC (avidemux_debug);
 #define GST_CAT_DEFAULT avidemux_debug
@@ -247,6 +261,8 @@ gst_avi_demux_reset_stream (GstAviDemux * avi, GstAviStream * stream)
   g_free (stream->strf.data);
   g_free (stream->name);
   g_free (stream->index);
+  g_free (stream->index_blocks);
+  g_free (stream->index_full);
   g_free (stream->indexes);
   if (stream->initdata)
     gst_buffer_unref (stream->initdata);
@@ -381,6 +397,14 @@ avi_stream_convert_time_to_frames_unchecked (GstAviStream * stream,
       stream->strh->scale * GST_SECOND);
 }
 
+/* in pull mode, the ODML subindexes of a stream are loaded on demand. This
+ * returns TRUE when @stream still has subindexes that were not read yet. */
+static inline gboolean
+gst_avi_demux_subindex_pending (GstAviDemux * avi, GstAviStream * stream)
+{
+  return !avi->streaming && stream->indexes != NULL;
+}
+
 static gboolean
 gst_avi_demux_src_convert (GstPad * pad,
     GstFormat src_format,
@@ -573,7 +597,8 @@ gst_avi_demux_handle_src_query (GstPad * pad, GstQuery * query)
           GST_DEBUG_OBJECT (query, "total frames is %" G_GUINT32_FORMAT,
               stream->idx_n);
 
-          if (stream->idx_n > 0)
+          if (stream->idx_n > 0 && !gst_avi_demux_subindex_pending (avi,
+                  stream))
             gst_query_set_duration (query, fmt, stream->idx_n);
           else if (gst_pad_query_convert (pad, GST_FORMAT_TIME,
                   duration, &fmt, &dur))
@@ -683,15 +708,56 @@ gst_avi_demux_seek_streams (GstAviDemux * avi, guint64 offset, gboolean before)
   return min;
 }
 
-static guint
-gst_avi_demux_index_entry_offset_search (GstAviIndexEntry * entry,
-    guint64 * offset)
+/*
+ * gst_avi_demux_index_search:
+ * @stream: the stream
+ * @by_offset: search on the offset instead of the total of the entries
+ * @value: the offset or total to look for
+ * @mode: GST_SEARCH_MODE_BEFORE or GST_SEARCH_MODE_AFTER
+ * @index: location for the index of the found entry
+ *
+ * Binary search in the packed index, with the semantics of
+ * gst_util_array_binary_search().
+ *
+ * Returns: TRUE when an entry was found.
+ */
+static gboolean
+gst_avi_demux_index_search (GstAviStream * stream, gboolean by_offset,
+    guint64 value, GstSearchMode mode, guint * index)
 {
-  if (entry->offset < *offset)
-    return -1;
-  else if (entry->offset > *offset)
-    return 1;
-  return 0;
+  guint lo = 0, hi = stream->idx_n;
+  guint64 val;
+
+  if (stream->idx_n == 0)
+    return FALSE;
+
+  /* find the first entry >= value */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    val = by_offset ? PACKED_OFFSET (stream, mid) : PACKED_TOTAL (stream, mid);
+    if (val < value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo < stream->idx_n) {
+    val = by_offset ? PACKED_OFFSET (stream, lo) : PACKED_TOTAL (stream, lo);
+    if (val == value || mode == GST_SEARCH_MODE_AFTER) {
+      *index = lo;
+      return TRUE;
+    }
+  } else if (mode == GST_SEARCH_MODE_AFTER) {
+    return FALSE;
+  }
+
+  /* BEFORE, take the entry before the first bigger one */
+  if (lo == 0)
+    return FALSE;
+
+  *index = lo - 1;
+  return TRUE;
 }
 
 static guint64
@@ -699,7 +765,7 @@ gst_avi_demux_seek_streams_index (GstAviDemux * avi, guint64 offset,
     gboolean before)
 {
   GstAviStream *stream;
-  GstAviIndexEntry *entry;
+  gboolean found;
   gint i;
   gint64 val, min = offset;
   guint index = 0;
@@ -709,19 +775,13 @@ gst_avi_demux_seek_streams_index (GstAviDemux * avi, guint64 offset,
 
     /* compensate for chunk header */
     offset += 8;
-    entry =
-        gst_util_array_binary_search (stream->index, stream->idx_n,
-        sizeof (GstAviIndexEntry),
-        (GCompareDataFunc) gst_avi_demux_index_entry_offset_search,
-        before ? GST_SEARCH_MODE_BEFORE : GST_SEARCH_MODE_AFTER, &offset, NULL);
+    found = gst_avi_demux_index_search (stream, TRUE, offset,
+        before ? GST_SEARCH_MODE_BEFORE : GST_SEARCH_MODE_AFTER, &index);
     offset -= 8;
 
-    if (entry)
-      index = entry - stream->index;
-
     if (before) {
-      if (entry) {
-        val = stream->index[index].offset;
+      if (found) {
+        val = PACKED_OFFSET (stream, index);
         GST_DEBUG_OBJECT (avi,
             "stream %d, previous entry at %" G_GUINT64_FORMAT, i, val);
         if (val < min)
@@ -730,18 +790,18 @@ gst_avi_demux_seek_streams_index (GstAviDemux * avi, guint64 offset,
       continue;
     }
 
-    if (!entry) {
+    if (!found) {
       GST_DEBUG_OBJECT (avi, "no position for stream %d, assuming at start", i);
       stream->current_entry = 0;
       stream->current_total = 0;
       continue;
     }
 
-    val = stream->index[index].offset - 8;
+    val = PACKED_OFFSET (stream, index) - 8;
     GST_DEBUG_OBJECT (avi, "stream %d, next entry at %" G_GUINT64_FORMAT, i,
         val);
 
-    stream->current_total = stream->index[index].total;
+    stream->current_total = PACKED_TOTAL (stream, index);
     stream->current_entry = index;
   }
 
@@ -791,7 +851,6 @@ gst_avi_demux_handle_sink_event (GstPad * pad, GstEvent * event)
       }
 
       if (avi->have_index) {
-        GstAviIndexEntry *entry;
         guint i = 0, index = 0, k = 0;
         GstAviStream *stream;
 
@@ -802,22 +861,17 @@ gst_avi_demux_handle_sink_event (GstPad * pad, GstEvent * event)
           stream = &avi->stream[i];
 
           /* find the index for start bytes offset */
-          entry = gst_util_array_binary_search (stream->index,
-              stream->idx_n, sizeof (GstAviIndexEntry),
-              (GCompareDataFunc) gst_avi_demux_index_entry_offset_search,
-              GST_SEARCH_MODE_AFTER, &start, NULL);
-
-          if (entry == NULL)
+          if (!gst_avi_demux_index_search (stream, TRUE, start,
+                  GST_SEARCH_MODE_AFTER, &index))
             continue;
-          index = entry - stream->index;
 
           /* we are on the stream with a chunk start offset closest to start */
-          if (!offset || stream->index[index].offset < offset) {
-            offset = stream->index[index].offset;
+          if (!offset || PACKED_OFFSET (stream, index) < offset) {
+            offset = PACKED_OFFSET (stream, index);
             k = i;
           }
           /* exact match needs no further searching */
-          if (stream->index[index].offset == start)
+          if (PACKED_OFFSET (stream, index) == start)
             break;
         } while (++i < avi->num_streams);
         start -= 8;
@@ -1237,6 +1291,8 @@ avih_too_small:
  * @locations: locations in the file (byte-offsets) that contain
  *             the actual indexes (see get_avi_demux_parse_subindex()).
  *             The array ends with GST_BUFFER_OFFSET_NONE.
+ * @ticks: the total duration of all the indexes in stream ticks, or 0 when
+ *         the superindex does not contain durations.
  *
  * Reads superindex (openDML-2 spec stuff) from the provided data.
  *
@@ -1245,15 +1301,17 @@ avih_too_small:
  */
 static gboolean
 gst_avi_demux_parse_superindex (GstAviDemux * avi,
-    GstBuffer * buf, guint64 ** _indexes)
+    GstBuffer * buf, guint64 ** _indexes, guint64 * _ticks)
 {
   guint8 *data;
   guint16 bpe = 16;
   guint32 num, i;
   guint64 *indexes;
+  guint64 ticks = 0;
   guint size;
 
   *_indexes = NULL;
+  *_ticks = 0;
 
   size = buf ? GST_BUFFER_SIZE (buf) : 0;
   if (size < 24)
@@ -1287,9 +1345,14 @@ gst_avi_demux_parse_superindex (GstAviDemux * avi,
       break;
     indexes[i] = GST_READ_UINT64_LE (&data[24 + bpe * i]);
     GST_DEBUG_OBJECT (avi, "index %d at %" G_GUINT64_FORMAT, i, indexes[i]);
+    /* the duration of the subindex, used to estimate the stream duration
+     * before all subindexes are loaded */
+    if (bpe >= 16)
+      ticks += GST_READ_UINT32_LE (&data[24 + bpe * i + 12]);
   }
   indexes[i] = GST_BUFFER_OFFSET_NONE;
   *_indexes = indexes;
+  *_ticks = ticks;
 
   gst_buffer_unref (buf);
 
@@ -1314,6 +1377,34 @@ invalid_params:
   }
 }
 
+/* Converts the index of @stream to unpacked entries, used when an entry does
+ * not fit in a packed one. */
+static gboolean
+gst_avi_demux_unpack_index (GstAviDemux * avi, GstAviStream * stream)
+{
+  GstAviIndexEntry *full;
+  guint i;
+
+  full = g_try_new (GstAviIndexEntry, MAX (stream->idx_max, 1));
+  if (G_UNLIKELY (!full))
+    return FALSE;
+
+  for (i = 0; i < stream->idx_n; i++) {
+    full[i].offset = PACKED_OFFSET (stream, i);
+    full[i].total = PACKED_TOTAL (stream, i);
+    full[i].size = PACKED_SIZE (stream, i);
+    full[i].flags = PACKED_IS_KEYFRAME (stream, i) ? GST_AVI_KEYFRAME : 0;
+  }
+
+  g_free (stream->index);
+  stream->index = NULL;
+  g_free (stream->index_blocks);
+  stream->index_blocks = NULL;
+  stream->index_full = full;
+
+  return TRUE;
+}
+
 /* add an entry to the index of a stream. @num should be an estimate of the
  * total amount of index entries for all streams and is used to dynamically
  * allocate memory for the index entries. */
@@ -1321,51 +1412,89 @@ static inline gboolean
 gst_avi_demux_add_index (GstAviDemux * avi, GstAviStream * stream,
     guint num, GstAviIndexEntry * entry)
 {
+  GstAviIndexPacked *packed;
+  GstAviIndexBlock *block = NULL;
+
   /* ensure index memory */
   if (G_UNLIKELY (stream->idx_n >= stream->idx_max)) {
     guint idx_max = stream->idx_max;
-    GstAviIndexEntry *new_idx;
+    GstAviIndexPacked *new_idx;
+    GstAviIndexBlock *new_blocks;
 
     /* we need to make some more room */
     if (idx_max == 0) {
       /* initial size guess, assume each stream has an equal amount of entries,
        * overshoot with at least 8K */
-      idx_max = (num / avi->num_streams) + (8192 / sizeof (GstAviIndexEntry));
+      idx_max = (num / avi->num_streams) + (8192 / sizeof (GstAviIndexPacked));
     } else {
-      idx_max += 8192 / sizeof (GstAviIndexEntry);
+      idx_max += 8192 / sizeof (GstAviIndexPacked);
       GST_DEBUG_OBJECT (avi, "expanded index from %u to %u",
           stream->idx_max, idx_max);
     }
-    new_idx = g_try_renew (GstAviIndexEntry, stream->index, idx_max);
-    /* out of memory, if this fails stream->index is untouched. */
-    if (G_UNLIKELY (!new_idx))
-      return FALSE;
-    /* use new index */
-    stream->index = new_idx;
+    if (G_UNLIKELY (stream->index_full)) {
+      GstAviIndexEntry *new_full;
+
+      new_full = g_try_renew (GstAviIndexEntry, stream->index_full, idx_max);
+      if (G_UNLIKELY (!new_full))
+        return FALSE;
+      stream->index_full = new_full;
+    } else {
+      new_blocks = g_try_renew (GstAviIndexBlock, stream->index_blocks,
+          DIV_ROUND_UP (idx_max, GST_AVI_INDEX_BLOCK_SIZE));
+      /* out of memory, if this fails the index is untouched. */
+      if (G_UNLIKELY (!new_blocks))
+        return FALSE;
+      stream->index_blocks = new_blocks;
+      new_idx = g_try_renew (GstAviIndexPacked, stream->index, idx_max);
+      if (G_UNLIKELY (!new_idx))
+        return FALSE;
+      /* use new index */
+      stream->index = new_idx;
+    }
     stream->idx_max = idx_max;
   }
 
-  /* update entry total and stream stats. The entry total can be converted to
+  /* calculate the entry total. The entry total can be converted to
    * the timestamp of the entry easily. */
+  if (stream->is_vbr) {
+    if (stream->strh->type == GST_RIFF_FCC_auds)
+      entry->total = stream->total_blocks;
+    else
+      entry->total = stream->idx_n;
+  } else {
+    entry->total = stream->total_bytes;
+  }
+
+  if (G_LIKELY (stream->index_full == NULL)) {
+    /* the first entry of a block provides the base values */
+    block = PACKED_BLOCK (stream, stream->idx_n);
+    if ((stream->idx_n & (GST_AVI_INDEX_BLOCK_SIZE - 1)) == 0) {
+      block->offset = entry->offset;
+      block->total = entry->total;
+    }
+    /* only happens for broken indexes with entries out of order or
+     * absurdly large chunks */
+    if (G_UNLIKELY (entry->offset < block->offset ||
+            entry->offset - block->offset > G_MAXUINT32 ||
+            entry->total - block->total > G_MAXUINT32 ||
+            entry->size & PACKED_KEYFRAME_FLAG)) {
+      GST_WARNING_OBJECT (avi, "stream %u: cannot pack index entry with "
+          "offset %" G_GUINT64_FORMAT " and size %u, not packing the index",
+          stream->num, entry->offset, entry->size);
+      if (G_UNLIKELY (!gst_avi_demux_unpack_index (avi, stream)))
+        return FALSE;
+    }
+  }
+
+  /* update stream stats */
   if (stream->strh->type == GST_RIFF_FCC_auds) {
     gint blockalign;
 
-    if (stream->is_vbr) {
-      entry->total = stream->total_blocks;
-    } else {
-      entry->total = stream->total_bytes;
-    }
     blockalign = stream->strf.auds->blockalign;
     if (blockalign > 0)
       stream->total_blocks += DIV_ROUND_UP (entry->size, blockalign);
     else
       stream->total_blocks++;
-  } else {
-    if (stream->is_vbr) {
-      entry->total = stream->idx_n;
-    } else {
-      entry->total = stream->total_bytes;
-    }
   }
   stream->total_bytes += entry->size;
   if (ENTRY_IS_KEYFRAME (entry))
@@ -1377,7 +1506,17 @@ gst_avi_demux_add_index (GstAviDemux * avi, GstAviStream * stream,
       ", offset %" G_GUINT64_FORMAT ", total %" G_GUINT64_FORMAT, stream->num,
       stream->idx_n, ENTRY_IS_KEYFRAME (entry), entry->size, entry->offset,
       entry->total);
-  stream->index[stream->idx_n++] = *entry;
+  if (G_UNLIKELY (stream->index_full)) {
+    stream->index_full[stream->idx_n++] = *entry;
+    return TRUE;
+  }
+
+  packed = &stream->index[stream->idx_n++];
+  packed->size = entry->size;
+  if (ENTRY_IS_KEYFRAME (entry))
+    packed->size |= PACKED_KEYFRAME_FLAG;
+  packed->offset = entry->offset - block->offset;
+  packed->total = entry->total - block->total;
 
   return TRUE;
 }
@@ -1389,19 +1528,19 @@ gst_avi_demux_get_buffer_info (GstAviDemux * avi, GstAviStream * stream,
     guint entry_n, GstClockTime * timestamp, GstClockTime * ts_end,
     guint64 * offset, guint64 * offset_end)
 {
-  GstAviIndexEntry *entry;
+  guint64 total;
 
-  entry = &stream->index[entry_n];
+  total = PACKED_TOTAL (stream, entry_n);
 
   if (stream->is_vbr) {
     /* VBR stream next timestamp */
     if (stream->strh->type == GST_RIFF_FCC_auds) {
       if (timestamp)
         *timestamp =
-            avi_stream_convert_frames_to_time_unchecked (stream, entry->total);
+            avi_stream_convert_frames_to_time_unchecked (stream, total);
       if (ts_end)
         *ts_end = avi_stream_convert_frames_to_time_unchecked (stream,
-            entry->total + 1);
+            total + 1);
     } else {
       if (timestamp)
         *timestamp =
@@ -1414,10 +1553,10 @@ gst_avi_demux_get_buffer_info (GstAviDemux * avi, GstAviStream * stream,
     /* constant rate stream */
     if (timestamp)
       *timestamp =
-          avi_stream_convert_bytes_to_time_unchecked (stream, entry->total);
+          avi_stream_convert_bytes_to_time_unchecked (stream, total);
     if (ts_end)
       *ts_end = avi_stream_convert_bytes_to_time_unchecked (stream,
-          entry->total + entry->size);
+          total + PACKED_SIZE (stream, entry_n));
   }
   if (stream->strh->type == GST_RIFF_FCC_vids) {
     /* video offsets are the frame number */
@@ -1463,6 +1602,11 @@ gst_avi_demux_do_index_stats (GstAviDemux * avi)
      * duration of this stream */
     gst_avi_demux_get_buffer_info (avi, stream, stream->idx_n - 1,
         NULL, &stream->idx_duration, NULL, NULL);
+    /* not all subindexes are loaded, use the duration of the superindex */
+    if (gst_avi_demux_subindex_pending (avi, stream) && stream->subidx_ticks)
+      stream->idx_duration =
+          avi_stream_convert_frames_to_time_unchecked (stream,
+          stream->subidx_ticks);
 
     total_idx += stream->idx_n;
 #ifndef GST_DISABLE_GST_DEBUG
@@ -1471,13 +1615,13 @@ gst_avi_demux_do_index_stats (GstAviDemux * avi)
     GST_INFO_OBJECT (avi, "Stream %d, dur %" GST_TIME_FORMAT ", %6u entries, "
         "%5u keyframes, entry size = %2u, total size = %10u, allocated %10u",
         i, GST_TIME_ARGS (stream->idx_duration), stream->idx_n,
-        stream->n_keyframes, (guint) sizeof (GstAviIndexEntry),
-        (guint) (stream->idx_n * sizeof (GstAviIndexEntry)),
-        (guint) (stream->idx_max * sizeof (GstAviIndexEntry)));
+        stream->n_keyframes, (guint) sizeof (GstAviIndexPacked),
+        (guint) (stream->idx_n * sizeof (GstAviIndexPacked)),
+        (guint) (stream->idx_max * sizeof (GstAviIndexPacked)));
   }
-  total_idx *= sizeof (GstAviIndexEntry);
+  total_idx *= sizeof (GstAviIndexPacked);
 #ifndef GST_DISABLE_GST_DEBUG
-  total_max *= sizeof (GstAviIndexEntry);
+  total_max *= sizeof (GstAviIndexPacked);
 #endif
   GST_INFO_OBJECT (avi, "%u bytes for index vs %u ideally, %u wasted",
       total_max, total_idx, total_max - total_idx);
@@ -1605,8 +1749,8 @@ out_of_mem:
   {
     GST_ELEMENT_ERROR (avi, RESOURCE, NO_SPACE_LEFT, (NULL),
         ("Cannot allocate memory for %u*%u=%u bytes",
-            (guint) sizeof (GstAviIndexEntry), num,
-            (guint) sizeof (GstAviIndexEntry) * num));
+            (guint) sizeof (GstAviIndexPacked), num,
+            (guint) sizeof (GstAviIndexPacked) * num));
     gst_buffer_unref (buf);
     return FALSE;
   }
@@ -1697,15 +1841,69 @@ gst_avi_demux_read_subindexes_push (GstAviDemux * avi)
   return perform_seek_to_offset (avi, avi->odml_subidxs[avi->odml_subidx]);
 }
 
+/*
+ * Read the next subindex of @stream in pull mode.
+ *
+ * Returns: FALSE when there were no more subindexes to read.
+ */
+static gboolean
+gst_avi_demux_read_subindex_pull (GstAviDemux * avi, GstAviStream * stream)
+{
+  guint32 tag;
+  GstBuffer *buf;
+  guint64 offset;
+
+  if (!gst_avi_demux_subindex_pending (avi, stream))
+    return FALSE;
+
+  offset = stream->indexes[stream->subidx_next++];
+
+  GST_DEBUG_OBJECT (avi, "stream %u: read subindex %u at %" G_GUINT64_FORMAT,
+      stream->num, stream->subidx_next - 1, offset);
+
+  if (gst_riff_read_chunk (GST_ELEMENT_CAST (avi), avi->sinkpad,
+          &offset, &tag, &buf) != GST_FLOW_OK)
+    goto done;
+
+  if ((tag != GST_MAKE_FOURCC ('i', 'x', '0' + stream->num / 10,
+              '0' + stream->num % 10)) &&
+      (tag != GST_MAKE_FOURCC ('0' + stream->num / 10,
+              '0' + stream->num % 10, 'i', 'x'))) {
+    /* Some ODML files (created by god knows what muxer) have a ##ix format
+     * instead of the 'official' ix##. They are still valid though. */
+    GST_WARNING_OBJECT (avi, "Not an ix## chunk (%" GST_FOURCC_FORMAT ")",
+        GST_FOURCC_ARGS (tag));
+    gst_buffer_unref (buf);
+    goto done;
+  }
+
+  gst_avi_demux_parse_subindex (avi, stream, buf);
+
+done:
+  if (stream->indexes[stream->subidx_next] == GST_BUFFER_OFFSET_NONE) {
+    GST_DEBUG_OBJECT (avi, "stream %u: all %u subindexes loaded, %u entries",
+        stream->num, stream->subidx_next, stream->idx_n);
+    g_free (stream->indexes);
+    stream->indexes = NULL;
+    /* we can calculate the exact duration now */
+    if (stream->idx_n > 0)
+      gst_avi_demux_get_buffer_info (avi, stream, stream->idx_n - 1,
+          NULL, &stream->idx_duration, NULL, NULL);
+  }
+  return TRUE;
+}
+
 /*
  * Read AVI index
+ *
+ * Only the first subindex of each stream is read when the superindex tells
+ * us the duration of the subindexes, the others are loaded when playback
+ * or seeking needs them.
  */
 static void
 gst_avi_demux_read_subindexes_pull (GstAviDemux * avi)
 {
-  guint32 tag;
-  GstBuffer *buf;
-  gint i, n;
+  gint n;
 
   GST_DEBUG_OBJECT (avi, "read subindexes for %d streams", avi->num_streams);
 
@@ -1715,28 +1913,14 @@ gst_avi_demux_read_subindexes_pull (GstAviDemux * avi)
     if (stream->indexes == NULL)
       continue;
 
-    for (i = 0; stream->indexes[i] != GST_BUFFER_OFFSET_NONE; i++) {
-      if (gst_riff_read_chunk (GST_ELEMENT_CAST (avi), avi->sinkpad,
-              &stream->indexes[i], &tag, &buf) != GST_FLOW_OK)
-        continue;
-      else if ((tag != GST_MAKE_FOURCC ('i', 'x', '0' + stream->num / 10,
-                  '0' + stream->num % 10)) &&
-          (tag != GST_MAKE_FOURCC ('0' + stream->num / 10,
-                  '0' + stream->num % 10, 'i', 'x'))) {
-        /* Some ODML files (created by god knows what muxer) have a ##ix format
-         * instead of the 'official' ix##. They are still valid though. */
-        GST_WARNING_OBJECT (avi, "Not an ix## chunk (%" GST_FOURCC_FORMAT ")",
-            GST_FOURCC_ARGS (tag));
-        gst_buffer_unref (buf);
-        continue;
-      }
-
-      if (!gst_avi_demux_parse_subindex (avi, stream, buf))
-        continue;
+    if (stream->subidx_ticks == 0) {
+      /* no durations, we need all the subindexes to know the duration */
+      while (gst_avi_demux_read_subindex_pull (avi, stream));
+    } else {
+      /* read until we have some entries */
+      while (stream->idx_n == 0 &&
+          gst_avi_demux_read_subindex_pull (avi, stream));
     }
-
-    g_free (stream->indexes);
-    stream->indexes = NULL;
   }
   /* get stream stats now */
   avi->have_index = gst_avi_demux_do_index_stats (avi);
@@ -2151,7 +2335,9 @@ gst_avi_demux_parse_stream (GstAviDemux * avi, GstBuffer * buf)
             tag == GST_MAKE_FOURCC ('i', 'x', '0' + avi->num_streams / 10,
                 '0' + avi->num_streams % 10)) {
           g_free (stream->indexes);
-          gst_avi_demux_parse_superindex (avi, sub, &stream->indexes);
+          gst_avi_demux_parse_superindex (avi, sub, &stream->indexes,
+              &stream->subidx_ticks);
+          stream->subidx_next = 0;
           stream->superindex = TRUE;
           sub = NULL;
           break;
@@ -2425,12 +2611,10 @@ static guint
 gst_avi_demux_index_prev (GstAviDemux * avi, GstAviStream * stream,
     guint last, gboolean keyframe)
 {
-  GstAviIndexEntry *entry;
   guint i;
 
   for (i = last; i > 0; i--) {
-    entry = &stream->index[i - 1];
-    if (!keyframe || ENTRY_IS_KEYFRAME (entry)) {
+    if (!keyframe || PACKED_IS_KEYFRAME (stream, i - 1)) {
       return i - 1;
     }
   }
@@ -2441,28 +2625,16 @@ static guint
 gst_avi_demux_index_next (GstAviDemux * avi, GstAviStream * stream,
     guint last, gboolean keyframe)
 {
-  GstAviIndexEntry *entry;
   gint i;
 
   for (i = last + 1; i < stream->idx_n; i++) {
-    entry = &stream->index[i];
-    if (!keyframe || ENTRY_IS_KEYFRAME (entry)) {
+    if (!keyframe || PACKED_IS_KEYFRAME (stream, i)) {
       return i;
     }
   }
   return stream->idx_n - 1;
 }
 
-static guint
-gst_avi_demux_index_entry_search (GstAviIndexEntry * entry, guint64 * total)
-{
-  if (entry->total < *total)
-    return -1;
-  else if (entry->total > *total)
-    return 1;
-  return 0;
-}
-
 /*
  * gst_avi_demux_index_for_time:
  * @avi: Avi object
@@ -2484,10 +2656,23 @@ gst_avi_demux_index_for_time (GstAviDemux * avi,
 
   GST_LOG_OBJECT (avi, "search time:%" GST_TIME_FORMAT, GST_TIME_ARGS (time));
 
+  /* load subindexes until we have the entries for @time */
+  while (gst_avi_demux_subindex_pending (avi, stream)) {
+    GstClockTime ts_end = 0;
+
+    if (stream->idx_n > 0)
+      gst_avi_demux_get_buffer_info (avi, stream, stream->idx_n - 1,
+          NULL, &ts_end, NULL, NULL);
+    if (time < ts_end)
+      break;
+    gst_avi_demux_read_subindex_pull (avi, stream);
+  }
+
   /* easy (and common) cases */
   if (time == 0 || stream->idx_n == 0)
     return 0;
-  if (time >= stream->idx_duration)
+  if (time >= stream->idx_duration &&
+      !gst_avi_demux_subindex_pending (avi, stream))
     return stream->idx_n - 1;
 
   /* figure out where we need to go. For that we convert the time to an
@@ -2505,26 +2690,21 @@ gst_avi_demux_index_for_time (GstAviDemux * avi,
   }
 
   if (index == -1) {
-    GstAviIndexEntry *entry;
-
     /* no index, find index with binary search on total */
     GST_LOG_OBJECT (avi, "binary search for entry with total %"
         G_GUINT64_FORMAT, total);
 
-    entry = gst_util_array_binary_search (stream->index,
-        stream->idx_n, sizeof (GstAviIndexEntry),
-        (GCompareDataFunc) gst_avi_demux_index_entry_search,
-        GST_SEARCH_MODE_BEFORE, &total, NULL);
-
-    if (entry == NULL) {
+    if (!gst_avi_demux_index_search (stream, FALSE, total,
+            GST_SEARCH_MODE_BEFORE, &index)) {
       GST_LOG_OBJECT (avi, "not found, assume index 0");
       index = 0;
     } else {
-      index = entry - stream->index;
       GST_LOG_OBJECT (avi, "found at %u", index);
     }
   } else {
     GST_LOG_OBJECT (avi, "converted time to index %u", index);
+    if (index >= stream->idx_n)
+      index = stream->idx_n - 1;
   }
 
   return index;
@@ -2658,8 +2838,8 @@ out_of_mem:
   {
     GST_ELEMENT_ERROR (avi, RESOURCE, NO_SPACE_LEFT, (NULL),
         ("Cannot allocate memory for %u*%u=%u bytes",
-            (guint) sizeof (GstAviIndexEntry), num,
-            (guint) sizeof (GstAviIndexEntry) * num));
+            (guint) sizeof (GstAviIndexPacked), num,
+            (guint) sizeof (GstAviIndexPacked) * num));
     gst_buffer_unref (buf);
     return FALSE;
   }
@@ -3009,8 +3189,8 @@ out_of_mem:
   {
     GST_ELEMENT_ERROR (avi, RESOURCE, NO_SPACE_LEFT, (NULL),
         ("Cannot allocate memory for %u*%u=%u bytes",
-            (guint) sizeof (GstAviIndexEntry), num,
-            (guint) sizeof (GstAviIndexEntry) * num));
+            (guint) sizeof (GstAviIndexPacked), num,
+            (guint) sizeof (GstAviIndexPacked) * num));
     return FALSE;
   }
 }
@@ -3987,7 +4167,7 @@ gst_avi_demux_move_stream (GstAviDemux * avi, GstAviStream * stream,
       stream->current_offset_end);
 
   GST_DEBUG_OBJECT (avi, "Seeking to offset %" G_GUINT64_FORMAT,
-      stream->index[index].offset);
+      PACKED_OFFSET (stream, index));
 }
 
 /*
@@ -4016,7 +4196,7 @@ gst_avi_demux_do_seek (GstAviDemux * avi, GstSegment * segment)
   GST_DEBUG_OBJECT (avi, "Got entry %u", index);
 
   /* check if we are already on a keyframe */
-  if (!ENTRY_IS_KEYFRAME (&stream->index[index])) {
+  if (!PACKED_IS_KEYFRAME (stream, index)) {
     GST_DEBUG_OBJECT (avi, "not keyframe, searching back");
     /* now go to the previous keyframe, this is where we should start
      * decoding from. */
@@ -4053,7 +4233,7 @@ gst_avi_demux_do_seek (GstAviDemux * avi, GstSegment * segment)
     index = gst_avi_demux_index_for_time (avi, ostream, seek_time);
 
     /* move to previous keyframe */
-    if (!ENTRY_IS_KEYFRAME (&ostream->index[index]))
+    if (!PACKED_IS_KEYFRAME (ostream, index))
       index = gst_avi_demux_index_prev (avi, ostream, index, TRUE);
 
     gst_avi_demux_move_stream (avi, ostream, segment, index);
@@ -4292,7 +4472,7 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
       str_num, index, GST_TIME_ARGS (cur));
 
   /* check if we are already on a keyframe */
-  if (!ENTRY_IS_KEYFRAME (&stream->index[index])) {
+  if (!PACKED_IS_KEYFRAME (stream, index)) {
     GST_DEBUG_OBJECT (avi, "Entry is not a keyframe - searching back");
     /* now go to the previous keyframe, this is where we should start
      * decoding from. */
@@ -4307,7 +4487,7 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
   /* re-use cur to be the timestamp of the seek as it _will_ be */
   cur = stream->current_timestamp;
 
-  min_offset = stream->index[index].offset;
+  min_offset = PACKED_OFFSET (stream, index);
   avi->seek_kf_offset = min_offset - 8;
 
   GST_DEBUG_OBJECT (avi,
@@ -4328,7 +4508,7 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
         idx, GST_TIME_ARGS (cur));
 
     /* check if we are already on a keyframe */
-    if (!ENTRY_IS_KEYFRAME (&str->index[idx])) {
+    if (!PACKED_IS_KEYFRAME (str, idx)) {
       GST_DEBUG_OBJECT (avi, "Entry is not a keyframe - searching back");
       /* now go to the previous keyframe, this is where we should start
        * decoding from. */
@@ -4340,8 +4520,8 @@ avi_demux_handle_seek_push (GstAviDemux * avi, GstPad * pad, GstEvent * event)
         &str->current_timestamp, &str->current_ts_end,
         &str->current_offset, &str->current_offset_end);
 
-    if (str->index[idx].offset < min_offset) {
-      min_offset = str->index[idx].offset;
+    if (PACKED_OFFSET (str, idx) < min_offset) {
+      min_offset = PACKED_OFFSET (str, idx);
       GST_DEBUG_OBJECT (avi,
           "Found an earlier offset at %" G_GUINT64_FORMAT ", str %u",
           min_offset, n);
@@ -4591,15 +4771,24 @@ gst_avi_demux_advance (GstAviDemux * avi, GstAviStream * stream,
       /* and start from the previous keyframe now */
       new_entry = stream->step_entry;
     } else {
-      /* EOS */
-      GST_DEBUG_OBJECT (avi, "forward reached stop %u", stream->stop_entry);
-      goto eos;
+      /* load the next subindexes when we played all loaded entries */
+      if (stream->stop_entry == stream->idx_n) {
+        while (new_entry >= stream->idx_n &&
+            gst_avi_demux_read_subindex_pull (avi, stream));
+        stream->stop_entry = gst_avi_demux_index_last (avi, stream);
+      }
+
+      if (new_entry >= stream->stop_entry) {
+        /* EOS */
+        GST_DEBUG_OBJECT (avi, "forward reached stop %u", stream->stop_entry);
+        goto eos;
+      }
     }
   }
 
   if (new_entry != old_entry) {
     stream->current_entry = new_entry;
-    stream->current_total = stream->index[new_entry].total;
+    stream->current_total = PACKED_TOTAL (stream, new_entry);
 
     if (new_entry == old_entry + 1) {
       GST_DEBUG_OBJECT (avi, "moved forwards from %u to %u",
@@ -4688,7 +4877,6 @@ gst_avi_demux_loop_data (GstAviDemux * avi)
   GstClockTime timestamp, duration;
   guint64 out_offset, out_offset_end;
   gboolean keyframe;
-  GstAviIndexEntry *entry;
 
   do {
     stream_num = gst_avi_demux_find_next (avi, avi->segment.rate);
@@ -4716,10 +4904,9 @@ gst_avi_demux_loop_data (GstAviDemux * avi)
     out_offset_end = stream->current_offset_end;
 
     /* get the entry data info */
-    entry = &stream->index[stream->current_entry];
-    offset = entry->offset;
-    size = entry->size;
-    keyframe = ENTRY_IS_KEYFRAME (entry);
+    offset = PACKED_OFFSET (stream, stream->current_entry);
+    size = PACKED_SIZE (stream, stream->current_entry);
+    keyframe = PACKED_IS_KEYFRAME (stream, stream->current_entry);
 
     /* skip empty entries */
     if (size == 0) {
@@ -48,7 +48,7 @@ G_BEGIN_DECLS
    (((chunkid) >> 8) & 0xff) - '0')
 
 
-/* new index entries 24 bytes */
+/* index entry as used while parsing, 24 bytes */
 typedef struct {
   guint32        flags;
   guint32        size;    /* bytes of the data */
@@ -56,6 +56,23 @@ typedef struct {
   guint64        total;   /* total bytes before */
 } GstAviIndexEntry;
 
+/* index entries as stored, 12 bytes. offset and total are deltas against the
+ * GstAviIndexBlock the entry belongs to */
+typedef struct {
+  guint32        size;    /* bytes of the data, upper bit marks keyframes */
+  guint32        offset;  /* data offset relative to the block offset */
+  guint32        total;   /* total relative to the block total */
+} GstAviIndexPacked;
+
+#define GST_AVI_INDEX_BLOCK_SHIFT  6
+#define GST_AVI_INDEX_BLOCK_SIZE   (1 << GST_AVI_INDEX_BLOCK_SHIFT)
+
+/* base values for GST_AVI_INDEX_BLOCK_SIZE consecutive entries */
+typedef struct {
+  guint64        offset;  /* data offset of the first entry in the block */
+  guint64        total;   /* total of the first entry in the block */
+} GstAviIndexBlock;
+
 typedef struct {
   /* index of this streamcontext */
   guint          num;
@@ -109,9 +126,16 @@ typedef struct {
   /* openDML support (for files >4GB) */
   gboolean       superindex;
   guint64       *indexes;
+  /* in pull mode subindexes are parsed when needed, this is the
+   * first one in @indexes that was not parsed yet */
+  guint          subidx_next;
+  /* stream length in strh ticks according to the superindex */
+  guint64        subidx_ticks;
 
   /* new indexes */
-  GstAviIndexEntry *index;     /* array with index entries */
+  GstAviIndexPacked *index;    /* array with index entries */
+  GstAviIndexBlock  *index_blocks; /* base values for the entries */
+  GstAviIndexEntry  *index_full; /* entries that could not be packed */
   guint             idx_n;     /* number of entries */
   guint             idx_max;   /* max allocated size of entries */
 
@@ -39,6 +39,9 @@ GST_DEBUG_CATEGORY (equalizer_debug);
 #define BANDS_LOCK(equ) g_mutex_lock(equ->bands_lock)
 #define BANDS_UNLOCK(equ) g_mutex_unlock(equ->bands_lock)
 
+/* Number of frames that are converted from integer samples at once */
+#define BLOCK_FRAMES 256
+
 static void gst_iir_equalizer_child_proxy_interface_init (gpointer g_iface,
     gpointer iface_data);
 
@@ -410,6 +413,7 @@ gst_iir_equalizer_finalize (GObject * object)
 
   g_free (equ->bands);
   g_free (equ->history);
+  g_free (equ->scratch);
 
   g_mutex_free (equ->bands_lock);
 
@@ -633,6 +637,10 @@ alloc_history (GstIirEqualizer * equ)
   equ->history =
       g_malloc0 (equ->history_size * GST_AUDIO_FILTER (equ)->format.channels *
       equ->freq_band_count);
+  g_free (equ->scratch);
+  equ->scratch =
+      g_malloc (BLOCK_FRAMES * GST_AUDIO_FILTER (equ)->format.channels *
+      sizeof (gdouble));
 }
 
 void
@@ -725,103 +733,109 @@ gst_iir_equalizer_compute_frequencies (GstIirEqualizer * equ, guint new_count)
 
 /* start of code that is type specific */
 
-#define CREATE_OPTIMIZED_FUNCTIONS_INT(TYPE,BIG_TYPE,MIN_VAL,MAX_VAL)   \
-typedef struct {                                                        \
-  BIG_TYPE x1, x2;          /* history of input values for a filter */  \
-  BIG_TYPE y1, y2;          /* history of output values for a filter */ \
-} SecondOrderHistory ## TYPE;                                           \
-                                                                        \
-static inline BIG_TYPE                                                  \
-one_step_ ## TYPE (GstIirEqualizerBand *filter,                         \
-    SecondOrderHistory ## TYPE *history, BIG_TYPE input)                \
+/* The bands are applied one after another to a complete block of samples,
+ * which keeps the coefficients of a band in registers. The history is
+ * stored as x1, x2, y1, y2 for all channels of a band, so that the
+ * innermost loop runs over the channels with the same coefficients and
+ * the compiler can process several channels at once with SIMD
+ * instructions. There are variants for one and two channels where the
+ * number of channels is known at compile time. */
+#define CREATE_BLOCK_FUNCTIONS(TYPE)                                    \
+static inline void                                                      \
+process_bands_ ## TYPE (GstIirEqualizer *equ, TYPE *data,               \
+    guint frames, guint channels)                                       \
 {                                                                       \
-  /* calculate output */                                                \
-  BIG_TYPE output = filter->a0 * input +                                \
-      filter->a1 * history->x1 + filter->a2 * history->x2 +             \
-      filter->b1 * history->y1 + filter->b2 * history->y2;              \
-  /* update history */                                                  \
-  history->y2 = history->y1;                                            \
-  history->y1 = output;                                                 \
-  history->x2 = history->x1;                                            \
-  history->x1 = input;                                                  \
+  guint i, c, f, nf = equ->freq_band_count;                             \
+  GstIirEqualizerBand **filters = equ->bands;                           \
+  TYPE *history = equ->history;                                         \
+  TYPE *x1, *x2, *y1, *y2, *d;                                          \
+  TYPE input, output;                                                   \
+  gdouble a0, a1, a2, b1, b2;                                           \
+                                                                        \
+  for (f = 0; f < nf; f++) {                                            \
+    a0 = filters[f]->a0;                                                \
+    a1 = filters[f]->a1;                                                \
+    a2 = filters[f]->a2;                                                \
+    b1 = filters[f]->b1;                                                \
+    b2 = filters[f]->b2;                                                \
+    x1 = history + 4 * f * channels;                                    \
+    x2 = x1 + channels;                                                 \
+    y1 = x2 + channels;                                                 \
+    y2 = y1 + channels;                                                 \
                                                                         \
-  return output;                                                        \
+    d = data;                                                           \
+    for (i = 0; i < frames; i++) {                                      \
+      for (c = 0; c < channels; c++) {                                  \
+        input = d[c];                                                   \
+        /* calculate output */                                          \
+        output = a0 * input + a1 * x1[c] + a2 * x2[c] +                 \
+            b1 * y1[c] + b2 * y2[c];                                    \
+        /* update history */                                            \
+        y2[c] = y1[c];                                                  \
+        y1[c] = output;                                                 \
+        x2[c] = x1[c];                                                  \
+        x1[c] = input;                                                  \
+        d[c] = output;                                                  \
+      }                                                                 \
+      d += channels;                                                    \
+    }                                                                   \
+  }                                                                     \
 }                                                                       \
                                                                         \
+static void                                                             \
+process_block_ ## TYPE (GstIirEqualizer *equ, TYPE *data,               \
+    guint frames, guint channels)                                       \
+{                                                                       \
+  if (channels == 1)                                                    \
+    process_bands_ ## TYPE (equ, data, frames, 1);                      \
+  else if (channels == 2)                                               \
+    process_bands_ ## TYPE (equ, data, frames, 2);                      \
+  else                                                                  \
+    process_bands_ ## TYPE (equ, data, frames, channels);               \
+}
+
+CREATE_BLOCK_FUNCTIONS (gfloat);
+CREATE_BLOCK_FUNCTIONS (gdouble);
+
+#define CREATE_OPTIMIZED_FUNCTIONS_INT(TYPE,BIG_TYPE,MIN_VAL,MAX_VAL)   \
 static const guint                                                      \
-history_size_ ## TYPE = sizeof (SecondOrderHistory ## TYPE);            \
+history_size_ ## TYPE = 4 * sizeof (BIG_TYPE);                          \
                                                                         \
 static void                                                             \
 gst_iir_equ_process_ ## TYPE (GstIirEqualizer *equ, guint8 *data,       \
 guint size, guint channels)                                             \
 {                                                                       \
   guint frames = size / channels / sizeof (TYPE);                       \
-  guint i, c, f, nf = equ->freq_band_count;                             \
+  guint i, n;                                                           \
+  TYPE *d = (TYPE *) data;                                              \
+  BIG_TYPE *scratch = equ->scratch;                                     \
   BIG_TYPE cur;                                                         \
-  GstIirEqualizerBand **filters = equ->bands;                           \
                                                                         \
-  for (i = 0; i < frames; i++) {                                        \
-    SecondOrderHistory ## TYPE *history = equ->history;                 \
-    for (c = 0; c < channels; c++) {                                    \
-      cur = *((TYPE *) data);                                           \
-      for (f = 0; f < nf; f++) {                                        \
-        cur = one_step_ ## TYPE (filters[f], history, cur);             \
-        history++;                                                      \
-      }                                                                 \
-      cur = CLAMP (cur, MIN_VAL, MAX_VAL);                              \
-      *((TYPE *) data) = (TYPE) floor (cur);                            \
-      data += sizeof (TYPE);                                            \
+  while (frames) {                                                      \
+    n = MIN (frames, BLOCK_FRAMES);                                     \
+    for (i = 0; i < n * channels; i++)                                  \
+      scratch[i] = d[i];                                                \
+    process_block_ ## BIG_TYPE (equ, scratch, n, channels);             \
+    for (i = 0; i < n * channels; i++) {                                \
+      cur = CLAMP (scratch[i], MIN_VAL, MAX_VAL);                       \
+      d[i] = (TYPE) floor (cur);                                        \
     }                                                                   \
+    d += n * channels;                                                  \
+    frames -= n;                                                        \
   }                                                                     \
 }
 
 #define CREATE_OPTIMIZED_FUNCTIONS(TYPE)                                \
-typedef struct {                                                        \
-  TYPE x1, x2;          /* history of input values for a filter */  \
-  TYPE y1, y2;          /* history of output values for a filter */ \
-} SecondOrderHistory ## TYPE;                                           \
-                                                                        \
-static inline TYPE                                                      \
-one_step_ ## TYPE (GstIirEqualizerBand *filter,                         \
-    SecondOrderHistory ## TYPE *history, TYPE input)                    \
-{                                                                       \
-  /* calculate output */                                                \
-  TYPE output = filter->a0 * input + filter->a1 * history->x1 +         \
-      filter->a2 * history->x2 + filter->b1 * history->y1 +             \
-      filter->b2 * history->y2;                                         \
-  /* update history */                                                  \
-  history->y2 = history->y1;                                            \
-  history->y1 = output;                                                 \
-  history->x2 = history->x1;                                            \
-  history->x1 = input;                                                  \
-                                                                        \
-  return output;                                                        \
-}                                                                       \
-                                                                        \
 static const guint                                                      \
-history_size_ ## TYPE = sizeof (SecondOrderHistory ## TYPE);            \
+history_size_ ## TYPE = 4 * sizeof (TYPE);                              \
                                                                         \
 static void                                                             \
 gst_iir_equ_process_ ## TYPE (GstIirEqualizer *equ, guint8 *data,       \
 guint size, guint channels)                                             \
 {                                                                       \
   guint frames = size / channels / sizeof (TYPE);                       \
-  guint i, c, f, nf = equ->freq_band_count;                             \
-  TYPE cur;                                                             \
-  GstIirEqualizerBand **filters = equ->bands;                           \
                                                                         \
-  for (i = 0; i < frames; i++) {                                        \
-    SecondOrderHistory ## TYPE *history = equ->history;                 \
-    for (c = 0; c < channels; c++) {                                    \
-      cur = *((TYPE *) data);                                           \
-      for (f = 0; f < nf; f++) {                                        \
-        cur = one_step_ ## TYPE (filters[f], history, cur);             \
-        history++;                                                      \
-      }                                                                 \
-      *((TYPE *) data) = (TYPE) cur;                                    \
-      data += sizeof (TYPE);                                            \
-    }                                                                   \
-  }                                                                     \
+  process_block_ ## TYPE (equ, (TYPE *) data, frames, channels);        \
 }
 
 CREATE_OPTIMIZED_FUNCTIONS_INT (gint16, gfloat, -32768.0, 32767.0);
@@ -60,6 +60,8 @@ struct _GstIirEqualizer
   /* for each band and channel */
   gpointer history;
   guint history_size;
+  /* 16 bit samples are converted to this in blocks */
+  gpointer scratch;
 
   gboolean need_new_coefficients;
 
@@ -91,6 +91,15 @@ GST_BOILERPLATE (GstFlvDemux, gst_flv_demux, GstElement, GST_TYPE_ELEMENT);
 /* two seconds - consider pts are resynced to another base if this different */
 #define RESYNC_THRESHOLD 2000
 
+enum
+{
+  PROP_0,
+  PROP_SCAN_INDEX,
+  PROP_KEYFRAME_INDEX
+};
+
+#define DEFAULT_SCAN_INDEX FALSE
+
 static gboolean flv_demux_handle_seek_push (GstFlvDemux * demux,
     GstEvent * event);
 static gboolean gst_flv_demux_handle_seek_pull (GstFlvDemux * demux,
@@ -99,13 +108,65 @@ static gboolean gst_flv_demux_handle_seek_pull (GstFlvDemux * demux,
 static gboolean gst_flv_demux_query (GstPad * pad, GstQuery * query);
 static gboolean gst_flv_demux_src_event (GstPad * pad, GstEvent * event);
 
+static void gst_flv_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_flv_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+
+/* find the last index entry with a position (or time) <= @value.
+ * Must be called with the index lock.
+ *
+ * Returns: the index of the entry or -1 if there is none. */
+static gint
+gst_flv_demux_index_search (GstFlvDemux * demux, gboolean by_pos,
+    guint64 value)
+{
+  GstFlvDemuxIndexEntry *entries;
+  guint lo = 0, hi = demux->kf_index->len;
+
+  entries = (GstFlvDemuxIndexEntry *) demux->kf_index->data;
+
+  /* find the first entry > value */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    guint64 val = by_pos ? entries[mid].pos : entries[mid].time;
+
+    if (val <= value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (gint) lo - 1;
+}
+
+/* look up the last keyframe at or before @value, in time or bytes */
+static gboolean
+gst_flv_demux_index_lookup (GstFlvDemux * demux, gboolean by_pos,
+    guint64 value, GstClockTime * time, guint64 * pos)
+{
+  gint idx;
+
+  g_mutex_lock (demux->index_lock);
+  idx = gst_flv_demux_index_search (demux, by_pos, value);
+  if (idx >= 0) {
+    GstFlvDemuxIndexEntry *entry =
+        &g_array_index (demux->kf_index, GstFlvDemuxIndexEntry, idx);
+
+    *time = entry->time;
+    *pos = entry->pos;
+  }
+  g_mutex_unlock (demux->index_lock);
+
+  return idx >= 0;
+}
 
 static void
 gst_flv_demux_parse_and_add_index_entry (GstFlvDemux * demux, GstClockTime ts,
     guint64 pos, gboolean keyframe)
 {
-  static GstIndexAssociation associations[2];
-  static GstIndexEntry *entry;
+  GstIndex *index = NULL;
 
   GST_LOG_OBJECT (demux,
       "adding key=%d association %" GST_TIME_FORMAT "-> %" G_GUINT64_FORMAT,
@@ -115,40 +176,178 @@ gst_flv_demux_parse_and_add_index_entry (GstFlvDemux * demux, GstClockTime ts,
   if (!demux->upstream_seekable)
     return;
 
-  /* entry may already have been added before, avoid adding indefinitely */
-  entry = gst_index_get_assoc_entry (demux->index, demux->index_id,
-      GST_INDEX_LOOKUP_EXACT, GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, pos);
-
-  if (entry) {
-#ifndef GST_DISABLE_GST_DEBUG
-    gint64 time;
-    gboolean key;
-
-    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-    key = ! !(GST_INDEX_ASSOC_FLAGS (entry) & GST_ASSOCIATION_FLAG_KEY_UNIT);
-    GST_LOG_OBJECT (demux, "position already mapped to time %" GST_TIME_FORMAT
-        ", keyframe %d", GST_TIME_ARGS (time), key);
-    /* there is not really a way to delete the existing one */
-    if (time != ts || key != ! !keyframe)
-      GST_DEBUG_OBJECT (demux, "metadata mismatch");
-#endif
-    return;
+  g_mutex_lock (demux->index_lock);
+  if (keyframe) {
+    GstFlvDemuxIndexEntry *entry = NULL;
+    gint idx;
+
+    idx = gst_flv_demux_index_search (demux, TRUE, pos);
+    if (idx >= 0)
+      entry = &g_array_index (demux->kf_index, GstFlvDemuxIndexEntry, idx);
+
+    /* entry may already have been added before, avoid adding indefinitely */
+    if (entry && entry->pos == pos) {
+      GST_LOG_OBJECT (demux, "position already mapped to time %"
+          GST_TIME_FORMAT, GST_TIME_ARGS (entry->time));
+      if (entry->time != ts)
+        GST_DEBUG_OBJECT (demux, "metadata mismatch");
+    } else {
+      GstFlvDemuxIndexEntry new_entry;
+
+      new_entry.time = ts;
+      new_entry.pos = pos;
+      if ((guint) (idx + 1) == demux->kf_index->len)
+        g_array_append_val (demux->kf_index, new_entry);
+      else
+        g_array_insert_val (demux->kf_index, idx + 1, new_entry);
+
+      /* also keep an application provided index up to date */
+      if (demux->index)
+        index = gst_object_ref (demux->index);
+    }
   }
 
-  associations[0].format = GST_FORMAT_TIME;
-  associations[0].value = ts;
-  associations[1].format = GST_FORMAT_BYTES;
-  associations[1].value = pos;
-
-  gst_index_add_associationv (demux->index, demux->index_id,
-      (keyframe) ? GST_ASSOCIATION_FLAG_KEY_UNIT :
-      GST_ASSOCIATION_FLAG_DELTA_UNIT, 2,
-      (const GstIndexAssociation *) &associations);
-
   if (pos > demux->index_max_pos)
     demux->index_max_pos = pos;
   if (ts > demux->index_max_time)
     demux->index_max_time = ts;
+  g_mutex_unlock (demux->index_lock);
+
+  if (index) {
+    GstIndexAssociation associations[2];
+
+    associations[0].format = GST_FORMAT_TIME;
+    associations[0].value = ts;
+    associations[1].format = GST_FORMAT_BYTES;
+    associations[1].value = pos;
+
+    gst_index_add_associationv (index, demux->index_id,
+        GST_ASSOCIATION_FLAG_KEY_UNIT, 2,
+        (const GstIndexAssociation *) &associations);
+    gst_object_unref (index);
+  }
+}
+
+/* the application thread reads this when exporting the index */
+static void
+gst_flv_demux_mark_indexed (GstFlvDemux * demux)
+{
+  g_mutex_lock (demux->index_lock);
+  demux->indexed = TRUE;
+  g_mutex_unlock (demux->index_lock);
+}
+
+/* serialize the keyframe index, all values are big endian:
+ *  4 bytes  'FLVI'
+ *  1 byte   version (1)
+ *  1 byte   flags, bit 0 set when the index covers the complete file
+ *  2 bytes  reserved
+ *  8 bytes  size of the file in bytes
+ *  4 bytes  number of entries
+ * followed by the entries, 8 bytes time in nanoseconds and 8 bytes position
+ */
+#define FLV_INDEX_HEADER_SIZE 20
+#define FLV_INDEX_ENTRY_SIZE 16
+#define FLV_INDEX_FLAG_COMPLETE 0x01
+
+static GstBuffer *
+gst_flv_demux_export_index (GstFlvDemux * demux)
+{
+  GstFormat fmt = GST_FORMAT_BYTES;
+  gint64 file_size = demux->file_size;
+  GstBuffer *buffer;
+  guint8 *data;
+  guint i, n;
+
+  if (!file_size && (!gst_pad_query_peer_duration (demux->sinkpad, &fmt,
+              &file_size) || fmt != GST_FORMAT_BYTES))
+    file_size = 0;
+
+  g_mutex_lock (demux->index_lock);
+  n = demux->kf_index->len;
+  buffer = gst_buffer_new_and_alloc (FLV_INDEX_HEADER_SIZE +
+      n * FLV_INDEX_ENTRY_SIZE);
+  data = GST_BUFFER_DATA (buffer);
+
+  memcpy (data, "FLVI", 4);
+  data[4] = 1;
+  data[5] = (demux->indexed || demux->scan_ret == GST_FLOW_UNEXPECTED) ?
+      FLV_INDEX_FLAG_COMPLETE : 0;
+  data[6] = data[7] = 0;
+  GST_WRITE_UINT64_BE (data + 8, file_size);
+  GST_WRITE_UINT32_BE (data + 16, n);
+  data += FLV_INDEX_HEADER_SIZE;
+
+  for (i = 0; i < n; i++) {
+    GstFlvDemuxIndexEntry *entry =
+        &g_array_index (demux->kf_index, GstFlvDemuxIndexEntry, i);
+
+    GST_WRITE_UINT64_BE (data, entry->time);
+    GST_WRITE_UINT64_BE (data + 8, entry->pos);
+    data += FLV_INDEX_ENTRY_SIZE;
+  }
+  g_mutex_unlock (demux->index_lock);
+
+  GST_DEBUG_OBJECT (demux, "exported index with %u entries", n);
+
+  return buffer;
+}
+
+/* merge a previously exported index into ours, the file size in it should
+ * match the size of the file we are reading */
+static void
+gst_flv_demux_import_index (GstFlvDemux * demux, GstBuffer * buffer)
+{
+  GstFormat fmt = GST_FORMAT_BYTES;
+  gint64 file_size = -1;
+  guint8 *data;
+  guint size, i, n;
+  gboolean complete;
+
+  data = GST_BUFFER_DATA (buffer);
+  size = GST_BUFFER_SIZE (buffer);
+
+  if (size < FLV_INDEX_HEADER_SIZE || memcmp (data, "FLVI", 4) != 0 ||
+      data[4] != 1)
+    goto invalid;
+
+  n = GST_READ_UINT32_BE (data + 16);
+  if (n > (size - FLV_INDEX_HEADER_SIZE) / FLV_INDEX_ENTRY_SIZE)
+    goto invalid;
+
+  if (gst_pad_query_peer_duration (demux->sinkpad, &fmt, &file_size) &&
+      fmt == GST_FORMAT_BYTES && file_size != GST_READ_UINT64_BE (data + 8))
+    goto wrong_file;
+
+  complete = (data[5] & FLV_INDEX_FLAG_COMPLETE) != 0;
+  data += FLV_INDEX_HEADER_SIZE;
+
+  for (i = 0; i < n; i++) {
+    gst_flv_demux_parse_and_add_index_entry (demux,
+        GST_READ_UINT64_BE (data), GST_READ_UINT64_BE (data + 8), TRUE);
+    data += FLV_INDEX_ENTRY_SIZE;
+  }
+
+  if (complete)
+    gst_flv_demux_mark_indexed (demux);
+
+  GST_DEBUG_OBJECT (demux, "imported index with %u entries, complete %d",
+      n, complete);
+  return;
+
+  /* ERRORS */
+invalid:
+  {
+    GST_WARNING_OBJECT (demux, "invalid index data, not importing");
+    return;
+  }
+wrong_file:
+  {
+    GST_WARNING_OBJECT (demux, "index is for a file of %" G_GUINT64_FORMAT
+        " bytes, not %" G_GINT64_FORMAT ", not importing",
+        GST_READ_UINT64_BE (data + 8), file_size);
+    return;
+  }
 }
 
 static gchar *
@@ -606,7 +805,7 @@ gst_flv_demux_parse_tag_script (GstFlvDemux * demux, GstBuffer * buffer)
 
     g_free (function_name);
 
-    if (demux->index && demux->times && demux->filepositions) {
+    if (demux->times && demux->filepositions) {
       guint num;
 
       /* If an index was found, insert associations */
@@ -619,7 +818,7 @@ gst_flv_demux_parse_tag_script (GstFlvDemux * demux, GstBuffer * buffer)
         gst_flv_demux_parse_and_add_index_entry (demux, time, fileposition,
             TRUE);
       }
-      demux->indexed = TRUE;
+      gst_flv_demux_mark_indexed (demux);
     }
   }
 
@@ -986,7 +1185,7 @@ gst_flv_demux_parse_tag_audio (GstFlvDemux * demux, GstBuffer * buffer)
 
   /* Only add audio frames to the index if we have no video,
    * and if the index is not yet complete */
-  if (!demux->has_video && demux->index && !demux->indexed) {
+  if (!demux->has_video && !demux->indexed) {
     gst_flv_demux_parse_and_add_index_entry (demux,
         GST_BUFFER_TIMESTAMP (outbuf), demux->cur_tag_offset, TRUE);
   }
@@ -1359,7 +1558,7 @@ gst_flv_demux_parse_tag_video (GstFlvDemux * demux, GstBuffer * buffer)
   if (!keyframe)
     GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
 
-  if (!demux->indexed && demux->index) {
+  if (!demux->indexed) {
     gst_flv_demux_parse_and_add_index_entry (demux,
         GST_BUFFER_TIMESTAMP (outbuf), demux->cur_tag_offset, keyframe);
   }
@@ -1508,7 +1707,7 @@ gst_flv_demux_parse_tag_timestamp (GstFlvDemux * demux, gboolean index,
   ret = pts * GST_MSECOND;
   GST_LOG_OBJECT (demux, "pts: %" GST_TIME_FORMAT, GST_TIME_ARGS (ret));
 
-  if (index && demux->index && !demux->indexed && (type == 9 || (type == 8
+  if (index && !demux->indexed && (type == 9 || (type == 8
               && !demux->has_video))) {
     gst_flv_demux_parse_and_add_index_entry (demux, ret, demux->offset,
         keyframe);
@@ -1599,6 +1798,10 @@ gst_flv_demux_parse_header (GstFlvDemux * demux, GstBuffer * buffer)
   /* do a one-time seekability check */
   gst_flv_demux_check_seekability (demux);
 
+  /* now that we know about the file, pick up an index from a previous run */
+  if (demux->import_index)
+    gst_flv_demux_import_index (demux, demux->import_index);
+
   /* We don't care about the rest */
   demux->need_header = FALSE;
 
@@ -1652,11 +1855,13 @@ gst_flv_demux_cleanup (GstFlvDemux * demux)
   demux->got_par = FALSE;
 
   demux->indexed = FALSE;
+  demux->scan_ret = GST_FLOW_OK;
   demux->upstream_seekable = FALSE;
   demux->file_size = 0;
 
   demux->index_max_pos = 0;
   demux->index_max_time = 0;
+  g_array_set_size (demux->kf_index, 0);
 
   demux->audio_start = demux->video_start = GST_CLOCK_TIME_NONE;
   demux->last_audio_pts = demux->last_video_pts = 0;
@@ -2139,7 +2344,8 @@ static GstFlowReturn
 gst_flv_demux_seek_to_prev_keyframe (GstFlvDemux * demux)
 {
   GstFlowReturn ret = GST_FLOW_UNEXPECTED;
-  GstIndexEntry *entry = NULL;
+  GstClockTime time;
+  guint64 bytes;
 
   GST_DEBUG_OBJECT (demux,
       "terminated section started at offset %" G_GINT64_FORMAT,
@@ -2158,19 +2364,10 @@ gst_flv_demux_seek_to_prev_keyframe (GstFlvDemux * demux)
   GST_DEBUG_OBJECT (demux, "locating previous position");
 
   /* locate index entry before previous start position */
-  if (demux->index)
-    entry = gst_index_get_assoc_entry (demux->index, demux->index_id,
-        GST_INDEX_LOOKUP_BEFORE, GST_ASSOCIATION_FLAG_KEY_UNIT,
-        GST_FORMAT_BYTES, demux->from_offset - 1);
-
-  if (entry) {
-    gint64 bytes, time;
-
-    gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &bytes);
-    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-
+  if (gst_flv_demux_index_lookup (demux, TRUE, demux->from_offset - 1,
+          &time, &bytes)) {
     GST_DEBUG_OBJECT (demux, "found index entry for %" G_GINT64_FORMAT
-        " at %" GST_TIME_FORMAT ", seeking to %" G_GINT64_FORMAT,
+        " at %" GST_TIME_FORMAT ", seeking to %" G_GUINT64_FORMAT,
         demux->offset - 1, GST_TIME_ARGS (time), bytes);
 
     /* setup for next section */
@@ -2235,7 +2432,7 @@ gst_flv_demux_create_index (GstFlvDemux * demux, gint64 pos, GstClockTime ts)
 
   if (ret == GST_FLOW_UNEXPECTED) {
     /* file ran out, so mark we have complete index */
-    demux->indexed = TRUE;
+    gst_flv_demux_mark_indexed (demux);
     ret = GST_FLOW_OK;
   }
 
@@ -2307,6 +2504,131 @@ exit:
   return ret;
 }
 
+/* scan the tag headers from the end of the index onwards, skipping the
+ * tag payloads, and add the keyframes to the index */
+static gpointer
+gst_flv_demux_scan_thread (GstFlvDemux * demux)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buffer;
+  guint64 offset;
+  guint n_tags = 0;
+  gboolean has_video = demux->scan_has_video;
+
+  g_mutex_lock (demux->index_lock);
+  offset = demux->index_max_pos;
+  g_mutex_unlock (demux->index_lock);
+
+  GST_DEBUG_OBJECT (demux, "scanning for index from %" G_GUINT64_FORMAT,
+      offset);
+
+  while (!g_atomic_int_get (&demux->scan_stop)) {
+    guint8 *data;
+    guint32 tag_data_size, pts;
+    gboolean keyframe = TRUE;
+    guint8 type;
+
+    /* when flushing for a seek we stop here, the streaming thread continues
+     * the scan from the end of the index after the seek */
+    ret = gst_pad_pull_range (demux->sinkpad, offset, 12, &buffer);
+    if (ret != GST_FLOW_OK)
+      break;
+    if (GST_BUFFER_SIZE (buffer) < 12) {
+      gst_buffer_unref (buffer);
+      ret = GST_FLOW_UNEXPECTED;
+      break;
+    }
+
+    data = GST_BUFFER_DATA (buffer);
+    type = data[0];
+    tag_data_size = GST_READ_UINT24_BE (data + 1);
+    pts = GST_READ_UINT24_BE (data + 4) | (GST_READ_UINT8 (data + 7) << 24);
+    if (type == 9)
+      keyframe = ((data[11] >> 4) == 1);
+    gst_buffer_unref (buffer);
+
+    if (type != 9 && type != 8 && type != 18) {
+      GST_WARNING_OBJECT (demux, "Unsupported tag type %u at %"
+          G_GUINT64_FORMAT ", stopping scan", type, offset);
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+
+    if (type == 9)
+      has_video = TRUE;
+    if (type == 9 || (type == 8 && !has_video))
+      gst_flv_demux_parse_and_add_index_entry (demux, pts * GST_MSECOND,
+          offset, keyframe);
+
+    offset += tag_data_size + 11 + 4;
+    n_tags++;
+  }
+
+  /* the streaming thread picks this up, UNEXPECTED means the file ran out
+   * and the index is complete */
+  g_mutex_lock (demux->index_lock);
+  demux->scan_ret = ret;
+  g_mutex_unlock (demux->index_lock);
+
+  GST_DEBUG_OBJECT (demux, "scan stopped after %u tags: %s", n_tags,
+      gst_flow_get_name (ret));
+
+  return NULL;
+}
+
+static void
+gst_flv_demux_start_scan (GstFlvDemux * demux)
+{
+  GError *error = NULL;
+
+  if (demux->scan_thread)
+    return;
+
+  g_mutex_lock (demux->index_lock);
+  demux->scan_ret = GST_FLOW_OK;
+  g_mutex_unlock (demux->index_lock);
+
+  demux->scan_has_video = demux->has_video;
+  g_atomic_int_set (&demux->scan_stop, FALSE);
+  demux->scan_thread = g_thread_create ((GThreadFunc) gst_flv_demux_scan_thread,
+      demux, TRUE, &error);
+  if (!demux->scan_thread) {
+    GST_WARNING_OBJECT (demux, "could not start index scan: %s",
+        error->message);
+    g_error_free (error);
+  }
+}
+
+static void
+gst_flv_demux_stop_scan (GstFlvDemux * demux)
+{
+  if (!demux->scan_thread)
+    return;
+
+  g_atomic_int_set (&demux->scan_stop, TRUE);
+  g_thread_join (demux->scan_thread);
+  demux->scan_thread = NULL;
+}
+
+/* picks up the result of the index scan, returns GST_FLOW_OK while the scan
+ * is still running. Call from the streaming thread or with the stream lock */
+static GstFlowReturn
+gst_flv_demux_check_scan (GstFlvDemux * demux)
+{
+  GstFlowReturn ret;
+
+  if (!demux->scan_thread || demux->indexed)
+    return GST_FLOW_OK;
+
+  g_mutex_lock (demux->index_lock);
+  ret = demux->scan_ret;
+  if (ret == GST_FLOW_UNEXPECTED)
+    demux->indexed = TRUE;
+  g_mutex_unlock (demux->index_lock);
+
+  return ret;
+}
+
 static void
 gst_flv_demux_loop (GstPad * pad)
 {
@@ -2320,13 +2642,23 @@ gst_flv_demux_loop (GstPad * pad)
     case FLV_STATE_TAG_TYPE:
       if (demux->from_offset == -1)
         demux->from_offset = demux->offset;
+      /* a flushing seek stopped the index scan, continue it */
+      if (G_UNLIKELY (gst_flv_demux_check_scan (demux) ==
+              GST_FLOW_WRONG_STATE)) {
+        gst_flv_demux_stop_scan (demux);
+        gst_flv_demux_start_scan (demux);
+      }
       ret = gst_flv_demux_pull_tag (pad, demux);
       /* if we have seen real data, we probably passed a possible metadata
        * header located at start.  So if we do not yet have an index,
        * try to pick up metadata (index, duration) at the end */
       if (G_UNLIKELY (!demux->file_size && !demux->indexed &&
-              (demux->has_video || demux->has_audio)))
+              (demux->has_video || demux->has_audio))) {
         demux->file_size = gst_flv_demux_get_metadata (demux);
+        /* still no index, build it in the background when asked to */
+        if (demux->scan_index && !demux->indexed && demux->upstream_seekable)
+          gst_flv_demux_start_scan (demux);
+      }
       break;
     case FLV_STATE_DONE:
       ret = GST_FLOW_UNEXPECTED;
@@ -2433,40 +2765,29 @@ pause:
 static guint64
 gst_flv_demux_find_offset (GstFlvDemux * demux, GstSegment * segment)
 {
-  gint64 bytes = 0;
-  gint64 time = 0;
-  GstIndexEntry *entry;
+  guint64 bytes = 0;
+  GstClockTime time = 0;
 
   g_return_val_if_fail (segment != NULL, 0);
 
-  time = segment->last_stop;
-
-  if (demux->index) {
-    /* Let's check if we have an index entry for that seek time */
-    entry = gst_index_get_assoc_entry (demux->index, demux->index_id,
-        GST_INDEX_LOOKUP_BEFORE, GST_ASSOCIATION_FLAG_KEY_UNIT,
-        GST_FORMAT_TIME, time);
-
-    if (entry) {
-      gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &bytes);
-      gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
-
-      GST_DEBUG_OBJECT (demux, "found index entry for %" GST_TIME_FORMAT
-          " at %" GST_TIME_FORMAT ", seeking to %" G_GINT64_FORMAT,
-          GST_TIME_ARGS (segment->last_stop), GST_TIME_ARGS (time), bytes);
-
-      /* Key frame seeking */
-      if (segment->flags & GST_SEEK_FLAG_KEY_UNIT) {
-        /* Adjust the segment so that the keyframe fits in */
-        if (time < segment->start) {
-          segment->start = segment->time = time;
-        }
-        segment->last_stop = time;
+  /* Let's check if we have an index entry for that seek time */
+  if (gst_flv_demux_index_lookup (demux, FALSE, segment->last_stop, &time,
+          &bytes)) {
+    GST_DEBUG_OBJECT (demux, "found index entry for %" GST_TIME_FORMAT
+        " at %" GST_TIME_FORMAT ", seeking to %" G_GUINT64_FORMAT,
+        GST_TIME_ARGS (segment->last_stop), GST_TIME_ARGS (time), bytes);
+
+    /* Key frame seeking */
+    if (segment->flags & GST_SEEK_FLAG_KEY_UNIT) {
+      /* Adjust the segment so that the keyframe fits in */
+      if (time < segment->start) {
+        segment->start = segment->time = time;
       }
-    } else {
-      GST_DEBUG_OBJECT (demux, "no index entry found for %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (segment->start));
+      segment->last_stop = time;
     }
+  } else {
+    GST_DEBUG_OBJECT (demux, "no index entry found for %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (segment->start));
   }
 
   return bytes;
@@ -2691,6 +3012,7 @@ gst_flv_demux_handle_seek_pull (GstFlvDemux * demux, GstEvent * event,
   if (flush || seeksegment.last_stop != demux->segment.last_stop) {
     /* Do the actual seeking */
     /* index is reliable if it is complete or we do not go to far ahead */
+    gst_flv_demux_check_scan (demux);
     if (seeking && !demux->indexed &&
         seeksegment.last_stop > demux->index_max_time + 10 * GST_SECOND) {
       GST_DEBUG_OBJECT (demux, "delaying seek to post-scan; "
@@ -2857,6 +3179,7 @@ gst_flv_demux_sink_activate_pull (GstPad * sinkpad, gboolean active)
         sinkpad);
   } else {
     demux->random_access = FALSE;
+    gst_flv_demux_stop_scan (demux);
     gst_object_unref (demux);
     return gst_pad_stop_task (sinkpad);
   }
@@ -3035,7 +3358,7 @@ gst_flv_demux_query (GstPad * pad, GstQuery * query)
         }
       }
       res = TRUE;
-      if (fmt != GST_FORMAT_TIME || !demux->index) {
+      if (fmt != GST_FORMAT_TIME) {
         gst_query_set_seeking (query, fmt, FALSE, -1, -1);
       } else if (demux->random_access) {
         gst_query_set_seeking (query, GST_FORMAT_TIME, TRUE, 0,
@@ -3089,24 +3412,6 @@ gst_flv_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-      /* If this is our own index destroy it as the
-       * old entries might be wrong for the new stream */
-      if (demux->own_index) {
-        gst_object_unref (demux->index);
-        demux->index = NULL;
-        demux->own_index = FALSE;
-      }
-
-      /* If no index was created, generate one */
-      if (G_UNLIKELY (!demux->index)) {
-        GST_DEBUG_OBJECT (demux, "no index provided creating our own");
-
-        demux->index = gst_index_factory_make ("memindex");
-
-        gst_index_get_writer_id (demux->index, GST_OBJECT (demux),
-            &demux->index_id);
-        demux->own_index = TRUE;
-      }
       gst_flv_demux_cleanup (demux);
       break;
     default:
@@ -3138,7 +3443,6 @@ gst_flv_demux_set_index (GstElement * element, GstIndex * index)
     gst_object_unref (demux->index);
   if (index) {
     demux->index = gst_object_ref (index);
-    demux->own_index = FALSE;
   } else
     demux->index = NULL;
 
@@ -3218,6 +3522,21 @@ gst_flv_demux_dispose (GObject * object)
     demux->index = NULL;
   }
 
+  if (demux->kf_index) {
+    g_array_free (demux->kf_index, TRUE);
+    demux->kf_index = NULL;
+  }
+
+  if (demux->index_lock) {
+    g_mutex_free (demux->index_lock);
+    demux->index_lock = NULL;
+  }
+
+  if (demux->import_index) {
+    gst_buffer_unref (demux->import_index);
+    demux->import_index = NULL;
+  }
+
   if (demux->times) {
     g_array_free (demux->times, TRUE);
     demux->times = NULL;
@@ -3231,6 +3550,46 @@ gst_flv_demux_dispose (GObject * object)
   GST_CALL_PARENT (G_OBJECT_CLASS, dispose, (object));
 }
 
+static void
+gst_flv_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstFlvDemux *demux = GST_FLV_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_SCAN_INDEX:
+      demux->scan_index = g_value_get_boolean (value);
+      break;
+    case PROP_KEYFRAME_INDEX:
+      if (demux->import_index)
+        gst_buffer_unref (demux->import_index);
+      demux->import_index = GST_BUFFER_CAST (gst_value_dup_mini_object (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_flv_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstFlvDemux *demux = GST_FLV_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_SCAN_INDEX:
+      g_value_set_boolean (value, demux->scan_index);
+      break;
+    case PROP_KEYFRAME_INDEX:
+      gst_value_take_buffer (value, gst_flv_demux_export_index (demux));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_flv_demux_base_init (gpointer g_class)
 {
@@ -3255,6 +3614,37 @@ gst_flv_demux_class_init (GstFlvDemuxClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->dispose = gst_flv_demux_dispose;
+  gobject_class->set_property = gst_flv_demux_set_property;
+  gobject_class->get_property = gst_flv_demux_get_property;
+
+  /**
+   * GstFlvDemux:scan-index
+   *
+   * When the file has no keyframe index in its metadata, build one in a
+   * background thread by reading only the tag headers. This makes seeking
+   * in long files fast once the scan is done. Only used in pull mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_SCAN_INDEX,
+      g_param_spec_boolean ("scan-index", "Scan index",
+          "Build the keyframe index in the background when the file has none",
+          DEFAULT_SCAN_INDEX, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFlvDemux:keyframe-index
+   *
+   * A serialized copy of the keyframe index built so far. Applications can
+   * store it and set it again when opening the same file later, to get
+   * fast seeking without scanning the file again. The index is only used
+   * if the file size matches.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_INDEX,
+      gst_param_spec_mini_object ("keyframe-index", "Keyframe index",
+          "Serialized keyframe index, to export and import the index",
+          GST_TYPE_BUFFER, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_flv_demux_change_state);
@@ -3285,7 +3675,9 @@ gst_flv_demux_init (GstFlvDemux * demux, GstFlvDemuxClass * g_class)
   demux->taglist = gst_tag_list_new ();
   gst_segment_init (&demux->segment, GST_FORMAT_TIME);
 
-  demux->own_index = FALSE;
+  demux->kf_index = g_array_new (FALSE, FALSE, sizeof (GstFlvDemuxIndexEntry));
+  demux->index_lock = g_mutex_new ();
+  demux->scan_index = DEFAULT_SCAN_INDEX;
 
   gst_flv_demux_cleanup (demux);
 }
@@ -49,6 +49,13 @@ typedef enum
   FLV_STATE_NONE
 } GstFlvDemuxState;
 
+/* entry of the keyframe index */
+typedef struct
+{
+  GstClockTime time;
+  guint64 pos;
+} GstFlvDemuxIndexEntry;
+
 struct _GstFlvDemux
 {
   GstElement element;
@@ -60,10 +67,25 @@ struct _GstFlvDemux
 
   /* <private> */
   
+  /* application provided index, kept up to date with the keyframes */
   GstIndex *index;
   gint index_id;
-  gboolean own_index;
-  
+
+  /* keyframe index, GstFlvDemuxIndexEntry sorted on position.
+   * protected by index_lock, also used by the scan thread */
+  GArray *kf_index;
+  GMutex *index_lock;
+  /* index to import when starting, see the keyframe-index property */
+  GstBuffer *import_index;
+
+  /* background scanning of the tag headers to build the index */
+  gboolean scan_index;
+  GThread *scan_thread;
+  volatile gint scan_stop;
+  gboolean scan_has_video;
+  /* result of the scan once it stopped, protected by index_lock */
+  GstFlowReturn scan_ret;
+
   GArray * times;
   GArray * filepositions;
 
@@ -127,7 +149,7 @@ struct _GstFlvDemux
 
   gboolean seeking;
   gboolean building_index;
-  gboolean indexed; /* TRUE if index is completely built */
+  gboolean indexed; /* TRUE if index is completely built, set with index_lock */
   gboolean upstream_seekable; /* TRUE if upstream is seekable */
   gint64 file_size;
   GstEvent *seek_event;
@@ -132,6 +132,68 @@ deinterleave_24 (guint8 * out, guint8 * in, guint stride, guint nframes)
   }
 }
 
+/* Deinterleave all channels at once for the most common channel counts.
+ * With the number of channels known at compile time the inner loop is
+ * unrolled and every input frame is read only once instead of walking
+ * over the input buffer once per channel */
+#define MAKE_TRANSPOSE_FUNC(type, channels) \
+static void deinterleave_##type##_##channels (guint##type **out, \
+    guint##type *in, guint nframes) \
+{ \
+  gint i, c; \
+  \
+  for (i = 0; i < nframes; i++) { \
+    for (c = 0; c < channels; c++) \
+      out[c][i] = in[c]; \
+    in += channels; \
+  } \
+}
+
+#define MAKE_TRANSPOSE_FUNCS(type) \
+MAKE_TRANSPOSE_FUNC (type, 2); \
+MAKE_TRANSPOSE_FUNC (type, 4); \
+MAKE_TRANSPOSE_FUNC (type, 6); \
+MAKE_TRANSPOSE_FUNC (type, 8); \
+MAKE_TRANSPOSE_FUNC (type, 16); \
+MAKE_TRANSPOSE_FUNC (type, 32); \
+MAKE_TRANSPOSE_FUNC (type, 64)
+
+MAKE_TRANSPOSE_FUNCS (8);
+MAKE_TRANSPOSE_FUNCS (16);
+MAKE_TRANSPOSE_FUNCS (32);
+MAKE_TRANSPOSE_FUNCS (64);
+
+#define SELECT_TRANSPOSE_FUNC(type, channels) \
+  switch (channels) { \
+    case 2: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_2; \
+    case 4: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_4; \
+    case 6: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_6; \
+    case 8: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_8; \
+    case 16: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_16; \
+    case 32: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_32; \
+    case 64: return (GstDeinterleaveTransposeFunc) deinterleave_##type##_64; \
+    default: return NULL; \
+  }
+
+/* Returns the function that deinterleaves all @channels at once or NULL if
+ * there is none for this width and number of channels */
+static GstDeinterleaveTransposeFunc
+gst_deinterleave_get_transpose_function (gint width, gint channels)
+{
+  switch (width) {
+    case 8:
+      SELECT_TRANSPOSE_FUNC (8, channels);
+    case 16:
+      SELECT_TRANSPOSE_FUNC (16, channels);
+    case 32:
+      SELECT_TRANSPOSE_FUNC (32, channels);
+    case 64:
+      SELECT_TRANSPOSE_FUNC (64, channels);
+    default:
+      return NULL;
+  }
+}
+
 GST_BOILERPLATE (GstDeinterleave, gst_deinterleave, GstElement,
     GST_TYPE_ELEMENT);
 
@@ -231,6 +293,7 @@ gst_deinterleave_init (GstDeinterleave * self, GstDeinterleaveClass * klass)
   self->keep_positions = FALSE;
   self->width = 0;
   self->func = NULL;
+  self->transpose = NULL;
 
   /* Add sink pad */
   self->sink = gst_pad_new_from_static_template (&sink_template, "sink");
@@ -377,6 +440,10 @@ gst_deinterleave_set_process_function (GstDeinterleave * self, GstCaps * caps)
     default:
       return FALSE;
   }
+
+  self->transpose =
+      gst_deinterleave_get_transpose_function (self->width, self->channels);
+
   return TRUE;
 }
 
@@ -705,6 +772,8 @@ gst_deinterleave_process (GstDeinterleave * self, GstBuffer * buf)
 
   guint pads_pushed = 0, buffers_allocated = 0;
 
+  gboolean transposed = FALSE;
+
   guint nframes = GST_BUFFER_SIZE (buf) / channels / (self->width / 8);
 
   guint bufsize = nframes * (self->width / 8);
@@ -739,6 +808,19 @@ gst_deinterleave_process (GstDeinterleave * self, GstBuffer * buf)
   }
   GST_OBJECT_UNLOCK (self);
 
+  /* With a single channel the input is already what the only src pad
+   * outputs, so push it downstream without copying */
+  if (channels == 1 && self->srcpads) {
+    GstPad *pad = (GstPad *) self->srcpads->data;
+
+    g_free (buffers_out);
+
+    buf = gst_buffer_make_metadata_writable (buf);
+    gst_buffer_set_caps (buf, GST_PAD_CAPS (pad));
+
+    return gst_pad_push (pad, buf);
+  }
+
   /* Allocate buffers */
   for (srcs = self->srcpads, i = 0; srcs; srcs = srcs->next, i++) {
     GstPad *pad = (GstPad *) srcs->data;
@@ -774,6 +856,17 @@ gst_deinterleave_process (GstDeinterleave * self, GstBuffer * buf)
     goto done;
   }
 
+  /* If all pads are linked, deinterleave all channels in one go */
+  if (self->transpose && buffers_allocated == channels) {
+    gpointer *outdata = g_newa (gpointer, channels);
+
+    for (i = 0; i < channels; i++)
+      outdata[i] = GST_BUFFER_DATA (buffers_out[i]);
+
+    self->transpose (outdata, GST_BUFFER_DATA (buf), nframes);
+    transposed = TRUE;
+  }
+
   /* deinterleave */
   for (srcs = self->srcpads, i = 0; srcs; srcs = srcs->next, i++) {
     GstPad *pad = (GstPad *) srcs->data;
@@ -783,7 +876,8 @@ gst_deinterleave_process (GstDeinterleave * self, GstBuffer * buf)
     if (buffers_out[i]) {
       out = (guint8 *) GST_BUFFER_DATA (buffers_out[i]);
 
-      self->func (out, in, channels, nframes);
+      if (!transposed)
+        self->func (out, in, channels, nframes);
 
       ret = gst_pad_push (pad, buffers_out[i]);
       buffers_out[i] = NULL;
@@ -874,6 +968,7 @@ gst_deinterleave_sink_activate_push (GstPad * pad, gboolean active)
     self->channels = 0;
     self->width = 0;
     self->func = NULL;
+    self->transpose = NULL;
 
     if (self->pending_events) {
       g_list_foreach (self->pending_events, (GFunc) gst_mini_object_unref,
@@ -43,6 +43,7 @@ typedef struct _GstDeinterleave GstDeinterleave;
 typedef struct _GstDeinterleaveClass GstDeinterleaveClass;
 
 typedef void (*GstDeinterleaveFunc) (gpointer out, gpointer in, guint stride, guint nframes);
+typedef void (*GstDeinterleaveTransposeFunc) (gpointer *out, gpointer in, guint nframes);
 
 struct _GstDeinterleave
 {
@@ -59,6 +60,7 @@ struct _GstDeinterleave
 
   gint width;
   GstDeinterleaveFunc func;
+  GstDeinterleaveTransposeFunc transpose;
 
   GList *pending_events;
 };
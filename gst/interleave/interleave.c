@@ -133,6 +133,68 @@ interleave_24 (guint8 * out, guint8 * in, guint stride, guint nframes)
   }
 }
 
+/* Interleave all channels at once for the most common channel counts.
+ * With the number of channels known at compile time the inner loop is
+ * unrolled and every output frame is written in one go instead of
+ * walking over the output buffer once per channel */
+#define MAKE_TRANSPOSE_FUNC(type, channels) \
+static void interleave_##type##_##channels (guint##type *out, \
+    guint##type **in, guint nframes) \
+{ \
+  gint i, c; \
+  \
+  for (i = 0; i < nframes; i++) { \
+    for (c = 0; c < channels; c++) \
+      out[c] = in[c][i]; \
+    out += channels; \
+  } \
+}
+
+#define MAKE_TRANSPOSE_FUNCS(type) \
+MAKE_TRANSPOSE_FUNC (type, 2); \
+MAKE_TRANSPOSE_FUNC (type, 4); \
+MAKE_TRANSPOSE_FUNC (type, 6); \
+MAKE_TRANSPOSE_FUNC (type, 8); \
+MAKE_TRANSPOSE_FUNC (type, 16); \
+MAKE_TRANSPOSE_FUNC (type, 32); \
+MAKE_TRANSPOSE_FUNC (type, 64)
+
+MAKE_TRANSPOSE_FUNCS (8);
+MAKE_TRANSPOSE_FUNCS (16);
+MAKE_TRANSPOSE_FUNCS (32);
+MAKE_TRANSPOSE_FUNCS (64);
+
+#define SELECT_TRANSPOSE_FUNC(type, channels) \
+  switch (channels) { \
+    case 2: return (GstInterleaveTransposeFunc) interleave_##type##_2; \
+    case 4: return (GstInterleaveTransposeFunc) interleave_##type##_4; \
+    case 6: return (GstInterleaveTransposeFunc) interleave_##type##_6; \
+    case 8: return (GstInterleaveTransposeFunc) interleave_##type##_8; \
+    case 16: return (GstInterleaveTransposeFunc) interleave_##type##_16; \
+    case 32: return (GstInterleaveTransposeFunc) interleave_##type##_32; \
+    case 64: return (GstInterleaveTransposeFunc) interleave_##type##_64; \
+    default: return NULL; \
+  }
+
+/* Returns the function that interleaves all @channels at once or NULL if
+ * there is none for this width and number of channels */
+static GstInterleaveTransposeFunc
+gst_interleave_get_transpose_function (gint width, gint channels)
+{
+  switch (width) {
+    case 8:
+      SELECT_TRANSPOSE_FUNC (8, channels);
+    case 16:
+      SELECT_TRANSPOSE_FUNC (16, channels);
+    case 32:
+      SELECT_TRANSPOSE_FUNC (32, channels);
+    case 64:
+      SELECT_TRANSPOSE_FUNC (64, channels);
+    default:
+      return NULL;
+  }
+}
+
 typedef struct
 {
   GstPad parent;
@@ -1199,9 +1261,12 @@ gst_interleave_collected (GstCollectPads2 * pads, GstInterleave * self)
   GstFlowReturn ret = GST_FLOW_OK;
   GSList *collected;
   guint nsamples;
-  guint ncollected = 0;
+  guint ncollected = 0, nfilled = 0;
   gboolean empty = TRUE;
   gint width = self->width / 8;
+  GstBuffer **inbufs;
+  GstInterleaveTransposeFunc transpose;
+  gint i;
 
   g_return_val_if_fail (self->func != NULL, GST_FLOW_NOT_NEGOTIATED);
   g_return_val_if_fail (self->width > 0, GST_FLOW_NOT_NEGOTIATED);
@@ -1232,36 +1297,63 @@ gst_interleave_collected (GstCollectPads2 * pads, GstInterleave * self)
     return GST_FLOW_NOT_NEGOTIATED;
   }
 
-  memset (GST_BUFFER_DATA (outbuf), 0, size * self->channels);
+  /* Collect the buffers of all channels first so that they can be
+   * interleaved in one go if all of them contain data */
+  inbufs = g_new0 (GstBuffer *, self->channels);
 
   for (collected = pads->data; collected != NULL; collected = collected->next) {
     GstCollectData2 *cdata;
     GstBuffer *inbuf;
-    guint8 *outdata;
+    guint channel;
 
     cdata = (GstCollectData2 *) collected->data;
 
     inbuf = gst_collect_pads2_take_buffer (pads, cdata, size);
     if (inbuf == NULL) {
       GST_DEBUG_OBJECT (cdata->pad, "No buffer available");
-      goto next;
+      continue;
     }
     ncollected++;
 
-    if (GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_GAP))
-      goto next;
+    channel = GST_INTERLEAVE_PAD_CAST (cdata->pad)->channel;
+    if (GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_GAP) ||
+        channel >= self->channels || inbufs[channel] != NULL) {
+      gst_buffer_unref (inbuf);
+      continue;
+    }
+
+    inbufs[channel] = inbuf;
+    nfilled++;
+  }
 
-    empty = FALSE;
-    outdata =
-        GST_BUFFER_DATA (outbuf) +
-        width * GST_INTERLEAVE_PAD_CAST (cdata->pad)->channel;
+  transpose = gst_interleave_get_transpose_function (self->width,
+      self->channels);
 
-    self->func (outdata, GST_BUFFER_DATA (inbuf), self->channels, nsamples);
+  if (transpose && nfilled == self->channels) {
+    gpointer *indata = g_newa (gpointer, self->channels);
 
-  next:
-    if (inbuf)
-      gst_buffer_unref (inbuf);
+    for (i = 0; i < self->channels; i++)
+      indata[i] = GST_BUFFER_DATA (inbufs[i]);
+
+    transpose (GST_BUFFER_DATA (outbuf), indata, nsamples);
+  } else {
+    memset (GST_BUFFER_DATA (outbuf), 0, size * self->channels);
+
+    for (i = 0; i < self->channels; i++) {
+      if (inbufs[i] == NULL)
+        continue;
+
+      self->func (GST_BUFFER_DATA (outbuf) + width * i,
+          GST_BUFFER_DATA (inbufs[i]), self->channels, nsamples);
+    }
+  }
+  empty = (nfilled == 0);
+
+  for (i = 0; i < self->channels; i++) {
+    if (inbufs[i])
+      gst_buffer_unref (inbufs[i]);
   }
+  g_free (inbufs);
 
   if (ncollected == 0)
     goto eos;
@@ -43,6 +43,7 @@ typedef struct _GstInterleave GstInterleave;
 typedef struct _GstInterleaveClass GstInterleaveClass;
 
 typedef void (*GstInterleaveFunc) (gpointer out, gpointer in, guint stride, guint nframes);
+typedef void (*GstInterleaveTransposeFunc) (gpointer out, gpointer *in, guint nframes);
 
 struct _GstInterleave
 {
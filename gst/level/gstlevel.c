@@ -91,8 +91,37 @@
  *   the Root Mean Square (or average power) level in dB for each channel
  *   </para>
  * </listitem>
+ * <listitem>
+ *   <para>
+ *   #GstValueList of #gdouble
+ *   <classname>&quot;true-peak&quot;</classname>:
+ *   the peak power level in dB of the 4 times oversampled signal for each
+ *   channel, as defined by ITU-R BS.1770. Only present if the
+ *   #GstLevel:true-peak property is %TRUE.
+ *   </para>
+ * </listitem>
+ * <listitem>
+ *   <para>
+ *   #gdouble
+ *   <classname>&quot;momentary-loudness&quot;</classname>:
+ *   the loudness of the last 400ms in LUFS as defined by EBU R128. Only
+ *   present if the #GstLevel:loudness property is %TRUE.
+ *   </para>
+ * </listitem>
+ * <listitem>
+ *   <para>
+ *   #gdouble
+ *   <classname>&quot;short-term-loudness&quot;</classname>:
+ *   the loudness of the last 3 seconds in LUFS as defined by EBU R128. Only
+ *   present if the #GstLevel:loudness property is %TRUE.
+ *   </para>
+ * </listitem>
  * </itemizedlist>
  *
+ * If the #GstLevel:compact-messages property is %TRUE, the per channel fields
+ * are a #GstBuffer with one native endian #gdouble per channel instead of a
+ * #GstValueList. This is a lot cheaper for many channels or short intervals.
+ *
  * <refsect2>
  * <title>Example application</title>
  * |[
@@ -108,6 +137,7 @@
 #include <math.h>
 #include <gst/gst.h>
 #include <gst/audio/audio.h>
+#include <gst/audio/multichannel.h>
 
 #include "gstlevel.h"
 
@@ -116,6 +146,30 @@ GST_DEBUG_CATEGORY_STATIC (level_debug);
 
 #define EPSILON 1e-35f
 
+#define DEFAULT_TRUE_PEAK FALSE
+#define DEFAULT_LOUDNESS FALSE
+#define DEFAULT_COMPACT_MESSAGES FALSE
+
+/* frames converted to doubles at once for true peak and loudness */
+#define BLOCK_FRAMES 256
+
+/* 4 times oversampling polyphase FIR filter from ITU-R BS.1770-3 */
+#define TRUE_PEAK_TAPS 12
+static const gdouble true_peak_coeffs[4][TRUE_PEAK_TAPS] = {
+  {0.0017089843750, 0.0109863281250, -0.0196533203125, 0.0332031250000,
+      -0.0594482421875, 0.1373291015625, 0.9721679687500, -0.1022949218750,
+      0.0476074218750, -0.0266113281250, 0.0148925781250, -0.0083007812500},
+  {-0.0291748046875, 0.0292968750000, -0.0517578125000, 0.0891113281250,
+      -0.1665039062500, 0.4650878906250, 0.7797851562500, -0.2003173828125,
+      0.1015625000000, -0.0582275390625, 0.0330810546875, -0.0189208984375},
+  {-0.0189208984375, 0.0330810546875, -0.0582275390625, 0.1015625000000,
+      -0.2003173828125, 0.7797851562500, 0.4650878906250, -0.1665039062500,
+      0.0891113281250, -0.0517578125000, 0.0292968750000, -0.0291748046875},
+  {-0.0083007812500, 0.0148925781250, -0.0266113281250, 0.0476074218750,
+      -0.1022949218750, 0.9721679687500, 0.1373291015625, -0.0594482421875,
+      0.0332031250000, -0.0196533203125, 0.0109863281250, 0.0017089843750}
+};
+
 static GstStaticPadTemplate sink_template_factory =
     GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -156,7 +210,10 @@ enum
   PROP_SIGNAL_LEVEL,
   PROP_SIGNAL_INTERVAL,
   PROP_PEAK_TTL,
-  PROP_PEAK_FALLOFF
+  PROP_PEAK_FALLOFF,
+  PROP_TRUE_PEAK,
+  PROP_LOUDNESS,
+  PROP_COMPACT_MESSAGES
 };
 
 GST_BOILERPLATE (GstLevel, gst_level, GstBaseTransform,
@@ -218,6 +275,42 @@ gst_level_class_init (GstLevelClass * klass)
       g_param_spec_double ("peak-falloff", "Peak Falloff",
           "Decay rate of decay peak after TTL (in dB/sec)",
           0.0, G_MAXDOUBLE, 10.0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstLevel:true-peak
+   *
+   * Measure the true peak level of the 4 times oversampled signal as
+   * defined by ITU-R BS.1770.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_TRUE_PEAK,
+      g_param_spec_boolean ("true-peak", "True peak",
+          "Add the true peak level to the messages", DEFAULT_TRUE_PEAK,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstLevel:loudness
+   *
+   * Measure the momentary and short-term loudness as defined by EBU R128.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_LOUDNESS,
+      g_param_spec_boolean ("loudness", "Loudness",
+          "Add the momentary and short-term loudness to the messages",
+          DEFAULT_LOUDNESS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstLevel:compact-messages
+   *
+   * Put the per channel values into the messages as a #GstBuffer of
+   * #gdouble values instead of as lists of values.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_COMPACT_MESSAGES,
+      g_param_spec_boolean ("compact-messages", "Compact messages",
+          "Send the per channel values as buffers of doubles instead of lists",
+          DEFAULT_COMPACT_MESSAGES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   GST_DEBUG_CATEGORY_INIT (level_debug, "level", 0, "Level calculation");
 
@@ -242,30 +335,56 @@ gst_level_init (GstLevel * filter, GstLevelClass * g_class)
   filter->decay_peak_falloff = 10.0;    /* dB falloff (/sec) */
 
   filter->message = TRUE;
+  filter->true_peak = DEFAULT_TRUE_PEAK;
+  filter->loudness = DEFAULT_LOUDNESS;
+  filter->compact_messages = DEFAULT_COMPACT_MESSAGES;
 
   filter->process = NULL;
+  filter->convert = NULL;
 
   gst_base_transform_set_gap_aware (GST_BASE_TRANSFORM (filter), TRUE);
 }
 
 static void
-gst_level_finalize (GObject * obj)
+gst_level_free_channel_data (GstLevel * filter)
 {
-  GstLevel *filter = GST_LEVEL (obj);
-
   g_free (filter->CS);
+  g_free (filter->MS);
   g_free (filter->peak);
   g_free (filter->last_peak);
   g_free (filter->decay_peak);
   g_free (filter->decay_peak_base);
   g_free (filter->decay_peak_age);
+  g_free (filter->last_true_peak);
+  g_free (filter->tp_history);
+  g_free (filter->kw_state);
+  g_free (filter->kw_weight);
+  g_free (filter->message_values);
+  g_free (filter->block);
+  g_free (filter->tp_buf);
 
   filter->CS = NULL;
+  filter->MS = NULL;
   filter->peak = NULL;
   filter->last_peak = NULL;
   filter->decay_peak = NULL;
   filter->decay_peak_base = NULL;
   filter->decay_peak_age = NULL;
+  filter->last_true_peak = NULL;
+  filter->tp_history = NULL;
+  filter->kw_state = NULL;
+  filter->kw_weight = NULL;
+  filter->message_values = NULL;
+  filter->block = NULL;
+  filter->tp_buf = NULL;
+}
+
+static void
+gst_level_finalize (GObject * obj)
+{
+  GstLevel *filter = GST_LEVEL (obj);
+
+  gst_level_free_channel_data (filter);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -294,6 +413,15 @@ gst_level_set_property (GObject * object, guint prop_id,
     case PROP_PEAK_FALLOFF:
       filter->decay_peak_falloff = g_value_get_double (value);
       break;
+    case PROP_TRUE_PEAK:
+      filter->true_peak = g_value_get_boolean (value);
+      break;
+    case PROP_LOUDNESS:
+      filter->loudness = g_value_get_boolean (value);
+      break;
+    case PROP_COMPACT_MESSAGES:
+      filter->compact_messages = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -319,6 +447,15 @@ gst_level_get_property (GObject * object, guint prop_id,
     case PROP_PEAK_FALLOFF:
       g_value_set_double (value, filter->decay_peak_falloff);
       break;
+    case PROP_TRUE_PEAK:
+      g_value_set_boolean (value, filter->true_peak);
+      break;
+    case PROP_LOUDNESS:
+      g_value_set_boolean (value, filter->loudness);
+      break;
+    case PROP_COMPACT_MESSAGES:
+      g_value_set_boolean (value, filter->compact_messages);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -326,93 +463,124 @@ gst_level_get_property (GObject * object, guint prop_id,
 }
 
 
-/* process one (interleaved) channel of incoming samples
- * calculate square sum of samples
+/* process a block of interleaved samples
+ * calculate square sum of samples for each channel
  * normalize and average over number of samples
- * returns a normalized cumulative square value, which can be averaged
+ * returns normalized cumulative square values, which can be averaged
  * to return the average power as a double between 0 and 1
  * also returns the normalized peak power (square of the highest amplitude)
  *
- * caller must assure num is a multiple of channels
- * samples for multiple channels are interleaved
- * input sample data enters in *in_data as 8 or 16 bit data
+ * input sample data enters in *in_data as 8, 16 or 32 bit integer or as
+ * float data, num is the number of frames
  * this filter only accepts signed audio data, so mid level is always 0
  *
  * for 16 bit, this code considers the non-existant 32768 value to be
  * full-scale; so 32767 will not map to 1.0
+ *
+ * There are variants for the common channel counts that walk through the
+ * block once and keep the values of all channels in registers, which lets
+ * the compiler vectorize the loop over the channels. All other channel
+ * counts walk through the block once per channel.
  */
 
-#define DEFINE_INT_LEVEL_CALCULATOR(TYPE, RESOLUTION)                         \
-static void inline                                                            \
-gst_level_calculate_##TYPE (gpointer data, guint num, guint channels,         \
-                            gdouble *NCS, gdouble *NPS)                       \
+#define DEFINE_LEVEL_CALCULATOR(TYPE, ACC_TYPE, NORMALIZER, CHANNELS)         \
+static void                                                                   \
+gst_level_calculate_##TYPE##_##CHANNELS (gpointer data, guint num,            \
+    guint channels, gdouble *NCS, gdouble *NPS)                               \
 {                                                                             \
   TYPE * in = (TYPE *)data;                                                   \
-  register guint j;                                                           \
-  gdouble squaresum = 0.0;           /* square sum of the integer samples */  \
-  register gdouble square = 0.0;     /* Square */                             \
-  register gdouble peaksquare = 0.0; /* Peak Square Sample */                 \
-  gdouble normalizer;               /* divisor to get a [-1.0, 1.0] range */  \
-                                                                              \
-  /* *NCS = 0.0; Normalized Cumulative Square */                              \
-  /* *NPS = 0.0; Normalized Peask Square */                                   \
+  guint j, c;                                                                 \
+  ACC_TYPE squaresum[CHANNELS];    /* square sum of the samples */            \
+  ACC_TYPE peaksquare[CHANNELS];   /* Peak Square Sample */                   \
+  gdouble normalizer = NORMALIZER; /* divisor to get a [-1.0, 1.0] range */   \
                                                                               \
-  normalizer = (gdouble) (G_GINT64_CONSTANT(1) << (RESOLUTION * 2));          \
+  for (c = 0; c < CHANNELS; c++)                                              \
+    squaresum[c] = peaksquare[c] = 0;                                         \
                                                                               \
-  /* oil_squaresum_shifted_s16(&squaresum,in,num); */                         \
-  for (j = 0; j < num; j += channels)                                         \
-  {                                                                           \
-    square = ((gdouble) in[j]) * in[j];                                       \
-    if (square > peaksquare) peaksquare = square;                             \
-    squaresum += square;                                                      \
+  for (j = 0; j < num; j++) {                                                 \
+    for (c = 0; c < CHANNELS; c++) {                                          \
+      ACC_TYPE square = ((ACC_TYPE) in[c]) * in[c];                           \
+      peaksquare[c] = (square > peaksquare[c]) ? square : peaksquare[c];      \
+      squaresum[c] += square;                                                 \
+    }                                                                         \
+    in += CHANNELS;                                                           \
   }                                                                           \
                                                                               \
-  *NCS = squaresum / normalizer;                                              \
-  *NPS = peaksquare / normalizer;                                             \
+  for (c = 0; c < CHANNELS; c++) {                                            \
+    NCS[c] = squaresum[c] / normalizer;                                       \
+    NPS[c] = peaksquare[c] / normalizer;                                      \
+  }                                                                           \
 }
 
-DEFINE_INT_LEVEL_CALCULATOR (gint32, 31);
-DEFINE_INT_LEVEL_CALCULATOR (gint16, 15);
-DEFINE_INT_LEVEL_CALCULATOR (gint8, 7);
-
-#define DEFINE_FLOAT_LEVEL_CALCULATOR(TYPE)                                   \
-static void inline                                                            \
+#define DEFINE_LEVEL_CALCULATOR_ANY(TYPE, NORMALIZER)                         \
+static void                                                                   \
 gst_level_calculate_##TYPE (gpointer data, guint num, guint channels,         \
                             gdouble *NCS, gdouble *NPS)                       \
 {                                                                             \
-  TYPE * in = (TYPE *)data;                                                   \
-  register guint j;                                                           \
-  gdouble squaresum = 0.0;           /* square sum of the integer samples */  \
-  register gdouble square = 0.0;     /* Square */                             \
-  register gdouble peaksquare = 0.0; /* Peak Square Sample */                 \
-                                                                              \
-  /* *NCS = 0.0; Normalized Cumulative Square */                              \
-  /* *NPS = 0.0; Normalized Peask Square */                                   \
+  TYPE * in;                                                                  \
+  guint j, c, num_samples = num * channels;                                   \
+  gdouble squaresum;                                                          \
+  gdouble square;                                                             \
+  gdouble peaksquare;                                                         \
+  gdouble normalizer = NORMALIZER;                                            \
                                                                               \
-  /* oil_squaresum_f64(&squaresum,in,num); */                                 \
-  for (j = 0; j < num; j += channels)                                         \
-  {                                                                           \
-    square = ((gdouble) in[j]) * in[j];                                       \
-    if (square > peaksquare) peaksquare = square;                             \
-    squaresum += square;                                                      \
+  for (c = 0; c < channels; c++) {                                            \
+    in = ((TYPE *) data) + c;                                                 \
+    squaresum = peaksquare = 0.0;                                             \
+    for (j = 0; j < num_samples; j += channels) {                             \
+      square = ((gdouble) in[j]) * in[j];                                     \
+      if (square > peaksquare) peaksquare = square;                           \
+      squaresum += square;                                                    \
+    }                                                                         \
+    NCS[c] = squaresum / normalizer;                                          \
+    NPS[c] = peaksquare / normalizer;                                         \
   }                                                                           \
-                                                                              \
-  *NCS = squaresum;                                                           \
-  *NPS = peaksquare;                                                          \
 }
 
-DEFINE_FLOAT_LEVEL_CALCULATOR (gfloat);
-DEFINE_FLOAT_LEVEL_CALCULATOR (gdouble);
-
-/* we would need stride to deinterleave also
-static void inline
-gst_level_calculate_gdouble (gpointer data, guint num, guint channels,
-                            gdouble *NCS, gdouble *NPS)
-{
-  oil_squaresum_f64(NCS,(gdouble *)data,num);
-  *NPS = 0.0;
+/* converts num samples to doubles in the range [-1.0, 1.0] */
+#define DEFINE_LEVEL_CONVERTER(TYPE, NORMALIZER)                              \
+static void                                                                   \
+gst_level_convert_##TYPE (gpointer data, guint num, gdouble *out)             \
+{                                                                             \
+  TYPE * in = (TYPE *)data;                                                   \
+  gdouble scale = 1.0 / (NORMALIZER);                                         \
+  guint j;                                                                    \
+                                                                              \
+  for (j = 0; j < num; j++)                                                   \
+    out[j] = in[j] * scale;                                                   \
 }
-*/
+
+#define DEFINE_LEVEL_CALCULATORS(TYPE, ACC_TYPE, NORMALIZER, AMPLITUDE)       \
+  DEFINE_LEVEL_CALCULATOR (TYPE, ACC_TYPE, NORMALIZER, 1)                     \
+  DEFINE_LEVEL_CALCULATOR (TYPE, ACC_TYPE, NORMALIZER, 2)                     \
+  DEFINE_LEVEL_CALCULATOR (TYPE, ACC_TYPE, NORMALIZER, 4)                     \
+  DEFINE_LEVEL_CALCULATOR (TYPE, ACC_TYPE, NORMALIZER, 6)                     \
+  DEFINE_LEVEL_CALCULATOR (TYPE, ACC_TYPE, NORMALIZER, 8)                     \
+  DEFINE_LEVEL_CALCULATOR_ANY (TYPE, NORMALIZER)                              \
+  DEFINE_LEVEL_CONVERTER (TYPE, AMPLITUDE)
+
+#define INT_NORMALIZER(RESOLUTION) \
+  ((gdouble) (G_GINT64_CONSTANT(1) << (RESOLUTION * 2)))
+#define INT_AMPLITUDE(RESOLUTION) \
+  ((gdouble) (G_GINT64_CONSTANT(1) << RESOLUTION))
+
+/* the square sums of 8 and 16 bit samples are exact in 64 bit integers */
+DEFINE_LEVEL_CALCULATORS (gint32, gdouble, INT_NORMALIZER (31),
+    INT_AMPLITUDE (31));
+DEFINE_LEVEL_CALCULATORS (gint16, gint64, INT_NORMALIZER (15),
+    INT_AMPLITUDE (15));
+DEFINE_LEVEL_CALCULATORS (gint8, gint64, INT_NORMALIZER (7),
+    INT_AMPLITUDE (7));
+DEFINE_LEVEL_CALCULATORS (gfloat, gdouble, 1.0, 1.0);
+DEFINE_LEVEL_CALCULATORS (gdouble, gdouble, 1.0, 1.0);
+
+#define SELECT_LEVEL_CALCULATOR(TYPE, channels)                               \
+  ((channels) == 1 ? gst_level_calculate_##TYPE##_1 :                         \
+   (channels) == 2 ? gst_level_calculate_##TYPE##_2 :                         \
+   (channels) == 4 ? gst_level_calculate_##TYPE##_4 :                         \
+   (channels) == 6 ? gst_level_calculate_##TYPE##_6 :                         \
+   (channels) == 8 ? gst_level_calculate_##TYPE##_8 :                         \
+   gst_level_calculate_##TYPE)
 
 
 static gint
@@ -426,6 +594,99 @@ structure_get_int (GstStructure * structure, const gchar * field)
   return ret;
 }
 
+/* K-weighting filter of EBU R128 / ITU-R BS.1770 for any sample rate, the
+ * pre-filter is a high shelf and the RLB filter a high-pass */
+static void
+gst_level_setup_k_weighting (GstLevel * filter)
+{
+  gdouble f0, G, Q, K, Vh, Vb, a0;
+
+  f0 = 1681.974450955533;
+  G = 3.999843853973347;
+  Q = 0.7071752369554196;
+
+  if (filter->rate > 2 * f0) {
+    K = tan (G_PI * f0 / filter->rate);
+    Vh = pow (10.0, G / 20.0);
+    Vb = pow (Vh, 0.4996667741545416);
+    a0 = 1.0 + K / Q + K * K;
+
+    filter->kw_b[0][0] = (Vh + Vb * K / Q + K * K) / a0;
+    filter->kw_b[0][1] = 2.0 * (K * K - Vh) / a0;
+    filter->kw_b[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+    filter->kw_a[0][1] = 2.0 * (K * K - 1.0) / a0;
+    filter->kw_a[0][2] = (1.0 - K / Q + K * K) / a0;
+  } else {
+    /* the shelf is above the nyquist frequency, pass everything */
+    filter->kw_b[0][0] = 1.0;
+    filter->kw_b[0][1] = filter->kw_b[0][2] = 0.0;
+    filter->kw_a[0][1] = filter->kw_a[0][2] = 0.0;
+  }
+  filter->kw_a[0][0] = 1.0;
+
+  f0 = 38.13547087602444;
+  Q = 0.5003270373238773;
+  K = tan (G_PI * f0 / filter->rate);
+  a0 = 1.0 + K / Q + K * K;
+
+  filter->kw_b[1][0] = 1.0;
+  filter->kw_b[1][1] = -2.0;
+  filter->kw_b[1][2] = 1.0;
+  filter->kw_a[1][0] = 1.0;
+  filter->kw_a[1][1] = 2.0 * (K * K - 1.0) / a0;
+  filter->kw_a[1][2] = (1.0 - K / Q + K * K) / a0;
+}
+
+/* weight of the channels for the loudness, the surround channels count more
+ * and the LFE channel is not used at all */
+static void
+gst_level_setup_channel_weights (GstLevel * filter, GstStructure * structure)
+{
+  GstAudioChannelPosition *pos = NULL;
+  gint i;
+
+  if (filter->channels > 2
+      && gst_structure_has_field (structure, "channel-positions"))
+    pos = gst_audio_get_channel_positions (structure);
+
+  for (i = 0; i < filter->channels; ++i) {
+    filter->kw_weight[i] = 1.0;
+    if (!pos)
+      continue;
+
+    switch (pos[i]) {
+      case GST_AUDIO_CHANNEL_POSITION_LFE:
+        filter->kw_weight[i] = 0.0;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+      case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+      case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+      case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+        filter->kw_weight[i] = 1.41;
+        break;
+      default:
+        break;
+    }
+  }
+  g_free (pos);
+}
+
+/* resets the filter states of the true peak and loudness measurement */
+static void
+gst_level_reset_meters (GstLevel * filter)
+{
+  if (filter->tp_history)
+    memset (filter->tp_history, 0,
+        sizeof (gdouble) * filter->channels * (TRUE_PEAK_TAPS - 1));
+  if (filter->kw_state)
+    memset (filter->kw_state, 0, sizeof (gdouble) * filter->channels * 4);
+
+  filter->lufs_frames = 0;
+  filter->lufs_sum = 0.0;
+  filter->lufs_pos = 0;
+  filter->lufs_n_blocks = 0;
+}
+
 static gboolean
 gst_level_set_caps (GstBaseTransform * trans, GstCaps * in, GstCaps * out)
 {
@@ -440,41 +701,42 @@ gst_level_set_caps (GstBaseTransform * trans, GstCaps * in, GstCaps * out)
   filter->channels = structure_get_int (structure, "channels");
   mimetype = gst_structure_get_name (structure);
 
-  /* FIXME: set calculator func depending on caps */
   filter->process = NULL;
+  filter->convert = NULL;
   if (strcmp (mimetype, "audio/x-raw-int") == 0) {
     GST_DEBUG_OBJECT (filter, "use int: %u", filter->width);
     switch (filter->width) {
       case 8:
-        filter->process = gst_level_calculate_gint8;
+        filter->process = SELECT_LEVEL_CALCULATOR (gint8, filter->channels);
+        filter->convert = gst_level_convert_gint8;
         break;
       case 16:
-        filter->process = gst_level_calculate_gint16;
+        filter->process = SELECT_LEVEL_CALCULATOR (gint16, filter->channels);
+        filter->convert = gst_level_convert_gint16;
         break;
       case 32:
-        filter->process = gst_level_calculate_gint32;
+        filter->process = SELECT_LEVEL_CALCULATOR (gint32, filter->channels);
+        filter->convert = gst_level_convert_gint32;
         break;
     }
   } else if (strcmp (mimetype, "audio/x-raw-float") == 0) {
     GST_DEBUG_OBJECT (filter, "use float, %u", filter->width);
     switch (filter->width) {
       case 32:
-        filter->process = gst_level_calculate_gfloat;
+        filter->process = SELECT_LEVEL_CALCULATOR (gfloat, filter->channels);
+        filter->convert = gst_level_convert_gfloat;
         break;
       case 64:
-        filter->process = gst_level_calculate_gdouble;
+        filter->process = SELECT_LEVEL_CALCULATOR (gdouble, filter->channels);
+        filter->convert = gst_level_convert_gdouble;
         break;
     }
   }
 
   /* allocate channel variable arrays */
-  g_free (filter->CS);
-  g_free (filter->peak);
-  g_free (filter->last_peak);
-  g_free (filter->decay_peak);
-  g_free (filter->decay_peak_base);
-  g_free (filter->decay_peak_age);
+  gst_level_free_channel_data (filter);
   filter->CS = g_new (gdouble, filter->channels);
+  filter->MS = g_new (gdouble, filter->channels);
   filter->peak = g_new (gdouble, filter->channels);
   filter->last_peak = g_new (gdouble, filter->channels);
   filter->decay_peak = g_new (gdouble, filter->channels);
@@ -482,15 +744,30 @@ gst_level_set_caps (GstBaseTransform * trans, GstCaps * in, GstCaps * out)
 
   filter->decay_peak_age = g_new (GstClockTime, filter->channels);
 
+  filter->last_true_peak = g_new (gdouble, filter->channels);
+  filter->tp_history = g_new (gdouble,
+      filter->channels * (TRUE_PEAK_TAPS - 1));
+  filter->kw_state = g_new (gdouble, filter->channels * 4);
+  filter->kw_weight = g_new (gdouble, filter->channels);
+  filter->message_values = g_new (gdouble, filter->channels * 4);
+  filter->block = g_new (gdouble, filter->channels * BLOCK_FRAMES);
+  filter->tp_buf = g_new (gdouble, TRUE_PEAK_TAPS - 1 + BLOCK_FRAMES);
+
   for (i = 0; i < filter->channels; ++i) {
     filter->CS[i] = filter->peak[i] = filter->last_peak[i] =
         filter->decay_peak[i] = filter->decay_peak_base[i] = 0.0;
     filter->decay_peak_age[i] = G_GUINT64_CONSTANT (0);
+    filter->last_true_peak[i] = 0.0;
   }
 
   filter->interval_frames =
       GST_CLOCK_TIME_TO_FRAMES (filter->interval, filter->rate);
 
+  filter->lufs_block_frames = MAX (filter->rate / 10, 1);
+  gst_level_setup_k_weighting (filter);
+  gst_level_setup_channel_weights (filter, structure);
+  gst_level_reset_meters (filter);
+
   return TRUE;
 }
 
@@ -500,10 +777,163 @@ gst_level_start (GstBaseTransform * trans)
   GstLevel *filter = GST_LEVEL (trans);
 
   filter->num_frames = 0;
+  gst_level_reset_meters (filter);
 
   return TRUE;
 }
 
+static void
+gst_level_push_loudness_block (GstLevel * filter)
+{
+  filter->lufs_blocks[filter->lufs_pos] =
+      filter->lufs_sum / filter->lufs_frames;
+  filter->lufs_pos = (filter->lufs_pos + 1) % G_N_ELEMENTS (filter->lufs_blocks);
+  if (filter->lufs_n_blocks < G_N_ELEMENTS (filter->lufs_blocks))
+    filter->lufs_n_blocks++;
+
+  filter->lufs_sum = 0.0;
+  filter->lufs_frames = 0;
+}
+
+/* loudness in LUFS over the last n_blocks blocks of 100ms */
+static gdouble
+gst_level_get_loudness (GstLevel * filter, gint n_blocks)
+{
+  gint i, n, pos = filter->lufs_pos;
+  gdouble sum = 0.0;
+
+  n = MIN (n_blocks, filter->lufs_n_blocks);
+  for (i = 0; i < n; i++) {
+    pos = (pos + G_N_ELEMENTS (filter->lufs_blocks) - 1) %
+        G_N_ELEMENTS (filter->lufs_blocks);
+    sum += filter->lufs_blocks[pos];
+  }
+  if (n > 0)
+    sum /= n;
+
+  return -0.691 + 10 * log10 (sum + EPSILON);
+}
+
+/* gap buffers count as silence for the loudness */
+static void
+gst_level_add_silence (GstLevel * filter, guint num_frames)
+{
+  guint n;
+
+  memset (filter->tp_history, 0,
+      sizeof (gdouble) * filter->channels * (TRUE_PEAK_TAPS - 1));
+  memset (filter->kw_state, 0, sizeof (gdouble) * filter->channels * 4);
+
+  while (num_frames > 0) {
+    n = MIN (num_frames, filter->lufs_block_frames - filter->lufs_frames);
+    filter->lufs_frames += n;
+    if (filter->lufs_frames == filter->lufs_block_frames)
+      gst_level_push_loudness_block (filter);
+    num_frames -= n;
+  }
+}
+
+/* Calculates the normalized square sums and peaks like filter->process and
+ * additionally the true peak and the loudness, in one pass over the data.
+ * The samples are converted to doubles one block at a time for this and
+ * the blocks never cross the 100ms loudness blocks. */
+static void
+gst_level_calculate_meters (GstLevel * filter, guint8 * data,
+    guint num_frames)
+{
+  gint channels = filter->channels;
+  guint frame_size = channels * (filter->width / 8);
+  gdouble *block = filter->block;
+  gdouble *tp_buf = filter->tp_buf;
+  guint j, k, n;
+  gint c, p;
+
+  for (c = 0; c < channels; c++)
+    filter->MS[c] = filter->peak[c] = 0.0;
+
+  while (num_frames > 0) {
+    n = MIN (num_frames, BLOCK_FRAMES);
+    if (filter->loudness)
+      n = MIN (n, filter->lufs_block_frames - filter->lufs_frames);
+
+    filter->convert (data, n * channels, block);
+
+    for (c = 0; c < channels; c++) {
+      const gdouble *x = block + c;
+      gdouble squaresum = 0.0, peaksquare = 0.0, square;
+
+      for (j = 0; j < n; j++) {
+        square = x[j * channels] * x[j * channels];
+        if (square > peaksquare)
+          peaksquare = square;
+        squaresum += square;
+      }
+      filter->MS[c] += squaresum;
+      if (peaksquare > filter->peak[c])
+        filter->peak[c] = peaksquare;
+
+      if (filter->true_peak) {
+        gdouble *history = filter->tp_history + c * (TRUE_PEAK_TAPS - 1);
+        gdouble tp = peaksquare, v;
+
+        /* the oversampler needs the last samples of the previous block */
+        memcpy (tp_buf, history, sizeof (gdouble) * (TRUE_PEAK_TAPS - 1));
+        for (j = 0; j < n; j++)
+          tp_buf[TRUE_PEAK_TAPS - 1 + j] = x[j * channels];
+
+        for (j = 0; j < n; j++) {
+          for (p = 0; p < 4; p++) {
+            v = 0.0;
+            for (k = 0; k < TRUE_PEAK_TAPS; k++)
+              v += true_peak_coeffs[p][k] * tp_buf[j + TRUE_PEAK_TAPS - 1 - k];
+            if (v * v > tp)
+              tp = v * v;
+          }
+        }
+        memcpy (history, tp_buf + n, sizeof (gdouble) * (TRUE_PEAK_TAPS - 1));
+
+        if (tp > filter->last_true_peak[c])
+          filter->last_true_peak[c] = tp;
+      }
+
+      if (filter->loudness && filter->kw_weight[c] != 0.0) {
+        gdouble *state = filter->kw_state + c * 4;
+        gdouble s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+        gdouble y, z, sum = 0.0;
+
+        /* pre-filter and RLB filter in transposed direct form II */
+        for (j = 0; j < n; j++) {
+          y = filter->kw_b[0][0] * x[j * channels] + s0;
+          s0 = filter->kw_b[0][1] * x[j * channels] - filter->kw_a[0][1] * y +
+              s1;
+          s1 = filter->kw_b[0][2] * x[j * channels] - filter->kw_a[0][2] * y;
+          z = filter->kw_b[1][0] * y + s2;
+          s2 = filter->kw_b[1][1] * y - filter->kw_a[1][1] * z + s3;
+          s3 = filter->kw_b[1][2] * y - filter->kw_a[1][2] * z;
+          sum += z * z;
+        }
+
+        /* don't let the filter state decay into denormals on silence */
+        state[0] = (fabs (s0) < EPSILON) ? 0.0 : s0;
+        state[1] = (fabs (s1) < EPSILON) ? 0.0 : s1;
+        state[2] = (fabs (s2) < EPSILON) ? 0.0 : s2;
+        state[3] = (fabs (s3) < EPSILON) ? 0.0 : s3;
+
+        filter->lufs_sum += filter->kw_weight[c] * sum;
+      }
+    }
+
+    if (filter->loudness) {
+      filter->lufs_frames += n;
+      if (filter->lufs_frames == filter->lufs_block_frames)
+        gst_level_push_loudness_block (filter);
+    }
+
+    data += n * frame_size;
+    num_frames -= n;
+  }
+}
+
 static GstMessage *
 gst_level_message_new (GstLevel * level, GstClockTime timestamp,
     GstClockTime duration)
@@ -513,8 +943,6 @@ gst_level_message_new (GstLevel * level, GstClockTime timestamp,
   GValue v = { 0, };
   GstClockTime endtime, running_time, stream_time;
 
-  g_value_init (&v, GST_TYPE_LIST);
-
   running_time = gst_segment_to_running_time (&trans->segment, GST_FORMAT_TIME,
       timestamp);
   stream_time = gst_segment_to_stream_time (&trans->segment, GST_FORMAT_TIME,
@@ -528,41 +956,73 @@ gst_level_message_new (GstLevel * level, GstClockTime timestamp,
       "stream-time", G_TYPE_UINT64, stream_time,
       "running-time", G_TYPE_UINT64, running_time,
       "duration", G_TYPE_UINT64, duration, NULL);
-  /* will copy-by-value */
-  gst_structure_set_value (s, "rms", &v);
-  gst_structure_set_value (s, "peak", &v);
-  gst_structure_set_value (s, "decay", &v);
 
-  g_value_unset (&v);
+  /* the per channel values are added as buffers later for compact messages */
+  if (!level->compact_messages) {
+    g_value_init (&v, GST_TYPE_LIST);
+    /* will copy-by-value */
+    gst_structure_set_value (s, "rms", &v);
+    gst_structure_set_value (s, "peak", &v);
+    gst_structure_set_value (s, "decay", &v);
+    if (level->true_peak)
+      gst_structure_set_value (s, "true-peak", &v);
+    g_value_unset (&v);
+  }
+
+  if (level->loudness) {
+    gst_structure_set (s,
+        "momentary-loudness", G_TYPE_DOUBLE, gst_level_get_loudness (level, 4),
+        "short-term-loudness", G_TYPE_DOUBLE,
+        gst_level_get_loudness (level, 30), NULL);
+  }
 
   return gst_message_new_element (GST_OBJECT (level), s);
 }
 
+static void
+gst_level_message_append_value (GstStructure * s, const gchar * name,
+    GValue * v, gdouble value)
+{
+  GValue *l;
+
+  l = (GValue *) gst_structure_get_value (s, name);
+  g_value_set_double (v, value);
+  gst_value_list_append_value (l, v);   /* copies by value */
+}
+
 static void
 gst_level_message_append_channel (GstMessage * m, gdouble rms, gdouble peak,
-    gdouble decay)
+    gdouble decay, gdouble true_peak)
 {
   GstStructure *s;
   GValue v = { 0, };
-  GValue *l;
 
   g_value_init (&v, G_TYPE_DOUBLE);
 
   s = (GstStructure *) gst_message_get_structure (m);
 
-  l = (GValue *) gst_structure_get_value (s, "rms");
-  g_value_set_double (&v, rms);
-  gst_value_list_append_value (l, &v);  /* copies by value */
+  gst_level_message_append_value (s, "rms", &v, rms);
+  gst_level_message_append_value (s, "peak", &v, peak);
+  gst_level_message_append_value (s, "decay", &v, decay);
+  if (gst_structure_has_field (s, "true-peak"))
+    gst_level_message_append_value (s, "true-peak", &v, true_peak);
 
-  l = (GValue *) gst_structure_get_value (s, "peak");
-  g_value_set_double (&v, peak);
-  gst_value_list_append_value (l, &v);  /* copies by value */
+  g_value_unset (&v);
+}
 
-  l = (GValue *) gst_structure_get_value (s, "decay");
-  g_value_set_double (&v, decay);
-  gst_value_list_append_value (l, &v);  /* copies by value */
+static void
+gst_level_message_add_buffer (GstMessage * m, const gchar * name,
+    const gdouble * values, gint channels)
+{
+  GstStructure *s;
+  GstBuffer *buf;
 
-  g_value_unset (&v);
+  s = (GstStructure *) gst_message_get_structure (m);
+
+  buf = gst_buffer_new_and_alloc (channels * sizeof (gdouble));
+  memcpy (GST_BUFFER_DATA (buf), values, channels * sizeof (gdouble));
+  gst_structure_set (s, name, GST_TYPE_BUFFER, buf, NULL);
+  gst_buffer_unref (buf);
 }
 
 static GstFlowReturn
@@ -570,7 +1030,6 @@ gst_level_transform_ip (GstBaseTransform * trans, GstBuffer * in)
 {
   GstLevel *filter;
   guint8 *in_data;
-  gdouble CS;
   guint i;
   guint num_frames = 0;
   guint num_int_samples = 0;    /* number of interleaved samples
@@ -590,18 +1049,28 @@ gst_level_transform_ip (GstBaseTransform * trans, GstBuffer * in)
 
   num_frames = num_int_samples / filter->channels;
 
+  if (!GST_BUFFER_FLAG_IS_SET (in, GST_BUFFER_FLAG_GAP)) {
+    if (filter->true_peak || filter->loudness) {
+      gst_level_calculate_meters (filter, in_data, num_frames);
+    } else {
+      filter->process (in_data, num_frames, filter->channels, filter->MS,
+          filter->peak);
+    }
+  } else {
+    for (i = 0; i < filter->channels; ++i)
+      filter->MS[i] = filter->peak[i] = 0.0;
+    if (filter->loudness)
+      gst_level_add_silence (filter, num_frames);
+  }
+
   for (i = 0; i < filter->channels; ++i) {
     if (!GST_BUFFER_FLAG_IS_SET (in, GST_BUFFER_FLAG_GAP)) {
-      filter->process (in_data, num_int_samples, filter->channels, &CS,
-          &filter->peak[i]);
       GST_LOG_OBJECT (filter,
           "channel %d, cumulative sum %f, peak %f, over %d samples/%d channels",
-          i, CS, filter->peak[i], num_int_samples, filter->channels);
-      filter->CS[i] += CS;
-    } else {
-      filter->peak[i] = 0.0;
+          i, filter->MS[i], filter->peak[i], num_int_samples,
+          filter->channels);
+      filter->CS[i] += filter->MS[i];
     }
-    in_data += (filter->width / 8);
 
     filter->decay_peak_age[i] +=
         GST_FRAMES_TO_CLOCK_TIME (num_frames, filter->rate);
@@ -670,7 +1139,7 @@ gst_level_transform_ip (GstBaseTransform * trans, GstBuffer * in)
 
       for (i = 0; i < filter->channels; ++i) {
         gdouble RMS;
-        gdouble RMSdB, lastdB, decaydB;
+        gdouble RMSdB, lastdB, decaydB, truedB;
 
         RMS = sqrt (filter->CS[i] / filter->num_frames);
         GST_LOG_OBJECT (filter,
@@ -684,6 +1153,7 @@ gst_level_transform_ip (GstBaseTransform * trans, GstBuffer * in)
         /* peak values are square sums, ie. power, so 10 * log 10 */
         lastdB = 10 * log10 (filter->last_peak[i] + EPSILON);
         decaydB = 10 * log10 (filter->decay_peak[i] + EPSILON);
+        truedB = 10 * log10 (filter->last_true_peak[i] + EPSILON);
 
         if (filter->decay_peak[i] < filter->last_peak[i]) {
           /* this can happen in certain cases, for example when
@@ -697,11 +1167,31 @@ gst_level_transform_ip (GstBaseTransform * trans, GstBuffer * in)
             "message: RMS %f dB, peak %f dB, decay %f dB",
             RMSdB, lastdB, decaydB);
 
-        gst_level_message_append_channel (m, RMSdB, lastdB, decaydB);
+        if (filter->compact_messages) {
+          filter->message_values[i] = RMSdB;
+          filter->message_values[filter->channels + i] = lastdB;
+          filter->message_values[2 * filter->channels + i] = decaydB;
+          filter->message_values[3 * filter->channels + i] = truedB;
+        } else {
+          gst_level_message_append_channel (m, RMSdB, lastdB, decaydB, truedB);
+        }
 
-        /* reset cumulative and normal peak */
+        /* reset cumulative, normal and true peak */
         filter->CS[i] = 0.0;
         filter->last_peak[i] = 0.0;
+        filter->last_true_peak[i] = 0.0;
+      }
+
+      if (filter->compact_messages) {
+        gst_level_message_add_buffer (m, "rms", filter->message_values,
+            filter->channels);
+        gst_level_message_add_buffer (m, "peak",
+            filter->message_values + filter->channels, filter->channels);
+        gst_level_message_add_buffer (m, "decay",
+            filter->message_values + 2 * filter->channels, filter->channels);
+        if (filter->true_peak)
+          gst_level_message_add_buffer (m, "true-peak",
+              filter->message_values + 3 * filter->channels, filter->channels);
       }
 
       gst_element_post_message (GST_ELEMENT (filter), m);
@@ -58,6 +58,9 @@ struct _GstLevel {
 
   gboolean message;             /* whether or not to post messages */
   guint64 interval;             /* how many seconds between emits */
+  gboolean true_peak;           /* whether to measure the true peak */
+  gboolean loudness;            /* whether to measure the loudness */
+  gboolean compact_messages;    /* post values as buffers of doubles */
 
   gint rate;                    /* caps variables */
   gint width;
@@ -79,8 +82,30 @@ struct _GstLevel {
   gdouble *MS;                  /* normalized Mean Square of buffer */
   gdouble *RMS_dB;              /* RMS in dB to emit */
   GstClockTime *decay_peak_age; /* age of last peak */
-  
+  gdouble *last_true_peak;      /* normalized true peak power over interval */
+  gdouble *tp_history;          /* last input samples of the oversampler */
+  gdouble *kw_state;            /* K-weighting filter state */
+  gdouble *kw_weight;           /* loudness weight of each channel */
+  gdouble *message_values;      /* dB values of a message, field by field */
+
+  /* scratch memory for true peak and loudness measurement */
+  gdouble *block;               /* interleaved normalized samples */
+  gdouble *tp_buf;              /* oversampler input of one channel */
+
+  /* K-weighting filter coefficients, pre-filter and RLB high-pass */
+  gdouble kw_b[2][3];
+  gdouble kw_a[2][3];
+
+  /* mean squares of the last 3 seconds in blocks of 100ms */
+  gint lufs_block_frames;       /* frames per block */
+  gint lufs_frames;             /* frames in the current block */
+  gdouble lufs_sum;             /* weighted square sum of the current block */
+  gdouble lufs_blocks[30];
+  gint lufs_pos;                /* position of the next block */
+  gint lufs_n_blocks;           /* number of valid blocks */
+
   void (*process)(gpointer, guint, guint, gdouble*, gdouble*);
+  void (*convert)(gpointer, guint, gdouble*);
 };
 
 struct _GstLevelClass {
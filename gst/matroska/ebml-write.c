@@ -33,6 +33,9 @@
 GST_DEBUG_CATEGORY_STATIC (gst_ebml_write_debug);
 #define GST_CAT_DEFAULT gst_ebml_write_debug
 
+/* size of the chunks small elements are allocated from */
+#define GST_EBML_WRITE_ARENA_SIZE 4096
+
 #define _do_init(thing) \
       GST_DEBUG_CATEGORY_INIT (gst_ebml_write_debug, "ebmlwrite", 0, "Write EBML structured data")
 GST_BOILERPLATE_FULL (GstEbmlWrite, gst_ebml_write, GstObject, GST_TYPE_OBJECT,
@@ -64,6 +67,10 @@ gst_ebml_write_init (GstEbmlWrite * ebml, GstEbmlWriteClass * klass)
   ebml->streamheader = NULL;
   ebml->streamheader_pos = 0;
   ebml->writing_streamheader = FALSE;
+  ebml->arena = NULL;
+  ebml->arena_used = 0;
+  ebml->buffer_list = NULL;
+  ebml->buffer_list_it = NULL;
   ebml->caps = NULL;
 }
 
@@ -84,6 +91,18 @@ gst_ebml_write_finalize (GObject * object)
     ebml->streamheader = NULL;
   }
 
+  if (ebml->buffer_list) {
+    gst_buffer_list_iterator_free (ebml->buffer_list_it);
+    gst_buffer_list_unref (ebml->buffer_list);
+    ebml->buffer_list_it = NULL;
+    ebml->buffer_list = NULL;
+  }
+
+  if (ebml->arena) {
+    gst_buffer_unref (ebml->arena);
+    ebml->arena = NULL;
+  }
+
   if (ebml->caps) {
     gst_caps_unref (ebml->caps);
     ebml->caps = NULL;
@@ -133,6 +152,19 @@ gst_ebml_write_reset (GstEbmlWrite * ebml)
     ebml->cache = NULL;
   }
 
+  if (ebml->buffer_list) {
+    gst_buffer_list_iterator_free (ebml->buffer_list_it);
+    gst_buffer_list_unref (ebml->buffer_list);
+    ebml->buffer_list_it = NULL;
+    ebml->buffer_list = NULL;
+  }
+
+  if (ebml->arena) {
+    gst_buffer_unref (ebml->arena);
+    ebml->arena = NULL;
+  }
+  ebml->arena_used = 0;
+
   if (ebml->caps) {
     gst_caps_unref (ebml->caps);
     ebml->caps = NULL;
@@ -210,11 +242,88 @@ gst_ebml_write_set_cache (GstEbmlWrite * ebml, guint size)
   ebml->cache_pos = ebml->pos;
 }
 
+/**
+ * gst_ebml_write_start_buffer_list:
+ * @ebml: a #GstEbmlWrite.
+ *
+ * Start collecting output into a #GstBufferList.
+ *
+ * All buffers that would otherwise be pushed one by one are
+ * added to a single group of the list instead, which is pushed
+ * with gst_ebml_write_flush_buffer_list(). This is meant for
+ * chunks of contiguous media data such as a cluster header and
+ * its blocks. Non-contiguous writes (seeks) implicitly push what
+ * was collected so far, so that byte segment events still end up
+ * between the right buffers.
+ */
+void
+gst_ebml_write_start_buffer_list (GstEbmlWrite * ebml)
+{
+  g_return_if_fail (ebml->buffer_list == NULL);
+
+  ebml->buffer_list = gst_buffer_list_new ();
+  ebml->buffer_list_it = gst_buffer_list_iterate (ebml->buffer_list);
+  gst_buffer_list_iterator_add_group (ebml->buffer_list_it);
+}
+
+static void
+gst_ebml_write_push_buffer_list (GstEbmlWrite * ebml, gboolean restart)
+{
+  GstBufferList *list = ebml->buffer_list;
+
+  gst_buffer_list_iterator_free (ebml->buffer_list_it);
+  ebml->buffer_list_it = NULL;
+  ebml->buffer_list = NULL;
+
+  if (ebml->last_write_result == GST_FLOW_OK &&
+      gst_buffer_list_get (list, 0, 0) != NULL) {
+    GST_LOG ("Pushing buffer list");
+    ebml->last_write_result = gst_pad_push_list (ebml->srcpad, list);
+  } else {
+    gst_buffer_list_unref (list);
+  }
+
+  if (restart)
+    gst_ebml_write_start_buffer_list (ebml);
+}
+
+/**
+ * gst_ebml_write_flush_buffer_list:
+ * @ebml: a #GstEbmlWrite.
+ *
+ * Push the buffer list started with gst_ebml_write_start_buffer_list()
+ * and go back to pushing buffers individually.
+ */
+void
+gst_ebml_write_flush_buffer_list (GstEbmlWrite * ebml)
+{
+  if (!ebml->buffer_list)
+    return;
+
+  gst_ebml_write_push_buffer_list (ebml, FALSE);
+}
+
+/* push @buf downstream or queue it in the pending buffer list */
+static void
+gst_ebml_write_push (GstEbmlWrite * ebml, GstBuffer * buf)
+{
+  if (ebml->buffer_list) {
+    gst_buffer_list_iterator_add (ebml->buffer_list_it, buf);
+    return;
+  }
+
+  ebml->last_write_result = gst_pad_push (ebml->srcpad, buf);
+}
+
 static gboolean
 gst_ebml_writer_send_new_segment_event (GstEbmlWrite * ebml, guint64 new_pos)
 {
   gboolean res;
 
+  /* whatever was collected so far has to go out before the event */
+  if (ebml->buffer_list)
+    gst_ebml_write_push_buffer_list (ebml, TRUE);
+
   GST_INFO ("seeking to %" G_GUINT64_FORMAT, new_pos);
 
   res = gst_pad_push_event (ebml->srcpad,
@@ -261,7 +370,7 @@ gst_ebml_write_flush_cache (GstEbmlWrite * ebml, gboolean is_keyframe,
       GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
     }
     ebml->last_pos = ebml->pos;
-    ebml->last_write_result = gst_pad_push (ebml->srcpad, buffer);
+    gst_ebml_write_push (ebml, buffer);
   } else {
     gst_buffer_unref (buffer);
   }
@@ -273,10 +382,14 @@ gst_ebml_write_flush_cache (GstEbmlWrite * ebml, gboolean is_keyframe,
  * @ebml: a #GstEbmlWrite.
  * @size: size of the requested buffer.
  *
- * Create a buffer for one element. If there is
- * a cache, use that instead.
+ * Create a buffer for one element.
  *
- * Returns: A new #GstBuffer.
+ * Small elements are not given a buffer of their own but are
+ * written straight into the shared arena; in that case NULL is
+ * returned and gst_ebml_write_element_push() takes care of
+ * copying them to the cache or creating a subbuffer.
+ *
+ * Returns: A new #GstBuffer, or NULL for arena backed elements.
  */
 static GstBuffer *
 gst_ebml_write_element_new (GstEbmlWrite * ebml, guint8 ** data_out, guint size)
@@ -287,6 +400,21 @@ gst_ebml_write_element_new (GstEbmlWrite * ebml, guint8 ** data_out, guint size)
   /* length, ID */
   size += 12;
 
+  if (size <= GST_EBML_WRITE_ARENA_SIZE / 4) {
+    if (ebml->arena == NULL ||
+        ebml->arena_used + size > GST_BUFFER_SIZE (ebml->arena)) {
+      /* outstanding subbuffers keep the old arena alive */
+      if (ebml->arena)
+        gst_buffer_unref (ebml->arena);
+      ebml->arena = gst_buffer_new_and_alloc (GST_EBML_WRITE_ARENA_SIZE);
+      ebml->arena_used = 0;
+    }
+
+    *data_out = GST_BUFFER_DATA (ebml->arena) + ebml->arena_used;
+
+    return NULL;
+  }
+
   buf = gst_buffer_new_and_alloc (size);
   GST_BUFFER_TIMESTAMP (buf) = ebml->timestamp;
 
@@ -395,7 +523,7 @@ gst_ebml_write_element_data (guint8 ** data_inout, guint8 * write,
 /**
  * gst_ebml_write_element_push:
  * @ebml: #GstEbmlWrite
- * @buf: #GstBuffer to be written.
+ * @buf: #GstBuffer to be written (or NULL for data written to the arena).
  * @buf_data: Start of data to push from @buf (or NULL for whole buffer).
  * @buf_data_end: Data pointer positioned after the last byte in @buf_data (or
  * NULL for whole buffer).
@@ -413,7 +541,8 @@ gst_ebml_write_element_push (GstEbmlWrite * ebml, GstBuffer * buf,
 
   if (buf_data_end) {
     data_size = buf_data_end - buf_data;
-    GST_BUFFER_SIZE (buf) = data_size;
+    if (buf)
+      GST_BUFFER_SIZE (buf) = data_size;
   } else {
     data_size = GST_BUFFER_SIZE (buf);
   }
@@ -425,11 +554,20 @@ gst_ebml_write_element_push (GstEbmlWrite * ebml, GstBuffer * buf,
     gst_byte_writer_put_data (ebml->streamheader, buf_data, data_size);
   }
   if (ebml->cache) {
+    /* arena space is simply reused by the next element */
     gst_byte_writer_put_data (ebml->cache, buf_data, data_size);
-    gst_buffer_unref (buf);
+    if (buf)
+      gst_buffer_unref (buf);
     return;
   }
 
+  if (!buf) {
+    buf = gst_buffer_create_sub (ebml->arena,
+        buf_data - GST_BUFFER_DATA (ebml->arena), data_size);
+    GST_BUFFER_TIMESTAMP (buf) = ebml->timestamp;
+    ebml->arena_used += data_size;
+  }
+
   if (ebml->last_write_result == GST_FLOW_OK) {
     buf = gst_buffer_make_metadata_writable (buf);
     gst_buffer_set_caps (buf, ebml->caps);
@@ -445,7 +583,7 @@ gst_ebml_write_element_push (GstEbmlWrite * ebml, GstBuffer * buf,
       GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
     }
     ebml->last_pos = ebml->pos;
-    ebml->last_write_result = gst_pad_push (ebml->srcpad, buf);
+    gst_ebml_write_push (ebml, buf);
   } else {
     gst_buffer_unref (buf);
   }
@@ -802,6 +940,37 @@ gst_ebml_write_buffer_header (GstEbmlWrite * ebml, guint32 id, guint64 length)
 }
 
 
+/**
+ * gst_ebml_write_block_header:
+ * @ebml: #GstEbmlWrite
+ * @id: Element ID.
+ * @length: Length of the data following in a separate buffer.
+ * @hdr: Data to be written right after the element header.
+ * @hdr_size: Length of @hdr.
+ *
+ * Write header of a binary element together with the first @hdr_size
+ * bytes of its contents, e.g. the header of a matroska (Simple)Block.
+ * The remaining @length bytes are expected to follow with
+ * gst_ebml_write_buffer(), so the element header and the block header
+ * end up in one small buffer while the payload is not copied.
+ */
+void
+gst_ebml_write_block_header (GstEbmlWrite * ebml, guint32 id, guint64 length,
+    const guint8 * hdr, guint hdr_size)
+{
+  GstBuffer *buf;
+  guint8 *data_start, *data_end;
+
+  buf = gst_ebml_write_element_new (ebml, &data_start, hdr_size);
+  data_end = data_start;
+
+  gst_ebml_write_element_id (&data_end, id);
+  gst_ebml_write_element_size (&data_end, length + hdr_size);
+  gst_ebml_write_element_data (&data_end, (guint8 *) hdr, hdr_size);
+  gst_ebml_write_element_push (ebml, buf, data_start, data_end);
+}
+
+
 /**
  * gst_ebml_write_buffer:
  * @ebml: #GstEbmlWrite
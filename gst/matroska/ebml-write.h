@@ -59,6 +59,14 @@ typedef struct _GstEbmlWrite {
   GstByteWriter *streamheader;
   guint64 streamheader_pos;
 
+  /* small elements are carved out of this as subbuffers */
+  GstBuffer *arena;
+  guint arena_used;
+
+  /* pending output when collecting into a buffer list */
+  GstBufferList *buffer_list;
+  GstBufferListIterator *buffer_list_it;
+
   GstCaps *caps;
 } GstEbmlWrite;
 
@@ -87,6 +95,13 @@ void    gst_ebml_write_flush_cache   (GstEbmlWrite *ebml,
                                       gboolean is_keyframe,
                                       GstClockTime timestamp);
 
+/*
+ * Collect everything written up to the next flush into
+ * a single buffer list instead of pushing buffers one by one.
+ */
+void    gst_ebml_write_start_buffer_list (GstEbmlWrite *ebml);
+void    gst_ebml_write_flush_buffer_list (GstEbmlWrite *ebml);
+
 /*
  * Seeking.
  */
@@ -137,6 +152,11 @@ void    gst_ebml_write_buffer_header (GstEbmlWrite *ebml,
                                       guint64       length);
 void    gst_ebml_write_buffer        (GstEbmlWrite *ebml,
                                       GstBuffer    *data);
+void    gst_ebml_write_block_header  (GstEbmlWrite *ebml,
+                                      guint32       id,
+                                      guint64       length,
+                                      const guint8 *hdr,
+                                      guint         hdr_size);
 
 /*
  * A hack, basically... See matroska-mux.c. I should actually
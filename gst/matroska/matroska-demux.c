@@ -3976,6 +3976,107 @@ exit:
   return ret;
 }
 
+/* Figures out where the frame data starts in the (Simple)Block element at
+ * the head of the adapter and which alignment its stream wants for it.
+ * Only done for unlaced blocks, which is what raw audio tracks use.
+ * Returns FALSE if nothing in particular is wanted. */
+static gboolean
+gst_matroska_demux_peek_block_alignment (GstMatroskaDemux * demux,
+    guint64 bytes, guint needed, gboolean is_simpleblock, guint * offset,
+    guint * alignment)
+{
+  GstMatroskaTrackContext *stream;
+  const guint8 *data;
+  guint size, pos = needed;
+  guint64 num;
+  gint n, stream_num;
+
+  /* BlockGroup id + size, Block id + size, track number, timecode, flags */
+  size = MIN (bytes, needed + 1 + 8 + 8 + 3);
+  data = gst_adapter_peek (demux->common.adapter, size);
+
+  if (!is_simpleblock) {
+    /* the Block is normally the first child of the BlockGroup */
+    if (pos >= size || data[pos] != GST_MATROSKA_ID_BLOCK)
+      return FALSE;
+    pos++;
+    if ((n = gst_matroska_ebmlnum_uint ((guint8 *) data + pos, size - pos,
+                &num)) < 0)
+      return FALSE;
+    pos += n;
+  }
+
+  if (pos >= size || (n = gst_matroska_ebmlnum_uint ((guint8 *) data + pos,
+              size - pos, &num)) < 0)
+    return FALSE;
+  pos += n;
+  if (pos + 3 > size)
+    return FALSE;
+  /* laced */
+  if (data[pos + 2] & 0x06)
+    return FALSE;
+  pos += 3;
+
+  stream_num = gst_matroska_read_common_stream_from_num (&demux->common, num);
+  if (stream_num < 0 || (guint) stream_num >= demux->common.num_streams)
+    return FALSE;
+  stream = g_ptr_array_index (demux->common.src, stream_num);
+  if (stream->alignment <= 1)
+    return FALSE;
+
+  *offset = pos;
+  *alignment = stream->alignment;
+  return TRUE;
+}
+
+/* Like gst_matroska_demux_take(), but for (Simple)Blocks in push mode.
+ * A block that is contained in a single upstream buffer is handed out as a
+ * sub-buffer of it and its frames as sub-buffers of that in turn, so the
+ * data is never copied. A block spanning upstream buffers has to be copied
+ * once; that copy is placed such that the frame data of raw audio tracks
+ * ends up aligned and is not copied a second time before pushing. */
+static GstFlowReturn
+gst_matroska_demux_take_block (GstMatroskaDemux * demux, guint64 bytes,
+    guint needed, gboolean is_simpleblock, GstEbmlRead * ebml)
+{
+  GstBuffer *buffer, *sub;
+  GstFlowReturn ret;
+  guint offset, alignment, pad = 0;
+
+  if (!demux->streaming ||
+      gst_adapter_available_fast (demux->common.adapter) >= bytes)
+    return gst_matroska_demux_take (demux, bytes, ebml);
+
+  ret = gst_matroska_demux_check_read_size (demux, bytes);
+  if (G_UNLIKELY (ret != GST_FLOW_OK))
+    return GST_FLOW_ERROR;
+  if (gst_adapter_available (demux->common.adapter) < bytes)
+    return GST_FLOW_UNEXPECTED;
+
+  if (!gst_matroska_demux_peek_block_alignment (demux, bytes, needed,
+          is_simpleblock, &offset, &alignment))
+    return gst_matroska_demux_take (demux, bytes, ebml);
+
+  GST_LOG_OBJECT (demux, "taking %" G_GUINT64_FORMAT " bytes spanning "
+      "buffers, frame data at %u aligned on %u", bytes, offset, alignment);
+
+  buffer = gst_buffer_new_and_alloc (bytes + alignment);
+  while (((guintptr) (GST_BUFFER_DATA (buffer) + pad + offset)) &
+      (alignment - 1))
+    pad++;
+  gst_adapter_copy (demux->common.adapter, GST_BUFFER_DATA (buffer) + pad, 0,
+      bytes);
+  gst_adapter_flush (demux->common.adapter, bytes);
+  sub = gst_buffer_create_sub (buffer, pad, bytes);
+  gst_buffer_unref (buffer);
+
+  gst_ebml_read_init (ebml, GST_ELEMENT_CAST (demux), sub,
+      demux->common.offset);
+  demux->common.offset += bytes;
+
+  return GST_FLOW_OK;
+}
+
 static void
 gst_matroska_demux_check_seekability (GstMatroskaDemux * demux)
 {
@@ -4216,7 +4317,8 @@ gst_matroska_demux_parse_id (GstMatroskaDemux * demux, guint32 id,
         case GST_MATROSKA_ID_BLOCKGROUP:
           if (!gst_matroska_demux_seek_block (demux))
             goto skip;
-          GST_READ_CHECK (gst_matroska_demux_take (demux, read, &ebml));
+          GST_READ_CHECK (gst_matroska_demux_take_block (demux, read, needed,
+                  FALSE, &ebml));
           DEBUG_ELEMENT_START (demux, &ebml, "BlockGroup");
           if ((ret = gst_ebml_read_master (&ebml, &id)) == GST_FLOW_OK) {
             ret = gst_matroska_demux_parse_blockgroup_or_simpleblock (demux,
@@ -4227,7 +4329,8 @@ gst_matroska_demux_parse_id (GstMatroskaDemux * demux, guint32 id,
         case GST_MATROSKA_ID_SIMPLEBLOCK:
           if (!gst_matroska_demux_seek_block (demux))
             goto skip;
-          GST_READ_CHECK (gst_matroska_demux_take (demux, read, &ebml));
+          GST_READ_CHECK (gst_matroska_demux_take_block (demux, read, needed,
+                  TRUE, &ebml));
           DEBUG_ELEMENT_START (demux, &ebml, "SimpleBlock");
           ret = gst_matroska_demux_parse_blockgroup_or_simpleblock (demux,
               &ebml, demux->cluster_time, demux->cluster_offset, TRUE);
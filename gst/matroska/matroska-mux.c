@@ -65,13 +65,21 @@ enum
   ARG_WRITING_APP,
   ARG_DOCTYPE_VERSION,
   ARG_MIN_INDEX_INTERVAL,
-  ARG_STREAMABLE
+  ARG_STREAMABLE,
+  ARG_MAX_CLUSTER_DURATION,
+  ARG_MAX_CLUSTER_SIZE,
+  ARG_MAX_INDEX_ENTRIES,
+  ARG_BUFFER_LIST
 };
 
 #define  DEFAULT_DOCTYPE_VERSION         2
 #define  DEFAULT_WRITING_APP             "GStreamer Matroska muxer"
 #define  DEFAULT_MIN_INDEX_INTERVAL      0
 #define  DEFAULT_STREAMABLE              FALSE
+#define  DEFAULT_MAX_CLUSTER_DURATION    0
+#define  DEFAULT_MAX_CLUSTER_SIZE        0
+#define  DEFAULT_MAX_INDEX_ENTRIES       0
+#define  DEFAULT_BUFFER_LIST             FALSE
 
 /* WAVEFORMATEX is gst_riff_strf_auds + an extra guint16 extension size */
 #define WAVEFORMATEX_SIZE  (2 + sizeof (gst_riff_strf_auds))
@@ -331,6 +339,30 @@ gst_matroska_mux_class_init (GstMatroskaMuxClass * klass)
           "to be streamed and hence no indexes written or duration written.",
           DEFAULT_STREAMABLE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_MAX_CLUSTER_DURATION,
+      g_param_spec_int64 ("max-cluster-duration", "Maximum cluster duration",
+          "A new cluster is started when the current one would span more "
+          "than this many nanoseconds (0 = only limited by the timecode "
+          "range of a cluster).", 0, G_MAXINT64, DEFAULT_MAX_CLUSTER_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_MAX_CLUSTER_SIZE,
+      g_param_spec_uint ("max-cluster-size", "Maximum cluster size",
+          "A new cluster is started when the current one has grown beyond "
+          "this many bytes (0 = unlimited).", 0, G_MAXUINT,
+          DEFAULT_MAX_CLUSTER_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_MAX_INDEX_ENTRIES,
+      g_param_spec_uint ("max-index-entries", "Maximum number of index "
+          "entries", "Upper bound on the number of cue points kept in memory; "
+          "when reached, every other entry is dropped and the index interval "
+          "is doubled (0 = unlimited).", 0, G_MAXUINT,
+          DEFAULT_MAX_INDEX_ENTRIES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_BUFFER_LIST,
+      g_param_spec_boolean ("buffer-list", "Buffer List",
+          "Push the output for each frame (cluster header, block header and "
+          "payload) as one buffer list", DEFAULT_BUFFER_LIST,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_matroska_mux_change_state);
@@ -473,6 +505,10 @@ gst_matroska_mux_init (GstMatroskaMux * mux, GstMatroskaMuxClass * g_class)
   mux->writing_app = g_strdup (DEFAULT_WRITING_APP);
   mux->min_index_interval = DEFAULT_MIN_INDEX_INTERVAL;
   mux->streamable = DEFAULT_STREAMABLE;
+  mux->max_cluster_duration_prop = DEFAULT_MAX_CLUSTER_DURATION;
+  mux->max_cluster_size = DEFAULT_MAX_CLUSTER_SIZE;
+  mux->max_index_entries = DEFAULT_MAX_INDEX_ENTRIES;
+  mux->buffer_list = DEFAULT_BUFFER_LIST;
 
   /* initialize internal variables */
   mux->index = NULL;
@@ -659,6 +695,7 @@ gst_matroska_mux_reset (GstElement * element)
   mux->num_indexes = 0;
   g_free (mux->index);
   mux->index = NULL;
+  mux->index_interval = 0;
 
   /* reset timers */
   mux->time_scale = GST_MSECOND;
@@ -2741,32 +2778,28 @@ gst_matroska_mux_finish (GstMatroskaMux * mux)
   gst_ebml_write_master_finish (ebml, mux->segment_pos);
 }
 
+#define BLOCK_HEADER_SIZE 4
+
 /**
- * gst_matroska_mux_buffer_header:
+ * gst_matroska_mux_fill_buffer_header:
  * @track: Track context.
  * @relative_timestamp: relative timestamp of the buffer
  * @flags: Buffer flags.
+ * @hdr: Memory of BLOCK_HEADER_SIZE bytes to fill.
  *
- * Create a buffer containing buffer header.
- *
- * Returns: New buffer.
+ * Fill in the (Simple)Block header of a buffer.
  */
-static GstBuffer *
-gst_matroska_mux_create_buffer_header (GstMatroskaTrackContext * track,
-    gint16 relative_timestamp, int flags)
+static void
+gst_matroska_mux_fill_buffer_header (GstMatroskaTrackContext * track,
+    gint16 relative_timestamp, int flags, guint8 * hdr)
 {
-  GstBuffer *hdr;
-
-  hdr = gst_buffer_new_and_alloc (4);
   /* track num - FIXME: what if num >= 0x80 (unlikely)? */
-  GST_BUFFER_DATA (hdr)[0] = track->num | 0x80;
+  hdr[0] = track->num | 0x80;
   /* time relative to clustertime */
-  GST_WRITE_UINT16_BE (GST_BUFFER_DATA (hdr) + 1, relative_timestamp);
+  GST_WRITE_UINT16_BE (hdr + 1, relative_timestamp);
 
   /* flags */
-  GST_BUFFER_DATA (hdr)[3] = flags;
-
-  return hdr;
+  hdr[3] = flags;
 }
 
 #define DIRAC_PARSE_CODE_SEQUENCE_HEADER 0x00
@@ -2869,6 +2902,40 @@ gst_matroska_mux_stop_streamheader (GstMatroskaMux * mux)
   gst_caps_unref (caps);
 }
 
+/**
+ * gst_matroska_mux_thin_index:
+ * @mux: #GstMatroskaMux
+ *
+ * Drop every other index entry and double the minimum distance between
+ * subsequent entries, so that the index of a long (live) recording stays
+ * within #GstMatroskaMux:max-index-entries while still covering the
+ * whole file evenly.
+ */
+static void
+gst_matroska_mux_thin_index (GstMatroskaMux * mux)
+{
+  GstClockTimeDiff span;
+  guint n, kept, num;
+
+  num = mux->num_indexes;
+  if (num < 2)
+    return;
+
+  span = GST_CLOCK_DIFF (mux->index[0].time, mux->index[num - 1].time);
+
+  for (n = 0, kept = 0; n < num; n += 2)
+    mux->index[kept++] = mux->index[n];
+
+  mux->num_indexes = kept;
+
+  /* at least double the average distance of the entries we had */
+  mux->index_interval = MAX (mux->index_interval * 2,
+      2 * span / (GstClockTimeDiff) (num - 1));
+
+  GST_DEBUG_OBJECT (mux, "thinned index to %u entries, interval now %"
+      GST_TIME_FORMAT, mux->num_indexes, GST_TIME_ARGS (mux->index_interval));
+}
+
 /**
  * gst_matroska_mux_write_data:
  * @mux: #GstMatroskaMux
@@ -2883,7 +2950,7 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
     GstBuffer * buf)
 {
   GstEbmlWrite *ebml = mux->ebml_write;
-  GstBuffer *hdr;
+  guint8 hdr[BLOCK_HEADER_SIZE];
   guint64 blockgroup;
   gboolean write_duration;
   gint16 relative_timestamp;
@@ -2933,18 +3000,34 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
     is_video_keyframe = TRUE;
   }
 
+  if (mux->buffer_list)
+    gst_ebml_write_start_buffer_list (ebml);
+
   if (mux->cluster) {
+    guint64 max_duration = mux->max_cluster_duration;
+
+    if (mux->max_cluster_duration_prop > 0)
+      max_duration = MIN (max_duration, mux->max_cluster_duration_prop);
+
     /* start a new cluster at every keyframe, at every GstForceKeyUnit event,
-     * or when we may be reaching the limit of the relative timestamp */
-    if (mux->cluster_time +
-        mux->max_cluster_duration < GST_BUFFER_TIMESTAMP (buf)
+     * when we may be reaching the limit of the relative timestamp, or when
+     * the configured cluster duration or size has been exceeded */
+    if (mux->cluster_time + max_duration < GST_BUFFER_TIMESTAMP (buf)
+        || (mux->max_cluster_size > 0 &&
+            ebml->pos - mux->cluster_pos >= mux->max_cluster_size)
         || is_video_keyframe || mux->force_key_unit_event) {
       if (!mux->streamable)
         gst_ebml_write_master_finish (ebml, mux->cluster);
 
       /* Forward the GstForceKeyUnit event after finishing the cluster */
       if (mux->force_key_unit_event) {
-        gst_pad_push_event (mux->srcpad, mux->force_key_unit_event);
+        if (ebml->buffer_list) {
+          gst_ebml_write_flush_buffer_list (ebml);
+          gst_pad_push_event (mux->srcpad, mux->force_key_unit_event);
+          gst_ebml_write_start_buffer_list (ebml);
+        } else {
+          gst_pad_push_event (mux->srcpad, mux->force_key_unit_event);
+        }
         mux->force_key_unit_event = NULL;
       }
 
@@ -2993,19 +3076,26 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
           ((collect_pad->track->type == GST_MATROSKA_TRACK_TYPE_AUDIO) &&
               (mux->num_streams == 1)))) {
     gint last_idx = -1;
+    GstClockTimeDiff interval;
 
-    if (mux->min_index_interval != 0) {
+    interval = MAX (mux->min_index_interval, mux->index_interval);
+
+    if (interval != 0) {
       for (last_idx = mux->num_indexes - 1; last_idx >= 0; last_idx--) {
         if (mux->index[last_idx].track == collect_pad->track->num)
           break;
       }
     }
 
-    if (last_idx < 0 || mux->min_index_interval == 0 ||
+    if (last_idx < 0 || interval == 0 ||
         (GST_CLOCK_DIFF (mux->index[last_idx].time, GST_BUFFER_TIMESTAMP (buf))
-            >= mux->min_index_interval)) {
+            >= interval)) {
       GstMatroskaIndex *idx;
 
+      if (mux->max_index_entries > 0 &&
+          mux->num_indexes >= mux->max_index_entries)
+        gst_matroska_mux_thin_index (mux);
+
       if (mux->num_indexes % 32 == 0) {
         mux->index = g_renew (GstMatroskaIndex, mux->index,
             mux->num_indexes + 32);
@@ -3049,36 +3139,32 @@ gst_matroska_mux_write_data (GstMatroskaMux * mux, GstMatroskaPad * collect_pad,
     int flags =
         GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT) ? 0 : 0x80;
 
-    hdr =
-        gst_matroska_mux_create_buffer_header (collect_pad->track,
-        relative_timestamp, flags);
-    gst_ebml_write_set_cache (ebml, 0x40);
-    gst_ebml_write_buffer_header (ebml, GST_MATROSKA_ID_SIMPLEBLOCK,
-        GST_BUFFER_SIZE (buf) + GST_BUFFER_SIZE (hdr));
-    gst_ebml_write_buffer (ebml, hdr);
-    gst_ebml_write_flush_cache (ebml, FALSE, GST_BUFFER_TIMESTAMP (buf));
+    /* element and block header go out in one small buffer,
+     * the payload follows without being copied */
+    gst_matroska_mux_fill_buffer_header (collect_pad->track,
+        relative_timestamp, flags, hdr);
+    gst_ebml_write_block_header (ebml, GST_MATROSKA_ID_SIMPLEBLOCK,
+        GST_BUFFER_SIZE (buf), hdr, BLOCK_HEADER_SIZE);
     gst_ebml_write_buffer (ebml, buf);
-
-    return gst_ebml_last_write_result (ebml);
   } else {
-    gst_ebml_write_set_cache (ebml, GST_BUFFER_SIZE (buf) * 2);
+    gst_ebml_write_set_cache (ebml, 0x40);
     /* write and call order slightly unnatural,
      * but avoids seek and minizes pushing */
     blockgroup = gst_ebml_write_master_start (ebml, GST_MATROSKA_ID_BLOCKGROUP);
-    hdr =
-        gst_matroska_mux_create_buffer_header (collect_pad->track,
-        relative_timestamp, 0);
+    gst_matroska_mux_fill_buffer_header (collect_pad->track,
+        relative_timestamp, 0, hdr);
     if (write_duration)
       gst_ebml_write_uint (ebml, GST_MATROSKA_ID_BLOCKDURATION, block_duration);
-    gst_ebml_write_buffer_header (ebml, GST_MATROSKA_ID_BLOCK,
-        GST_BUFFER_SIZE (buf) + GST_BUFFER_SIZE (hdr));
-    gst_ebml_write_buffer (ebml, hdr);
+    gst_ebml_write_block_header (ebml, GST_MATROSKA_ID_BLOCK,
+        GST_BUFFER_SIZE (buf), hdr, BLOCK_HEADER_SIZE);
     gst_ebml_write_master_finish_full (ebml, blockgroup, GST_BUFFER_SIZE (buf));
     gst_ebml_write_flush_cache (ebml, FALSE, GST_BUFFER_TIMESTAMP (buf));
     gst_ebml_write_buffer (ebml, buf);
-
-    return gst_ebml_last_write_result (ebml);
   }
+
+  gst_ebml_write_flush_buffer_list (ebml);
+
+  return gst_ebml_last_write_result (ebml);
 }
 
 /**
@@ -3240,6 +3326,18 @@ gst_matroska_mux_set_property (GObject * object,
     case ARG_STREAMABLE:
       mux->streamable = g_value_get_boolean (value);
       break;
+    case ARG_MAX_CLUSTER_DURATION:
+      mux->max_cluster_duration_prop = g_value_get_int64 (value);
+      break;
+    case ARG_MAX_CLUSTER_SIZE:
+      mux->max_cluster_size = g_value_get_uint (value);
+      break;
+    case ARG_MAX_INDEX_ENTRIES:
+      mux->max_index_entries = g_value_get_uint (value);
+      break;
+    case ARG_BUFFER_LIST:
+      mux->buffer_list = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3268,6 +3366,18 @@ gst_matroska_mux_get_property (GObject * object,
     case ARG_STREAMABLE:
       g_value_set_boolean (value, mux->streamable);
       break;
+    case ARG_MAX_CLUSTER_DURATION:
+      g_value_set_int64 (value, mux->max_cluster_duration_prop);
+      break;
+    case ARG_MAX_CLUSTER_SIZE:
+      g_value_set_uint (value, mux->max_cluster_size);
+      break;
+    case ARG_MAX_INDEX_ENTRIES:
+      g_value_set_uint (value, mux->max_index_entries);
+      break;
+    case ARG_BUFFER_LIST:
+      g_value_set_boolean (value, mux->buffer_list);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
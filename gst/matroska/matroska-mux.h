@@ -97,11 +97,18 @@ typedef struct _GstMatroskaMux {
   guint          num_indexes;
   GstClockTimeDiff min_index_interval;
   gboolean       streamable;
+  gboolean       buffer_list;
+  guint          max_index_entries;
+  /* interval enforced after thinning the index (on top of the minimum) */
+  GstClockTimeDiff index_interval;
  
   /* timescale in the file */
   guint64        time_scale;
   /* based on timescale, limit of nanoseconds you can have in a cluster */ 
   guint64        max_cluster_duration;
+  /* user configured limits for a cluster (0 = unlimited) */
+  gint64         max_cluster_duration_prop;
+  guint          max_cluster_size;
 
   /* length, position (time, ns) */
   guint64        duration;
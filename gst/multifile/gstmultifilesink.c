@@ -96,11 +96,22 @@
  * </listitem>
  * </itemizedlist>
  *
+ * If the #GstMultiFileSink:async-write property is #TRUE, the files are
+ * opened, written and closed by a separate I/O thread, so that slow storage
+ * does not stall the streaming thread. The streaming thread only blocks when
+ * more than #GstMultiFileSink:max-queue-size bytes are waiting to be written.
+ * Consecutive buffers are written with one system call, the next file is
+ * opened ahead of time and finished files are closed (and optionally synced
+ * to disk) without blocking the pipeline. The messages described above are
+ * posted by the I/O thread in this mode, after everything that was queued
+ * before them was done.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
  * gst-launch audiotestsrc ! multifilesink
  * gst-launch videotestsrc ! multifilesink post-messages=true filename="frame%d"
+ * gst-launch v4l2src ! jpegenc ! multifilesink async-write=true fsync=true location="frame%05d.jpg"
  * ]|
  * </refsect2>
  *
@@ -115,6 +126,15 @@
 #include <glib/gstdio.h>
 #include "gstmultifilesink.h"
 
+#include <fcntl.h>
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY (0)
+#endif
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -129,6 +149,18 @@ GST_DEBUG_CATEGORY_STATIC (gst_multi_file_sink_debug);
 #define DEFAULT_NEXT_FILE GST_MULTI_FILE_SINK_NEXT_BUFFER
 #define DEFAULT_MAX_FILES 0
 #define DEFAULT_MAX_FILE_SIZE G_GUINT64_CONSTANT(2*1024*1024*1024)
+#define DEFAULT_ASYNC_WRITE FALSE
+#define DEFAULT_MAX_QUEUE_SIZE (8 * 1024 * 1024)
+#define DEFAULT_DIRECT_IO FALSE
+#define DEFAULT_PREALLOCATE 0
+#define DEFAULT_FSYNC FALSE
+
+/* at most this many buffers are written with one system call */
+#define IO_MAX_BATCH 64
+
+/* direct I/O needs aligned memory, offsets and sizes */
+#define DIRECT_IO_ALIGN 4096
+#define DIRECT_IO_SIZE (1024 * 1024)
 
 enum
 {
@@ -139,6 +171,15 @@ enum
   PROP_NEXT_FILE,
   PROP_MAX_FILES,
   PROP_MAX_FILE_SIZE,
+  PROP_ASYNC_WRITE,
+  PROP_MAX_QUEUE_SIZE,
+  PROP_DIRECT_IO,
+  PROP_PREALLOCATE,
+  PROP_FSYNC,
+  PROP_QUEUE_LEVEL,
+  PROP_MAX_QUEUE_LEVEL,
+  PROP_WRITE_LATENCY,
+  PROP_MAX_WRITE_LATENCY,
   PROP_LAST
 };
 
@@ -149,7 +190,10 @@ static void gst_multi_file_sink_set_property (GObject * object, guint prop_id,
 static void gst_multi_file_sink_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
+static gboolean gst_multi_file_sink_start (GstBaseSink * sink);
 static gboolean gst_multi_file_sink_stop (GstBaseSink * sink);
+static gboolean gst_multi_file_sink_unlock (GstBaseSink * sink);
+static gboolean gst_multi_file_sink_unlock_stop (GstBaseSink * sink);
 static GstFlowReturn gst_multi_file_sink_render (GstBaseSink * sink,
     GstBuffer * buffer);
 static GstFlowReturn gst_multi_file_sink_render_list (GstBaseSink * sink,
@@ -158,12 +202,16 @@ static gboolean gst_multi_file_sink_set_caps (GstBaseSink * sink,
     GstCaps * caps);
 static gboolean gst_multi_file_sink_open_next_file (GstMultiFileSink *
     multifilesink);
-static void gst_multi_file_sink_close_file (GstMultiFileSink * multifilesink,
-    GstBuffer * buffer);
-static void gst_multi_file_sink_ensure_max_files (GstMultiFileSink *
+static gboolean gst_multi_file_sink_close_file (GstMultiFileSink *
+    multifilesink, GstBuffer * buffer);
+static gboolean gst_multi_file_sink_ensure_max_files (GstMultiFileSink *
     multifilesink);
 static gboolean gst_multi_file_sink_event (GstBaseSink * sink,
     GstEvent * event);
+static gboolean gst_multi_file_sink_write_buffer (GstMultiFileSink *
+    multifilesink, GstBuffer * buffer);
+static void gst_multi_file_sink_post (GstMultiFileSink * multifilesink,
+    GstMessage * message);
 
 #define GST_TYPE_MULTI_FILE_SINK_NEXT (gst_multi_file_sink_next_get_type ())
 static GType
@@ -283,10 +331,137 @@ gst_multi_file_sink_class_init (GstMultiFileSinkClass * klass)
           0, G_MAXUINT64, DEFAULT_MAX_FILE_SIZE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMultiFileSink:async-write
+   *
+   * Open, write and close the files in a separate I/O thread.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_ASYNC_WRITE,
+      g_param_spec_boolean ("async-write", "Asynchronous Write",
+          "Open, write and close the files in a separate I/O thread",
+          DEFAULT_ASYNC_WRITE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstMultiFileSink:max-queue-size
+   *
+   * Maximum number of bytes waiting for the I/O thread before rendering
+   * blocks in async-write mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_SIZE,
+      g_param_spec_uint64 ("max-queue-size", "Maximum Queue Size",
+          "Maximum number of bytes waiting for the I/O thread before "
+          "rendering blocks in async-write mode",
+          0, G_MAXUINT64, DEFAULT_MAX_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:direct-io
+   *
+   * Bypass the page cache of the operating system in async-write mode, if
+   * the file system supports it.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_DIRECT_IO,
+      g_param_spec_boolean ("direct-io", "Direct I/O",
+          "Bypass the page cache in async-write mode, if the file system "
+          "supports it", DEFAULT_DIRECT_IO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstMultiFileSink:preallocate
+   *
+   * Number of bytes to reserve on disk for each new file in async-write
+   * mode, to avoid fragmentation. The files are truncated to their real
+   * size when they are closed. 0 disables preallocation.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_PREALLOCATE,
+      g_param_spec_uint64 ("preallocate", "Preallocate",
+          "Number of bytes to reserve on disk for each new file in "
+          "async-write mode (0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_PREALLOCATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:fsync
+   *
+   * Make sure that each file is on disk before it is closed and the
+   * message for it is posted in async-write mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_FSYNC,
+      g_param_spec_boolean ("fsync", "Sync",
+          "Flush each file to disk before closing it in async-write mode",
+          DEFAULT_FSYNC, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:queue-level
+   *
+   * Number of bytes currently waiting for the I/O thread.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_QUEUE_LEVEL,
+      g_param_spec_uint64 ("queue-level", "Queue Level",
+          "Number of bytes currently waiting for the I/O thread",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:max-queue-level
+   *
+   * Highest number of bytes that were waiting for the I/O thread since the
+   * element was started.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_LEVEL,
+      g_param_spec_uint64 ("max-queue-level", "Maximum Queue Level",
+          "Highest number of bytes that were waiting for the I/O thread",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:write-latency
+   *
+   * Time between queueing and writing of the last buffer in async-write
+   * mode, in nanoseconds.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_WRITE_LATENCY,
+      g_param_spec_uint64 ("write-latency", "Write Latency",
+          "Time between queueing and writing of the last buffer (in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiFileSink:max-write-latency
+   *
+   * Longest time between queueing and writing of a buffer in async-write
+   * mode since the element was started, in nanoseconds.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_WRITE_LATENCY,
+      g_param_spec_uint64 ("max-write-latency", "Maximum Write Latency",
+          "Longest time between queueing and writing of a buffer (in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->finalize = gst_multi_file_sink_finalize;
 
   gstbasesink_class->get_times = NULL;
+  gstbasesink_class->start = GST_DEBUG_FUNCPTR (gst_multi_file_sink_start);
   gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_multi_file_sink_stop);
+  gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_multi_file_sink_unlock);
+  gstbasesink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_multi_file_sink_unlock_stop);
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_multi_file_sink_render);
   gstbasesink_class->render_list =
       GST_DEBUG_FUNCPTR (gst_multi_file_sink_render_list);
@@ -306,6 +481,17 @@ gst_multi_file_sink_init (GstMultiFileSink * multifilesink,
   multifilesink->max_file_size = DEFAULT_MAX_FILE_SIZE;
   multifilesink->files = NULL;
   multifilesink->n_files = 0;
+  multifilesink->async_write = DEFAULT_ASYNC_WRITE;
+  multifilesink->max_queue_size = DEFAULT_MAX_QUEUE_SIZE;
+  multifilesink->direct_io = DEFAULT_DIRECT_IO;
+  multifilesink->preallocate = DEFAULT_PREALLOCATE;
+  multifilesink->fsync = DEFAULT_FSYNC;
+
+  multifilesink->io_lock = g_mutex_new ();
+  multifilesink->io_cond = g_cond_new ();
+  multifilesink->io_queue = g_queue_new ();
+  multifilesink->io_fd = -1;
+  multifilesink->io_preopen_fd = -1;
 
   gst_base_sink_set_sync (GST_BASE_SINK (multifilesink), FALSE);
 
@@ -321,6 +507,9 @@ gst_multi_file_sink_finalize (GObject * object)
   g_free (sink->filename);
   g_slist_foreach (sink->files, (GFunc) g_free, NULL);
   g_slist_free (sink->files);
+  g_queue_free (sink->io_queue);
+  g_cond_free (sink->io_cond);
+  g_mutex_free (sink->io_lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -361,6 +550,24 @@ gst_multi_file_sink_set_property (GObject * object, guint prop_id,
     case PROP_MAX_FILE_SIZE:
       sink->max_file_size = g_value_get_uint64 (value);
       break;
+    case PROP_ASYNC_WRITE:
+      sink->async_write = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_mutex_lock (sink->io_lock);
+      sink->max_queue_size = g_value_get_uint64 (value);
+      g_cond_broadcast (sink->io_cond);
+      g_mutex_unlock (sink->io_lock);
+      break;
+    case PROP_DIRECT_IO:
+      sink->direct_io = g_value_get_boolean (value);
+      break;
+    case PROP_PREALLOCATE:
+      sink->preallocate = g_value_get_uint64 (value);
+      break;
+    case PROP_FSYNC:
+      sink->fsync = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -392,12 +599,620 @@ gst_multi_file_sink_get_property (GObject * object, guint prop_id,
     case PROP_MAX_FILE_SIZE:
       g_value_set_uint64 (value, sink->max_file_size);
       break;
+    case PROP_ASYNC_WRITE:
+      g_value_set_boolean (value, sink->async_write);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_value_set_uint64 (value, sink->max_queue_size);
+      break;
+    case PROP_DIRECT_IO:
+      g_value_set_boolean (value, sink->direct_io);
+      break;
+    case PROP_PREALLOCATE:
+      g_value_set_uint64 (value, sink->preallocate);
+      break;
+    case PROP_FSYNC:
+      g_value_set_boolean (value, sink->fsync);
+      break;
+    case PROP_QUEUE_LEVEL:
+      g_mutex_lock (sink->io_lock);
+      g_value_set_uint64 (value, sink->io_queued);
+      g_mutex_unlock (sink->io_lock);
+      break;
+    case PROP_MAX_QUEUE_LEVEL:
+      g_mutex_lock (sink->io_lock);
+      g_value_set_uint64 (value, sink->io_max_queued);
+      g_mutex_unlock (sink->io_lock);
+      break;
+    case PROP_WRITE_LATENCY:
+      g_mutex_lock (sink->io_lock);
+      g_value_set_uint64 (value, sink->io_latency);
+      g_mutex_unlock (sink->io_lock);
+      break;
+    case PROP_MAX_WRITE_LATENCY:
+      g_mutex_lock (sink->io_lock);
+      g_value_set_uint64 (value, sink->io_max_latency);
+      g_mutex_unlock (sink->io_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+/* Asynchronous writing: the streaming thread turns everything it would do
+ * with the files into operations for the I/O thread, which executes them in
+ * order. Only WRITE operations count towards max-queue-size. */
+typedef enum
+{
+  IO_OP_OPEN,
+  IO_OP_WRITE,
+  IO_OP_CLOSE,
+  IO_OP_REMOVE,
+  IO_OP_MESSAGE,
+  IO_OP_STOP
+} GstMultiFileSinkIOOpType;
+
+typedef struct
+{
+  GstMultiFileSinkIOOpType type;
+  GstClockTime queued;
+
+  /* OPEN: the file to open and the one that will probably be next,
+   * REMOVE: the file to remove */
+  gchar *filename;
+  gchar *next_filename;
+
+  /* WRITE */
+  GstBuffer *buffer;
+
+  /* MESSAGE */
+  GstMessage *message;
+} GstMultiFileSinkIOOp;
+
+static GstMultiFileSinkIOOp *
+gst_multi_file_sink_io_op_new (GstMultiFileSinkIOOpType type)
+{
+  GstMultiFileSinkIOOp *op = g_slice_new0 (GstMultiFileSinkIOOp);
+
+  op->type = type;
+
+  return op;
+}
+
+static void
+gst_multi_file_sink_io_op_free (GstMultiFileSinkIOOp * op)
+{
+  g_free (op->filename);
+  g_free (op->next_filename);
+  if (op->buffer)
+    gst_buffer_unref (op->buffer);
+  if (op->message)
+    gst_message_unref (op->message);
+  g_slice_free (GstMultiFileSinkIOOp, op);
+}
+
+/* Called with the io_lock */
+static void
+gst_multi_file_sink_io_push (GstMultiFileSink * sink, GstMultiFileSinkIOOp * op)
+{
+  op->queued = gst_util_get_timestamp ();
+  g_queue_push_tail (sink->io_queue, op);
+  sink->io_ops++;
+  if (op->buffer) {
+    sink->io_queued += GST_BUFFER_SIZE (op->buffer);
+    if (sink->io_queued > sink->io_max_queued)
+      sink->io_max_queued = sink->io_queued;
+  }
+  g_cond_broadcast (sink->io_cond);
+}
+
+/* Hands @op to the I/O thread, waiting for room in the queue first if it
+ * is a write. Returns FALSE with errno set if the I/O thread failed. */
+static gboolean
+gst_multi_file_sink_io_queue (GstMultiFileSink * sink,
+    GstMultiFileSinkIOOp * op)
+{
+  guint64 size = op->buffer ? GST_BUFFER_SIZE (op->buffer) : 0;
+  gint err;
+
+  g_mutex_lock (sink->io_lock);
+  /* a buffer larger than the queue still goes in once the queue is empty,
+   * and when flushing we must not block at all */
+  while (size > 0 && sink->io_queued > 0 &&
+      sink->io_queued + size > sink->max_queue_size &&
+      !sink->io_flushing && sink->io_errno == 0) {
+    GST_LOG_OBJECT (sink, "queue full (%" G_GUINT64_FORMAT " bytes), waiting",
+        sink->io_queued);
+    g_cond_wait (sink->io_cond, sink->io_lock);
+  }
+
+  if (G_UNLIKELY (sink->io_errno != 0))
+    goto io_error;
+
+  gst_multi_file_sink_io_push (sink, op);
+  g_mutex_unlock (sink->io_lock);
+
+  return TRUE;
+
+  /* ERRORS */
+io_error:
+  {
+    err = sink->io_errno;
+    g_mutex_unlock (sink->io_lock);
+    gst_multi_file_sink_io_op_free (op);
+    errno = err;
+    return FALSE;
+  }
+}
+
+/* Waits until the I/O thread has done everything that was queued */
+static gboolean
+gst_multi_file_sink_io_drain (GstMultiFileSink * sink)
+{
+  gint err;
+
+  g_mutex_lock (sink->io_lock);
+  while (sink->io_ops > 0 && !sink->io_flushing && sink->io_errno == 0)
+    g_cond_wait (sink->io_cond, sink->io_lock);
+  err = sink->io_errno;
+  g_mutex_unlock (sink->io_lock);
+
+  if (err != 0) {
+    errno = err;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* The I/O thread only keeps the first error, the streaming thread reports
+ * it the next time it queues something */
+static void
+gst_multi_file_sink_io_error (GstMultiFileSink * sink, const gchar * what)
+{
+  gint err = errno;
+
+  GST_WARNING_OBJECT (sink, "%s failed: %s", what, g_strerror (err));
+
+  g_mutex_lock (sink->io_lock);
+  if (sink->io_errno == 0)
+    sink->io_errno = err ? err : EIO;
+  g_cond_broadcast (sink->io_cond);
+  g_mutex_unlock (sink->io_lock);
+}
+
+static gboolean
+gst_multi_file_sink_io_write_all (gint fd, const guint8 * data, gsize size)
+{
+  gssize ret;
+
+  while (size > 0) {
+    ret = write (fd, data, size);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    data += ret;
+    size -= ret;
+  }
+
+  return TRUE;
+}
+
+#ifdef HAVE_SYS_UIO_H
+static gboolean
+gst_multi_file_sink_io_writev_all (gint fd, struct iovec *iov, gint n_iov)
+{
+  gssize ret;
+
+  while (n_iov > 0) {
+    ret = writev (fd, iov, n_iov);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    /* skip what was written, writev may stop in the middle of a buffer */
+    while (n_iov > 0 && (gsize) ret >= iov->iov_len) {
+      ret -= iov->iov_len;
+      iov++;
+      n_iov--;
+    }
+    if (n_iov > 0) {
+      iov->iov_base = (guint8 *) iov->iov_base + ret;
+      iov->iov_len -= ret;
+    }
+  }
+
+  return TRUE;
+}
+#endif
+
+/* With direct I/O the data goes through an aligned staging buffer that is
+ * only written out in full */
+static gboolean
+gst_multi_file_sink_io_write_direct (GstMultiFileSink * sink,
+    const guint8 * data, gsize size)
+{
+  guint n;
+
+  while (size > 0) {
+    n = MIN (size, DIRECT_IO_SIZE - sink->io_direct_fill);
+    memcpy (sink->io_direct_buf + sink->io_direct_fill, data, n);
+    sink->io_direct_fill += n;
+    data += n;
+    size -= n;
+
+    if (sink->io_direct_fill == DIRECT_IO_SIZE) {
+      if (!gst_multi_file_sink_io_write_all (sink->io_fd, sink->io_direct_buf,
+              DIRECT_IO_SIZE))
+        return FALSE;
+      sink->io_direct_fill = 0;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Writes the buffers of @n consecutive WRITE operations to the current
+ * file, with a single system call if possible */
+static void
+gst_multi_file_sink_io_write_batch (GstMultiFileSink * sink,
+    GstMultiFileSinkIOOp ** batch, guint n)
+{
+  GstClockTime now;
+  guint64 size = 0;
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < n; i++)
+    size += GST_BUFFER_SIZE (batch[i]->buffer);
+
+  /* nothing to write to after an error */
+  if (sink->io_fd >= 0) {
+    if (sink->io_direct) {
+      for (i = 0; i < n && ret; i++)
+        ret = gst_multi_file_sink_io_write_direct (sink,
+            GST_BUFFER_DATA (batch[i]->buffer),
+            GST_BUFFER_SIZE (batch[i]->buffer));
+    } else {
+#ifdef HAVE_SYS_UIO_H
+      struct iovec iov[IO_MAX_BATCH];
+
+      for (i = 0; i < n; i++) {
+        iov[i].iov_base = GST_BUFFER_DATA (batch[i]->buffer);
+        iov[i].iov_len = GST_BUFFER_SIZE (batch[i]->buffer);
+      }
+      ret = gst_multi_file_sink_io_writev_all (sink->io_fd, iov, n);
+#else
+      for (i = 0; i < n && ret; i++)
+        ret = gst_multi_file_sink_io_write_all (sink->io_fd,
+            GST_BUFFER_DATA (batch[i]->buffer),
+            GST_BUFFER_SIZE (batch[i]->buffer));
+#endif
+    }
+
+    if (ret) {
+      sink->io_written += size;
+      GST_LOG_OBJECT (sink, "wrote %u buffers, %" G_GUINT64_FORMAT " bytes",
+          n, size);
+    } else {
+      gst_multi_file_sink_io_error (sink, "write");
+    }
+  }
+
+  now = gst_util_get_timestamp ();
+
+  g_mutex_lock (sink->io_lock);
+  sink->io_queued -= size;
+  sink->io_ops -= n;
+  /* the first buffer of the batch waited longest */
+  sink->io_max_latency = MAX (sink->io_max_latency, now - batch[0]->queued);
+  sink->io_latency = now - batch[n - 1]->queued;
+  g_cond_broadcast (sink->io_cond);
+  g_mutex_unlock (sink->io_lock);
+
+  for (i = 0; i < n; i++)
+    gst_multi_file_sink_io_op_free (batch[i]);
+}
+
+static gint
+gst_multi_file_sink_io_open_fd (GstMultiFileSink * sink,
+    const gchar * filename, gint flags)
+{
+  gint fd = -1;
+
+  flags |= O_WRONLY | O_CREAT | O_BINARY;
+
+#ifdef O_DIRECT
+  if (sink->direct_io) {
+    fd = g_open (filename, flags | O_DIRECT, 0666);
+    /* not every file system supports direct I/O */
+    if (fd < 0 && errno == EINVAL)
+      GST_INFO_OBJECT (sink, "no direct I/O for %s", filename);
+  }
+#endif
+  if (fd < 0)
+    fd = g_open (filename, flags, 0666);
+
+#ifdef HAVE_POSIX_FALLOCATE
+  if (fd >= 0 && sink->preallocate > 0) {
+    gint err = posix_fallocate (fd, 0, sink->preallocate);
+
+    if (err != 0)
+      GST_INFO_OBJECT (sink, "could not preallocate %s: %s", filename,
+          g_strerror (err));
+  }
+#endif
+
+  return fd;
+}
+
+static void
+gst_multi_file_sink_io_drop_preopened (GstMultiFileSink * sink)
+{
+  if (sink->io_preopen_fd < 0)
+    return;
+
+  /* we created it with O_EXCL, so nobody else is using it */
+  GST_DEBUG_OBJECT (sink, "removing unused file %s", sink->io_preopen_name);
+  close (sink->io_preopen_fd);
+  g_unlink (sink->io_preopen_name);
+  g_free (sink->io_preopen_name);
+  sink->io_preopen_name = NULL;
+  sink->io_preopen_fd = -1;
+}
+
+/* Creates the file that will most likely be opened next, so that opening it
+ * later only takes a string compare. Existing files are left alone. */
+static void
+gst_multi_file_sink_io_preopen (GstMultiFileSink * sink, gchar * filename)
+{
+  if (sink->io_preopen_fd >= 0) {
+    g_free (filename);
+    return;
+  }
+
+  sink->io_preopen_fd =
+      gst_multi_file_sink_io_open_fd (sink, filename, O_EXCL);
+  if (sink->io_preopen_fd < 0) {
+    g_free (filename);
+    return;
+  }
+
+  GST_DEBUG_OBJECT (sink, "opened %s ahead of time", filename);
+  sink->io_preopen_name = filename;
+}
+
+static void
+gst_multi_file_sink_io_open (GstMultiFileSink * sink, const gchar * filename)
+{
+  if (sink->io_preopen_fd >= 0 &&
+      strcmp (sink->io_preopen_name, filename) == 0) {
+    sink->io_fd = sink->io_preopen_fd;
+    g_free (sink->io_preopen_name);
+    sink->io_preopen_name = NULL;
+    sink->io_preopen_fd = -1;
+  } else {
+    gst_multi_file_sink_io_drop_preopened (sink);
+    sink->io_fd = gst_multi_file_sink_io_open_fd (sink, filename, O_TRUNC);
+  }
+
+  if (sink->io_fd < 0) {
+    gst_multi_file_sink_io_error (sink, "open");
+    return;
+  }
+
+  GST_INFO_OBJECT (sink, "opened file %s", filename);
+  sink->io_written = 0;
+  sink->io_direct_fill = 0;
+#ifdef O_DIRECT
+  sink->io_direct = (fcntl (sink->io_fd, F_GETFL) & O_DIRECT) != 0;
+#endif
+}
+
+static void
+gst_multi_file_sink_io_close (GstMultiFileSink * sink)
+{
+  if (sink->io_fd < 0)
+    return;
+
+#ifdef O_DIRECT
+  /* the rest of the staging buffer is not a multiple of the alignment */
+  if (sink->io_direct && sink->io_direct_fill > 0) {
+    fcntl (sink->io_fd, F_SETFL, fcntl (sink->io_fd, F_GETFL) & ~O_DIRECT);
+    if (!gst_multi_file_sink_io_write_all (sink->io_fd, sink->io_direct_buf,
+            sink->io_direct_fill))
+      gst_multi_file_sink_io_error (sink, "write");
+    sink->io_direct_fill = 0;
+  }
+#endif
+
+#ifdef HAVE_POSIX_FALLOCATE
+  /* cut off what was reserved but not used */
+  if (sink->preallocate > sink->io_written &&
+      ftruncate (sink->io_fd, sink->io_written) < 0)
+    gst_multi_file_sink_io_error (sink, "truncate");
+#endif
+
+#ifdef HAVE_FSYNC
+  if (sink->fsync && fsync (sink->io_fd) < 0)
+    gst_multi_file_sink_io_error (sink, "fsync");
+#endif
+
+  if (close (sink->io_fd) < 0)
+    gst_multi_file_sink_io_error (sink, "close");
+  sink->io_fd = -1;
+}
+
+static gpointer
+gst_multi_file_sink_io_thread (GstMultiFileSink * sink)
+{
+  GstMultiFileSinkIOOp *batch[IO_MAX_BATCH];
+  GstMultiFileSinkIOOp *op;
+  GQueue ops = G_QUEUE_INIT;
+  gchar *next_filename = NULL;
+  gboolean running = TRUE;
+  guint n = 0;
+
+  GST_DEBUG_OBJECT (sink, "I/O thread started");
+
+  if (sink->direct_io) {
+    sink->io_direct_mem = g_malloc (DIRECT_IO_SIZE + DIRECT_IO_ALIGN);
+    sink->io_direct_buf = (guint8 *) GSIZE_TO_POINTER
+        ((GPOINTER_TO_SIZE (sink->io_direct_mem) + DIRECT_IO_ALIGN - 1) &
+        ~(gsize) (DIRECT_IO_ALIGN - 1));
+  }
+
+  while (running) {
+    /* take everything that was queued since the last round */
+    g_mutex_lock (sink->io_lock);
+    while (g_queue_is_empty (sink->io_queue))
+      g_cond_wait (sink->io_cond, sink->io_lock);
+    ops = *sink->io_queue;
+    g_queue_init (sink->io_queue);
+    g_mutex_unlock (sink->io_lock);
+
+    while ((op = g_queue_pop_head (&ops))) {
+      if (op->type == IO_OP_WRITE) {
+        batch[n++] = op;
+        if (n == IO_MAX_BATCH) {
+          gst_multi_file_sink_io_write_batch (sink, batch, n);
+          n = 0;
+        }
+        continue;
+      }
+
+      if (n > 0) {
+        gst_multi_file_sink_io_write_batch (sink, batch, n);
+        n = 0;
+      }
+
+      switch (op->type) {
+        case IO_OP_OPEN:
+          gst_multi_file_sink_io_open (sink, op->filename);
+          g_free (next_filename);
+          next_filename = op->next_filename;
+          op->next_filename = NULL;
+          break;
+        case IO_OP_CLOSE:
+          gst_multi_file_sink_io_close (sink);
+          break;
+        case IO_OP_REMOVE:
+          g_remove (op->filename);
+          break;
+        case IO_OP_MESSAGE:
+          gst_element_post_message (GST_ELEMENT_CAST (sink), op->message);
+          op->message = NULL;
+          break;
+        case IO_OP_STOP:
+          running = FALSE;
+          break;
+        default:
+          g_assert_not_reached ();
+      }
+
+      g_mutex_lock (sink->io_lock);
+      sink->io_ops--;
+      g_cond_broadcast (sink->io_cond);
+      g_mutex_unlock (sink->io_lock);
+
+      gst_multi_file_sink_io_op_free (op);
+    }
+
+    if (n > 0) {
+      gst_multi_file_sink_io_write_batch (sink, batch, n);
+      n = 0;
+    }
+
+    /* nothing else to do right now, prepare the next file */
+    if (running && next_filename) {
+      gst_multi_file_sink_io_preopen (sink, next_filename);
+      next_filename = NULL;
+    }
+  }
+
+  gst_multi_file_sink_io_close (sink);
+  gst_multi_file_sink_io_drop_preopened (sink);
+  g_free (next_filename);
+
+  g_free (sink->io_direct_mem);
+  sink->io_direct_mem = NULL;
+  sink->io_direct_buf = NULL;
+  sink->io_direct = FALSE;
+
+  GST_DEBUG_OBJECT (sink, "I/O thread stopped");
+
+  return NULL;
+}
+
+static gboolean
+gst_multi_file_sink_start (GstBaseSink * sink)
+{
+  GstMultiFileSink *multifilesink = GST_MULTI_FILE_SINK (sink);
+  GError *error = NULL;
+
+  if (!multifilesink->async_write)
+    return TRUE;
+
+  multifilesink->io_queued = 0;
+  multifilesink->io_ops = 0;
+  multifilesink->io_errno = 0;
+  multifilesink->io_flushing = FALSE;
+  multifilesink->io_max_queued = 0;
+  multifilesink->io_latency = 0;
+  multifilesink->io_max_latency = 0;
+
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+  multifilesink->io_thread =
+      g_thread_create ((GThreadFunc) gst_multi_file_sink_io_thread,
+      multifilesink, TRUE, &error);
+#else
+  multifilesink->io_thread = g_thread_try_new ("multifilesink-io",
+      (GThreadFunc) gst_multi_file_sink_io_thread, multifilesink, &error);
+#endif
+
+  if (multifilesink->io_thread == NULL)
+    goto no_thread;
+
+  return TRUE;
+
+  /* ERRORS */
+no_thread:
+  {
+    GST_ELEMENT_ERROR (multifilesink, RESOURCE, FAILED,
+        ("Could not create the I/O thread."), ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_multi_file_sink_unlock (GstBaseSink * sink)
+{
+  GstMultiFileSink *multifilesink = GST_MULTI_FILE_SINK (sink);
+
+  g_mutex_lock (multifilesink->io_lock);
+  multifilesink->io_flushing = TRUE;
+  g_cond_broadcast (multifilesink->io_cond);
+  g_mutex_unlock (multifilesink->io_lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_multi_file_sink_unlock_stop (GstBaseSink * sink)
+{
+  GstMultiFileSink *multifilesink = GST_MULTI_FILE_SINK (sink);
+
+  g_mutex_lock (multifilesink->io_lock);
+  multifilesink->io_flushing = FALSE;
+  g_mutex_unlock (multifilesink->io_lock);
+
+  return TRUE;
+}
+
 static gboolean
 gst_multi_file_sink_stop (GstBaseSink * sink)
 {
@@ -406,10 +1221,20 @@ gst_multi_file_sink_stop (GstBaseSink * sink)
 
   multifilesink = GST_MULTI_FILE_SINK (sink);
 
-  if (multifilesink->file != NULL) {
+  if (multifilesink->io_thread) {
+    /* the I/O thread closes the current file before it exits */
+    g_mutex_lock (multifilesink->io_lock);
+    gst_multi_file_sink_io_push (multifilesink,
+        gst_multi_file_sink_io_op_new (IO_OP_STOP));
+    g_mutex_unlock (multifilesink->io_lock);
+
+    g_thread_join (multifilesink->io_thread);
+    multifilesink->io_thread = NULL;
+  } else if (multifilesink->file != NULL) {
     fclose (multifilesink->file);
     multifilesink->file = NULL;
   }
+  multifilesink->file_open = FALSE;
 
   if (multifilesink->streamheaders) {
     for (i = 0; i < multifilesink->n_streamheaders; i++) {
@@ -446,10 +1271,27 @@ gst_multi_file_sink_post_message_full (GstMultiFileSink * multifilesink,
       "offset", G_TYPE_UINT64, offset,
       "offset-end", G_TYPE_UINT64, offset_end, NULL);
 
-  gst_element_post_message (GST_ELEMENT_CAST (multifilesink),
+  gst_multi_file_sink_post (multifilesink,
       gst_message_new_element (GST_OBJECT_CAST (multifilesink), s));
 }
 
+/* In async-write mode the I/O thread posts the message once it is done
+ * with everything queued before it */
+static void
+gst_multi_file_sink_post (GstMultiFileSink * multifilesink,
+    GstMessage * message)
+{
+  GstMultiFileSinkIOOp *op;
+
+  if (multifilesink->io_thread) {
+    op = gst_multi_file_sink_io_op_new (IO_OP_MESSAGE);
+    op->message = message;
+    gst_multi_file_sink_io_queue (multifilesink, op);
+  } else {
+    gst_element_post_message (GST_ELEMENT_CAST (multifilesink), message);
+  }
+}
+
 
 static void
 gst_multi_file_sink_post_message (GstMultiFileSink * multifilesink,
@@ -479,6 +1321,22 @@ gst_multi_file_sink_post_message (GstMultiFileSink * multifilesink,
       offset, offset_end, running_time, stream_time, filename);
 }
 
+static gboolean
+gst_multi_file_sink_write_buffer (GstMultiFileSink * multifilesink,
+    GstBuffer * buffer)
+{
+  GstMultiFileSinkIOOp *op;
+
+  if (multifilesink->io_thread) {
+    op = gst_multi_file_sink_io_op_new (IO_OP_WRITE);
+    op->buffer = gst_buffer_ref (buffer);
+    return gst_multi_file_sink_io_queue (multifilesink, op);
+  }
+
+  return fwrite (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer), 1,
+      multifilesink->file) == 1;
+}
+
 static gboolean
 gst_multi_file_sink_write_stream_headers (GstMultiFileSink * sink)
 {
@@ -492,13 +1350,10 @@ gst_multi_file_sink_write_stream_headers (GstMultiFileSink * sink)
 
   for (i = 0; i < sink->n_streamheaders; i++) {
     GstBuffer *hdr;
-    int ret;
 
     hdr = sink->streamheaders[i];
 
-    ret = fwrite (GST_BUFFER_DATA (hdr), GST_BUFFER_SIZE (hdr), 1, sink->file);
-
-    if (ret != 1)
+    if (!gst_multi_file_sink_write_buffer (sink, hdr))
       return FALSE;
 
     sink->cur_file_size += GST_BUFFER_SIZE (hdr);
@@ -524,6 +1379,14 @@ gst_multi_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 
   switch (multifilesink->next_file) {
     case GST_MULTI_FILE_SINK_NEXT_BUFFER:
+      if (multifilesink->io_thread) {
+        if (!gst_multi_file_sink_open_next_file (multifilesink) ||
+            !gst_multi_file_sink_write_buffer (multifilesink, buffer) ||
+            !gst_multi_file_sink_close_file (multifilesink, buffer))
+          goto stdio_write_error;
+        break;
+      }
+
       gst_multi_file_sink_ensure_max_files (multifilesink);
 
       filename = g_strdup_printf (multifilesink->filename,
@@ -541,18 +1404,17 @@ gst_multi_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
       break;
     case GST_MULTI_FILE_SINK_NEXT_DISCONT:
       if (GST_BUFFER_IS_DISCONT (buffer)) {
-        if (multifilesink->file)
-          gst_multi_file_sink_close_file (multifilesink, buffer);
+        if (multifilesink->file_open &&
+            !gst_multi_file_sink_close_file (multifilesink, buffer))
+          goto stdio_write_error;
       }
 
-      if (multifilesink->file == NULL) {
+      if (!multifilesink->file_open) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
       }
 
-      ret = fwrite (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer), 1,
-          multifilesink->file);
-      if (ret != 1)
+      if (!gst_multi_file_sink_write_buffer (multifilesink, buffer))
         goto stdio_write_error;
 
       break;
@@ -567,34 +1429,31 @@ gst_multi_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
       if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer) &&
           GST_BUFFER_TIMESTAMP (buffer) >= multifilesink->next_segment &&
           !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
-        if (multifilesink->file)
-          gst_multi_file_sink_close_file (multifilesink, buffer);
+        if (multifilesink->file_open &&
+            !gst_multi_file_sink_close_file (multifilesink, buffer))
+          goto stdio_write_error;
 
         multifilesink->next_segment += 10 * GST_SECOND;
       }
 
-      if (multifilesink->file == NULL) {
+      if (!multifilesink->file_open) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
         gst_multi_file_sink_write_stream_headers (multifilesink);
       }
 
-      ret = fwrite (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer), 1,
-          multifilesink->file);
-      if (ret != 1)
+      if (!gst_multi_file_sink_write_buffer (multifilesink, buffer))
         goto stdio_write_error;
 
       break;
     case GST_MULTI_FILE_SINK_NEXT_KEY_UNIT_EVENT:
-      if (multifilesink->file == NULL) {
+      if (!multifilesink->file_open) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
       }
 
-      ret = fwrite (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer), 1,
-          multifilesink->file);
-      if (ret != 1)
+      if (!gst_multi_file_sink_write_buffer (multifilesink, buffer))
         goto stdio_write_error;
 
       break;
@@ -609,21 +1468,19 @@ gst_multi_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
             multifilesink->cur_file_size, new_size,
             multifilesink->max_file_size);
 
-        if (multifilesink->file != NULL)
-          gst_multi_file_sink_close_file (multifilesink, NULL);
+        if (multifilesink->file_open &&
+            !gst_multi_file_sink_close_file (multifilesink, NULL))
+          goto stdio_write_error;
       }
 
-      if (multifilesink->file == NULL) {
+      if (!multifilesink->file_open) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
 
         gst_multi_file_sink_write_stream_headers (multifilesink);
       }
 
-      ret = fwrite (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer), 1,
-          multifilesink->file);
-
-      if (ret != 1)
+      if (!gst_multi_file_sink_write_buffer (multifilesink, buffer))
         goto stdio_write_error;
 
       multifilesink->cur_file_size += GST_BUFFER_SIZE (buffer);
@@ -760,20 +1617,34 @@ gst_multi_file_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
   return TRUE;
 }
 
-static void
+/* Returns FALSE with errno set if the I/O thread failed */
+static gboolean
 gst_multi_file_sink_ensure_max_files (GstMultiFileSink * multifilesink)
 {
   char *filename;
+  gboolean ret = TRUE;
 
   while (multifilesink->max_files &&
       multifilesink->n_files >= multifilesink->max_files) {
     filename = multifilesink->files->data;
-    g_remove (filename);
-    g_free (filename);
+    if (multifilesink->io_thread) {
+      GstMultiFileSinkIOOp *op;
+
+      op = gst_multi_file_sink_io_op_new (IO_OP_REMOVE);
+      op->filename = filename;
+      ret = gst_multi_file_sink_io_queue (multifilesink, op);
+    } else {
+      g_remove (filename);
+      g_free (filename);
+    }
     multifilesink->files = g_slist_delete_link (multifilesink->files,
         multifilesink->files);
     multifilesink->n_files -= 1;
+    if (!ret)
+      return FALSE;
   }
+
+  return TRUE;
 }
 
 static gboolean
@@ -807,7 +1678,7 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
 
       multifilesink->force_key_unit_count = count;
 
-      if (multifilesink->file) {
+      if (multifilesink->file_open) {
         duration = GST_CLOCK_TIME_NONE;
         offset = offset_end = -1;
         filename = g_strdup_printf (multifilesink->filename,
@@ -817,17 +1688,23 @@ gst_multi_file_sink_event (GstBaseSink * sink, GstEvent * event)
 
         g_free (filename);
 
-        gst_multi_file_sink_close_file (multifilesink, NULL);
-
+        if (!gst_multi_file_sink_close_file (multifilesink, NULL))
+          goto stdio_write_error;
       }
 
-      if (multifilesink->file == NULL) {
+      if (!multifilesink->file_open) {
         if (!gst_multi_file_sink_open_next_file (multifilesink))
           goto stdio_write_error;
       }
 
       break;
     }
+    case GST_EVENT_EOS:
+      /* everything should be written by the time EOS is posted */
+      if (multifilesink->io_thread &&
+          !gst_multi_file_sink_io_drain (multifilesink))
+        goto stdio_write_error;
+      break;
     default:
       break;
   }
@@ -846,38 +1723,64 @@ gst_multi_file_sink_open_next_file (GstMultiFileSink * multifilesink)
 {
   char *filename;
 
-  g_return_val_if_fail (multifilesink->file == NULL, FALSE);
+  g_return_val_if_fail (!multifilesink->file_open, FALSE);
 
-  gst_multi_file_sink_ensure_max_files (multifilesink);
-  filename = g_strdup_printf (multifilesink->filename, multifilesink->index);
-  multifilesink->file = g_fopen (filename, "wb");
-  if (multifilesink->file == NULL) {
-    g_free (filename);
+  if (!gst_multi_file_sink_ensure_max_files (multifilesink))
     return FALSE;
+  filename = g_strdup_printf (multifilesink->filename, multifilesink->index);
+  if (multifilesink->io_thread) {
+    GstMultiFileSinkIOOp *op;
+
+    op = gst_multi_file_sink_io_op_new (IO_OP_OPEN);
+    op->filename = g_strdup (filename);
+    op->next_filename = g_strdup_printf (multifilesink->filename,
+        multifilesink->index + 1);
+    if (!gst_multi_file_sink_io_queue (multifilesink, op)) {
+      g_free (filename);
+      return FALSE;
+    }
+  } else {
+    multifilesink->file = g_fopen (filename, "wb");
+    if (multifilesink->file == NULL) {
+      g_free (filename);
+      return FALSE;
+    }
   }
 
   GST_INFO_OBJECT (multifilesink, "opening file %s", filename);
   multifilesink->files = g_slist_append (multifilesink->files, filename);
   multifilesink->n_files += 1;
+  multifilesink->file_open = TRUE;
 
   multifilesink->cur_file_size = 0;
   return TRUE;
 }
 
-static void
+/* Returns FALSE with errno set if closing failed, the file counts as
+ * closed anyway */
+static gboolean
 gst_multi_file_sink_close_file (GstMultiFileSink * multifilesink,
     GstBuffer * buffer)
 {
   char *filename;
+  gboolean ret;
 
-  fclose (multifilesink->file);
-  multifilesink->file = NULL;
+  if (multifilesink->io_thread) {
+    ret = gst_multi_file_sink_io_queue (multifilesink,
+        gst_multi_file_sink_io_op_new (IO_OP_CLOSE));
+  } else {
+    ret = fclose (multifilesink->file) == 0;
+    multifilesink->file = NULL;
+  }
+  multifilesink->file_open = FALSE;
 
-  if (buffer) {
+  if (ret && buffer) {
     filename = g_strdup_printf (multifilesink->filename, multifilesink->index);
     gst_multi_file_sink_post_message (multifilesink, buffer, filename);
     g_free (filename);
   }
 
   multifilesink->index++;
+
+  return ret;
 }
@@ -94,6 +94,40 @@ struct _GstMultiFileSink
 
   guint64 cur_file_size;
   guint64 max_file_size;
+
+  /* TRUE while a file is open, in both synchronous and asynchronous mode */
+  gboolean file_open;
+
+  /* asynchronous writing */
+  gboolean async_write;
+  guint64 max_queue_size;
+  gboolean direct_io;
+  guint64 preallocate;
+  gboolean fsync;
+
+  GThread *io_thread;
+  GMutex *io_lock;
+  GCond *io_cond;
+  GQueue *io_queue;
+  guint io_ops;
+  guint64 io_queued;
+  gboolean io_flushing;
+  gint io_errno;
+
+  /* statistics, protected by io_lock */
+  guint64 io_max_queued;
+  GstClockTime io_latency;
+  GstClockTime io_max_latency;
+
+  /* only used by the I/O thread */
+  gint io_fd;
+  guint64 io_written;
+  gboolean io_direct;
+  guint8 *io_direct_mem;
+  guint8 *io_direct_buf;
+  guint io_direct_fill;
+  gint io_preopen_fd;
+  gchar *io_preopen_name;
 };
 
 struct _GstMultiFileSinkClass
@@ -37,6 +37,12 @@
  *     filesink location="images.ogg"
  * ]| This pipeline creates a video file "images.ogg" by joining multiple PNG
  * files named img.0000.png, img.0001.png, etc.
+ * |[
+ * gst-launch multifilesrc location="img.%04d.png" readahead=8 caps="image/png,framerate=\(fraction\)25/1" ! \
+ *     pngdec ! ffmpegcolorspace ! xvimagesink
+ * ]| This pipeline plays back an image sequence, with up to eight files being
+ * read ahead of time so that the per-file latency of the storage does not
+ * limit the frame rate.
  * </refsect2>
 */
 
@@ -46,6 +52,9 @@
 
 #include "gstmultifilesrc.h"
 
+#include <glib/gstdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 static GstFlowReturn gst_multi_file_src_create (GstPushSrc * src,
     GstBuffer ** buffer);
@@ -58,6 +67,9 @@ static void gst_multi_file_src_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static GstCaps *gst_multi_file_src_getcaps (GstBaseSrc * src);
 static gboolean gst_multi_file_src_query (GstBaseSrc * src, GstQuery * query);
+static gboolean gst_multi_file_src_start (GstBaseSrc * src);
+static gboolean gst_multi_file_src_stop (GstBaseSrc * src);
+static void gst_multi_file_src_finalize (GObject * object);
 
 
 static GstStaticPadTemplate gst_multi_file_src_pad_template =
@@ -77,11 +89,32 @@ enum
   ARG_START_INDEX,
   ARG_STOP_INDEX,
   ARG_CAPS,
-  ARG_LOOP
+  ARG_LOOP,
+  ARG_READAHEAD,
+  ARG_MMAP_THRESHOLD
 };
 
 #define DEFAULT_LOCATION "%05d"
 #define DEFAULT_INDEX 0
+#define DEFAULT_READAHEAD 0
+#define DEFAULT_MMAP_THRESHOLD 0
+
+/* at most this many files are read at the same time */
+#define MAX_READ_THREADS 4
+
+typedef struct
+{
+  gint index;
+  gchar *filename;
+
+  /* set by the thread that read the file */
+  GstBuffer *buffer;
+  GError *error;
+  gboolean done;
+
+  /* nobody is waiting for the file anymore */
+  gboolean abandoned;
+} GstMultiFileSrcRead;
 
 
 GST_BOILERPLATE (GstMultiFileSrc, gst_multi_file_src, GstPushSrc,
@@ -145,11 +178,42 @@ gst_multi_file_src_class_init (GstMultiFileSrcClass * klass)
       g_param_spec_boolean ("loop", "Loop",
           "Whether to repeat from the beginning when all files have been read.",
           FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstMultiFileSrc:readahead
+   *
+   * Number of files to read ahead of time in a small pool of threads. The
+   * files are still output one after the other, in order. 0 reads each file
+   * when it is needed.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_READAHEAD,
+      g_param_spec_uint ("readahead", "Readahead",
+          "Number of files to read ahead of time (0 = disabled)",
+          0, G_MAXINT, DEFAULT_READAHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstMultiFileSrc:mmap-threshold
+   *
+   * Files of at least this size are mapped into memory instead of being
+   * copied. 0 never maps files.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, ARG_MMAP_THRESHOLD,
+      g_param_spec_uint64 ("mmap-threshold", "Mmap Threshold",
+          "Map files of at least this many bytes into memory instead of "
+          "copying them (0 = never)", 0, G_MAXUINT64, DEFAULT_MMAP_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gobject_class->dispose = gst_multi_file_src_dispose;
+  gobject_class->finalize = gst_multi_file_src_finalize;
 
   gstbasesrc_class->get_caps = gst_multi_file_src_getcaps;
   gstbasesrc_class->query = gst_multi_file_src_query;
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_multi_file_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_multi_file_src_stop);
 
   gstpushsrc_class->create = gst_multi_file_src_create;
 
@@ -168,6 +232,12 @@ gst_multi_file_src_init (GstMultiFileSrc * multifilesrc,
   multifilesrc->stop_index = -1;
   multifilesrc->filename = g_strdup (DEFAULT_LOCATION);
   multifilesrc->successful_read = FALSE;
+  multifilesrc->readahead = DEFAULT_READAHEAD;
+  multifilesrc->mmap_threshold = DEFAULT_MMAP_THRESHOLD;
+
+  multifilesrc->lock = g_mutex_new ();
+  multifilesrc->cond = g_cond_new ();
+  multifilesrc->pending = g_queue_new ();
 }
 
 static void
@@ -183,6 +253,18 @@ gst_multi_file_src_dispose (GObject * object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gst_multi_file_src_finalize (GObject * object)
+{
+  GstMultiFileSrc *src = GST_MULTI_FILE_SRC (object);
+
+  g_queue_free (src->pending);
+  g_cond_free (src->cond);
+  g_mutex_free (src->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static GstCaps *
 gst_multi_file_src_getcaps (GstBaseSrc * src)
 {
@@ -279,6 +361,12 @@ gst_multi_file_src_set_property (GObject * object, guint prop_id,
     case ARG_LOOP:
       src->loop = g_value_get_boolean (value);
       break;
+    case ARG_READAHEAD:
+      src->readahead = g_value_get_uint (value);
+      break;
+    case ARG_MMAP_THRESHOLD:
+      src->mmap_threshold = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -310,6 +398,12 @@ gst_multi_file_src_get_property (GObject * object, guint prop_id,
     case ARG_LOOP:
       g_value_set_boolean (value, src->loop);
       break;
+    case ARG_READAHEAD:
+      g_value_set_uint (value, src->readahead);
+      break;
+    case ARG_MMAP_THRESHOLD:
+      g_value_set_uint64 (value, src->mmap_threshold);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -327,15 +421,230 @@ gst_multi_file_src_get_filename (GstMultiFileSrc * multifilesrc)
   return filename;
 }
 
+static gint
+gst_multi_file_src_next_index (GstMultiFileSrc * multifilesrc, gint index)
+{
+  index++;
+  if (multifilesrc->stop_index != -1 && index >= multifilesrc->stop_index)
+    index = multifilesrc->start_index;
+
+  return index;
+}
+
+/* Reads the whole file into a buffer, or maps it if it is large enough */
+static GstBuffer *
+gst_multi_file_src_read_file (GstMultiFileSrc * multifilesrc,
+    const gchar * filename, GError ** error)
+{
+  guint64 mmap_threshold = multifilesrc->mmap_threshold;
+  GstBuffer *buf;
+  struct stat st;
+  gchar *data;
+  gsize size;
+
+  if (mmap_threshold > 0 && g_stat (filename, &st) == 0 &&
+      (guint64) st.st_size >= mmap_threshold) {
+    GMappedFile *mapped;
+    GError *map_error = NULL;
+
+    /* map read-only so that read-only files and mounts work too, the buffer
+     * is flagged read-only so that downstream copies it before writing */
+    mapped = g_mapped_file_new (filename, FALSE, &map_error);
+    if (mapped != NULL) {
+      buf = gst_buffer_new ();
+      GST_BUFFER_DATA (buf) = (guint8 *) g_mapped_file_get_contents (mapped);
+      GST_BUFFER_SIZE (buf) = g_mapped_file_get_length (mapped);
+      GST_BUFFER_MALLOCDATA (buf) = (guint8 *) mapped;
+      GST_BUFFER_FREE_FUNC (buf) = (GFreeFunc) g_mapped_file_unref;
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_READONLY);
+
+      return buf;
+    }
+
+    /* not all files can be mapped, read those instead */
+    GST_DEBUG_OBJECT (multifilesrc, "could not map \"%s\": %s", filename,
+        map_error->message);
+    g_error_free (map_error);
+  }
+
+  if (!g_file_get_contents (filename, &data, &size, error))
+    return NULL;
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_DATA (buf) = (guint8 *) data;
+  GST_BUFFER_MALLOCDATA (buf) = GST_BUFFER_DATA (buf);
+  GST_BUFFER_SIZE (buf) = size;
+
+  return buf;
+}
+
+static void
+gst_multi_file_src_read_free (GstMultiFileSrcRead * read)
+{
+  g_free (read->filename);
+  if (read->buffer)
+    gst_buffer_unref (read->buffer);
+  if (read->error)
+    g_error_free (read->error);
+  g_slice_free (GstMultiFileSrcRead, read);
+}
+
+/* Runs in the thread pool */
+static void
+gst_multi_file_src_read_func (GstMultiFileSrcRead * read,
+    GstMultiFileSrc * multifilesrc)
+{
+  GstBuffer *buf;
+  GError *error = NULL;
+
+  GST_LOG_OBJECT (multifilesrc, "reading ahead \"%s\"", read->filename);
+  buf = gst_multi_file_src_read_file (multifilesrc, read->filename, &error);
+
+  g_mutex_lock (multifilesrc->lock);
+  read->buffer = buf;
+  read->error = error;
+  read->done = TRUE;
+  if (read->abandoned)
+    gst_multi_file_src_read_free (read);
+  else
+    g_cond_broadcast (multifilesrc->cond);
+  g_mutex_unlock (multifilesrc->lock);
+}
+
+/* Called with the lock */
+static void
+gst_multi_file_src_queue_read (GstMultiFileSrc * multifilesrc, gint index)
+{
+  GstMultiFileSrcRead *read;
+
+  read = g_slice_new0 (GstMultiFileSrcRead);
+  read->index = index;
+  read->filename = g_strdup_printf (multifilesrc->filename, index);
+
+  g_queue_push_tail (multifilesrc->pending, read);
+  g_thread_pool_push (multifilesrc->pool, read, NULL);
+}
+
+/* Called with the lock. Reads that are still running free themselves. */
+static void
+gst_multi_file_src_abandon_reads (GstMultiFileSrc * multifilesrc)
+{
+  GstMultiFileSrcRead *read;
+
+  while ((read = g_queue_pop_head (multifilesrc->pending))) {
+    if (read->done)
+      gst_multi_file_src_read_free (read);
+    else
+      read->abandoned = TRUE;
+  }
+}
+
+/* Returns the contents of the file for the current index, which is usually
+ * already read if the files are requested in order, and makes sure that
+ * the next files are being read. */
+static GstBuffer *
+gst_multi_file_src_fetch (GstMultiFileSrc * multifilesrc, GError ** error)
+{
+  GstMultiFileSrcRead *read;
+  GstBuffer *buf;
+
+  g_mutex_lock (multifilesrc->lock);
+  read = g_queue_peek_head (multifilesrc->pending);
+  if (read && read->index != multifilesrc->index) {
+    /* seek, loop or a new index property */
+    GST_DEBUG_OBJECT (multifilesrc, "expected file %d but need %d, dropping "
+        "files read ahead", read->index, multifilesrc->index);
+    gst_multi_file_src_abandon_reads (multifilesrc);
+  }
+
+  if (g_queue_is_empty (multifilesrc->pending))
+    gst_multi_file_src_queue_read (multifilesrc, multifilesrc->index);
+  /* the file we return now plus readahead more */
+  while (g_queue_get_length (multifilesrc->pending) <=
+      multifilesrc->readahead) {
+    read = g_queue_peek_tail (multifilesrc->pending);
+    gst_multi_file_src_queue_read (multifilesrc,
+        gst_multi_file_src_next_index (multifilesrc, read->index));
+  }
+
+  read = g_queue_pop_head (multifilesrc->pending);
+  while (!read->done)
+    g_cond_wait (multifilesrc->cond, multifilesrc->lock);
+  g_mutex_unlock (multifilesrc->lock);
+
+  buf = read->buffer;
+  read->buffer = NULL;
+  if (read->error) {
+    g_propagate_error (error, read->error);
+    read->error = NULL;
+  }
+  gst_multi_file_src_read_free (read);
+
+  return buf;
+}
+
+static GstBuffer *
+gst_multi_file_src_read (GstMultiFileSrc * multifilesrc,
+    const gchar * filename, GError ** error)
+{
+  if (multifilesrc->pool)
+    return gst_multi_file_src_fetch (multifilesrc, error);
+
+  return gst_multi_file_src_read_file (multifilesrc, filename, error);
+}
+
+static gboolean
+gst_multi_file_src_start (GstBaseSrc * src)
+{
+  GstMultiFileSrc *multifilesrc = GST_MULTI_FILE_SRC (src);
+  GError *error = NULL;
+
+  if (multifilesrc->readahead == 0)
+    return TRUE;
+
+  multifilesrc->pool =
+      g_thread_pool_new ((GFunc) gst_multi_file_src_read_func, multifilesrc,
+      MIN (multifilesrc->readahead, MAX_READ_THREADS), FALSE, &error);
+  if (multifilesrc->pool == NULL)
+    goto no_pool;
+
+  return TRUE;
+
+  /* ERRORS */
+no_pool:
+  {
+    GST_ELEMENT_ERROR (multifilesrc, RESOURCE, FAILED,
+        ("Could not create the readahead threads."), ("%s", error->message));
+    g_error_free (error);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_multi_file_src_stop (GstBaseSrc * src)
+{
+  GstMultiFileSrc *multifilesrc = GST_MULTI_FILE_SRC (src);
+
+  if (multifilesrc->pool) {
+    g_mutex_lock (multifilesrc->lock);
+    gst_multi_file_src_abandon_reads (multifilesrc);
+    g_mutex_unlock (multifilesrc->lock);
+
+    /* waits for the reads that are still running */
+    g_thread_pool_free (multifilesrc->pool, FALSE, TRUE);
+    multifilesrc->pool = NULL;
+  }
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
 {
   GstMultiFileSrc *multifilesrc;
   gsize size;
-  gchar *data;
   gchar *filename;
   GstBuffer *buf;
-  gboolean ret;
   GError *error = NULL;
 
   multifilesrc = GST_MULTI_FILE_SRC (src);
@@ -347,8 +656,8 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
 
   GST_DEBUG_OBJECT (multifilesrc, "reading from file \"%s\".", filename);
 
-  ret = g_file_get_contents (filename, &data, &size, &error);
-  if (!ret) {
+  buf = gst_multi_file_src_read (multifilesrc, filename, &error);
+  if (buf == NULL) {
     if (multifilesrc->successful_read) {
       /* If we've read at least one buffer successfully, not finding the
        * next file is EOS. */
@@ -361,8 +670,8 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
         multifilesrc->index = multifilesrc->start_index;
 
         filename = gst_multi_file_src_get_filename (multifilesrc);
-        ret = g_file_get_contents (filename, &data, &size, &error);
-        if (!ret) {
+        buf = gst_multi_file_src_read (multifilesrc, filename, &error);
+        if (buf == NULL) {
           g_free (filename);
           if (error != NULL)
             g_error_free (error);
@@ -378,16 +687,10 @@ gst_multi_file_src_create (GstPushSrc * src, GstBuffer ** buffer)
   }
 
   multifilesrc->successful_read = TRUE;
-  multifilesrc->index++;
-  if (multifilesrc->stop_index != -1 &&
-      multifilesrc->index >= multifilesrc->stop_index) {
-    multifilesrc->index = multifilesrc->start_index;
-  }
+  multifilesrc->index =
+      gst_multi_file_src_next_index (multifilesrc, multifilesrc->index);
 
-  buf = gst_buffer_new ();
-  GST_BUFFER_DATA (buf) = (unsigned char *) data;
-  GST_BUFFER_MALLOCDATA (buf) = GST_BUFFER_DATA (buf);
-  GST_BUFFER_SIZE (buf) = size;
+  size = GST_BUFFER_SIZE (buf);
   GST_BUFFER_OFFSET (buf) = multifilesrc->offset;
   GST_BUFFER_OFFSET_END (buf) = multifilesrc->offset + size;
   multifilesrc->offset += size;
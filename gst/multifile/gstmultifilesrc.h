@@ -56,6 +56,15 @@ struct _GstMultiFileSrc
 
   GstCaps *caps;
   gboolean successful_read;
+
+  guint readahead;
+  guint64 mmap_threshold;
+
+  /* files being read ahead of time, in the order they will be needed */
+  GThreadPool *pool;
+  GMutex *lock;
+  GCond *cond;
+  GQueue *pending;
 };
 
 struct _GstMultiFileSrcClass
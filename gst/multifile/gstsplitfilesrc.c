@@ -34,6 +34,10 @@
  * |[
  * gst-launch splitfilesrc location="/path/to/part-*.mpg" ! decodebin ! ... \
  * ]| Plays the different parts as if they were one single MPEG file.
+ * |[
+ * gst-launch splitfilesrc location="/path/to/part-*.mpg" readahead=4 ! decodebin ! ... \
+ * ]| Same, with the next four blocks of 512 kB being read ahead in parallel,
+ * for slow or networked storage.
  * </refsect2>
  *
  * Since: 0.10.31
@@ -60,10 +64,32 @@
 
 enum
 {
-  PROP_LOCATION = 1
+  PROP_LOCATION = 1,
+  PROP_READAHEAD
 };
 
 #define DEFAULT_LOCATION NULL
+#define DEFAULT_READAHEAD 0
+
+/* unit of readahead, requests are served from these blocks */
+#define READAHEAD_BLOCK_SIZE (512 * 1024)
+
+/* at most this many blocks are read at the same time */
+#define MAX_READ_THREADS 4
+
+typedef struct
+{
+  guint64 offset;
+  guint size;
+
+  /* set by the thread that read the block */
+  GstBuffer *buffer;
+  GError *error;
+  gboolean done;
+
+  /* nobody is waiting for the block anymore */
+  gboolean abandoned;
+} GstSplitFileBlock;
 
 static void gst_split_file_src_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -77,6 +103,7 @@ static gboolean gst_split_file_src_can_seek (GstBaseSrc * basesrc);
 static gboolean gst_split_file_src_check_get_range (GstBaseSrc * basesrc);
 static gboolean gst_split_file_src_get_size (GstBaseSrc * basesrc, guint64 * s);
 static gboolean gst_split_file_src_unlock (GstBaseSrc * basesrc);
+static gboolean gst_split_file_src_unlock_stop (GstBaseSrc * basesrc);
 static GstFlowReturn gst_split_file_src_create (GstBaseSrc * basesrc,
     guint64 offset, guint size, GstBuffer ** buffer);
 
@@ -133,11 +160,28 @@ gst_split_file_src_class_init (GstSplitFileSrcClass * klass)
           "matching. The results will be sorted." WIN32_BLURB,
           DEFAULT_LOCATION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSplitFileSrc:readahead
+   *
+   * Number of blocks of 512 kB after the current read position that are
+   * read ahead of time, several of them in parallel. 0 reads the data only
+   * when it is requested.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_READAHEAD,
+      g_param_spec_uint ("readahead", "Readahead",
+          "Number of blocks of 512 kB to read ahead of time (0 = disabled)",
+          0, 1024, DEFAULT_READAHEAD, G_PARAM_READWRITE |
+          G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
   gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_split_file_src_start);
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_split_file_src_stop);
   gstbasesrc_class->create = GST_DEBUG_FUNCPTR (gst_split_file_src_create);
   gstbasesrc_class->get_size = GST_DEBUG_FUNCPTR (gst_split_file_src_get_size);
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_split_file_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_split_file_src_unlock_stop);
   gstbasesrc_class->is_seekable =
       GST_DEBUG_FUNCPTR (gst_split_file_src_can_seek);
   gstbasesrc_class->check_get_range =
@@ -148,6 +192,11 @@ static void
 gst_split_file_src_init (GstSplitFileSrc * splitfilesrc,
     GstSplitFileSrcClass * g_class)
 {
+  splitfilesrc->readahead = DEFAULT_READAHEAD;
+
+  splitfilesrc->blocks_lock = g_mutex_new ();
+  splitfilesrc->blocks_cond = g_cond_new ();
+  splitfilesrc->blocks = g_queue_new ();
 }
 
 static void
@@ -158,6 +207,10 @@ gst_split_file_src_finalize (GObject * obj)
   g_free (src->location);
   src->location = NULL;
 
+  g_queue_free (src->blocks);
+  g_cond_free (src->blocks_cond);
+  g_mutex_free (src->blocks_lock);
+
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
@@ -176,15 +229,27 @@ gst_split_file_src_check_get_range (GstBaseSrc * basesrc)
 static gboolean
 gst_split_file_src_unlock (GstBaseSrc * basesrc)
 {
-  /* This is not actually that useful, since all normal file
-   * operations are fully blocking anyway */
-#if 0
   GstSplitFileSrc *src = GST_SPLIT_FILE_SRC (basesrc);
 
-  GST_DEBUG_OBJECT (src, "cancelling pending I/O operation if there is one");
-  /* g_cancellable_cancel (src->cancellable); */
-  GST_DEBUG_OBJECT (src, "done");
-#endif
+  /* Normal file operations are fully blocking anyway, but waiting for the
+   * readahead threads is not */
+  GST_DEBUG_OBJECT (src, "unlocking");
+  g_mutex_lock (src->blocks_lock);
+  src->flushing = TRUE;
+  g_cond_broadcast (src->blocks_cond);
+  g_mutex_unlock (src->blocks_lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_split_file_src_unlock_stop (GstBaseSrc * basesrc)
+{
+  GstSplitFileSrc *src = GST_SPLIT_FILE_SRC (basesrc);
+
+  g_mutex_lock (src->blocks_lock);
+  src->flushing = FALSE;
+  g_mutex_unlock (src->blocks_lock);
 
   return TRUE;
 }
@@ -217,6 +282,11 @@ gst_split_file_src_set_property (GObject * object, guint prop_id,
 #endif
       GST_OBJECT_UNLOCK (src);
       break;
+    case PROP_READAHEAD:
+      GST_OBJECT_LOCK (src);
+      src->readahead = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -235,6 +305,11 @@ gst_split_file_src_get_property (GObject * object, guint prop_id,
       g_value_set_string (value, src->location);
       GST_OBJECT_UNLOCK (src);
       break;
+    case PROP_READAHEAD:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->readahead);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -319,6 +394,266 @@ no_matches:
   }
 }
 
+static gboolean
+gst_split_file_src_find_part_for_offset (GstSplitFileSrc * src, guint64 offset,
+    guint * part_number);
+
+/* Reads @size bytes at @offset with streams of its own, so that it can run
+ * in several threads at once */
+static gboolean
+gst_split_file_src_read_range (GstSplitFileSrc * src, guint64 offset,
+    guint8 * data, guint size, GError ** err)
+{
+  GFileInputStream *stream;
+  GstFilePart *part;
+  GFile *file;
+  gboolean ret;
+  guint to_read;
+  gsize read;
+  guint i;
+
+  if (!gst_split_file_src_find_part_for_offset (src, offset, &i)) {
+    g_set_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+        "Offset %" G_GUINT64_FORMAT " is beyond the end", offset);
+    return FALSE;
+  }
+
+  while (size > 0) {
+    part = &src->parts[i];
+    to_read = MIN (size, part->stop - offset + 1);
+
+    file = g_file_new_for_path (part->path);
+    stream = g_file_read (file, NULL, err);
+    g_object_unref (file);
+    if (stream == NULL)
+      return FALSE;
+
+    read = 0;
+    ret = g_seekable_seek (G_SEEKABLE (stream), offset - part->start,
+        G_SEEK_SET, NULL, err) &&
+        g_input_stream_read_all (G_INPUT_STREAM (stream), data, to_read,
+        &read, NULL, err);
+    g_object_unref (stream);
+
+    if (!ret)
+      return FALSE;
+    if (read < to_read) {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_FAILED, "Short read in file "
+          "part %s, file may have been modified since start", part->path);
+      return FALSE;
+    }
+
+    data += to_read;
+    size -= to_read;
+    offset += to_read;
+    ++i;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_split_file_src_block_free (GstSplitFileBlock * block)
+{
+  if (block->buffer)
+    gst_buffer_unref (block->buffer);
+  if (block->error)
+    g_error_free (block->error);
+  g_slice_free (GstSplitFileBlock, block);
+}
+
+/* Runs in the thread pool */
+static void
+gst_split_file_src_read_block (GstSplitFileBlock * block,
+    GstSplitFileSrc * src)
+{
+  GstBuffer *buf;
+  GError *err = NULL;
+
+  GST_LOG_OBJECT (src, "reading ahead %u bytes at %" G_GUINT64_FORMAT,
+      block->size, block->offset);
+
+  buf = gst_buffer_new_and_alloc (block->size);
+  if (!gst_split_file_src_read_range (src, block->offset,
+          GST_BUFFER_DATA (buf), block->size, &err)) {
+    gst_buffer_unref (buf);
+    buf = NULL;
+  }
+
+  g_mutex_lock (src->blocks_lock);
+  block->buffer = buf;
+  block->error = err;
+  block->done = TRUE;
+  if (block->abandoned)
+    gst_split_file_src_block_free (block);
+  else
+    g_cond_broadcast (src->blocks_cond);
+  g_mutex_unlock (src->blocks_lock);
+}
+
+/* Called with the blocks_lock */
+static GstSplitFileBlock *
+gst_split_file_src_find_block (GstSplitFileSrc * src, guint64 offset)
+{
+  GList *l;
+
+  for (l = src->blocks->head; l != NULL; l = l->next) {
+    GstSplitFileBlock *block = l->data;
+
+    if (block->offset == offset)
+      return block;
+  }
+
+  return NULL;
+}
+
+/* Called with the blocks_lock. Drops all blocks, or the ones outside
+ * [@start, @end]. Blocks that are still being read free themselves. */
+static void
+gst_split_file_src_drop_blocks (GstSplitFileSrc * src, gboolean all,
+    guint64 start, guint64 end)
+{
+  GList *l, *next;
+
+  for (l = src->blocks->head; l != NULL; l = next) {
+    GstSplitFileBlock *block = l->data;
+
+    next = l->next;
+    if (!all && block->offset >= start && block->offset <= end)
+      continue;
+
+    g_queue_delete_link (src->blocks, l);
+    if (block->done)
+      gst_split_file_src_block_free (block);
+    else
+      block->abandoned = TRUE;
+  }
+}
+
+static GstFlowReturn
+gst_split_file_src_create_from_blocks (GstSplitFileSrc * src, guint64 offset,
+    guint size, GstBuffer ** buffer)
+{
+  GstSplitFileBlock *block;
+  GstBuffer *buf = NULL;
+  GError *err = NULL;
+  guint64 total, first, last, end, pos;
+  guint readahead;
+
+  total = src->parts[src->num_parts - 1].stop + 1;
+  if (offset >= total)
+    return GST_FLOW_UNEXPECTED;
+  size = MIN (size, total - offset);
+
+  if (G_UNLIKELY (size == 0)) {
+    buf = gst_buffer_new ();
+    GST_BUFFER_OFFSET (buf) = GST_BUFFER_OFFSET_END (buf) = offset;
+    *buffer = buf;
+    return GST_FLOW_OK;
+  }
+
+  GST_OBJECT_LOCK (src);
+  readahead = src->readahead;
+  GST_OBJECT_UNLOCK (src);
+
+  /* the blocks this request needs, and the ones after it */
+  first = offset - offset % READAHEAD_BLOCK_SIZE;
+  last = offset + size - 1;
+  last -= last % READAHEAD_BLOCK_SIZE;
+  end = last + (guint64) readahead * READAHEAD_BLOCK_SIZE;
+
+  g_mutex_lock (src->blocks_lock);
+  gst_split_file_src_drop_blocks (src, FALSE, first, end);
+
+  for (pos = first; pos <= end && pos < total; pos += READAHEAD_BLOCK_SIZE) {
+    if (gst_split_file_src_find_block (src, pos) == NULL) {
+      block = g_slice_new0 (GstSplitFileBlock);
+      block->offset = pos;
+      block->size = MIN (READAHEAD_BLOCK_SIZE, total - pos);
+      g_queue_push_tail (src->blocks, block);
+      g_thread_pool_push (src->pool, block, NULL);
+    }
+  }
+
+  /* only we remove blocks, so they stay around while we wait */
+  for (pos = first; pos <= last; pos += READAHEAD_BLOCK_SIZE) {
+    block = gst_split_file_src_find_block (src, pos);
+    while (!block->done && !src->flushing)
+      g_cond_wait (src->blocks_cond, src->blocks_lock);
+    if (src->flushing)
+      goto flushing;
+    if (block->error) {
+      err = g_error_copy (block->error);
+      break;
+    }
+  }
+
+  if (err == NULL) {
+    block = gst_split_file_src_find_block (src, first);
+    if (first == last) {
+      buf = gst_buffer_create_sub (block->buffer, offset - first, size);
+    } else {
+      guint8 *data;
+      guint64 cur = offset;
+
+      buf = gst_buffer_new_and_alloc (size);
+      data = GST_BUFFER_DATA (buf);
+      for (pos = first; pos <= last; pos += READAHEAD_BLOCK_SIZE) {
+        guint skip, n;
+
+        block = gst_split_file_src_find_block (src, pos);
+        skip = cur - pos;
+        n = MIN (block->size - skip, offset + size - cur);
+        memcpy (data, GST_BUFFER_DATA (block->buffer) + skip, n);
+        data += n;
+        cur += n;
+      }
+    }
+  }
+  g_mutex_unlock (src->blocks_lock);
+
+  if (err != NULL)
+    goto read_failed;
+
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + size;
+
+  *buffer = buf;
+  GST_LOG_OBJECT (src, "read %u bytes into buf %p", size, buf);
+  return GST_FLOW_OK;
+
+/* ERRORS */
+flushing:
+  {
+    GST_DEBUG_OBJECT (src, "flushing while waiting for block %"
+        G_GUINT64_FORMAT, pos);
+    g_mutex_unlock (src->blocks_lock);
+    return GST_FLOW_WRONG_STATE;
+  }
+read_failed:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, ("%s", err->message),
+        ("Read of %u bytes from %" G_GUINT64_FORMAT " failed", size, offset));
+    g_error_free (err);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static void
+gst_split_file_src_close_parts (GstSplitFileSrc * src)
+{
+  guint i;
+
+  for (i = 0; i < src->num_parts; ++i) {
+    if (src->parts[i].stream != NULL)
+      g_object_unref (src->parts[i].stream);
+    g_free (src->parts[i].path);
+  }
+  g_free (src->parts);
+  src->parts = NULL;
+  src->num_parts = 0;
+}
+
 static gboolean
 gst_split_file_src_start (GstBaseSrc * basesrc)
 {
@@ -330,6 +665,7 @@ gst_split_file_src_start (GstBaseSrc * basesrc)
   gchar *basename = NULL;
   gchar *dirname = NULL;
   gchar **files;
+  guint readahead;
   guint i;
 
   GST_OBJECT_LOCK (src);
@@ -337,6 +673,7 @@ gst_split_file_src_start (GstBaseSrc * basesrc)
     basename = g_path_get_basename (src->location);
     dirname = g_path_get_dirname (src->location);
   }
+  readahead = src->readahead;
   GST_OBJECT_UNLOCK (src);
 
   files = gst_split_file_src_find_files (src, dirname, basename, &err);
@@ -388,10 +725,26 @@ gst_split_file_src_start (GstBaseSrc * basesrc)
   src->cur_part = 0;
 
   src->cancellable = g_cancellable_new ();
+  src->flushing = FALSE;
+
+  if (readahead > 0) {
+    src->pool = g_thread_pool_new ((GFunc) gst_split_file_src_read_block, src,
+        MIN (readahead, MAX_READ_THREADS), FALSE, &err);
+    if (src->pool == NULL)
+      goto no_pool;
+  }
 
   ret = TRUE;
 
 done:
+  /* stop is not called when start fails */
+  if (!ret) {
+    gst_split_file_src_close_parts (src);
+    if (src->cancellable) {
+      g_object_unref (src->cancellable);
+      src->cancellable = NULL;
+    }
+  }
   if (err != NULL)
     g_error_free (err);
   g_strfreev (files);
@@ -428,6 +781,12 @@ query_info_error:
         ("Failed to query info for file '%s'", files[i]));
     goto done;
   }
+no_pool:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Could not create the readahead threads."), ("%s", err->message));
+    goto done;
+  }
 cancelled:
   {
     GST_DEBUG_OBJECT (src, "I/O operation cancelled from another thread");
@@ -439,16 +798,18 @@ static gboolean
 gst_split_file_src_stop (GstBaseSrc * basesrc)
 {
   GstSplitFileSrc *src = GST_SPLIT_FILE_SRC (basesrc);
-  guint i;
 
-  for (i = 0; i < src->num_parts; ++i) {
-    if (src->parts[i].stream != NULL)
-      g_object_unref (src->parts[i].stream);
-    g_free (src->parts[i].path);
+  if (src->pool) {
+    g_mutex_lock (src->blocks_lock);
+    gst_split_file_src_drop_blocks (src, TRUE, 0, 0);
+    g_mutex_unlock (src->blocks_lock);
+
+    /* waits for the blocks that are still being read */
+    g_thread_pool_free (src->pool, FALSE, TRUE);
+    src->pool = NULL;
   }
-  g_free (src->parts);
-  src->parts = NULL;
-  src->num_parts = 0;
+
+  gst_split_file_src_close_parts (src);
 
   g_object_unref (src->cancellable);
   src->cancellable = NULL;
@@ -491,6 +852,9 @@ gst_split_file_src_create (GstBaseSrc * basesrc, guint64 offset, guint size,
   guint8 *data;
   guint to_read;
 
+  if (src->pool)
+    return gst_split_file_src_create_from_blocks (src, offset, size, buffer);
+
   cur_part = src->parts[src->cur_part];
   if (offset < cur_part.start || offset > cur_part.stop) {
     if (!gst_split_file_src_find_part_for_offset (src, offset, &src->cur_part))
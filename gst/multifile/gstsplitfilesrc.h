@@ -60,6 +60,15 @@ struct _GstSplitFileSrc
   guint        cur_part;  /* part used last (likely also to be used next) */
 
   GCancellable *cancellable; /* so we can interrupt blocking operations */
+
+  guint         readahead; /* OBJECT_LOCK */
+
+  /* blocks being read ahead of the current position */
+  GThreadPool  *pool;
+  GMutex       *blocks_lock;
+  GCond        *blocks_cond;
+  GQueue       *blocks;    /* blocks_lock */
+  gboolean      flushing;  /* blocks_lock */
 };
 
 struct _GstSplitFileSrcClass
@@ -43,6 +43,10 @@
  * since the album gain and peak values need to be associated with all tracks of
  * an album, not just the last one.
  * 
+ * Since 0.10.31, streams with up to 8 channels are accepted.  The loudness of
+ * all channels is summed up with equal weights; for mono and stereo streams
+ * the results are the same as before.
+ * 
  * <refsect2>
  * <title>Example launch lines</title>
  * |[
@@ -100,10 +104,11 @@ enum
 };
 
 /* The ReplayGain algorithm is intended for use with mono and stereo
- * audio.  The used implementation has filter coefficients for the
- * "usual" sample rates in the 8000 to 48000 Hz range. */
+ * audio.  For more channels, the loudness of all channels is summed up
+ * with equal weights.  The used implementation has filter coefficients
+ * for the "usual" sample rates in the 8000 to 48000 Hz range. */
 #define REPLAY_GAIN_CAPS                                                \
-  "channels = (int) { 1, 2 }, "                                         \
+  "channels = (int) [ 1, 8 ], "                                         \
   "rate = (int) { 8000, 11025, 12000, 16000, 22050, 24000, 32000, "     \
   "44100, 48000 }"
 
@@ -415,6 +420,9 @@ gst_rg_analysis_set_caps (GstBaseTransform * base, GstCaps * in_caps,
       || !gst_structure_get_int (structure, "rate", &sample_rate))
     goto invalid_format;
 
+  if (!rg_analysis_set_channels (filter->ctx, n_channels))
+    goto invalid_format;
+
   if (!rg_analysis_set_sample_rate (filter->ctx, sample_rate))
     goto invalid_format;
 
@@ -431,13 +439,7 @@ gst_rg_analysis_set_caps (GstBaseTransform * base, GstCaps * in_caps,
      * makes the transform function nice and simple if the
      * rg_analysis_analyze_* functions have a common signature. */
     filter->depth = sizeof (gfloat) * 8;
-
-    if (n_channels == 1)
-      filter->analyze = rg_analysis_analyze_mono_float;
-    else if (n_channels == 2)
-      filter->analyze = rg_analysis_analyze_stereo_float;
-    else
-      goto invalid_format;
+    filter->analyze = rg_analysis_analyze_float;
 
   } else if (g_str_equal (name, "audio/x-raw-int")) {
 
@@ -449,12 +451,7 @@ gst_rg_analysis_set_caps (GstBaseTransform * base, GstCaps * in_caps,
     if (filter->depth < 1 || filter->depth > 16)
       goto invalid_format;
 
-    if (n_channels == 1)
-      filter->analyze = rg_analysis_analyze_mono_int16;
-    else if (n_channels == 2)
-      filter->analyze = rg_analysis_analyze_stereo_int16;
-    else
-      goto invalid_format;
+    filter->analyze = rg_analysis_analyze_int16;
 
   } else {
 
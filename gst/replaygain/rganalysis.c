@@ -31,16 +31,14 @@
  * "gain_analysis.c" from vorbisgain version 0.34.
  */
 
-/* Room for future improvement: Mono data is currently in fact copied
- * to two channels which get processed normally.  This means that mono
- * input data is processed twice.
- */
-
 /* Helpful information for understanding this code: The two IIR
  * filters depend on previous input _and_ previous output samples (up
  * to the filter's order number of samples).  This explains the whole
  * lot of memcpy'ing done in rg_analysis_analyze and why the context
- * holds so many buffers.
+ * holds so many buffers.  All buffers hold the samples of all channels
+ * interleaved, so the filters run over all channels of a frame in the
+ * inner loop, which the compiler can turn into SIMD code for the common
+ * channel counts.
  */
 
 #include <math.h>
@@ -64,6 +62,7 @@
 #define PINK_REF           64.82        /* 298640883795 */
 
 #define MAX_ORDER         MAX (BUTTER_ORDER, YULE_ORDER)
+#define MAX_CHANNELS      RG_ANALYSIS_MAX_CHANNELS
 #define MAX_SAMPLE_RATE   48000
 /* The + 999 has the effect of ceil()ing: */
 #define MAX_SAMPLE_WINDOW (guint) \
@@ -83,20 +82,18 @@ typedef struct _RgAnalysisAcc RgAnalysisAcc;
 
 struct _RgAnalysisCtx
 {
-  /* Filter buffers for left channel. */
-  gfloat inprebuf_l[MAX_ORDER * 2];
-  gfloat *inpre_l;
-  gfloat stepbuf_l[MAX_SAMPLE_WINDOW + MAX_ORDER];
-  gfloat *step_l;
-  gfloat outbuf_l[MAX_SAMPLE_WINDOW + MAX_ORDER];
-  gfloat *out_l;
-  /* Filter buffers for right channel. */
-  gfloat inprebuf_r[MAX_ORDER * 2];
-  gfloat *inpre_r;
-  gfloat stepbuf_r[MAX_SAMPLE_WINDOW + MAX_ORDER];
-  gfloat *step_r;
-  gfloat outbuf_r[MAX_SAMPLE_WINDOW + MAX_ORDER];
-  gfloat *out_r;
+  /* Filter buffers, the samples of all channels are interleaved.  The
+   * pointers point behind the filter history of MAX_ORDER frames. */
+  gfloat inprebuf[MAX_ORDER * 2 * MAX_CHANNELS];
+  gfloat *inpre;
+  gfloat stepbuf[(MAX_SAMPLE_WINDOW + MAX_ORDER) * MAX_CHANNELS];
+  gfloat *step;
+  gfloat outbuf[(MAX_SAMPLE_WINDOW + MAX_ORDER) * MAX_CHANNELS];
+  gfloat *out;
+
+  gint n_channels;
+  void (*apply_filters) (const RgAnalysisCtx * ctx, const gfloat * input,
+      guint n_frames);
 
   /* Number of samples to reach duration of the RMS window: */
   guint window_n_samples;
@@ -227,11 +224,13 @@ static const gfloat BButter[9][3] = {
 #pragma warning ( default : 4305 )
 #endif
 
-/* Filter functions.  These access elements with negative indices of
- * the input and output arrays (up to the filter's order). */
+/* Filter macros.  These access elements with negative indices of
+ * the input and output arrays (up to the filter's order), the samples
+ * of one channel are @stride elements apart. */
 
 /* For much better performance, the function below has been
- * implemented by unrolling the inner loop for our two use cases. */
+ * implemented by unrolling the inner loop for our two use cases in the
+ * macros that follow it. */
 
 /*
  * static inline void
@@ -250,58 +249,64 @@ static const gfloat BButter[9][3] = {
  * }
  */
 
-static inline void
-yule_filter (const gfloat * input, gfloat * output,
-    const gfloat * a, const gfloat * b)
-{
-  /* 1e-10 is added below to avoid running into denormals when operating on
-   * near silence. */
-
-  output[0] = 1e-10 + input[0] * b[0]
-      + input[-1] * b[1] - output[-1] * a[1]
-      + input[-2] * b[2] - output[-2] * a[2]
-      + input[-3] * b[3] - output[-3] * a[3]
-      + input[-4] * b[4] - output[-4] * a[4]
-      + input[-5] * b[5] - output[-5] * a[5]
-      + input[-6] * b[6] - output[-6] * a[6]
-      + input[-7] * b[7] - output[-7] * a[7]
-      + input[-8] * b[8] - output[-8] * a[8]
-      + input[-9] * b[9] - output[-9] * a[9]
-      + input[-10] * b[10] - output[-10] * a[10];
-}
-
-static inline void
-butter_filter (const gfloat * input, gfloat * output,
-    const gfloat * a, const gfloat * b)
-{
-  output[0] = input[0] * b[0]
-      + input[-1] * b[1] - output[-1] * a[1]
-      + input[-2] * b[2] - output[-2] * a[2];
+/* These are macros instead of inline functions as the compiler refuses
+ * to inline them into the specialized functions below once they take a
+ * stride. */
+
+/* 1e-10 is added below to avoid running into denormals when operating on
+ * near silence. */
+#define YULE_FILTER(input, output, a, b, stride) \
+  (output)[0] = 1e-10 + (input)[0] * (b)[0] \
+      + (input)[-1 * (stride)] * (b)[1] - (output)[-1 * (stride)] * (a)[1] \
+      + (input)[-2 * (stride)] * (b)[2] - (output)[-2 * (stride)] * (a)[2] \
+      + (input)[-3 * (stride)] * (b)[3] - (output)[-3 * (stride)] * (a)[3] \
+      + (input)[-4 * (stride)] * (b)[4] - (output)[-4 * (stride)] * (a)[4] \
+      + (input)[-5 * (stride)] * (b)[5] - (output)[-5 * (stride)] * (a)[5] \
+      + (input)[-6 * (stride)] * (b)[6] - (output)[-6 * (stride)] * (a)[6] \
+      + (input)[-7 * (stride)] * (b)[7] - (output)[-7 * (stride)] * (a)[7] \
+      + (input)[-8 * (stride)] * (b)[8] - (output)[-8 * (stride)] * (a)[8] \
+      + (input)[-9 * (stride)] * (b)[9] - (output)[-9 * (stride)] * (a)[9] \
+      + (input)[-10 * (stride)] * (b)[10] - (output)[-10 * (stride)] * (a)[10]
+
+#define BUTTER_FILTER(input, output, a, b, stride) \
+  (output)[0] = (input)[0] * (b)[0] \
+      + (input)[-1 * (stride)] * (b)[1] - (output)[-1 * (stride)] * (a)[1] \
+      + (input)[-2 * (stride)] * (b)[2] - (output)[-2 * (stride)] * (a)[2]
+
+/* Because BUTTER_FILTER and YULE_FILTER are expanded in place, these
+ * functions are a bit blown-up (code-size wise), but not inlining the
+ * filters gives a ca. 40% performance penalty.  The channels are
+ * processed in the inner loops, which the compiler can turn into SIMD
+ * code if the number of channels is a constant. */
+
+#define DEFINE_APPLY_FILTERS_FUNC(name, channels) \
+static void \
+apply_filters_##name (const RgAnalysisCtx * ctx, const gfloat * input, \
+    guint n_frames) \
+{ \
+  const gfloat *ayule = AYule[ctx->sample_rate_index]; \
+  const gfloat *byule = BYule[ctx->sample_rate_index]; \
+  const gfloat *abutter = AButter[ctx->sample_rate_index]; \
+  const gfloat *bbutter = BButter[ctx->sample_rate_index]; \
+  gfloat *step = ctx->step + ctx->window_n_samples_done * (channels); \
+  gfloat *out = ctx->out + ctx->window_n_samples_done * (channels); \
+  gint i, c; \
+  \
+  for (i = 0; i < n_frames; i++) { \
+    for (c = 0; c < (channels); c++) \
+      YULE_FILTER (input + c, step + c, ayule, byule, (channels)); \
+    for (c = 0; c < (channels); c++) \
+      BUTTER_FILTER (step + c, out + c, abutter, bbutter, (channels)); \
+    \
+    input += (channels); \
+    step += (channels); \
+    out += (channels); \
+  } \
 }
 
-/* Because butter_filter and yule_filter are inlined, this function is
- * a bit blown-up (code-size wise), but not inlining gives a ca. 40%
- * performance penalty. */
-
-static inline void
-apply_filters (const RgAnalysisCtx * ctx, const gfloat * input_l,
-    const gfloat * input_r, guint n_samples)
-{
-  const gfloat *ayule = AYule[ctx->sample_rate_index];
-  const gfloat *byule = BYule[ctx->sample_rate_index];
-  const gfloat *abutter = AButter[ctx->sample_rate_index];
-  const gfloat *bbutter = BButter[ctx->sample_rate_index];
-  gint pos = ctx->window_n_samples_done;
-  gint i;
-
-  for (i = 0; i < n_samples; i++, pos++) {
-    yule_filter (input_l + i, ctx->step_l + pos, ayule, byule);
-    butter_filter (ctx->step_l + pos, ctx->out_l + pos, abutter, bbutter);
-
-    yule_filter (input_r + i, ctx->step_r + pos, ayule, byule);
-    butter_filter (ctx->step_r + pos, ctx->out_r + pos, abutter, bbutter);
-  }
-}
+DEFINE_APPLY_FILTERS_FUNC (1, 1);
+DEFINE_APPLY_FILTERS_FUNC (2, 2);
+DEFINE_APPLY_FILTERS_FUNC (n, ctx->n_channels);
 
 /* Clear filter buffer state and current RMS window. */
 
@@ -310,15 +315,10 @@ reset_filters (RgAnalysisCtx * ctx)
 {
   gint i;
 
-  for (i = 0; i < MAX_ORDER; i++) {
-
-    ctx->inprebuf_l[i] = 0.;
-    ctx->stepbuf_l[i] = 0.;
-    ctx->outbuf_l[i] = 0.;
-
-    ctx->inprebuf_r[i] = 0.;
-    ctx->stepbuf_r[i] = 0.;
-    ctx->outbuf_r[i] = 0.;
+  for (i = 0; i < MAX_ORDER * MAX_CHANNELS; i++) {
+    ctx->inprebuf[i] = 0.;
+    ctx->stepbuf[i] = 0.;
+    ctx->outbuf[i] = 0.;
   }
 
   ctx->window_square_sum = 0.;
@@ -388,8 +388,9 @@ accumulator_result (const RgAnalysisAcc * acc, gdouble * result_gain,
 
 /* Functions that operate on contexts, for external usage. */
 
-/* Create a new context.  Before it can be used, a sample rate must be
- * configured using rg_analysis_set_sample_rate. */
+/* Create a new context.  Before it can be used, the number of channels
+ * and a sample rate must be configured using rg_analysis_set_channels
+ * and rg_analysis_set_sample_rate. */
 
 RgAnalysisCtx *
 rg_analysis_new (void)
@@ -398,16 +399,12 @@ rg_analysis_new (void)
 
   ctx = g_new (RgAnalysisCtx, 1);
 
-  ctx->inpre_l = ctx->inprebuf_l + MAX_ORDER;
-  ctx->step_l = ctx->stepbuf_l + MAX_ORDER;
-  ctx->out_l = ctx->outbuf_l + MAX_ORDER;
-
-  ctx->inpre_r = ctx->inprebuf_r + MAX_ORDER;
-  ctx->step_r = ctx->stepbuf_r + MAX_ORDER;
-  ctx->out_r = ctx->outbuf_r + MAX_ORDER;
-
+  ctx->n_channels = 0;
+  ctx->apply_filters = NULL;
   ctx->sample_rate = 0;
 
+  reset_filters (ctx);
+
   accumulator_clear (&ctx->track);
   accumulator_clear (&ctx->album);
 
@@ -478,6 +475,66 @@ rg_analysis_set_sample_rate (RgAnalysisCtx * ctx, gint sample_rate)
   return TRUE;
 }
 
+/* Rearrange the first @n_frames frames of @buf from @old_channels to
+ * @new_channels interleaved channels.  New channels get the data of an
+ * existing one. */
+
+static void
+remap_channels (gfloat * buf, guint n_frames, gint old_channels,
+    gint new_channels)
+{
+  gfloat *old;
+  gint i, c;
+
+  old = g_memdup (buf, n_frames * old_channels * sizeof (gfloat));
+  for (i = 0; i < n_frames; i++)
+    for (c = 0; c < new_channels; c++)
+      buf[i * new_channels + c] = old[i * old_channels + c % old_channels];
+  g_free (old);
+}
+
+/* Adapt to given number of channels.  Does nothing if already the
+ * current number (returns TRUE then).  Returns FALSE only if the given
+ * number of channels is not supported.  If the number changes, the
+ * state of the filters and the current RMS window are carried over: The
+ * filter history of each new channel is taken from an old one and the
+ * square sum of the window is scaled to the new number of channels. */
+
+gboolean
+rg_analysis_set_channels (RgAnalysisCtx * ctx, gint n_channels)
+{
+  g_return_val_if_fail (ctx != NULL, FALSE);
+
+  if (ctx->n_channels == n_channels)
+    return TRUE;
+
+  if (n_channels < 1 || n_channels > MAX_CHANNELS)
+    return FALSE;
+
+  if (ctx->n_channels != 0) {
+    guint n_frames = MAX_ORDER + ctx->window_n_samples_done;
+
+    remap_channels (ctx->inprebuf, MAX_ORDER, ctx->n_channels, n_channels);
+    remap_channels (ctx->stepbuf, n_frames, ctx->n_channels, n_channels);
+    remap_channels (ctx->outbuf, n_frames, ctx->n_channels, n_channels);
+    ctx->window_square_sum *= (gdouble) n_channels / ctx->n_channels;
+  }
+
+  ctx->n_channels = n_channels;
+  ctx->inpre = ctx->inprebuf + MAX_ORDER * n_channels;
+  ctx->step = ctx->stepbuf + MAX_ORDER * n_channels;
+  ctx->out = ctx->outbuf + MAX_ORDER * n_channels;
+
+  if (n_channels == 1)
+    ctx->apply_filters = apply_filters_1;
+  else if (n_channels == 2)
+    ctx->apply_filters = apply_filters_2;
+  else
+    ctx->apply_filters = apply_filters_n;
+
+  return TRUE;
+}
+
 void
 rg_analysis_init_silence_detection (RgAnalysisCtx * ctx,
     void (*post_message) (gpointer analysis, GstClockTime timestamp,
@@ -502,87 +559,59 @@ rg_analysis_destroy (RgAnalysisCtx * ctx)
 }
 
 /* Entry points for analyzing sample data in common raw data formats.
- * The stereo format functions expect interleaved frames.  It is
- * possible to pass data in different formats for the same context,
- * there are no restrictions.  All functions have the same signature;
- * the depth argument for the float functions is not variable and must
- * be given the value 32. */
+ * The functions expect interleaved frames of the configured number of
+ * channels.  It is possible to pass data in different formats for the
+ * same context, there are no restrictions.  All functions have the
+ * same signature; the depth argument for the float function is not
+ * variable and must be given the value 32. */
 
 void
-rg_analysis_analyze_mono_float (RgAnalysisCtx * ctx, gconstpointer data,
+rg_analysis_analyze_float (RgAnalysisCtx * ctx, gconstpointer data,
     gsize size, guint depth)
 {
   gfloat conv_samples[512];
   const gfloat *samples = (gfloat *) data;
   guint n_samples = size / sizeof (gfloat);
+  gint channels = ctx->n_channels;
   gint i;
 
   g_return_if_fail (depth == 32);
-  g_return_if_fail (size % sizeof (gfloat) == 0);
+  g_return_if_fail (channels != 0);
+  g_return_if_fail (size % (sizeof (gfloat) * channels) == 0);
 
   while (n_samples) {
-    gint n = MIN (n_samples, G_N_ELEMENTS (conv_samples));
+    gint n = MIN (n_samples,
+        G_N_ELEMENTS (conv_samples) / channels * channels);
 
     n_samples -= n;
-    memcpy (conv_samples, samples, n * sizeof (gfloat));
     for (i = 0; i < n; i++) {
-      ctx->track.peak = MAX (ctx->track.peak, fabs (conv_samples[i]));
-      conv_samples[i] *= 32768.;
+      ctx->track.peak = MAX (ctx->track.peak, fabs (samples[i]));
+      conv_samples[i] = samples[i] * 32768.;
     }
     samples += n;
-    rg_analysis_analyze (ctx, conv_samples, NULL, n);
-  }
-}
-
-void
-rg_analysis_analyze_stereo_float (RgAnalysisCtx * ctx, gconstpointer data,
-    gsize size, guint depth)
-{
-  gfloat conv_samples_l[256];
-  gfloat conv_samples_r[256];
-  const gfloat *samples = (gfloat *) data;
-  guint n_frames = size / (sizeof (gfloat) * 2);
-  gint i;
-
-  g_return_if_fail (depth == 32);
-  g_return_if_fail (size % (sizeof (gfloat) * 2) == 0);
-
-  while (n_frames) {
-    gint n = MIN (n_frames, G_N_ELEMENTS (conv_samples_l));
-
-    n_frames -= n;
-    for (i = 0; i < n; i++) {
-      gfloat old_sample;
-
-      old_sample = samples[2 * i];
-      ctx->track.peak = MAX (ctx->track.peak, fabs (old_sample));
-      conv_samples_l[i] = old_sample * 32768.;
-
-      old_sample = samples[2 * i + 1];
-      ctx->track.peak = MAX (ctx->track.peak, fabs (old_sample));
-      conv_samples_r[i] = old_sample * 32768.;
-    }
-    samples += 2 * n;
-    rg_analysis_analyze (ctx, conv_samples_l, conv_samples_r, n);
+    rg_analysis_analyze (ctx, conv_samples, n / channels);
   }
 }
 
 void
-rg_analysis_analyze_mono_int16 (RgAnalysisCtx * ctx, gconstpointer data,
+rg_analysis_analyze_int16 (RgAnalysisCtx * ctx, gconstpointer data,
     gsize size, guint depth)
 {
   gfloat conv_samples[512];
   gint32 peak_sample = 0;
   const gint16 *samples = (gint16 *) data;
   guint n_samples = size / sizeof (gint16);
+  gint channels = ctx->n_channels;
   gint shift = sizeof (gint16) * 8 - depth;
   gint i;
 
   g_return_if_fail (depth <= (sizeof (gint16) * 8));
-  g_return_if_fail (size % sizeof (gint16) == 0);
+  g_return_if_fail (channels != 0);
+  g_return_if_fail (size % (sizeof (gint16) * channels) == 0);
 
   while (n_samples) {
-    gint n = MIN (n_samples, G_N_ELEMENTS (conv_samples));
+    gint n = MIN (n_samples,
+        G_N_ELEMENTS (conv_samples) / channels * channels);
 
     n_samples -= n;
     for (i = 0; i < n; i++) {
@@ -592,44 +621,7 @@ rg_analysis_analyze_mono_int16 (RgAnalysisCtx * ctx, gconstpointer data,
       conv_samples[i] = (gfloat) old_sample;
     }
     samples += n;
-    rg_analysis_analyze (ctx, conv_samples, NULL, n);
-  }
-  ctx->track.peak = MAX (ctx->track.peak,
-      (gdouble) peak_sample / ((gdouble) (1u << 15)));
-}
-
-void
-rg_analysis_analyze_stereo_int16 (RgAnalysisCtx * ctx, gconstpointer data,
-    gsize size, guint depth)
-{
-  gfloat conv_samples_l[256];
-  gfloat conv_samples_r[256];
-  gint32 peak_sample = 0;
-  const gint16 *samples = (gint16 *) data;
-  guint n_frames = size / (sizeof (gint16) * 2);
-  gint shift = sizeof (gint16) * 8 - depth;
-  gint i;
-
-  g_return_if_fail (depth <= (sizeof (gint16) * 8));
-  g_return_if_fail (size % (sizeof (gint16) * 2) == 0);
-
-  while (n_frames) {
-    gint n = MIN (n_frames, G_N_ELEMENTS (conv_samples_l));
-
-    n_frames -= n;
-    for (i = 0; i < n; i++) {
-      gint16 old_sample;
-
-      old_sample = samples[2 * i] << shift;
-      peak_sample = MAX (peak_sample, ABS ((gint32) old_sample));
-      conv_samples_l[i] = (gfloat) old_sample;
-
-      old_sample = samples[2 * i + 1] << shift;
-      peak_sample = MAX (peak_sample, ABS ((gint32) old_sample));
-      conv_samples_r[i] = (gfloat) old_sample;
-    }
-    samples += 2 * n;
-    rg_analysis_analyze (ctx, conv_samples_l, conv_samples_r, n);
+    rg_analysis_analyze (ctx, conv_samples, n / channels);
   }
   ctx->track.peak = MAX (ctx->track.peak,
       (gdouble) peak_sample / ((gdouble) (1u << 15)));
@@ -639,73 +631,73 @@ rg_analysis_analyze_stereo_int16 (RgAnalysisCtx * ctx, gconstpointer data,
  * floating point format but should be scaled such that the values
  * +/-32768.0 correspond to the -0dBFS reference amplitude.
  *
- * samples_l: Buffer with sample data for the left channel or of the
- * mono channel.
+ * samples: Buffer with the interleaved sample data of all channels.
  *
- * samples_r: Buffer with sample data for the right channel or NULL
- * for mono.
+ * n_frames: Number of frames in the buffer.
  *
- * n_samples: Number of samples passed in each buffer.
+ * The loudness of a window is the mean square of all its samples, that
+ * is the loudness of the channels is summed up with equal weights.
  */
 
 void
-rg_analysis_analyze (RgAnalysisCtx * ctx, const gfloat * samples_l,
-    const gfloat * samples_r, guint n_samples)
+rg_analysis_analyze (RgAnalysisCtx * ctx, const gfloat * samples,
+    guint n_frames)
 {
-  const gfloat *input_l, *input_r;
-  guint n_samples_done;
-  gint i;
+  const gfloat *input;
+  const gfloat *out;
+  guint n_frames_done;
+  gint channels;
+  gint i, c;
 
   g_return_if_fail (ctx != NULL);
-  g_return_if_fail (samples_l != NULL);
+  g_return_if_fail (samples != NULL);
   g_return_if_fail (ctx->sample_rate != 0);
+  g_return_if_fail (ctx->n_channels != 0);
 
-  if (n_samples == 0)
+  if (n_frames == 0)
     return;
 
-  if (samples_r == NULL)
-    /* Mono. */
-    samples_r = samples_l;
+  channels = ctx->n_channels;
 
-  memcpy (ctx->inpre_l, samples_l,
-      MIN (n_samples, MAX_ORDER) * sizeof (gfloat));
-  memcpy (ctx->inpre_r, samples_r,
-      MIN (n_samples, MAX_ORDER) * sizeof (gfloat));
+  memcpy (ctx->inpre, samples,
+      MIN (n_frames, MAX_ORDER) * channels * sizeof (gfloat));
 
-  n_samples_done = 0;
-  while (n_samples_done < n_samples) {
-    /* Limit number of samples to be processed in this iteration to
+  n_frames_done = 0;
+  while (n_frames_done < n_frames) {
+    /* Limit number of frames to be processed in this iteration to
      * the number needed to complete the next window: */
-    guint n_samples_current = MIN (n_samples - n_samples_done,
+    guint n_frames_current = MIN (n_frames - n_frames_done,
         ctx->window_n_samples - ctx->window_n_samples_done);
 
-    if (n_samples_done < MAX_ORDER) {
-      input_l = ctx->inpre_l + n_samples_done;
-      input_r = ctx->inpre_r + n_samples_done;
-      n_samples_current = MIN (n_samples_current, MAX_ORDER - n_samples_done);
+    if (n_frames_done < MAX_ORDER) {
+      input = ctx->inpre + n_frames_done * channels;
+      n_frames_current = MIN (n_frames_current, MAX_ORDER - n_frames_done);
     } else {
-      input_l = samples_l + n_samples_done;
-      input_r = samples_r + n_samples_done;
+      input = samples + n_frames_done * channels;
     }
 
-    apply_filters (ctx, input_l, input_r, n_samples_current);
+    ctx->apply_filters (ctx, input, n_frames_current);
 
     /* Update the square sum. */
-    for (i = 0; i < n_samples_current; i++)
-      ctx->window_square_sum += ctx->out_l[ctx->window_n_samples_done + i]
-          * ctx->out_l[ctx->window_n_samples_done + i]
-          + ctx->out_r[ctx->window_n_samples_done + i]
-          * ctx->out_r[ctx->window_n_samples_done + i];
+    out = ctx->out + ctx->window_n_samples_done * channels;
+    for (i = 0; i < n_frames_current; i++) {
+      gfloat square_sum = out[0] * out[0];
+
+      for (c = 1; c < channels; c++)
+        square_sum += out[c] * out[c];
+      ctx->window_square_sum += square_sum;
+      out += channels;
+    }
 
-    ctx->window_n_samples_done += n_samples_current;
-    ctx->buffer_n_samples_done += n_samples_current;
+    ctx->window_n_samples_done += n_frames_current;
+    ctx->buffer_n_samples_done += n_frames_current;
 
     g_return_if_fail (ctx->window_n_samples_done <= ctx->window_n_samples);
 
     if (ctx->window_n_samples_done == ctx->window_n_samples) {
       /* Get the Root Mean Square (RMS) for this set of samples. */
       gdouble val = STEPS_PER_DB * 10. * log10 (ctx->window_square_sum /
-          ctx->window_n_samples * 0.5 + 1.e-37);
+          ctx->window_n_samples / channels + 1.e-37);
       gint ival = CLAMP ((gint) val, 0,
           (gint) G_N_ELEMENTS (ctx->track.histogram) - 1);
       /* Compute the per-window gain */
@@ -728,39 +720,26 @@ rg_analysis_analyze (RgAnalysisCtx * ctx, const gfloat * samples_l,
        * the smallest sample rate, the number of samples needed for
        * the window is greater than MAX_ORDER. */
 
-      memcpy (ctx->stepbuf_l, ctx->stepbuf_l + ctx->window_n_samples,
-          MAX_ORDER * sizeof (gfloat));
-      memcpy (ctx->outbuf_l, ctx->outbuf_l + ctx->window_n_samples,
-          MAX_ORDER * sizeof (gfloat));
-
-      memcpy (ctx->stepbuf_r, ctx->stepbuf_r + ctx->window_n_samples,
-          MAX_ORDER * sizeof (gfloat));
-      memcpy (ctx->outbuf_r, ctx->outbuf_r + ctx->window_n_samples,
-          MAX_ORDER * sizeof (gfloat));
+      memcpy (ctx->stepbuf, ctx->stepbuf + ctx->window_n_samples * channels,
+          MAX_ORDER * channels * sizeof (gfloat));
+      memcpy (ctx->outbuf, ctx->outbuf + ctx->window_n_samples * channels,
+          MAX_ORDER * channels * sizeof (gfloat));
     }
 
-    n_samples_done += n_samples_current;
+    n_frames_done += n_frames_current;
   }
 
-  if (n_samples >= MAX_ORDER) {
+  if (n_frames >= MAX_ORDER) {
 
-    memcpy (ctx->inprebuf_l, samples_l + n_samples - MAX_ORDER,
-        MAX_ORDER * sizeof (gfloat));
-
-    memcpy (ctx->inprebuf_r, samples_r + n_samples - MAX_ORDER,
-        MAX_ORDER * sizeof (gfloat));
+    memcpy (ctx->inprebuf, samples + (n_frames - MAX_ORDER) * channels,
+        MAX_ORDER * channels * sizeof (gfloat));
 
   } else {
 
-    memmove (ctx->inprebuf_l, ctx->inprebuf_l + n_samples,
-        (MAX_ORDER - n_samples) * sizeof (gfloat));
-    memcpy (ctx->inprebuf_l + MAX_ORDER - n_samples, samples_l,
-        n_samples * sizeof (gfloat));
-
-    memmove (ctx->inprebuf_r, ctx->inprebuf_r + n_samples,
-        (MAX_ORDER - n_samples) * sizeof (gfloat));
-    memcpy (ctx->inprebuf_r + MAX_ORDER - n_samples, samples_r,
-        n_samples * sizeof (gfloat));
+    memmove (ctx->inprebuf, ctx->inprebuf + n_frames * channels,
+        (MAX_ORDER - n_frames) * channels * sizeof (gfloat));
+    memcpy (ctx->inprebuf + (MAX_ORDER - n_frames) * channels, samples,
+        n_frames * channels * sizeof (gfloat));
 
   }
 }
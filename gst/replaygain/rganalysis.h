@@ -30,20 +30,20 @@
 
 G_BEGIN_DECLS
 
+/* Maximum number of interleaved channels a context can analyze */
+#define RG_ANALYSIS_MAX_CHANNELS 8
+
 typedef struct _RgAnalysisCtx RgAnalysisCtx;
 
 RgAnalysisCtx *rg_analysis_new (void);
+gboolean rg_analysis_set_channels (RgAnalysisCtx * ctx, gint n_channels);
 gboolean rg_analysis_set_sample_rate (RgAnalysisCtx * ctx, gint sample_rate);
-void rg_analysis_analyze_mono_float (RgAnalysisCtx * ctx, gconstpointer data,
-    gsize size, guint depth);
-void rg_analysis_analyze_stereo_float (RgAnalysisCtx * ctx, gconstpointer data,
-    gsize size, guint depth);
-void rg_analysis_analyze_mono_int16 (RgAnalysisCtx * ctx, gconstpointer data,
+void rg_analysis_analyze_float (RgAnalysisCtx * ctx, gconstpointer data,
     gsize size, guint depth);
-void rg_analysis_analyze_stereo_int16 (RgAnalysisCtx * ctx, gconstpointer data,
+void rg_analysis_analyze_int16 (RgAnalysisCtx * ctx, gconstpointer data,
     gsize size, guint depth);
-void rg_analysis_analyze (RgAnalysisCtx * ctx, const gfloat * samples_l,
-    const gfloat * samples_r, guint n_samples);
+void rg_analysis_analyze (RgAnalysisCtx * ctx, const gfloat * samples,
+    guint n_frames);
 gboolean rg_analysis_track_result (RgAnalysisCtx * ctx, gdouble * gain,
     gdouble * peak);
 gboolean rg_analysis_album_result (RgAnalysisCtx * ctx, gdouble * gain,
@@ -0,0 +1,328 @@
+/* GStreamer
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * The reactor watches the file descriptors of many sources from a small,
+ * process wide set of threads, so that elements that would otherwise each
+ * need a thread blocking on their own socket can share them. Sources are
+ * spread over at most one thread per CPU, the threads are started when
+ * needed and live as long as the process.
+ *
+ * The threads wait with GstPoll, which uses poll() or select() and so scans
+ * all the file descriptors of a thread on every wakeup. That is fine for the
+ * few hundred connections a thread gets, an epoll or kqueue backend would
+ * be needed to scale much further. Only the interleaved TCP connections of
+ * rtspsrc are watched for now, its UDP sockets and RTCP and the threads of
+ * rtpbin are not shared yet.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* FIXME 0.11: suppress warnings for deprecated API such as GMutex
+ * with newer GLib versions (>= 2.31.0) */
+#define GLIB_DISABLE_DEPRECATION_WARNINGS
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "gstrtspreactor.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtspreactor_debug);
+#define GST_CAT_DEFAULT (rtspreactor_debug)
+
+/* max number of threads we dispatch the sources from */
+#define MAX_THREADS     8
+/* how often all sources are dispatched for their timeouts */
+#define TICK_INTERVAL   GST_SECOND
+/* how soon we retry a source of which the owner was busy */
+#define BUSY_INTERVAL   (10 * GST_MSECOND)
+
+typedef struct
+{
+  GstPoll *poll;
+  GList *sources;
+  guint n_sources;
+  GstClockTime next_tick;
+} GstRTSPReactorThread;
+
+struct _GstRTSPReactorSource
+{
+  gint refcount;
+
+  GstRTSPReactorThread *thread;
+  GstPollFD pfd;
+  GstRTSPReactorFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+
+  gboolean busy;
+  gboolean dispatching;
+  gboolean removed;
+};
+
+/* protects the threads and the sources */
+static GMutex *reactor_lock;
+static GCond *reactor_cond;
+static GstRTSPReactorThread *threads[MAX_THREADS];
+static guint n_threads;
+static guint max_threads;
+
+void
+gst_rtsp_reactor_init (void)
+{
+  GST_DEBUG_CATEGORY_INIT (rtspreactor_debug, "rtspreactor", 0,
+      "RTSP shared I/O reactor");
+
+  reactor_lock = g_mutex_new ();
+  reactor_cond = g_cond_new ();
+
+  max_threads = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  max_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN), 1, MAX_THREADS);
+#endif
+}
+
+static void
+gst_rtsp_reactor_source_unref (GstRTSPReactorSource * source)
+{
+  if (g_atomic_int_dec_and_test (&source->refcount)) {
+    if (source->notify)
+      source->notify (source->user_data);
+    g_slice_free (GstRTSPReactorSource, source);
+  }
+}
+
+/* stops watching @source, call with the reactor lock */
+static void
+gst_rtsp_reactor_detach (GstRTSPReactorSource * source)
+{
+  GstRTSPReactorThread *thread = source->thread;
+
+  if (thread == NULL)
+    return;
+
+  gst_poll_remove_fd (thread->poll, &source->pfd);
+  thread->sources = g_list_remove (thread->sources, source);
+  thread->n_sources--;
+  source->thread = NULL;
+
+  /* the caller has a ref of its own */
+  g_atomic_int_add (&source->refcount, -1);
+}
+
+static gpointer
+gst_rtsp_reactor_thread (GstRTSPReactorThread * thread)
+{
+  g_mutex_lock (reactor_lock);
+  while (TRUE) {
+    GstClockTime timeout, now;
+    GList *ready = NULL, *walk;
+    gboolean busy = FALSE, tick;
+
+    for (walk = thread->sources; walk; walk = g_list_next (walk))
+      busy |= ((GstRTSPReactorSource *) walk->data)->busy;
+
+    /* wait forever when there is nothing to watch */
+    if (busy) {
+      timeout = BUSY_INTERVAL;
+    } else if (thread->sources) {
+      now = gst_util_get_timestamp ();
+      timeout = thread->next_tick > now ? thread->next_tick - now : 0;
+    } else {
+      timeout = GST_CLOCK_TIME_NONE;
+    }
+    g_mutex_unlock (reactor_lock);
+
+    gst_poll_wait (thread->poll, timeout);
+
+    now = gst_util_get_timestamp ();
+    g_mutex_lock (reactor_lock);
+    tick = (now >= thread->next_tick);
+    if (tick)
+      thread->next_tick = now + TICK_INTERVAL;
+
+    for (walk = thread->sources; walk; walk = g_list_next (walk)) {
+      GstRTSPReactorSource *source = walk->data;
+
+      if (tick || source->busy ||
+          gst_poll_fd_can_read (thread->poll, &source->pfd)) {
+        g_atomic_int_inc (&source->refcount);
+        ready = g_list_prepend (ready, source);
+      }
+    }
+
+    for (walk = ready; walk; walk = g_list_next (walk)) {
+      GstRTSPReactorSource *source = walk->data;
+      GstRTSPReactorResult res;
+
+      /* removed while we dispatched the others */
+      if (source->removed)
+        continue;
+
+      source->dispatching = TRUE;
+      g_mutex_unlock (reactor_lock);
+      res = source->func (source->user_data);
+      g_mutex_lock (reactor_lock);
+      source->dispatching = FALSE;
+      g_cond_broadcast (reactor_cond);
+
+      if (source->thread == NULL)
+        continue;
+
+      switch (res) {
+        case GST_RTSP_REACTOR_CONTINUE:
+          if (source->busy) {
+            source->busy = FALSE;
+            gst_poll_fd_ctl_read (thread->poll, &source->pfd, TRUE);
+          }
+          break;
+        case GST_RTSP_REACTOR_BUSY:
+          /* don't spin on the data while the owner can't read it */
+          if (!source->busy) {
+            source->busy = TRUE;
+            gst_poll_fd_ctl_read (thread->poll, &source->pfd, FALSE);
+          }
+          break;
+        case GST_RTSP_REACTOR_REMOVE:
+          GST_DEBUG ("removing source %p", source);
+          gst_rtsp_reactor_detach (source);
+          break;
+      }
+    }
+
+    /* release outside of the lock, the owners may go away */
+    g_mutex_unlock (reactor_lock);
+    g_list_foreach (ready, (GFunc) gst_rtsp_reactor_source_unref, NULL);
+    g_list_free (ready);
+    g_mutex_lock (reactor_lock);
+  }
+
+  return NULL;
+}
+
+static GstRTSPReactorThread *
+gst_rtsp_reactor_thread_new (void)
+{
+  GstRTSPReactorThread *thread;
+  GError *error = NULL;
+
+  thread = g_slice_new0 (GstRTSPReactorThread);
+  thread->poll = gst_poll_new (TRUE);
+
+  if (!g_thread_create ((GThreadFunc) gst_rtsp_reactor_thread, thread, FALSE,
+          &error)) {
+    GST_WARNING ("could not create reactor thread: %s", error->message);
+    g_error_free (error);
+    gst_poll_free (thread->poll);
+    g_slice_free (GstRTSPReactorThread, thread);
+    return NULL;
+  }
+
+  GST_DEBUG ("started reactor thread %u", n_threads);
+
+  return thread;
+}
+
+/**
+ * gst_rtsp_reactor_add:
+ * @fd: the file descriptor to watch
+ * @func: the function to call when @fd can be read from
+ * @user_data: user data for @func
+ * @notify: called with @user_data when the source is freed
+ *
+ * Starts watching @fd from one of the reactor threads.
+ *
+ * Returns: a new source to pass to gst_rtsp_reactor_remove(), or NULL when no
+ * reactor thread could be started.
+ */
+GstRTSPReactorSource *
+gst_rtsp_reactor_add (gint fd, GstRTSPReactorFunc func, gpointer user_data,
+    GDestroyNotify notify)
+{
+  GstRTSPReactorSource *source;
+  GstRTSPReactorThread *thread = NULL, *new_thread;
+  guint i;
+
+  g_mutex_lock (reactor_lock);
+  /* take the thread with the least sources, but start a new thread for every
+   * source until we have one per CPU */
+  for (i = 0; i < n_threads; i++) {
+    if (thread == NULL || threads[i]->n_sources < thread->n_sources)
+      thread = threads[i];
+  }
+  if ((thread == NULL || thread->n_sources > 0) && n_threads < max_threads) {
+    if ((new_thread = gst_rtsp_reactor_thread_new ())) {
+      threads[n_threads++] = new_thread;
+      thread = new_thread;
+    }
+  }
+  if (thread == NULL) {
+    g_mutex_unlock (reactor_lock);
+    if (notify)
+      notify (user_data);
+    return NULL;
+  }
+
+  source = g_slice_new0 (GstRTSPReactorSource);
+  /* one for the caller, one for the thread */
+  source->refcount = 2;
+  source->thread = thread;
+  gst_poll_fd_init (&source->pfd);
+  source->pfd.fd = fd;
+  source->func = func;
+  source->user_data = user_data;
+  source->notify = notify;
+
+  thread->sources = g_list_prepend (thread->sources, source);
+  thread->n_sources++;
+  gst_poll_add_fd (thread->poll, &source->pfd);
+  gst_poll_fd_ctl_read (thread->poll, &source->pfd, TRUE);
+  /* wake up the thread so that it waits for the new source too */
+  gst_poll_restart (thread->poll);
+  g_mutex_unlock (reactor_lock);
+
+  GST_DEBUG ("added source %p for fd %d", source, fd);
+
+  return source;
+}
+
+/**
+ * gst_rtsp_reactor_remove:
+ * @source: a source
+ *
+ * Stops watching @source and releases it. When this function returns, the
+ * function of @source is not running and will not be called anymore.
+ */
+void
+gst_rtsp_reactor_remove (GstRTSPReactorSource * source)
+{
+  g_mutex_lock (reactor_lock);
+  source->removed = TRUE;
+  while (source->dispatching)
+    g_cond_wait (reactor_cond, reactor_lock);
+  gst_rtsp_reactor_detach (source);
+  g_mutex_unlock (reactor_lock);
+
+  GST_DEBUG ("removed source %p", source);
+
+  gst_rtsp_reactor_source_unref (source);
+}
@@ -0,0 +1,64 @@
+/* GStreamer
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_RTSP_REACTOR_H__
+#define __GST_RTSP_REACTOR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPReactorSource GstRTSPReactorSource;
+
+/**
+ * GstRTSPReactorResult:
+ * @GST_RTSP_REACTOR_CONTINUE: keep watching the source
+ * @GST_RTSP_REACTOR_BUSY: the owner of the source is busy, try again soon
+ * @GST_RTSP_REACTOR_REMOVE: stop watching the source
+ *
+ * What the reactor should do with a source after dispatching it.
+ */
+typedef enum
+{
+  GST_RTSP_REACTOR_CONTINUE,
+  GST_RTSP_REACTOR_BUSY,
+  GST_RTSP_REACTOR_REMOVE
+} GstRTSPReactorResult;
+
+/**
+ * GstRTSPReactorFunc:
+ * @user_data: the user data of the source
+ *
+ * Called from one of the reactor threads when the file descriptor of a source
+ * can be read from, and about once a second so that the owner can handle
+ * its timeouts. It must not block.
+ *
+ * Returns: what to do with the source next.
+ */
+typedef GstRTSPReactorResult (*GstRTSPReactorFunc) (gpointer user_data);
+
+void                    gst_rtsp_reactor_init    (void);
+
+GstRTSPReactorSource *  gst_rtsp_reactor_add     (gint fd, GstRTSPReactorFunc func,
+                                                  gpointer user_data, GDestroyNotify notify);
+void                    gst_rtsp_reactor_remove  (GstRTSPReactorSource *source);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_REACTOR_H__ */
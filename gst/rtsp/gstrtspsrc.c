@@ -66,6 +66,22 @@
  * rtspsrc acts like a live source and will therefore only generate data in the
  * PLAYING state.
  *
+ * Every rtspsrc normally reads from its connection with a thread of its own.
+ * When many streams are received over interleaved TCP in one process, for
+ * example from a large number of cameras, #GstRTSPSrc:shared-io makes them
+ * share a small set of threads instead, at most one per CPU. Only the reading
+ * of the TCP connection is shared: keep-alives and replies to the server are
+ * still sent from the thread of the element, which is only woken up for that,
+ * and the rtpbin inside rtspsrc keeps its own threads. The shared threads
+ * never push downstream: they only hand the packets to rtpbin, whose
+ * jitterbuffers push them on, so the I/O is not shared when rtpbin is not
+ * available. EOS and errors are handled by the thread of the element as well.
+ * Sessions over UDP are not affected, their udpsrc elements and the thread
+ * that watches the RTSP connection work as before. The
+ * rtspsrc-shared-io-benchmark program in tests/icles compares the number of
+ * threads and context switches of both modes for a given number of streams
+ * from a local test server.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -93,6 +109,7 @@
 #include <locale.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <errno.h>
 
 #include <gst/sdp/gstsdpmessage.h>
 #include <gst/rtp/gstrtppayloads.h>
@@ -103,6 +120,9 @@
 
 #ifdef G_OS_WIN32
 #include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
 #endif
 
 GST_DEBUG_CATEGORY_STATIC (rtspsrc_debug);
@@ -185,6 +205,17 @@ gst_rtsp_src_buffer_mode_get_type (void)
 #define DEFAULT_BUFFER_MODE      BUFFER_MODE_AUTO
 #define DEFAULT_PORT_RANGE       NULL
 #define DEFAULT_SHORT_HEADER     FALSE
+#define DEFAULT_TCP_BULK_SIZE    0
+#define DEFAULT_SHARED_IO        FALSE
+
+/* number of released chunks we keep around for bulk reading */
+#define BULK_POOL_SIZE           4
+/* max size of the headers of an RTSP message in interleaved data */
+#define BULK_MAX_HEADER_SIZE     65536
+/* how long to wait for the rest of a message when we stop reading in bulk */
+#define BULK_DRAIN_TIMEOUT       (2 * GST_SECOND)
+/* chunk size for shared I/O when tcp-bulk-size is not set */
+#define SHARED_IO_BULK_SIZE      65536
 
 enum
 {
@@ -207,6 +238,8 @@ enum
   PROP_PORT_RANGE,
   PROP_UDP_BUFFER_SIZE,
   PROP_SHORT_HEADER,
+  PROP_TCP_BULK_SIZE,
+  PROP_SHARED_IO,
   PROP_LAST
 };
 
@@ -272,6 +305,7 @@ static gboolean gst_rtspsrc_uri_set_uri (GstURIHandler * handler,
 
 static gboolean gst_rtspsrc_activate_streams (GstRTSPSrc * src);
 static gboolean gst_rtspsrc_loop (GstRTSPSrc * src);
+static void gst_rtspsrc_bulk_reset (GstRTSPSrc * src);
 static gboolean gst_rtspsrc_stream_push_event (GstRTSPSrc * src,
     GstRTSPStream * stream, GstEvent * event, gboolean source);
 static gboolean gst_rtspsrc_push_event (GstRTSPSrc * src, GstEvent * event,
@@ -496,12 +530,51 @@ gst_rtspsrc_class_init (GstRTSPSrcClass * klass)
           "Only send the basic RTSP headers for broken encoders",
           DEFAULT_SHORT_HEADER, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPSrc::tcp-bulk-size:
+   *
+   * Read interleaved TCP data in chunks of this many bytes instead of packet
+   * by packet. The packets in a chunk are pushed downstream without copying,
+   * as one buffer list per stream. Tunneled connections are always read
+   * packet by packet.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_TCP_BULK_SIZE,
+      g_param_spec_uint ("tcp-bulk-size", "TCP Bulk Size",
+          "Size of the chunks interleaved TCP data is read in "
+          "(0 = read packet by packet)", 0, 16 * 1024 * 1024,
+          DEFAULT_TCP_BULK_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstRTSPSrc::shared-io:
+   *
+   * Read interleaved TCP data from a small set of threads that is shared by
+   * all rtspsrc elements in the process, instead of from a thread of our
+   * own. The data is read in chunks of #GstRTSPSrc:tcp-bulk-size bytes, or
+   * 64 KiB when that is not set. Keep-alives and replies to the server are
+   * sent from the thread of the element, which is woken up for them. The
+   * shared threads only hand the packets to the RTP session manager, this
+   * property has no effect when gstrtpbin is not available. Streams
+   * received over UDP or a tunneled connection are not affected.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_SHARED_IO,
+      g_param_spec_boolean ("shared-io", "Shared I/O",
+          "Read interleaved TCP data from threads shared by all rtspsrc "
+          "elements", DEFAULT_SHARED_IO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   gstelement_class->send_event = gst_rtspsrc_send_event;
   gstelement_class->change_state = gst_rtspsrc_change_state;
 
   gstbin_class->handle_message = gst_rtspsrc_handle_message;
 
   gst_rtsp_ext_list_init ();
+  gst_rtsp_reactor_init ();
 }
 
 
@@ -535,6 +608,12 @@ gst_rtspsrc_init (GstRTSPSrc * src, GstRTSPSrcClass * g_class)
   src->client_port_range.max = 0;
   src->udp_buffer_size = DEFAULT_UDP_BUFFER_SIZE;
   src->short_header = DEFAULT_SHORT_HEADER;
+  src->tcp_bulk_size = DEFAULT_TCP_BULK_SIZE;
+  src->shared_io = DEFAULT_SHARED_IO;
+
+  src->bulk_poll = gst_poll_new (TRUE);
+  gst_poll_fd_init (&src->bulk_pollfd);
+  g_queue_init (&src->bulk_pool);
 
   /* get a list of all extensions */
   src->extensions = gst_rtsp_ext_list_get ();
@@ -571,6 +650,11 @@ gst_rtspsrc_finalize (GObject * object)
   g_free (rtspsrc->user_id);
   g_free (rtspsrc->user_pw);
 
+  gst_rtspsrc_bulk_reset (rtspsrc);
+  g_queue_foreach (&rtspsrc->bulk_pool, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (&rtspsrc->bulk_pool);
+  gst_poll_free (rtspsrc->bulk_poll);
+
   if (rtspsrc->sdp) {
     gst_sdp_message_free (rtspsrc->sdp);
     rtspsrc->sdp = NULL;
@@ -731,6 +815,12 @@ gst_rtspsrc_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_SHORT_HEADER:
       rtspsrc->short_header = g_value_get_boolean (value);
       break;
+    case PROP_TCP_BULK_SIZE:
+      rtspsrc->tcp_bulk_size = g_value_get_uint (value);
+      break;
+    case PROP_SHARED_IO:
+      rtspsrc->shared_io = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -826,6 +916,12 @@ gst_rtspsrc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_SHORT_HEADER:
       g_value_set_boolean (value, rtspsrc->short_header);
       break;
+    case PROP_TCP_BULK_SIZE:
+      g_value_set_uint (value, rtspsrc->tcp_bulk_size);
+      break;
+    case PROP_SHARED_IO:
+      g_value_set_boolean (value, rtspsrc->shared_io);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3390,6 +3486,8 @@ gst_rtsp_conninfo_close (GstRTSPSrc * src, GstRTSPConnInfo * info,
     gst_rtsp_connection_close (info->connection);
     info->connected = FALSE;
   }
+  if (info == &src->conninfo)
+    gst_rtspsrc_bulk_reset (src);
   if (free && info->connection) {
     /* free connection */
     GST_DEBUG_OBJECT (src, "freeing connection...");
@@ -3422,6 +3520,7 @@ gst_rtspsrc_connection_flush (GstRTSPSrc * src, gboolean flush)
     GST_DEBUG_OBJECT (src, "connection flush");
     gst_rtsp_connection_flush (src->conninfo.connection, flush);
   }
+  gst_poll_set_flushing (src->bulk_poll, flush);
   for (walk = src->streams; walk; walk = g_list_next (walk)) {
     GstRTSPStream *stream = (GstRTSPStream *) walk->data;
     GST_DEBUG_OBJECT (src, "stream %p flush", stream);
@@ -3537,6 +3636,85 @@ send_error:
   }
 }
 
+/* Finds the stream and the pad for the packet @data received on the
+ * interleaved @channel. @data must be at least 2 bytes. */
+static GstPad *
+gst_rtspsrc_find_channel_pad (GstRTSPSrc * src, gint channel,
+    const guint8 * data, GstRTSPStream ** stream, gboolean * is_rtcp)
+{
+  GstRTSPStream *s;
+
+  s = find_stream (src, &channel, (gpointer) find_stream_by_channel);
+  if (!s)
+    return NULL;
+
+  *stream = s;
+
+  /* channels are not correct on some servers, do extra check */
+  if (data[1] >= 200 && data[1] <= 204) {
+    /* hmm RTCP message switch to the RTCP pad of the same stream. */
+    *is_rtcp = TRUE;
+    return s->channelpad[1];
+  }
+
+  *is_rtcp = (channel == s->channel[1]);
+
+  return s->channelpad[*is_rtcp ? 1 : 0];
+}
+
+/* Prepares @buf, received on @stream, for pushing downstream */
+static void
+gst_rtspsrc_prepare_buffer (GstRTSPSrc * src, GstRTSPStream * stream,
+    GstBuffer * buf, gboolean is_rtcp)
+{
+  if (src->need_activate) {
+    gst_rtspsrc_activate_streams (src);
+    src->need_activate = FALSE;
+  }
+
+  if (!src->manager) {
+    /* set stream caps on buffer when we don't have a session manager to do it
+     * for us */
+    gst_buffer_set_caps (buf, stream->caps);
+  }
+
+  if (src->base_time == -1) {
+    /* Take current running_time. This timestamp will be put on
+     * the first buffer of each stream because we are a live source and so we
+     * timestamp with the running_time. When we are dealing with TCP, we also
+     * only timestamp the first buffer (using the DISCONT flag) because a server
+     * typically bursts data, for which we don't want to compensate by speeding
+     * up the media. The other timestamps will be interpollated from this one
+     * using the RTP timestamps. */
+    GST_OBJECT_LOCK (src);
+    if (GST_ELEMENT_CLOCK (src)) {
+      GstClockTime now;
+      GstClockTime base_time;
+
+      now = gst_clock_get_time (GST_ELEMENT_CLOCK (src));
+      base_time = GST_ELEMENT_CAST (src)->base_time;
+
+      src->base_time = now - base_time;
+
+      GST_DEBUG_OBJECT (src, "first buffer at time %" GST_TIME_FORMAT ", base %"
+          GST_TIME_FORMAT, GST_TIME_ARGS (now), GST_TIME_ARGS (base_time));
+    }
+    GST_OBJECT_UNLOCK (src);
+  }
+
+  if (stream->discont && !is_rtcp) {
+    /* mark first RTP buffer as discont */
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    stream->discont = FALSE;
+    /* first buffer gets the timestamp, other buffers are not timestamped and
+     * their presentation time will be interpollated from the rtp timestamps. */
+    GST_DEBUG_OBJECT (src, "setting timestamp %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (src->base_time));
+
+    GST_BUFFER_TIMESTAMP (buf) = src->base_time;
+  }
+}
+
 static GstFlowReturn
 gst_rtspsrc_loop_interleaved (GstRTSPSrc * src)
 {
@@ -3630,31 +3808,13 @@ gst_rtspsrc_loop_interleaved (GstRTSPSrc * src)
 
   channel = message.type_data.data.channel;
 
-  stream = find_stream (src, &channel, (gpointer) find_stream_by_channel);
-  if (!stream)
-    goto unknown_stream;
-
-  if (channel == stream->channel[0]) {
-    outpad = stream->channelpad[0];
-    is_rtcp = FALSE;
-  } else if (channel == stream->channel[1]) {
-    outpad = stream->channelpad[1];
-    is_rtcp = TRUE;
-  } else {
-    is_rtcp = FALSE;
-  }
-
   /* take a look at the body to figure out what we have */
   gst_rtsp_message_get_body (&message, &data, &size);
   if (size < 2)
     goto invalid_length;
 
-  /* channels are not correct on some servers, do extra check */
-  if (data[1] >= 200 && data[1] <= 204) {
-    /* hmm RTCP message switch to the RTCP pad of the same stream. */
-    outpad = stream->channelpad[1];
-    is_rtcp = TRUE;
-  }
+  outpad = gst_rtspsrc_find_channel_pad (src, channel, data, &stream,
+      &is_rtcp);
 
   /* we have no clue what this is, just ignore then. */
   if (outpad == NULL)
@@ -3677,52 +3837,7 @@ gst_rtspsrc_loop_interleaved (GstRTSPSrc * src)
   GST_DEBUG_OBJECT (src, "pushing data of size %d on channel %d", size,
       channel);
 
-  if (src->need_activate) {
-    gst_rtspsrc_activate_streams (src);
-    src->need_activate = FALSE;
-  }
-
-  if (!src->manager) {
-    /* set stream caps on buffer when we don't have a session manager to do it
-     * for us */
-    gst_buffer_set_caps (buf, stream->caps);
-  }
-
-  if (src->base_time == -1) {
-    /* Take current running_time. This timestamp will be put on
-     * the first buffer of each stream because we are a live source and so we
-     * timestamp with the running_time. When we are dealing with TCP, we also
-     * only timestamp the first buffer (using the DISCONT flag) because a server
-     * typically bursts data, for which we don't want to compensate by speeding
-     * up the media. The other timestamps will be interpollated from this one
-     * using the RTP timestamps. */
-    GST_OBJECT_LOCK (src);
-    if (GST_ELEMENT_CLOCK (src)) {
-      GstClockTime now;
-      GstClockTime base_time;
-
-      now = gst_clock_get_time (GST_ELEMENT_CLOCK (src));
-      base_time = GST_ELEMENT_CAST (src)->base_time;
-
-      src->base_time = now - base_time;
-
-      GST_DEBUG_OBJECT (src, "first buffer at time %" GST_TIME_FORMAT ", base %"
-          GST_TIME_FORMAT, GST_TIME_ARGS (now), GST_TIME_ARGS (base_time));
-    }
-    GST_OBJECT_UNLOCK (src);
-  }
-
-  if (stream->discont && !is_rtcp) {
-    /* mark first RTP buffer as discont */
-    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
-    stream->discont = FALSE;
-    /* first buffer gets the timestamp, other buffers are not timestamped and
-     * their presentation time will be interpollated from the rtp timestamps. */
-    GST_DEBUG_OBJECT (src, "setting timestamp %" GST_TIME_FORMAT,
-        GST_TIME_ARGS (src->base_time));
-
-    GST_BUFFER_TIMESTAMP (buf) = src->base_time;
-  }
+  gst_rtspsrc_prepare_buffer (src, stream, buf, is_rtcp);
 
   /* chain to the peer pad */
   if (GST_PAD_IS_SINK (outpad))
@@ -3789,6 +3904,521 @@ invalid_length:
   }
 }
 
+/* Returns how many bytes are missing for the interleaved data or RTSP message
+ * at the start of @data, or 0 when @data contains all of it, in which case
+ * its size is put in @msg_size. For RTSP messages of which we don't have all
+ * headers yet, we don't know how many bytes are missing and return 1. */
+static guint
+gst_rtspsrc_bulk_missing (const guint8 * data, guint size, guint * msg_size)
+{
+  const gchar *p, *end, *eol;
+  guint header_size, body_size;
+
+  if (size < 4)
+    return 4 - size;
+
+  if (data[0] == '$') {
+    /* '$', channel and 16 bits length */
+    *msg_size = 4 + GST_READ_UINT16_BE (data + 2);
+  } else {
+    /* headers up to an empty line, then as much body as the Content-Length
+     * header says */
+    p = (const gchar *) data;
+    end = p + size - 3;
+    for (; p < end; p++) {
+      if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n')
+        break;
+    }
+    if (p == end)
+      return 1;
+    header_size = p + 4 - (const gchar *) data;
+
+    body_size = 0;
+    end = p + 2;
+    for (p = (const gchar *) data; p < end; p = eol + 2) {
+      eol = memchr (p, '\r', end - p);
+      if (g_ascii_strncasecmp (p, "Content-Length:", 15) == 0)
+        body_size = strtoul (p + 15, NULL, 10);
+    }
+    *msg_size = header_size + body_size;
+  }
+
+  if (size < *msg_size)
+    return *msg_size - size;
+
+  return 0;
+}
+
+/* Makes room for at least @size more bytes of data. When the current chunk
+ * is too small, the unparsed data is copied to a new one. Chunks that still
+ * have packets downstream are kept in a pool and reused once all of them are
+ * released. */
+static void
+gst_rtspsrc_bulk_reserve (GstRTSPSrc * src, guint size)
+{
+  GstBuffer *chunk = NULL;
+  guint avail, chunk_size;
+  GList *walk;
+
+  if (src->bulk_buf &&
+      src->bulk_filled + size <= GST_BUFFER_SIZE (src->bulk_buf))
+    return;
+
+  avail = src->bulk_filled - src->bulk_offset;
+  chunk_size = src->tcp_bulk_size ? src->tcp_bulk_size : SHARED_IO_BULK_SIZE;
+  chunk_size = MAX (chunk_size, avail + size);
+
+  for (walk = src->bulk_pool.head; walk; walk = g_list_next (walk)) {
+    GstBuffer *buf = walk->data;
+
+    if (GST_MINI_OBJECT_REFCOUNT_VALUE (buf) == 1 &&
+        GST_BUFFER_SIZE (buf) >= chunk_size) {
+      g_queue_delete_link (&src->bulk_pool, walk);
+      chunk = buf;
+      break;
+    }
+  }
+  if (chunk == NULL)
+    chunk = gst_buffer_new_and_alloc (chunk_size);
+
+  if (src->bulk_buf) {
+    memcpy (GST_BUFFER_DATA (chunk),
+        GST_BUFFER_DATA (src->bulk_buf) + src->bulk_offset, avail);
+    g_queue_push_tail (&src->bulk_pool, src->bulk_buf);
+    if (g_queue_get_length (&src->bulk_pool) > BULK_POOL_SIZE)
+      gst_buffer_unref (g_queue_pop_head (&src->bulk_pool));
+  }
+
+  src->bulk_buf = chunk;
+  src->bulk_offset = 0;
+  src->bulk_filled = avail;
+}
+
+/* reads at most @size bytes after the data we have */
+static GstRTSPResult
+gst_rtspsrc_bulk_read (GstRTSPSrc * src, guint size)
+{
+  gint r;
+
+  r = recv (src->bulk_pollfd.fd, (gchar *) GST_BUFFER_DATA (src->bulk_buf) +
+      src->bulk_filled, size, 0);
+  if (r == 0)
+    return GST_RTSP_EEOF;
+  if (r < 0) {
+    if (errno == EAGAIN || errno == EINTR)
+      return GST_RTSP_OK;
+    return GST_RTSP_ESYS;
+  }
+
+  src->bulk_filled += r;
+
+  return GST_RTSP_OK;
+}
+
+/* drops the data we did not parse yet and stops polling the connection */
+static void
+gst_rtspsrc_bulk_reset (GstRTSPSrc * src)
+{
+  if (src->bulk_pollfd.fd != -1) {
+    gst_poll_remove_fd (src->bulk_poll, &src->bulk_pollfd);
+    gst_poll_fd_init (&src->bulk_pollfd);
+  }
+  if (src->bulk_buf) {
+    gst_buffer_unref (src->bulk_buf);
+    src->bulk_buf = NULL;
+  }
+  src->bulk_offset = 0;
+  src->bulk_filled = 0;
+  src->reactor_handback = FALSE;
+  src->reactor_ret = GST_FLOW_OK;
+}
+
+/* When we stop with the start of a message in the current chunk, the rest of
+ * it is still in the socket and would confuse the connection when it is used
+ * for the control messages while we are paused. Read the rest of the message
+ * and drop it. */
+static void
+gst_rtspsrc_bulk_drain (GstRTSPSrc * src)
+{
+  GstPoll *poll;
+  guint missing, msg_size;
+  gint r;
+
+  if (src->bulk_pollfd.fd == -1 || src->bulk_offset == src->bulk_filled)
+    return;
+
+  GST_DEBUG_OBJECT (src, "reading the rest of the last message");
+
+  /* the connection may still be flushing, don't use our own poll */
+  poll = gst_poll_new (FALSE);
+  gst_poll_add_fd (poll, &src->bulk_pollfd);
+  gst_poll_fd_ctl_read (poll, &src->bulk_pollfd, TRUE);
+
+  while ((missing = gst_rtspsrc_bulk_missing (GST_BUFFER_DATA (src->bulk_buf)
+              + src->bulk_offset, src->bulk_filled - src->bulk_offset,
+              &msg_size)) > 0) {
+    gst_rtspsrc_bulk_reserve (src, missing);
+
+    r = gst_poll_wait (poll, BULK_DRAIN_TIMEOUT);
+    if (r == 0 || (r < 0 && errno != EINTR && errno != EAGAIN))
+      break;
+    if (gst_rtspsrc_bulk_read (src, missing) != GST_RTSP_OK)
+      break;
+  }
+  gst_poll_free (poll);
+
+  if (missing > 0)
+    GST_WARNING_OBJECT (src, "could not read the rest of the last message");
+
+  src->bulk_offset = src->bulk_filled = 0;
+}
+
+/* Parses the RTSP message of @size bytes in @data into @msg */
+static GstRTSPResult
+gst_rtspsrc_bulk_parse_message (GstRTSPSrc * src, const guint8 * data,
+    guint size, GstRTSPMessage * msg)
+{
+  gchar **lines, **parts;
+  guint header_size, i;
+  GstRTSPResult res;
+  gchar *headers;
+  const gchar *body;
+
+  body = g_strstr_len ((const gchar *) data, size, "\r\n\r\n") + 4;
+  header_size = body - (const gchar *) data;
+  headers = g_strndup ((const gchar *) data, header_size - 4);
+  lines = g_strsplit (headers, "\r\n", -1);
+  g_free (headers);
+
+  /* RTSP/1.0 <code> <reason> or <method> <uri> RTSP/1.0 */
+  parts = g_strsplit (lines[0], " ", 3);
+  if (g_strv_length (parts) < 3) {
+    res = GST_RTSP_EPARSE;
+  } else if (g_str_has_prefix (parts[0], "RTSP/")) {
+    res = gst_rtsp_message_init_response (msg, atoi (parts[1]), parts[2],
+        NULL);
+  } else {
+    res = gst_rtsp_message_init_request (msg, gst_rtsp_find_method (parts[0]),
+        parts[1]);
+  }
+  g_strfreev (parts);
+
+  for (i = 1; res == GST_RTSP_OK && lines[i]; i++) {
+    GstRTSPHeaderField field;
+    gchar *value;
+
+    if ((value = strchr (lines[i], ':')) == NULL)
+      continue;
+    *value++ = '\0';
+    field = gst_rtsp_find_header_field (g_strstrip (lines[i]));
+    if (field != GST_RTSP_HDR_INVALID)
+      gst_rtsp_message_add_header (msg, field, g_strstrip (value));
+  }
+  g_strfreev (lines);
+
+  if (res == GST_RTSP_OK && size > header_size)
+    res = gst_rtsp_message_set_body (msg, (guint8 *) body, size - header_size);
+
+  return res;
+}
+
+typedef struct
+{
+  GstRTSPStream *stream;
+  GstPad *pad;
+  gboolean is_rtcp;
+  GstBufferList *list;
+  GstBufferListIterator *it;
+} GstRTSPSrcBatch;
+
+/* adds @buf to the buffer list we will push on @pad */
+static GSList *
+gst_rtspsrc_batch_add (GSList * batches, GstRTSPStream * stream, GstPad * pad,
+    gboolean is_rtcp, GstBuffer * buf)
+{
+  GstRTSPSrcBatch *batch = NULL;
+  GSList *walk;
+
+  for (walk = batches; walk; walk = g_slist_next (walk)) {
+    if (((GstRTSPSrcBatch *) walk->data)->pad == pad) {
+      batch = walk->data;
+      break;
+    }
+  }
+  if (batch == NULL) {
+    batch = g_slice_new (GstRTSPSrcBatch);
+    batch->stream = stream;
+    batch->pad = pad;
+    batch->is_rtcp = is_rtcp;
+    batch->list = gst_buffer_list_new ();
+    batch->it = gst_buffer_list_iterate (batch->list);
+    batches = g_slist_append (batches, batch);
+  }
+
+  /* one group per packet */
+  gst_buffer_list_iterator_add_group (batch->it);
+  gst_buffer_list_iterator_add (batch->it, buf);
+
+  return batches;
+}
+
+/* pushes the buffer lists and returns the first flow that is not OK */
+static GstFlowReturn
+gst_rtspsrc_batch_push (GstRTSPSrc * src, GSList * batches)
+{
+  GstFlowReturn ret = GST_FLOW_OK, res;
+  GSList *walk;
+
+  for (walk = batches; walk; walk = g_slist_next (walk)) {
+    GstRTSPSrcBatch *batch = walk->data;
+
+    gst_buffer_list_iterator_free (batch->it);
+
+    GST_DEBUG_OBJECT (src, "pushing %u packets on %s:%s",
+        gst_buffer_list_n_groups (batch->list),
+        GST_DEBUG_PAD_NAME (batch->pad));
+
+    /* chain to the peer pad */
+    if (GST_PAD_IS_SINK (batch->pad))
+      res = gst_pad_chain_list (batch->pad, batch->list);
+    else
+      res = gst_pad_push_list (batch->pad, batch->list);
+
+    if (!batch->is_rtcp) {
+      /* combine all stream flows for the data transport */
+      res = gst_rtspsrc_combine_flows (src, batch->stream, res);
+    }
+    if (ret == GST_FLOW_OK)
+      ret = res;
+
+    g_slice_free (GstRTSPSrcBatch, batch);
+  }
+  g_slist_free (batches);
+
+  return ret;
+}
+
+/* Reads interleaved data in chunks of tcp-bulk-size bytes and pushes the
+ * packets of a chunk as sub-buffers of it, grouped per pad in buffer lists.
+ * The RTSP messages the server sends in between are handled here as well.
+ * From the reactor, we only read what is available and never wait. Partial
+ * messages stay in the chunk for the next time, and when something has to be
+ * sent we stop and hand the connection back to the streaming task. */
+static GstFlowReturn
+gst_rtspsrc_loop_interleaved_bulk (GstRTSPSrc * src)
+{
+  GstRTSPMessage message = { 0 };
+  GstRTSPResult res;
+  GSList *batches = NULL;
+  GstFlowReturn ret;
+  gint fd, r;
+
+  fd = gst_rtsp_connection_get_readfd (src->conninfo.connection);
+  if (fd != src->bulk_pollfd.fd) {
+    gst_rtspsrc_bulk_reset (src);
+    src->bulk_pollfd.fd = fd;
+    gst_poll_add_fd (src->bulk_poll, &src->bulk_pollfd);
+    gst_poll_fd_ctl_read (src->bulk_poll, &src->bulk_pollfd, TRUE);
+  }
+
+  /* the streaming task still has to take over */
+  if (src->reactor_source && src->reactor_handback)
+    return GST_FLOW_OK;
+
+  while (TRUE) {
+    GTimeVal tv_timeout;
+    GstClockTime timeout;
+    guint8 *data;
+    guint avail, missing, msg_size, filled;
+
+    data = src->bulk_buf ? GST_BUFFER_DATA (src->bulk_buf) +
+        src->bulk_offset : NULL;
+    avail = src->bulk_filled - src->bulk_offset;
+
+    missing = gst_rtspsrc_bulk_missing (data, avail, &msg_size);
+    if (missing == 0) {
+      src->bulk_offset += msg_size;
+
+      if (data[0] == '$') {
+        GstRTSPStream *stream;
+        GstPad *outpad;
+        gboolean is_rtcp;
+        GstBuffer *buf;
+
+        if (msg_size < 6) {
+          GST_ELEMENT_WARNING (src, RESOURCE, READ, (NULL),
+              ("Short message received, ignoring."));
+          continue;
+        }
+
+        outpad = gst_rtspsrc_find_channel_pad (src, data[1], data + 4,
+            &stream, &is_rtcp);
+        if (outpad == NULL) {
+          GST_DEBUG_OBJECT (src, "unknown stream on channel %d, ignored",
+              data[1]);
+          continue;
+        }
+
+        buf = gst_buffer_create_sub (src->bulk_buf, src->bulk_offset -
+            msg_size + 4, msg_size - 4);
+        gst_rtspsrc_prepare_buffer (src, stream, buf, is_rtcp);
+        batches = gst_rtspsrc_batch_add (batches, stream, outpad, is_rtcp,
+            buf);
+        continue;
+      }
+
+      res = gst_rtspsrc_bulk_parse_message (src, data, msg_size, &message);
+      if (res < 0)
+        goto receive_error;
+
+      if (message.type == GST_RTSP_MESSAGE_REQUEST && src->reactor_source) {
+        /* replying may block, leave the request for the streaming task */
+        src->bulk_offset -= msg_size;
+        src->reactor_handback = TRUE;
+        gst_rtsp_message_unset (&message);
+        break;
+      } else if (message.type == GST_RTSP_MESSAGE_REQUEST) {
+        /* server sends us a request message, handle it */
+        res =
+            gst_rtspsrc_handle_request (src, src->conninfo.connection,
+            &message);
+        if (res == GST_RTSP_EEOF)
+          goto server_eof;
+        else if (res < 0)
+          goto handle_request_failed;
+      } else {
+        /* we ignore response messages */
+        GST_DEBUG_OBJECT (src, "ignoring response message");
+        if (src->debug)
+          gst_rtsp_message_dump (&message);
+      }
+      gst_rtsp_message_unset (&message);
+      continue;
+    }
+
+    /* push what we have before waiting for more */
+    if (batches)
+      break;
+
+    if (avail > BULK_MAX_HEADER_SIZE && data[0] != '$') {
+      res = GST_RTSP_EPARSE;
+      goto receive_error;
+    }
+
+    /* read as much as we can, but at least enough for this message */
+    gst_rtspsrc_bulk_reserve (src, missing);
+
+    /* get the next timeout interval */
+    gst_rtsp_connection_next_timeout (src->conninfo.connection, &tv_timeout);
+
+    /* see if the timeout period expired */
+    if ((tv_timeout.tv_sec | tv_timeout.tv_usec) == 0 && src->reactor_source) {
+      /* sending may block, leave the keep-alive to the streaming task */
+      src->reactor_handback = TRUE;
+      break;
+    } else if ((tv_timeout.tv_sec | tv_timeout.tv_usec) == 0) {
+      GST_DEBUG_OBJECT (src, "timout, sending keep-alive");
+      /* send keep-alive, only act on interrupt, a warning will be posted for
+       * other errors. */
+      if ((res = gst_rtspsrc_send_keep_alive (src)) == GST_RTSP_EINTR)
+        goto interrupt;
+    }
+
+    if (src->reactor_handback && src->reactor_source == NULL) {
+      /* we did what the reactor could not, let it read again */
+      src->reactor_handback = FALSE;
+      break;
+    }
+
+    if (src->reactor_source == NULL) {
+      if (src->ptcp_timeout)
+        timeout = GST_TIMEVAL_TO_TIME (*src->ptcp_timeout);
+      else
+        timeout = GST_CLOCK_TIME_NONE;
+
+      r = gst_poll_wait (src->bulk_poll, timeout);
+      if (r == 0) {
+        /* no data, send keep alive */
+        GST_DEBUG_OBJECT (src, "timeout, sending keep-alive");
+        if ((res = gst_rtspsrc_send_keep_alive (src)) == GST_RTSP_EINTR)
+          goto interrupt;
+        continue;
+      } else if (r < 0) {
+        /* we got interrupted this means we need to stop */
+        if (errno == EBUSY)
+          goto interrupt;
+        if (errno == EAGAIN || errno == EINTR)
+          continue;
+        res = GST_RTSP_ESYS;
+        goto receive_error;
+      }
+    }
+
+    filled = src->bulk_filled;
+    res = gst_rtspsrc_bulk_read (src,
+        GST_BUFFER_SIZE (src->bulk_buf) - src->bulk_filled);
+    if (res == GST_RTSP_EEOF)
+      goto server_eof;
+    else if (res < 0)
+      goto receive_error;
+
+    /* nothing more to read, let the reactor wait for more */
+    if (src->reactor_source && src->bulk_filled == filled)
+      break;
+  }
+
+  ret = gst_rtspsrc_batch_push (src, batches);
+  /* the reactor can't wait for the rest, the streaming task reads it when it
+   * takes over for the next command */
+  if (ret != GST_FLOW_OK && src->reactor_source == NULL)
+    gst_rtspsrc_bulk_drain (src);
+
+  return ret;
+
+  /* ERRORS */
+server_eof:
+  {
+    GST_DEBUG_OBJECT (src, "we got an eof from the server");
+    GST_ELEMENT_WARNING (src, RESOURCE, READ, (NULL),
+        ("The server closed the connection."));
+    src->conninfo.connected = FALSE;
+    gst_rtsp_message_unset (&message);
+    gst_rtspsrc_batch_push (src, batches);
+    return GST_FLOW_UNEXPECTED;
+  }
+interrupt:
+  {
+    GST_DEBUG_OBJECT (src, "got interrupted: stop connection flush");
+    gst_rtspsrc_connection_flush (src, FALSE);
+    if (src->reactor_source == NULL)
+      gst_rtspsrc_bulk_drain (src);
+    return GST_FLOW_WRONG_STATE;
+  }
+receive_error:
+  {
+    gchar *str = gst_rtsp_strresult (res);
+
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Could not receive message. (%s)", str));
+    g_free (str);
+
+    gst_rtsp_message_unset (&message);
+    gst_rtspsrc_batch_push (src, batches);
+    return GST_FLOW_ERROR;
+  }
+handle_request_failed:
+  {
+    gchar *str = gst_rtsp_strresult (res);
+
+    GST_ELEMENT_ERROR (src, RESOURCE, WRITE, (NULL),
+        ("Could not handle server message. (%s)", str));
+    g_free (str);
+    gst_rtsp_message_unset (&message);
+    gst_rtspsrc_batch_push (src, batches);
+    return GST_FLOW_ERROR;
+  }
+}
+
 static GstFlowReturn
 gst_rtspsrc_loop_udp (GstRTSPSrc * src)
 {
@@ -4136,18 +4766,110 @@ gst_rtspsrc_loop_send_cmd (GstRTSPSrc * src, gint cmd, gboolean flush)
   GST_OBJECT_UNLOCK (src);
 }
 
+/* The reactor threads must not push downstream, so we only share the I/O
+ * when all packets go into the session manager. Its jitterbuffers push the
+ * packets from threads of their own. */
+static gboolean
+gst_rtspsrc_can_share_io (GstRTSPSrc * src)
+{
+  GList *walk;
+
+  if (src->manager == NULL)
+    return FALSE;
+
+  for (walk = src->streams; walk; walk = g_list_next (walk)) {
+    GstRTSPStream *stream = (GstRTSPStream *) walk->data;
+
+    if (stream->channelpad[0] && !GST_PAD_IS_SINK (stream->channelpad[0]))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* called from a reactor thread when there is data for us or when we might
+ * have to send a keep-alive */
+static GstRTSPReactorResult
+gst_rtspsrc_reactor_dispatch (GstRTSPSrc * src)
+{
+  gboolean running, handback;
+
+  /* the streaming task is running a command or someone is stopping the
+   * streaming, try again later */
+  if (!g_static_rec_mutex_trylock (GST_RTSP_STREAM_GET_LOCK (src)))
+    return GST_RTSP_REACTOR_BUSY;
+
+  running = gst_rtspsrc_loop (src);
+  handback = src->reactor_handback;
+  GST_RTSP_STREAM_UNLOCK (src);
+
+  if (!running)
+    return GST_RTSP_REACTOR_REMOVE;
+
+  if (handback) {
+    /* something has to be sent, wake up the streaming task to take over,
+     * unless it will already for a command */
+    GST_DEBUG_OBJECT (src, "handing the connection back to the task");
+    GST_OBJECT_LOCK (src);
+    if (src->loop_cmd == CMD_WAIT)
+      src->loop_cmd = CMD_LOOP;
+    if (src->task)
+      gst_task_start (src->task);
+    GST_OBJECT_UNLOCK (src);
+    return GST_RTSP_REACTOR_BUSY;
+  }
+
+  return GST_RTSP_REACTOR_CONTINUE;
+}
+
+/* Hands the connection over to the shared reactor threads, the streaming task
+ * stops when this returns TRUE and is started again for the next command. */
+static gboolean
+gst_rtspsrc_share_io (GstRTSPSrc * src)
+{
+  gint fd;
+
+  fd = gst_rtsp_connection_get_readfd (src->conninfo.connection);
+  src->reactor_source = gst_rtsp_reactor_add (fd,
+      (GstRTSPReactorFunc) gst_rtspsrc_reactor_dispatch,
+      gst_object_ref (src), (GDestroyNotify) gst_object_unref);
+
+  if (src->reactor_source == NULL) {
+    GST_WARNING_OBJECT (src, "could not share I/O, reading ourselves");
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (src, "connection is read from the reactor now");
+  return TRUE;
+}
+
 static gboolean
 gst_rtspsrc_loop (GstRTSPSrc * src)
 {
   GstFlowReturn ret;
 
+  if (src->reactor_source == NULL && src->reactor_ret != GST_FLOW_OK) {
+    /* the reactor stopped on this, pause from our own thread */
+    ret = src->reactor_ret;
+    src->reactor_ret = GST_FLOW_OK;
+    src->reactor_handback = FALSE;
+    goto pause;
+  }
+
   if (!src->conninfo.connection || !src->conninfo.connected)
     goto no_connection;
 
-  if (src->interleaved)
+  if (!src->interleaved)
+    ret = gst_rtspsrc_loop_udp (src);
+  else if (gst_rtsp_connection_is_tunneled (src->conninfo.connection))
     ret = gst_rtspsrc_loop_interleaved (src);
+  else if (src->shared_io && src->reactor_source == NULL &&
+      !src->reactor_handback && gst_rtspsrc_can_share_io (src) &&
+      gst_rtspsrc_share_io (src))
+    return TRUE;
+  else if (src->tcp_bulk_size > 0 || src->shared_io)
+    ret = gst_rtspsrc_loop_interleaved_bulk (src);
   else
-    ret = gst_rtspsrc_loop_udp (src);
+    ret = gst_rtspsrc_loop_interleaved (src);
 
   if (ret != GST_FLOW_OK)
     goto pause;
@@ -4165,6 +4887,15 @@ pause:
   {
     const gchar *reason = gst_flow_get_name (ret);
 
+    if (src->reactor_source) {
+      /* EOS and errors are not pushed or posted from the reactor threads,
+       * the streaming task takes over and does that */
+      GST_DEBUG_OBJECT (src, "handing back the connection, reason %s", reason);
+      src->reactor_ret = ret;
+      src->reactor_handback = TRUE;
+      return TRUE;
+    }
+
     GST_DEBUG_OBJECT (src, "pausing task, reason %s", reason);
     src->running = FALSE;
     if (ret == GST_FLOW_UNEXPECTED) {
@@ -6511,6 +7242,16 @@ gst_rtspsrc_thread (GstRTSPSrc * src)
     src->waiting = TRUE;
   GST_OBJECT_UNLOCK (src);
 
+  /* we take over from the reactor for the command */
+  if (src->reactor_source) {
+    gst_rtsp_reactor_remove (src->reactor_source);
+    src->reactor_source = NULL;
+  }
+  /* the reactor leaves partial messages in the chunk, read the rest before
+   * the connection is used for the command */
+  if (cmd != CMD_LOOP)
+    gst_rtspsrc_bulk_drain (src);
+
   switch (cmd) {
     case CMD_OPEN:
       ret = gst_rtspsrc_open (src, TRUE);
@@ -6543,7 +7284,12 @@ gst_rtspsrc_thread (GstRTSPSrc * src)
   GST_OBJECT_LOCK (src);
   /* and go back to sleep */
   if (src->loop_cmd == CMD_WAIT) {
-    if (running)
+    if (src->reactor_source) {
+      /* the reactor reads for us, we don't need a thread until the next
+       * command */
+      if (src->task)
+        gst_task_stop (src->task);
+    } else if (running)
       src->loop_cmd = CMD_LOOP;
     else if (src->task)
       gst_task_pause (src->task);
@@ -6612,6 +7358,13 @@ gst_rtspsrc_stop (GstRTSPSrc * src)
   }
   GST_OBJECT_UNLOCK (src);
 
+  /* the task did not get to take over from the reactor */
+  if (src->reactor_source) {
+    gst_rtsp_reactor_remove (src->reactor_source);
+    src->reactor_source = NULL;
+    gst_rtspsrc_bulk_drain (src);
+  }
+
   /* ensure synchronously all is closed and clean */
   gst_rtspsrc_close (src, FALSE, TRUE);
 
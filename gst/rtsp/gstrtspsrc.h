@@ -54,6 +54,7 @@ G_BEGIN_DECLS
 #include <gst/rtsp/gstrtsprange.h>
 
 #include "gstrtspext.h"
+#include "gstrtspreactor.h"
 
 #define GST_TYPE_RTSPSRC \
   (gst_rtspsrc_get_type())
@@ -215,6 +216,8 @@ struct _GstRTSPSrc {
   GstRTSPRange      client_port_range;
   gint              udp_buffer_size;
   gboolean          short_header;
+  guint             tcp_bulk_size;
+  gboolean          shared_io;
 
   /* state */
   GstRTSPState       state;
@@ -233,6 +236,23 @@ struct _GstRTSPSrc {
   gboolean           seekable;
   GstClockTime       last_pos;
 
+  /* bulk reading of interleaved data, the unparsed data of the current chunk
+   * is between bulk_offset and bulk_filled */
+  GstPoll           *bulk_poll;
+  GstPollFD          bulk_pollfd;
+  GstBuffer         *bulk_buf;
+  guint              bulk_offset;
+  guint              bulk_filled;
+  GQueue             bulk_pool;
+
+  /* the connection is read from the shared reactor threads. Those must not
+   * block, so they hand the connection back to the streaming task when a
+   * keep-alive or a reply has to be sent, or with the flow in reactor_ret
+   * when they stopped on something else than OK. */
+  GstRTSPReactorSource *reactor_source;
+  gboolean              reactor_handback;
+  GstFlowReturn         reactor_ret;
+
   /* session management */
   GstElement      *manager;
   gulong           manager_sig_id;
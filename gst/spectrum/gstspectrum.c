@@ -88,6 +88,12 @@
  * fields will be each a nested #GstValueArray. The first dimension are the
  * channels and the second dimension are the values.
  *
+ * Since 0.10.31 the #GstSpectrum:compact-messages property can be set to
+ * %TRUE to make the magnitude and phase fields a #GstBuffer instead. The
+ * buffer contains the values as native endian #gfloat, all bands of the
+ * first channel followed by all bands of the next channel. This is a lot
+ * cheaper to create and parse than the lists for a high number of bands.
+ *
  * <refsect2>
  * <title>Example application</title>
  * |[
@@ -148,6 +154,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_spectrum_debug);
 #define DEFAULT_BANDS			128
 #define DEFAULT_THRESHOLD		-60
 #define DEFAULT_MULTI_CHANNEL		FALSE
+#define DEFAULT_COMPACT_MESSAGES	FALSE
 
 enum
 {
@@ -159,7 +166,8 @@ enum
   PROP_INTERVAL,
   PROP_BANDS,
   PROP_THRESHOLD,
-  PROP_MULTI_CHANNEL
+  PROP_MULTI_CHANNEL,
+  PROP_COMPACT_MESSAGES
 };
 
 GST_BOILERPLATE (GstSpectrum, gst_spectrum, GstAudioFilter,
@@ -275,6 +283,20 @@ gst_spectrum_class_init (GstSpectrumClass * klass)
           "Send separate results for each channel",
           DEFAULT_MULTI_CHANNEL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSpectrum:compact-messages
+   *
+   * Put the magnitude and phase values into the messages as a #GstBuffer of
+   * #gfloat values, channel after channel, instead of as lists of values.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_COMPACT_MESSAGES,
+      g_param_spec_boolean ("compact-messages", "Compact messages",
+          "Send magnitude and phase as buffers of floats instead of lists",
+          DEFAULT_COMPACT_MESSAGES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (gst_spectrum_debug, "spectrum", 0,
       "audio spectrum analyser element");
 }
@@ -288,6 +310,7 @@ gst_spectrum_init (GstSpectrum * spectrum, GstSpectrumClass * g_class)
   spectrum->interval = DEFAULT_INTERVAL;
   spectrum->bands = DEFAULT_BANDS;
   spectrum->threshold = DEFAULT_THRESHOLD;
+  spectrum->compact_messages = DEFAULT_COMPACT_MESSAGES;
 }
 
 static void
@@ -306,13 +329,24 @@ gst_spectrum_alloc_channel_data (GstSpectrum * spectrum)
   GST_DEBUG_OBJECT (spectrum, "allocating data for %d channels",
       spectrum->num_channels);
 
+  /* The FFT context and the scratch memory is only needed while running a
+   * FFT, so all channels can share them */
+  spectrum->fft_ctx = gst_fft_f32_new (nfft, FALSE);
+  spectrum->input_tmp = g_new0 (gfloat, nfft);
+  spectrum->freqdata = g_new0 (GstFFTF32Complex, bands);
+  spectrum->power = g_new0 (gfloat, bands);
+
+  /* Calculate the window once instead of for every FFT */
+  spectrum->window = g_new (gfloat, nfft);
+  for (i = 0; i < nfft; i++)
+    spectrum->window[i] = 1.0;
+  gst_fft_f32_window (spectrum->fft_ctx, spectrum->window,
+      GST_FFT_WINDOW_HAMMING);
+
   spectrum->channel_data = g_new (GstSpectrumChannel, spectrum->num_channels);
   for (i = 0; i < spectrum->num_channels; i++) {
     cd = &spectrum->channel_data[i];
-    cd->fft_ctx = gst_fft_f32_new (nfft, FALSE);
     cd->input = g_new0 (gfloat, nfft);
-    cd->input_tmp = g_new0 (gfloat, nfft);
-    cd->freqdata = g_new0 (GstFFTF32Complex, bands);
     cd->spect_magnitude = g_new0 (gfloat, bands);
     cd->spect_phase = g_new0 (gfloat, bands);
   }
@@ -330,16 +364,24 @@ gst_spectrum_free_channel_data (GstSpectrum * spectrum)
 
     for (i = 0; i < spectrum->num_channels; i++) {
       cd = &spectrum->channel_data[i];
-      if (cd->fft_ctx)
-        gst_fft_f32_free (cd->fft_ctx);
       g_free (cd->input);
-      g_free (cd->input_tmp);
-      g_free (cd->freqdata);
       g_free (cd->spect_magnitude);
       g_free (cd->spect_phase);
     }
     g_free (spectrum->channel_data);
     spectrum->channel_data = NULL;
+
+    if (spectrum->fft_ctx)
+      gst_fft_f32_free (spectrum->fft_ctx);
+    spectrum->fft_ctx = NULL;
+    g_free (spectrum->window);
+    spectrum->window = NULL;
+    g_free (spectrum->input_tmp);
+    spectrum->input_tmp = NULL;
+    g_free (spectrum->freqdata);
+    spectrum->freqdata = NULL;
+    g_free (spectrum->power);
+    spectrum->power = NULL;
   }
 }
 
@@ -421,6 +463,9 @@ gst_spectrum_set_property (GObject * object, guint prop_id,
       }
     }
       break;
+    case PROP_COMPACT_MESSAGES:
+      filter->compact_messages = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -456,6 +501,9 @@ gst_spectrum_get_property (GObject * object, guint prop_id,
     case PROP_MULTI_CHANNEL:
       g_value_set_boolean (value, filter->multi_channel);
       break;
+    case PROP_COMPACT_MESSAGES:
+      g_value_set_boolean (value, filter->compact_messages);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -853,6 +901,29 @@ gst_spectrum_message_add_array (GValue * cv, gfloat * data, guint num_values)
   g_value_unset (&a);
 }
 
+static void
+gst_spectrum_message_add_buffer (GstStructure * s, const gchar * name,
+    GstSpectrum * spectrum, gboolean phase)
+{
+  GstBuffer *buf;
+  gfloat *data;
+  guint bands = spectrum->bands;
+  guint c;
+
+  buf = gst_buffer_new_and_alloc (spectrum->num_channels * bands *
+      sizeof (gfloat));
+  data = (gfloat *) GST_BUFFER_DATA (buf);
+  for (c = 0; c < spectrum->num_channels; c++) {
+    GstSpectrumChannel *cd = &spectrum->channel_data[c];
+
+    memcpy (data + c * bands, phase ? cd->spect_phase : cd->spect_magnitude,
+        bands * sizeof (gfloat));
+  }
+
+  gst_structure_set (s, name, GST_TYPE_BUFFER, buf, NULL);
+  gst_buffer_unref (buf);
+}
+
 static GstMessage *
 gst_spectrum_message_new (GstSpectrum * spectrum, GstClockTime timestamp,
     GstClockTime duration)
@@ -879,7 +950,12 @@ gst_spectrum_message_new (GstSpectrum * spectrum, GstClockTime timestamp,
       "running-time", G_TYPE_UINT64, running_time,
       "duration", G_TYPE_UINT64, duration, NULL);
 
-  if (!spectrum->multi_channel) {
+  if (spectrum->compact_messages) {
+    if (spectrum->message_magnitude)
+      gst_spectrum_message_add_buffer (s, "magnitude", spectrum, FALSE);
+    if (spectrum->message_phase)
+      gst_spectrum_message_add_buffer (s, "phase", spectrum, TRUE);
+  } else if (!spectrum->multi_channel) {
     cd = &spectrum->channel_data[0];
 
     if (spectrum->message_magnitude) {
@@ -911,7 +987,7 @@ gst_spectrum_message_new (GstSpectrum * spectrum, GstClockTime timestamp,
             spectrum->bands);
       }
       if (spectrum->message_phase) {
-        gst_spectrum_message_add_array (pcv, cd->spect_magnitude,
+        gst_spectrum_message_add_array (pcv, cd->spect_phase,
             spectrum->bands);
       }
     }
@@ -919,46 +995,62 @@ gst_spectrum_message_new (GstSpectrum * spectrum, GstClockTime timestamp,
   return gst_message_new_element (GST_OBJECT (spectrum), s);
 }
 
+/* Runs the FFT for all channels, one after another with the same FFT context
+ * and scratch memory */
 static void
-gst_spectrum_run_fft (GstSpectrum * spectrum, GstSpectrumChannel * cd,
-    guint input_pos)
+gst_spectrum_run_fft (GstSpectrum * spectrum, guint input_pos)
 {
-  guint i;
+  guint i, c;
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
   gint threshold = spectrum->threshold;
-  gfloat *input = cd->input;
-  gfloat *input_tmp = cd->input_tmp;
-  gfloat *spect_magnitude = cd->spect_magnitude;
-  gfloat *spect_phase = cd->spect_phase;
-  GstFFTF32Complex *freqdata = cd->freqdata;
-  GstFFTF32 *fft_ctx = cd->fft_ctx;
-
-  for (i = 0; i < nfft; i++)
-    input_tmp[i] = input[(input_pos + i) % nfft];
+  gfloat *window = spectrum->window;
+  gfloat *input_tmp = spectrum->input_tmp;
+  gfloat *power = spectrum->power;
+  GstFFTF32Complex *freqdata = spectrum->freqdata;
+  GstFFTF32 *fft_ctx = spectrum->fft_ctx;
+  gdouble norm;
+  gfloat threshold_power;
+
+  /* The magnitude in dB is 10 * log10 (power / (nfft * nfft)). Comparing the
+   * power against the threshold converted back to a power only requires the
+   * logarithm for the bands above the threshold */
+  norm = 20.0 * log10 (nfft);
+  threshold_power = pow (10.0, (threshold + norm) / 10.0);
+
+  for (c = 0; c < spectrum->num_channels; c++) {
+    GstSpectrumChannel *cd = &spectrum->channel_data[c];
+    gfloat *input = cd->input;
+    gfloat *spect_magnitude = cd->spect_magnitude;
+    gfloat *spect_phase = cd->spect_phase;
 
-  gst_fft_f32_window (fft_ctx, input_tmp, GST_FFT_WINDOW_HAMMING);
+    /* unroll the ringbuffer and apply the window in one go */
+    for (i = 0; i < nfft - input_pos; i++)
+      input_tmp[i] = input[input_pos + i] * window[i];
+    for (; i < nfft; i++)
+      input_tmp[i] = input[input_pos + i - nfft] * window[i];
 
-  gst_fft_f32_fft (fft_ctx, input_tmp, freqdata);
+    gst_fft_f32_fft (fft_ctx, input_tmp, freqdata);
 
-  if (spectrum->message_magnitude) {
-    gdouble val;
-    /* Calculate magnitude in db */
-    for (i = 0; i < bands; i++) {
-      val = freqdata[i].r * freqdata[i].r;
-      val += freqdata[i].i * freqdata[i].i;
-      val /= nfft * nfft;
-      val = 10.0 * log10 (val);
-      if (val < threshold)
-        val = threshold;
-      spect_magnitude[i] += val;
+    if (spectrum->message_magnitude) {
+      /* Calculate magnitude in db, the first loop can be vectorized by
+       * the compiler */
+      for (i = 0; i < bands; i++)
+        power[i] = freqdata[i].r * freqdata[i].r +
+            freqdata[i].i * freqdata[i].i;
+      for (i = 0; i < bands; i++) {
+        if (power[i] <= threshold_power)
+          spect_magnitude[i] += threshold;
+        else
+          spect_magnitude[i] += 10.0 * log10 (power[i]) - norm;
+      }
     }
-  }
 
-  if (spectrum->message_phase) {
-    /* Calculate phase */
-    for (i = 0; i < bands; i++)
-      spect_phase[i] += atan2 (freqdata[i].i, freqdata[i].r);
+    if (spectrum->message_phase) {
+      /* Calculate phase */
+      for (i = 0; i < bands; i++)
+        spect_phase[i] += atan2 (freqdata[i].i, freqdata[i].r);
+    }
   }
 }
 
@@ -1095,10 +1187,7 @@ gst_spectrum_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
      * the interval and we haven't run a FFT, then run an FFT */
     if ((spectrum->num_frames % nfft == 0) ||
         (have_full_interval && !spectrum->num_fft)) {
-      for (c = 0; c < output_channels; c++) {
-        cd = &spectrum->channel_data[c];
-        gst_spectrum_run_fft (spectrum, cd, input_pos);
-      }
+      gst_spectrum_run_fft (spectrum, input_pos);
       spectrum->num_fft++;
     }
 
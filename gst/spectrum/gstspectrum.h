@@ -43,11 +43,8 @@ typedef void (*GstSpectrumInputData)(const guint8 * in, gfloat * out,
 struct _GstSpectrumChannel
 {
   gfloat *input;
-  gfloat *input_tmp;
-  GstFFTF32Complex *freqdata;
   gfloat *spect_magnitude;      /* accumulated mangitude and phase */
   gfloat *spect_phase;          /* will be scaled by num_fft before sending */
-  GstFFTF32 *fft_ctx;
 };
 
 struct _GstSpectrum
@@ -64,6 +61,7 @@ struct _GstSpectrum
   guint bands;                  /* number of spectrum bands */
   gint threshold;               /* energy level treshold */
   gboolean multi_channel;       /* send separate channel results */
+  gboolean compact_messages;    /* send results as buffers of floats */
 
   guint64 num_frames;           /* frame count (1 sample per channel)
                                  * since last emit */
@@ -74,6 +72,13 @@ struct _GstSpectrum
   GstSpectrumChannel *channel_data;
   guint num_channels;
 
+  /* shared by all channels, they are processed one after another */
+  GstFFTF32 *fft_ctx;
+  gfloat *window;               /* precalculated window function */
+  gfloat *input_tmp;
+  GstFFTF32Complex *freqdata;
+  gfloat *power;                /* squared magnitude per band */
+
   guint input_pos;
   guint64 error_per_interval;
   guint64 accumulated_error;
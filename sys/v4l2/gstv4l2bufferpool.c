@@ -28,6 +28,7 @@
 
 #include <sys/mman.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "gst/video/video.h"
@@ -105,10 +106,15 @@ gst_v4l2_buffer_finalize (GstV4l2Buffer * buffer)
 
   if (!resuscitated) {
     GST_LOG_OBJECT (pool->v4l2elem,
-        "buffer %p (data %p, len %u) not recovered, unmapping",
+        "buffer %p (data %p, len %u) not recovered, releasing",
         buffer, GST_BUFFER_DATA (buffer), buffer->vbuffer.length);
+    if (pool->memory == V4L2_MEMORY_USERPTR) {
+      if (buffer->mem)
+        gst_buffer_unref (buffer->mem);
+    } else {
+      v4l2_munmap ((void *) GST_BUFFER_DATA (buffer), buffer->vbuffer.length);
+    }
     gst_mini_object_unref (GST_MINI_OBJECT (pool));
-    v4l2_munmap ((void *) GST_BUFFER_DATA (buffer), buffer->vbuffer.length);
 
     GST_MINI_OBJECT_CLASS (v4l2buffer_parent_class)->finalize (GST_MINI_OBJECT
         (buffer));
@@ -166,7 +172,14 @@ gst_v4l2_buffer_new (GstV4l2BufferPool * pool, guint index, GstCaps * caps)
 
   ret->vbuffer.index = index;
   ret->vbuffer.type = pool->type;
-  ret->vbuffer.memory = V4L2_MEMORY_MMAP;
+  ret->vbuffer.memory = pool->memory;
+  ret->latency = GST_CLOCK_TIME_NONE;
+
+  gst_buffer_set_caps (GST_BUFFER (ret), caps);
+
+  /* the memory is attached with gst_v4l2_buffer_pool_attach() */
+  if (pool->memory == V4L2_MEMORY_USERPTR)
+    return ret;
 
   if (v4l2_ioctl (pool->video_fd, VIDIOC_QUERYBUF, &ret->vbuffer) < 0)
     goto querybuf_failed;
@@ -195,8 +208,6 @@ gst_v4l2_buffer_new (GstV4l2BufferPool * pool, guint index, GstCaps * caps)
 
   GST_BUFFER_FLAG_SET (ret, GST_BUFFER_FLAG_READONLY);
 
-  gst_buffer_set_caps (GST_BUFFER (ret), caps);
-
   return ret;
 
   /* ERRORS */
@@ -323,6 +334,10 @@ get_v4l2_object (GstElement * v4l2elem)
  *  buffer with no remaining references is immediately passed back to v4l2
  *  (VIDIOC_QBUF), otherwise it is returned to the pool of available buffers
  *  (which can be accessed via gst_v4l2_buffer_pool_get().
+ * @type: the buffer type
+ * @memory: %V4L2_MEMORY_MMAP to map buffers allocated by the driver, or
+ *  %V4L2_MEMORY_USERPTR to let the driver use memory that is attached to the
+ *  buffers with gst_v4l2_buffer_pool_attach() before queueing them
  *
  * Construct a new buffer pool.
  *
@@ -330,11 +345,13 @@ get_v4l2_object (GstElement * v4l2elem)
  */
 GstV4l2BufferPool *
 gst_v4l2_buffer_pool_new (GstElement * v4l2elem, gint fd, gint num_buffers,
-    GstCaps * caps, gboolean requeuebuf, enum v4l2_buf_type type)
+    GstCaps * caps, gboolean requeuebuf, enum v4l2_buf_type type,
+    enum v4l2_memory memory)
 {
   GstV4l2BufferPool *pool;
   gint n;
   struct v4l2_requestbuffers breq;
+  struct v4l2_format format;
 
   pool = (GstV4l2BufferPool *) gst_mini_object_new (GST_TYPE_V4L2_BUFFER_POOL);
 
@@ -344,13 +361,13 @@ gst_v4l2_buffer_pool_new (GstElement * v4l2elem, gint fd, gint num_buffers,
 
 
   /* first, lets request buffers, and see how many we can get: */
-  GST_DEBUG_OBJECT (v4l2elem, "STREAMING, requesting %d MMAP buffers",
-      num_buffers);
+  GST_DEBUG_OBJECT (v4l2elem, "STREAMING, requesting %d %s buffers",
+      num_buffers, memory == V4L2_MEMORY_USERPTR ? "USERPTR" : "MMAP");
 
   memset (&breq, 0, sizeof (struct v4l2_requestbuffers));
   breq.type = type;
   breq.count = num_buffers;
-  breq.memory = V4L2_MEMORY_MMAP;
+  breq.memory = memory;
 
   if (v4l2_ioctl (fd, VIDIOC_REQBUFS, &breq) < 0)
     goto reqbufs_failed;
@@ -367,9 +384,21 @@ gst_v4l2_buffer_pool_new (GstElement * v4l2elem, gint fd, gint num_buffers,
     num_buffers = breq.count;
   }
 
+  if (memory == V4L2_MEMORY_USERPTR) {
+    /* the attached memory has to hold a complete image */
+    memset (&format, 0, sizeof (struct v4l2_format));
+    format.type = type;
+    if (v4l2_ioctl (fd, VIDIOC_G_FMT, &format) < 0)
+      goto get_fmt_failed;
+
+    pool->buffer_size = format.fmt.pix.sizeimage;
+    GST_LOG_OBJECT (v4l2elem, " size:   %u", pool->buffer_size);
+  }
+
   pool->v4l2elem = v4l2elem;
   pool->requeuebuf = requeuebuf;
   pool->type = type;
+  pool->memory = memory;
   pool->buffer_count = num_buffers;
   pool->buffers = g_new0 (GstV4l2Buffer *, num_buffers);
   pool->avail_buffers = g_async_queue_new ();
@@ -405,6 +434,14 @@ reqbufs_failed:
         ("error requesting %d buffers: %s", num_buffers, g_strerror (errno)));
     return NULL;
   }
+get_fmt_failed:
+  {
+    GstV4l2Object *v4l2object = get_v4l2_object (v4l2elem);
+    GST_ELEMENT_ERROR (v4l2elem, RESOURCE, SETTINGS,
+        (_("Could not get parameters on device '%s'"),
+            v4l2object->videodev), GST_ERROR_SYSTEM);
+    return NULL;
+  }
 no_buffers:
   {
     GstV4l2Object *v4l2object = get_v4l2_object (v4l2elem);
@@ -521,6 +558,39 @@ gst_v4l2_buffer_pool_qbuf (GstV4l2BufferPool * pool, GstV4l2Buffer * buf)
   return TRUE;
 }
 
+/* returns how long ago the driver captured the frame in @buffer */
+static GstClockTime
+gst_v4l2_buffer_pool_get_latency (struct v4l2_buffer *buffer)
+{
+  GstClockTime captured, now;
+  GTimeVal tv;
+
+  if (buffer->timestamp.tv_sec == 0 && buffer->timestamp.tv_usec == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  captured = GST_TIMEVAL_TO_TIME (buffer->timestamp);
+
+#ifdef V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+  if ((buffer->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+      V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    now = GST_TIMESPEC_TO_TIME (ts);
+  } else
+#endif
+  {
+    /* older drivers stamp the frames with the wall clock */
+    g_get_current_time (&tv);
+    now = GST_TIMEVAL_TO_TIME (tv);
+  }
+
+  if (now < captured)
+    return GST_CLOCK_TIME_NONE;
+
+  return now - captured;
+}
+
 /**
  * gst_v4l2_buffer_pool_dqbuf:
  * @pool: the pool
@@ -540,7 +610,7 @@ gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool * pool)
 
   memset (&buffer, 0x00, sizeof (buffer));
   buffer.type = pool->type;
-  buffer.memory = V4L2_MEMORY_MMAP;
+  buffer.memory = pool->memory;
 
 
   if (v4l2_ioctl (pool->video_fd, VIDIOC_DQBUF, &buffer) >= 0) {
@@ -579,6 +649,8 @@ gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool * pool)
     /* this can change at every frame, esp. with jpeg */
     GST_BUFFER_SIZE (pool_buffer) = buffer.bytesused;
 
+    pool_buffer->latency = gst_v4l2_buffer_pool_get_latency (&buffer);
+
     GST_V4L2_BUFFER_POOL_UNLOCK (pool);
 
     return pool_buffer;
@@ -650,3 +722,98 @@ gst_v4l2_buffer_pool_available_buffers (GstV4l2BufferPool * pool)
 {
   return pool->buffer_count - pool->num_live_buffers;
 }
+
+/**
+ * gst_v4l2_buffer_pool_grow:
+ * @pool: the pool
+ *
+ * Queue one of the available buffers that were never given to the driver, so
+ * that it has one more buffer to capture into.
+ *
+ * Returns: %TRUE if a buffer was queued, %FALSE if there are none left
+ */
+gboolean
+gst_v4l2_buffer_pool_grow (GstV4l2BufferPool * pool)
+{
+  GstV4l2Buffer *buf;
+  gboolean ret;
+
+  buf = g_async_queue_try_pop (pool->avail_buffers);
+  if (!buf)
+    return FALSE;
+
+  GST_V4L2_BUFFER_POOL_LOCK (pool);
+  ret = gst_v4l2_buffer_pool_qbuf (pool, buf);
+  GST_V4L2_BUFFER_POOL_UNLOCK (pool);
+
+  if (!ret) {
+    GST_WARNING_OBJECT (pool->v4l2elem, "could not queue buffer %d: %s",
+        buf->vbuffer.index, g_strerror (errno));
+    g_async_queue_push (pool->avail_buffers, buf);
+  }
+
+  return ret;
+}
+
+/**
+ * gst_v4l2_buffer_pool_attach:
+ * @pool: the pool
+ * @buf: a buffer of a %V4L2_MEMORY_USERPTR pool that is not with the driver
+ * @mem: the memory for the driver to use, at least @pool->buffer_size bytes
+ *
+ * Let @buf point at the data of @mem the next time it is queued. Takes
+ * ownership of @mem and releases the memory that was attached before.
+ */
+void
+gst_v4l2_buffer_pool_attach (GstV4l2BufferPool * pool, GstV4l2Buffer * buf,
+    GstBuffer * mem)
+{
+  g_return_if_fail (pool->memory == V4L2_MEMORY_USERPTR);
+  g_return_if_fail (GST_BUFFER_SIZE (mem) >= pool->buffer_size);
+
+  if (buf->mem)
+    gst_buffer_unref (buf->mem);
+  buf->mem = mem;
+
+  buf->vbuffer.m.userptr = (unsigned long) GST_BUFFER_DATA (mem);
+  buf->vbuffer.length = pool->buffer_size;
+
+  GST_BUFFER_DATA (buf) = GST_BUFFER_DATA (mem);
+  GST_BUFFER_SIZE (buf) = pool->buffer_size;
+}
+
+/**
+ * gst_v4l2_buffer_pool_detach:
+ * @pool: the pool
+ * @buf: a dequeued buffer of a %V4L2_MEMORY_USERPTR pool
+ *
+ * Take the memory the driver used for @buf. The returned buffer has the
+ * size, flags and caps of @buf, so it can be pushed instead of @buf, which
+ * needs new memory from gst_v4l2_buffer_pool_attach() before it can be queued
+ * again.
+ *
+ * Returns: the memory that was attached to @buf
+ */
+GstBuffer *
+gst_v4l2_buffer_pool_detach (GstV4l2BufferPool * pool, GstV4l2Buffer * buf)
+{
+  GstBuffer *mem;
+
+  g_return_val_if_fail (pool->memory == V4L2_MEMORY_USERPTR, NULL);
+  g_return_val_if_fail (buf->mem != NULL, NULL);
+
+  mem = buf->mem;
+  buf->mem = NULL;
+
+  GST_BUFFER_SIZE (mem) = GST_BUFFER_SIZE (buf);
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_VIDEO_BUFFER_TFF))
+    GST_BUFFER_FLAG_SET (mem, GST_VIDEO_BUFFER_TFF);
+  else
+    GST_BUFFER_FLAG_UNSET (mem, GST_VIDEO_BUFFER_TFF);
+  gst_buffer_set_caps (mem, GST_BUFFER_CAPS (buf));
+
+  GST_BUFFER_DATA (buf) = NULL;
+  GST_BUFFER_SIZE (buf) = 0;
+
+  return mem;
+}
@@ -56,6 +56,8 @@ struct _GstV4l2BufferPool
   GstElement *v4l2elem;      /* the v4l2 src/sink that owns us.. maybe we should be owned by v4l2object? */
   gboolean requeuebuf;       /* if true, unusued buffers are automatically re-QBUF'd */
   enum v4l2_buf_type type;   /* V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_BUF_TYPE_VIDEO_OUTPUT */
+  enum v4l2_memory memory;   /* V4L2_MEMORY_MMAP, V4L2_MEMORY_USERPTR */
+  guint buffer_size;         /* size of the memory to attach in USERPTR mode */
 
   GMutex *lock;
   gboolean running;          /* with lock */
@@ -76,15 +78,26 @@ struct _GstV4l2Buffer {
    * between v4l2src and v4l2sink??
    */
   GstV4l2BufferPool *pool;
+
+  /* USERPTR mode: the buffer the driver reads from or writes into */
+  GstBuffer *mem;
+
+  /* time between capture and dequeue of the last frame, or
+   * GST_CLOCK_TIME_NONE if the driver timestamp can't be compared to now */
+  GstClockTime latency;
 };
 
 void gst_v4l2_buffer_pool_destroy (GstV4l2BufferPool * pool);
-GstV4l2BufferPool *gst_v4l2_buffer_pool_new (GstElement *v4l2elem, gint fd, gint num_buffers, GstCaps * caps, gboolean requeuebuf, enum v4l2_buf_type type);
+GstV4l2BufferPool *gst_v4l2_buffer_pool_new (GstElement *v4l2elem, gint fd, gint num_buffers, GstCaps * caps, gboolean requeuebuf, enum v4l2_buf_type type, enum v4l2_memory memory);
 
 
 GstV4l2Buffer *gst_v4l2_buffer_pool_get (GstV4l2BufferPool *pool, gboolean blocking);
 gboolean gst_v4l2_buffer_pool_qbuf (GstV4l2BufferPool *pool, GstV4l2Buffer *buf);
 GstV4l2Buffer *gst_v4l2_buffer_pool_dqbuf (GstV4l2BufferPool *pool);
+gboolean gst_v4l2_buffer_pool_grow (GstV4l2BufferPool *pool);
+
+void gst_v4l2_buffer_pool_attach (GstV4l2BufferPool *pool, GstV4l2Buffer *buf, GstBuffer *mem);
+GstBuffer *gst_v4l2_buffer_pool_detach (GstV4l2BufferPool *pool, GstV4l2Buffer *buf);
 
 gint gst_v4l2_buffer_pool_available_buffers (GstV4l2BufferPool *pool);
 
@@ -796,7 +796,7 @@ gst_v4l2sink_buffer_alloc (GstBaseSink * bsink, guint64 offset, guint size,
       if (!(v4l2sink->pool = gst_v4l2_buffer_pool_new (GST_ELEMENT (v4l2sink),
                   v4l2sink->v4l2object->video_fd,
                   v4l2sink->num_buffers, caps, FALSE,
-                  V4L2_BUF_TYPE_VIDEO_OUTPUT))) {
+                  V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_MEMORY_MMAP))) {
         return GST_FLOW_ERROR;
       }
 
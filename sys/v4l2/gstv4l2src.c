@@ -66,6 +66,8 @@ GST_DEBUG_CATEGORY (v4l2src_debug);
 #define PROP_DEF_QUEUE_SIZE         2
 #define PROP_DEF_ALWAYS_COPY        TRUE
 #define PROP_DEF_DECIMATE           1
+#define PROP_DEF_MAX_QUEUE_SIZE     0
+#define PROP_DEF_IO_MODE            GST_V4L2SRC_IO_MODE_MMAP
 
 #define DEFAULT_PROP_DEVICE   "/dev/video0"
 
@@ -75,9 +77,33 @@ enum
   V4L2_STD_OBJECT_PROPS,
   PROP_QUEUE_SIZE,
   PROP_ALWAYS_COPY,
-  PROP_DECIMATE
+  PROP_DECIMATE,
+  PROP_MAX_QUEUE_SIZE,
+  PROP_IO_MODE,
+  PROP_COPIED_BUFFERS,
+  PROP_CAPTURE_LATENCY,
+  PROP_MAX_CAPTURE_LATENCY
 };
 
+GType
+gst_v4l2src_io_mode_get_type (void)
+{
+  static GType v4l2src_io_mode = 0;
+
+  if (!v4l2src_io_mode) {
+    static const GEnumValue io_modes[] = {
+      {GST_V4L2SRC_IO_MODE_MMAP, "Capture into driver buffers", "mmap"},
+      {GST_V4L2SRC_IO_MODE_USERPTR, "Capture into downstream buffers",
+          "userptr"},
+      {0, NULL, NULL}
+    };
+
+    v4l2src_io_mode = g_enum_register_static ("GstV4l2SrcIOMode", io_modes);
+  }
+
+  return v4l2src_io_mode;
+}
+
 GST_IMPLEMENT_V4L2_PROBE_METHODS (GstV4l2SrcClass, gst_v4l2src);
 GST_IMPLEMENT_V4L2_COLOR_BALANCE_METHODS (GstV4l2Src, gst_v4l2src);
 GST_IMPLEMENT_V4L2_TUNER_METHODS (GstV4l2Src, gst_v4l2src);
@@ -284,6 +310,75 @@ gst_v4l2src_class_init (GstV4l2SrcClass * klass)
       g_param_spec_int ("decimate", "Decimate",
           "Only use every nth frame", 1, G_MAXINT,
           PROP_DEF_DECIMATE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstV4l2Src:max-queue-size
+   *
+   * Maximum number of buffers to enqueue in the driver. When downstream holds
+   * on to the captured buffers until the driver runs out of buffers, another
+   * buffer is enqueued instead of copying the frame, until this many buffers
+   * are enqueued. 0 disables growing the queue. The buffers are allocated by
+   * the driver when capturing starts. Only used in mmap mode.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_SIZE,
+      g_param_spec_uint ("max-queue-size", "Maximum queue size",
+          "Maximum number of buffers to enqueue in the driver when downstream "
+          "holds on to buffers (0 = queue-size)", 0, GST_V4L2_MAX_BUFFERS,
+          PROP_DEF_MAX_QUEUE_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstV4l2Src:io-mode
+   *
+   * How to capture in streaming mode. In userptr mode the driver captures
+   * straight into buffers allocated downstream, which are pushed without a
+   * copy, so #GstV4l2Src:always-copy has no effect. Needs a driver that
+   * supports user pointer I/O.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_IO_MODE,
+      g_param_spec_enum ("io-mode", "IO mode",
+          "How to capture frames in streaming mode", GST_TYPE_V4L2SRC_IO_MODE,
+          PROP_DEF_IO_MODE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  /**
+   * GstV4l2Src:copied-buffers
+   *
+   * Number of captured frames that were copied instead of pushed directly
+   * since the element was started.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_COPIED_BUFFERS,
+      g_param_spec_uint64 ("copied-buffers", "Copied buffers",
+          "Number of captured frames that were copied",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstV4l2Src:capture-latency
+   *
+   * Average time between the capture of a frame by the driver and its
+   * dequeueing since the element was started, in nanoseconds. Stays 0 if the
+   * driver doesn't timestamp the frames.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_CAPTURE_LATENCY,
+      g_param_spec_uint64 ("capture-latency", "Capture Latency",
+          "Average time between capture and dequeue of a frame (in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstV4l2Src:max-capture-latency
+   *
+   * Longest time between the capture of a frame by the driver and its
+   * dequeueing since the element was started, in nanoseconds.
+   *
+   * Since: 0.10.31
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_CAPTURE_LATENCY,
+      g_param_spec_uint64 ("max-capture-latency", "Maximum Capture Latency",
+          "Longest time between capture and dequeue of a frame (in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   basesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_v4l2src_get_caps);
   basesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_v4l2src_set_caps);
@@ -311,6 +406,8 @@ gst_v4l2src_init (GstV4l2Src * v4l2src, GstV4l2SrcClass * klass)
 
   v4l2src->always_copy = PROP_DEF_ALWAYS_COPY;
   v4l2src->decimate = PROP_DEF_DECIMATE;
+  v4l2src->max_queue_size = PROP_DEF_MAX_QUEUE_SIZE;
+  v4l2src->io_mode = PROP_DEF_IO_MODE;
 
   v4l2src->is_capturing = FALSE;
 
@@ -362,6 +459,12 @@ gst_v4l2src_set_property (GObject * object,
       case PROP_DECIMATE:
         v4l2src->decimate = g_value_get_int (value);
         break;
+      case PROP_MAX_QUEUE_SIZE:
+        v4l2src->max_queue_size = g_value_get_uint (value);
+        break;
+      case PROP_IO_MODE:
+        v4l2src->io_mode = g_value_get_enum (value);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -388,6 +491,28 @@ gst_v4l2src_get_property (GObject * object,
       case PROP_DECIMATE:
         g_value_set_int (value, v4l2src->decimate);
         break;
+      case PROP_MAX_QUEUE_SIZE:
+        g_value_set_uint (value, v4l2src->max_queue_size);
+        break;
+      case PROP_IO_MODE:
+        g_value_set_enum (value, v4l2src->io_mode);
+        break;
+      case PROP_COPIED_BUFFERS:
+        GST_OBJECT_LOCK (v4l2src);
+        g_value_set_uint64 (value, v4l2src->copied_buffers);
+        GST_OBJECT_UNLOCK (v4l2src);
+        break;
+      case PROP_CAPTURE_LATENCY:
+        GST_OBJECT_LOCK (v4l2src);
+        g_value_set_uint64 (value, v4l2src->latency_frames ?
+            v4l2src->latency_total / v4l2src->latency_frames : 0);
+        GST_OBJECT_UNLOCK (v4l2src);
+        break;
+      case PROP_MAX_CAPTURE_LATENCY:
+        GST_OBJECT_LOCK (v4l2src);
+        g_value_set_uint64 (value, v4l2src->max_latency);
+        GST_OBJECT_UNLOCK (v4l2src);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -739,6 +864,13 @@ gst_v4l2src_start (GstBaseSrc * src)
 
   v4l2src->offset = 0;
 
+  GST_OBJECT_LOCK (v4l2src);
+  v4l2src->copied_buffers = 0;
+  v4l2src->latency_frames = 0;
+  v4l2src->latency_total = 0;
+  v4l2src->max_latency = 0;
+  GST_OBJECT_UNLOCK (v4l2src);
+
   /* activate settings for first frame */
   v4l2src->ctrl_time = 0;
   gst_object_sync_values (G_OBJECT (src), v4l2src->ctrl_time);
@@ -47,6 +47,23 @@ typedef struct _GstV4l2SrcClass GstV4l2SrcClass;
 
 typedef GstFlowReturn (*GstV4l2SrcGetFunc)(GstV4l2Src * v4l2src, GstBuffer ** buf);
 
+/**
+ * GstV4l2SrcIOMode:
+ * @GST_V4L2SRC_IO_MODE_MMAP: capture into buffers allocated by the driver
+ * @GST_V4L2SRC_IO_MODE_USERPTR: capture into buffers allocated downstream
+ *
+ * How the frames get from the driver into the buffers that are pushed.
+ *
+ * Since: 0.10.31
+ */
+typedef enum {
+  GST_V4L2SRC_IO_MODE_MMAP,
+  GST_V4L2SRC_IO_MODE_USERPTR
+} GstV4l2SrcIOMode;
+
+#define GST_TYPE_V4L2SRC_IO_MODE (gst_v4l2src_io_mode_get_type ())
+GType gst_v4l2src_io_mode_get_type (void);
+
 /**
  * GstV4l2Src:
  *
@@ -66,6 +83,8 @@ struct _GstV4l2Src
   GstV4l2BufferPool *pool;
 
   guint32 num_buffers;
+  guint32 max_queue_size;
+  GstV4l2SrcIOMode io_mode;
   gboolean use_mmap;
   guint32 frame_byte_size;
 
@@ -85,6 +104,12 @@ struct _GstV4l2Src
 
   GstClockTime ctrl_time;
 
+  /* statistics, with the object lock */
+  guint64 copied_buffers;
+  guint64 latency_frames;
+  GstClockTime latency_total;
+  GstClockTime max_latency;
+
   GstV4l2SrcGetFunc get_frame;
 };
 
@@ -62,15 +62,71 @@ GST_DEBUG_CATEGORY_EXTERN (GST_CAT_PERFORMANCE);
 
 /* Local functions */
 
+/* Allocates memory for the driver to capture a frame into in USERPTR mode.
+ * With @from_peer we try to get it from downstream first, so that the frame
+ * can be pushed without a copy. */
+static GstBuffer *
+gst_v4l2src_alloc_userptr (GstV4l2Src * v4l2src, GstCaps * caps,
+    gboolean from_peer)
+{
+  GstV4l2BufferPool *pool = v4l2src->pool;
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+  gsize page_size, data;
+
+  /* some drivers can only capture into page aligned memory */
+  page_size = sysconf (_SC_PAGESIZE);
+
+  if (from_peer) {
+    ret = gst_pad_alloc_buffer (GST_BASE_SRC_PAD (v4l2src),
+        GST_BUFFER_OFFSET_NONE, pool->buffer_size, caps, &buf);
+
+    if (ret == GST_FLOW_OK) {
+      if (GST_BUFFER_SIZE (buf) >= pool->buffer_size &&
+          ((gsize) GST_BUFFER_DATA (buf) & (page_size - 1)) == 0 &&
+          GST_BUFFER_CAPS (buf) && gst_caps_is_equal (GST_BUFFER_CAPS (buf),
+              caps))
+        return buf;
+
+      GST_DEBUG_OBJECT (v4l2src, "can't capture into buffer %p of %u bytes "
+          "at %p from downstream", buf, GST_BUFFER_SIZE (buf),
+          GST_BUFFER_DATA (buf));
+      gst_buffer_unref (buf);
+    }
+  }
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_MALLOCDATA (buf) = g_malloc (pool->buffer_size + page_size - 1);
+  data = (gsize) GST_BUFFER_MALLOCDATA (buf);
+  GST_BUFFER_DATA (buf) = (guint8 *) ((data + page_size - 1) &
+      ~(page_size - 1));
+  GST_BUFFER_SIZE (buf) = pool->buffer_size;
+  gst_buffer_set_caps (buf, caps);
+
+  return buf;
+}
+
 static gboolean
 gst_v4l2src_buffer_pool_activate (GstV4l2BufferPool * pool,
     GstV4l2Src * v4l2src)
 {
   GstV4l2Buffer *buf;
+  guint n;
+
+  /* anything above queue-size stays available for the pool to grow */
+  for (n = 0; n < v4l2src->num_buffers; n++) {
+    if (!(buf = gst_v4l2_buffer_pool_get (pool, FALSE)))
+      break;
+
+    /* we're still negotiating, so only ask downstream for memory once we
+     * dequeue the first frames */
+    if (pool->memory == V4L2_MEMORY_USERPTR)
+      gst_v4l2_buffer_pool_attach (pool, buf,
+          gst_v4l2src_alloc_userptr (v4l2src, GST_BUFFER_CAPS (buf), FALSE));
 
-  while ((buf = gst_v4l2_buffer_pool_get (pool, FALSE)) != NULL)
     if (!gst_v4l2_buffer_pool_qbuf (pool, buf))
       goto queue_failed;
+  }
 
   return TRUE;
 
@@ -99,7 +155,8 @@ gst_v4l2src_grab_frame (GstV4l2Src * v4l2src, GstBuffer ** buf)
   GstV4l2BufferPool *pool;
   gint32 trials = NUM_TRIALS;
   GstBuffer *pool_buffer;
-  gboolean need_copy;
+  GstClockTime latency;
+  gboolean need_copy, queued;
   gint ret;
 
   v4l2object = v4l2src->v4l2object;
@@ -153,6 +210,43 @@ gst_v4l2src_grab_frame (GstV4l2Src * v4l2src, GstBuffer ** buf)
     }
   }
 
+  latency = GST_V4L2_BUFFER (pool_buffer)->latency;
+  if (GST_CLOCK_TIME_IS_VALID (latency)) {
+    GST_OBJECT_LOCK (v4l2src);
+    v4l2src->latency_total += latency;
+    v4l2src->latency_frames++;
+    v4l2src->max_latency = MAX (v4l2src->max_latency, latency);
+    GST_OBJECT_UNLOCK (v4l2src);
+  }
+
+  if (pool->memory == V4L2_MEMORY_USERPTR) {
+    GstV4l2Buffer *v4l2buf = GST_V4L2_BUFFER (pool_buffer);
+
+    /* push the memory the frame was captured into and give the driver new
+     * memory right away, so we never run out of buffers */
+    *buf = gst_v4l2_buffer_pool_detach (pool, v4l2buf);
+    gst_v4l2_buffer_pool_attach (pool, v4l2buf,
+        gst_v4l2src_alloc_userptr (v4l2src, GST_BUFFER_CAPS (v4l2buf), TRUE));
+
+    GST_V4L2_BUFFER_POOL_LOCK (pool);
+    queued = gst_v4l2_buffer_pool_qbuf (pool, v4l2buf);
+    GST_V4L2_BUFFER_POOL_UNLOCK (pool);
+    if (!queued)
+      GST_WARNING_OBJECT (v4l2src, "could not requeue buffer %d: %s",
+          v4l2buf->vbuffer.index, g_strerror (errno));
+
+    return GST_FLOW_OK;
+  }
+
+  /* if the driver has no buffers left, give it one of the buffers we kept
+   * aside instead of copying */
+  if (!v4l2src->always_copy && !gst_v4l2_buffer_pool_available_buffers (pool)
+      && gst_v4l2_buffer_pool_grow (pool)) {
+    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, v4l2src,
+        "running out of buffers, queued %d buffers now",
+        gst_v4l2_buffer_pool_available_buffers (pool));
+  }
+
   /* if we are handing out the last buffer in the pool, we need to make a
    * copy and bring the buffer back in the pool. */
   need_copy = v4l2src->always_copy
@@ -163,6 +257,10 @@ gst_v4l2src_grab_frame (GstV4l2Src * v4l2src, GstBuffer ** buf)
       GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, v4l2src,
           "running out of buffers, making a copy to reuse current one");
     }
+    GST_OBJECT_LOCK (v4l2src);
+    v4l2src->copied_buffers++;
+    GST_OBJECT_UNLOCK (v4l2src);
+
     *buf = gst_buffer_copy (pool_buffer);
     GST_BUFFER_FLAG_UNSET (*buf, GST_BUFFER_FLAG_READONLY);
     /* this will requeue */
@@ -289,6 +387,9 @@ done:
 gboolean
 gst_v4l2src_capture_init (GstV4l2Src * v4l2src, GstCaps * caps)
 {
+  enum v4l2_memory memory;
+  guint32 num_buffers;
+
   GST_DEBUG_OBJECT (v4l2src, "initializing the capture system");
 
   GST_V4L2_CHECK_OPEN (v4l2src->v4l2object);
@@ -299,15 +400,31 @@ gst_v4l2src_capture_init (GstV4l2Src * v4l2src, GstCaps * caps)
     /* Map the buffers */
     GST_LOG_OBJECT (v4l2src, "initiating buffer pool");
 
+    /* in mmap mode, request the buffers the pool may grow into as well */
+    num_buffers = v4l2src->num_buffers;
+    if (v4l2src->io_mode == GST_V4L2SRC_IO_MODE_USERPTR) {
+      memory = V4L2_MEMORY_USERPTR;
+    } else {
+      memory = V4L2_MEMORY_MMAP;
+      num_buffers = MAX (num_buffers, v4l2src->max_queue_size);
+    }
+
     if (!(v4l2src->pool = gst_v4l2_buffer_pool_new (GST_ELEMENT (v4l2src),
                 v4l2src->v4l2object->video_fd,
-                v4l2src->num_buffers, caps, TRUE, V4L2_BUF_TYPE_VIDEO_CAPTURE)))
+                num_buffers, caps, TRUE, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                memory)))
       goto buffer_pool_new_failed;
 
-    GST_INFO_OBJECT (v4l2src, "capturing buffers via mmap()");
+    if (memory == V4L2_MEMORY_USERPTR)
+      GST_INFO_OBJECT (v4l2src, "capturing buffers via user pointers");
+    else
+      GST_INFO_OBJECT (v4l2src, "capturing buffers via mmap()");
     v4l2src->use_mmap = TRUE;
 
-    if (v4l2src->num_buffers != v4l2src->pool->buffer_count) {
+    /* without room to grow, we queue all buffers the driver gave us */
+    if (v4l2src->num_buffers > v4l2src->pool->buffer_count ||
+        (num_buffers == v4l2src->num_buffers &&
+            v4l2src->num_buffers != v4l2src->pool->buffer_count)) {
       v4l2src->num_buffers = v4l2src->pool->buffer_count;
       g_object_notify (G_OBJECT (v4l2src), "queue-size");
     }
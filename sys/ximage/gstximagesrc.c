@@ -27,6 +27,15 @@
  * available to also capture your mouse pointer.  By default it will fixate to
  * 25 frames per second.
  *
+ * When #GstXImageSrc:tile-size is set, every frame is compared to the previous
+ * one in tiles of that size, and a custom downstream event named
+ * "GstXImageSrcChanges" is pushed before every frame but the first. Its
+ * "timestamp" field is the timestamp of the frame and its "rectangles" field
+ * is an array of the changed regions, each an array of x, y, width and
+ * height, so that encoders can skip the unchanged parts of the frame. A frame
+ * that doesn't differ from the previous one has no rectangles and shares its
+ * memory with the previous frame.
+ *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
@@ -75,8 +84,11 @@ enum
   PROP_REMOTE,
   PROP_XID,
   PROP_XNAME,
+  PROP_TILE_SIZE
 };
 
+#define DEFAULT_TILE_SIZE 0
+
 GST_BOILERPLATE (GstXImageSrc, gst_ximage_src, GstPushSrc, GST_TYPE_PUSH_SRC);
 
 static void gst_ximage_src_fixate (GstPad * pad, GstCaps * caps);
@@ -273,11 +285,9 @@ gst_ximage_src_start (GstBaseSrc * basesrc)
   GstXImageSrc *s = GST_XIMAGE_SRC (basesrc);
 
   s->last_frame_no = -1;
-#ifdef HAVE_XDAMAGE
   if (s->last_ximage)
     gst_buffer_unref (GST_BUFFER_CAST (s->last_ximage));
   s->last_ximage = NULL;
-#endif
   return gst_ximage_src_open_display (s, s->display_name);
 }
 
@@ -286,11 +296,9 @@ gst_ximage_src_stop (GstBaseSrc * basesrc)
 {
   GstXImageSrc *src = GST_XIMAGE_SRC (basesrc);
 
-#ifdef HAVE_XDAMAGE
   if (src->last_ximage)
     gst_buffer_unref (GST_BUFFER_CAST (src->last_ximage));
   src->last_ximage = NULL;
-#endif
 
   gst_ximage_src_clear_bufpool (src);
 
@@ -433,10 +441,214 @@ composite_pixel (GstXContext * xcontext, guchar * dest, guchar * src)
 }
 #endif
 
+/* The tiles of one frame. The tile size is taken once per frame, so that the
+ * property can change while we are capturing. */
+typedef struct
+{
+  gint size;
+  gint n_x, n_y;
+  guint8 *changed;
+} GstXImageSrcTiles;
+
+static GstXImageSrcTiles *
+gst_ximage_src_tiles_new (GstXImageSrc * ximagesrc, gint size)
+{
+  GstXImageSrcTiles *tiles = g_slice_new (GstXImageSrcTiles);
+
+  tiles->size = size;
+  tiles->n_x = (ximagesrc->width + size - 1) / size;
+  tiles->n_y = (ximagesrc->height + size - 1) / size;
+  tiles->changed = g_malloc0 (tiles->n_x * tiles->n_y);
+
+  return tiles;
+}
+
+static void
+gst_ximage_src_tiles_free (GstXImageSrcTiles * tiles)
+{
+  if (tiles == NULL)
+    return;
+
+  g_free (tiles->changed);
+  g_slice_free (GstXImageSrcTiles, tiles);
+}
+
+/* Marks the tiles touching the given area of the image for comparison */
+static void
+gst_ximage_src_mark_tiles (GstXImageSrc * ximagesrc,
+    GstXImageSrcTiles * tiles, gint x, gint y, gint width, gint height)
+{
+  gint tx, ty;
+
+  if (tiles == NULL)
+    return;
+
+  if (x < 0) {
+    width += x;
+    x = 0;
+  }
+  if (y < 0) {
+    height += y;
+    y = 0;
+  }
+  width = MIN (width, ximagesrc->width - x);
+  height = MIN (height, ximagesrc->height - y);
+  if (width <= 0 || height <= 0)
+    return;
+
+  for (ty = y / tiles->size; ty <= (y + height - 1) / tiles->size; ty++) {
+    for (tx = x / tiles->size; tx <= (x + width - 1) / tiles->size; tx++)
+      tiles->changed[ty * tiles->n_x + tx] = 1;
+  }
+}
+
+/* Compares the marked tiles of @ximage with the last image, unmarks the ones
+ * that didn't change and returns how many did */
+static guint
+gst_ximage_src_diff_tiles (GstXImageSrc * ximagesrc,
+    GstXImageSrcBuffer * ximage, GstXImageSrcTiles * tiles)
+{
+  XImage *cur = ximage->ximage, *last = ximagesrc->last_ximage->ximage;
+  gint tile_size = tiles->size, pixel_size;
+  gint tx, ty, x, y, width, height;
+  guint changed = 0;
+
+  pixel_size = ximagesrc->xcontext->bpp / 8;
+
+  for (ty = 0; ty < tiles->n_y; ty++) {
+    for (tx = 0; tx < tiles->n_x; tx++) {
+      guint8 *tile = &tiles->changed[ty * tiles->n_x + tx];
+      gsize offset;
+
+      if (!*tile)
+        continue;
+
+      x = tx * tile_size;
+      width = MIN (tile_size, ximagesrc->width - x);
+      height = MIN (tile_size, ximagesrc->height - ty * tile_size);
+
+      /* row by row, so that every byte is only read once per frame */
+      *tile = 0;
+      for (y = ty * tile_size; y < ty * tile_size + height; y++) {
+        offset = (gsize) y * cur->bytes_per_line + x * pixel_size;
+        if (memcmp (cur->data + offset, last->data + offset,
+                width * pixel_size) != 0) {
+          *tile = 1;
+          changed++;
+          break;
+        }
+      }
+    }
+  }
+
+  return changed;
+}
+
+static void
+gst_ximage_src_append_rect (GValue * rects, gint x, gint y, gint width,
+    gint height)
+{
+  GValue rect = { 0, };
+  GValue v = { 0, };
+
+  g_value_init (&rect, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_INT);
+  g_value_set_int (&v, x);
+  gst_value_array_append_value (&rect, &v);
+  g_value_set_int (&v, y);
+  gst_value_array_append_value (&rect, &v);
+  g_value_set_int (&v, width);
+  gst_value_array_append_value (&rect, &v);
+  g_value_set_int (&v, height);
+  gst_value_array_append_value (&rect, &v);
+  g_value_unset (&v);
+
+  gst_value_array_append_value (rects, &rect);
+  g_value_unset (&rect);
+}
+
+/* Creates the event announcing the changed tiles of the frame with
+ * @timestamp, merging neighbouring tiles of a row. Without @tiles nothing
+ * changed. */
+static GstEvent *
+gst_ximage_src_changes_event_new (GstXImageSrc * ximagesrc,
+    GstXImageSrcTiles * tiles, GstClockTime timestamp)
+{
+  GstStructure *structure;
+  GValue rects = { 0, };
+  gint tile_size, tx, ty, start;
+  guint8 *row;
+
+  g_value_init (&rects, GST_TYPE_ARRAY);
+
+  tile_size = tiles ? tiles->size : 0;
+  for (ty = 0; tiles && ty < tiles->n_y; ty++) {
+    row = &tiles->changed[ty * tiles->n_x];
+    tx = 0;
+    while (tx < tiles->n_x) {
+      if (!row[tx]) {
+        tx++;
+        continue;
+      }
+      start = tx;
+      while (tx < tiles->n_x && row[tx])
+        tx++;
+
+      gst_ximage_src_append_rect (&rects, start * tile_size, ty * tile_size,
+          MIN (tx * tile_size, ximagesrc->width) - start * tile_size,
+          MIN ((ty + 1) * tile_size, ximagesrc->height) - ty * tile_size);
+    }
+  }
+
+  structure = gst_structure_new ("GstXImageSrcChanges",
+      "timestamp", G_TYPE_UINT64, timestamp, NULL);
+  gst_structure_set_value (structure, "rectangles", &rects);
+  g_value_unset (&rects);
+
+  return gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM, structure);
+}
+
+#ifdef HAVE_XDAMAGE
+/* Whether the next frame would be the same as the last one, because nothing
+ * was damaged and the cursor didn't change */
+static gboolean
+gst_ximage_src_last_frame_valid (GstXImageSrc * ximagesrc)
+{
+  gboolean ret = TRUE;
+
+  if (!ximagesrc->have_xdamage || !ximagesrc->use_damage ||
+      ximagesrc->last_ximage == NULL)
+    return FALSE;
+
+  if (XPending (ximagesrc->xcontext->disp))
+    return FALSE;
+
+#ifdef HAVE_XFIXES
+  if (ximagesrc->show_pointer && ximagesrc->have_xfixes) {
+    XFixesCursorImage *cursor, *last = ximagesrc->cursor_image;
+
+    cursor = XFixesGetCursorImage (ximagesrc->xcontext->disp);
+    if (cursor == NULL || last == NULL) {
+      ret = (cursor == last);
+    } else {
+      ret = (cursor->x == last->x && cursor->y == last->y &&
+          cursor->cursor_serial == last->cursor_serial);
+    }
+    if (cursor)
+      XFree (cursor);
+  }
+#endif
+
+  return ret;
+}
+#endif
+
 /* Retrieve an XImageSrcBuffer, preferably from our
- * pool of existing images and populate it from the window */
+ * pool of existing images and populate it from the window. If @tiles is not
+ * %NULL, the tiles that may have changed since the last image are marked. */
 static GstXImageSrcBuffer *
-gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
+gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc,
+    GstXImageSrcTiles * tiles)
 {
   GstXImageSrcBuffer *ximage = NULL;
 
@@ -444,13 +656,16 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
   while (ximagesrc->buffer_pool != NULL) {
     ximage = ximagesrc->buffer_pool->data;
 
+    ximagesrc->buffer_pool = g_slist_delete_link (ximagesrc->buffer_pool,
+        ximagesrc->buffer_pool);
+
     if ((ximage->width != ximagesrc->width) ||
         (ximage->height != ximagesrc->height)) {
       gst_ximage_buffer_free (ximage);
+      ximage = NULL;
+    } else {
+      break;
     }
-
-    ximagesrc->buffer_pool = g_slist_delete_link (ximagesrc->buffer_pool,
-        ximagesrc->buffer_pool);
   }
   g_mutex_unlock (ximagesrc->pool_lock);
 
@@ -508,7 +723,7 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
 
     GST_DEBUG_OBJECT (ximagesrc, "Retrieving screen using XDamage");
 
-    do {
+    while (XPending (ximagesrc->xcontext->disp)) {
       XNextEvent (ximagesrc->xcontext->disp, &ev);
 
       if (ev.type == ximagesrc->damage_event_base + XDamageNotify) {
@@ -571,6 +786,9 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
                     startx, starty, width, height, AllPlanes, ZPixmap,
                     ximage->ximage, startx - ximagesrc->startx,
                     starty - ximagesrc->starty);
+                gst_ximage_src_mark_tiles (ximagesrc, tiles,
+                    startx - ximagesrc->startx, starty - ximagesrc->starty,
+                    width, height);
               }
             } else {
 
@@ -582,12 +800,14 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
                   rects[i].x, rects[i].y,
                   rects[i].width, rects[i].height,
                   AllPlanes, ZPixmap, ximage->ximage, rects[i].x, rects[i].y);
+              gst_ximage_src_mark_tiles (ximagesrc, tiles, rects[i].x,
+                  rects[i].y, rects[i].width, rects[i].height);
             }
           }
           free (rects);
         }
       }
-    } while (XPending (ximagesrc->xcontext->disp));
+    }
     if (!have_frame) {
       GST_LOG_OBJECT (ximagesrc,
           "Copying from last frame ximage->size: %d",
@@ -645,12 +865,16 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
               startx, starty, iwidth, iheight, AllPlanes, ZPixmap,
               ximage->ximage, startx - ximagesrc->startx,
               starty - ximagesrc->starty);
+          gst_ximage_src_mark_tiles (ximagesrc, tiles,
+              startx - ximagesrc->startx, starty - ximagesrc->starty,
+              iwidth, iheight);
         }
       } else {
 
         GST_DEBUG_OBJECT (ximagesrc, "Removing cursor from %d,%d", x, y);
         XGetSubImage (ximagesrc->xcontext->disp, ximagesrc->xwindow,
             x, y, width, height, AllPlanes, ZPixmap, ximage->ximage, x, y);
+        gst_ximage_src_mark_tiles (ximagesrc, tiles, x, y, width, height);
       }
     }
 #endif
@@ -659,6 +883,10 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
   } else {
 #endif
 
+    /* the whole image may have changed */
+    if (tiles)
+      memset (tiles->changed, 1, tiles->n_x * tiles->n_y);
+
 #ifdef HAVE_XSHM
     if (ximagesrc->xcontext->use_xshm) {
       GST_DEBUG_OBJECT (ximagesrc, "Retrieving screen using XShm");
@@ -738,6 +966,9 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
 
       if (cursor_in_image) {
         GST_DEBUG_OBJECT (ximagesrc, "Cursor is in image so trying to draw it");
+        gst_ximage_src_mark_tiles (ximagesrc, tiles,
+            startx - ximagesrc->startx, starty - ximagesrc->starty,
+            iwidth, iheight);
         for (i = 0; i < count; i++)
           ximagesrc->cursor_image->pixels[i] =
               GUINT_TO_LE (ximagesrc->cursor_image->pixels[i]);
@@ -766,17 +997,6 @@ gst_ximage_src_ximage_get (GstXImageSrc * ximagesrc)
       }
     }
   }
-#endif
-#ifdef HAVE_XDAMAGE
-  if (ximagesrc->have_xdamage && ximagesrc->use_damage) {
-    /* need to ref ximage to put in last_ximage */
-    gst_buffer_ref (GST_BUFFER (ximage));
-    if (ximagesrc->last_ximage) {
-      gst_buffer_unref (GST_BUFFER (ximagesrc->last_ximage));
-    }
-    ximagesrc->last_ximage = ximage;
-    GST_LOG_OBJECT (ximagesrc, "reffing current buffer for last_ximage");
-  }
 #endif
   return ximage;
 }
@@ -785,11 +1005,14 @@ static GstFlowReturn
 gst_ximage_src_create (GstPushSrc * bs, GstBuffer ** buf)
 {
   GstXImageSrc *s = GST_XIMAGE_SRC (bs);
-  GstXImageSrcBuffer *image;
+  GstXImageSrcBuffer *image = NULL;
   GstClockTime base_time;
   GstClockTime next_capture_ts;
   GstClockTime dur;
   gint64 next_frame_no;
+  gboolean keep_last, have_last;
+  GstXImageSrcTiles *tiles = NULL;
+  guint tile_size;
 
   if (!gst_ximage_src_recalc (s)) {
     GST_ELEMENT_ERROR (s, RESOURCE, FAILED,
@@ -863,16 +1086,66 @@ gst_ximage_src_create (GstPushSrc * bs, GstBuffer ** buf)
     dur = next_frame_ts - next_capture_ts;
   }
   s->last_frame_no = next_frame_no;
+  tile_size = s->tile_size;
   GST_OBJECT_UNLOCK (s);
 
-  image = gst_ximage_src_ximage_get (s);
-  if (!image)
-    return GST_FLOW_ERROR;
+  keep_last = (tile_size > 0);
+#ifdef HAVE_XDAMAGE
+  keep_last = keep_last || (s->have_xdamage && s->use_damage);
+#endif
+  if (!keep_last && s->last_ximage) {
+    gst_buffer_unref (GST_BUFFER (s->last_ximage));
+    s->last_ximage = NULL;
+  }
+  have_last = (s->last_ximage != NULL);
+
+#ifdef HAVE_XDAMAGE
+  if (gst_ximage_src_last_frame_valid (s)) {
+    GST_LOG_OBJECT (s, "nothing changed, reusing last frame");
+  } else
+#endif
+  {
+    if (tile_size > 0 && have_last)
+      tiles = gst_ximage_src_tiles_new (s, tile_size);
+
+    image = gst_ximage_src_ximage_get (s, tiles);
+    if (!image) {
+      gst_ximage_src_tiles_free (tiles);
+      return GST_FLOW_ERROR;
+    }
+
+    if (tiles && gst_ximage_src_diff_tiles (s, image, tiles) == 0) {
+      GST_LOG_OBJECT (s, "no tile changed, reusing last frame");
+      gst_buffer_unref (GST_BUFFER (image));
+      image = NULL;
+      gst_ximage_src_tiles_free (tiles);
+      tiles = NULL;
+    }
+  }
+
+  if (image) {
+    if (keep_last) {
+      if (s->last_ximage)
+        gst_buffer_unref (GST_BUFFER (s->last_ximage));
+      gst_buffer_ref (GST_BUFFER (image));
+      s->last_ximage = image;
+    }
+    *buf = GST_BUFFER (image);
+  } else {
+    /* share the memory of the last frame, its metadata is not ours */
+    *buf = gst_buffer_create_sub (GST_BUFFER (s->last_ximage), 0,
+        GST_BUFFER_SIZE (s->last_ximage));
+    gst_buffer_set_caps (*buf, GST_BUFFER_CAPS (s->last_ximage));
+  }
 
-  *buf = GST_BUFFER (image);
   GST_BUFFER_TIMESTAMP (*buf) = next_capture_ts;
   GST_BUFFER_DURATION (*buf) = dur;
 
+  if (tile_size > 0 && have_last)
+    gst_pad_push_event (GST_BASE_SRC_PAD (s),
+        gst_ximage_src_changes_event_new (s, tiles, next_capture_ts));
+  gst_ximage_src_tiles_free (tiles);
+
   return GST_FLOW_OK;
 }
 
@@ -927,6 +1200,11 @@ gst_ximage_src_set_property (GObject * object, guint prop_id,
       g_free (src->xname);
       src->xname = g_strdup (g_value_get_string (value));
       break;
+    case PROP_TILE_SIZE:
+      GST_OBJECT_LOCK (src);
+      src->tile_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       break;
   }
@@ -976,6 +1254,11 @@ gst_ximage_src_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_XNAME:
       g_value_set_string (value, src->xname);
       break;
+    case PROP_TILE_SIZE:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint (value, src->tile_size);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1267,6 +1550,20 @@ gst_ximage_src_class_init (GstXImageSrcClass * klass)
           "Window name to capture from", NULL,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstXImageSrc:tile-size
+   *
+   * Width and height of the tiles in which every frame is compared to the
+   * previous one, to announce the changed regions downstream. 0 disables the
+   * comparison.
+   *
+   * Since: 0.10.31
+   **/
+  g_object_class_install_property (gc, PROP_TILE_SIZE,
+      g_param_spec_uint ("tile-size", "Tile size",
+          "Size of the tiles to compare frames in (0 = disabled)", 0, 4096,
+          DEFAULT_TILE_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   parent_class = g_type_class_peek_parent (klass);
 
   push_class->create = gst_ximage_src_create;
@@ -1294,6 +1591,7 @@ gst_ximage_src_init (GstXImageSrc * ximagesrc, GstXImageSrcClass * klass)
   ximagesrc->endx = 0;
   ximagesrc->endy = 0;
   ximagesrc->remote = FALSE;
+  ximagesrc->tile_size = DEFAULT_TILE_SIZE;
 }
 
 static gboolean
@@ -90,6 +90,12 @@ struct _GstXImageSrc
   /* whether to use remote friendly calls */
   gboolean remote;
 
+  /* change detection: tiles of tile_size pixels are compared against
+   * last_ximage, which is also used to fill in XDamage updates. tile_size is
+   * protected by the object lock. */
+  guint tile_size;
+  GstXImageSrcBuffer *last_ximage;
+
 #ifdef HAVE_XFIXES
   int fixes_event_base;
   XFixesCursorImage *cursor_image;
@@ -99,7 +105,6 @@ struct _GstXImageSrc
   int damage_event_base;
   XserverRegion damage_region;
   GC damage_copy_gc;
-  GstXImageSrcBuffer *last_ximage;
 #endif
 };
 
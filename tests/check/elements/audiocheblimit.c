@@ -25,6 +25,7 @@
 #include <gst/check/gstcheck.h>
 
 #include <math.h>
+#include <string.h>
 
 /* For ease of programming we use globals to keep refs for our floating
  * src and sink pads we create; otherwise we always have to do get_pad,
@@ -49,7 +50,7 @@ static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw-float, "
-        "channels = (int) 1, "
+        "channels = (int) [ 1, 8 ], "
         "rate = (int) 44100, "
         "endianness = (int) BYTE_ORDER, " "width = (int) { 32, 64 }")
     );
@@ -57,7 +58,7 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw-float, "
-        "channels = (int) 1, "
+        "channels = (int) [ 1, 8 ], "
         "rate = (int) 44100, "
         "endianness = (int) BYTE_ORDER, " "width = (int) { 32, 64 }")
     );
@@ -958,6 +959,82 @@ GST_START_TEST (test_type2_64_hp_22050hz)
 GST_END_TEST;
 
 
+/* Filters @frames frames of @channels channels with an 8 pole lowpass
+ * and returns the output */
+static gfloat *
+filter_32_lp (const gfloat * in, gint frames, gint channels)
+{
+  GstElement *audiocheblimit;
+  GstBuffer *inbuffer;
+  GstCaps *caps;
+  gfloat *out;
+
+  audiocheblimit = setup_audiocheblimit ();
+  /* Set to lowpass */
+  g_object_set (G_OBJECT (audiocheblimit), "mode", 0, NULL);
+  g_object_set (G_OBJECT (audiocheblimit), "type", 1, NULL);
+  g_object_set (G_OBJECT (audiocheblimit), "poles", 8, NULL);
+  g_object_set (G_OBJECT (audiocheblimit), "ripple", 0.25, NULL);
+
+  fail_unless (gst_element_set_state (audiocheblimit,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  g_object_set (G_OBJECT (audiocheblimit), "cutoff", 44100 / 8.0, NULL);
+
+  inbuffer = gst_buffer_new_and_alloc (frames * channels * sizeof (gfloat));
+  memcpy (GST_BUFFER_DATA (inbuffer), in, frames * channels * sizeof (gfloat));
+
+  caps = gst_caps_from_string (BUFFER_CAPS_STRING_32);
+  gst_caps_set_simple (caps, "channels", G_TYPE_INT, channels, NULL);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  fail_unless (g_list_length (buffers) == 1);
+
+  out = g_memdup (GST_BUFFER_DATA (GST_BUFFER (buffers->data)),
+      frames * channels * sizeof (gfloat));
+
+  cleanup_audiocheblimit (audiocheblimit);
+
+  return out;
+}
+
+/* All channels are filtered together, check that this gives the same
+ * result as filtering every channel on its own */
+GST_START_TEST (test_multichannel)
+{
+  gfloat *in, *out, *mono_in, *mono_out;
+  gint i, c, channels, frames = 1000;
+
+  for (channels = 1; channels <= 5; channels++) {
+    in = g_new (gfloat, frames * channels);
+    for (i = 0; i < frames * channels; i++)
+      in[i] = g_random_double_range (-1.0, 1.0);
+
+    out = filter_32_lp (in, frames, channels);
+
+    mono_in = g_new (gfloat, frames);
+    for (c = 0; c < channels; c++) {
+      for (i = 0; i < frames; i++)
+        mono_in[i] = in[i * channels + c];
+
+      mono_out = filter_32_lp (mono_in, frames, 1);
+
+      for (i = 0; i < frames; i++)
+        fail_unless (fabs (mono_out[i] - out[i * channels + c]) < 1e-6);
+      g_free (mono_out);
+    }
+
+    g_free (mono_in);
+    g_free (in);
+    g_free (out);
+  }
+}
+
+GST_END_TEST;
+
 static Suite *
 audiocheblimit_suite (void)
 {
@@ -981,6 +1058,7 @@ audiocheblimit_suite (void)
   tcase_add_test (tc_chain, test_type2_64_lp_22050hz);
   tcase_add_test (tc_chain, test_type2_64_hp_0hz);
   tcase_add_test (tc_chain, test_type2_64_hp_22050hz);
+  tcase_add_test (tc_chain, test_multichannel);
   return s;
 }
 
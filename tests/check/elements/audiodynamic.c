@@ -424,6 +424,158 @@ GST_START_TEST (test_expand_hard_0_200)
 
 GST_END_TEST;
 
+GST_START_TEST (test_compress_hard_50_50_lookahead)
+{
+  GstElement *dynamic;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  gint16 in[200];
+  gint16 *res;
+  gint i;
+
+  for (i = 0; i < 200; i++)
+    in[i] = (i % 2) ? 24576 : -24576;
+
+  dynamic = setup_dynamic ();
+  g_object_set (G_OBJECT (dynamic), "mode", 0, NULL);
+  g_object_set (G_OBJECT (dynamic), "characteristics", 0, NULL);
+  g_object_set (G_OBJECT (dynamic), "ratio", 0.5, NULL);
+  g_object_set (G_OBJECT (dynamic), "threshold", 0.5, NULL);
+  /* 100 samples at 44100 Hz */
+  g_object_set (G_OBJECT (dynamic), "lookahead",
+      gst_util_uint64_scale (100, GST_SECOND, 44100), NULL);
+  fail_unless (gst_element_set_state (dynamic,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  inbuffer = gst_buffer_new_and_alloc (400);
+  memcpy (GST_BUFFER_DATA (inbuffer), in, 400);
+  fail_unless (memcmp (GST_BUFFER_DATA (inbuffer), in, 400) == 0);
+  GST_BUFFER_TIMESTAMP (inbuffer) = 0;
+  caps = gst_caps_from_string (DYNAMIC_CAPS_STRING);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  /* pushing gives away my reference ... */
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  /* ... and puts a new buffer on the global list */
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  fail_if ((outbuffer = (GstBuffer *) buffers->data) == NULL);
+
+  /* the silence of the delay line is dropped, the buffer holds the first
+   * samples, compressed from 0.75 to 0.625 */
+  fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer), 200);
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer), 0);
+  res = (gint16 *) GST_BUFFER_DATA (outbuffer);
+  for (i = 0; i < 100; i++)
+    fail_unless (ABS (res[i] - ((i % 2) ? 20480 : -20480)) <= 1);
+
+  /* the rest comes out at EOS, right after them */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  outbuffer = (GstBuffer *) buffers->next->data;
+  fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer), 200);
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer),
+      gst_util_uint64_scale_int (100, GST_SECOND, 44100));
+  res = (gint16 *) GST_BUFFER_DATA (outbuffer);
+  for (i = 0; i < 100; i++)
+    fail_unless (ABS (res[i] - ((i % 2) ? 20480 : -20480)) <= 1);
+
+  /* cleanup */
+  cleanup_dynamic (dynamic);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_compress_hard_50_50_attack_release_lookahead)
+{
+  GstElement *dynamic;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  gint16 in[1200];
+  gint16 *res;
+  gint i, val;
+
+  /* quiet, a loud passage from 300 to 500, and quiet again */
+  for (i = 0; i < 1200; i++) {
+    val = (i >= 300 && i < 500) ? 24576 : 8192;
+    in[i] = (i % 2) ? val : -val;
+  }
+
+  dynamic = setup_dynamic ();
+  g_object_set (G_OBJECT (dynamic), "mode", 0, NULL);
+  g_object_set (G_OBJECT (dynamic), "characteristics", 0, NULL);
+  g_object_set (G_OBJECT (dynamic), "ratio", 0.5, NULL);
+  g_object_set (G_OBJECT (dynamic), "threshold", 0.5, NULL);
+  g_object_set (G_OBJECT (dynamic), "attack", 1 * GST_MSECOND, NULL);
+  g_object_set (G_OBJECT (dynamic), "release", 10 * GST_MSECOND, NULL);
+  /* 100 samples at 44100 Hz */
+  g_object_set (G_OBJECT (dynamic), "lookahead",
+      gst_util_uint64_scale (100, GST_SECOND, 44100), NULL);
+  fail_unless (gst_element_set_state (dynamic,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  inbuffer = gst_buffer_new_and_alloc (2400);
+  memcpy (GST_BUFFER_DATA (inbuffer), in, 2400);
+  GST_BUFFER_TIMESTAMP (inbuffer) = 0;
+  caps = gst_caps_from_string (DYNAMIC_CAPS_STRING);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  fail_if ((outbuffer = (GstBuffer *) buffers->data) == NULL);
+
+  /* the silence of the delay line is dropped, the output is aligned with
+   * the input */
+  fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer), 2200);
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer), 0);
+  res = (gint16 *) GST_BUFFER_DATA (outbuffer);
+
+  /* the quiet samples are not changed while the loud passage is not in the
+   * lookahead window yet */
+  for (i = 0; i < 200; i++)
+    fail_unless_equals_int (res[i], in[i]);
+
+  /* the gain goes down before the loud passage arrives */
+  fail_unless (ABS (res[299]) < 7500);
+  for (i = 201; i < 300; i++)
+    fail_unless (ABS (res[i]) <= ABS (res[i - 1]) + 1);
+
+  /* the loud passage is compressed from 0.75 to about 0.625 up to its
+   * end, also when the quiet samples are in the lookahead window */
+  for (i = 300; i < 500; i++)
+    fail_unless (ABS (res[i]) < 22000);
+  for (i = 450; i < 500; i++)
+    fail_unless (ABS (ABS (res[i]) - 20480) < 100);
+
+  /* after it the gain rises again with the release time */
+  fail_unless (ABS (res[500]) < 7000);
+  for (i = 501; i < 1100; i++)
+    fail_unless (ABS (res[i]) >= ABS (res[i - 1]) - 1);
+  fail_unless_equals_int (res[1099], in[1099]);
+
+  /* the samples still in the delay line come out at EOS */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  outbuffer = (GstBuffer *) buffers->next->data;
+  fail_unless_equals_int (GST_BUFFER_SIZE (outbuffer), 200);
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (outbuffer),
+      gst_util_uint64_scale_int (1100, GST_SECOND, 44100));
+
+  res = (gint16 *) GST_BUFFER_DATA (outbuffer);
+  for (i = 0; i < 100; i++)
+    fail_unless_equals_int (res[i], in[1100 + i]);
+
+  /* cleanup */
+  cleanup_dynamic (dynamic);
+}
+
+GST_END_TEST;
+
 static Suite *
 dynamic_suite (void)
 {
@@ -438,6 +590,8 @@ dynamic_suite (void)
   tcase_add_test (tc_chain, test_expand_hard_50_200);
   tcase_add_test (tc_chain, test_expand_soft_50_200);
   tcase_add_test (tc_chain, test_expand_hard_0_200);
+  tcase_add_test (tc_chain, test_compress_hard_50_50_lookahead);
+  tcase_add_test (tc_chain, test_compress_hard_50_50_attack_release_lookahead);
   return s;
 }
 
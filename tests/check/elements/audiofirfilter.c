@@ -21,6 +21,32 @@
 #include <gst/gst.h>
 #include <gst/check/gstcheck.h>
 
+#include <string.h>
+#include <math.h>
+
+/* For ease of programming we use globals to keep refs for our floating
+ * src and sink pads we create; otherwise we always have to do get_pad,
+ * get_peer, and then remove references in every test function */
+GstPad *mysrcpad, *mysinkpad;
+
+#define AUDIO_FIR_FILTER_CAPS_STRING           \
+    "audio/x-raw-float, "               \
+    "channels = (int) 2, "              \
+    "rate = (int) 44100, "              \
+    "endianness = (int) BYTE_ORDER, "   \
+    "width = (int) 64"                  \
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (AUDIO_FIR_FILTER_CAPS_STRING)
+    );
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (AUDIO_FIR_FILTER_CAPS_STRING)
+    );
+
 static gboolean have_eos = FALSE;
 
 static gboolean
@@ -154,6 +180,103 @@ GST_START_TEST (test_pipeline)
 
 GST_END_TEST;
 
+/* Feeds an impulse on the left and a step on the right channel through
+ * a long kernel that is split into many partitions and checks the output
+ * against the direct convolution */
+#define KERNEL_LENGTH 1000
+#define INPUT_LENGTH 3000
+
+GST_START_TEST (test_partitioned)
+{
+  GstElement *filter;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  GValueArray *va;
+  GValue v = { 0, };
+  gdouble *kernel, *in, *out, *res, expected;
+  guint i, samples = 0, partition_size;
+  GList *node;
+
+  kernel = g_new (gdouble, KERNEL_LENGTH);
+  for (i = 0; i < KERNEL_LENGTH; i++)
+    kernel[i] = ((i * 7919) % 1000) / 1000.0 - 0.5;
+
+  for (partition_size = 32; partition_size <= 2048; partition_size *= 4) {
+    filter = gst_check_setup_element ("audiofirfilter");
+    mysrcpad = gst_check_setup_src_pad (filter, &srctemplate, NULL);
+    mysinkpad = gst_check_setup_sink_pad (filter, &sinktemplate, NULL);
+    gst_pad_set_active (mysrcpad, TRUE);
+    gst_pad_set_active (mysinkpad, TRUE);
+
+    g_object_set (G_OBJECT (filter), "partition-size", partition_size, NULL);
+
+    va = g_value_array_new (KERNEL_LENGTH);
+    g_value_init (&v, G_TYPE_DOUBLE);
+    for (i = 0; i < KERNEL_LENGTH; i++) {
+      g_value_set_double (&v, kernel[i]);
+      g_value_array_append (va, &v);
+    }
+    g_value_unset (&v);
+    g_object_set (G_OBJECT (filter), "kernel", va, NULL);
+    g_value_array_free (va);
+
+    fail_unless (gst_element_set_state (filter,
+            GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+        "could not set to playing");
+
+    inbuffer = gst_buffer_new_and_alloc (INPUT_LENGTH * 2 * sizeof (gdouble));
+    GST_BUFFER_TIMESTAMP (inbuffer) = 0;
+    in = (gdouble *) GST_BUFFER_DATA (inbuffer);
+    for (i = 0; i < INPUT_LENGTH; i++) {
+      in[2 * i] = (i == 0) ? 1.0 : 0.0;
+      in[2 * i + 1] = 1.0;
+    }
+    caps = gst_caps_from_string (AUDIO_FIR_FILTER_CAPS_STRING);
+    gst_buffer_set_caps (inbuffer, caps);
+    gst_caps_unref (caps);
+
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+    fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+    /* All input samples come out again, including the residue */
+    out = g_new0 (gdouble, INPUT_LENGTH * 2);
+    for (node = buffers; node; node = node->next) {
+      outbuffer = (GstBuffer *) node->data;
+      res = (gdouble *) GST_BUFFER_DATA (outbuffer);
+      fail_unless (samples * 2 * sizeof (gdouble) + GST_BUFFER_SIZE (outbuffer)
+          <= INPUT_LENGTH * 2 * sizeof (gdouble));
+      memcpy (out + samples * 2, res, GST_BUFFER_SIZE (outbuffer));
+      samples += GST_BUFFER_SIZE (outbuffer) / (2 * sizeof (gdouble));
+    }
+    fail_unless_equals_int (samples, INPUT_LENGTH);
+
+    expected = 0.0;
+    for (i = 0; i < INPUT_LENGTH; i++) {
+      if (i < KERNEL_LENGTH)
+        expected += kernel[i];
+      fail_unless (fabs (out[2 * i] - ((i < KERNEL_LENGTH) ? kernel[i] : 0.0))
+          < 1e-9);
+      fail_unless (fabs (out[2 * i + 1] - expected) < 1e-9);
+    }
+    g_free (out);
+
+    g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (buffers);
+    buffers = NULL;
+    samples = 0;
+
+    gst_pad_set_active (mysrcpad, FALSE);
+    gst_pad_set_active (mysinkpad, FALSE);
+    gst_check_teardown_src_pad (filter);
+    gst_check_teardown_sink_pad (filter);
+    gst_check_teardown_element (filter);
+  }
+
+  g_free (kernel);
+}
+
+GST_END_TEST;
+
 static Suite *
 audiofirfilter_suite (void)
 {
@@ -162,6 +285,7 @@ audiofirfilter_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_pipeline);
+  tcase_add_test (tc_chain, test_partitioned);
 
   return s;
 }
@@ -42,6 +42,7 @@ static GstPad *mysrcpad, **mysinkpads;
 static gint nsinkpads;
 static GstBus *bus;
 static GstElement *deinterleave;
+static guint8 *expected_data;
 
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -56,7 +57,7 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw-float, "
         "width = (int) 32, "
-        "channels = (int) { 2, 3 }, "
+        "channels = (int) { 1, 2, 3 }, "
         "rate = (int) {32000, 48000}, " "endianness = (int) BYTE_ORDER"));
 
 #define CAPS_32khz \
@@ -73,6 +74,13 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
         "rate = (int) 48000, " \
 	"endianness = (int) BYTE_ORDER"
 
+#define CAPS_48khz_1CH \
+         "audio/x-raw-float, " \
+        "width = (int) 32, " \
+        "channels = (int) 1, " \
+        "rate = (int) 48000, " \
+	"endianness = (int) BYTE_ORDER"
+
 #define CAPS_48khz_3CH \
          "audio/x-raw-float, " \
         "width = (int) 32, " \
@@ -89,6 +97,8 @@ deinterleave_chain_func (GstPad * pad, GstBuffer * buffer)
   fail_unless (GST_IS_BUFFER (buffer));
   fail_unless_equals_int (GST_BUFFER_SIZE (buffer), 48000 * sizeof (gfloat));
   fail_unless (GST_BUFFER_DATA (buffer) != NULL);
+  if (expected_data)
+    fail_unless (GST_BUFFER_DATA (buffer) == expected_data);
 
   indata = (gfloat *) GST_BUFFER_DATA (buffer);
 
@@ -189,6 +199,69 @@ GST_START_TEST (test_2_channels)
 
 GST_END_TEST;
 
+GST_START_TEST (test_1_channel_passthrough)
+{
+  GstPad *sinkpad;
+  gint i;
+  GstBuffer *inbuf;
+  GstCaps *caps;
+  gfloat *indata;
+
+  mysinkpads = g_new0 (GstPad *, 1);
+  nsinkpads = 0;
+
+  deinterleave = gst_element_factory_make ("deinterleave", NULL);
+  fail_unless (deinterleave != NULL);
+
+  mysrcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  fail_unless (mysrcpad != NULL);
+
+  caps = gst_caps_from_string (CAPS_48khz_1CH);
+  fail_unless (gst_pad_set_caps (mysrcpad, caps));
+  gst_pad_use_fixed_caps (mysrcpad);
+
+  sinkpad = gst_element_get_static_pad (deinterleave, "sink");
+  fail_unless (sinkpad != NULL);
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (sinkpad);
+
+  g_signal_connect (deinterleave, "pad-added",
+      G_CALLBACK (deinterleave_pad_added), GINT_TO_POINTER (1));
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (deinterleave, bus);
+
+  fail_unless (gst_element_set_state (deinterleave,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+
+  inbuf = gst_buffer_new_and_alloc (48000 * sizeof (gfloat));
+  indata = (gfloat *) GST_BUFFER_DATA (inbuf);
+  for (i = 0; i < 48000; i++)
+    indata[i] = -1.0;
+  gst_buffer_set_caps (inbuf, caps);
+
+  /* the mono input must be pushed downstream without copying */
+  expected_data = GST_BUFFER_DATA (inbuf);
+  fail_unless (gst_pad_push (mysrcpad, inbuf) == GST_FLOW_OK);
+  expected_data = NULL;
+
+  fail_unless_equals_int (nsinkpads, 1);
+
+  fail_unless (gst_element_set_state (deinterleave,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < nsinkpads; i++)
+    g_object_unref (mysinkpads[i]);
+  g_free (mysinkpads);
+  mysinkpads = NULL;
+
+  g_object_unref (deinterleave);
+  g_object_unref (bus);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_2_channels_1_linked)
 {
   GstPad *sinkpad;
@@ -549,6 +622,7 @@ deinterleave_suite (void)
   tcase_set_timeout (tc_chain, 180);
   tcase_add_test (tc_chain, test_create_and_unref);
   tcase_add_test (tc_chain, test_2_channels);
+  tcase_add_test (tc_chain, test_1_channel_passthrough);
   tcase_add_test (tc_chain, test_2_channels_1_linked);
   tcase_add_test (tc_chain, test_2_channels_caps_change);
   tcase_add_test (tc_chain, test_8_channels_float32);
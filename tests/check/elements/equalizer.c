@@ -25,6 +25,7 @@
 #include <gst/check/gstcheck.h>
 
 #include <math.h>
+#include <string.h>
 
 /* For ease of programming we use globals to keep refs for our floating
  * src and sink pads we create; otherwise we always have to do get_pad,
@@ -42,7 +43,7 @@ static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw-float, "
-        "channels = (int) 1, "
+        "channels = (int) [ 1, 8 ], "
         "rate = (int) 48000, "
         "endianness = (int) BYTE_ORDER, " "width = (int) 64 ")
     );
@@ -50,7 +51,7 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw-float, "
-        "channels = (int) 1, "
+        "channels = (int) [ 1, 8 ], "
         "rate = (int) 48000, "
         "endianness = (int) BYTE_ORDER, " "width = (int) 64 ")
     );
@@ -294,6 +295,87 @@ GST_START_TEST (test_equalizer_band_number_changing)
 
 GST_END_TEST;
 
+/* Filters @frames frames of @channels channels with a 10 band
+ * equalizer and returns the output */
+static gdouble *
+equalize (const gdouble * in, gint frames, gint channels)
+{
+  GstElement *equalizer;
+  GstBuffer *inbuffer;
+  GstCaps *caps;
+  gdouble *out;
+  gint i;
+
+  equalizer = setup_equalizer ();
+  g_object_set (G_OBJECT (equalizer), "num-bands", 10, NULL);
+
+  for (i = 0; i < 10; i++) {
+    GstObject *band =
+        gst_child_proxy_get_child_by_index (GST_CHILD_PROXY (equalizer), i);
+    fail_unless (band != NULL);
+
+    g_object_set (G_OBJECT (band), "gain", (i % 2) ? -12.0 : 6.0, NULL);
+    g_object_unref (G_OBJECT (band));
+  }
+
+  fail_unless (gst_element_set_state (equalizer,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  inbuffer = gst_buffer_new_and_alloc (frames * channels * sizeof (gdouble));
+  memcpy (GST_BUFFER_DATA (inbuffer), in,
+      frames * channels * sizeof (gdouble));
+
+  caps = gst_caps_from_string (EQUALIZER_CAPS_STRING);
+  gst_caps_set_simple (caps, "channels", G_TYPE_INT, channels, NULL);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  fail_unless (g_list_length (buffers) == 1);
+
+  out = g_memdup (GST_BUFFER_DATA (GST_BUFFER (buffers->data)),
+      frames * channels * sizeof (gdouble));
+
+  cleanup_equalizer (equalizer);
+
+  return out;
+}
+
+/* All channels are filtered together, check that this gives the same
+ * result as filtering every channel on its own */
+GST_START_TEST (test_equalizer_multichannel)
+{
+  gdouble *in, *out, *mono_in, *mono_out;
+  gint i, c, channels, frames = 1000;
+
+  for (channels = 1; channels <= 5; channels++) {
+    in = g_new (gdouble, frames * channels);
+    for (i = 0; i < frames * channels; i++)
+      in[i] = g_random_double_range (-1.0, 1.0);
+
+    out = equalize (in, frames, channels);
+
+    mono_in = g_new (gdouble, frames);
+    for (c = 0; c < channels; c++) {
+      for (i = 0; i < frames; i++)
+        mono_in[i] = in[i * channels + c];
+
+      mono_out = equalize (mono_in, frames, 1);
+
+      for (i = 0; i < frames; i++)
+        fail_unless (fabs (mono_out[i] - out[i * channels + c]) < 1e-10);
+      g_free (mono_out);
+    }
+
+    g_free (mono_in);
+    g_free (in);
+    g_free (out);
+  }
+}
+
+GST_END_TEST;
+
 static Suite *
 equalizer_suite (void)
 {
@@ -305,6 +387,7 @@ equalizer_suite (void)
   tcase_add_test (tc_chain, test_equalizer_5bands_minus_24);
   tcase_add_test (tc_chain, test_equalizer_5bands_plus_12);
   tcase_add_test (tc_chain, test_equalizer_band_number_changing);
+  tcase_add_test (tc_chain, test_equalizer_multichannel);
 
   return s;
 }
@@ -22,6 +22,11 @@
 
 #include <gst/gst.h>
 
+#include <glib/gstdio.h>
+
+#include <string.h>
+#include <unistd.h>
+
 static void
 pad_added_cb (GstElement * flvdemux, GstPad * pad, GstBin * pipeline)
 {
@@ -61,7 +66,7 @@ handoff_cb (GstElement * element, GstBuffer * buf, GstPad * pad,
 
 static void
 process_file (const gchar * file, gboolean push_mode, gint repeat,
-    gint num_buffers)
+    gint num_buffers, GstBuffer ** p_index)
 {
   GstElement *src, *sep, *sink, *flvdemux, *pipeline;
   GstBus *bus;
@@ -91,6 +96,13 @@ process_file (const gchar * file, gboolean push_mode, gint repeat,
   flvdemux = gst_element_factory_make ("flvdemux", "flvdemux");
   fail_unless (flvdemux != NULL, "Failed to create 'flvdemux' element!");
 
+  /* scan the index and import the one from a previous run, if any */
+  if (p_index) {
+    g_object_set (flvdemux, "scan-index", TRUE, NULL);
+    if (*p_index)
+      g_object_set (flvdemux, "keyframe-index", *p_index, NULL);
+  }
+
   sink = gst_element_factory_make ("fakesink", "fakesink");
   fail_unless (sink != NULL, "Failed to create 'fakesink' element!");
 
@@ -140,6 +152,13 @@ process_file (const gchar * file, gboolean push_mode, gint repeat,
       fail_unless_equals_int (counter, num_buffers);
     }
 
+    if (p_index) {
+      if (*p_index)
+        gst_buffer_unref (*p_index);
+      g_object_get (flvdemux, "keyframe-index", p_index, NULL);
+      fail_unless (*p_index != NULL);
+    }
+
     fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
         GST_STATE_CHANGE_SUCCESS);
 
@@ -154,7 +173,7 @@ process_file (const gchar * file, gboolean push_mode, gint repeat,
 
 GST_START_TEST (test_reuse_pull)
 {
-  process_file ("pcm16sine.flv", FALSE, 3, 129);
+  process_file ("pcm16sine.flv", FALSE, 3, 129, NULL);
   gst_task_cleanup_all ();
 }
 
@@ -162,7 +181,176 @@ GST_END_TEST;
 
 GST_START_TEST (test_reuse_push)
 {
-  process_file ("pcm16sine.flv", TRUE, 3, 129);
+  process_file ("pcm16sine.flv", TRUE, 3, 129, NULL);
+  gst_task_cleanup_all ();
+}
+
+GST_END_TEST;
+
+static guint
+check_index (GstBuffer * index)
+{
+  guint8 *data = GST_BUFFER_DATA (index);
+  guint n;
+
+  fail_unless (GST_BUFFER_SIZE (index) >= 20);
+  fail_unless (memcmp (data, "FLVI", 4) == 0);
+  fail_unless_equals_int (data[4], 1);
+
+  n = GST_READ_UINT32_BE (data + 16);
+  fail_unless_equals_int (GST_BUFFER_SIZE (index), 20 + n * 16);
+
+  return n;
+}
+
+GST_START_TEST (test_index_export_import)
+{
+  GstBuffer *index = NULL;
+  guint n;
+
+  /* the audio-only file has an index entry for each tag */
+  process_file ("pcm16sine.flv", FALSE, 1, 129, &index);
+  n = check_index (index);
+  fail_unless (n > 0);
+
+  /* importing it gives us at least the same index again */
+  process_file ("pcm16sine.flv", FALSE, 1, 129, &index);
+  fail_unless (check_index (index) >= n);
+
+  gst_buffer_unref (index);
+  gst_task_cleanup_all ();
+}
+
+GST_END_TEST;
+
+#define SEEK_FILE_TAGS 60
+
+/* writes an audio-only file without metadata, with a tag every second,
+ * and fills @index with a complete serialized index for it */
+static gchar *
+create_seek_file (GstBuffer ** index)
+{
+  static const guint8 header[] = { 'F', 'L', 'V', 1, 0x04, 0, 0, 0, 9,
+    0, 0, 0, 0
+  };
+  GError *err = NULL;
+  guint8 *data, *tag, *entry;
+  gchar *path;
+  guint size, i;
+  gint fd;
+
+  size = sizeof (header) + SEEK_FILE_TAGS * (11 + 3 + 4);
+  data = g_malloc (size);
+  memcpy (data, header, sizeof (header));
+
+  *index = gst_buffer_new_and_alloc (20 + SEEK_FILE_TAGS * 16);
+  entry = GST_BUFFER_DATA (*index);
+  memcpy (entry, "FLVI", 4);
+  entry[4] = 1;
+  entry[5] = 0x01;
+  entry[6] = entry[7] = 0;
+  GST_WRITE_UINT64_BE (entry + 8, size);
+  GST_WRITE_UINT32_BE (entry + 16, SEEK_FILE_TAGS);
+  entry += 20;
+
+  tag = data + sizeof (header);
+  for (i = 0; i < SEEK_FILE_TAGS; i++) {
+    GST_WRITE_UINT64_BE (entry, i * GST_SECOND);
+    GST_WRITE_UINT64_BE (entry + 8, tag - data);
+    entry += 16;
+
+    /* audio tag with one 16 bit mono 44.1 kHz PCM sample */
+    tag[0] = 8;
+    GST_WRITE_UINT24_BE (tag + 1, 3);
+    GST_WRITE_UINT24_BE (tag + 4, i * 1000);
+    tag[7] = tag[8] = tag[9] = tag[10] = 0;
+    tag[11] = 0x3e;
+    tag[12] = tag[13] = 0;
+    GST_WRITE_UINT32_BE (tag + 14, 11 + 3);
+    tag += 11 + 3 + 4;
+  }
+
+  fd = g_file_open_tmp ("flvdemux-seek-XXXXXX.flv", &path, &err);
+  fail_unless (fd >= 0, "Could not create file: %s", err ? err->message : "");
+  close (fd);
+  fail_unless (g_file_set_contents (path, (gchar *) data, size, NULL));
+  g_free (data);
+
+  return path;
+}
+
+static gboolean
+pull_probe_cb (GstPad * pad, GstBuffer * buffer, gint * p_pulls)
+{
+  *p_pulls += 1;
+  return TRUE;
+}
+
+/* prerolls @path and returns how many times flvdemux pulled data for a
+ * flushing seek close to the end of the file */
+static gint
+seek_counting_pulls (const gchar * path, GstBuffer * index)
+{
+  GstElement *src, *flvdemux, *sink, *pipeline;
+  GstStateChangeReturn state_ret;
+  GstPad *sinkpad;
+  gint pulls = 0;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("filesrc", "filesrc");
+  flvdemux = gst_element_factory_make ("flvdemux", "flvdemux");
+  sink = gst_element_factory_make ("fakesink", "fakesink");
+  fail_unless (pipeline && src && flvdemux && sink);
+
+  g_object_set (src, "location", path, NULL);
+  /* no background scan, the index should come from the import only */
+  g_object_set (flvdemux, "scan-index", FALSE, NULL);
+  if (index)
+    g_object_set (flvdemux, "keyframe-index", index, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, flvdemux, sink, NULL);
+  fail_unless (gst_element_link (src, flvdemux));
+  g_signal_connect (flvdemux, "pad-added", G_CALLBACK (pad_added_cb), pipeline);
+
+  state_ret = gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  fail_unless (state_ret != GST_STATE_CHANGE_FAILURE);
+  state_ret = gst_element_get_state (pipeline, NULL, NULL, -1);
+  fail_unless_equals_int (state_ret, GST_STATE_CHANGE_SUCCESS);
+
+  sinkpad = gst_element_get_static_pad (flvdemux, "sink");
+  gst_pad_add_buffer_probe (sinkpad, G_CALLBACK (pull_probe_cb), &pulls);
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, (SEEK_FILE_TAGS - 5) * GST_SECOND));
+  state_ret = gst_element_get_state (pipeline, NULL, NULL, -1);
+  fail_unless_equals_int (state_ret, GST_STATE_CHANGE_SUCCESS);
+
+  GST_LOG ("seek pulled %d times", pulls);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (sinkpad);
+  gst_object_unref (pipeline);
+
+  return pulls;
+}
+
+GST_START_TEST (test_index_import_seek)
+{
+  GstBuffer *index;
+  gchar *path;
+
+  path = create_seek_file (&index);
+
+  /* without an index the seek scans the tag headers up to the position */
+  fail_unless (seek_counting_pulls (path, NULL) >= SEEK_FILE_TAGS / 2);
+
+  /* with the imported index it goes to the position directly */
+  fail_unless (seek_counting_pulls (path, index) < 5);
+
+  g_unlink (path);
+  g_free (path);
+  gst_buffer_unref (index);
   gst_task_cleanup_all ();
 }
 
@@ -177,6 +365,8 @@ flvdemux_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_reuse_push);
   tcase_add_test (tc_chain, test_reuse_pull);
+  tcase_add_test (tc_chain, test_index_export_import);
+  tcase_add_test (tc_chain, test_index_import_seek);
 
   return s;
 }
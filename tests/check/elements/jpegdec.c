@@ -0,0 +1,205 @@
+/* GStreamer
+ *
+ * unit test for jpegdec
+ *
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/app/gstappsink.h>
+
+/* For ease of programming we use globals to keep refs for our floating
+ * src and sink pads we create; otherwise we always have to do get_pad,
+ * get_peer, and then remove references in every test function */
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate jpeg_srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("image/jpeg"));
+
+static GstStaticPadTemplate any_sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstElement *
+setup_jpegdec (void)
+{
+  GstElement *jpegdec;
+
+  GST_DEBUG ("setup_jpegdec");
+  jpegdec = gst_check_setup_element ("jpegdec");
+  mysrcpad = gst_check_setup_src_pad (jpegdec, &jpeg_srctemplate, NULL);
+  mysinkpad = gst_check_setup_sink_pad (jpegdec, &any_sinktemplate, NULL);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  return jpegdec;
+}
+
+static void
+cleanup_jpegdec (GstElement * jpegdec)
+{
+  GST_DEBUG ("cleanup_jpegdec");
+  gst_element_set_state (jpegdec, GST_STATE_NULL);
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (jpegdec);
+  gst_check_teardown_sink_pad (jpegdec);
+  gst_check_teardown_element (jpegdec);
+}
+
+/* Returns 20 frames of a moving ball, encoded with the given restart
+ * interval */
+static GList *
+create_jpeg_buffers (const gchar * format, gint restart_interval)
+{
+  GstElement *pipeline;
+  GstElement *sink;
+  GList *jpegs = NULL;
+  gchar *desc;
+  gint i;
+
+  desc = g_strdup_printf ("videotestsrc pattern=ball num-buffers=20 ! "
+      "video/x-raw-yuv,format=(fourcc)%s,width=320,height=240,"
+      "framerate=25/1 ! jpegenc restart-interval=%d ! appsink name=sink",
+      format, restart_interval);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < 20; i++)
+    jpegs = g_list_append (jpegs,
+        gst_app_sink_pull_buffer (GST_APP_SINK (sink)));
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  gst_object_unref (sink);
+  return jpegs;
+}
+
+/* pushes @jpegs through a jpegdec with @threads threads and returns what it
+ * pushed out */
+static GList *
+decode_frames (GList * jpegs, guint threads)
+{
+  GstElement *jpegdec;
+  GList *result, *l;
+
+  jpegdec = setup_jpegdec ();
+  g_object_set (jpegdec, "threads", threads, NULL);
+  fail_unless (gst_element_set_state (jpegdec,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (l = jpegs; l; l = l->next)
+    fail_unless (gst_pad_push (mysrcpad,
+            gst_buffer_ref (l->data)) == GST_FLOW_OK);
+
+  /* EOS waits for the pictures that are still being decoded */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  result = buffers;
+  buffers = NULL;
+
+  cleanup_jpegdec (jpegdec);
+
+  return result;
+}
+
+static void
+free_buffers (GList * list)
+{
+  g_list_foreach (list, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (list);
+}
+
+/* parallel decoding has to give the same pictures in the same order */
+static void
+check_threads (const gchar * format, gint restart_interval)
+{
+  GList *jpegs, *expected, *decoded, *l, *e;
+
+  jpegs = create_jpeg_buffers (format, restart_interval);
+
+  expected = decode_frames (jpegs, 1);
+  fail_unless_equals_int (g_list_length (expected), 20);
+
+  decoded = decode_frames (jpegs, 4);
+  fail_unless_equals_int (g_list_length (decoded), 20);
+
+  for (l = decoded, e = expected; l; l = l->next, e = e->next) {
+    GstBuffer *buf = l->data, *exp = e->data;
+
+    fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buf),
+        GST_BUFFER_TIMESTAMP (exp));
+    fail_unless_equals_int (GST_BUFFER_SIZE (buf), GST_BUFFER_SIZE (exp));
+    fail_unless (memcmp (GST_BUFFER_DATA (buf), GST_BUFFER_DATA (exp),
+            GST_BUFFER_SIZE (buf)) == 0);
+  }
+
+  free_buffers (expected);
+  free_buffers (decoded);
+  free_buffers (jpegs);
+}
+
+GST_START_TEST (test_jpegdec_threads_frames)
+{
+  /* no restart markers, the frames are decoded in parallel */
+  check_threads ("I420", 0);
+  check_threads ("YUY2", 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_jpegdec_threads_restart_markers)
+{
+  /* one restart marker per MCU row and more than one per row, the slices
+   * are decoded in parallel */
+  check_threads ("I420", 20);
+  check_threads ("I420", 4);
+  check_threads ("YUY2", 20);
+  /* slices of several rows, and an interval that doesn't end on a row */
+  check_threads ("I420", 60);
+  check_threads ("I420", 7);
+}
+
+GST_END_TEST;
+
+static Suite *
+jpegdec_suite (void)
+{
+  Suite *s = suite_create ("jpegdec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_jpegdec_threads_frames);
+  tcase_add_test (tc_chain, test_jpegdec_threads_restart_markers);
+
+  return s;
+}
+
+GST_CHECK_MAIN (jpegdec);
@@ -21,6 +21,7 @@
  */
 
 #include <unistd.h>
+#include <string.h>
 
 #include <gst/check/gstcheck.h>
 #include <gst/app/gstappsink.h>
@@ -216,6 +217,117 @@ GST_START_TEST (test_jpegenc_different_caps)
 
 GST_END_TEST;
 
+/* like create_video_buffer(), but @n frames of a moving ball */
+static GList *
+create_video_buffers (GstCaps * caps, gint n)
+{
+  GstElement *pipeline;
+  GstElement *cf;
+  GstElement *sink;
+  GList *buffers = NULL;
+  gchar *desc;
+  gint i;
+
+  desc = g_strdup_printf ("videotestsrc pattern=ball num-buffers=%d ! "
+      "capsfilter name=cf ! appsink name=sink", n);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  g_assert (pipeline != NULL);
+
+  cf = gst_bin_get_by_name (GST_BIN (pipeline), "cf");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+
+  g_object_set (G_OBJECT (cf), "caps", caps, NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < n; i++)
+    buffers = g_list_append (buffers,
+        gst_app_sink_pull_buffer (GST_APP_SINK (sink)));
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  gst_object_unref (sink);
+  gst_object_unref (cf);
+  return buffers;
+}
+
+/* pushes @frames through a jpegenc with @threads threads and returns what
+ * it pushed out */
+static GList *
+encode_video_buffers (GList * frames, guint threads, guint frames_in_flight)
+{
+  GstElement *jpegenc;
+  GList *result, *l;
+
+  jpegenc = setup_jpegenc (&any_sinktemplate);
+  g_object_set (jpegenc, "threads", threads, "max-frames-in-flight",
+      frames_in_flight, NULL);
+  gst_element_set_state (jpegenc, GST_STATE_PLAYING);
+
+  for (l = frames; l; l = l->next)
+    fail_unless (gst_pad_push (mysrcpad,
+            gst_buffer_ref (l->data)) == GST_FLOW_OK);
+
+  /* EOS waits for the frames that are still being encoded */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  result = buffers;
+  buffers = NULL;
+
+  cleanup_jpegenc (jpegenc);
+
+  return result;
+}
+
+GST_START_TEST (test_jpegenc_threads)
+{
+  const gchar *formats[] = { "I420", "YUY2" };
+  /* the default and the smallest bound on the frames in flight */
+  const guint settings[][2] = { {4, 0}, {4, 1}, {3, 5} };
+  GList *frames, *expected, *encoded, *l, *e;
+  GstCaps *caps;
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    caps = gst_caps_new_simple ("video/x-raw-yuv", "width", G_TYPE_INT,
+        320, "height", G_TYPE_INT, 240, "framerate",
+        GST_TYPE_FRACTION, 25, 1, "format", GST_TYPE_FOURCC,
+        GST_STR_FOURCC (formats[i]), NULL);
+    frames = create_video_buffers (caps, 20);
+    gst_caps_unref (caps);
+
+    expected = encode_video_buffers (frames, 1, 0);
+    fail_unless_equals_int (g_list_length (expected), 20);
+
+    /* parallel encoding has to give the same images in the same order */
+    for (j = 0; j < G_N_ELEMENTS (settings); j++) {
+      encoded = encode_video_buffers (frames, settings[j][0], settings[j][1]);
+      fail_unless_equals_int (g_list_length (encoded), 20);
+
+      for (l = encoded, e = expected; l; l = l->next, e = e->next) {
+        GstBuffer *buf = l->data, *exp = e->data;
+
+        fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buf),
+            GST_BUFFER_TIMESTAMP (exp));
+        fail_unless_equals_int (GST_BUFFER_SIZE (buf), GST_BUFFER_SIZE (exp));
+        fail_unless (memcmp (GST_BUFFER_DATA (buf), GST_BUFFER_DATA (exp),
+                GST_BUFFER_SIZE (buf)) == 0);
+      }
+
+      g_list_foreach (encoded, (GFunc) gst_mini_object_unref, NULL);
+      g_list_free (encoded);
+    }
+
+    g_list_foreach (expected, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (expected);
+    g_list_foreach (frames, (GFunc) gst_mini_object_unref, NULL);
+    g_list_free (frames);
+  }
+}
+
+GST_END_TEST;
+
 static Suite *
 jpegenc_suite (void)
 {
@@ -225,6 +337,7 @@ jpegenc_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_jpegenc_getcaps);
   tcase_add_test (tc_chain, test_jpegenc_different_caps);
+  tcase_add_test (tc_chain, test_jpegenc_threads);
 
   return s;
 }
@@ -50,6 +50,15 @@ GstPad *mysrcpad, *mysinkpad;
     "depth = (int) 16, " \
     "signed = (boolean) true"
 
+#define LEVEL_CAPS_STRING_48000 \
+  "audio/x-raw-int, " \
+    "rate = (int) 48000, " \
+    "channels = (int) 2, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "width = (int) 16, " \
+    "depth = (int) 16, " \
+    "signed = (boolean) true"
+
 
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -295,6 +304,123 @@ GST_START_TEST (test_int16_panned)
 
 GST_END_TEST;
 
+GST_START_TEST (test_int16_compact)
+{
+  GstElement *level;
+  GstBuffer *inbuffer, *outbuffer, *values;
+  GstBus *bus;
+  GstCaps *caps;
+  GstMessage *message;
+  const GstStructure *structure;
+  int i, j;
+  gint16 *data;
+  gdouble *dB, loudness;
+  /* expected dB of a half-amplitude 997 Hz sine for each field */
+  const gdouble expected[4] = { -9.03, -6.02, -6.02, -6.01 };
+  GstClockTime endtime;
+  const gchar *fields[4] = { "rms", "peak", "decay", "true-peak" };
+
+  level = setup_level ();
+  g_object_set (level, "message", TRUE, "interval", GST_SECOND / 10,
+      "true-peak", TRUE, "loudness", TRUE, "compact-messages", TRUE, NULL);
+
+  fail_unless (gst_element_set_state (level,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* create a fake 0.1 sec buffer with a half-amplitude 997 Hz sine at
+   * 48 kHz, the reference signal of ITU-R BS.1770 */
+  inbuffer = gst_buffer_new_and_alloc (4800 * 2 * sizeof (gint16));
+  data = (gint16 *) GST_BUFFER_DATA (inbuffer);
+  for (j = 0; j < 4800; ++j) {
+    *data = (gint16) floor (16384 * sin (2 * G_PI * 997 * j / 48000) + 0.5);
+    data[1] = data[0];
+    data += 2;
+  }
+  caps = gst_caps_from_string (LEVEL_CAPS_STRING_48000);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  /* create a bus to get the level message on */
+  bus = gst_bus_new ();
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 1);
+  gst_element_set_bus (level, bus);
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 2);
+
+  /* pushing gives away my reference ... */
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  /* ... but it ends up being collected on the global buffer list */
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  fail_if ((outbuffer = (GstBuffer *) buffers->data) == NULL);
+  fail_unless (inbuffer == outbuffer);
+
+  message = gst_bus_poll (bus, GST_MESSAGE_ELEMENT, -1);
+  ASSERT_OBJECT_REFCOUNT (message, "message", 1);
+
+  fail_unless (message != NULL);
+  fail_unless (GST_MESSAGE_SRC (message) == GST_OBJECT (level));
+  fail_unless (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ELEMENT);
+  structure = gst_message_get_structure (message);
+  fail_if (structure == NULL);
+  fail_unless_equals_string ((char *) gst_structure_get_name (structure),
+      "level");
+  fail_unless (gst_structure_get_clock_time (structure, "endtime", &endtime));
+
+  /* the K-weighting has about 0 dB gain at 997 Hz, so both channels of a
+   * sine of -6.02 dBFS give -6.02 LUFS. There is only one 100ms block, the
+   * momentary and short-term loudness are the same. */
+  fail_unless (gst_structure_get_double (structure, "momentary-loudness",
+          &loudness));
+  GST_DEBUG ("momentary loudness is %lf", loudness);
+  fail_if (loudness < -6.12);
+  fail_if (loudness > -5.92);
+  fail_unless (gst_structure_get_double (structure, "short-term-loudness",
+          &loudness));
+  GST_DEBUG ("short-term loudness is %lf", loudness);
+  fail_if (loudness < -6.12);
+  fail_if (loudness > -5.92);
+
+  /* the sine has -9.03 dB rms and -6.02 dB for peak and decay, the true peak
+   * between the samples is a little higher */
+  for (j = 0; j < 4; ++j) {
+    fail_unless (gst_structure_get (structure, fields[j], GST_TYPE_BUFFER,
+            &values, NULL));
+    fail_unless_equals_int (GST_BUFFER_SIZE (values), 2 * sizeof (gdouble));
+    dB = (gdouble *) GST_BUFFER_DATA (values);
+    for (i = 0; i < 2; ++i) {
+      GST_DEBUG ("%s[%d] is %lf", fields[j], i, dB[i]);
+      fail_if (dB[i] < expected[j] - 0.05);
+      fail_if (dB[i] > expected[j] + 0.05);
+    }
+    gst_buffer_unref (values);
+  }
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  fail_if ((outbuffer = (GstBuffer *) buffers->data) == NULL);
+  fail_unless (inbuffer == outbuffer);
+
+  /* clean up */
+  /* flush current messages,and future state change messages */
+  gst_bus_set_flushing (bus, TRUE);
+
+  /* message has a ref to the element */
+  ASSERT_OBJECT_REFCOUNT (level, "level", 2);
+  gst_message_unref (message);
+  ASSERT_OBJECT_REFCOUNT (level, "level", 1);
+
+  gst_element_set_bus (level, NULL);
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 1);
+  gst_object_unref (bus);
+  gst_buffer_unref (outbuffer);
+  fail_unless (gst_element_set_state (level,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+  ASSERT_OBJECT_REFCOUNT (level, "level", 1);
+  cleanup_level (level);
+}
+
+GST_END_TEST;
+
 static Suite *
 level_suite (void)
 {
@@ -304,6 +430,7 @@ level_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_int16);
   tcase_add_test (tc_chain, test_int16_panned);
+  tcase_add_test (tc_chain, test_int16_compact);
 
   return s;
 }
@@ -387,6 +387,54 @@ GST_START_TEST (test_block_group)
 
 GST_END_TEST;
 
+GST_START_TEST (test_buffer_list)
+{
+  GstElement *matroskamux;
+  GstBuffer *inbuffer, *outbuffer;
+  GstCaps *caps;
+  guint8 data[] = { 0xa0, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+    0xa1, 0x85,
+    0x81, 0x00, 0x01, 0x00,
+    0x42
+  };
+
+  matroskamux = setup_matroskamux (&srcac3template);
+  g_object_set (matroskamux, "buffer-list", TRUE, NULL);
+  fail_unless (gst_element_set_state (matroskamux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* Generate the header */
+  inbuffer = gst_buffer_new_and_alloc (1);
+  GST_BUFFER_TIMESTAMP (inbuffer) = 0;
+  caps = gst_caps_from_string (AC3_CAPS_STRING);
+  gst_buffer_set_caps (inbuffer, caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), GST_FLOW_OK);
+  gst_check_drop_buffers ();
+
+  /* Now push a buffer, block group header and payload arrive as one list
+   * which is merged into a single buffer by our list-unaware sink pad */
+  inbuffer = gst_buffer_new_and_alloc (1);
+  GST_BUFFER_DATA (inbuffer)[0] = 0x42;
+  GST_BUFFER_TIMESTAMP (inbuffer) = 1000000;
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+
+  outbuffer = GST_BUFFER (buffers->data);
+  check_buffer_data (outbuffer, data, sizeof (data));
+  gst_check_drop_buffers ();
+
+  cleanup_matroskamux (matroskamux);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_reset)
 {
   GstElement *matroskamux;
@@ -437,6 +485,104 @@ GST_START_TEST (test_reset)
 
 GST_END_TEST;
 
+static guint
+count_clusters (GList * bufs)
+{
+  const guint8 cluster_id[] = { 0x1f, 0x43, 0xb6, 0x75 };
+  GstAdapter *adapter;
+  GstBuffer *outbuffer;
+  guint num_clusters = 0;
+  guint size, j;
+  GList *l;
+
+  adapter = gst_adapter_new ();
+  for (l = bufs; l; l = l->next)
+    gst_adapter_push (adapter, gst_buffer_ref (GST_BUFFER (l->data)));
+
+  size = gst_adapter_available (adapter);
+  outbuffer = gst_adapter_take_buffer (adapter, size);
+  g_object_unref (adapter);
+
+  for (j = 0; j + sizeof (cluster_id) <= size; j++) {
+    if (memcmp (GST_BUFFER_DATA (outbuffer) + j, cluster_id,
+            sizeof (cluster_id)) == 0)
+      num_clusters++;
+  }
+  gst_buffer_unref (outbuffer);
+
+  return num_clusters;
+}
+
+GST_START_TEST (test_max_cluster_duration)
+{
+  GstElement *matroskamux;
+  GstBuffer *inbuffer;
+  GstCaps *caps;
+  int i;
+
+  matroskamux = setup_matroskamux (&srcac3template);
+  g_object_set (matroskamux, "max-cluster-duration", 5 * GST_MSECOND, NULL);
+  fail_unless (gst_element_set_state (matroskamux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (AC3_CAPS_STRING);
+  for (i = 0; i < 4; i++) {
+    inbuffer = gst_buffer_new_and_alloc (1);
+    GST_BUFFER_DATA (inbuffer)[0] = 0x42;
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * 10 * GST_MSECOND;
+    GST_BUFFER_DURATION (inbuffer) = 10 * GST_MSECOND;
+    gst_buffer_set_caps (inbuffer, caps);
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  gst_caps_unref (caps);
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* every buffer is further apart than the maximum cluster duration */
+  fail_unless_equals_int (count_clusters (buffers), 4);
+
+  cleanup_matroskamux (matroskamux);
+  gst_check_drop_buffers ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_max_cluster_size)
+{
+  GstElement *matroskamux;
+  GstBuffer *inbuffer;
+  GstCaps *caps;
+  int i;
+
+  matroskamux = setup_matroskamux (&srcac3template);
+  g_object_set (matroskamux, "max-cluster-size", 100, NULL);
+  fail_unless (gst_element_set_state (matroskamux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (AC3_CAPS_STRING);
+  for (i = 0; i < 4; i++) {
+    inbuffer = gst_buffer_new_and_alloc (200);
+    memset (GST_BUFFER_DATA (inbuffer), 0x42, 200);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_MSECOND;
+    GST_BUFFER_DURATION (inbuffer) = GST_MSECOND;
+    gst_buffer_set_caps (inbuffer, caps);
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  gst_caps_unref (caps);
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* every block overflows the maximum cluster size on its own */
+  fail_unless_equals_int (count_clusters (buffers), 4);
+
+  cleanup_matroskamux (matroskamux);
+  gst_check_drop_buffers ();
+}
+
+GST_END_TEST;
+
 static Suite *
 matroskamux_suite (void)
 {
@@ -447,7 +593,10 @@ matroskamux_suite (void)
   tcase_add_test (tc_chain, test_ebml_header);
   tcase_add_test (tc_chain, test_vorbis_header);
   tcase_add_test (tc_chain, test_block_group);
+  tcase_add_test (tc_chain, test_buffer_list);
   tcase_add_test (tc_chain, test_reset);
+  tcase_add_test (tc_chain, test_max_cluster_duration);
+  tcase_add_test (tc_chain, test_max_cluster_size);
 
   return s;
 }
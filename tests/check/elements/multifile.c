@@ -207,6 +207,76 @@ GST_START_TEST (test_multifilesink_key_unit)
 
 GST_END_TEST;
 
+GST_START_TEST (test_multifilesink_async_write)
+{
+  GstElement *mfs;
+  int i;
+  const gchar *tmpdir;
+  gchar *my_tmpdir;
+  gchar *template;
+  gchar *mfs_pattern;
+  GstBuffer *buf;
+  GstPad *sink;
+  guint64 level;
+
+  tmpdir = g_get_tmp_dir ();
+  template = g_build_filename (tmpdir, "multifile-test-XXXXXX", NULL);
+  my_tmpdir = g_mkdtemp (template);
+  fail_if (my_tmpdir == NULL);
+
+  mfs = gst_element_factory_make ("multifilesink", NULL);
+  fail_if (mfs == NULL);
+  mfs_pattern = g_build_filename (my_tmpdir, "%05d", NULL);
+  /* max-size mode, two buffers per file */
+  g_object_set (G_OBJECT (mfs), "location", mfs_pattern, "next-file", 4,
+      "max-file-size", (guint64) 8, "async-write", TRUE, "max-queue-size",
+      (guint64) 8, "preallocate", (guint64) 4096, NULL);
+  fail_if (gst_element_set_state (mfs,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE);
+
+  sink = gst_element_get_static_pad (mfs, "sink");
+
+  for (i = 0; i < 5; i++) {
+    buf = gst_buffer_new_and_alloc (4);
+    memset (GST_BUFFER_DATA (buf), 'a' + i, 3);
+    GST_BUFFER_DATA (buf)[3] = '\n';
+    fail_if (gst_pad_chain (sink, buf) != GST_FLOW_OK);
+  }
+
+  /* everything is written when EOS is handled */
+  fail_unless (gst_pad_send_event (sink, gst_event_new_eos ()));
+  g_object_get (G_OBJECT (mfs), "queue-level", &level, NULL);
+  fail_unless_equals_uint64 (level, 0);
+  g_object_get (G_OBJECT (mfs), "max-queue-level", &level, NULL);
+  fail_unless (level > 0 && level <= 8);
+
+  fail_if (gst_element_set_state (mfs,
+          GST_STATE_NULL) == GST_STATE_CHANGE_FAILURE);
+
+  for (i = 0; i < 3; i++) {
+    const gchar *expected[] = { "aaa\nbbb\n", "ccc\nddd\n", "eee\n" };
+    gchar *s, *contents;
+    gsize length;
+
+    s = g_strdup_printf (mfs_pattern, i);
+    fail_unless (g_file_get_contents (s, &contents, &length, NULL));
+    fail_unless_equals_int (length, strlen (expected[i]));
+    fail_unless (memcmp (contents, expected[i], length) == 0);
+    g_free (contents);
+    fail_if (g_remove (s) != 0);
+    g_free (s);
+  }
+  /* the file that was opened ahead of time is gone again */
+  fail_if (g_remove (my_tmpdir) != 0);
+
+  g_free (mfs_pattern);
+  g_free (my_tmpdir);
+  gst_object_unref (sink);
+  gst_object_unref (mfs);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_multifilesrc)
 {
   GstElement *pipeline;
@@ -264,6 +334,182 @@ GST_START_TEST (test_multifilesrc)
 
 GST_END_TEST;
 
+static GstPad *mysinkpad;
+static gboolean have_eos;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* gstcheck sets up a chain function that appends buffers to a global list,
+ * this wakes up the test at EOS */
+static gboolean
+event_func (GstPad * pad, GstEvent * event)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    g_mutex_lock (check_mutex);
+    have_eos = TRUE;
+    g_cond_signal (check_cond);
+    g_mutex_unlock (check_mutex);
+  }
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* Runs the source @src until EOS and returns everything it pushed */
+static GString *
+collect_src_data (GstElement * src)
+{
+  GString *data;
+  GList *l;
+
+  mysinkpad = gst_check_setup_sink_pad (src, &sinktemplate, NULL);
+  gst_pad_set_event_function (mysinkpad, event_func);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  have_eos = FALSE;
+  fail_unless (gst_element_set_state (src,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE,
+      "could not set to playing");
+
+  g_mutex_lock (check_mutex);
+  while (!have_eos)
+    g_cond_wait (check_cond, check_mutex);
+  g_mutex_unlock (check_mutex);
+
+  data = g_string_new (NULL);
+  for (l = buffers; l; l = l->next)
+    g_string_append_len (data, (gchar *) GST_BUFFER_DATA (l->data),
+        GST_BUFFER_SIZE (l->data));
+  gst_check_drop_buffers ();
+
+  gst_element_set_state (src, GST_STATE_NULL);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (src);
+  gst_check_teardown_element (src);
+
+  return data;
+}
+
+GST_START_TEST (test_multifilesrc_readahead)
+{
+  const gchar *tmpdir;
+  gchar *my_tmpdir;
+  gchar *template;
+  gchar *mfs_pattern;
+  GstElement *src;
+  GString *expected, *data;
+  int i;
+
+  tmpdir = g_get_tmp_dir ();
+  template = g_build_filename (tmpdir, "multifile-test-XXXXXX", NULL);
+  my_tmpdir = g_mkdtemp (template);
+  fail_if (my_tmpdir == NULL);
+  mfs_pattern = g_build_filename (my_tmpdir, "%05d", NULL);
+
+  /* read-only files of different sizes, the larger ones get mapped */
+  expected = g_string_new (NULL);
+  for (i = 0; i < 20; i++) {
+    gchar *s, *contents;
+
+    s = g_strdup_printf (mfs_pattern, i);
+    contents = g_strnfill (1 + i * 10, 'a' + i);
+    fail_unless (g_file_set_contents (s, contents, -1, NULL));
+    fail_unless (g_chmod (s, 0444) == 0);
+    g_string_append (expected, contents);
+    g_free (contents);
+    g_free (s);
+  }
+
+  src = gst_check_setup_element ("multifilesrc");
+  g_object_set (src, "location", mfs_pattern, "readahead", 5,
+      "mmap-threshold", (guint64) 100, NULL);
+  data = collect_src_data (src);
+
+  fail_unless_equals_int (data->len, expected->len);
+  fail_unless (memcmp (data->str, expected->str, data->len) == 0);
+  g_string_free (data, TRUE);
+  g_string_free (expected, TRUE);
+
+  for (i = 0; i < 20; i++) {
+    char *s;
+
+    s = g_strdup_printf (mfs_pattern, i);
+    fail_if (g_remove (s) != 0);
+    g_free (s);
+  }
+  fail_if (g_remove (my_tmpdir) != 0);
+
+  g_free (mfs_pattern);
+  g_free (my_tmpdir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_splitfilesrc_readahead)
+{
+  const gsize sizes[] = { 700001, 300000, 5, 1500000 };
+  const gchar *tmpdir;
+  gchar *my_tmpdir;
+  gchar *template;
+  gchar *location;
+  GstElement *src;
+  GString *expected, *data;
+  guint i, j;
+
+  tmpdir = g_get_tmp_dir ();
+  template = g_build_filename (tmpdir, "multifile-test-XXXXXX", NULL);
+  my_tmpdir = g_mkdtemp (template);
+  fail_if (my_tmpdir == NULL);
+
+  /* the parts do not line up with the readahead blocks */
+  expected = g_string_new (NULL);
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    gchar *name, *s;
+    GString *part = g_string_new (NULL);
+
+    for (j = 0; j < sizes[i]; j++)
+      g_string_append_c (part, (expected->len + j) * 7 % 251);
+
+    name = g_strdup_printf ("part-%u", i);
+    s = g_build_filename (my_tmpdir, name, NULL);
+    fail_unless (g_file_set_contents (s, part->str, part->len, NULL));
+    g_string_append_len (expected, part->str, part->len);
+    g_string_free (part, TRUE);
+    g_free (name);
+    g_free (s);
+  }
+
+  src = gst_check_setup_element ("splitfilesrc");
+  location = g_build_filename (my_tmpdir, "part-*", NULL);
+  g_object_set (src, "location", location, "readahead", 3,
+      "blocksize", (gulong) 300000, NULL);
+  g_free (location);
+  data = collect_src_data (src);
+
+  fail_unless_equals_int (data->len, expected->len);
+  fail_unless (memcmp (data->str, expected->str, data->len) == 0);
+  g_string_free (data, TRUE);
+  g_string_free (expected, TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    gchar *name, *s;
+
+    name = g_strdup_printf ("part-%u", i);
+    s = g_build_filename (my_tmpdir, name, NULL);
+    fail_if (g_remove (s) != 0);
+    g_free (name);
+    g_free (s);
+  }
+  fail_if (g_remove (my_tmpdir) != 0);
+
+  g_free (my_tmpdir);
+}
+
+GST_END_TEST;
+
 static Suite *
 libvisual_suite (void)
 {
@@ -275,7 +521,10 @@ libvisual_suite (void)
   tcase_add_test (tc_chain, test_multifilesink_key_frame);
   tcase_add_test (tc_chain, test_multifilesink_max_files);
   tcase_add_test (tc_chain, test_multifilesink_key_unit);
+  tcase_add_test (tc_chain, test_multifilesink_async_write);
   tcase_add_test (tc_chain, test_multifilesrc);
+  tcase_add_test (tc_chain, test_multifilesrc_readahead);
+  tcase_add_test (tc_chain, test_splitfilesrc_readahead);
 
   return s;
 }
@@ -0,0 +1,260 @@
+/* GStreamer
+ *
+ * unit test for pngenc
+ *
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/app/gstappsink.h>
+
+/* For ease of programming we use globals to keep refs for our floating
+ * src and sink pads we create; otherwise we always have to do get_pad,
+ * get_peer, and then remove references in every test function */
+static GstPad *mysrcpad, *mysinkpad;
+
+#define RGB_CAPS_STRING "video/x-raw-rgb, " \
+    "bpp = (int) 24, depth = (int) 24, endianness = (int) 4321, " \
+    "red_mask = (int) 16711680, green_mask = (int) 65280, " \
+    "blue_mask = (int) 255, width = (int) 320, height = (int) 240, " \
+    "framerate = (fraction) 25/1"
+
+#define GRAY8_CAPS_STRING "video/x-raw-gray, " \
+    "bpp = (int) 8, depth = (int) 8, width = (int) 320, " \
+    "height = (int) 240, framerate = (fraction) 25/1"
+
+static GstStaticPadTemplate any_sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate any_srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* answers the latency query of pngenc like a live source without latency */
+static gboolean
+src_query_func (GstPad * pad, GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+    return FALSE;
+
+  gst_query_set_latency (query, TRUE, 0, GST_CLOCK_TIME_NONE);
+  return TRUE;
+}
+
+static GstElement *
+setup_pngenc (void)
+{
+  GstElement *pngenc;
+
+  GST_DEBUG ("setup_pngenc");
+  pngenc = gst_check_setup_element ("pngenc");
+  mysinkpad = gst_check_setup_sink_pad (pngenc, &any_sinktemplate, NULL);
+  mysrcpad = gst_check_setup_src_pad (pngenc, &any_srctemplate, NULL);
+  gst_pad_set_query_function (mysrcpad, src_query_func);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  return pngenc;
+}
+
+static void
+cleanup_pngenc (GstElement * pngenc)
+{
+  GST_DEBUG ("cleanup_pngenc");
+  gst_element_set_state (pngenc, GST_STATE_NULL);
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (pngenc);
+  gst_check_teardown_src_pad (pngenc);
+  gst_check_teardown_element (pngenc);
+}
+
+/* @n frames of a moving ball with @caps */
+static GList *
+create_video_buffers (const gchar * caps_string, gint n)
+{
+  GstElement *pipeline;
+  GstElement *cf;
+  GstElement *sink;
+  GstCaps *caps;
+  GList *frames = NULL;
+  gchar *desc;
+  gint i;
+
+  desc = g_strdup_printf ("videotestsrc pattern=ball num-buffers=%d ! "
+      "capsfilter name=cf ! appsink name=sink", n);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  cf = gst_bin_get_by_name (GST_BIN (pipeline), "cf");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+
+  caps = gst_caps_from_string (caps_string);
+  g_object_set (G_OBJECT (cf), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (i = 0; i < n; i++)
+    frames = g_list_append (frames,
+        gst_app_sink_pull_buffer (GST_APP_SINK (sink)));
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  gst_object_unref (sink);
+  gst_object_unref (cf);
+  return frames;
+}
+
+/* pushes @frames through a pngenc with @threads threads and returns what
+ * it pushed out */
+static GList *
+encode_video_buffers (GList * frames, guint threads, guint frames_in_flight)
+{
+  GstElement *pngenc;
+  GList *result, *l;
+
+  pngenc = setup_pngenc ();
+  g_object_set (pngenc, "snapshot", FALSE, "threads", threads,
+      "max-frames-in-flight", frames_in_flight, NULL);
+  fail_unless (gst_element_set_state (pngenc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (l = frames; l; l = l->next)
+    fail_unless (gst_pad_push (mysrcpad,
+            gst_buffer_ref (l->data)) == GST_FLOW_OK);
+
+  /* EOS waits for the frames that are still being encoded */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  result = buffers;
+  buffers = NULL;
+
+  cleanup_pngenc (pngenc);
+
+  return result;
+}
+
+static void
+free_buffers (GList * list)
+{
+  g_list_foreach (list, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (list);
+}
+
+GST_START_TEST (test_pngenc_threads)
+{
+  const gchar *formats[] = { RGB_CAPS_STRING, GRAY8_CAPS_STRING };
+  /* the default and the smallest bound on the frames in flight */
+  const guint settings[][2] = { {4, 0}, {4, 1}, {3, 5} };
+  GList *frames, *expected, *encoded, *l, *e;
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    frames = create_video_buffers (formats[i], 20);
+
+    expected = encode_video_buffers (frames, 1, 0);
+    fail_unless_equals_int (g_list_length (expected), 20);
+
+    /* parallel encoding has to give the same images in the same order */
+    for (j = 0; j < G_N_ELEMENTS (settings); j++) {
+      encoded = encode_video_buffers (frames, settings[j][0], settings[j][1]);
+      fail_unless_equals_int (g_list_length (encoded), 20);
+
+      for (l = encoded, e = expected; l; l = l->next, e = e->next) {
+        GstBuffer *buf = l->data, *exp = e->data;
+
+        fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buf),
+            GST_BUFFER_TIMESTAMP (exp));
+        fail_unless_equals_int (GST_BUFFER_SIZE (buf), GST_BUFFER_SIZE (exp));
+        fail_unless (memcmp (GST_BUFFER_DATA (buf), GST_BUFFER_DATA (exp),
+                GST_BUFFER_SIZE (buf)) == 0);
+      }
+
+      free_buffers (encoded);
+    }
+
+    free_buffers (expected);
+    free_buffers (frames);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pngenc_latency)
+{
+  GstElement *pngenc;
+  GstQuery *query;
+  GstClockTime min, max;
+  gboolean live;
+  GList *frames;
+
+  frames = create_video_buffers (RGB_CAPS_STRING, 1);
+
+  pngenc = setup_pngenc ();
+  g_object_set (pngenc, "snapshot", FALSE, "threads", 2,
+      "max-frames-in-flight", 3, NULL);
+  fail_unless (gst_element_set_state (pngenc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* the framerate is known after the first frame */
+  fail_unless (gst_pad_push (mysrcpad,
+          gst_buffer_ref (frames->data)) == GST_FLOW_OK);
+
+  /* up to two frames at 25 fps are held back */
+  query = gst_query_new_latency ();
+  fail_unless (gst_pad_peer_query (mysinkpad, query));
+  gst_query_parse_latency (query, &live, &min, &max);
+  fail_unless (live);
+  fail_unless_equals_uint64 (min, 80 * GST_MSECOND);
+  fail_unless_equals_uint64 (max, GST_CLOCK_TIME_NONE);
+  gst_query_unref (query);
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  gst_check_drop_buffers ();
+
+  cleanup_pngenc (pngenc);
+  free_buffers (frames);
+}
+
+GST_END_TEST;
+
+static Suite *
+pngenc_suite (void)
+{
+  Suite *s = suite_create ("pngenc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_pngenc_threads);
+  tcase_add_test (tc_chain, test_pngenc_latency);
+
+  return s;
+}
+
+GST_CHECK_MAIN (pngenc);
@@ -0,0 +1,167 @@
+/* GStreamer unit tests for the pulsesink ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#include "../../../ext/pulse/pulsering.h"
+
+/* two segments of 101 frames of 3 channels of 16 bits, like pulsesink
+ * makes it, and not a power of two */
+#define RING_SIZE (2 * 101 * 6)
+
+/* the bytes we move through the ring count up, 251 doesn't divide the
+ * ring size so every lap of the ring holds different values */
+#define BYTE_AT(pos) ((guint8) ((pos) % 251))
+
+static guint64
+produce (GstPulseRing * ring, guint64 pos, guint len)
+{
+  guint8 *dest;
+  guint avail, i;
+
+  while (len > 0) {
+    dest = gst_pulse_ring_get_free (ring, &avail);
+    if (avail == 0)
+      break;
+    avail = MIN (avail, len);
+    for (i = 0; i < avail; i++)
+      dest[i] = BYTE_AT (pos + i);
+    gst_pulse_ring_commit (ring, avail);
+    pos += avail;
+    len -= avail;
+  }
+
+  return pos;
+}
+
+static guint64
+consume (GstPulseRing * ring, guint64 pos, guint len)
+{
+  guint8 buf[RING_SIZE];
+  guint i;
+
+  len = MIN (len, gst_pulse_ring_get_used (ring));
+  gst_pulse_ring_peek (ring, buf, len);
+  i = 0;
+  while (i < len && buf[i] == BYTE_AT (pos + i))
+    i++;
+  fail_unless (i == len, "wrong byte at %" G_GUINT64_FORMAT, pos + i);
+  gst_pulse_ring_skip (ring, len);
+
+  return pos + len;
+}
+
+GST_START_TEST (test_ring_wrap)
+{
+  GstPulseRing ring;
+  guint64 in = 0, out = 0;
+  guint i;
+
+  gst_pulse_ring_init (&ring, RING_SIZE);
+
+  /* start close to the end so that the first write wraps */
+  ring.read = ring.write = RING_SIZE - 6;
+
+  /* move through the ring many times, with write and read sizes that
+   * don't line up with each other or with the ring */
+  for (i = 0; i < 10000; i++) {
+    in = produce (&ring, in, 6 * (1 + i % 37));
+    fail_unless (gst_pulse_ring_get_used (&ring) <= RING_SIZE);
+    out = consume (&ring, out, 6 * (1 + i % 29));
+    fail_unless_equals_int (gst_pulse_ring_get_used (&ring), in - out);
+  }
+  fail_unless (in > 100 * RING_SIZE);
+
+  /* a full ring has no free space, and is empty again after reading it */
+  in = produce (&ring, in, 2 * RING_SIZE);
+  fail_unless_equals_int (gst_pulse_ring_get_used (&ring), RING_SIZE);
+  fail_unless (gst_pulse_ring_get_free (&ring, &i) != NULL);
+  fail_unless_equals_int (i, 0);
+  out = consume (&ring, out, RING_SIZE);
+  fail_unless (in == out);
+
+  /* dropping leaves nothing and the next data comes out right */
+  in = produce (&ring, in, 100);
+  gst_pulse_ring_drop (&ring);
+  fail_unless_equals_int (gst_pulse_ring_get_used (&ring), 0);
+  in = produce (&ring, in, 500);
+  consume (&ring, in - 500, 500);
+
+  gst_pulse_ring_free (&ring);
+}
+
+GST_END_TEST;
+
+#define THREADED_BYTES (16 * 1024 * 1024)
+
+static gpointer
+producer_thread (GstPulseRing * ring)
+{
+  guint64 pos = 0;
+
+  while (pos < THREADED_BYTES) {
+    guint64 next = produce (ring, pos, MIN (THREADED_BYTES - pos, 1000));
+
+    if (next == pos)
+      g_thread_yield ();
+    pos = next;
+  }
+
+  return NULL;
+}
+
+GST_START_TEST (test_ring_threads)
+{
+  GstPulseRing ring;
+  GThread *thread;
+  guint64 out = 0, next;
+
+  gst_pulse_ring_init (&ring, RING_SIZE);
+
+  thread = g_thread_create ((GThreadFunc) producer_thread, &ring, TRUE, NULL);
+  fail_unless (thread != NULL);
+
+  while (out < THREADED_BYTES) {
+    next = consume (&ring, out, 700);
+    if (next == out)
+      g_thread_yield ();
+    out = next;
+  }
+
+  g_thread_join (thread);
+  fail_unless_equals_int (gst_pulse_ring_get_used (&ring), 0);
+
+  gst_pulse_ring_free (&ring);
+}
+
+GST_END_TEST;
+
+static Suite *
+pulsesink_suite (void)
+{
+  Suite *s = suite_create ("pulsesink");
+  TCase *tc_chain = tcase_create ("ring");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_ring_wrap);
+  tcase_add_test (tc_chain, test_ring_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (pulsesink)
@@ -119,7 +119,7 @@ get_expected_gain (guint sample_rate)
 #define SILENCE_GAIN 64.82
 
 #define REPLAY_GAIN_CAPS                                \
-  "channels = (int) { 1, 2 }, "                         \
+  "channels = (int) [ 1, 8 ], "                         \
   "rate = (int) { 8000, 11025, 12000, 16000, 22050, "   \
   "24000, 32000, 44100, 48000 }"
 
@@ -511,6 +511,35 @@ test_buffer_square_float_stereo (gint * accumulator, gint sample_rate,
   return buf;
 }
 
+static GstBuffer *
+test_buffer_square_float_multichannel (gint * accumulator, gint sample_rate,
+    gsize n_frames, gint channels, gfloat value)
+{
+  GstBuffer *buf =
+      gst_buffer_new_and_alloc (n_frames * sizeof (gfloat) * channels);
+  gfloat *data = (gfloat *) GST_BUFFER_DATA (buf);
+  GstCaps *caps;
+  gint i, c;
+
+  for (i = n_frames; i--;) {
+    *accumulator += 1;
+    *accumulator %= 96;
+
+    for (c = 0; c < channels; c++)
+      *data++ = (*accumulator < 48) ? value : -value;
+  }
+
+  caps = gst_caps_new_simple ("audio/x-raw-float",
+      "rate", G_TYPE_INT, sample_rate, "channels", G_TYPE_INT, channels,
+      "endianness", G_TYPE_INT, G_BYTE_ORDER, "width", G_TYPE_INT, 32, NULL);
+  gst_buffer_set_caps (buf, caps);
+  gst_caps_unref (caps);
+
+  ASSERT_BUFFER_REFCOUNT (buf, "buf", 1);
+
+  return buf;
+}
+
 static GstBuffer *
 test_buffer_square_int16_mono (gint * accumulator, gint sample_rate,
     gint depth, gsize n_frames, gint16 value)
@@ -1595,6 +1624,35 @@ GST_START_TEST (test_all_formats)
 
 GST_END_TEST;
 
+/* The loudness of the channels is summed up with equal weights, so a
+ * signal that is the same on all channels gives the same result for any
+ * number of channels. */
+
+GST_START_TEST (test_gain_float_multichannel)
+{
+  GstElement *element = setup_rganalysis ();
+  GstTagList *tag_list;
+  gint accumulator;
+  gint channels, i;
+
+  set_playing_state (element);
+  for (channels = 3; channels <= 8; channels++) {
+    accumulator = 0;
+    for (i = 0; i < 20; i++)
+      push_buffer (test_buffer_square_float_multichannel (&accumulator,
+              44100, 512, channels, 0.25));
+    send_eos_event (element);
+    tag_list = poll_tags (element);
+    fail_unless_track_peak (tag_list, 0.25);
+    fail_unless_track_gain (tag_list, get_expected_gain (44100));
+    gst_tag_list_free (tag_list);
+  }
+
+  cleanup_rganalysis (element);
+}
+
+GST_END_TEST;
+
 /* Checks ensuring all advertised supported sample rates are really
  * accepted, for integer and float, mono and stereo.  This also
  * verifies that the correct gain is computed for all formats (except
@@ -1796,6 +1854,7 @@ rganalysis_suite (void)
   tcase_add_test (tc_chain, test_reference_level);
 
   tcase_add_test (tc_chain, test_all_formats);
+  tcase_add_test (tc_chain, test_gain_float_multichannel);
 
   tcase_add_test (tc_chain, test_gain_float_mono_8000);
   tcase_add_test (tc_chain, test_gain_float_mono_11025);
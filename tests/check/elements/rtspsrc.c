@@ -0,0 +1,350 @@
+/* GStreamer RTSP source unit tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <gst/check/gstcheck.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the server streams this many RTP packets over the RTSP connection */
+#define NUM_PACKETS     50
+#define PAYLOAD_SIZE    160
+
+#define SERVER_REQUEST \
+    "GET_PARAMETER rtsp://127.0.0.1/test RTSP/1.0\r\n" \
+    "CSeq: 100\r\n" \
+    "Session: 1234\r\n" \
+    "\r\n"
+
+#define SERVER_RESPONSE \
+    "RTSP/1.0 200 OK\r\n" \
+    "CSeq: 101\r\n" \
+    "Content-Length: 10\r\n" \
+    "\r\n" \
+    "$123456789"
+
+#define SDP \
+    "v=0\r\n" \
+    "o=- 1 1 IN IP4 127.0.0.1\r\n" \
+    "s=test\r\n" \
+    "c=IN IP4 127.0.0.1\r\n" \
+    "t=0 0\r\n" \
+    "m=audio 0 RTP/AVP 0\r\n" \
+    "a=rtpmap:0 PCMU/8000\r\n" \
+    "a=control:stream=0\r\n"
+
+/* sizes of the pieces the server writes the stream in, so that messages are
+ * split at different places */
+static const gsize piece_sizes[] = { 1, 3, 7, 33, 101, 250, 2, 180 };
+
+static GSocket *server_socket;
+static guint16 server_port;
+static gboolean server_got_reply;
+
+static GMutex *check_mutex;
+static GCond *check_cond;
+static guint received;
+
+static void
+send_all (GSocket * socket, const gchar * data, gsize size)
+{
+  gssize r;
+
+  while (size > 0) {
+    r = g_socket_send (socket, data, size, NULL, NULL);
+    if (r <= 0)
+      return;
+    data += r;
+    size -= r;
+  }
+}
+
+/* returns the next message from the client, or NULL when it went away */
+static gchar *
+receive_message (GSocket * socket, GString * pending)
+{
+  gchar buf[1024], *end, *msg;
+  gssize r;
+
+  while ((end = strstr (pending->str, "\r\n\r\n")) == NULL) {
+    r = g_socket_receive (socket, buf, sizeof (buf), NULL, NULL);
+    if (r <= 0)
+      return NULL;
+    g_string_append_len (pending, buf, r);
+  }
+
+  msg = g_strndup (pending->str, end + 4 - pending->str);
+  g_string_erase (pending, 0, end + 4 - pending->str);
+
+  return msg;
+}
+
+/* the RTP packets, the request and the response in one stream */
+static GString *
+create_stream (void)
+{
+  GString *stream = g_string_new (NULL);
+  guint8 frame[4 + 12 + PAYLOAD_SIZE];
+  guint i;
+
+  for (i = 0; i < NUM_PACKETS; i++) {
+    if (i == 10)
+      g_string_append (stream, SERVER_REQUEST);
+    if (i == 20)
+      g_string_append (stream, SERVER_RESPONSE);
+
+    frame[0] = '$';
+    frame[1] = 0;
+    GST_WRITE_UINT16_BE (frame + 2, 12 + PAYLOAD_SIZE);
+    /* version 2, PCMU */
+    frame[4] = 0x80;
+    frame[5] = 0;
+    GST_WRITE_UINT16_BE (frame + 6, i);
+    GST_WRITE_UINT32_BE (frame + 8, i * PAYLOAD_SIZE);
+    GST_WRITE_UINT32_BE (frame + 12, 0x12345678);
+    memset (frame + 16, i, PAYLOAD_SIZE);
+
+    g_string_append_len (stream, (gchar *) frame, sizeof (frame));
+  }
+
+  return stream;
+}
+
+static void
+send_stream (GSocket * socket)
+{
+  GString *stream = create_stream ();
+  gsize offset = 0, size;
+  guint i;
+
+  for (i = 0; offset < stream->len; i++) {
+    size = MIN (piece_sizes[i % G_N_ELEMENTS (piece_sizes)],
+        stream->len - offset);
+    send_all (socket, stream->str + offset, size);
+    offset += size;
+    /* let the client read the pieces one by one now and then */
+    if (i % 3 == 0)
+      g_usleep (1000);
+  }
+
+  g_string_free (stream, TRUE);
+}
+
+static void
+send_response (GSocket * socket, gint cseq, const gchar * headers,
+    const gchar * body)
+{
+  gchar *response;
+
+  response = g_strdup_printf ("RTSP/1.0 200 OK\r\nCSeq: %d\r\n%s"
+      "Content-Length: %" G_GSIZE_FORMAT "\r\n\r\n%s", cseq, headers,
+      body ? strlen (body) : 0, body ? body : "");
+  send_all (socket, response, strlen (response));
+  g_free (response);
+}
+
+/* answers the requests of one client, and sends the stream after PLAY */
+static gpointer
+server_thread (gpointer data)
+{
+  GString *pending = g_string_new (NULL);
+  GSocket *socket;
+  gchar *msg, *cseq;
+  gboolean done = FALSE;
+
+  socket = g_socket_accept (server_socket, NULL, NULL);
+  fail_unless (socket != NULL);
+
+  while (!done && (msg = receive_message (socket, pending))) {
+    gint seq;
+
+    cseq = strstr (msg, "CSeq:");
+    seq = cseq ? atoi (cseq + 5) : 0;
+
+    if (g_str_has_prefix (msg, "RTSP/1.0 ")) {
+      /* the reply to our request in the stream */
+      if (seq == 100)
+        server_got_reply = TRUE;
+    } else if (g_str_has_prefix (msg, "OPTIONS ")) {
+      send_response (socket, seq,
+          "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN\r\n", NULL);
+    } else if (g_str_has_prefix (msg, "DESCRIBE ")) {
+      send_response (socket, seq, "Content-Type: application/sdp\r\n", SDP);
+    } else if (g_str_has_prefix (msg, "SETUP ")) {
+      send_response (socket, seq,
+          "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
+          "Session: 1234\r\n", NULL);
+    } else if (g_str_has_prefix (msg, "PLAY ")) {
+      send_response (socket, seq, "Session: 1234\r\n", NULL);
+      send_stream (socket);
+    } else {
+      send_response (socket, seq, "Session: 1234\r\n", NULL);
+      done = g_str_has_prefix (msg, "TEARDOWN ");
+    }
+    g_free (msg);
+  }
+
+  g_object_unref (socket);
+  g_string_free (pending, TRUE);
+
+  return NULL;
+}
+
+static GThread *
+start_server (void)
+{
+  GInetAddress *ia;
+  GSocketAddress *sa;
+  GThread *thread;
+
+  server_socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+      G_SOCKET_PROTOCOL_TCP, NULL);
+  fail_unless (server_socket != NULL);
+
+  ia = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  sa = g_inet_socket_address_new (ia, 0);
+  fail_unless (g_socket_bind (server_socket, sa, TRUE, NULL));
+  fail_unless (g_socket_listen (server_socket, NULL));
+  g_object_unref (sa);
+  g_object_unref (ia);
+
+  sa = g_socket_get_local_address (server_socket, NULL);
+  server_port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (sa));
+  g_object_unref (sa);
+
+  server_got_reply = FALSE;
+
+  thread = g_thread_create (server_thread, NULL, TRUE, NULL);
+  fail_unless (thread != NULL);
+
+  return thread;
+}
+
+static void
+handoff_cb (GstElement * sink, GstBuffer * buf, GstPad * pad, gpointer data)
+{
+  guint8 *payload = GST_BUFFER_DATA (buf) + 12;
+  guint i;
+
+  g_mutex_lock (check_mutex);
+  fail_unless_equals_int (GST_BUFFER_SIZE (buf), 12 + PAYLOAD_SIZE);
+  fail_unless_equals_int (GST_READ_UINT16_BE (GST_BUFFER_DATA (buf) + 2),
+      received);
+  for (i = 0; i < PAYLOAD_SIZE; i++) {
+    if (payload[i] != (guint8) received)
+      break;
+  }
+  fail_unless (i == PAYLOAD_SIZE, "packet %u has bad data at %u", received, i);
+
+  received++;
+  g_cond_signal (check_cond);
+  g_mutex_unlock (check_mutex);
+}
+
+/* streams from the server with the rtspsrc properties in @props, and checks
+ * that all packets come out unchanged and the request is answered */
+static void
+run_session (const gchar * props)
+{
+  GstElement *pipeline, *sink;
+  GThread *thread;
+  GTimeVal deadline;
+  gchar *desc;
+
+  thread = start_server ();
+
+  desc = g_strdup_printf ("rtspsrc location=rtsp://127.0.0.1:%u/test "
+      "protocols=tcp latency=0 %s ! fakesink name=sink sync=false "
+      "signal-handoffs=true", server_port, props);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), NULL);
+  gst_object_unref (sink);
+
+  received = 0;
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  g_get_current_time (&deadline);
+  g_time_val_add (&deadline, 10 * G_USEC_PER_SEC);
+  g_mutex_lock (check_mutex);
+  while (received < NUM_PACKETS) {
+    if (!g_cond_timed_wait (check_cond, check_mutex, &deadline))
+      break;
+  }
+  g_mutex_unlock (check_mutex);
+
+  fail_unless_equals_int (received, NUM_PACKETS);
+
+  /* sends the TEARDOWN that stops the server */
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  g_thread_join (thread);
+  g_object_unref (server_socket);
+  server_socket = NULL;
+
+  fail_unless (server_got_reply);
+}
+
+GST_START_TEST (test_bulk_small_chunks)
+{
+  /* smaller than one packet, every message needs a chunk of its own */
+  run_session ("tcp-bulk-size=100");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bulk_large_chunks)
+{
+  run_session ("tcp-bulk-size=4096");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_shared_io)
+{
+  /* the reply to the request is sent by the streaming task, and the partial
+   * messages the reactor leaves behind are completed by its next reads */
+  run_session ("shared-io=true");
+  run_session ("shared-io=true tcp-bulk-size=100");
+}
+
+GST_END_TEST;
+
+static Suite *
+rtspsrc_suite (void)
+{
+  Suite *s = suite_create ("rtspsrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  check_mutex = g_mutex_new ();
+  check_cond = g_cond_new ();
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 60);
+  tcase_add_test (tc_chain, test_bulk_small_chunks);
+  tcase_add_test (tc_chain, test_bulk_large_chunks);
+  tcase_add_test (tc_chain, test_shared_io);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtspsrc)
@@ -53,9 +53,24 @@ static const char *realm = "SOUPHTTPSRC_REALM";
 static const char *basic_auth_path = "/basic_auth";
 static const char *digest_auth_path = "/digest_auth";
 
+/* Size of the resource at /large, which accepts Range requests */
+#define LARGE_SIZE (1024 * 1024 + 123)
+
+/* Number of requests for /large the server got */
+static guint large_requests = 0;
+
+/* Number of connections the server accepted */
+static guint connections = 0;
+
 static int run_server (guint * http_port, guint * https_port);
 static void stop_server (void);
 
+static guint8
+large_byte (guint64 offset)
+{
+  return (offset * 7 + (offset >> 12)) & 0xff;
+}
+
 static void
 handoff_cb (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
     GstBuffer ** p_outbuf)
@@ -356,6 +371,259 @@ got_buffer (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
   fail_unless_equals_string (gst_structure_get_name (s), "application/x-icy");
 }
 
+static void
+check_large_buffer (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    guint64 * bytes)
+{
+  guint i, bad = 0;
+
+  for (i = 0; i < GST_BUFFER_SIZE (buf); i++) {
+    if (GST_BUFFER_DATA (buf)[i] != large_byte (GST_BUFFER_OFFSET (buf) + i))
+      bad++;
+  }
+  fail_unless_equals_int (bad, 0);
+  *bytes += GST_BUFFER_SIZE (buf);
+}
+
+/* Reads /large to the end with the given souphttpsrc properties, seeks back
+ * to the start and reads it again. Returns the number of requests the
+ * server got for the second read. */
+static guint
+run_large_test (const gchar * props)
+{
+  GstElement *pipe, *src, *sink;
+  GstMessage *msg;
+  guint64 bytes = 0, hits, misses, hits_after, misses_after;
+  guint requests;
+  gchar *desc;
+
+  fail_unless (http_port != 0);
+  desc = g_strdup_printf ("souphttpsrc name=src "
+      "location=http://127.0.0.1:%u/large %s ! "
+      "fakesink name=sink signal-handoffs=true sync=false", http_port, props);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipe), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (check_large_buffer), &bytes);
+
+  /* gst_bus_poll() runs the main loop the server lives in */
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE);
+
+  g_object_get (src, "cache-hits", &hits, "cache-misses", &misses, NULL);
+  fail_unless (misses > 0);
+
+  /* read everything again, the element keeps its cache when paused */
+  requests = large_requests;
+  bytes = 0;
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+  fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_BYTES,
+          GST_SEEK_FLAG_FLUSH, 0));
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE);
+  requests = large_requests - requests;
+
+  g_object_get (src, "cache-hits", &hits_after, "cache-misses", &misses_after,
+      NULL);
+  if (requests == 0) {
+    fail_unless (hits_after > hits);
+    fail_unless_equals_uint64 (misses_after, misses);
+  }
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipe);
+
+  return requests;
+}
+
+GST_START_TEST (test_parallel_requests_cache)
+{
+  /* everything fits in the cache */
+  fail_unless_equals_int (run_large_test ("parallel-requests=4 "
+          "cache-block-size=65536"), 0);
+  /* only two blocks fit in memory, the others have to be requested again */
+  fail_unless (run_large_test ("parallel-requests=4 cache-block-size=65536 "
+          "cache-size=131072") > 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parallel_requests_spill)
+{
+  gchar *props;
+
+  /* only two blocks fit in memory, the others are read back from disk */
+  props = g_strdup_printf ("parallel-requests=2 cache-block-size=65536 "
+      "cache-size=131072 cache-location=\"%s\"", g_get_tmp_dir ());
+  fail_unless_equals_int (run_large_test (props), 0);
+  g_free (props);
+}
+
+GST_END_TEST;
+
+/* Waits for @type, gst_bus_poll() runs the main loop the server lives in */
+static void
+wait_for_message (GstElement * pipe, GstMessageType type)
+{
+  GstMessage *msg;
+
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe), type | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), type);
+  gst_message_unref (msg);
+}
+
+GST_START_TEST (test_parallel_requests_seek)
+{
+  GstElement *pipe, *sink;
+  guint64 bytes = 0;
+  gchar *desc;
+
+  fail_unless (http_port != 0);
+  desc = g_strdup_printf ("souphttpsrc location=http://127.0.0.1:%u/large "
+      "parallel-requests=4 cache-block-size=65536 cache-size=131072 ! "
+      "fakesink name=sink signal-handoffs=true sync=false", http_port);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (check_large_buffer), &bytes);
+
+  /* the requests for the blocks after the first one are still in flight
+   * when prerolled, seeking past them cancels them */
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+  wait_for_message (pipe, GST_MESSAGE_ASYNC_DONE);
+  fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_BYTES,
+          GST_SEEK_FLAG_FLUSH, 700017));
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  wait_for_message (pipe, GST_MESSAGE_EOS);
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE - 700017);
+
+  /* the cache is still consistent, blocks are evicted while reading all */
+  bytes = 0;
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+  fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_BYTES,
+          GST_SEEK_FLAG_FLUSH, 0));
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  wait_for_message (pipe, GST_MESSAGE_EOS);
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
+/* Reads @path to the end with a new souphttpsrc */
+static void
+run_keep_alive_test (const gchar * path, gboolean keep_alive)
+{
+  GstElement *pipe;
+  GstMessage *msg;
+  gchar *desc;
+
+  fail_unless (http_port != 0);
+  desc = g_strdup_printf ("souphttpsrc location=http://127.0.0.1:%u%s "
+      "keep-alive=%d ! fakesink sync=false", http_port, path, keep_alive);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (pipe);
+}
+
+GST_START_TEST (test_keep_alive)
+{
+  guint n;
+
+  /* every element connects */
+  n = connections;
+  run_keep_alive_test ("/", FALSE);
+  run_keep_alive_test ("/", FALSE);
+  fail_unless_equals_int (connections - n, 2);
+
+  /* the second element gets the connection of the first one */
+  n = connections;
+  run_keep_alive_test ("/", TRUE);
+  run_keep_alive_test ("/large", TRUE);
+  fail_unless_equals_int (connections - n, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_keep_alive_new_location)
+{
+  GstElement *pipe, *src, *sink;
+  GstMessage *msg;
+  guint64 bytes = 0;
+  guint n = connections;
+  gchar *desc, *location;
+
+  fail_unless (http_port != 0);
+  desc = g_strdup_printf ("souphttpsrc name=src keep-alive=true "
+      "location=http://127.0.0.1:%u/ ! "
+      "fakesink name=sink signal-handoffs=true sync=false", http_port);
+  pipe = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipe != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipe), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipe), "sink");
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* read another location without going through READY */
+  g_signal_connect (sink, "handoff", G_CALLBACK (check_large_buffer), &bytes);
+  location = g_strdup_printf ("http://127.0.0.1:%u/large", http_port);
+  g_object_set (src, "location", location, NULL);
+  g_free (location);
+
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+  fail_unless (gst_element_seek_simple (pipe, GST_FORMAT_BYTES,
+          GST_SEEK_FLAG_FLUSH, 0));
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  fail_unless_equals_uint64 (bytes, LARGE_SIZE);
+
+  /* both over the same connection */
+  fail_unless_equals_int (connections - n, 1);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_icy_stream)
 {
   GstElement *pipe, *src, *sink;
@@ -469,6 +737,11 @@ souphttpsrc_suite (void)
   tcase_add_test (tc_chain, test_good_user_digest_auth);
   tcase_add_test (tc_chain, test_bad_user_digest_auth);
   tcase_add_test (tc_chain, test_bad_password_digest_auth);
+  tcase_add_test (tc_chain, test_parallel_requests_cache);
+  tcase_add_test (tc_chain, test_parallel_requests_spill);
+  tcase_add_test (tc_chain, test_parallel_requests_seek);
+  tcase_add_test (tc_chain, test_keep_alive);
+  tcase_add_test (tc_chain, test_keep_alive_new_location);
   if (soup_ssl_supported)
     tcase_add_test (tc_chain, test_https);
 
@@ -540,6 +813,43 @@ leave:
   g_free (uri);
 }
 
+static void
+do_get_large (SoupMessage * msg)
+{
+  SoupRange *ranges;
+  int n_ranges;
+  goffset start = 0, end = LARGE_SIZE - 1, i;
+  guint8 *buf;
+
+  large_requests++;
+
+  if (soup_message_headers_get_ranges (msg->request_headers, LARGE_SIZE,
+          &ranges, &n_ranges)) {
+    /* souphttpsrc only asks for one range at a time */
+    start = ranges[0].start;
+    end = ranges[0].end;
+    soup_message_headers_free_ranges (msg->request_headers, ranges);
+    soup_message_headers_set_content_range (msg->response_headers, start, end,
+        LARGE_SIZE);
+    soup_message_set_status (msg, SOUP_STATUS_PARTIAL_CONTENT);
+  } else {
+    soup_message_set_status (msg, SOUP_STATUS_OK);
+  }
+  soup_message_headers_append (msg->response_headers, "Accept-Ranges",
+      "bytes");
+
+  if (msg->method == SOUP_METHOD_GET) {
+    buf = g_malloc (end - start + 1);
+    for (i = start; i <= end; i++)
+      buf[i - start] = large_byte (i);
+    soup_message_body_append (msg->response_body, SOUP_MEMORY_TAKE,
+        buf, end - start + 1);
+  } else {
+    soup_message_headers_set_content_length (msg->response_headers,
+        end - start + 1);
+  }
+}
+
 static void
 print_header (const char *name, const char *value, gpointer data)
 {
@@ -551,13 +861,24 @@ server_callback (SoupServer * server, SoupMessage * msg,
     const char *path, GHashTable * query,
     SoupClientContext * context, gpointer data)
 {
+  SoupSocket *sock = soup_client_context_get_socket (context);
+
   GST_DEBUG ("%s %s HTTP/1.%d", msg->method, path,
       soup_message_get_http_version (msg));
+
+  if (!g_object_get_data (G_OBJECT (sock), "souphttpsrc-test-seen")) {
+    g_object_set_data (G_OBJECT (sock), "souphttpsrc-test-seen",
+        GINT_TO_POINTER (1));
+    connections++;
+  }
   soup_message_headers_foreach (msg->request_headers, print_header, NULL);
   if (msg->request_body->length)
     GST_DEBUG ("%s", msg->request_body->data);
 
-  if (msg->method == SOUP_METHOD_GET || msg->method == SOUP_METHOD_HEAD)
+  if ((msg->method == SOUP_METHOD_GET || msg->method == SOUP_METHOD_HEAD) &&
+      !strcmp (path, "/large"))
+    do_get_large (msg);
+  else if (msg->method == SOUP_METHOD_GET || msg->method == SOUP_METHOD_HEAD)
     do_get (msg, path);
   else
     soup_message_set_status (msg, SOUP_STATUS_NOT_IMPLEMENTED);
@@ -77,6 +77,13 @@ GstPad *mysrcpad, *mysinkpad;
     " rate = (int) 44100, "                                           \
     " channels = (int) 1"
 
+#define SPECT_CAPS_STRING_F32_2CH \
+    "audio/x-raw-float, "                                             \
+    " width = (int) 32, "                                             \
+    " endianness = (int) BYTE_ORDER, "                                \
+    " rate = (int) 44100, "                                           \
+    " channels = (int) 2"
+
 #define SPECT_CAPS_STRING_F64 \
     "audio/x-raw-float, "                                             \
     " width = (int) 64, "                                             \
@@ -536,6 +543,122 @@ GST_START_TEST (test_float64)
 
 GST_END_TEST;
 
+GST_START_TEST (test_float32_multichannel_compact)
+{
+  GstElement *spectrum;
+  GstBuffer *inbuffer, *outbuffer, *magnitude, *phase;
+  GstBus *bus;
+  GstCaps *caps;
+  GstMessage *message;
+  const GstStructure *structure;
+  int i, j;
+  gfloat *data, *levels;
+  GstClockTime endtime;
+  gfloat level;
+
+  spectrum = setup_spectrum ();
+  g_object_set (spectrum, "post-messages", TRUE, "interval", GST_SECOND / 100,
+      "bands", SPECT_BANDS, "threshold", -80, "multi-channel", TRUE,
+      "message-phase", TRUE, "compact-messages", TRUE, NULL);
+
+  fail_unless (gst_element_set_state (spectrum,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* create a 1 sec buffer with an 11025 Hz sine wave on the first channel
+   * and silence on the second */
+  inbuffer = gst_buffer_new_and_alloc (2 * 44100 * sizeof (gfloat));
+  data = (gfloat *) GST_BUFFER_DATA (inbuffer);
+  for (j = 0; j < 44100; j += 4) {
+    *data++ = 0.0;
+    *data++ = 0.0;
+    *data++ = 1.0;
+    *data++ = 0.0;
+    *data++ = 0.0;
+    *data++ = 0.0;
+    *data++ = -1.0;
+    *data++ = 0.0;
+  }
+  caps = gst_caps_from_string (SPECT_CAPS_STRING_F32_2CH);
+  gst_buffer_set_caps (inbuffer, caps);
+  gst_caps_unref (caps);
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+
+  /* create a bus to get the spectrum message on */
+  bus = gst_bus_new ();
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 1);
+  gst_element_set_bus (spectrum, bus);
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 2);
+
+  /* pushing gives away my reference ... */
+  fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  /* ... but it ends up being collected on the global buffer list */
+  ASSERT_BUFFER_REFCOUNT (inbuffer, "inbuffer", 1);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  fail_if ((outbuffer = (GstBuffer *) buffers->data) == NULL);
+  fail_unless (inbuffer == outbuffer);
+
+  message = gst_bus_poll (bus, GST_MESSAGE_ELEMENT, -1);
+  ASSERT_OBJECT_REFCOUNT (message, "message", 1);
+
+  fail_unless (message != NULL);
+  fail_unless (GST_MESSAGE_SRC (message) == GST_OBJECT (spectrum));
+  fail_unless (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ELEMENT);
+  structure = gst_message_get_structure (message);
+  fail_if (structure == NULL);
+  fail_unless_equals_string ((char *) gst_structure_get_name (structure),
+      "spectrum");
+  fail_unless (gst_structure_get_clock_time (structure, "endtime", &endtime));
+
+  /* all bands of the first channel followed by those of the second */
+  fail_unless (gst_structure_get (structure, "magnitude", GST_TYPE_BUFFER,
+          &magnitude, "phase", GST_TYPE_BUFFER, &phase, NULL));
+  fail_unless_equals_int (GST_BUFFER_SIZE (magnitude),
+      2 * SPECT_BANDS * sizeof (gfloat));
+  fail_unless_equals_int (GST_BUFFER_SIZE (phase),
+      2 * SPECT_BANDS * sizeof (gfloat));
+
+  levels = (gfloat *) GST_BUFFER_DATA (magnitude);
+  for (i = 0; i < SPECT_BANDS; ++i) {
+    level = levels[i];
+    GST_DEBUG ("band[%3d] is %.2f", i, level);
+    /* Only the bands in the middle should have a level above 60 */
+    fail_if ((i == SPECT_BANDS / 2 || i == SPECT_BANDS / 2 - 1)
+        && level < -20.0);
+    fail_if ((i != SPECT_BANDS / 2 && i != SPECT_BANDS / 2 - 1)
+        && level > -20.0);
+  }
+  /* the silent channel only has values at the threshold */
+  for (i = SPECT_BANDS; i < 2 * SPECT_BANDS; ++i)
+    fail_unless (levels[i] == -80.0);
+
+  levels = (gfloat *) GST_BUFFER_DATA (phase);
+  for (i = 0; i < 2 * SPECT_BANDS; ++i)
+    fail_unless (levels[i] >= -G_PI && levels[i] <= G_PI);
+
+  gst_buffer_unref (magnitude);
+  gst_buffer_unref (phase);
+
+  /* clean up */
+  /* flush current messages,and future state change messages */
+  gst_bus_set_flushing (bus, TRUE);
+
+  /* message has a ref to the element */
+  ASSERT_OBJECT_REFCOUNT (spectrum, "spectrum", 2);
+  gst_message_unref (message);
+  ASSERT_OBJECT_REFCOUNT (spectrum, "spectrum", 1);
+
+  gst_element_set_bus (spectrum, NULL);
+  ASSERT_OBJECT_REFCOUNT (bus, "bus", 1);
+  gst_object_unref (bus);
+  fail_unless (gst_element_set_state (spectrum,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+  ASSERT_OBJECT_REFCOUNT (spectrum, "spectrum", 1);
+  cleanup_spectrum (spectrum);
+}
+
+GST_END_TEST;
+
 
 static Suite *
 spectrum_suite (void)
@@ -548,6 +671,7 @@ spectrum_suite (void)
   tcase_add_test (tc_chain, test_int32);
   tcase_add_test (tc_chain, test_float32);
   tcase_add_test (tc_chain, test_float64);
+  tcase_add_test (tc_chain, test_float32_multichannel_compact);
 
   return s;
 }
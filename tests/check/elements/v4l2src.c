@@ -0,0 +1,201 @@
+/* GStreamer
+ *
+ * unit test for v4l2src
+ *
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* These tests capture from the virtual video driver (modprobe vivi, or vivid
+ * on newer kernels) and do nothing if there is no such device. */
+
+#include <gst/check/gstcheck.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+#define NUM_FRAMES 30
+
+/* number of buffers the sink holds on to, like a deep queue downstream */
+#define HELD_BUFFERS 4
+
+static gchar *
+find_virtual_device (void)
+{
+  gint i;
+
+  for (i = 0; i < 64; i++) {
+    struct v4l2_capability vcap;
+    gchar *device = g_strdup_printf ("/dev/video%d", i);
+    gint fd = open (device, O_RDWR);
+
+    if (fd >= 0) {
+      memset (&vcap, 0, sizeof (vcap));
+      if (ioctl (fd, VIDIOC_QUERYCAP, &vcap) == 0 &&
+          (strcmp ((gchar *) vcap.driver, "vivi") == 0 ||
+              strcmp ((gchar *) vcap.driver, "vivid") == 0) &&
+          (vcap.capabilities & V4L2_CAP_STREAMING)) {
+        close (fd);
+        return device;
+      }
+      close (fd);
+    }
+    g_free (device);
+  }
+
+  GST_INFO ("no vivi device found, skipping test");
+  return NULL;
+}
+
+typedef struct
+{
+  GQueue held;
+  guint frames;
+} Sink;
+
+static void
+hold_buffer (GstElement * sink, GstBuffer * buf, GstPad * pad, Sink * s)
+{
+  g_queue_push_tail (&s->held, gst_buffer_ref (buf));
+  if (g_queue_get_length (&s->held) > HELD_BUFFERS)
+    gst_buffer_unref (g_queue_pop_head (&s->held));
+  s->frames++;
+}
+
+/* Captures NUM_FRAMES frames with the given v4l2src properties while the sink
+ * holds on to the last HELD_BUFFERS of them, and returns the number of
+ * frames v4l2src had to copy */
+static guint64
+capture (const gchar * device, const gchar * props)
+{
+  GstElement *pipeline, *src, *sink;
+  GstBus *bus;
+  GstMessage *msg;
+  Sink s = { G_QUEUE_INIT, 0 };
+  guint64 copied, latency, max_latency;
+  gchar *desc;
+
+  desc = g_strdup_printf ("v4l2src name=src device=%s num-buffers=%d %s ! "
+      "video/x-raw-yuv,width=320,height=240 ! "
+      "fakesink name=sink signal-handoffs=true", device, NUM_FRAMES, props);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (hold_buffer), &s);
+  gst_object_unref (sink);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (s.frames, NUM_FRAMES);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_get (src, "copied-buffers", &copied, "capture-latency", &latency,
+      "max-capture-latency", &max_latency, NULL);
+  gst_object_unref (src);
+  fail_unless (max_latency >= latency);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* the buffers can outlive the pipeline */
+  g_queue_foreach (&s.held, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (&s.held);
+
+  return copied;
+}
+
+GST_START_TEST (test_v4l2src_mmap_copy)
+{
+  gchar *device;
+
+  if (!(device = find_virtual_device ()))
+    return;
+
+  /* the driver runs out of buffers, so frames get copied */
+  fail_unless (capture (device, "always-copy=false queue-size=2") > 0);
+  fail_unless_equals_uint64 (capture (device, "always-copy=true"),
+      NUM_FRAMES);
+
+  g_free (device);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_v4l2src_mmap_grow)
+{
+  gchar *device;
+
+  if (!(device = find_virtual_device ()))
+    return;
+
+  /* the queue grows instead */
+  fail_unless_equals_uint64 (capture (device,
+          "always-copy=false queue-size=2 max-queue-size=8"), 0);
+
+  g_free (device);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_v4l2src_userptr)
+{
+  gchar *device;
+
+  if (!(device = find_virtual_device ()))
+    return;
+
+  /* the frames are captured into buffers that the sink owns */
+  fail_unless_equals_uint64 (capture (device,
+          "io-mode=userptr queue-size=2"), 0);
+  fail_unless_equals_uint64 (capture (device,
+          "io-mode=userptr always-copy=true"), 0);
+
+  g_free (device);
+}
+
+GST_END_TEST;
+
+static Suite *
+v4l2src_suite (void)
+{
+  Suite *s = suite_create ("v4l2src");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_v4l2src_mmap_copy);
+  tcase_add_test (tc_chain, test_v4l2src_mmap_grow);
+  tcase_add_test (tc_chain, test_v4l2src_userptr);
+
+  return s;
+}
+
+GST_CHECK_MAIN (v4l2src);
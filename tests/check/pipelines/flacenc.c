@@ -0,0 +1,173 @@
+/* GStreamer
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+
+/* more than two groups of 16 frames of 4608 samples */
+#define NUM_BUFFERS 200
+#define SAMPLES_PER_BUFFER 1024
+
+static void
+run_pipeline (const gchar * desc)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+static gchar *
+encode (guint threads, gsize * size)
+{
+  gchar *path, *desc, *contents;
+  gint fd;
+
+  fd = g_file_open_tmp ("flacenc-test-XXXXXX.flac", &path, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  desc = g_strdup_printf ("audiotestsrc num-buffers=%d samplesperbuffer=%d ! "
+      "audio/x-raw-int,width=16,depth=16,rate=44100 ! "
+      "flacenc threads=%u ! filesink location=\"%s\"", NUM_BUFFERS,
+      SAMPLES_PER_BUFFER, threads, path);
+  run_pipeline (desc);
+  g_free (desc);
+
+  fail_unless (g_file_get_contents (path, &contents, size, NULL));
+  g_unlink (path);
+  g_free (path);
+
+  return contents;
+}
+
+/* Decodes the stream and returns the MD5 sum of the little endian samples,
+ * which is what STREAMINFO contains */
+static void
+decode (const gchar * data, gsize size, guint8 * digest)
+{
+  GstElement *pipeline, *appsink;
+  GstBuffer *buffer = NULL;
+  GChecksum *md5;
+  gchar *path, *desc;
+  gsize len = 16, samples = 0;
+
+  path = g_build_filename (g_get_tmp_dir (), "flacenc-test.flac", NULL);
+  fail_unless (g_file_set_contents (path, data, size, NULL));
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" ! flacdec ! audioconvert ! "
+      "audio/x-raw-int,width=16,depth=16,endianness=1234 ! "
+      "appsink name=sink", path);
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+  g_free (desc);
+
+  appsink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  fail_unless (appsink != NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  md5 = g_checksum_new (G_CHECKSUM_MD5);
+  do {
+    g_signal_emit_by_name (appsink, "pull-buffer", &buffer);
+    if (buffer == NULL)
+      break;
+    g_checksum_update (md5, GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer));
+    samples += GST_BUFFER_SIZE (buffer) / 2;
+    gst_buffer_unref (buffer);
+  } while (TRUE);
+
+  fail_unless_equals_int (samples, NUM_BUFFERS * SAMPLES_PER_BUFFER);
+  g_checksum_get_digest (md5, digest, &len);
+  g_checksum_free (md5);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (appsink);
+  gst_object_unref (pipeline);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+GST_START_TEST (test_encode_parallel)
+{
+  gchar *data2, *data4;
+  gsize size2, size4;
+  guint64 val;
+  guint8 digest[16];
+
+  data2 = encode (2, &size2);
+  data4 = encode (4, &size4);
+
+  /* the output does not depend on the number of threads */
+  fail_unless_equals_int (size2, size4);
+  fail_unless (memcmp (data2, data4, size2) == 0);
+
+  /* STREAMINFO was updated at the end */
+  fail_unless (size2 > 42);
+  fail_unless (memcmp (data2, "fLaC", 4) == 0);
+  val = GST_READ_UINT64_BE (data2 + 8 + 10);
+  fail_unless_equals_int (val >> 44, 44100);
+  fail_unless_equals_uint64 (val & G_GUINT64_CONSTANT (0x0FFFFFFFFF),
+      NUM_BUFFERS * SAMPLES_PER_BUFFER);
+
+  /* all frames decode and the MD5 sum matches the decoded samples */
+  decode (data2, size2, digest);
+  fail_unless (memcmp (data2 + 8 + 18, digest, 16) == 0);
+
+  g_free (data2);
+  g_free (data4);
+}
+
+GST_END_TEST;
+
+static Suite *
+flacenc_suite (void)
+{
+  Suite *s = suite_create ("flacenc");
+
+  TCase *tc_chain = tcase_create ("linear");
+
+  /* time out after 60s, not the default 3 */
+  tcase_set_timeout (tc_chain, 60);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_encode_parallel);
+
+  return s;
+}
+
+GST_CHECK_MAIN (flacenc);
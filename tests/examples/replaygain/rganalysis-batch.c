@@ -0,0 +1,287 @@
+/* GStreamer
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * rganalysis-batch.c: Analyze many files concurrently with rganalysis
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Computes the ReplayGain values of many files, running one pipeline per
+ * track (or per album with --album) in a pool of worker threads.  The
+ * analysis itself is single threaded per stream, so this is what makes
+ * analyzing a whole music library use all CPU cores.
+ *
+ * With --album, consecutive files in the same directory are treated as
+ * the tracks of one album.  They are analyzed one after the other by the
+ * same rganalysis element, which stays in PLAYING between the tracks as
+ * described in the documentation of its num-tracks property.
+ *
+ * Usage: rganalysis-batch [--jobs=N] [--album] FILE...
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+typedef struct
+{
+  const gchar *filename;
+  gboolean success;
+  gdouble gain, peak;
+} Track;
+
+typedef struct
+{
+  Track *tracks;
+  guint n_tracks;
+  gboolean album;
+  gboolean album_success;
+  gdouble album_gain, album_peak;
+} Job;
+
+static void
+on_pad_added (GstElement * decodebin, GstPad * pad, GstElement * convert)
+{
+  GstPad *sinkpad;
+  GstCaps *caps;
+
+  caps = gst_pad_get_caps (pad);
+  if (g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps,
+                  0)), "audio/")) {
+    sinkpad = gst_element_get_static_pad (convert, "sink");
+    if (!gst_pad_is_linked (sinkpad))
+      gst_pad_link (pad, sinkpad);
+    gst_object_unref (sinkpad);
+  }
+  gst_caps_unref (caps);
+}
+
+/* Plays the pipeline until EOS and collects the results that @rganalysis
+ * posts.  Returns FALSE on errors. */
+static gboolean
+run_track (GstElement * pipeline, GstElement * rganalysis, Track * track,
+    Job * job)
+{
+  GstBus *bus;
+  GstMessage *msg;
+  gboolean done = FALSE, ret = TRUE;
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus (pipeline);
+  while (!done) {
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_TAG);
+
+    switch (GST_MESSAGE_TYPE (msg)) {
+      case GST_MESSAGE_TAG:{
+        GstTagList *tags;
+
+        /* Ignore the tags that are already in the file */
+        if (GST_MESSAGE_SRC (msg) != GST_OBJECT_CAST (rganalysis))
+          break;
+
+        gst_message_parse_tag (msg, &tags);
+        if (gst_tag_list_get_double (tags, GST_TAG_TRACK_GAIN, &track->gain)
+            && gst_tag_list_get_double (tags, GST_TAG_TRACK_PEAK,
+                &track->peak))
+          track->success = TRUE;
+        if (gst_tag_list_get_double (tags, GST_TAG_ALBUM_GAIN,
+                &job->album_gain)
+            && gst_tag_list_get_double (tags, GST_TAG_ALBUM_PEAK,
+                &job->album_peak))
+          job->album_success = TRUE;
+        gst_tag_list_free (tags);
+        break;
+      }
+      case GST_MESSAGE_ERROR:{
+        GError *err = NULL;
+
+        gst_message_parse_error (msg, &err, NULL);
+        g_printerr ("%s: %s\n", track->filename, err->message);
+        g_error_free (err);
+        ret = FALSE;
+        done = TRUE;
+        break;
+      }
+      case GST_MESSAGE_EOS:
+        done = TRUE;
+        break;
+      default:
+        break;
+    }
+    gst_message_unref (msg);
+  }
+  gst_object_unref (bus);
+
+  return ret;
+}
+
+static void
+run_job (Job * job, gpointer user_data)
+{
+  GstElement *pipeline, *src, *decodebin, *convert, *rganalysis;
+  GError *err = NULL;
+  guint i;
+
+  pipeline = gst_parse_launch ("filesrc name=src ! decodebin2 name=dec "
+      "audioconvert name=convert ! audioresample ! rganalysis name=rg "
+      "! fakesink sync=false", &err);
+  if (!pipeline || err) {
+    g_printerr ("could not create pipeline: %s\n",
+        err ? err->message : "unknown error");
+    return;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  decodebin = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+  convert = gst_bin_get_by_name (GST_BIN (pipeline), "convert");
+  rganalysis = gst_bin_get_by_name (GST_BIN (pipeline), "rg");
+
+  g_signal_connect (decodebin, "pad-added", G_CALLBACK (on_pad_added),
+      convert);
+
+  if (job->album)
+    g_object_set (rganalysis, "num-tracks", job->n_tracks, NULL);
+
+  for (i = 0; i < job->n_tracks; i++) {
+    g_object_set (src, "location", job->tracks[i].filename, NULL);
+
+    if (!run_track (pipeline, rganalysis, &job->tracks[i], job))
+      break;
+
+    /* Keep the album state of rganalysis while the rest of the pipeline
+     * goes back to READY for the next track */
+    gst_element_set_locked_state (rganalysis, TRUE);
+    gst_element_set_state (pipeline, GST_STATE_READY);
+  }
+
+  gst_element_set_locked_state (rganalysis, FALSE);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  gst_object_unref (src);
+  gst_object_unref (decodebin);
+  gst_object_unref (convert);
+  gst_object_unref (rganalysis);
+  gst_object_unref (pipeline);
+}
+
+static gint
+get_default_jobs (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  return MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#else
+  return 1;
+#endif
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  gint jobs = get_default_jobs ();
+  gboolean album = FALSE;
+  GOptionEntry options[] = {
+    {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+        "Number of files or albums to analyze at the same time", "N"},
+    {"album", 'a', 0, G_OPTION_ARG_NONE, &album,
+        "Treat the files of a directory as one album", NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GThreadPool *pool;
+  GPtrArray *job_list;
+  Track *tracks;
+  guint n_tracks, i, j;
+
+  ctx = g_option_context_new ("FILE...");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (argc < 2 || jobs < 1) {
+    g_printerr ("usage: %s [--jobs=N] [--album] FILE...\n", argv[0]);
+    return 1;
+  }
+
+  n_tracks = argc - 1;
+  tracks = g_new0 (Track, n_tracks);
+  for (i = 0; i < n_tracks; i++)
+    tracks[i].filename = argv[i + 1];
+
+  /* One job per track, or per run of files in the same directory */
+  job_list = g_ptr_array_new ();
+  for (i = 0; i < n_tracks; i = j) {
+    gchar *dir = g_path_get_dirname (tracks[i].filename);
+    Job *job = g_new0 (Job, 1);
+
+    for (j = i + 1; album && j < n_tracks; j++) {
+      gchar *next_dir = g_path_get_dirname (tracks[j].filename);
+      gboolean same = (strcmp (dir, next_dir) == 0);
+
+      g_free (next_dir);
+      if (!same)
+        break;
+    }
+    g_free (dir);
+
+    job->tracks = &tracks[i];
+    job->n_tracks = j - i;
+    job->album = album;
+    g_ptr_array_add (job_list, job);
+  }
+
+  pool = g_thread_pool_new ((GFunc) run_job, NULL, jobs, TRUE, NULL);
+  for (i = 0; i < job_list->len; i++)
+    g_thread_pool_push (pool, g_ptr_array_index (job_list, i), NULL);
+  /* Waits for all jobs to finish */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < job_list->len; i++) {
+    Job *job = g_ptr_array_index (job_list, i);
+
+    for (j = 0; j < job->n_tracks; j++) {
+      Track *track = &job->tracks[j];
+
+      if (!track->success) {
+        g_print ("%s: no result\n", track->filename);
+      } else if (job->album && job->album_success) {
+        g_print ("%s: track gain %+.2f dB, peak %.6f, "
+            "album gain %+.2f dB, peak %.6f\n", track->filename,
+            track->gain, track->peak, job->album_gain, job->album_peak);
+      } else {
+        g_print ("%s: track gain %+.2f dB, peak %.6f\n", track->filename,
+            track->gain, track->peak);
+      }
+    }
+    g_free (job);
+  }
+  g_ptr_array_free (job_list, TRUE);
+  g_free (tracks);
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+/* GStreamer audiofirfilter partitioned convolution benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Filters some seconds of white noise with audiofirfilter for kernel
+ * sizes from 64 to 65536 samples and prints the latency of the filter
+ * and the CPU time it needs per channel, relative to the duration of
+ * the audio.
+ *
+ * Usage: audiofirfilter-benchmark [partition-size] [channels] [seconds]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include <stdlib.h>
+
+#define RATE 44100
+#define SAMPLES_PER_BUFFER 1024
+
+static void
+set_kernel (GstElement * filter, guint length)
+{
+  GValueArray *va;
+  GValue v = { 0, };
+  guint i;
+
+  va = g_value_array_new (length);
+  g_value_init (&v, G_TYPE_DOUBLE);
+  /* some decaying noise, like a room impulse response */
+  for (i = 0; i < length; i++) {
+    g_value_set_double (&v, (g_random_double () - 0.5) * (length - i) /
+        length);
+    g_value_array_append (va, &v);
+  }
+  g_value_unset (&v);
+
+  g_object_set (G_OBJECT (filter), "kernel", va, NULL);
+  g_value_array_free (va);
+}
+
+/* Runs the pipeline until EOS and returns the time it took. Without a
+ * kernel only the input is generated, otherwise the latency the filter
+ * reports in PAUSED is stored in @latency */
+static GstClockTime
+run (guint kernel_length, guint partition_size, gint channels,
+    guint seconds, GstClockTime * latency)
+{
+  GstElement *pipeline, *src, *capsfilter, *filter = NULL, *sink;
+  GstCaps *caps;
+  GstBus *bus;
+  GstMessage *msg;
+  GstQuery *query;
+  GstClockTime start, elapsed;
+
+  pipeline = gst_pipeline_new (NULL);
+
+  src = gst_element_factory_make ("audiotestsrc", NULL);
+  g_object_set (G_OBJECT (src), "wave", 5, "samplesperbuffer",
+      SAMPLES_PER_BUFFER, "num-buffers",
+      seconds * RATE / SAMPLES_PER_BUFFER, NULL);
+
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  caps = gst_caps_new_simple ("audio/x-raw-float",
+      "width", G_TYPE_INT, 64,
+      "rate", G_TYPE_INT, RATE, "channels", G_TYPE_INT, channels, NULL);
+  g_object_set (G_OBJECT (capsfilter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (G_OBJECT (sink), "sync", FALSE, NULL);
+
+  if (kernel_length > 0) {
+    filter = gst_element_factory_make ("audiofirfilter", NULL);
+    if (!filter) {
+      g_printerr ("audiofirfilter not available\n");
+      exit (1);
+    }
+    g_object_set (G_OBJECT (filter), "partition-size", partition_size, NULL);
+    set_kernel (filter, kernel_length);
+    gst_bin_add_many (GST_BIN (pipeline), src, capsfilter, filter, sink, NULL);
+    gst_element_link_many (src, capsfilter, filter, sink, NULL);
+  } else {
+    gst_bin_add_many (GST_BIN (pipeline), src, capsfilter, sink, NULL);
+    gst_element_link_many (src, capsfilter, sink, NULL);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+  if (filter) {
+    *latency = GST_CLOCK_TIME_NONE;
+    query = gst_query_new_latency ();
+    if (gst_element_query (filter, query))
+      gst_query_parse_latency (query, NULL, latency, NULL);
+    gst_query_unref (query);
+  }
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    g_printerr ("error while running the pipeline\n");
+    exit (1);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  GstClockTime base, elapsed, latency;
+  guint partition_size = 0, seconds = 10, kernel_length;
+  gint channels = 2;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    partition_size = atoi (argv[1]);
+  if (argc > 2)
+    channels = atoi (argv[2]);
+  if (argc > 3)
+    seconds = atoi (argv[3]);
+
+  if (channels <= 0 || seconds == 0) {
+    g_printerr ("usage: %s [partition-size] [channels] [seconds]\n", argv[0]);
+    return 1;
+  }
+
+  /* time for generating the input alone */
+  base = run (0, 0, channels, seconds, NULL);
+
+  g_print ("%u s of %d channel audio, partition size %u%s\n", seconds,
+      channels, partition_size, partition_size ? "" : " (automatic)");
+  g_print ("%8s %14s %14s\n", "kernel", "latency (ms)", "CPU/channel %");
+
+  for (kernel_length = 64; kernel_length <= 65536; kernel_length *= 4) {
+    elapsed = run (kernel_length, partition_size, channels, seconds, &latency);
+    elapsed = (elapsed > base) ? elapsed - base : 0;
+
+    g_print ("%8u %14.2f %14.3f\n", kernel_length,
+        GST_CLOCK_TIME_IS_VALID (latency) ?
+        (gdouble) latency / GST_MSECOND : -1.0,
+        100.0 * elapsed / ((gdouble) seconds * GST_SECOND) / channels);
+  }
+
+  return 0;
+}
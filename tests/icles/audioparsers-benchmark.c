@@ -0,0 +1,296 @@
+/* GStreamer audio parsers throughput benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Writes synthetic MP3, ADTS AAC, AC3, DTS and FLAC streams with random
+ * payload, optionally with some kilobytes of garbage after every N frames to
+ * make the parsers resync, and prints how fast each parser gets through
+ * them in MB/s and how many frames it found.
+ *
+ * Usage: audioparsers-benchmark [megabytes] [frames-between-garbage]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GARBAGE_SIZE 4096
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *parser;
+  /* writes the header of frame @n to @data and returns the frame size */
+  guint (*write_header) (guint8 * data, guint n);
+  guint max_frame_size;
+} Codec;
+
+/* MPEG-1 layer 3, 128 kbit/s, 44100 Hz, joint stereo: 417 bytes */
+static guint
+write_mp3_header (guint8 * data, guint n)
+{
+  GST_WRITE_UINT32_BE (data, 0xfffb9064);
+  return 417;
+}
+
+/* MPEG-4 AAC LC, 44100 Hz, stereo */
+static guint
+write_adts_header (guint8 * data, guint n)
+{
+  guint len = 371;
+
+  data[0] = 0xff;
+  data[1] = 0xf1;
+  data[2] = (1 << 6) | (4 << 2);
+  data[3] = (2 << 6) | ((len >> 11) & 0x3);
+  data[4] = (len >> 3) & 0xff;
+  data[5] = ((len & 0x7) << 5) | 0x1f;
+  data[6] = 0xfc;
+  return len;
+}
+
+/* AC3, 384 kbit/s, 48000 Hz, stereo: 1536 bytes */
+static guint
+write_ac3_header (guint8 * data, guint n)
+{
+  data[0] = 0x0b;
+  data[1] = 0x77;
+  data[2] = data[3] = 0;        /* crc1 */
+  data[4] = (0 << 6) | 28;      /* fscod, frmsizcod */
+  data[5] = (8 << 3) | 0;       /* bsid, bsmod */
+  data[6] = (2 << 5);           /* acmod, dsurmod, lfeon */
+  return 1536;
+}
+
+/* DTS core, 16 bit big endian, 48000 Hz, stereo, 512 samples: 1024 bytes */
+static guint
+write_dts_header (guint8 * data, guint n)
+{
+  GST_WRITE_UINT32_BE (data, 0x7ffe8001);
+  GST_WRITE_UINT16_BE (data + 4, 0xfc3c);
+  GST_WRITE_UINT16_BE (data + 6, 0x3ff0);
+  GST_WRITE_UINT16_BE (data + 8, 0xb400);
+  GST_WRITE_UINT16_BE (data + 10, 0x0000);
+  GST_WRITE_UINT16_BE (data + 12, 0x0000);
+  GST_WRITE_UINT16_BE (data + 14, 0x0000);
+  return 1024;
+}
+
+static guint8
+flac_crc8 (const guint8 * data, guint len)
+{
+  guint8 crc = 0;
+  guint i;
+
+  while (len--) {
+    crc ^= *data++;
+    for (i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+  return crc;
+}
+
+/* Headerless FLAC, 4096 samples, 44100 Hz, stereo, 16 bit */
+static guint
+write_flac_header (guint8 * data, guint n)
+{
+  guint len;
+
+  data[0] = 0xff;
+  data[1] = 0xf8;
+  data[2] = (0xc << 4) | 0x9;
+  data[3] = (0x1 << 4) | (0x4 << 1);
+
+  /* "UTF-8" coded frame number, at most 2^16 frames */
+  if (n < 0x80) {
+    data[4] = n;
+    len = 5;
+  } else if (n < 0x800) {
+    data[4] = 0xc0 | (n >> 6);
+    data[5] = 0x80 | (n & 0x3f);
+    len = 6;
+  } else {
+    data[4] = 0xe0 | ((n >> 12) & 0x0f);
+    data[5] = 0x80 | ((n >> 6) & 0x3f);
+    data[6] = 0x80 | (n & 0x3f);
+    len = 7;
+  }
+  data[len] = flac_crc8 (data, len);
+
+  /* vary the size, FLAC frames have no length field */
+  return 6000 + (n * 7919) % 4000;
+}
+
+static const Codec codecs[] = {
+  {"mp3", "mpegaudioparse", write_mp3_header, 417},
+  {"adts", "aacparse", write_adts_header, 371},
+  {"ac3", "ac3parse", write_ac3_header, 1536},
+  {"dts", "dcaparse", write_dts_header, 1024},
+  {"flac", "flacparse", write_flac_header, 10000}
+};
+
+static gboolean
+write_file (const gchar * filename, const Codec * codec, guint64 size,
+    guint garbage_every, guint * n_frames)
+{
+  FILE *f;
+  guint8 *frame;
+  guint64 written = 0;
+  guint n = 0, len, i;
+
+  if (!(f = fopen (filename, "wb")))
+    return FALSE;
+
+  frame = g_malloc (MAX (codec->max_frame_size, GARBAGE_SIZE));
+
+  while (written < size) {
+    /* random payload, which also contains some false sync words */
+    for (i = 0; i < codec->max_frame_size; i++)
+      frame[i] = g_random_int ();
+    len = codec->write_header (frame, n);
+    fwrite (frame, 1, len, f);
+    written += len;
+    n++;
+
+    if (garbage_every > 0 && n % garbage_every == 0) {
+      for (i = 0; i < GARBAGE_SIZE; i++)
+        frame[i] = g_random_int ();
+      fwrite (frame, 1, GARBAGE_SIZE, f);
+      written += GARBAGE_SIZE;
+    }
+  }
+
+  g_free (frame);
+  *n_frames = n;
+
+  return fclose (f) == 0;
+}
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buf, GstPad * pad, guint * frames)
+{
+  (*frames)++;
+}
+
+/* Parses the file and returns the time it took */
+static GstClockTime
+run (const gchar * filename, const Codec * codec, guint * frames)
+{
+  GstElement *pipeline, *sink;
+  GstBus *bus;
+  GstMessage *msg;
+  GstClockTime start, elapsed;
+  GError *err = NULL;
+  gchar *desc;
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" blocksize=65536 ! %s ! "
+      "fakesink name=sink signal-handoffs=true sync=false", filename,
+      codec->parser);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (!pipeline || err) {
+    g_printerr ("could not create pipeline: %s\n",
+        err ? err->message : "unknown error");
+    exit (1);
+  }
+
+  *frames = 0;
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), frames);
+  gst_object_unref (sink);
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    g_printerr ("error while parsing %s\n", codec->name);
+    exit (1);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  guint megabytes = 64, garbage_every = 0, i;
+  gchar *filename;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    megabytes = atoi (argv[1]);
+  if (argc > 2)
+    garbage_every = atoi (argv[2]);
+
+  if (megabytes == 0) {
+    g_printerr ("usage: %s [megabytes] [frames-between-garbage]\n", argv[0]);
+    return 1;
+  }
+
+  filename = g_build_filename (g_get_tmp_dir (),
+      "audioparsers-benchmark.data", NULL);
+
+  if (garbage_every > 0)
+    g_print ("%u MB per codec, %u bytes of garbage every %u frames\n",
+        megabytes, GARBAGE_SIZE, garbage_every);
+  else
+    g_print ("%u MB per codec\n", megabytes);
+  g_print ("%8s %16s %10s %10s %10s\n", "codec", "parser", "MB/s", "written",
+      "parsed");
+
+  for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+    const Codec *codec = &codecs[i];
+    GstClockTime elapsed;
+    guint written, parsed;
+
+    if (!write_file (filename, codec, (guint64) megabytes * 1024 * 1024,
+            garbage_every, &written)) {
+      g_printerr ("could not write %s\n", filename);
+      return 1;
+    }
+
+    elapsed = run (filename, codec, &parsed);
+
+    g_print ("%8s %16s %10.1f %10u %10u\n", codec->name, codec->parser,
+        elapsed ? megabytes / ((gdouble) elapsed / GST_SECOND) : -1.0,
+        written, parsed);
+  }
+
+  g_unlink (filename);
+  g_free (filename);
+
+  return 0;
+}
@@ -0,0 +1,337 @@
+/* GStreamer avidemux ODML index benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Writes a synthetic ODML AVI file with a superindex and many small frames
+ * and measures how long avidemux takes to preroll and to seek near the end
+ * of the file, and how much memory the index takes.
+ *
+ * Usage: avidemux-odml-benchmark [frames] [frames-per-subindex] [frame-size]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FPS 25
+
+static void
+put_le32 (FILE * f, guint32 val)
+{
+  guint8 data[4];
+
+  GST_WRITE_UINT32_LE (data, val);
+  fwrite (data, 1, 4, f);
+}
+
+static void
+put_le16 (FILE * f, guint16 val)
+{
+  guint8 data[2];
+
+  GST_WRITE_UINT16_LE (data, val);
+  fwrite (data, 1, 2, f);
+}
+
+static void
+put_le64 (FILE * f, guint64 val)
+{
+  guint8 data[8];
+
+  GST_WRITE_UINT64_LE (data, val);
+  fwrite (data, 1, 8, f);
+}
+
+static void
+put_fourcc (FILE * f, const gchar * fourcc)
+{
+  fwrite (fourcc, 1, 4, f);
+}
+
+/* write the size of the chunk that starts at @start */
+static void
+fixup_size (FILE * f, long start)
+{
+  long end = ftell (f);
+
+  fseek (f, start + 4, SEEK_SET);
+  put_le32 (f, end - start - 8);
+  fseek (f, end, SEEK_SET);
+}
+
+static gboolean
+write_file (const gchar * filename, guint frames, guint per_subidx,
+    guint frame_size)
+{
+  FILE *f;
+  guint n_subidx, i, j;
+  long riff, hdrl, strl, movi, indx;
+  guint64 *subidx_offsets;
+  guint8 *frame;
+
+  n_subidx = (frames + per_subidx - 1) / per_subidx;
+
+  if (!(f = fopen (filename, "wb")))
+    return FALSE;
+
+  riff = ftell (f);
+  put_fourcc (f, "RIFF");
+  put_le32 (f, 0);
+  put_fourcc (f, "AVI ");
+
+  hdrl = ftell (f);
+  put_fourcc (f, "LIST");
+  put_le32 (f, 0);
+  put_fourcc (f, "hdrl");
+
+  /* main header, no idx1 */
+  put_fourcc (f, "avih");
+  put_le32 (f, 56);
+  put_le32 (f, 1000000 / FPS);  /* us_frame */
+  put_le32 (f, frame_size * FPS);       /* max_bps */
+  put_le32 (f, 0);              /* pad_gran */
+  put_le32 (f, 0);              /* flags */
+  put_le32 (f, frames);         /* tot_frames */
+  put_le32 (f, 0);              /* init_frames */
+  put_le32 (f, 1);              /* streams */
+  put_le32 (f, frame_size);     /* bufsize */
+  put_le32 (f, 16);             /* width */
+  put_le32 (f, 16);             /* height */
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+
+  strl = ftell (f);
+  put_fourcc (f, "LIST");
+  put_le32 (f, 0);
+  put_fourcc (f, "strl");
+
+  put_fourcc (f, "strh");
+  put_le32 (f, 56);
+  put_fourcc (f, "vids");
+  put_fourcc (f, "MJPG");
+  put_le32 (f, 0);              /* flags */
+  put_le16 (f, 0);              /* priority */
+  put_le16 (f, 0);              /* language */
+  put_le32 (f, 0);              /* init_frames */
+  put_le32 (f, 1);              /* scale */
+  put_le32 (f, FPS);            /* rate */
+  put_le32 (f, 0);              /* start */
+  put_le32 (f, frames);         /* length */
+  put_le32 (f, frame_size);     /* bufsize */
+  put_le32 (f, -1);             /* quality */
+  put_le32 (f, 0);              /* samplesize */
+  put_le16 (f, 0);
+  put_le16 (f, 0);
+  put_le16 (f, 16);
+  put_le16 (f, 16);
+
+  put_fourcc (f, "strf");
+  put_le32 (f, 40);
+  put_le32 (f, 40);             /* size */
+  put_le32 (f, 16);             /* width */
+  put_le32 (f, 16);             /* height */
+  put_le16 (f, 1);              /* planes */
+  put_le16 (f, 24);             /* bit_cnt */
+  put_fourcc (f, "MJPG");       /* compression */
+  put_le32 (f, frame_size);     /* image_size */
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+
+  /* superindex, the entries are filled in when the movi is written */
+  indx = ftell (f);
+  put_fourcc (f, "indx");
+  put_le32 (f, 24 + 16 * n_subidx);
+  put_le16 (f, 4);              /* longs per entry */
+  fputc (0, f);                 /* sub type */
+  fputc (0, f);                 /* AVI_INDEX_OF_INDEXES */
+  put_le32 (f, n_subidx);
+  put_fourcc (f, "00dc");
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  put_le32 (f, 0);
+  for (i = 0; i < n_subidx; i++) {
+    put_le64 (f, 0);
+    put_le32 (f, 0);
+    put_le32 (f, 0);
+  }
+  fixup_size (f, strl);
+  fixup_size (f, hdrl);
+
+  movi = ftell (f);
+  put_fourcc (f, "LIST");
+  put_le32 (f, 0);
+  put_fourcc (f, "movi");
+
+  subidx_offsets = g_new (guint64, n_subidx);
+  frame = g_malloc0 (frame_size);
+
+  for (i = 0; i < n_subidx; i++) {
+    guint n = MIN (per_subidx, frames - i * per_subidx);
+    guint64 base = ftell (f);
+
+    /* the frames */
+    for (j = 0; j < n; j++) {
+      put_fourcc (f, "00dc");
+      put_le32 (f, frame_size);
+      fwrite (frame, 1, frame_size, f);
+      if (frame_size & 1)
+        fputc (0, f);
+    }
+
+    /* followed by their subindex */
+    subidx_offsets[i] = ftell (f);
+    put_fourcc (f, "ix00");
+    put_le32 (f, 24 + 8 * n);
+    put_le16 (f, 2);            /* longs per entry */
+    fputc (0, f);               /* sub type */
+    fputc (1, f);               /* AVI_INDEX_OF_CHUNKS */
+    put_le32 (f, n);
+    put_fourcc (f, "00dc");
+    put_le64 (f, base);
+    put_le32 (f, 0);
+    for (j = 0; j < n; j++) {
+      /* offset points to the data, every 25th frame is a keyframe */
+      put_le32 (f, j * (8 + GST_ROUND_UP_2 (frame_size)) + 8);
+      put_le32 (f, frame_size | ((j % FPS) ? 0x80000000 : 0));
+    }
+  }
+  fixup_size (f, movi);
+  fixup_size (f, riff);
+
+  /* now fill in the superindex */
+  fseek (f, indx + 8 + 24, SEEK_SET);
+  for (i = 0; i < n_subidx; i++) {
+    guint n = MIN (per_subidx, frames - i * per_subidx);
+
+    put_le64 (f, subidx_offsets[i]);
+    put_le32 (f, 32 + 8 * n);
+    put_le32 (f, n);
+  }
+
+  g_free (frame);
+  g_free (subidx_offsets);
+
+  return fclose (f) == 0;
+}
+
+/* resident memory in kB */
+static gint
+get_rss (void)
+{
+  gchar *contents, *line;
+  gint rss = -1;
+
+  if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+    return -1;
+
+  if ((line = strstr (contents, "VmRSS:")))
+    rss = atoi (line + 6);
+  g_free (contents);
+
+  return rss;
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  GstElement *pipeline;
+  GstStateChangeReturn ret;
+  GstClockTime start, preroll, seek;
+  gchar *filename, *desc;
+  guint frames = 500000, per_subidx = 1000, frame_size = 16;
+  gint rss;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = atoi (argv[1]);
+  if (argc > 2)
+    per_subidx = atoi (argv[2]);
+  if (argc > 3)
+    frame_size = atoi (argv[3]);
+
+  if (frames == 0 || per_subidx == 0 || frame_size == 0) {
+    g_printerr ("usage: %s [frames] [frames-per-subindex] [frame-size]\n",
+        argv[0]);
+    return 1;
+  }
+
+  filename = g_build_filename (g_get_tmp_dir (), "avidemux-odml-benchmark.avi",
+      NULL);
+
+  g_print ("writing %u frames of %u bytes, %u per subindex to %s\n",
+      frames, frame_size, per_subidx, filename);
+  if (!write_file (filename, frames, per_subidx, frame_size)) {
+    g_printerr ("could not write %s\n", filename);
+    return 1;
+  }
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" ! avidemux ! fakesink",
+      filename);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  if (!pipeline) {
+    g_printerr ("could not create pipeline\n");
+    return 1;
+  }
+
+  rss = get_rss ();
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  ret = gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  preroll = gst_util_get_timestamp () - start;
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("could not preroll\n");
+    return 1;
+  }
+
+  g_print ("preroll: %" GST_TIME_FORMAT ", memory: %d kB\n",
+      GST_TIME_ARGS (preroll), get_rss () - rss);
+
+  /* seek to 90% of the file */
+  start = gst_util_get_timestamp ();
+  gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+      GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+      gst_util_uint64_scale (frames, GST_SECOND * 9, FPS * 10));
+  gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  seek = gst_util_get_timestamp () - start;
+
+  g_print ("seek: %" GST_TIME_FORMAT ", memory: %d kB\n",
+      GST_TIME_ARGS (seek), get_rss () - rss);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  g_unlink (filename);
+  g_free (filename);
+
+  return 0;
+}
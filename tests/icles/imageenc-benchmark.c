@@ -0,0 +1,208 @@
+/* GStreamer jpegenc/pngenc parallel encoding benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Encodes video frames with jpegenc and pngenc using 1 to 16 worker threads
+ * and prints how many frames per second each encoder gets through, without
+ * the time needed for generating the frames, and the average and maximum
+ * time a frame spends in the encoder.
+ *
+ * Usage: imageenc-benchmark [frames] [width] [height]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include <stdlib.h>
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *caps;
+  const gchar *encoder;
+} Encoder;
+
+static const Encoder encoders[] = {
+  {"jpeg 4:2:0", "video/x-raw-yuv,format=(fourcc)I420", "jpegenc"},
+  {"jpeg 4:2:2", "video/x-raw-yuv,format=(fourcc)YUY2", "jpegenc"},
+  {"png rgb", "video/x-raw-rgb,bpp=24,depth=24", "pngenc snapshot=false"}
+};
+
+static const guint threads[] = { 1, 2, 4, 8, 16 };
+
+typedef struct
+{
+  /* times the frames in the encoder went in, in order */
+  GQueue in_times;
+  GstClockTime total, max;
+  guint frames;
+} Latency;
+
+static void
+on_encoder_input (GstElement * identity, GstBuffer * buf, Latency * latency)
+{
+  GstClockTime *now = g_new (GstClockTime, 1);
+
+  *now = gst_util_get_timestamp ();
+  g_queue_push_tail (&latency->in_times, now);
+}
+
+/* the encoders push the frames in order, from the streaming thread */
+static void
+on_encoder_output (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    Latency * latency)
+{
+  GstClockTime *in = g_queue_pop_head (&latency->in_times), elapsed;
+
+  if (in == NULL)
+    return;
+
+  elapsed = gst_util_get_timestamp () - *in;
+  latency->total += elapsed;
+  latency->max = MAX (latency->max, elapsed);
+  latency->frames++;
+  g_free (in);
+}
+
+/* Runs the pipeline until EOS and returns the time it took. The time the
+ * frames spend between the elements named "in" and "sink" is added to
+ * @latency. */
+static GstClockTime
+run (const gchar * desc, Latency * latency)
+{
+  GstElement *pipeline, *element;
+  GstBus *bus;
+  GstMessage *msg;
+  GstClockTime start, elapsed;
+  GError *err = NULL;
+
+  pipeline = gst_parse_launch (desc, &err);
+  if (!pipeline || err) {
+    g_printerr ("could not create pipeline '%s': %s\n", desc,
+        err ? err->message : "unknown error");
+    exit (1);
+  }
+
+  if (latency) {
+    element = gst_bin_get_by_name (GST_BIN (pipeline), "in");
+    g_signal_connect (element, "handoff", G_CALLBACK (on_encoder_input),
+        latency);
+    gst_object_unref (element);
+
+    element = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+    g_signal_connect (element, "handoff", G_CALLBACK (on_encoder_output),
+        latency);
+    gst_object_unref (element);
+  }
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    g_printerr ("error while running the pipeline '%s'\n", desc);
+    exit (1);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+static void
+encode (const Encoder * encoder, guint n_threads, const gchar * src,
+    guint frames, GstClockTime base)
+{
+  Latency latency = { G_QUEUE_INIT, 0, 0, 0 };
+  GstClockTime elapsed;
+  gchar *desc;
+
+  desc = g_strdup_printf ("%s ! identity name=in signal-handoffs=true ! "
+      "%s threads=%u ! fakesink name=sink signal-handoffs=true sync=false",
+      src, encoder->encoder, n_threads);
+  elapsed = run (desc, &latency);
+  g_free (desc);
+
+  g_queue_foreach (&latency.in_times, (GFunc) g_free, NULL);
+  g_queue_clear (&latency.in_times);
+
+  elapsed = (elapsed > base) ? elapsed - base : 0;
+
+  g_print ("%12s %8u %10.1f %12.2f %12.2f\n", encoder->name, n_threads,
+      elapsed ? frames / ((gdouble) elapsed / GST_SECOND) : -1.0,
+      latency.frames ? (gdouble) latency.total / latency.frames / GST_MSECOND :
+      -1.0, (gdouble) latency.max / GST_MSECOND);
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  guint frames = 300, i, j;
+  gint width = 1920, height = 1080;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = atoi (argv[1]);
+  if (argc > 2)
+    width = atoi (argv[2]);
+  if (argc > 3)
+    height = atoi (argv[3]);
+
+  if (frames == 0 || width <= 0 || height <= 0) {
+    g_printerr ("usage: %s [frames] [width] [height]\n", argv[0]);
+    return 1;
+  }
+
+  g_print ("%u frames of %dx%d\n", frames, width, height);
+  g_print ("%12s %8s %10s %12s %12s\n", "encoder", "threads", "fps",
+      "latency ms", "max ms");
+
+  for (i = 0; i < G_N_ELEMENTS (encoders); i++) {
+    const Encoder *encoder = &encoders[i];
+    GstClockTime base;
+    gchar *src, *desc;
+
+    src = g_strdup_printf ("videotestsrc pattern=ball num-buffers=%u ! "
+        "%s,width=%d,height=%d,framerate=60/1", frames, encoder->caps,
+        width, height);
+
+    /* time for generating the frames alone */
+    desc = g_strdup_printf ("%s ! fakesink sync=false", src);
+    base = run (desc, NULL);
+    g_free (desc);
+
+    for (j = 0; j < G_N_ELEMENTS (threads); j++)
+      encode (encoder, threads[j], src, frames, base);
+
+    g_free (src);
+  }
+
+  return 0;
+}
@@ -0,0 +1,218 @@
+/* GStreamer interleave/deinterleave throughput benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Interleaves and deinterleaves some seconds of audio for different
+ * channel counts and sample formats and prints the throughput of both
+ * elements in MB/s, without the time needed for generating the input.
+ *
+ * Usage: interleave-benchmark [seconds]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include <stdlib.h>
+
+#define RATE 48000
+#define SAMPLES_PER_BUFFER 1024
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *caps;
+  gint width;
+} Format;
+
+static const Format formats[] = {
+  {"int16", "audio/x-raw-int,width=16,depth=16,signed=true", 16},
+  {"int32", "audio/x-raw-int,width=32,depth=32,signed=true", 32},
+  {"float32", "audio/x-raw-float,width=32", 32},
+  {"float64", "audio/x-raw-float,width=64", 64}
+};
+
+static const gint channel_counts[] = { 1, 2, 4, 6, 8, 16, 32, 64 };
+
+static gchar *
+make_caps (const Format * format, gint channels)
+{
+  return g_strdup_printf ("%s,endianness=%d,rate=%d,channels=%d",
+      format->caps, G_BYTE_ORDER, RATE, channels);
+}
+
+static gchar *
+make_src (const Format * format, gint channels, guint seconds)
+{
+  gchar *caps, *src;
+
+  caps = make_caps (format, channels);
+  src = g_strdup_printf ("audiotestsrc wave=silence samplesperbuffer=%d "
+      "num-buffers=%u ! %s", SAMPLES_PER_BUFFER,
+      seconds * RATE / SAMPLES_PER_BUFFER, caps);
+  g_free (caps);
+
+  return src;
+}
+
+/* Runs the pipeline until EOS and returns the time it took */
+static GstClockTime
+run (const gchar * desc)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GstClockTime start, elapsed;
+  GError *err = NULL;
+
+  pipeline = gst_parse_launch (desc, &err);
+  if (!pipeline || err) {
+    g_printerr ("could not create pipeline '%s': %s\n", desc,
+        err ? err->message : "unknown error");
+    exit (1);
+  }
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    g_printerr ("error while running the pipeline '%s'\n", desc);
+    exit (1);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+/* Time for interleaving @channels mono streams, minus the time for
+ * generating them */
+static GstClockTime
+run_interleave (const Format * format, gint channels, guint seconds)
+{
+  GString *desc, *base_desc;
+  GstClockTime base, elapsed;
+  gchar *src;
+  gint i;
+
+  src = make_src (format, 1, seconds);
+
+  desc = g_string_new ("interleave name=i ! fakesink sync=false");
+  base_desc = g_string_new ("");
+  for (i = 0; i < channels; i++) {
+    g_string_append_printf (desc, " %s ! i.", src);
+    g_string_append_printf (base_desc, " %s ! fakesink sync=false", src);
+  }
+  g_free (src);
+
+  base = run (base_desc->str);
+  elapsed = run (desc->str);
+
+  g_string_free (desc, TRUE);
+  g_string_free (base_desc, TRUE);
+
+  return (elapsed > base) ? elapsed - base : 0;
+}
+
+/* Time for deinterleaving a stream with @channels channels, minus the time
+ * for generating it */
+static GstClockTime
+run_deinterleave (const Format * format, gint channels, guint seconds)
+{
+  GString *desc;
+  GstClockTime base, elapsed;
+  gchar *src, *base_desc;
+  gint i;
+
+  src = make_src (format, channels, seconds);
+
+  desc = g_string_new ("");
+  g_string_append_printf (desc, "%s ! deinterleave name=d", src);
+  for (i = 0; i < channels; i++)
+    g_string_append_printf (desc, " d.src%d ! fakesink sync=false", i);
+  base_desc = g_strdup_printf ("%s ! fakesink sync=false", src);
+  g_free (src);
+
+  base = run (base_desc);
+  elapsed = run (desc->str);
+
+  g_free (base_desc);
+  g_string_free (desc, TRUE);
+
+  return (elapsed > base) ? elapsed - base : 0;
+}
+
+static gdouble
+throughput (const Format * format, gint channels, guint seconds,
+    GstClockTime elapsed)
+{
+  gdouble bytes = (gdouble) seconds * RATE * channels * (format->width / 8);
+
+  if (elapsed == 0)
+    return -1.0;
+
+  return bytes / (1024.0 * 1024.0) / ((gdouble) elapsed / GST_SECOND);
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  guint seconds = 60, f, c;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    seconds = atoi (argv[1]);
+
+  if (seconds == 0) {
+    g_printerr ("usage: %s [seconds]\n", argv[0]);
+    return 1;
+  }
+
+  g_print ("%u s of audio at %d Hz, throughput in MB/s\n", seconds, RATE);
+  g_print ("%8s %8s %14s %14s\n", "format", "channels", "interleave",
+      "deinterleave");
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    for (c = 0; c < G_N_ELEMENTS (channel_counts); c++) {
+      const Format *format = &formats[f];
+      gint channels = channel_counts[c];
+      GstClockTime ielapsed, delapsed;
+
+      ielapsed = run_interleave (format, channels, seconds);
+      delapsed = run_deinterleave (format, channels, seconds);
+
+      g_print ("%8s %8d %14.1f %14.1f\n", format->name, channels,
+          throughput (format, channels, seconds, ielapsed),
+          throughput (format, channels, seconds, delapsed));
+    }
+  }
+
+  return 0;
+}
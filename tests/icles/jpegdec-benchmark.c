@@ -0,0 +1,199 @@
+/* GStreamer jpegdec parallel decoding benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Encodes motion JPEG streams without restart markers and with restart
+ * markers after every MCU row and after every 4 MCUs, in 4:2:0 and 4:2:2,
+ * and prints how many frames per second jpegdec decodes from them with
+ * different numbers of threads, without the time needed for reading the
+ * files.
+ *
+ * Usage: jpegdec-benchmark [frames] [width] [height]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *format;
+  /* number of 16 pixel wide MCUs between restart markers, 0 for none,
+   * -1 for one MCU row */
+  gint restart_interval;
+} Stream;
+
+static const Stream streams[] = {
+  {"4:2:0", "I420", 0},
+  {"4:2:0 rst row", "I420", -1},
+  {"4:2:0 rst 4", "I420", 4},
+  {"4:2:2", "YUY2", 0},
+  {"4:2:2 rst row", "YUY2", -1},
+  {"4:2:2 rst 4", "YUY2", 4}
+};
+
+/* Runs the pipeline until EOS and returns the time it took */
+static GstClockTime
+run (const gchar * desc)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GstClockTime start, elapsed;
+  GError *err = NULL;
+
+  pipeline = gst_parse_launch (desc, &err);
+  if (!pipeline || err) {
+    g_printerr ("could not create pipeline '%s': %s\n", desc,
+        err ? err->message : "unknown error");
+    exit (1);
+  }
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    g_printerr ("error while running the pipeline '%s'\n", desc);
+    exit (1);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+static void
+encode (const gchar * location, const Stream * stream, guint frames,
+    gint width, gint height)
+{
+  gchar *desc;
+  gint restart_interval = stream->restart_interval;
+
+  if (restart_interval < 0)
+    restart_interval = (width + 15) / 16;
+
+  desc = g_strdup_printf ("videotestsrc pattern=ball num-buffers=%u ! "
+      "video/x-raw-yuv,format=(fourcc)%s,width=%d,height=%d,framerate=60/1 ! "
+      "jpegenc restart-interval=%d ! multifilesink location=\"%s\"", frames,
+      stream->format, width, height, restart_interval, location);
+  run (desc);
+  g_free (desc);
+}
+
+static gdouble
+decode (const gchar * location, guint threads, guint frames,
+    GstClockTime base)
+{
+  GstClockTime elapsed;
+  gchar *desc;
+
+  desc = g_strdup_printf ("multifilesrc location=\"%s\" "
+      "caps=\"image/jpeg,framerate=60/1\" ! jpegdec threads=%u ! "
+      "fakesink sync=false", location, threads);
+  elapsed = run (desc);
+  g_free (desc);
+
+  elapsed = (elapsed > base) ? elapsed - base : 0;
+  if (elapsed == 0)
+    return -1.0;
+
+  return frames / ((gdouble) elapsed / GST_SECOND);
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  guint frames = 300, threads[4] = { 1, 2, 4, 0 }, i, j;
+  gint width = 1920, height = 1080;
+  gchar *dir, *location, *desc;
+  GstClockTime base;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = atoi (argv[1]);
+  if (argc > 2)
+    width = atoi (argv[2]);
+  if (argc > 3)
+    height = atoi (argv[3]);
+
+  if (frames == 0 || width <= 0 || height <= 0) {
+    g_printerr ("usage: %s [frames] [width] [height]\n", argv[0]);
+    return 1;
+  }
+
+#ifdef _SC_NPROCESSORS_ONLN
+  threads[3] = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+#endif
+
+  dir = g_build_filename (g_get_tmp_dir (), "jpegdec-benchmark", NULL);
+  g_mkdir_with_parents (dir, 0755);
+  location = g_build_filename (dir, "%05d.jpg", NULL);
+
+  g_print ("%u frames of %dx%d, decoded frames per second\n", frames, width,
+      height);
+  g_print ("%14s %10u %10u %10u %10u\n", "stream", threads[0], threads[1],
+      threads[2], threads[3]);
+
+  for (i = 0; i < G_N_ELEMENTS (streams); i++) {
+    const Stream *stream = &streams[i];
+
+    encode (location, stream, frames, width, height);
+
+    /* time for reading the files alone */
+    desc = g_strdup_printf ("multifilesrc location=\"%s\" "
+        "caps=\"image/jpeg,framerate=60/1\" ! fakesink sync=false", location);
+    base = run (desc);
+    g_free (desc);
+
+    g_print ("%14s", stream->name);
+    for (j = 0; j < G_N_ELEMENTS (threads); j++)
+      g_print (" %10.1f", decode (location, threads[j], frames, base));
+    g_print ("\n");
+  }
+
+  for (i = 0; i < frames; i++) {
+    gchar *filename = g_strdup_printf (location, i);
+
+    g_unlink (filename);
+    g_free (filename);
+  }
+  g_rmdir (dir);
+  g_free (location);
+  g_free (dir);
+
+  return 0;
+}
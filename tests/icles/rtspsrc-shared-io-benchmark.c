@@ -0,0 +1,422 @@
+/* GStreamer rtspsrc shared I/O benchmark
+ * Copyright (C) 2010 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Receives a number of streams over interleaved TCP with one rtspsrc
+ * pipeline per stream, like a recorder for many cameras, first with a
+ * thread per rtspsrc and then with shared-io=true. For every number of
+ * streams it prints the number of threads in the process and the number of
+ * context switches and received packets per second while streaming.
+ *
+ * The streams come from a minimal RTSP server that runs in a child process,
+ * so that its threads and context switches are not counted. Every stream
+ * sends PACKET_RATE packets of MPEG-TS over RTP per second. The thread count
+ * is read from /proc, so this only gives useful numbers on Linux. For many
+ * streams the limit of open files may have to be raised with ulimit -n.
+ *
+ * No reference results are kept with this program, shared-io was merged
+ * without a measured comparison. The results depend on the machine, the
+ * kernel and the number of CPUs, so compare both modes on the machine that
+ * is going to receive the streams. Only the reading of the interleaved TCP
+ * connections is shared, sessions over UDP and the threads of rtpbin are
+ * not, so those still show up in the thread count of both modes.
+ *
+ * Usage: rtspsrc-shared-io-benchmark [seconds] [streams ...]
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define PACKET_RATE     100
+#define PAYLOAD_SIZE    (7 * 188)
+#define WARMUP_TIME     (3 * GST_SECOND)
+
+static const guint default_streams[] = { 10, 100, 500 };
+
+static const gchar sdp[] =
+    "v=0\r\n"
+    "o=- 1 1 IN IP4 127.0.0.1\r\n"
+    "s=camera\r\n"
+    "c=IN IP4 127.0.0.1\r\n"
+    "t=0 0\r\n"
+    "m=video 0 RTP/AVP 33\r\n"
+    "a=rtpmap:33 MP2T/90000\r\n" "a=control:stream=0\r\n";
+
+typedef struct
+{
+  gint fd;
+  GString *in;
+  gboolean playing;
+  guint16 seqnum;
+} Client;
+
+static void
+client_free (Client * client)
+{
+  close (client->fd);
+  g_string_free (client->in, TRUE);
+  g_free (client);
+}
+
+static gboolean
+client_send (Client * client, const gchar * data, gsize size)
+{
+  while (size > 0) {
+    gssize r = send (client->fd, data, size, MSG_NOSIGNAL);
+
+    if (r <= 0)
+      return FALSE;
+    data += r;
+    size -= r;
+  }
+  return TRUE;
+}
+
+/* answers the request at the start of the input of @client, if complete */
+static gboolean
+client_handle_request (Client * client, guint port, gboolean * done)
+{
+  gchar *end, *line, *method, *reply;
+  gint cseq = 0;
+  gboolean res;
+
+  end = strstr (client->in->str, "\r\n\r\n");
+  if (end == NULL) {
+    *done = TRUE;
+    return TRUE;
+  }
+  *end = '\0';
+
+  method = g_strndup (client->in->str, strcspn (client->in->str, " "));
+  for (line = client->in->str; line; line = strstr (line + 1, "\r\n")) {
+    if (g_ascii_strncasecmp (line, "\r\nCSeq:", 7) == 0)
+      cseq = atoi (line + 7);
+  }
+
+  if (strcmp (method, "OPTIONS") == 0) {
+    reply = g_strdup_printf ("RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+        "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, "
+        "GET_PARAMETER\r\n\r\n", cseq);
+  } else if (strcmp (method, "DESCRIBE") == 0) {
+    reply = g_strdup_printf ("RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+        "Content-Type: application/sdp\r\n"
+        "Content-Base: rtsp://127.0.0.1:%u/camera/\r\n"
+        "Content-Length: %u\r\n\r\n%s", cseq, port,
+        (guint) strlen (sdp), sdp);
+  } else if (strcmp (method, "SETUP") == 0) {
+    reply = g_strdup_printf ("RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+        "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
+        "Session: 1;timeout=60\r\n\r\n", cseq);
+  } else {
+    if (strcmp (method, "PLAY") == 0)
+      client->playing = TRUE;
+    else if (strcmp (method, "PAUSE") == 0 ||
+        strcmp (method, "TEARDOWN") == 0)
+      client->playing = FALSE;
+    reply = g_strdup_printf ("RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+        "Session: 1\r\n\r\n", cseq);
+  }
+
+  g_string_erase (client->in, 0, end + 4 - client->in->str);
+  res = client_send (client, reply, strlen (reply));
+  g_free (reply);
+  g_free (method);
+
+  return res;
+}
+
+static gboolean
+client_send_packet (Client * client, guint32 timestamp)
+{
+  guint8 packet[4 + 12 + PAYLOAD_SIZE] = { 0, };
+
+  packet[0] = '$';
+  packet[1] = 0;
+  GST_WRITE_UINT16_BE (packet + 2, 12 + PAYLOAD_SIZE);
+  /* version 2, payload type 33 */
+  packet[4] = 0x80;
+  packet[5] = 33;
+  GST_WRITE_UINT16_BE (packet + 6, client->seqnum++);
+  GST_WRITE_UINT32_BE (packet + 8, timestamp);
+  GST_WRITE_UINT32_BE (packet + 12, 0x12345678);
+
+  return client_send (client, (gchar *) packet, sizeof (packet));
+}
+
+/* the RTSP server, runs until it is killed */
+static void
+serve (gint listen_fd, guint port)
+{
+  GPtrArray *clients = g_ptr_array_new ();
+  GstClockTime next_packet = gst_util_get_timestamp ();
+  guint32 timestamp = 0;
+
+  while (TRUE) {
+    struct pollfd *fds;
+    GstClockTime now;
+    guint i;
+    gint timeout;
+
+    fds = g_new0 (struct pollfd, clients->len + 1);
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    for (i = 0; i < clients->len; i++) {
+      fds[i + 1].fd = ((Client *) g_ptr_array_index (clients, i))->fd;
+      fds[i + 1].events = POLLIN;
+    }
+
+    now = gst_util_get_timestamp ();
+    timeout = next_packet > now ? (next_packet - now) / GST_MSECOND : 0;
+    poll (fds, clients->len + 1, timeout);
+
+    /* handle the requests before accepting, the indices match the fds */
+    for (i = clients->len; i > 0; i--) {
+      Client *client = g_ptr_array_index (clients, i - 1);
+      gboolean done = FALSE, ok = TRUE;
+      gchar buf[4096];
+      gssize r;
+
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+
+      if ((r = recv (client->fd, buf, sizeof (buf), 0)) > 0) {
+        g_string_append_len (client->in, buf, r);
+        while (ok && !done)
+          ok = client_handle_request (client, port, &done);
+      }
+      if (r <= 0 || !ok) {
+        g_ptr_array_remove_index_fast (clients, i - 1);
+        client_free (client);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      gint fd = accept (listen_fd, NULL, NULL);
+
+      if (fd >= 0) {
+        Client *client = g_new0 (Client, 1);
+
+        client->fd = fd;
+        client->in = g_string_new (NULL);
+        g_ptr_array_add (clients, client);
+      }
+    }
+    g_free (fds);
+
+    if (gst_util_get_timestamp () < next_packet)
+      continue;
+
+    next_packet += GST_SECOND / PACKET_RATE;
+    timestamp += 90000 / PACKET_RATE;
+    for (i = clients->len; i > 0; i--) {
+      Client *client = g_ptr_array_index (clients, i - 1);
+
+      if (client->playing && !client_send_packet (client, timestamp)) {
+        g_ptr_array_remove_index_fast (clients, i - 1);
+        client_free (client);
+      }
+    }
+  }
+}
+
+/* starts the server in a child process and returns its pid */
+static pid_t
+start_server (guint * port)
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof (addr);
+  gint fd, one = 1;
+  pid_t pid;
+
+  fd = socket (AF_INET, SOCK_STREAM, 0);
+  setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+      listen (fd, 1024) < 0 ||
+      getsockname (fd, (struct sockaddr *) &addr, &len) < 0) {
+    g_printerr ("could not start the server\n");
+    exit (1);
+  }
+  *port = ntohs (addr.sin_port);
+
+  if ((pid = fork ()) == 0) {
+    serve (fd, *port);
+    _exit (0);
+  }
+  close (fd);
+
+  return pid;
+}
+
+static gint received;
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buf, GstPad * pad,
+    gpointer user_data)
+{
+  g_atomic_int_inc (&received);
+}
+
+static guint
+count_threads (void)
+{
+  gchar *status, *threads;
+  guint n = 0;
+
+  if (g_file_get_contents ("/proc/self/status", &status, NULL, NULL)) {
+    if ((threads = strstr (status, "Threads:")))
+      n = atoi (threads + 8);
+    g_free (status);
+  }
+  return n;
+}
+
+static guint64
+count_context_switches (void)
+{
+  struct rusage usage;
+
+  /* for all threads of the process */
+  getrusage (RUSAGE_SELF, &usage);
+
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static void
+run (guint port, guint n_streams, gboolean shared_io, guint seconds)
+{
+  GstElement **pipelines;
+  guint64 switches;
+  gint packets;
+  guint i, threads;
+
+  pipelines = g_new0 (GstElement *, n_streams);
+  for (i = 0; i < n_streams; i++) {
+    GstElement *sink;
+    GError *err = NULL;
+    gchar *desc;
+
+    desc = g_strdup_printf ("rtspsrc location=rtsp://127.0.0.1:%u/camera "
+        "protocols=tcp shared-io=%s ! "
+        "fakesink name=sink sync=false signal-handoffs=true", port,
+        shared_io ? "true" : "false");
+    pipelines[i] = gst_parse_launch (desc, &err);
+    if (!pipelines[i] || err) {
+      g_printerr ("could not create pipeline '%s': %s\n", desc,
+          err ? err->message : "unknown error");
+      exit (1);
+    }
+    g_free (desc);
+
+    sink = gst_bin_get_by_name (GST_BIN (pipelines[i]), "sink");
+    g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), NULL);
+    gst_object_unref (sink);
+
+    gst_element_set_state (pipelines[i], GST_STATE_PLAYING);
+  }
+
+  g_usleep (WARMUP_TIME / GST_USECOND);
+
+  switches = count_context_switches ();
+  packets = g_atomic_int_get (&received);
+
+  g_usleep (seconds * G_USEC_PER_SEC);
+
+  threads = count_threads ();
+  switches = count_context_switches () - switches;
+  packets = g_atomic_int_get (&received) - packets;
+
+  g_print ("%8u %10s %8u %12.0f %12.0f\n", n_streams,
+      shared_io ? "shared" : "per-src", threads, (gdouble) switches / seconds,
+      (gdouble) packets / seconds);
+
+  for (i = 0; i < n_streams; i++) {
+    gst_element_set_state (pipelines[i], GST_STATE_NULL);
+    gst_object_unref (pipelines[i]);
+  }
+  g_free (pipelines);
+}
+
+gint
+main (gint argc, gchar ** argv)
+{
+  const guint *streams = default_streams;
+  guint n_streams = G_N_ELEMENTS (default_streams);
+  guint seconds = 10, port, *args = NULL, i;
+  struct rlimit limit;
+  pid_t server;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    seconds = atoi (argv[1]);
+  if (argc > 2) {
+    n_streams = argc - 2;
+    streams = args = g_new (guint, n_streams);
+    for (i = 0; i < n_streams; i++)
+      args[i] = atoi (argv[i + 2]);
+  }
+
+  if (seconds == 0) {
+    g_printerr ("usage: %s [seconds] [streams ...]\n", argv[0]);
+    return 1;
+  }
+
+  /* every stream needs a couple of sockets */
+  if (getrlimit (RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit (RLIMIT_NOFILE, &limit);
+  }
+
+  server = start_server (&port);
+
+  g_print ("%u packets per second per stream, %u seconds\n", PACKET_RATE,
+      seconds);
+  g_print ("%8s %10s %8s %12s %12s\n", "streams", "mode", "threads",
+      "switches/s", "packets/s");
+
+  for (i = 0; i < n_streams; i++) {
+    run (port, streams[i], FALSE, seconds);
+    run (port, streams[i], TRUE, seconds);
+  }
+
+  kill (server, SIGTERM);
+  waitpid (server, NULL, 0);
+  g_free (args);
+
+  return 0;
+}